@@ -214,9 +214,12 @@ static int ParseCPrecompiler(PDEPGLOBALS pThis, FILE *pInput)
 static int usage(FILE *pOut,  const char *argv0)
 {
     fprintf(pOut,
-            "usage: %s [-l=c] -o <output> -t <target> [-f] [-s] < - | <filename> | -e <cmdline> >\n"
+            "usage: %s [-l=c] -o <output> -t <target> [-f] [-s] [-d <depdb>] < - | <filename> | -e <cmdline> >\n"
             "   or: %s --help\n"
-            "   or: %s --version\n",
+            "   or: %s --version\n"
+            "\n"
+            "With -d (--db) the dependencies are stored in the given dependency\n"
+            "database under the <output> name instead of being written to <output>.\n",
             argv0, argv0, argv0);
     return 1;
 }
@@ -231,6 +234,7 @@ int main(int argc, char *argv[])
     int         iExec = 0;
     FILE       *pOutput = NULL;
     const char *pszOutput = NULL;
+    const char *pszDb = NULL;
     FILE       *pInput = NULL;
     const char *pszTarget = NULL;
     int         fStubs = 0;
@@ -254,6 +258,8 @@ int main(int argc, char *argv[])
                     psz = "h";
                 else if (!strcmp(psz, "-version"))
                     psz = "V";
+                else if (!strcmp(psz, "-db"))
+                    psz = "d";
             }
 
             switch (*psz)
@@ -263,12 +269,12 @@ int main(int argc, char *argv[])
                  */
                 case 'o':
                 {
-                    pszOutput = &argv[i][2];
-                    if (pOutput)
+                    if (pszOutput)
                     {
                         fprintf(stderr, "%s: syntax error: only one output file!\n", argv[0]);
                         return 1;
                     }
+                    pszOutput = &argv[i][2];
                     if (!*pszOutput)
                     {
                         if (++i >= argc)
@@ -278,15 +284,29 @@ int main(int argc, char *argv[])
                         }
                         pszOutput = argv[i];
                     }
-                    if (pszOutput[0] == '-' && !pszOutput[1])
-                        pOutput = stdout;
-                    else
-                        pOutput = fopen(pszOutput, "w");
-                    if (!pOutput)
+                    break;
+                }
+
+                /*
+                 * Dependency database.
+                 */
+                case 'd':
+                {
+                    if (pszDb)
                     {
-                        fprintf(stderr, "%s: error: Failed to create output file '%s'.\n", argv[0], pszOutput);
+                        fprintf(stderr, "%s: syntax error: only one dependency database!\n", argv[0]);
                         return 1;
                     }
+                    pszDb = psz[1] ? &psz[1] : NULL;
+                    if (!pszDb)
+                    {
+                        if (++i >= argc)
+                        {
+                            fprintf(stderr, "%s: syntax error: The '-d' argument is missing the database name.\n", argv[0]);
+                            return 1;
+                        }
+                        pszDb = argv[i];
+                    }
                     break;
                 }
 
@@ -428,7 +448,7 @@ int main(int argc, char *argv[])
         fprintf(stderr, "%s: syntax error: No input!\n", argv[0]);
         return 1;
     }
-    if (!pOutput)
+    if (!pszOutput)
     {
         fprintf(stderr, "%s: syntax error: No output!\n", argv[0]);
         return 1;
@@ -439,6 +459,22 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    /*
+     * Open the output file (unless we're writing to the database).
+     */
+    if (!pszDb)
+    {
+        if (pszOutput[0] == '-' && !pszOutput[1])
+            pOutput = stdout;
+        else
+            pOutput = fopen(pszOutput, "w");
+        if (!pOutput)
+        {
+            fprintf(stderr, "%s: error: Failed to create output file '%s'.\n", argv[0], pszOutput);
+            return 1;
+        }
+    }
+
     /*
      * Spawn process?
      */
@@ -463,8 +499,24 @@ int main(int argc, char *argv[])
     }
 
     /*
-     * Write the dependecy file.
+     * Write the dependecy file or database entry.
      */
+    if (pszDb)
+    {
+        if (!i)
+        {
+            depOptimize(&This, fFixCase, 0 /* fQuiet */, NULL /*pszIgnoredExt*/);
+            i = depWriteToDb(&This, pszDb, pszOutput, pszTarget, fStubs);
+            if (i)
+            {
+                fprintf(stderr, "%s: error: Failed to store '%s' in the dependency database '%s': %s\n",
+                        argv[0], pszOutput, pszDb, strerror(i));
+                i = 1;
+            }
+        }
+        depCleanup(&This);
+        return i;
+    }
     if (!i)
     {
         depOptimize(&This, fFixCase, 0 /* fQuiet */, NULL /*pszIgnoredExt*/);
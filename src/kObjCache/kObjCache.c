@@ -41,6 +41,7 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <ctype.h>
+#include <time.h>
 #ifndef PATH_MAX
 # ifdef _MAX_PATH
 #  define PATH_MAX _MAX_PATH /* windows */
@@ -58,7 +59,11 @@
 # endif
 # if defined(_MSC_VER)
 #  include <direct.h>
+#  include <sys/utime.h>
    typedef intptr_t pid_t;
+# else
+#  include <utime.h>
+#  include <dirent.h>
 # endif
 # ifndef _P_WAIT
 #  define _P_WAIT   P_WAIT
@@ -68,6 +73,8 @@
 # endif
 #else
 # include <unistd.h>
+# include <dirent.h>
+# include <utime.h>
 # include <sys/wait.h>
 # include <sys/time.h>
 # ifndef O_BINARY
@@ -80,6 +87,7 @@
 #if defined(__WIN__)
 # include <Windows.h>
 # include "quoted_spawn.h"
+# include "nt/ntdir.h"
 #endif
 #if defined(__HAIKU__)
 # include <posix/sys/file.h>
@@ -87,6 +95,7 @@
 
 #include "crc32.h"
 #include "md5.h"
+#include "murmurhash3.h"
 #include "kDep.h"
 
 
@@ -124,6 +133,11 @@
 #define KOC_BUF_INCR        KOC_BUF_ALIGNMENT
 #define KOC_BUF_ALIGNMENT   (4U*1024U*1024U)
 
+/** The number of shard directories in an object store (2 hex digits). */
+#define KOCSTORE_SHARDS     256
+/** Age in seconds after which left behind temporary store files are removed. */
+#define KOCSTORE_TMP_MAX_AGE    3600
+
 
 /*******************************************************************************
 *   Global Variables                                                           *
@@ -1775,6 +1789,24 @@ static void kOCCppRdGrabOutput(PKOCCPPRD pCppRd, char **ppszRet, size_t *pcbRet)
 
 
 
+/**
+ * The digest algorithms a checksum can be using.
+ *
+ * Checksums of different types never compare equal, so switching algorithm
+ * just costs one recompile per cache entry.
+ */
+typedef enum KOCSUMTYPE
+{
+    /** MD5, which is what older versions used exclusively. */
+    kOCSumType_MD5 = 0,
+    /** MurmurHash3 x64 128-bit, a lot cheaper than MD5.  The default. */
+    kOCSumType_MurmurHash3
+} KOCSUMTYPE;
+
+/** The digest algorithm used for new checksums (--digest). */
+static KOCSUMTYPE g_enmSumType = kOCSumType_MurmurHash3;
+
+
 /** A checksum list entry.
  * We keep a list checksums (of preprocessor output) that matches.
  *
@@ -1787,8 +1819,10 @@ typedef struct KOCSUM
     struct KOCSUM *pNext;
     /** The crc32 checksum. */
     uint32_t crc32;
-    /** The MD5 digest. */
-    unsigned char md5[16];
+    /** The digest algorithm. */
+    KOCSUMTYPE enmType;
+    /** The 128-bit digest, see enmType. */
+    unsigned char abDigest[16];
     /** Valid or not. */
     unsigned fUsed;
 } KOCSUM;
@@ -1803,8 +1837,15 @@ typedef const KOCSUM *PCKOCSUM;
  */
 typedef struct KOCSUMCTX
 {
-    /** The MD5 context. */
-    struct MD5Context MD5Ctx;
+    /** The digest algorithm. */
+    KOCSUMTYPE enmType;
+    union
+    {
+        /** The MD5 context. */
+        struct MD5Context MD5Ctx;
+        /** The MurmurHash3 context. */
+        struct MurmurHash3Context MM3Ctx;
+    } u;
 } KOCSUMCTX;
 /** Pointer to a check context record. */
 typedef KOCSUMCTX *PKOCSUMCTX;
@@ -1820,7 +1861,11 @@ typedef KOCSUMCTX *PKOCSUMCTX;
 static void kOCSumInitWithCtx(PKOCSUM pSum, PKOCSUMCTX pCtx)
 {
     memset(pSum, 0, sizeof(*pSum));
-    MD5Init(&pCtx->MD5Ctx);
+    pSum->enmType = pCtx->enmType = g_enmSumType;
+    if (pCtx->enmType == kOCSumType_MD5)
+        MD5Init(&pCtx->u.MD5Ctx);
+    else
+        MurmurHash3Init(&pCtx->u.MM3Ctx);
 }
 
 
@@ -1842,7 +1887,11 @@ static void kOCSumUpdate(PKOCSUM pSum, PKOCSUMCTX pCtx, const void *pvBuf, size_
     {
         size_t cb = cbBuf >= 128*1024 ? 128*1024 : cbBuf;
         pSum->crc32 = crc32(pSum->crc32, pb, cb);
-        MD5Update(&pCtx->MD5Ctx, pb, (unsigned)cb);
+        if (pCtx->enmType == kOCSumType_MD5)
+            MD5Update(&pCtx->u.MD5Ctx, pb, (unsigned)cb);
+        else
+            MurmurHash3Update(&pCtx->u.MM3Ctx, pb, cb);
+        pb += cb;
         cbBuf -= cb;
     }
 }
@@ -1856,7 +1905,10 @@ static void kOCSumUpdate(PKOCSUM pSum, PKOCSUMCTX pCtx, const void *pvBuf, size_
  */
 static void kOCSumFinalize(PKOCSUM pSum, PKOCSUMCTX pCtx)
 {
-    MD5Final(&pSum->md5[0], &pCtx->MD5Ctx);
+    if (pCtx->enmType == kOCSumType_MD5)
+        MD5Final(&pSum->abDigest[0], &pCtx->u.MD5Ctx);
+    else
+        MurmurHash3Final(&pSum->abDigest[0], &pCtx->u.MM3Ctx);
     pSum->fUsed = 1;
 }
 
@@ -1883,24 +1935,31 @@ static int kOCSumInitFromString(PKOCSUM pSumHead, const char *pszVal)
 {
     unsigned i;
     char *pszNext;
-    char *pszMD5;
+    char *pszDigest;
 
     memset(pSumHead, 0, sizeof(*pSumHead));
 
-    pszMD5 = strchr(pszVal, ':');
-    if (pszMD5 == NULL)
+    pszDigest = strchr(pszVal, ':');
+    if (pszDigest == NULL)
         return -1;
-    *pszMD5++ = '\0';
+    *pszDigest++ = '\0';
 
     /* crc32 */
     pSumHead->crc32 = (uint32_t)strtoul(pszVal, &pszNext, 16);
     if (pszNext && *pszNext)
         return -1;
 
-    /* md5 */
-    for (i = 0; i < sizeof(pSumHead->md5) * 2; i++)
+    /* digest, MD5 ones have no type prefix. */
+    if (!strncmp(pszDigest, "murmur3:", sizeof("murmur3:") - 1))
     {
-        unsigned char ch = pszMD5[i];
+        pSumHead->enmType = kOCSumType_MurmurHash3;
+        pszDigest += sizeof("murmur3:") - 1;
+    }
+    else
+        pSumHead->enmType = kOCSumType_MD5;
+    for (i = 0; i < sizeof(pSumHead->abDigest) * 2; i++)
+    {
+        unsigned char ch = pszDigest[i];
         int x;
         if ((unsigned char)(ch - '0') <= 9)
             x = ch - '0';
@@ -1911,9 +1970,9 @@ static int kOCSumInitFromString(PKOCSUM pSumHead, const char *pszVal)
         else
             return -1;
         if (!(i & 1))
-            pSumHead->md5[i >> 1] = x << 4;
+            pSumHead->abDigest[i >> 1] = x << 4;
         else
-            pSumHead->md5[i >> 1] |= x;
+            pSumHead->abDigest[i >> 1] |= x;
     }
 
     pSumHead->fUsed = 1;
@@ -1989,12 +2048,13 @@ static void kOCSumAddChain(PKOCSUM pSumHead, PCKOCSUM pSumHeadAdd)
  */
 static void kOCSumFPrintf(PCKOCSUM pSum, FILE *pFile)
 {
-    fprintf(pFile, "%#x:%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x\n",
+    fprintf(pFile, "%#x:%s%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x\n",
             pSum->crc32,
-            pSum->md5[0], pSum->md5[1], pSum->md5[2], pSum->md5[3],
-            pSum->md5[4], pSum->md5[5], pSum->md5[6], pSum->md5[7],
-            pSum->md5[8], pSum->md5[9], pSum->md5[10], pSum->md5[11],
-            pSum->md5[12], pSum->md5[13], pSum->md5[14], pSum->md5[15]);
+            pSum->enmType == kOCSumType_MD5 ? "" : "murmur3:",
+            pSum->abDigest[0], pSum->abDigest[1], pSum->abDigest[2], pSum->abDigest[3],
+            pSum->abDigest[4], pSum->abDigest[5], pSum->abDigest[6], pSum->abDigest[7],
+            pSum->abDigest[8], pSum->abDigest[9], pSum->abDigest[10], pSum->abDigest[11],
+            pSum->abDigest[12], pSum->abDigest[13], pSum->abDigest[14], pSum->abDigest[15]);
 }
 
 
@@ -2008,13 +2068,14 @@ static void kOCSumFPrintf(PCKOCSUM pSum, FILE *pFile)
 static void kOCSumInfo(PCKOCSUM pSum, unsigned uLevel, const char *pszMsg)
 {
     InfoMsg(uLevel,
-            "%s: crc32=%#010x md5=%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x\n",
+            "%s: crc32=%#010x %s=%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x\n",
             pszMsg,
             pSum->crc32,
-            pSum->md5[0], pSum->md5[1], pSum->md5[2], pSum->md5[3],
-            pSum->md5[4], pSum->md5[5], pSum->md5[6], pSum->md5[7],
-            pSum->md5[8], pSum->md5[9], pSum->md5[10], pSum->md5[11],
-            pSum->md5[12], pSum->md5[13], pSum->md5[14], pSum->md5[15]);
+            pSum->enmType == kOCSumType_MD5 ? "md5" : "murmur3",
+            pSum->abDigest[0], pSum->abDigest[1], pSum->abDigest[2], pSum->abDigest[3],
+            pSum->abDigest[4], pSum->abDigest[5], pSum->abDigest[6], pSum->abDigest[7],
+            pSum->abDigest[8], pSum->abDigest[9], pSum->abDigest[10], pSum->abDigest[11],
+            pSum->abDigest[12], pSum->abDigest[13], pSum->abDigest[14], pSum->abDigest[15]);
 }
 
 
@@ -2034,7 +2095,9 @@ static int kOCSumIsEqual(PCKOCSUM pSum1, PCKOCSUM pSum2)
         return 0;
     if (pSum1->crc32 != pSum2->crc32)
         return 0;
-    if (memcmp(&pSum1->md5[0], &pSum2->md5[0], sizeof(pSum1->md5)))
+    if (pSum1->enmType != pSum2->enmType)
+        return 0;
+    if (memcmp(&pSum1->abDigest[0], &pSum2->abDigest[0], sizeof(pSum1->abDigest)))
         return 0;
     return 1;
 }
@@ -2058,7 +2121,9 @@ static int kOCSumHasEqualInChain(PCKOCSUM pSumHead, PCKOCSUM pSum)
             return 1;
         if (pSumHead->crc32 != pSum->crc32)
             continue;
-        if (memcmp(&pSumHead->md5[0], &pSum->md5[0], sizeof(pSumHead->md5)))
+        if (pSumHead->enmType != pSum->enmType)
+            continue;
+        if (memcmp(&pSumHead->abDigest[0], &pSum->abDigest[0], sizeof(pSumHead->abDigest)))
             continue;
         return 1;
     }
@@ -2302,7 +2367,8 @@ static void kOCEntryRead(PKOCENTRY pEntry)
          */
         if (    !fgets(g_szLine, sizeof(g_szLine), pFile)
             ||  (   strcmp(g_szLine, "magic=kObjCacheEntry-v0.1.0\n")
-                 && strcmp(g_szLine, "magic=kObjCacheEntry-v0.1.1\n"))
+                 && strcmp(g_szLine, "magic=kObjCacheEntry-v0.1.1\n")
+                 && strcmp(g_szLine, "magic=kObjCacheEntry-v0.1.2\n"))
            )
         {
             InfoMsg(2, "bad cache file (magic)\n");
@@ -2514,7 +2580,7 @@ static void kOCEntryWrite(PKOCENTRY pEntry)
 #define CHECK_LEN(expr) \
         do { int cch = expr; if (cch >= KOBJCACHE_MAX_LINE_LEN) FatalDie("Line too long: %d (max %d)\nexpr: %s\n", cch, KOBJCACHE_MAX_LINE_LEN, #expr); } while (0)
 
-    fprintf(pFile, "magic=kObjCacheEntry-v0.1.1\n");
+    fprintf(pFile, "magic=kObjCacheEntry-v0.1.2\n");
     CHECK_LEN(fprintf(pFile, "target=%s\n",     pEntry->New.pszTarget ? pEntry->New.pszTarget : pEntry->Old.pszTarget));
     CHECK_LEN(fprintf(pFile, "key=%lu\n",       (unsigned long)pEntry->uKey));
     CHECK_LEN(fprintf(pFile, "obj=%s\n",        pEntry->New.pszObjName ? pEntry->New.pszObjName : pEntry->Old.pszObjName));
@@ -4324,7 +4390,8 @@ static void kObjCacheRead(PKOBJCACHE pCache)
      * Read magic and generation.
      */
     if (    !fgets(g_szLine, sizeof(g_szLine), pCache->pFile)
-        ||  strcmp(g_szLine, "magic=kObjCache-v0.1.0\n"))
+        ||  (   strcmp(g_szLine, "magic=kObjCache-v0.1.0\n")
+             && strcmp(g_szLine, "magic=kObjCache-v0.1.1\n")))
     {
         InfoMsg(2, "bad cache file (magic)\n");
         fBad = 1;
@@ -4533,7 +4600,7 @@ static void kObjCacheWrite(PKOBJCACHE pCache)
      */
     pCache->uGeneration++;
     fprintf(pCache->pFile,
-            "magic=kObjCache-v0.1.0\n"
+            "magic=kObjCache-v0.1.1\n"
             "generation=%d\n"
             "digests=%d\n",
             pCache->uGeneration,
@@ -4900,6 +4967,429 @@ static int kObjCacheIsNew(PKOBJCACHE pCache)
 }
 
 
+/**
+ * Content addressed object store.
+ *
+ * This is an alternative to the central cache file which doesn't require any
+ * locking.  Objects are stored in files named after a digest of the target,
+ * the compiler arguments and the preprocessor output, spread over 256 shard
+ * directories.  Objects are inserted by creating a temporary file in the
+ * shard directory and renaming it into place, and the store size is kept
+ * below the configured limit by evicting the least recently used objects of
+ * the shard that was inserted into.
+ */
+typedef struct KOCSTORE
+{
+    /** The absolute path to the store directory. */
+    char *pszDir;
+    /** The max size of the store in bytes, 0 if unlimited. */
+    uint64_t cbMax;
+} KOCSTORE;
+/** Pointer to an object store. */
+typedef KOCSTORE *PKOCSTORE;
+
+
+/**
+ * Store file record used when trimming a shard.
+ */
+typedef struct KOCSTOREFILE
+{
+    /** The path to the file. */
+    char *pszPath;
+    /** The last time it was used (mtime). */
+    time_t uLastUsed;
+    /** The file size. */
+    uint64_t cb;
+} KOCSTOREFILE;
+/** Pointer to a store file record. */
+typedef KOCSTOREFILE *PKOCSTOREFILE;
+
+
+/**
+ * Creates an object store instance.
+ *
+ * This doesn't touch the file system, the shard directories are created on
+ * demand.
+ *
+ * @returns Pointer to the store.
+ * @param   pszDir      The store directory.
+ * @param   cbMax       The max store size in bytes, 0 if unlimited.
+ */
+static PKOCSTORE kOCStoreCreate(const char *pszDir, uint64_t cbMax)
+{
+    PKOCSTORE pStore = xmallocz(sizeof(*pStore));
+    pStore->pszDir = AbsPath(pszDir);
+#if defined(__OS2__) || defined(__WIN__)
+    if (!IS_SLASH(pStore->pszDir[0]) && !(pStore->pszDir[0] && pStore->pszDir[1] == ':'))
+#else
+    if (!IS_SLASH(pStore->pszDir[0]))
+#endif
+    {
+        /* AbsPath fails on paths that doesn't exist yet. */
+        char szCwd[PATH_MAX];
+        if (!getcwd(szCwd, sizeof(szCwd)))
+            FatalDie("getcwd failed: %s\n", strerror(errno));
+        free(pStore->pszDir);
+        pStore->pszDir = MakePathFromDirAndFile(pszDir, szCwd);
+    }
+    pStore->cbMax = cbMax;
+    return pStore;
+}
+
+
+/**
+ * Destroys an object store instance.
+ *
+ * @param   pStore      The store.
+ */
+static void kOCStoreDestroy(PKOCSTORE pStore)
+{
+    free(pStore->pszDir);
+    free(pStore);
+}
+
+
+/**
+ * Formats a checksum into a buffer, the same way kOCSumFPrintf does.
+ *
+ * @returns Number of chars written.
+ * @param   pSum        The checksum.
+ * @param   pszBuf      The output buffer, at least 56 chars.
+ */
+static int kOCStoreFmtSum(PCKOCSUM pSum, char *pszBuf)
+{
+    int off = sprintf(pszBuf, "%#x:%s", pSum->crc32, pSum->enmType == kOCSumType_MD5 ? "" : "murmur3:");
+    unsigned i;
+    for (i = 0; i < sizeof(pSum->abDigest); i++)
+        off += sprintf(&pszBuf[off], "%02x", pSum->abDigest[i]);
+    return off;
+}
+
+
+/**
+ * Calculates the store key (object file name) for an entry.
+ *
+ * The key covers the target, the compiler argument vector and the current
+ * preprocessor output.
+ *
+ * @param   pEntry      The entry, with New.SumHead and New.SumCompArgv set.
+ * @param   pszKey      Where to return the key, at least 33 chars.
+ */
+static void kOCStoreCalcKey(PCKOCENTRY pEntry, char *pszKey)
+{
+    const char *pszTarget = pEntry->New.pszTarget ? pEntry->New.pszTarget : pEntry->Old.pszTarget;
+    char        szSum[64];
+    KOCSUMCTX   Ctx;
+    KOCSUM      Sum;
+    unsigned    i;
+
+    assert(!kOCSumIsEmpty(&pEntry->New.SumHead));
+    assert(!kOCSumIsEmpty(&pEntry->New.SumCompArgv));
+
+    kOCSumInitWithCtx(&Sum, &Ctx);
+    kOCSumUpdate(&Sum, &Ctx, pszTarget, strlen(pszTarget) + 1);
+    kOCSumUpdate(&Sum, &Ctx, szSum, kOCStoreFmtSum(&pEntry->New.SumCompArgv, szSum) + 1);
+    kOCSumUpdate(&Sum, &Ctx, szSum, kOCStoreFmtSum(&pEntry->New.SumHead, szSum) + 1);
+    kOCSumFinalize(&Sum, &Ctx);
+
+    for (i = 0; i < sizeof(Sum.abDigest); i++)
+        sprintf(&pszKey[i * 2], "%02x", Sum.abDigest[i]);
+}
+
+
+/**
+ * Makes the path to a file in the store.
+ *
+ * @returns Heap string (free it).
+ * @param   pStore      The store.
+ * @param   pszKey      The store key.
+ * @param   pszSuffix   The file name suffix.
+ * @param   ppszShard   Where to return the shard directory path (heap, free
+ *                      it). Optional.
+ */
+static char *kOCStoreMakePath(PKOCSTORE pStore, const char *pszKey, const char *pszSuffix, char **ppszShard)
+{
+    char    szShard[3];
+    char    szName[128];
+    char   *pszShardDir;
+    char   *pszPath;
+
+    szShard[0] = pszKey[0];
+    szShard[1] = pszKey[1];
+    szShard[2] = '\0';
+    sprintf(szName, "%s%s", &pszKey[2], pszSuffix);
+
+    pszShardDir = MakePathFromDirAndFile(szShard, pStore->pszDir);
+    pszPath = MakePathFromDirAndFile(szName, pszShardDir);
+    if (ppszShard)
+        *ppszShard = pszShardDir;
+    else
+        free(pszShardDir);
+    return pszPath;
+}
+
+
+/**
+ * Copies a file, failing quietly.
+ *
+ * @returns 0 on success, -1 and errno on failure.  The destination is
+ *          removed on failure.
+ * @param   pszDst      The destination file (created or truncated).
+ * @param   pszSrc      The source file.
+ */
+static int kOCStoreCopyFile(const char *pszDst, const char *pszSrc)
+{
+    char   *pszBuf;
+    int     iErr = 0;
+    int     fdSrc;
+    int     fdDst;
+
+    fdSrc = open(pszSrc, O_RDONLY | O_BINARY);
+    if (fdSrc == -1)
+        return -1;
+    fdDst = open(pszDst, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (fdDst == -1)
+    {
+        iErr = errno;
+        close(fdSrc);
+        errno = iErr;
+        return -1;
+    }
+
+    pszBuf = xmalloc(256 * 1024);
+    for (;;)
+    {
+        char *psz;
+        long cbRead = read(fdSrc, pszBuf, 256*1024);
+        if (cbRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            iErr = errno;
+            break;
+        }
+        if (!cbRead)
+            break; /* eof */
+
+        psz = pszBuf;
+        do
+        {
+            long cbWritten = write(fdDst, psz, cbRead);
+            if (cbWritten < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                iErr = errno;
+                break;
+            }
+            psz += cbWritten;
+            cbRead -= cbWritten;
+        } while (cbRead > 0);
+        if (iErr)
+            break;
+    }
+    free(pszBuf);
+    close(fdSrc);
+    if (close(fdDst) != 0 && !iErr)
+        iErr = errno;
+    if (iErr)
+    {
+        unlink(pszDst);
+        errno = iErr;
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * qsort callback that sorts store files by last use, oldest first.
+ */
+static int kOCStoreCompareFiles(const void *pv1, const void *pv2)
+{
+    const KOCSTOREFILE *p1 = (const KOCSTOREFILE *)pv1;
+    const KOCSTOREFILE *p2 = (const KOCSTOREFILE *)pv2;
+    return p1->uLastUsed < p2->uLastUsed ? -1 : p1->uLastUsed > p2->uLastUsed ? 1 : 0;
+}
+
+
+/**
+ * Evicts the least recently used objects from a shard directory until it's
+ * below its share of the store size limit.
+ *
+ * This also removes temporary files left behind by crashed insertions.
+ * Several instances may trim the same shard concurrently, that's harmless.
+ *
+ * @param   pStore      The store.
+ * @param   pszShardDir The shard directory.
+ */
+static void kOCStoreTrimShard(PKOCSTORE pStore, const char *pszShardDir)
+{
+    uint64_t        cbShardMax = pStore->cbMax / KOCSTORE_SHARDS;
+    uint64_t        cbTotal = 0;
+    PKOCSTOREFILE   paFiles = NULL;
+    unsigned        cFiles = 0;
+    unsigned        i;
+    time_t          uNow = time(NULL);
+    struct dirent  *pEnt;
+    DIR            *pDir;
+
+    pDir = opendir(pszShardDir);
+    if (!pDir)
+        return;
+    while ((pEnt = readdir(pDir)) != NULL)
+    {
+        struct stat st;
+        char       *pszPath;
+        if (pEnt->d_name[0] == '.')
+            continue;
+        pszPath = MakePathFromDirAndFile(pEnt->d_name, pszShardDir);
+        if (    stat(pszPath, &st) != 0
+#ifdef S_ISREG
+            ||  !S_ISREG(st.st_mode)
+#else
+            ||  (st.st_mode & _S_IFMT) != _S_IFREG
+#endif
+           )
+        {
+            free(pszPath);
+            continue;
+        }
+
+        if (strstr(pEnt->d_name, ".tmp"))
+        {
+            if (uNow - st.st_mtime > KOCSTORE_TMP_MAX_AGE)
+            {
+                InfoMsg(3, "store: removing stale '%s'\n", pszPath);
+                unlink(pszPath);
+            }
+            free(pszPath);
+            continue;
+        }
+
+        if (!(cFiles % 64))
+            paFiles = xrealloc(paFiles, (cFiles + 64) * sizeof(paFiles[0]));
+        paFiles[cFiles].pszPath = pszPath;
+        paFiles[cFiles].uLastUsed = st.st_mtime;
+        paFiles[cFiles].cb = st.st_size;
+        cbTotal += st.st_size;
+        cFiles++;
+    }
+    closedir(pDir);
+
+    if (cbTotal > cbShardMax)
+    {
+        uint64_t cbTarget = cbShardMax / 10 * 9;
+        qsort(paFiles, cFiles, sizeof(paFiles[0]), kOCStoreCompareFiles);
+        for (i = 0; i < cFiles && cbTotal > cbTarget; i++)
+            if (unlink(paFiles[i].pszPath) == 0 || errno == ENOENT)
+            {
+                InfoMsg(3, "store: evicted '%s'\n", paFiles[i].pszPath);
+                cbTotal -= paFiles[i].cb;
+            }
+    }
+
+    for (i = 0; i < cFiles; i++)
+        free(paFiles[i].pszPath);
+    free(paFiles);
+}
+
+
+/**
+ * Looks up the entry's object in the store and copies it to the object file
+ * if found.
+ *
+ * @returns 1 if found and copied, 0 if not.
+ * @param   pStore      The store.
+ * @param   pEntry      The entry.
+ */
+static int kOCStoreLookup(PKOCSTORE pStore, PKOCENTRY pEntry)
+{
+    char    szKey[40];
+    char   *pszPath;
+    char   *pszDst;
+    int     fFound = 0;
+
+    kOCStoreCalcKey(pEntry, szKey);
+    pszPath = kOCStoreMakePath(pStore, szKey, ".o", NULL);
+
+    /* Mark it as recently used.  This also gives a hardlinked object a
+       fresh timestamp.  It fails if the object isn't in the store. */
+    if (utime(pszPath, NULL) == 0)
+    {
+        pszDst = MakePathFromDirAndFile(pEntry->New.pszObjName, pEntry->pszDir);
+        unlink(pszDst);
+        if (    kOCEntryTryHardlink(pszDst, pszPath)
+            ||  kOCStoreCopyFile(pszDst, pszPath) == 0)
+        {
+            InfoMsg(1, "using store object '%s'\n", pszPath);
+            fFound = 1;
+        }
+        else
+            InfoMsg(2, "store: failed to copy '%s': %s\n", pszPath, strerror(errno));
+        free(pszDst);
+    }
+    else
+        InfoMsg(2, "store: no object '%s'\n", pszPath);
+
+    free(pszPath);
+    return fFound;
+}
+
+
+/**
+ * Inserts the entry's object into the store.
+ *
+ * Failures are not fatal, they just means the object won't be found the next
+ * time around.
+ *
+ * @param   pStore      The store.
+ * @param   pEntry      The entry (compiled).
+ */
+static void kOCStoreInsert(PKOCSTORE pStore, PKOCENTRY pEntry)
+{
+    char    szKey[40];
+    char    szSuffix[48];
+    char   *pszShardDir;
+    char   *pszPath;
+    char   *pszTmp;
+    char   *pszObj;
+
+    kOCStoreCalcKey(pEntry, szKey);
+    sprintf(szSuffix, ".%ld.tmp", (long)getpid());
+    pszTmp = kOCStoreMakePath(pStore, szKey, szSuffix, &pszShardDir);
+    pszPath = kOCStoreMakePath(pStore, szKey, ".o", NULL);
+    pszObj = MakePathFromDirAndFile(pEntry->New.pszObjName, pEntry->pszDir);
+
+    /* The compiler always writes a new object file (kOCEntryCompileIt
+       deletes the old one), so it's safe to share it via a hardlink. */
+    unlink(pszTmp);
+    if (    !kOCEntryTryHardlink(pszTmp, pszObj)
+        &&  kOCStoreCopyFile(pszTmp, pszObj) != 0
+        &&  (   MakePath(pszShardDir) != 0
+             || (   !kOCEntryTryHardlink(pszTmp, pszObj)
+                 && kOCStoreCopyFile(pszTmp, pszObj) != 0)))
+        InfoMsg(1, "store: failed to create '%s': %s\n", pszTmp, strerror(errno));
+    else if (rename(pszTmp, pszPath) != 0)
+    {
+        /* Windows won't replace an existing file, somebody beat us to it. */
+        InfoMsg(2, "store: failed to rename '%s' to '%s': %s\n", pszTmp, pszPath, strerror(errno));
+        unlink(pszTmp);
+    }
+    else
+    {
+        InfoMsg(2, "store: inserted '%s'\n", pszPath);
+        if (pStore->cbMax)
+            kOCStoreTrimShard(pStore, pszShardDir);
+    }
+
+    free(pszObj);
+    free(pszPath);
+    free(pszTmp);
+    free(pszShardDir);
+}
+
+
 /**
  * Prints a syntax error and returns the appropriate exit code
  *
@@ -4931,6 +5421,8 @@ static int usage(FILE *pOut)
             "            <-f|--file <local-cache-file>>\n"
             "            <-t|--target <target-name>>\n"
             "            [-r|--redir-stdout] [-p|--passthru] [--named-pipe-compile <pipename>]\n"
+            "            [-s|--store-dir <store-dir> [--store-max-size <MB>]]\n"
+            "            [--digest <md5|murmur3>]\n"
             "            --kObjCache-cpp <filename> <preprocessor + args>\n"
             "            --kObjCache-cc <object> <compiler + args>\n"
             "            [--kObjCache-both [args]]\n"
@@ -4941,6 +5433,12 @@ static int usage(FILE *pOut)
             "        kObjCache [-?|/?|-h|/h|--help|/help]\n"
             "\n"
             "The env.var. KOBJCACHE_DIR sets the default cache diretory (-d).\n"
+            "The env.var. KOBJCACHE_STORE_DIR sets the default object store directory (-s)\n"
+            "and KOBJCACHE_STORE_MAX_SIZE its default max size in megabytes.  The object\n"
+            "store replaces the cache file (-c, -n, -d) and requires no locking.\n"
+            "The --digest option picks the checksum algorithm for the preprocessor output\n"
+            "and compiler arguments; murmur3 (default) is a lot faster than md5.  Entries\n"
+            "made with the other algorithm are recompiled once.\n"
             "The env.var. KOBJCACHE_OPTS allow you to specifie additional options\n"
             "without having to mess with the makefiles. These are appended with "
             "a --kObjCache-options between them and the command args.\n"
@@ -4951,13 +5449,16 @@ static int usage(FILE *pOut)
 
 int main(int argc, char **argv)
 {
-    PKOBJCACHE pCache;
+    PKOBJCACHE pCache = NULL;
     PKOCENTRY pEntry;
 
     const char *pszCacheDir = getenv("KOBJCACHE_DIR");
     const char *pszCacheName = NULL;
     const char *pszCacheFile = NULL;
     const char *pszEntryFile = NULL;
+    const char *pszStoreDir = getenv("KOBJCACHE_STORE_DIR");
+    const char *pszStoreMaxSize = getenv("KOBJCACHE_STORE_MAX_SIZE");
+    PKOCSTORE pStore = NULL;
 
     const char **papszArgvPreComp = NULL;
     unsigned cArgvPreComp = 0;
@@ -5067,12 +5568,36 @@ int main(int argc, char **argv)
                 return SyntaxError("%s requires a cache directory!\n", argv[i]);
             pszCacheDir = argv[++i];
         }
+        else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--store-dir"))
+        {
+            if (i + 1 >= argc)
+                return SyntaxError("%s requires a store directory!\n", argv[i]);
+            pszStoreDir = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--store-max-size"))
+        {
+            if (i + 1 >= argc)
+                return SyntaxError("%s requires a size in megabytes!\n", argv[i]);
+            pszStoreMaxSize = argv[++i];
+        }
         else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--target"))
         {
             if (i + 1 >= argc)
                 return SyntaxError("%s requires a target platform/arch name!\n", argv[i]);
             pszTarget = argv[++i];
         }
+        else if (!strcmp(argv[i], "--digest"))
+        {
+            if (i + 1 >= argc)
+                return SyntaxError("%s requires a digest name!\n", argv[i]);
+            if (!strcmp(argv[i + 1], "md5"))
+                g_enmSumType = kOCSumType_MD5;
+            else if (!strcmp(argv[i + 1], "murmur3"))
+                g_enmSumType = kOCSumType_MurmurHash3;
+            else
+                return SyntaxError("Unknown digest '%s', expected 'md5' or 'murmur3'!\n", argv[i + 1]);
+            i++;
+        }
         else if (!strcmp(argv[i], "--named-pipe-compile"))
         {
             if (i + 1 >= argc)
@@ -5129,11 +5654,26 @@ int main(int argc, char **argv)
     if (!cArgvPreComp)
         return SyntaxError("No preprocessor arguments (--kObjCache-cc)!\n");
 
+    if (pszStoreDir && *pszStoreDir)
+    {
+        uint64_t cbMax = 0;
+        if (pszStoreMaxSize && *pszStoreMaxSize)
+        {
+            char *pszEnd;
+            cbMax = (uint64_t)strtoul(pszStoreMaxSize, &pszEnd, 0) * 1024 * 1024;
+            if (*pszEnd)
+                return SyntaxError("Bad store size '%s', expected megabytes!\n", pszStoreMaxSize);
+        }
+        pStore = kOCStoreCreate(pszStoreDir, cbMax);
+    }
+
     /*
      * Calc the cache file name.
      * It's a bit messy since the extension has to be replaced.
      */
-    if (!pszCacheFile)
+    if (pStore)
+        SetErrorPrefix("kObjCache - %s", FindFilenameInPath(pszEntryFile));
+    else if (!pszCacheFile)
     {
         if (!pszCacheDir)
             return SyntaxError("No cache dir (-d / KOBJCACHE_DIR) and no cache filename!\n");
@@ -5159,8 +5699,11 @@ int main(int argc, char **argv)
      * so it's perfectly fine to read it here before we lock it. This simplifies
      * the detection of object name and compiler argument changes.
      */
-    SetErrorPrefix("kObjCache - %s", FindFilenameInPath(pszCacheFile));
-    pCache = kObjCacheCreate(pszCacheFile);
+    if (!pStore)
+    {
+        SetErrorPrefix("kObjCache - %s", FindFilenameInPath(pszCacheFile));
+        pCache = kObjCacheCreate(pszCacheFile);
+    }
 
     pEntry = kOCEntryCreate(pszEntryFile);
     kOCEntryRead(pEntry);
@@ -5172,6 +5715,30 @@ int main(int argc, char **argv)
     kOCEntrySetDepFilename(pEntry, pszMakeDepFilename, fMakeDepFixCase, fMakeDepQuiet, fMakeDepGenStubs);
     kOCEntrySetOptimizations(pEntry, fOptimizePreprocessorOutput);
 
+    /*
+     * With an object store we always preprocess first so we can look up the
+     * object before compiling.  No locking is required.
+     */
+    if (pStore)
+    {
+        kOCEntryPreProcess(pEntry, papszArgvPreComp, cArgvPreComp);
+        kOCEntryCalcRecompile(pEntry);
+        if (kOCEntryNeedsCompiling(pEntry))
+        {
+            if (!kOCStoreLookup(pStore, pEntry))
+            {
+                InfoMsg(1, "recompiling\n");
+                kOCEntryCompileIt(pEntry);
+                kOCStoreInsert(pStore, pEntry);
+            }
+        }
+        else
+            InfoMsg(1, "no need to recompile\n");
+        kOCEntryWrite(pEntry);
+        kOCStoreDestroy(pStore);
+        return 0;
+    }
+
     /*
      * Open (& lock) the two files and do validity checks and such.
      */
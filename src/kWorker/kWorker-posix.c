@@ -0,0 +1,1411 @@
+/* $Id$ */
+/** @file
+ * kWorker - job worker for POSIX hosts.
+ *
+ * Unlike the Windows worker, this cannot load the tools into its own address
+ * space.  Instead, where possible, each tool is started once as a zygote with
+ * kWorkerZygote.so preloaded (see kWorkerZygote.c), which stops the tool right
+ * before its main and forks a child calling main for every job we pass it.
+ * So the exec and dynamic linking cost is paid once per tool and worker.
+ * Tools that cannot be run that way (scripts, static or set-uid executables,
+ * relative paths, a different LD_* environment than the zygote was started
+ * with) are forked and exec'ed for each job.  Setting KWORKER_NO_ZYGOTE in
+ * the worker environment disables the zygotes altogether.
+ *
+ * The worker also saves kmk forking its own big image (and a shell) per job,
+ * the PATH search for the tool, and spawning a separate process for the post
+ * command (kDepObj), which runs in-process.
+ *
+ * When kmk synchronizes output, the job's standard output and error
+ * descriptors are passed along with the JOB message and the job writes to
+ * those, so the output ends up in the kmk child's buffers.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "kbuild_version.h"
+#include "../kmk/kmkbuiltin.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Number of buckets in the tool lookup hash table. */
+#define KW_TOOL_HASH_SIZE   61
+
+/** The ERROR_CODE exit code kmk uses for failed execs. */
+#define KW_EXEC_FAILED      127
+
+/** Restart when the lowest free descriptor reaches this, something leaks. */
+#define KW_FD_LEAK_RESTART  512
+
+#ifdef KWORKER_WITH_ZYGOTES
+/** The max number of live tool zygotes. */
+# define KW_MAX_ZYGOTES     16
+/** The greeting of a zygote, see kWorkerZygote.c. */
+# define KW_ZYGOTE_MAGIC    UINT32_C(0x315a574b)
+#endif
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Cached executable lookup.
+ */
+typedef struct KWTOOL
+{
+    /** Next tool in the hash bucket. */
+    struct KWTOOL  *pNext;
+    /** The hash of the name + PATH. */
+    unsigned        uHash;
+    /** Length of the name as given by kSubmit. */
+    size_t          cchName;
+    /** The PATH value used for the lookup (copy, points into szName). */
+    const char     *pszSearchPath;
+    /** The resolved path of the executable (points into szName). */
+    const char     *pszPath;
+    /** The name as given by kSubmit followed by the other strings. */
+    char            szName[1];
+} KWTOOL;
+typedef KWTOOL *PKWTOOL;
+
+#ifdef KWORKER_WITH_ZYGOTES
+/**
+ * A tool zygote, or a tool that cannot be run by one.
+ */
+typedef struct KWZYGOTE
+{
+    /** Next zygote. */
+    struct KWZYGOTE *pNext;
+    /** The zygote process, -1 if the tool cannot be run by a zygote. */
+    pid_t           pid;
+    /** Our end of the connection, -1 if no zygote. */
+    int             fdSocket;
+    /** Identity of the executable when the zygote was started. */
+    dev_t           idDev;
+    ino_t           idIno;
+    off_t           cbFile;
+    time_t          tsMTime;
+    /** The LD_* variables the zygote was started with, newline separated. */
+    char           *pszLdEnv;
+    /** g_cJobs when last used. */
+    unsigned        uLastUsed;
+    /** The executable path. */
+    char            szPath[1];
+} KWZYGOTE;
+typedef KWZYGOTE *PKWZYGOTE;
+#endif
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Set when we need to restart (tell kSubmit we're exiting). */
+static int          g_fRestart = 0;
+/** File descriptor for /dev/null, used as the stdin of jobs. */
+static int          g_fdDevNull = -1;
+/** The current directory of the worker process (the last job's). */
+static char        *g_pszCwd = NULL;
+/** Standard output and error descriptors received with the current job
+ * message, -1 if none. */
+static int          g_afdJobOutput[2] = { -1, -1 };
+
+/** The tool lookup hash table. */
+static PKWTOOL      g_apToolHash[KW_TOOL_HASH_SIZE];
+
+#ifdef KWORKER_WITH_ZYGOTES
+/** Path to kWorkerZygote.so, NULL if zygotes are disabled or unavailable. */
+static char        *g_pszZygoteLib = NULL;
+/** The zygotes. */
+static PKWZYGOTE    g_pZygoteHead = NULL;
+/** Number of live zygotes. */
+static unsigned     g_cZygotes = 0;
+#endif
+
+/** @name Statistics.
+ * @{ */
+static unsigned     g_cJobs = 0;
+static unsigned     g_cToolHits = 0;
+static unsigned     g_cToolMisses = 0;
+static unsigned     g_cChDirs = 0;
+static unsigned     g_cPostCmds = 0;
+#ifdef KWORKER_WITH_ZYGOTES
+static unsigned     g_cZygoteJobs = 0;
+static unsigned     g_cZygotesStarted = 0;
+static unsigned     g_cZygoteMisfits = 0;
+#endif
+/** @} */
+
+
+/**
+ * Error printing.
+ * @param   pszFormat           Message format string.
+ * @param   va                  Format arguments.
+ */
+static void kwErrPrintfV(const char *pszFormat, va_list va)
+{
+    fflush(stdout);
+    fputs("kWorker: error: ", stderr);
+    vfprintf(stderr, pszFormat, va);
+    fflush(stderr);
+}
+
+
+/**
+ * Error printing.
+ * @param   pszFormat           Message format string.
+ * @param   ...                 Format argument.
+ */
+static void kwErrPrintf(const char *pszFormat, ...)
+{
+    va_list va;
+    va_start(va, pszFormat);
+    kwErrPrintfV(pszFormat, va);
+    va_end(va);
+}
+
+
+/**
+ * Error printing.
+ * @return  rc;
+ * @param   rc                  Return value
+ * @param   pszFormat           Message format string.
+ * @param   ...                 Format argument.
+ */
+static int kwErrPrintfRc(int rc, const char *pszFormat, ...)
+{
+    va_list va;
+    va_start(va, pszFormat);
+    kwErrPrintfV(pszFormat, va);
+    va_end(va);
+    return rc;
+}
+
+
+/**
+ * Checks if the given path exists (file system cache hook for kDep.c).
+ *
+ * @returns 1 if it exists, 0 if not.
+ * @param   pszPath             The path to check.
+ */
+int kwFsPathExists(const char *pszPath)
+{
+    struct stat St;
+    return stat(pszPath, &St) == 0;
+}
+
+
+/**
+ * Looks up a variable in the job environment.
+ *
+ * @returns Pointer to the value, NULL if not found.
+ * @param   papszEnvVars        The job environment.
+ * @param   pszVar              The variable name.
+ */
+static const char *kwEnvGet(const char **papszEnvVars, const char *pszVar)
+{
+    size_t const cchVar = strlen(pszVar);
+    for (; *papszEnvVars; papszEnvVars++)
+        if (   strncmp(*papszEnvVars, pszVar, cchVar) == 0
+            && (*papszEnvVars)[cchVar] == '=')
+            return &(*papszEnvVars)[cchVar + 1];
+    return NULL;
+}
+
+
+/**
+ * Checks if @a pszPath is an executable regular file.
+ */
+static int kwToolIsExecutable(const char *pszPath)
+{
+    struct stat St;
+    return stat(pszPath, &St) == 0
+        && S_ISREG(St.st_mode)
+        && access(pszPath, X_OK) == 0;
+}
+
+
+/**
+ * Searches the PATH for @a pszName.
+ *
+ * @returns Pointer to a heap copy of the full path, NULL if not found.
+ * @param   pszName             The executable name (no slashes).
+ * @param   pszSearchPath       The PATH value.
+ */
+static char *kwToolSearchPath(const char *pszName, const char *pszSearchPath)
+{
+    size_t const cchName = strlen(pszName);
+    char        *pszBuf  = (char *)malloc(strlen(pszSearchPath) + 1 + cchName + 1);
+    if (!pszBuf)
+        return NULL;
+    for (;;)
+    {
+        const char *pszEnd = strchr(pszSearchPath, ':');
+        size_t      cchDir = pszEnd ? (size_t)(pszEnd - pszSearchPath) : strlen(pszSearchPath);
+        if (cchDir == 0)
+            memcpy(pszBuf, pszName, cchName + 1); /* empty entry means the current directory */
+        else
+        {
+            memcpy(pszBuf, pszSearchPath, cchDir);
+            pszBuf[cchDir] = '/';
+            memcpy(&pszBuf[cchDir + 1], pszName, cchName + 1);
+        }
+        if (kwToolIsExecutable(pszBuf))
+            return pszBuf;
+        if (!pszEnd)
+            break;
+        pszSearchPath = pszEnd + 1;
+    }
+    free(pszBuf);
+    return NULL;
+}
+
+
+/**
+ * Resolves the executable of a job, caching PATH searches.
+ *
+ * Names containing a slash are used as-is (relative to the job's current
+ * directory) since there is nothing to gain from caching them.
+ *
+ * @returns Pointer to the executable path, NULL if not found.
+ * @param   pszName             The executable name given by kSubmit.
+ * @param   papszEnvVars        The job environment.
+ */
+static const char *kwToolLookup(const char *pszName, const char **papszEnvVars)
+{
+    const char     *pszSearchPath;
+    size_t          cchName;
+    size_t          cchSearchPath;
+    unsigned        uHash;
+    size_t          cchPath;
+    const char     *pch;
+    PKWTOOL         pTool;
+    PKWTOOL        *ppTool;
+    char           *pszPath;
+
+    if (strchr(pszName, '/'))
+        return pszName;
+
+    pszSearchPath = kwEnvGet(papszEnvVars, "PATH");
+    if (!pszSearchPath)
+        pszSearchPath = "/bin:/usr/bin";
+
+    /* Hash the name and the search path (sdbm). */
+    uHash = 0;
+    for (pch = pszName; *pch; pch++)
+        uHash = (unsigned char)*pch + (uHash << 6) + (uHash << 16) - uHash;
+    cchName = pch - pszName;
+    for (pch = pszSearchPath; *pch; pch++)
+        uHash = (unsigned char)*pch + (uHash << 6) + (uHash << 16) - uHash;
+    cchSearchPath = pch - pszSearchPath;
+
+    /* Look it up, dropping the entry if the cached path went stale. */
+    for (ppTool = &g_apToolHash[uHash % KW_TOOL_HASH_SIZE]; (pTool = *ppTool) != NULL; ppTool = &pTool->pNext)
+        if (   pTool->uHash == uHash
+            && pTool->cchName == cchName
+            && memcmp(pTool->szName, pszName, cchName) == 0
+            && strcmp(pTool->pszSearchPath, pszSearchPath) == 0)
+        {
+            if (access(pTool->pszPath, X_OK) == 0)
+            {
+                g_cToolHits++;
+                return pTool->pszPath;
+            }
+            *ppTool = pTool->pNext;
+            free(pTool);
+            break;
+        }
+
+    /* Search the path and add a cache entry. */
+    g_cToolMisses++;
+    pszPath = kwToolSearchPath(pszName, pszSearchPath);
+    if (!pszPath)
+        return NULL;
+    cchPath = strlen(pszPath);
+    pTool = (PKWTOOL)malloc(sizeof(*pTool) + cchName + 1 + cchSearchPath + 1 + cchPath + 1);
+    if (!pTool)
+    {
+        free(pszPath);
+        return NULL;
+    }
+    pTool->uHash   = uHash;
+    pTool->cchName = cchName;
+    memcpy(pTool->szName, pszName, cchName + 1);
+    pTool->pszSearchPath = memcpy(&pTool->szName[cchName + 1], pszSearchPath, cchSearchPath + 1);
+    pTool->pszPath = memcpy(&pTool->szName[cchName + 1 + cchSearchPath + 1], pszPath, cchPath + 1);
+    pTool->pNext = g_apToolHash[uHash % KW_TOOL_HASH_SIZE];
+    g_apToolHash[uHash % KW_TOOL_HASH_SIZE] = pTool;
+    free(pszPath);
+    return pTool->pszPath;
+}
+
+
+/**
+ * Changes the current directory of the worker if necessary.
+ *
+ * @returns 0 on success, -1 on failure (error printed).
+ * @param   pszCwd              The job's current directory.
+ */
+static int kwChangeDir(const char *pszCwd)
+{
+    if (g_pszCwd && strcmp(g_pszCwd, pszCwd) == 0)
+        return 0;
+    free(g_pszCwd);
+    g_pszCwd = NULL;
+    if (chdir(pszCwd) == 0)
+    {
+        g_cChDirs++;
+        g_pszCwd = strdup(pszCwd);
+        return 0;
+    }
+    kwErrPrintf("chdir(%s) failed: %s\n", pszCwd, strerror(errno));
+    return -1;
+}
+
+
+/**
+ * Closes the output descriptors received with the job message, if any.
+ */
+static void kwJobOutputClose(void)
+{
+    if (g_afdJobOutput[1] != -1 && g_afdJobOutput[1] != g_afdJobOutput[0])
+        close(g_afdJobOutput[1]);
+    if (g_afdJobOutput[0] != -1)
+        close(g_afdJobOutput[0]);
+    g_afdJobOutput[0] = g_afdJobOutput[1] = -1;
+}
+
+
+/**
+ * Points our standard output and error at the descriptors received with the
+ * job message, so the job, the post command and our own complaints all end up
+ * in the output of the kmk child.
+ *
+ * @param   pafdSaved           Where to save the original descriptors for
+ *                              kwJobOutputRestore, -1 if not redirected.
+ */
+static void kwJobOutputRedirect(int *pafdSaved)
+{
+    pafdSaved[0] = pafdSaved[1] = -1;
+    if (g_afdJobOutput[0] != -1)
+    {
+        fflush(stdout);
+        fflush(stderr);
+        pafdSaved[0] = fcntl(1, F_DUPFD_CLOEXEC, 3);
+        pafdSaved[1] = fcntl(2, F_DUPFD_CLOEXEC, 3);
+        dup2(g_afdJobOutput[0], 1);
+        dup2(g_afdJobOutput[1] != -1 ? g_afdJobOutput[1] : g_afdJobOutput[0], 2);
+    }
+}
+
+
+/**
+ * Undoes kwJobOutputRedirect and closes the job output descriptors, so kmk
+ * sees end-of-file on its pipes once the job is done.
+ *
+ * @param   pafdSaved           The descriptors saved by kwJobOutputRedirect.
+ */
+static void kwJobOutputRestore(int *pafdSaved)
+{
+    fflush(stdout);
+    fflush(stderr);
+    if (pafdSaved[0] != -1)
+    {
+        dup2(pafdSaved[0], 1);
+        close(pafdSaved[0]);
+    }
+    if (pafdSaved[1] != -1)
+    {
+        dup2(pafdSaved[1], 2);
+        close(pafdSaved[1]);
+    }
+    kwJobOutputClose();
+}
+
+
+/**
+ * Converts a wait status to an exit code the way kmk would see it.
+ */
+static int kwWaitStatusToExitCode(int iStatus)
+{
+    if (WIFEXITED(iStatus))
+        return WEXITSTATUS(iStatus);
+    if (WIFSIGNALED(iStatus))
+        return 128 + WTERMSIG(iStatus);
+    return 42 + 3;
+}
+
+
+/**
+ * Waits for the given child process.
+ *
+ * @returns The exit code of the child.
+ * @param   pid                 The child process.
+ */
+static int kwWaitForChild(pid_t pid)
+{
+    int   iStatus;
+    pid_t pidWait;
+    do
+        pidWait = waitpid(pid, &iStatus, 0);
+    while (pidWait == -1 && errno == EINTR);
+    if (pidWait == pid)
+        return kwWaitStatusToExitCode(iStatus);
+    return kwErrPrintfRc(42 + 3, "waitpid(%ld) failed: %s\n", (long)pid, strerror(errno));
+}
+
+
+/**
+ * Forks and execs the job executable, waiting for it to complete.
+ *
+ * @returns The exit code of the job.
+ * @param   pszPath             The executable.
+ * @param   papszArgs           The argument vector.
+ * @param   papszEnvVars        The environment.
+ */
+static int kwExecJob(const char *pszPath, const char **papszArgs, const char **papszEnvVars)
+{
+    pid_t pid;
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid == 0)
+    {
+        /* The child: stdin is /dev/null, just like kmk gives jobs when running in parallel. */
+        signal(SIGPIPE, SIG_DFL);
+        if (g_fdDevNull != -1)
+            dup2(g_fdDevNull, 0);
+        execve(pszPath, (char **)papszArgs, (char **)papszEnvVars);
+        fprintf(stderr, "kWorker: error: execve(%s) failed: %s\n", pszPath, strerror(errno));
+        _exit(KW_EXEC_FAILED);
+    }
+    if (pid > 0)
+        return kwWaitForChild(pid);
+    return kwErrPrintfRc(42 + 4, "fork failed: %s\n", strerror(errno));
+}
+
+
+#ifdef KWORKER_WITH_ZYGOTES
+
+/**
+ * Locates kWorkerZygote.so next to our executable, unless disabled.
+ */
+static void kwZygoteInit(void)
+{
+    char    szPath[4096];
+    ssize_t cch;
+    char   *pszSlash;
+
+    if (getenv("KWORKER_NO_ZYGOTE") != NULL)
+        return;
+    cch = readlink("/proc/self/exe", szPath, sizeof(szPath) - sizeof("kWorkerZygote.so"));
+    if (cch <= 0 || cch >= (ssize_t)(sizeof(szPath) - sizeof("kWorkerZygote.so")))
+        return;
+    szPath[cch] = '\0';
+    pszSlash = strrchr(szPath, '/');
+    if (!pszSlash)
+        return;
+    memcpy(pszSlash + 1, "kWorkerZygote.so", sizeof("kWorkerZygote.so"));
+    if (access(szPath, R_OK) == 0)
+        g_pszZygoteLib = strdup(szPath);
+}
+
+
+/**
+ * Collects the LD_* variables of a job environment, which affect what the
+ * dynamic linker did in a zygote.
+ *
+ * @returns Heap string with the variables separated by newlines, NULL if out
+ *          of memory.
+ * @param   papszEnvVars        The job environment.
+ */
+static char *kwZygoteLdEnv(const char **papszEnvVars)
+{
+    size_t  cb = 1;
+    size_t  i;
+    char   *psz;
+    char   *pszDst;
+    for (i = 0; papszEnvVars[i]; i++)
+        if (strncmp(papszEnvVars[i], "LD_", 3) == 0)
+            cb += strlen(papszEnvVars[i]) + 1;
+    pszDst = psz = (char *)malloc(cb);
+    if (psz)
+    {
+        for (i = 0; papszEnvVars[i]; i++)
+            if (strncmp(papszEnvVars[i], "LD_", 3) == 0)
+            {
+                size_t cch = strlen(papszEnvVars[i]);
+                memcpy(pszDst, papszEnvVars[i], cch);
+                pszDst += cch;
+                *pszDst++ = '\n';
+            }
+        *pszDst = '\0';
+    }
+    return psz;
+}
+
+
+/**
+ * Reads exactly @a cbToRead bytes from a zygote.
+ *
+ * @returns 0 on success, -1 on end of file or error.
+ */
+static int kwZygoteRead(int fd, void *pvBuf, size_t cbToRead)
+{
+    char *pbBuf = (char *)pvBuf;
+    while (cbToRead > 0)
+    {
+        ssize_t cbActual = read(fd, pbBuf, cbToRead);
+        if (cbActual > 0)
+        {
+            pbBuf    += cbActual;
+            cbToRead -= cbActual;
+        }
+        else if (cbActual == 0 || errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Unlinks and frees a zygote entry, terminating the zygote if live.
+ *
+ * Closing the connection makes an idle zygote exit.
+ */
+static void kwZygoteDestroy(PKWZYGOTE pZygote)
+{
+    PKWZYGOTE *ppCur;
+    for (ppCur = &g_pZygoteHead; *ppCur; ppCur = &(*ppCur)->pNext)
+        if (*ppCur == pZygote)
+        {
+            *ppCur = pZygote->pNext;
+            break;
+        }
+    if (pZygote->pid != -1)
+    {
+        close(pZygote->fdSocket);
+        kwWaitForChild(pZygote->pid);
+        g_cZygotes--;
+    }
+    free(pZygote->pszLdEnv);
+    free(pZygote);
+}
+
+
+/**
+ * Checks if the file is an ELF executable, anything else (scripts) is run
+ * via execve.
+ */
+static int kwZygoteIsElf(const char *pszPath)
+{
+    char abHdr[4];
+    int  fOk = 0;
+    int  fd  = open(pszPath, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fOk = read(fd, abHdr, sizeof(abHdr)) == sizeof(abHdr)
+           && memcmp(abHdr, "\177ELF", 4) == 0;
+        close(fd);
+    }
+    return fOk;
+}
+
+
+/**
+ * Starts a zygote for the tool, running the job with it.
+ *
+ * @returns The exit code of the job, -1 if nothing was started and the caller
+ *          should exec the job the normal way.
+ * @param   pZygote             The new zygote entry, not linked.  Becomes a
+ *                              misfit entry if the tool doesn't pick up the
+ *                              zygote library.
+ * @param   papszArgs           The argument vector.
+ * @param   papszEnvVars        The environment.
+ */
+static int kwZygoteStart(PKWZYGOTE pZygote, const char **papszArgs, const char **papszEnvVars)
+{
+    int         afd[2];
+    pid_t       pid;
+    uint32_t    uMagic;
+    int32_t     iStatus;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, afd) != 0)
+        return -1;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid == 0)
+    {
+        /* The child: put the zygote library first in LD_PRELOAD and tell it
+           about the connection.  (Not CLOEXEC after the dup.) */
+        size_t          cEnvVars = 0;
+        const char    **papszNewEnv;
+        const char     *pszOldPreload = kwEnvGet(papszEnvVars, "LD_PRELOAD");
+        char           *pszPreload;
+        char            szFdVar[64];
+        size_t          i, j;
+        int             fdChild = dup(afd[1]);
+        if (fdChild < 0)
+            _exit(KW_EXEC_FAILED);
+        snprintf(szFdVar, sizeof(szFdVar), "KWORKER_ZYGOTE_FD=%d", fdChild);
+        pszPreload = (char *)malloc(sizeof("LD_PRELOAD=") + strlen(g_pszZygoteLib) + 1
+                                    + (pszOldPreload ? strlen(pszOldPreload) : 0));
+        while (papszEnvVars[cEnvVars])
+            cEnvVars++;
+        papszNewEnv = (const char **)malloc((cEnvVars + 3) * sizeof(papszNewEnv[0]));
+        if (!pszPreload || !papszNewEnv)
+            _exit(KW_EXEC_FAILED);
+        sprintf(pszPreload, "LD_PRELOAD=%s%s%s", g_pszZygoteLib, pszOldPreload ? ":" : "",
+                pszOldPreload ? pszOldPreload : "");
+        for (i = j = 0; i < cEnvVars; i++)
+            if (strncmp(papszEnvVars[i], "LD_PRELOAD=", sizeof("LD_PRELOAD=") - 1) != 0)
+                papszNewEnv[j++] = papszEnvVars[i];
+        papszNewEnv[j++] = pszPreload;
+        papszNewEnv[j++] = szFdVar;
+        papszNewEnv[j]   = NULL;
+
+        signal(SIGPIPE, SIG_DFL);
+        if (g_fdDevNull != -1)
+            dup2(g_fdDevNull, 0);
+        execve(pZygote->szPath, (char **)papszArgs, (char **)papszNewEnv);
+        fprintf(stderr, "kWorker: error: execve(%s) failed: %s\n", pZygote->szPath, strerror(errno));
+        _exit(KW_EXEC_FAILED);
+    }
+    close(afd[1]);
+    if (pid < 0)
+    {
+        close(afd[0]);
+        return -1;
+    }
+
+    /*
+     * If we get a greeting, it's a zygote and the job status follows.
+     * Otherwise the tool ran the job on its own.
+     */
+    pZygote->pid = -1;
+    pZygote->fdSocket = -1;
+    if (kwZygoteRead(afd[0], &uMagic, sizeof(uMagic)) != 0 || uMagic != KW_ZYGOTE_MAGIC)
+    {
+        close(afd[0]);
+        g_cZygoteMisfits++;
+        pZygote->pNext = g_pZygoteHead;
+        g_pZygoteHead = pZygote;
+        return kwWaitForChild(pid);
+    }
+
+    pZygote->pid      = pid;
+    pZygote->fdSocket = afd[0];
+    pZygote->pNext    = g_pZygoteHead;
+    g_pZygoteHead     = pZygote;
+    g_cZygotes++;
+    g_cZygotesStarted++;
+    g_cZygoteJobs++;
+    if (kwZygoteRead(afd[0], &iStatus, sizeof(iStatus)) == 0)
+        return kwWaitStatusToExitCode(iStatus);
+    kwZygoteDestroy(pZygote);
+    return kwErrPrintfRc(42 + 3, "The zygote for %s died!\n", papszArgs[0]);
+}
+
+
+/**
+ * Passes a job to a live zygote and waits for it to complete.
+ *
+ * @returns The exit code of the job, -1 if the job couldn't be passed on (the
+ *          zygote is destroyed and the caller should exec the job).
+ * @param   pZygote             The zygote.
+ * @param   papszArgs           The argument vector.
+ * @param   papszEnvVars        The environment.
+ */
+static int kwZygoteSubmit(PKWZYGOTE pZygote, const char **papszArgs, const char **papszEnvVars)
+{
+    union
+    {
+        struct cmsghdr  Hdr;
+        char            ab[CMSG_SPACE(sizeof(int) * 2)];
+    } uCtl;
+    struct msghdr   MsgHdr;
+    struct iovec    IoVec;
+    size_t          cbMsg;
+    uint32_t        cArgs, cEnvVars, u32;
+    char           *pbMsg;
+    char           *pbCur;
+    size_t          i, cch;
+    ssize_t         cbSent;
+    int32_t         iStatus;
+    int             afdOutput[2] = { 1, 2 };
+
+    /*
+     * Compose the message.
+     */
+    cbMsg = sizeof(uint32_t) + strlen(g_pszCwd) + 1 + sizeof(uint32_t) + sizeof(uint32_t);
+    for (cArgs = 0; papszArgs[cArgs]; cArgs++)
+        cbMsg += strlen(papszArgs[cArgs]) + 1;
+    for (cEnvVars = 0; papszEnvVars[cEnvVars]; cEnvVars++)
+        cbMsg += strlen(papszEnvVars[cEnvVars]) + 1;
+    pbCur = pbMsg = (char *)malloc(cbMsg);
+    if (!pbMsg)
+        return -1;
+    u32 = (uint32_t)cbMsg;
+    memcpy(pbCur, &u32, sizeof(u32));
+    pbCur += sizeof(u32);
+    cch = strlen(g_pszCwd) + 1;
+    memcpy(pbCur, g_pszCwd, cch);
+    pbCur += cch;
+    memcpy(pbCur, &cArgs, sizeof(cArgs));
+    pbCur += sizeof(cArgs);
+    for (i = 0; i < cArgs; i++)
+    {
+        cch = strlen(papszArgs[i]) + 1;
+        memcpy(pbCur, papszArgs[i], cch);
+        pbCur += cch;
+    }
+    memcpy(pbCur, &cEnvVars, sizeof(cEnvVars));
+    pbCur += sizeof(cEnvVars);
+    for (i = 0; i < cEnvVars; i++)
+    {
+        cch = strlen(papszEnvVars[i]) + 1;
+        memcpy(pbCur, papszEnvVars[i], cch);
+        pbCur += cch;
+    }
+
+    /*
+     * Send it along with our current (i.e. the job's) output descriptors.
+     */
+    fflush(stdout);
+    fflush(stderr);
+    memset(&MsgHdr, 0, sizeof(MsgHdr));
+    memset(&uCtl, 0, sizeof(uCtl));
+    IoVec.iov_base = pbMsg;
+    IoVec.iov_len  = cbMsg;
+    MsgHdr.msg_iov        = &IoVec;
+    MsgHdr.msg_iovlen     = 1;
+    MsgHdr.msg_control    = uCtl.ab;
+    MsgHdr.msg_controllen = sizeof(uCtl.ab);
+    CMSG_FIRSTHDR(&MsgHdr)->cmsg_level = SOL_SOCKET;
+    CMSG_FIRSTHDR(&MsgHdr)->cmsg_type  = SCM_RIGHTS;
+    CMSG_FIRSTHDR(&MsgHdr)->cmsg_len   = CMSG_LEN(sizeof(afdOutput));
+    memcpy(CMSG_DATA(CMSG_FIRSTHDR(&MsgHdr)), afdOutput, sizeof(afdOutput));
+    do
+        cbSent = sendmsg(pZygote->fdSocket, &MsgHdr, MSG_NOSIGNAL);
+    while (cbSent < 0 && errno == EINTR);
+    if (cbSent > 0 && (size_t)cbSent < cbMsg)
+    {
+        /* The rest without the descriptors. */
+        pbCur = pbMsg + cbSent;
+        cbMsg -= cbSent;
+        while (cbMsg > 0)
+        {
+            cbSent = send(pZygote->fdSocket, pbCur, cbMsg, MSG_NOSIGNAL);
+            if (cbSent > 0)
+            {
+                pbCur += cbSent;
+                cbMsg -= cbSent;
+            }
+            else if (cbSent < 0 && errno != EINTR)
+                break;
+        }
+        if (cbMsg > 0)
+        {
+            /* The zygote has a partial job and is of no further use. */
+            free(pbMsg);
+            kwZygoteDestroy(pZygote);
+            return kwErrPrintfRc(42 + 3, "Sending job to the zygote for %s failed: %s\n",
+                                 papszArgs[0], strerror(errno));
+        }
+    }
+    else if (cbSent <= 0)
+    {
+        free(pbMsg);
+        kwZygoteDestroy(pZygote);
+        return -1;
+    }
+    free(pbMsg);
+
+    /*
+     * Wait for the result.
+     */
+    g_cZygoteJobs++;
+    pZygote->uLastUsed = g_cJobs;
+    if (kwZygoteRead(pZygote->fdSocket, &iStatus, sizeof(iStatus)) == 0)
+        return kwWaitStatusToExitCode(iStatus);
+    kwZygoteDestroy(pZygote);
+    return kwErrPrintfRc(42 + 3, "The zygote for %s died!\n", papszArgs[0]);
+}
+
+
+/**
+ * Runs a job using a tool zygote, starting one if necessary.
+ *
+ * @returns The exit code of the job, -1 if the tool cannot be run by a zygote
+ *          and the caller should exec the job.
+ * @param   pszPath             The absolute executable path.
+ * @param   papszArgs           The argument vector.
+ * @param   papszEnvVars        The environment.
+ */
+static int kwZygoteRunJob(const char *pszPath, const char **papszArgs, const char **papszEnvVars)
+{
+    PKWZYGOTE   pZygote;
+    PKWZYGOTE   pLru;
+    struct stat St;
+    char       *pszLdEnv;
+    size_t      cchPath;
+
+    if (stat(pszPath, &St) != 0)
+        return -1;
+
+    /*
+     * Look for an entry, dropping it if the executable changed.
+     */
+    for (pZygote = g_pZygoteHead; pZygote; pZygote = pZygote->pNext)
+        if (strcmp(pZygote->szPath, pszPath) == 0)
+            break;
+    if (   pZygote
+        && (   pZygote->idDev   != St.st_dev
+            || pZygote->idIno   != St.st_ino
+            || pZygote->cbFile  != St.st_size
+            || pZygote->tsMTime != St.st_mtime))
+    {
+        kwZygoteDestroy(pZygote);
+        pZygote = NULL;
+    }
+
+    pszLdEnv = kwZygoteLdEnv(papszEnvVars);
+    if (!pszLdEnv)
+        return -1;
+    if (pZygote)
+    {
+        /* Misfit, or a zygote whose libraries may not be what this job wants. */
+        int rcExit = -1;
+        if (pZygote->pid != -1 && strcmp(pZygote->pszLdEnv, pszLdEnv) == 0)
+            rcExit = kwZygoteSubmit(pZygote, papszArgs, papszEnvVars);
+        free(pszLdEnv);
+        return rcExit;
+    }
+
+    /*
+     * Start a new one, retiring the least recently used zygote if necessary.
+     */
+    cchPath = strlen(pszPath);
+    pZygote = (PKWZYGOTE)malloc(sizeof(*pZygote) + cchPath);
+    if (!pZygote)
+    {
+        free(pszLdEnv);
+        return -1;
+    }
+    memcpy(pZygote->szPath, pszPath, cchPath + 1);
+    pZygote->pszLdEnv  = pszLdEnv;
+    pZygote->idDev     = St.st_dev;
+    pZygote->idIno     = St.st_ino;
+    pZygote->cbFile    = St.st_size;
+    pZygote->tsMTime   = St.st_mtime;
+    pZygote->uLastUsed = g_cJobs;
+    pZygote->pid       = -1;
+    pZygote->fdSocket  = -1;
+    pZygote->pNext     = NULL;
+    if (!kwZygoteIsElf(pszPath))
+    {
+        g_cZygoteMisfits++;
+        pZygote->pNext = g_pZygoteHead;
+        g_pZygoteHead = pZygote;
+        return -1;
+    }
+
+    if (g_cZygotes >= KW_MAX_ZYGOTES)
+    {
+        PKWZYGOTE pCur;
+        pLru = NULL;
+        for (pCur = g_pZygoteHead; pCur; pCur = pCur->pNext)
+            if (pCur->pid != -1 && (!pLru || pCur->uLastUsed < pLru->uLastUsed))
+                pLru = pCur;
+        if (pLru)
+            kwZygoteDestroy(pLru);
+    }
+
+    return kwZygoteStart(pZygote, papszArgs, papszEnvVars);
+}
+
+#endif /* KWORKER_WITH_ZYGOTES */
+
+
+/**
+ * Runs the job executable, waiting for it to complete.
+ *
+ * @returns The exit code of the job.
+ * @param   pszExecutable       The executable.
+ * @param   papszArgs           The argument vector.
+ * @param   papszEnvVars        The environment.
+ */
+static int kwRunJob(const char *pszExecutable, const char **papszArgs, const char **papszEnvVars)
+{
+    const char *pszPath = kwToolLookup(pszExecutable, papszEnvVars);
+    if (!pszPath)
+        return kwErrPrintfRc(KW_EXEC_FAILED, "%s: command not found\n", pszExecutable);
+
+#ifdef KWORKER_WITH_ZYGOTES
+    if (g_pszZygoteLib && pszPath[0] == '/')
+    {
+        int rcExit = kwZygoteRunJob(pszPath, papszArgs, papszEnvVars);
+        if (rcExit != -1)
+            return rcExit;
+    }
+#endif
+    return kwExecJob(pszPath, papszArgs, papszEnvVars);
+}
+
+
+/**
+ * Checks whether the worker should be restarted after a job.
+ *
+ * Like the Windows worker, we restart if descriptors appear to be leaking.
+ * The job descriptors we receive are all closed after the job.
+ */
+static void kwCheckForRestart(void)
+{
+    int fd = dup(0);
+    if (fd >= KW_FD_LEAK_RESTART)
+        g_fRestart = 1;
+    if (fd >= 0)
+        close(fd);
+}
+
+
+/**
+ * Does the post command part of a job (optional).
+ *
+ * @returns The exit code of the job.
+ * @param   cPostCmdArgs        Number of post command arguments (includes cmd).
+ * @param   papszPostCmdArgs    The post command and its argument.
+ */
+static int kSubmitHandleJobPostCmd(unsigned cPostCmdArgs, const char **papszPostCmdArgs)
+{
+    const char *pszCmd = papszPostCmdArgs[0];
+
+    /* Allow the kmk builtin prefix. */
+    static const char s_szKmkBuiltinPrefix[] = "kmk_builtin_";
+    if (strncmp(pszCmd, s_szKmkBuiltinPrefix, sizeof(s_szKmkBuiltinPrefix) - 1) == 0)
+        pszCmd += sizeof(s_szKmkBuiltinPrefix) - 1;
+
+    /* Command switch. */
+    if (strcmp(pszCmd, "kDepObj") == 0)
+    {
+        KMKBUILTINCTX Ctx = { papszPostCmdArgs[0], NULL };
+        g_cPostCmds++;
+        return kmk_builtin_kDepObj(cPostCmdArgs, (char **)papszPostCmdArgs, NULL, &Ctx);
+    }
+
+    return kwErrPrintfRc(42 + 5 , "Unknown post command: '%s'\n", pszCmd);
+}
+
+
+/**
+ * Handles a "JOB" command.
+ *
+ * The message layout is the one produced by kSubmitComposeJobMessage, see the
+ * Windows worker for details.  The expansion flags and the watcom/PCH flags
+ * have no meaning here and are ignored.
+ *
+ * @returns The exit code of the job.
+ * @param   pszMsg              Points to the "JOB" command part of the message.
+ * @param   cbMsg               Number of message bytes at @a pszMsg.  There are
+ *                              4 more zero bytes after the message body to
+ *                              simplify parsing.
+ */
+static int kSubmitHandleJob(const char *pszMsg, size_t cbMsg)
+{
+    const char     *pszExecutable;
+    const char     *pszCwd;
+    const char    **papszArgs    = NULL;
+    const char    **papszEnvVars = NULL;
+    const char     *apszPostCmdArgs[32+1];
+    uint32_t        cArgs, cEnvVars, cPostCmdArgs = 0;
+    uint32_t        i;
+    size_t          cbTmp;
+    int             afdSaved[2];
+    int             rcExit = 42 + 1;
+
+#define KW_MSG_SKIP_STR(a_pszDst) \
+        do { \
+            (a_pszDst) = pszMsg; \
+            cbTmp = strlen(pszMsg) + 1; \
+            if (cbTmp > cbMsg) \
+                goto l_bad_msg; \
+            pszMsg += cbTmp; \
+            cbMsg  -= cbTmp; \
+        } while (0)
+#define KW_MSG_GET_U32(a_uDst) \
+        do { \
+            if (cbMsg < sizeof(uint32_t)) \
+                goto l_bad_msg; \
+            memcpy(&(a_uDst), pszMsg, sizeof(uint32_t)); \
+            pszMsg += sizeof(uint32_t); \
+            cbMsg  -= sizeof(uint32_t); \
+        } while (0)
+
+    pszMsg += sizeof("JOB");
+    cbMsg  -= sizeof("JOB");
+
+    KW_MSG_SKIP_STR(pszExecutable);
+    KW_MSG_SKIP_STR(pszCwd);
+    if (!*pszExecutable || !*pszCwd)
+        goto l_bad_msg;
+
+    /* The argument vector, the first byte of each being expansion flags for MSC & EMX. */
+    KW_MSG_GET_U32(cArgs);
+    if (cArgs == 0 || cArgs >= 4096)
+        goto l_bad_msg;
+    papszArgs = (const char **)malloc((cArgs + 1) * sizeof(papszArgs[0]));
+    if (!papszArgs)
+        return kwErrPrintfRc(42 + 1, "Out of memory!\n");
+    for (i = 0; i < cArgs; i++)
+    {
+        if (cbMsg < 2)
+            goto l_bad_msg;
+        pszMsg++;
+        cbMsg--;
+        KW_MSG_SKIP_STR(papszArgs[i]);
+    }
+    papszArgs[cArgs] = NULL;
+
+    /* The environment. */
+    KW_MSG_GET_U32(cEnvVars);
+    if (cEnvVars >= 4096)
+        goto l_bad_msg;
+    papszEnvVars = (const char **)malloc((cEnvVars + 1) * sizeof(papszEnvVars[0]));
+    if (!papszEnvVars)
+    {
+        free(papszArgs);
+        return kwErrPrintfRc(42 + 1, "Out of memory!\n");
+    }
+    for (i = 0; i < cEnvVars; i++)
+        KW_MSG_SKIP_STR(papszEnvVars[i]);
+    papszEnvVars[cEnvVars] = NULL;
+
+    /* Flags (watcom argument brain damage and no precompiled header caching), both ignored. */
+    if (cbMsg < 2)
+        goto l_bad_msg;
+    pszMsg += 2;
+    cbMsg  -= 2;
+
+    /* Post command argument count (can be zero). */
+    KW_MSG_GET_U32(cPostCmdArgs);
+    if (cPostCmdArgs >= 32)
+        goto l_bad_msg;
+    for (i = 0; i < cPostCmdArgs; i++)
+        KW_MSG_SKIP_STR(apszPostCmdArgs[i]);
+    apszPostCmdArgs[cPostCmdArgs] = NULL;
+    if (cbMsg != 0)
+        goto l_bad_msg;
+
+#undef KW_MSG_SKIP_STR
+#undef KW_MSG_GET_U32
+
+    /*
+     * Do the job.
+     */
+    g_cJobs++;
+    kwJobOutputRedirect(afdSaved);
+    if (kwChangeDir(pszCwd) == 0)
+    {
+        rcExit = kwRunJob(pszExecutable, papszArgs, papszEnvVars);
+        if (cPostCmdArgs && rcExit == 0)
+            rcExit = kSubmitHandleJobPostCmd(cPostCmdArgs, apszPostCmdArgs);
+    }
+    else
+        rcExit = 42 + 2;
+    kwJobOutputRestore(afdSaved);
+    kwCheckForRestart();
+
+    free(papszEnvVars);
+    free(papszArgs);
+    return rcExit;
+
+l_bad_msg:
+    free(papszEnvVars);
+    free(papszArgs);
+    kwJobOutputClose();
+    return kwErrPrintfRc(42 + 1, "Malformed JOB message!\n");
+}
+
+
+/**
+ * Reads @a cbToRead bytes from the socket.
+ *
+ * @returns 0 on success.
+ *          1 on shut down (@a fShutdownOkay must be set).
+ *          -1 on error (fatal).
+ * @param   fd                  The socket.
+ * @param   pvBuf               The buffer.
+ * @param   cbToRead            The number of bytes to read.
+ * @param   fShutdownOkay       Whether connection shutdown while reading the
+ *                              first byte is okay or not.
+ */
+static int kSubmitReadIt(int fd, void *pvBuf, size_t cbToRead, int fShutdownOkay)
+{
+    char *pbBuf = (char *)pvBuf;
+    while (cbToRead > 0)
+    {
+        union
+        {
+            struct cmsghdr  Hdr;
+            char            ab[CMSG_SPACE(sizeof(int) * 2)];
+        } uCtl;
+        struct msghdr   MsgHdr;
+        struct iovec    IoVec;
+        ssize_t         cbActual;
+
+        IoVec.iov_base = pbBuf;
+        IoVec.iov_len  = cbToRead;
+        memset(&MsgHdr, 0, sizeof(MsgHdr));
+        MsgHdr.msg_iov        = &IoVec;
+        MsgHdr.msg_iovlen     = 1;
+        MsgHdr.msg_control    = uCtl.ab;
+        MsgHdr.msg_controllen = sizeof(uCtl.ab);
+#ifdef MSG_CMSG_CLOEXEC
+        cbActual = recvmsg(fd, &MsgHdr, MSG_CMSG_CLOEXEC);
+#else
+        cbActual = recvmsg(fd, &MsgHdr, 0);
+#endif
+        if (cbActual > 0)
+        {
+            /* Pick up output descriptors kSubmit sent with the message. */
+            struct cmsghdr *pCMsgHdr;
+            for (pCMsgHdr = CMSG_FIRSTHDR(&MsgHdr); pCMsgHdr; pCMsgHdr = CMSG_NXTHDR(&MsgHdr, pCMsgHdr))
+                if (   pCMsgHdr->cmsg_level == SOL_SOCKET
+                    && pCMsgHdr->cmsg_type  == SCM_RIGHTS)
+                {
+                    int    afd[2] = { -1, -1 };
+                    size_t cfds   = (pCMsgHdr->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    memcpy(afd, CMSG_DATA(pCMsgHdr), (cfds < 2 ? cfds : 2) * sizeof(int));
+                    kwJobOutputClose();
+                    g_afdJobOutput[0] = afd[0];
+                    g_afdJobOutput[1] = afd[1];
+                }
+
+            pbBuf    += cbActual;
+            cbToRead -= cbActual;
+            fShutdownOkay = 0;
+        }
+        else if (cbActual == 0)
+        {
+            if (fShutdownOkay)
+                return 1;
+            return kwErrPrintfRc(-1, "Unexpected end of input\n");
+        }
+        else if (errno != EINTR)
+        {
+            if (fShutdownOkay && (errno == ECONNRESET || errno == EPIPE))
+                return 1;
+            return kwErrPrintfRc(-1, "read failed: %s\n", strerror(errno));
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Writes @a cbToWrite bytes to the socket.
+ *
+ * @returns 0 on success, -1 on error (fatal).
+ * @param   fd                  The socket.
+ * @param   pvBuf               The buffer.
+ * @param   cbToWrite           The number of bytes to write.
+ */
+static int kSubmitWriteIt(int fd, const void *pvBuf, size_t cbToWrite)
+{
+    const char *pbBuf = (const char *)pvBuf;
+    while (cbToWrite > 0)
+    {
+        ssize_t cbActual = write(fd, pbBuf, cbToWrite);
+        if (cbActual > 0)
+        {
+            pbBuf     += cbActual;
+            cbToWrite -= cbActual;
+        }
+        else if (cbActual < 0 && errno != EINTR)
+            return kwErrPrintfRc(-1, "write failed: %s\n", strerror(errno));
+    }
+    return 0;
+}
+
+
+/**
+ * Prints the statistics (KWORKER_STATS).
+ */
+static void kwPrintStats(void)
+{
+    fprintf(stderr, "kWorker[%ld]: %u jobs, %u post commands, %u chdirs; tool lookups: %u hits, %u misses\n",
+            (long)getpid(), g_cJobs, g_cPostCmds, g_cChDirs, g_cToolHits, g_cToolMisses);
+#ifdef KWORKER_WITH_ZYGOTES
+    fprintf(stderr, "kWorker[%ld]: %u jobs run by %u zygotes started, %u tools not suitable for zygotes\n",
+            (long)getpid(), g_cZygoteJobs, g_cZygotesStarted, g_cZygoteMisfits);
+#endif
+}
+
+
+int main(int argc, char **argv)
+{
+    int             fd = 0;
+    size_t          cbMsgBuf = 0;
+    char           *pbMsgBuf = NULL;
+    int             i;
+    int             rc;
+
+    /*
+     * Parse arguments.
+     */
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--volatile") == 0)
+        {
+            /* We don't cache file system state, so there is nothing to invalidate. */
+            i++;
+            if (i >= argc)
+                return kwErrPrintfRc(2, "--volatile takes an argument!\n");
+        }
+        else if (   strcmp(argv[i], "--help") == 0
+                 || strcmp(argv[i], "-h") == 0
+                 || strcmp(argv[i], "-?") == 0)
+        {
+            printf("usage: kWorker [--volatile dir]\n"
+                   "usage: kWorker <--help|-h>\n"
+                   "usage: kWorker <--version|-V>\n"
+                   "\n"
+                   "This is an internal kmk program that is used via the builtin_kSubmit.\n"
+                   "Jobs are read from a socket on standard input.\n");
+            return 0;
+        }
+        else if (   strcmp(argv[i], "--version") == 0
+                 || strcmp(argv[i], "-V") == 0)
+            return kbuild_version(argv[0]);
+        else
+            return kwErrPrintfRc(2, "Unknown argument '%s'\n", argv[i]);
+    }
+
+    /*
+     * Standard input is the socket, so move it out of the way and give
+     * the jobs /dev/null instead.  Broken connections are handled via EPIPE.
+     */
+    signal(SIGPIPE, SIG_IGN);
+    g_fdDevNull = open("/dev/null", O_RDONLY);
+    if (g_fdDevNull != -1)
+    {
+        fd = dup(0);
+        if (fd == -1)
+            return kwErrPrintfRc(1, "dup(0) failed: %s\n", strerror(errno));
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(g_fdDevNull, F_SETFD, FD_CLOEXEC);
+        dup2(g_fdDevNull, 0);
+    }
+
+#ifdef KWORKER_WITH_ZYGOTES
+    kwZygoteInit();
+#endif
+
+    /*
+     * Serve the socket.
+     */
+    for (;;)
+    {
+        uint32_t cbMsg = 0;
+        rc = kSubmitReadIt(fd, &cbMsg, sizeof(cbMsg), 1 /*fShutdownOkay*/);
+        if (rc != 0)
+            break;
+
+        /* Make sure the message length is within sane bounds.  */
+        if (   cbMsg <= 4
+            || cbMsg > 256*1024*1024)
+        {
+            rc = kwErrPrintfRc(-1, "Bogus message length: %u (%#x)\n", cbMsg, cbMsg);
+            break;
+        }
+
+        /* Reallocate the message buffer if necessary.  We add 4 zero bytes.  */
+        if (cbMsg + 4 > cbMsgBuf)
+        {
+            cbMsgBuf = (cbMsg + 4 + 2047) & ~(size_t)2047;
+            pbMsgBuf = (char *)realloc(pbMsgBuf, cbMsgBuf);
+            if (!pbMsgBuf)
+                return kwErrPrintfRc(1, "Failed to allocate %u bytes for a message buffer!\n", (unsigned)cbMsgBuf);
+        }
+
+        /* Read the whole message into the buffer, making sure there is are a 4 zero bytes following it. */
+        memcpy(pbMsgBuf, &cbMsg, sizeof(cbMsg));
+        rc = kSubmitReadIt(fd, &pbMsgBuf[sizeof(cbMsg)], cbMsg - sizeof(cbMsg), 0 /*fShutdownOkay*/);
+        if (rc != 0)
+            break;
+        memset(&pbMsgBuf[cbMsg], 0, 4);
+
+        /* The first string after the header is the command. */
+        if (strcmp(&pbMsgBuf[sizeof(cbMsg)], "JOB") == 0)
+        {
+            struct
+            {
+                int32_t  rcExitCode;
+                uint8_t  bExiting;
+                uint8_t  abZero[3];
+            } Reply;
+            Reply.rcExitCode = kSubmitHandleJob(&pbMsgBuf[sizeof(cbMsg)], cbMsg - sizeof(cbMsg));
+            Reply.bExiting   = (uint8_t)g_fRestart;
+            Reply.abZero[0]  = 0;
+            Reply.abZero[1]  = 0;
+            Reply.abZero[2]  = 0;
+            fflush(stdout);
+            fflush(stderr);
+            rc = kSubmitWriteIt(fd, &Reply, sizeof(Reply));
+            if (rc != 0)
+                break;
+            if (g_fRestart)
+                break;
+        }
+        else
+        {
+            rc = kwErrPrintfRc(-1, "Unknown command: '%s'\n", &pbMsgBuf[sizeof(cbMsg)]);
+            break;
+        }
+    }
+
+    close(fd);
+    if (getenv("KWORKER_STATS") != NULL)
+        kwPrintStats();
+    return rc >= 0 ? 0 : 1;
+}
+
@@ -0,0 +1,432 @@
+/* $Id$ */
+/** @file
+ * kWorker - tool zygote, preloaded into tools started by the POSIX kWorker.
+ *
+ * The POSIX kWorker cannot load ELF executables into its own address space the
+ * way the Windows one does with PE images.  Instead it starts a tool with this
+ * library in LD_PRELOAD the first time it is needed.  The library interposes
+ * __libc_start_main, so once the dynamic linker has loaded and relocated the
+ * tool and its libraries and the C library has been initialized, control ends
+ * up in kwZygoteMain instead of the tool's main.  There we turn the process
+ * into a zygote that forks a child for each job kWorker sends us, calling the
+ * tool's main with the job's arguments, environment, current directory and
+ * output descriptors.  So, the exec and dynamic linking cost of the tool is
+ * paid once per worker rather than once per job.
+ *
+ * The first job is the one the zygote was started for, using the argument
+ * vector and environment it was exec'ed with.  If the library isn't loaded
+ * (static executable, set-uid, ...) the tool simply runs that job and exits,
+ * and kWorker notices the lack of a greeting and stops trying.
+ *
+ * Protocol on the socket (native byte order):
+ *  - zygote:  uint32_t KWZYGOTE_MAGIC once the library is in control.
+ *  - kWorker: uint32_t cbMsg (including itself), then the current directory,
+ *             uint32_t cArgs, the arguments, uint32_t cEnvVars and the
+ *             environment, all zero terminated strings.  The standard output
+ *             and error descriptors are passed along as SCM_RIGHTS.
+ *  - zygote:  int32_t wait status of each job, the first job included.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* RTLD_NEXT, program_invocation_name */
+#endif
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The greeting the zygote sends when it has taken control ('KWZ1'). */
+#define KWZYGOTE_MAGIC          UINT32_C(0x315a574b)
+/** The environment variable with the socket descriptor number. */
+#define KWZYGOTE_FD_VAR         "KWORKER_ZYGOTE_FD"
+/** The max message size we accept. */
+#define KWZYGOTE_MAX_MSG        (64U*1024*1024)
+/** Max arguments and environment variables. */
+#define KWZYGOTE_MAX_STRINGS    65536
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** The main function of the tool. */
+typedef int FNKWMAIN(int, char **, char **);
+typedef FNKWMAIN *PFNKWMAIN;
+
+/** glibc's __libc_start_main. */
+typedef int FNLIBCSTARTMAIN(PFNKWMAIN pfnMain, int argc, char **argv, void (*pfnInit)(void), void (*pfnFini)(void),
+                            void (*pfnRtldFini)(void), void *pvStackEnd);
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The tool's main function. */
+static PFNKWMAIN    g_pfnToolMain = NULL;
+/** The socket connected to kWorker. */
+static int          g_fdSocket = -1;
+
+
+/**
+ * Writes all of @a cbToWrite bytes to @a fd.
+ *
+ * @returns 0 on success, -1 on failure.
+ */
+static int kwZygoteWriteIt(int fd, const void *pvBuf, size_t cbToWrite)
+{
+    const char *pbBuf = (const char *)pvBuf;
+    while (cbToWrite > 0)
+    {
+        ssize_t cbActual = send(fd, pbBuf, cbToWrite, MSG_NOSIGNAL);
+        if (cbActual > 0)
+        {
+            pbBuf     += cbActual;
+            cbToWrite -= cbActual;
+        }
+        else if (cbActual < 0 && errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Reads all of @a cbToRead bytes from the socket, picking up descriptors.
+ *
+ * @returns 0 on success, -1 on failure or end of file.
+ * @param   pvBuf               The buffer.
+ * @param   cbToRead            The number of bytes to read.
+ * @param   pafdOutput          Where to put the two output descriptors if
+ *                              passed along, -1 if not.
+ */
+static int kwZygoteReadIt(void *pvBuf, size_t cbToRead, int *pafdOutput)
+{
+    char *pbBuf = (char *)pvBuf;
+    while (cbToRead > 0)
+    {
+        union
+        {
+            struct cmsghdr  Hdr;
+            char            ab[CMSG_SPACE(sizeof(int) * 2)];
+        } uCtl;
+        struct msghdr   MsgHdr;
+        struct iovec    IoVec;
+        ssize_t         cbActual;
+
+        IoVec.iov_base = pbBuf;
+        IoVec.iov_len  = cbToRead;
+        memset(&MsgHdr, 0, sizeof(MsgHdr));
+        MsgHdr.msg_iov        = &IoVec;
+        MsgHdr.msg_iovlen     = 1;
+        MsgHdr.msg_control    = uCtl.ab;
+        MsgHdr.msg_controllen = sizeof(uCtl.ab);
+        cbActual = recvmsg(g_fdSocket, &MsgHdr, MSG_CMSG_CLOEXEC);
+        if (cbActual > 0)
+        {
+            struct cmsghdr *pCMsgHdr;
+            for (pCMsgHdr = CMSG_FIRSTHDR(&MsgHdr); pCMsgHdr; pCMsgHdr = CMSG_NXTHDR(&MsgHdr, pCMsgHdr))
+                if (   pCMsgHdr->cmsg_level == SOL_SOCKET
+                    && pCMsgHdr->cmsg_type  == SCM_RIGHTS)
+                {
+                    size_t const cfds = (pCMsgHdr->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    if (pafdOutput[0] != -1)
+                        close(pafdOutput[0]);
+                    if (pafdOutput[1] != -1)
+                        close(pafdOutput[1]);
+                    pafdOutput[0] = pafdOutput[1] = -1;
+                    memcpy(pafdOutput, CMSG_DATA(pCMsgHdr), (cfds < 2 ? cfds : 2) * sizeof(int));
+                }
+            pbBuf    += cbActual;
+            cbToRead -= cbActual;
+        }
+        else if (cbActual == 0 || errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Waits for a job child and tells kWorker how it went.
+ *
+ * @returns 0 on success, -1 if the connection is broken.
+ * @param   pid                 The job child, -1 if the fork failed.
+ */
+static int kwZygoteCompleteJob(pid_t pid)
+{
+    int32_t iStatus = 127 << 8;
+    if (pid > 0)
+    {
+        int   iWaitStatus;
+        pid_t pidWait;
+        do
+            pidWait = waitpid(pid, &iWaitStatus, 0);
+        while (pidWait == -1 && errno == EINTR);
+        if (pidWait == pid)
+            iStatus = iWaitStatus;
+    }
+    return kwZygoteWriteIt(g_fdSocket, &iStatus, sizeof(iStatus));
+}
+
+
+/**
+ * Removes the zygote variable and this library from the environment, so the
+ * job and whatever it starts won't see them.
+ */
+static void kwZygoteCleanEnv(void)
+{
+    const char *pszPreload = getenv("LD_PRELOAD");
+    unsetenv(KWZYGOTE_FD_VAR);
+    if (pszPreload)
+    {
+        /* kWorker put us first. */
+        size_t off = strcspn(pszPreload, ": ");
+        while (pszPreload[off] == ':' || pszPreload[off] == ' ')
+            off++;
+        if (pszPreload[off])
+            setenv("LD_PRELOAD", &pszPreload[off], 1);
+        else
+            unsetenv("LD_PRELOAD");
+    }
+}
+
+
+/**
+ * Redirects the standard descriptors of the zygote to /dev/null so it doesn't
+ * keep the output pipes of the first job open.
+ */
+static void kwZygoteDetachStdFds(void)
+{
+    int fd = open("/dev/null", O_RDWR);
+    if (fd >= 0)
+    {
+        dup2(fd, 0);
+        dup2(fd, 1);
+        dup2(fd, 2);
+        if (fd > 2)
+            close(fd);
+    }
+}
+
+
+/**
+ * Runs one job in a forked child.  Does not return in the child.
+ *
+ * @returns The process ID of the child, -1 on fork failure.
+ * @param   pszCwd              The job's current directory, NULL for the
+ *                              first job.
+ * @param   papszArgs           The argument vector.
+ * @param   papszEnv            The environment, NULL for the first job.
+ * @param   pafdOutput          The standard output and error descriptors,
+ *                              -1 if inherited (first job).
+ */
+static pid_t kwZygoteForkJob(const char *pszCwd, char **papszArgs, char **papszEnv, int const *pafdOutput)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int cArgs = 0;
+        while (papszArgs[cArgs])
+            cArgs++;
+
+        close(g_fdSocket);
+        if (pafdOutput[0] != -1)
+        {
+            int fd = open("/dev/null", O_RDONLY);
+            if (fd >= 0 && fd != 0)
+            {
+                dup2(fd, 0);
+                close(fd);
+            }
+            dup2(pafdOutput[0], 1);
+            dup2(pafdOutput[1] != -1 ? pafdOutput[1] : pafdOutput[0], 2);
+        }
+        if (pszCwd && chdir(pszCwd) != 0)
+            _exit(127);
+        if (papszEnv)
+            environ = papszEnv;
+        program_invocation_name = papszArgs[0];
+        program_invocation_short_name = strrchr(papszArgs[0], '/') ? strrchr(papszArgs[0], '/') + 1 : papszArgs[0];
+        exit(g_pfnToolMain(cArgs, papszArgs, environ));
+    }
+    return pid;
+}
+
+
+/**
+ * Splits @a cStrings zero terminated strings at @a *ppszMsg into a vector.
+ *
+ * @returns Pointer to the NULL terminated vector, NULL on failure.
+ */
+static char **kwZygoteSplitStrings(char **ppszMsg, char *pszEnd, uint32_t cStrings)
+{
+    char   **papsz;
+    uint32_t i;
+    if (cStrings >= KWZYGOTE_MAX_STRINGS)
+        return NULL;
+    papsz = (char **)malloc((cStrings + 1) * sizeof(papsz[0]));
+    if (!papsz)
+        return NULL;
+    for (i = 0; i < cStrings; i++)
+    {
+        char *pszZero = memchr(*ppszMsg, '\0', pszEnd - *ppszMsg);
+        if (!pszZero)
+        {
+            free(papsz);
+            return NULL;
+        }
+        papsz[i] = *ppszMsg;
+        *ppszMsg = pszZero + 1;
+    }
+    papsz[i] = NULL;
+    return papsz;
+}
+
+
+/**
+ * The zygote loop, replaces the tool's main.
+ *
+ * Never returns.
+ */
+static int kwZygoteMain(int argc, char **argv, char **envp)
+{
+    int afdOutput[2] = { -1, -1 };
+    (void)argc; (void)envp;
+
+    fcntl(g_fdSocket, F_SETFD, FD_CLOEXEC);
+    kwZygoteCleanEnv();
+
+    /*
+     * Greet kWorker and run the job we were started for.
+     */
+    {
+        uint32_t const uMagic = KWZYGOTE_MAGIC;
+        pid_t pid;
+        if (kwZygoteWriteIt(g_fdSocket, &uMagic, sizeof(uMagic)) != 0)
+            _exit(127);
+        pid = kwZygoteForkJob(NULL, argv, NULL, afdOutput);
+        kwZygoteDetachStdFds();
+        if (kwZygoteCompleteJob(pid) != 0)
+            _exit(0);
+    }
+
+    /*
+     * Serve further jobs till kWorker closes the connection.
+     */
+    for (;;)
+    {
+        uint32_t cbMsg;
+        uint32_t cArgs;
+        uint32_t cEnvVars;
+        char    *pszMsg;
+        char    *pszEnd;
+        char    *pszCur;
+        char    *pszCwd;
+        char   **papszArgs;
+        char   **papszEnv;
+        pid_t    pid = -1;
+
+        if (kwZygoteReadIt(&cbMsg, sizeof(cbMsg), afdOutput) != 0)
+            break;
+        if (cbMsg <= sizeof(cbMsg) || cbMsg > KWZYGOTE_MAX_MSG)
+            break;
+        pszMsg = (char *)malloc(cbMsg);
+        if (!pszMsg)
+            break;
+        if (kwZygoteReadIt(pszMsg, cbMsg - sizeof(cbMsg), afdOutput) != 0)
+            break;
+        pszEnd = &pszMsg[cbMsg - sizeof(cbMsg)];
+
+        /* Parse it: cwd, cArgs, args, cEnvVars, env. */
+        papszArgs = papszEnv = NULL;
+        pszCwd = pszCur = pszMsg;
+        pszCur = memchr(pszCur, '\0', pszEnd - pszCur);
+        if (pszCur && (size_t)(pszEnd - ++pszCur) >= sizeof(uint32_t))
+        {
+            memcpy(&cArgs, pszCur, sizeof(cArgs));
+            pszCur += sizeof(cArgs);
+            papszArgs = cArgs > 0 ? kwZygoteSplitStrings(&pszCur, pszEnd, cArgs) : NULL;
+            if (papszArgs && (size_t)(pszEnd - pszCur) >= sizeof(uint32_t))
+            {
+                memcpy(&cEnvVars, pszCur, sizeof(cEnvVars));
+                pszCur += sizeof(cEnvVars);
+                papszEnv = kwZygoteSplitStrings(&pszCur, pszEnd, cEnvVars);
+            }
+        }
+
+        if (papszEnv && pszCur == pszEnd)
+            pid = kwZygoteForkJob(pszCwd, papszArgs, papszEnv, afdOutput);
+        free(papszEnv);
+        free(papszArgs);
+        free(pszMsg);
+        if (afdOutput[0] != -1)
+            close(afdOutput[0]);
+        if (afdOutput[1] != -1)
+            close(afdOutput[1]);
+        afdOutput[0] = afdOutput[1] = -1;
+
+        if (kwZygoteCompleteJob(pid) != 0)
+            break;
+    }
+    _exit(0);
+    return 0;
+}
+
+
+/**
+ * Our __libc_start_main interposer.
+ *
+ * Substitutes kwZygoteMain for the tool's main when started by kWorker.
+ */
+int __libc_start_main(PFNKWMAIN pfnMain, int argc, char **argv, void (*pfnInit)(void), void (*pfnFini)(void),
+                      void (*pfnRtldFini)(void), void *pvStackEnd)
+{
+    FNLIBCSTARTMAIN *pfnReal = (FNLIBCSTARTMAIN *)dlsym(RTLD_NEXT, "__libc_start_main");
+    const char      *pszFd   = getenv(KWZYGOTE_FD_VAR);
+    if (pszFd && *pszFd)
+    {
+        char *pszNext;
+        long  lFd = strtol(pszFd, &pszNext, 10);
+        if (!*pszNext && lFd > 2 && lFd < 65536)
+        {
+            g_fdSocket    = (int)lFd;
+            g_pfnToolMain = pfnMain;
+            pfnMain       = kwZygoteMain;
+        }
+    }
+    return pfnReal(pfnMain, argc, argv, pfnInit, pfnFini, pfnRtldFini, pvStackEnd);
+}
@@ -80,6 +80,7 @@ setalias(shinstance *psh, char *name, char *val)
 	INTOFF;
 	ap = ckmalloc(psh, sizeof (struct alias));
 	ap->name = savestr(psh, name);
+	ap->flag = 0;
 	/*
 	 * XXX - HACK: in order that the parser will not finish reading the
 	 * alias value off the input before processing the next alias, we
@@ -175,6 +176,34 @@ rmaliases(shinstance *psh)
 	INTON;
 }
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * Copy the aliases of the parent shell into a subshell that is to run
+ * on a thread of its own.
+ */
+void
+subshellinitalias(shinstance *psh, shinstance *inherit)
+{
+	struct alias *src, *ap, **app;
+	int i;
+
+	for (i = 0; i < ATABSIZE; i++) {
+		app = &psh->atab[i];
+		for (src = inherit->atab[i]; src; src = src->next) {
+			if (*src->name == '\0')
+				continue;	/* unaliased while in use */
+			ap = ckmalloc(psh, sizeof (struct alias));
+			ap->name = savestr(psh, src->name);
+			ap->val = savestr(psh, src->val);
+			ap->flag = 0;
+			*app = ap;
+			app = &ap->next;
+		}
+		*app = NULL;
+	}
+}
+#endif
+
 struct alias *
 lookupalias(shinstance *psh, char *name, int check)
 {
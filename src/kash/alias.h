@@ -48,3 +48,6 @@ char *get_alias_text(struct shinstance *, char *);
 int aliascmd(struct shinstance *, int, char **);
 int unaliascmd(struct shinstance *, int, char **);
 void rmaliases(struct shinstance *);
+#ifdef SH_THREADED_SUBSHELLS
+void subshellinitalias(struct shinstance *, struct shinstance *);
+#endif
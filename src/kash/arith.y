@@ -48,6 +48,9 @@ __RCSID("$NetBSD: arith.y,v 1.17 2003/09/17 17:33:36 jmmv Exp $");
 #include "output.h"
 #include "memalloc.h"
 #include "shinstance.h"
+#ifdef SH_EMBEDDED_MODE
+# include <pthread.h>
+#endif
 
 shinstance *arith_psh;
 const char *arith_buf, *arith_startbuf;
@@ -125,15 +128,34 @@ int
 arith(shinstance *psh, const char *s)
 {
 	long result;
+#ifdef SH_EMBEDDED_MODE
+	/* The parser and lexer state is global and the shells are threads. */
+	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	struct jmploc jmploc;
+	struct jmploc *volatile savehandler = psh->handler;
+#endif
 
 	INTOFF;
-/* todo lock */
+#ifdef SH_EMBEDDED_MODE
+	pthread_mutex_lock(&mtx);
+	if (setjmp(jmploc.loc)) {
+		arith_lex_reset();
+		arith_psh = NULL;
+		pthread_mutex_unlock(&mtx);
+		psh->handler = savehandler;
+		longjmp(psh->handler->loc, 1);
+	}
+	psh->handler = &jmploc;
+#endif
    arith_psh = psh;
 	arith_buf = arith_startbuf = s;
 	result = yyparse();
 	arith_lex_reset();	/* reprime lex */
    arith_psh = NULL;
-/* todo unlock */
+#ifdef SH_EMBEDDED_MODE
+	psh->handler = savehandler;
+	pthread_mutex_unlock(&mtx);
+#endif
 	INTON;
 
 	return (result);
@@ -326,6 +326,22 @@ pwdcmd(shinstance *psh, int argc, char **argv)
 }
 
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * Copy the current and previous directories of the parent shell into a
+ * subshell that is to run on a thread of its own.
+ */
+
+void
+subshellinitcd(shinstance *psh, shinstance *inherit)
+{
+	psh->curdir = inherit->curdir ? savestr(psh, inherit->curdir) : NULL;
+	psh->prevdir = inherit->prevdir ? savestr(psh, inherit->prevdir) : NULL;
+	psh->getpwd_first = inherit->getpwd_first;
+}
+#endif
+
+
 
 
 #define MAXPWD 256
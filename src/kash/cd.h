@@ -33,6 +33,9 @@
 const char *getpwd(struct shinstance *, int);
 int	cdcmd(struct shinstance *, int, char **);
 int	pwdcmd(struct shinstance *, int, char **);
+#ifdef SH_THREADED_SUBSHELLS
+void	subshellinitcd(struct shinstance *, struct shinstance *);
+#endif
 #ifdef PC_DRIVE_LETTERS
 #define IS_ROOT(path) (   *(path) == '/' \
                        || *(path) == '\\' \
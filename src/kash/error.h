@@ -101,6 +101,11 @@ extern volatile int intpending;*/
 # define __attribute__(a)
 #endif
 
+#ifdef SH_EMBEDDED_MODE
+/* kmk has an error() function of its own. */
+# define error sh_error
+#endif
+
 SH_NORETURN_1 void exraise(struct shinstance *, int) SH_NORETURN_2;
 void onint(struct shinstance *);
 SH_NORETURN_1 void error(struct shinstance *, const char *, ...) SH_NORETURN_2;
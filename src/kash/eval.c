@@ -102,8 +102,12 @@ STATIC void evalloop(shinstance *, union node *, int);
 STATIC void evalfor(shinstance *, union node *, int);
 STATIC void evalcase(shinstance *, union node *, int);
 STATIC void evalsubshell(shinstance *, union node *, int);
+STATIC void evalsubshellchild(shinstance *, union node *, void *);
+STATIC size_t saveredirnames(union node *, char *);
 STATIC void expredir(shinstance *, union node *);
 STATIC void evalpipe(shinstance *, union node *);
+STATIC void evalpipechild(shinstance *, union node *, void *);
+STATIC void evalbackcmdchild(shinstance *, union node *, void *);
 STATIC void evalcommand(shinstance *, union node *, int, struct backcmd *);
 STATIC void prehash(shinstance *, union node *);
 
@@ -422,21 +426,84 @@ evalsubshell(shinstance *psh, union node *n, int flags)
 {
 	struct job *jp;
 	int backgnd = (n->type == NBACKGND);
+	struct stackmark smark;
+	size_t cbarg;
+	char *argp;
 
 	expredir(psh, n->nredir.redirect);
+	if (backgnd)
+		flags &=~ EV_TESTED;
+	/* The child gets the flags and the expanded file names, the latter
+	   aren't part of the node when it's copied for a subshell thread. */
+	setstackmark(psh, &smark);
+	cbarg = sizeof(int) + saveredirnames(n->nredir.redirect, NULL);
+	argp = stalloc(psh, cbarg);
+	*(int *)argp = flags;
+	saveredirnames(n->nredir.redirect, argp + sizeof(int));
 	INTOFF;
 	jp = makejob(psh, n, 1);
-	if (forkshell(psh, jp, n, backgnd ? FORK_BG : FORK_FG) == 0) {
-		INTON;
-		if (backgnd)
-			flags &=~ EV_TESTED;
-		redirect(psh, n->nredir.redirect, 0);
-		/* never returns */
-		evaltree(psh, n->nredir.n, flags | EV_EXIT);
-	}
+	forkshell2(psh, jp, n, backgnd ? FORK_BG : FORK_FG,
+		   evalsubshellchild, argp, cbarg);
 	if (! backgnd)
 		psh->exitstatus = waitforjob(psh, jp);
 	INTON;
+	popstackmark(psh, &smark);
+}
+
+STATIC void
+evalsubshellchild(shinstance *psh, union node *n, void *argp)
+{
+	int flags = *(int *)argp;
+	char *name = (char *)argp + sizeof(int);
+	union node *redir;
+
+	INTON;
+	for (redir = n->nredir.redirect ; redir ; redir = redir->nfile.next) {
+		switch (redir->type) {
+		case NFROMTO:
+		case NFROM:
+		case NTO:
+		case NCLOBBER:
+		case NAPPEND:
+			redir->nfile.expfname = name;
+			name += strlen(name) + 1;
+			break;
+		}
+	}
+	redirect(psh, n->nredir.redirect, 0);
+	/* never returns */
+	evaltree(psh, n->nredir.n, flags | EV_EXIT);
+}
+
+
+
+/*
+ * Copy the file names computed by expredir into buf, one after the other.
+ * Returns the size required, buf may be NULL to just get that.
+ */
+
+STATIC size_t
+saveredirnames(union node *n, char *buf)
+{
+	union node *redir;
+	size_t cb = 0;
+	size_t len;
+
+	for (redir = n ; redir ; redir = redir->nfile.next) {
+		switch (redir->type) {
+		case NFROMTO:
+		case NFROM:
+		case NTO:
+		case NCLOBBER:
+		case NAPPEND:
+			len = strlen(redir->nfile.expfname) + 1;
+			if (buf)
+				memcpy(buf + cb, redir->nfile.expfname, len);
+			cb += len;
+			break;
+		}
+	}
+	return cb;
 }
 
 
@@ -490,6 +557,7 @@ evalpipe(shinstance *psh, union node *n)
 	int pipelen;
 	int prevfd;
 	int pip[2];
+	int fds[3];
 
 	TRACE((psh, "evalpipe(0x%lx) called\n", (long)n));
 	pipelen = 0;
@@ -507,19 +575,11 @@ evalpipe(shinstance *psh, union node *n)
 				error(psh, "Pipe call failed");
 			}
 		}
-		if (forkshell(psh, jp, lp->n, n->npipe.backgnd ? FORK_BG : FORK_FG) == 0) {
-			INTON;
-			if (prevfd > 0) {
-				movefd(psh, prevfd, 0);
-			}
-			if (pip[1] >= 0) {
-				shfile_close(&psh->fdtab, pip[0]);
-				if (pip[1] != 1) {
-					movefd(psh, pip[1], 1);
-				}
-			}
-			evaltree(psh, lp->n, EV_EXIT);
-		}
+		fds[0] = prevfd;
+		fds[1] = pip[0];
+		fds[2] = pip[1];
+		forkshell2(psh, jp, lp->n, n->npipe.backgnd ? FORK_BG : FORK_FG,
+			   evalpipechild, fds, sizeof(fds));
 		if (prevfd >= 0)
 			shfile_close(&psh->fdtab, prevfd);
 		prevfd = pip[0];
@@ -532,6 +592,25 @@ evalpipe(shinstance *psh, union node *n)
 	INTON;
 }
 
+/* fds = { prevfd, pip[0], pip[1] } */
+STATIC void
+evalpipechild(shinstance *psh, union node *n, void *argp)
+{
+	int *fds = (int *)argp;
+
+	INTON;
+	if (fds[0] > 0) {
+		movefd(psh, fds[0], 0);
+	}
+	if (fds[2] >= 0) {
+		shfile_close(&psh->fdtab, fds[1]);
+		if (fds[2] != 1) {
+			movefd(psh, fds[2], 1);
+		}
+	}
+	evaltree(psh, n, EV_EXIT);
+}
+
 
 
 /*
@@ -573,16 +652,7 @@ evalbackcmd(shinstance *psh, union node *n, struct backcmd *result)
 		if (sh_pipe(psh, pip) < 0)
 			error(psh, "Pipe call failed");
 		jp = makejob(psh, n, 1);
-		if (forkshell(psh, jp, n, FORK_NOJOB) == 0) {
-			FORCEINTON;
-			shfile_close(&psh->fdtab, pip[0]);
-			if (pip[1] != 1) {
-				movefd(psh, pip[1], 1);
-			}
-			eflag(psh) = 0;
-			evaltree(psh, n, EV_EXIT);
-			/* NOTREACHED */
-		}
+		forkshell2(psh, jp, n, FORK_NOJOB, evalbackcmdchild, pip, sizeof(pip));
 		shfile_close(&psh->fdtab, pip[1]);
 		result->fd = pip[0];
 		result->jp = jp;
@@ -594,6 +664,21 @@ out:
 		result->fd, result->buf, result->nleft, result->jp));
 }
 
+STATIC void
+evalbackcmdchild(shinstance *psh, union node *n, void *argp)
+{
+	int *pip = (int *)argp;
+
+	FORCEINTON;
+	shfile_close(&psh->fdtab, pip[0]);
+	if (pip[1] != 1) {
+		movefd(psh, pip[1], 1);
+	}
+	eflag(psh) = 0;
+	evaltree(psh, n, EV_EXIT);
+	/* NOTREACHED */
+}
+
 static const char *
 syspath(shinstance *psh)
 {
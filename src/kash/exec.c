@@ -976,6 +976,39 @@ deletefuncs(shinstance *psh)
 }
 
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * Copy the command hash table, functions included, of the parent shell
+ * into a subshell that is to run on a thread of its own.
+ */
+
+void
+subshellinitexec(shinstance *psh, shinstance *inherit)
+{
+	struct tblentry *const *srcp;
+	struct tblentry **pp;
+	struct tblentry *src;
+	struct tblentry *cmdp;
+	size_t size;
+
+	for (srcp = inherit->cmdtable; srcp < &inherit->cmdtable[CMDTABLESIZE]; srcp++) {
+		pp = &psh->cmdtable[srcp - inherit->cmdtable];
+		for (src = *srcp; src; src = src->next) {
+			size = sizeof (struct tblentry) - ARB + strlen(src->cmdname) + 1;
+			cmdp = ckmalloc(psh, size);
+			memcpy(cmdp, src, size);
+			if (cmdp->cmdtype == CMDFUNCTION)
+				cmdp->param.func = copyfunc(psh, src->param.func);
+			*pp = cmdp;
+			pp = &cmdp->next;
+		}
+		*pp = NULL;
+	}
+	psh->builtinloc = inherit->builtinloc;
+}
+#endif
+
+
 
 /*
  * Locate a command in the command hash table.  If "add" is nonzero,
@@ -985,7 +1018,7 @@ deletefuncs(shinstance *psh)
  * entry.
  */
 
-struct tblentry **lastcmdentry;
+/*struct tblentry **lastcmdentry;*/
 
 
 STATIC struct tblentry *
@@ -1017,7 +1050,7 @@ cmdlookup(shinstance *psh, const char *name, int add)
 		strcpy(cmdp->cmdname, name);
 		INTON;
 	}
-	lastcmdentry = pp;
+	psh->lastcmdentry = pp;
 	return cmdp;
 }
 
@@ -1031,8 +1064,8 @@ delete_cmd_entry(shinstance *psh)
 	struct tblentry *cmdp;
 
 	INTOFF;
-	cmdp = *lastcmdentry;
-	*lastcmdentry = cmdp->next;
+	cmdp = *psh->lastcmdentry;
+	*psh->lastcmdentry = cmdp->next;
 	ckfree(psh, cmdp);
 	INTON;
 }
@@ -85,5 +85,8 @@ void defun(struct shinstance *, char *, union node *);
 int unsetfunc(struct shinstance *, char *);
 int typecmd(struct shinstance *, int, char **);
 void hash_special_builtins(struct shinstance *);
+#ifdef SH_THREADED_SUBSHELLS
+void subshellinitexec(struct shinstance *, struct shinstance *);
+#endif
 
 #endif
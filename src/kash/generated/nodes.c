@@ -49,6 +49,9 @@
 #include "machdep.h"
 #include "mystring.h"
 #include "shinstance.h"
+#ifdef SH_EMBEDDED_MODE
+# include <pthread.h>
+#endif
 
 
 size_t  funcblocksize;		/* size of structures in function */
@@ -103,14 +106,41 @@ copyfunc(psh, n)
     struct shinstance *psh;
 	union node *n;
 {
+#ifdef SH_EMBEDDED_MODE
+	/* The copying state is global and the shells are threads.  The lock
+	   isn't held while allocating as that may raise an error. */
+	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	size_t blocksize, stringsize;
+	pointer block;
+#endif
+
 	if (n == NULL)
 		return NULL;
+#ifdef SH_EMBEDDED_MODE
+	pthread_mutex_lock(&mtx);
+	funcblocksize = 0;
+	funcstringsize = 0;
+	calcsize(n);
+	blocksize = funcblocksize;
+	stringsize = funcstringsize;
+	pthread_mutex_unlock(&mtx);
+
+	block = ckmalloc(psh, blocksize + stringsize);
+
+	pthread_mutex_lock(&mtx);
+	funcblock = block;
+	funcstring = (char *) block + blocksize;
+	n = copynode(n);
+	pthread_mutex_unlock(&mtx);
+	return n;
+#else
 	funcblocksize = 0;
 	funcstringsize = 0;
 	calcsize(n);
 	funcblock = ckmalloc(psh, funcblocksize + funcstringsize);
 	funcstring = (char *) funcblock + funcblocksize;
 	return copynode(n);
+#endif
 }
 
 
@@ -797,6 +797,89 @@ forkshell(shinstance *psh, struct job *jp, union node *n, int mode)
 	}
 }
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * What a subshell thread is started with, followed by a copy of the
+ * argument package for the child function.
+ */
+struct forkthread {
+	void (*child)(shinstance *, union node *, void *);
+	union node *n;			/* copy of the node */
+	int mode;
+};
+
+/*
+ * The subshell thread.  Sets up an exception handler like the one in main
+ * and does what forkshell does in a forked child before calling the child
+ * function.
+ */
+STATIC void
+forkthreadmain(shinstance *psh, void *pvuser)
+{
+	struct forkthread *ft = pvuser;
+	struct jmploc jmploc;
+
+	if (setjmp(jmploc.loc)) {
+		if (psh->exception == EXEXEC)
+			psh->exitstatus = psh->exerrno;
+		else if (psh->exception == EXERROR)
+			psh->exitstatus = 2;
+		exitshell(psh, psh->exitstatus);
+	}
+	psh->handler = &jmploc;
+	forkchild(psh, NULL, ft->n, ft->mode, 0);
+	ft->child(psh, ft->n, ft + 1);
+	/* NOTREACHED */
+}
+#endif
+
+/*
+ * Like forkshell, except that the child side is done by calling the child
+ * function with N and ARGP, and it must not return.  Where the host process
+ * allows it (SH_THREADED_SUBSHELLS), a foreground subshell runs on a thread
+ * instead of in a forked process.  It then gets copies of the shell state,
+ * of N and of the CBARG bytes at ARGP, since the parent carries on.
+ */
+
+int
+forkshell2(shinstance *psh, struct job *jp, union node *n, int mode,
+	   void (*child)(shinstance *, union node *, void *),
+	   void *argp, size_t cbarg)
+{
+	int pid;
+
+#ifdef SH_THREADED_SUBSHELLS
+	if (mode != FORK_BG && g_sh_embedded_host) {
+		shinstance *pshchild;
+		struct forkthread *ft;
+
+		TRACE((psh, "forkshell2(%%%d, %p, %d) called\n", jp - psh->jobtab, n, mode));
+		pid = -1;
+		pshchild = sh_create_subshell(psh);
+		if (pshchild) {
+			ft = ckmalloc(pshchild, sizeof(*ft) + cbarg);
+			ft->child = child;
+			ft->n = copyfunc(pshchild, n);
+			ft->mode = mode;
+			memcpy(ft + 1, argp, cbarg);
+			pid = sh_thread_subshell(pshchild, forkthreadmain, ft);
+		}
+		if (pid == -1) {
+			TRACE((psh, "Subshell thread failed, errno=%d\n", errno));
+			INTON;
+			error(psh, "Cannot fork");
+		}
+		return forkparent(psh, jp, n, mode, pid);
+	}
+#endif
+	pid = forkshell(psh, jp, n, mode);
+	if (pid == 0) {
+		child(psh, n, argp);
+		/* NOTREACHED */
+	}
+	return pid;
+}
+
 int
 forkparent(shinstance *psh, struct job *jp, union node *n, int mode, pid_t pid)
 {
@@ -95,6 +95,8 @@ int jobidcmd(struct shinstance *, int, char **);
 union node;
 struct job *makejob(struct shinstance *, union node *, int);
 int forkshell(struct shinstance *, struct job *, union node *, int);
+int forkshell2(struct shinstance *, struct job *, union node *, int,
+	       void (*)(struct shinstance *, union node *, void *), void *, size_t);
 void forkchild(struct shinstance *, struct job *, union node *, int, int);
 int forkparent(struct shinstance *, struct job *, union node *, int, pid_t);
 int waitforjob(struct shinstance *, struct job *);
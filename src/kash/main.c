@@ -83,13 +83,15 @@ STATIC union node *prevcmd;
 
 STATIC void read_profile(struct shinstance *, const char *);
 STATIC char *find_dot_file(struct shinstance *, char *);
-int main(int, char **, char **);
 SH_NORETURN_1 void shell_main(shinstance *, int, char **) SH_NORETURN_2;
+#ifndef SH_EMBEDDED_MODE
+int main(int, char **, char **);
 #ifdef _MSC_VER
 extern void init_syntax(void);
 #endif
 STATIC int usage(const char *argv0);
 STATIC int version(const char *argv0);
+#endif
 
 /*
  * Main routine.  We initialize things, parse the arguments, execute
@@ -99,6 +101,7 @@ STATIC int version(const char *argv0);
  * is used to figure out how far we had gotten.
  */
 
+#ifndef SH_EMBEDDED_MODE
 int
 #if K_OS == K_OS_WINDOWS
 real_main(int argc, char **argv, char **envp)
@@ -138,6 +141,38 @@ main(int argc, char **argv, char **envp)
 	return 89;
 }
 
+#else /* SH_EMBEDDED_MODE */
+
+/*
+ * Runs a shell on the calling thread of the host process (kmk) and returns
+ * the wait status of it, as if it had been a child process.  The fds are the
+ * standard input, output and error handles to give the shell and pid is the
+ * fake process id the host has assigned it.
+ */
+
+int
+sh_embedded_main(int argc, char **argv, char **envp, int const *fds, pid_t pid)
+{
+	shinstance *psh;
+	jmp_buf exitloc;
+	int status;
+
+	sh_embedded_init();
+	psh = sh_create_embedded_shell(argc, argv, envp, fds, pid);
+	if (!psh)
+		return 2 << 8;
+	shthread_set_shell(psh);
+	psh->embexit = &exitloc;
+	if (!setjmp(exitloc))
+		shell_main(psh, argc, psh->argptr);
+	status = psh->embstatus;
+	shthread_set_shell(NULL);
+	sh_destroy_embedded_shell(psh);
+	return status;
+}
+
+#endif /* SH_EMBEDDED_MODE */
+
 SH_NORETURN_1 void
 shell_main(shinstance *psh, int argc, char **argv)
 {
@@ -432,6 +467,7 @@ exitcmd(struct shinstance *psh, int argc, char **argv)
 	return 1;
 }
 
+#ifndef SH_EMBEDDED_MODE
 
 STATIC const char *
 strip_argv0(const char *argv0, unsigned *lenp)
@@ -482,6 +518,8 @@ version(const char *argv0)
 	return 0;
 }
 
+#endif /* !SH_EMBEDDED_MODE */
+
 
 /*
  * Local Variables:
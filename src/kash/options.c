@@ -311,6 +311,40 @@ freeparam(shinstance *psh, volatile struct shparam *param)
 }
 
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * Copy the options and positional parameters of the parent shell into a
+ * subshell that is to run on a thread of its own.
+ */
+
+void
+subshellinitoptions(shinstance *psh, shinstance *inherit)
+{
+	struct shparam *src = &inherit->shellparam;
+	char **ap;
+	int i;
+
+	memcpy(psh->optlist, inherit->optlist, sizeof(psh->optlist));
+	psh->minusc = inherit->minusc ? savestr(psh, inherit->minusc) : NULL;
+	psh->arg0 = inherit->arg0 ? savestr(psh, inherit->arg0) : NULL;
+
+	psh->shellparam = *src;
+	psh->shellparam.malloc = 1;
+	psh->shellparam.p = ap = ckmalloc(psh, (src->nparam + 1) * sizeof *ap);
+	psh->shellparam.optptr = NULL;
+	for (i = 0; src->p[i]; i++) {
+		ap[i] = savestr(psh, src->p[i]);
+		if (src->optptr >= src->p[i]
+		 && src->optptr <= src->p[i] + strlen(src->p[i]))
+			psh->shellparam.optptr = ap[i] + (src->optptr - src->p[i]);
+	}
+	ap[i] = NULL;
+	if (src->optnext)
+		psh->shellparam.optnext = ap + (src->optnext - src->p);
+}
+#endif
+
+
 
 /*
  * The shift builtin command.
@@ -133,6 +133,9 @@ void procargs(struct shinstance *, int, char **);
 void optschanged(struct shinstance *);
 void setparam(struct shinstance *, char **);
 void freeparam(struct shinstance *, volatile struct shparam *);
+#ifdef SH_THREADED_SUBSHELLS
+void subshellinitoptions(struct shinstance *, struct shinstance *);
+#endif
 int shiftcmd(struct shinstance *, int, char **);
 int setcmd(struct shinstance *, int, char **);
 int getoptscmd(struct shinstance *, int, char **);
@@ -487,6 +487,12 @@ xwrite(shinstance *psh, int fd, char *buf, size_t nbytes)
 			if (++ntry > 10)
 				return (int)(nbytes - n);
 		} else if (errno != EINTR) {
+#ifdef SH_EMBEDDED_MODE
+			/* SIGPIPE is either blocked or fatal to the host process,
+			   so do what it would have done to a shell process. */
+			if (errno == EPIPE && g_sh_embedded_host)
+				sh_raise_sigpipe(psh);
+#endif
 			return -1;
 		}
 	}
@@ -89,6 +89,7 @@ struct redirtab {
 
 STATIC void openredirect(shinstance *, union node *, char[10], int);
 STATIC int openhere(shinstance *, union node *);
+STATIC void openherechild(shinstance *, union node *, void *);
 
 
 /*
@@ -249,11 +250,19 @@ eopen:
  * the pipe without forking.
  */
 
+/* What openherechild needs besides the document. */
+struct openhereargs {
+	int pip[2];
+	size_t len;
+	int expand;
+};
+
 STATIC int
 openhere(shinstance *psh, union node *redir)
 {
 	int pip[2];
 	size_t len = 0;
+	struct openhereargs args;
 
 	if (shfile_pipe(&psh->fdtab, pip) < 0)
 		error(psh, "Pipe call failed");
@@ -264,26 +273,37 @@ openhere(shinstance *psh, union node *redir)
 			goto out;
 		}
 	}
-	if (forkshell(psh, (struct job *)NULL, (union node *)NULL, FORK_NOJOB) == 0) {
-		shfile_close(&psh->fdtab, pip[0]);
-		sh_signal(psh, SIGINT, SH_SIG_IGN);
-		sh_signal(psh, SIGQUIT, SH_SIG_IGN);
-		sh_signal(psh, SIGHUP, SH_SIG_IGN);
-#ifdef SIGTSTP
-		sh_signal(psh, SIGTSTP, SH_SIG_IGN);
-#endif
-		sh_signal(psh, SIGPIPE, SH_SIG_DFL);
-		if (redir->type == NHERE)
-			xwrite(psh, pip[1], redir->nhere.doc->narg.text, len);
-		else
-			expandhere(psh, redir->nhere.doc, pip[1]);
-		sh__exit(psh, 0);
-	}
+	args.pip[0] = pip[0];
+	args.pip[1] = pip[1];
+	args.len = len;
+	args.expand = redir->type != NHERE;
+	forkshell2(psh, (struct job *)NULL, redir->nhere.doc, FORK_NOJOB,
+		   openherechild, &args, sizeof(args));
 out:
 	shfile_close(&psh->fdtab, pip[1]);
 	return pip[0];
 }
 
+STATIC void
+openherechild(shinstance *psh, union node *doc, void *argp)
+{
+	struct openhereargs *args = (struct openhereargs *)argp;
+
+	shfile_close(&psh->fdtab, args->pip[0]);
+	sh_signal(psh, SIGINT, SH_SIG_IGN);
+	sh_signal(psh, SIGQUIT, SH_SIG_IGN);
+	sh_signal(psh, SIGHUP, SH_SIG_IGN);
+#ifdef SIGTSTP
+	sh_signal(psh, SIGTSTP, SH_SIG_IGN);
+#endif
+	sh_signal(psh, SIGPIPE, SH_SIG_DFL);
+	if (!args->expand)
+		xwrite(psh, args->pip[1], doc->narg.text, args->len);
+	else
+		expandhere(psh, doc, args->pip[1]);
+	sh__exit(psh, 0);
+}
+
 
 
 /*
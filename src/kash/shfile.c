@@ -27,6 +27,9 @@
 /*******************************************************************************
 *   Header Files                                                               *
 *******************************************************************************/
+#if defined(SH_EMBEDDED_MODE) && defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* pipe2 */
+#endif
 #include "shfile.h"
 #include "shinstance.h" /* TRACE2 */
 #include <stdlib.h>
@@ -61,7 +64,8 @@
  */
 #if K_OS == K_OS_WINDOWS \
  || K_OS == K_OS_OPENBSD /* because of ugly pthread library pipe hacks */ \
- || !defined(SH_FORKED_MODE)
+ || !defined(SH_FORKED_MODE) \
+ || defined(SH_EMBEDDED_MODE) /* the shells share the host process */
 # define SHFILE_IN_USE
 #endif
 /** The max file table size. */
@@ -70,6 +74,19 @@
 #define SHFILE_GROW         64
 /** The min native unix file descriptor. */
 #define SHFILE_UNIX_MIN_FD  32
+/** @def SHFILE_UNIX_F_DUPFD
+ * The fcntl command for copying native unix file descriptors.  When running
+ * in the host process (SH_EMBEDDED_MODE) the natives must not leak into the
+ * programs started by the other threads, so they're created close-on-exec. */
+/** @def SHFILE_UNIX_O_CLOEXEC
+ * The open flag to go with SHFILE_UNIX_F_DUPFD. */
+#if defined(SH_EMBEDDED_MODE) && defined(F_DUPFD_CLOEXEC)
+# define SHFILE_UNIX_F_DUPFD    F_DUPFD_CLOEXEC
+# define SHFILE_UNIX_O_CLOEXEC  O_CLOEXEC
+#else
+# define SHFILE_UNIX_F_DUPFD    F_DUPFD
+# define SHFILE_UNIX_O_CLOEXEC  0
+#endif
 /** The path buffer size we use. */
 #define SHFILE_MAX_PATH     4096
 
@@ -308,7 +325,7 @@ static int shfile_copy_insert_and_close(shfdtab *pfdtab, int *pnative, unsigned
 {
     int fd          = -1;
     int s           = errno;
-    int native_copy = fcntl(*pnative, F_DUPFD, SHFILE_UNIX_MIN_FD);
+    int native_copy = fcntl(*pnative, SHFILE_UNIX_F_DUPFD, SHFILE_UNIX_MIN_FD);
     close(*pnative);
     *pnative = -1;
     errno = s;
@@ -829,6 +846,149 @@ int shfile_init(shfdtab *pfdtab, shfdtab *inherit)
     return rc;
 }
 
+#ifdef SH_EMBEDDED_MODE
+
+/**
+ * Initializes the file descriptor table of a shell running in the host
+ * process.
+ *
+ * @returns 0 on success, -1 and errno on failure.
+ * @param   pfdtab      The table to initialize.
+ * @param   fds         The native standard input, output and error handles
+ *                      to use, -1 for closed.  These are copied, the caller
+ *                      keeps the originals.
+ */
+int shfile_init_embedded(shfdtab *pfdtab, int const *fds)
+{
+    char buf[SHFILE_MAX_PATH];
+    int rc;
+    int fd;
+
+    pfdtab->cwd  = NULL;
+    pfdtab->size = 0;
+    pfdtab->tab  = NULL;
+    rc = shmtx_init(&pfdtab->mtx);
+    if (rc)
+        return rc;
+    if (!getcwd(buf, sizeof(buf)))
+        return -1;
+    pfdtab->cwd = sh_strdup(NULL, buf);
+
+    for (fd = 0; fd < 3 && !rc; fd++)
+    {
+        struct stat st;
+        int oflags;
+        int native;
+        int fd2;
+        int fFlags2;
+
+        if (   fds[fd] == -1
+            || (oflags = fcntl(fds[fd], F_GETFL, 0)) == -1
+            || fstat(fds[fd], &st) == -1)
+            continue;
+        if (S_ISREG(st.st_mode))
+            fFlags2 = SHFILE_FLAGS_FILE;
+        else if (S_ISDIR(st.st_mode))
+            fFlags2 = SHFILE_FLAGS_DIR;
+        else if (S_ISFIFO(st.st_mode))
+            fFlags2 = SHFILE_FLAGS_PIPE;
+        else
+            fFlags2 = SHFILE_FLAGS_TTY;
+
+        native = fcntl(fds[fd], SHFILE_UNIX_F_DUPFD, SHFILE_UNIX_MIN_FD);
+        if (native == -1)
+            rc = -1;
+        else
+        {
+            fd2 = shfile_insert(pfdtab, native, oflags, fFlags2, fd, "shfile_init_embedded");
+            assert(fd2 == fd); (void)fd2;
+            if (fd2 != fd)
+                rc = -1;
+        }
+    }
+    return rc;
+}
+
+# ifdef SH_THREADED_SUBSHELLS
+/**
+ * Initializes the file descriptor table of a subshell running on a thread in
+ * the host process, duplicating all the descriptors of the parent shell.
+ *
+ * Called by the parent thread.  The table is allocated without associating
+ * it with either shell, so it's safe to grow and free from the child thread.
+ *
+ * @returns 0 on success, -1 and errno on failure.
+ * @param   pfdtab      The table to initialize.
+ * @param   inherit     The table of the parent shell.
+ */
+int shfile_init_subshell(shfdtab *pfdtab, shfdtab *inherit)
+{
+    shmtxtmp tmp;
+    unsigned fd;
+    int rc;
+
+    pfdtab->cwd  = NULL;
+    pfdtab->size = 0;
+    pfdtab->tab  = NULL;
+    rc = shmtx_init(&pfdtab->mtx);
+    if (rc)
+        return rc;
+
+    shmtx_enter(&inherit->mtx, &tmp);
+    pfdtab->cwd = sh_strdup(NULL, inherit->cwd);
+    pfdtab->tab = sh_malloc(NULL, inherit->size * sizeof(shfile));
+    if (pfdtab->cwd && pfdtab->tab)
+    {
+        pfdtab->size = inherit->size;
+        for (fd = 0; fd < inherit->size; fd++)
+        {
+            pfdtab->tab[fd] = inherit->tab[fd];
+            if (inherit->tab[fd].fd != -1)
+            {
+                pfdtab->tab[fd].native = fcntl((int)inherit->tab[fd].native, SHFILE_UNIX_F_DUPFD, SHFILE_UNIX_MIN_FD);
+                if (pfdtab->tab[fd].native == -1)
+                {
+                    pfdtab->tab[fd].fd = -1;
+                    rc = -1;
+                }
+            }
+        }
+    }
+    else
+    {
+        errno = ENOMEM;
+        rc = -1;
+    }
+    shmtx_leave(&inherit->mtx, &tmp);
+
+    if (rc && pfdtab->tab)
+        shfile_uninit(pfdtab);
+    return rc;
+}
+# endif /* SH_THREADED_SUBSHELLS */
+
+/**
+ * Cleans up a file descriptor table of a shell running in the host process,
+ * closing all the native handles.
+ *
+ * @param   pfdtab      The table.
+ */
+void shfile_uninit(shfdtab *pfdtab)
+{
+    unsigned fd;
+    for (fd = 0; fd < pfdtab->size; fd++)
+        if (pfdtab->tab[fd].fd != -1)
+            shfile_native_close(pfdtab->tab[fd].native, pfdtab->tab[fd].oflags);
+    sh_free(NULL, pfdtab->tab);
+    sh_free(NULL, pfdtab->cwd);
+    pfdtab->tab  = NULL;
+    pfdtab->cwd  = NULL;
+    pfdtab->size = 0;
+    shmtx_delete(&pfdtab->mtx);
+}
+
+#endif /* SH_EMBEDDED_MODE */
+
 #if K_OS == K_OS_WINDOWS && defined(SHFILE_IN_USE)
 
 /**
@@ -1036,6 +1196,18 @@ int shfile_exec_unix(shfdtab *pfdtab)
 # ifdef SHFILE_IN_USE
     unsigned fd;
 
+#  ifdef SH_EMBEDDED_MODE
+    /* We may be a vfork child of the host process, whose current directory
+       and standard handles have nothing to do with the shell. */
+    if (chdir(pfdtab->cwd))
+        rc = -1;
+    for (fd = 0; fd < 3; fd++)
+        if (   fd >= pfdtab->size
+            || pfdtab->tab[fd].fd == -1
+            || (pfdtab->tab[fd].shflags & SHFILE_FLAGS_CLOSE_ON_EXEC))
+            close(fd);
+#  endif
+
     for (fd = 0; fd < pfdtab->size; fd++)
     {
         if (   pfdtab->tab[fd].fd != -1
@@ -1135,7 +1307,7 @@ int shfile_open(shfdtab *pfdtab, const char *name, unsigned flags, mode_t mode)
     fd = shfile_make_path(pfdtab, name, &absname[0]);
     if (!fd)
     {
-        fd = open(absname, flags, mode);
+        fd = open(absname, flags | SHFILE_UNIX_O_CLOEXEC, mode);
         if (fd != -1)
             fd = shfile_copy_insert_and_close(pfdtab, &fd, flags, 0, -1, "shfile_open");
     }
@@ -1178,7 +1350,11 @@ int shfile_pipe(shfdtab *pfdtab, int fds[2])
     int native_fds[2];
 
     fds[1] = fds[0] = -1;
+#  if defined(SH_EMBEDDED_MODE) && K_OS == K_OS_LINUX
+    if (!pipe2(native_fds, O_CLOEXEC))
+#  else
     if (!pipe(native_fds))
+#  endif
     {
         fds[0] = shfile_copy_insert_and_close(pfdtab, &native_fds[0], O_RDONLY, SHFILE_FLAGS_PIPE, -1, "shfile_pipe");
         if (fds[0] != -1)
@@ -1563,7 +1739,7 @@ int shfile_fcntl(shfdtab *pfdtab, int fd, int cmd, int arg)
                 else
                     rc = shfile_dos2errno(GetLastError());
 # else
-                int nativeNew = fcntl(file->native, F_DUPFD, SHFILE_UNIX_MIN_FD);
+                int nativeNew = fcntl(file->native, SHFILE_UNIX_F_DUPFD, SHFILE_UNIX_MIN_FD);
                 if (nativeNew != -1)
                     rc = shfile_insert(pfdtab, nativeNew, file->oflags, file->shflags, arg, "shfile_fcntl");
                 else
@@ -1667,6 +1843,23 @@ int shfile_chdir(shfdtab *pfdtab, const char *path)
     {
         char *abspath_copy = sh_strdup(psh, abspath);
         char *free_me = abspath_copy;
+# ifdef SH_EMBEDDED_MODE
+        /* The current directory of the host process isn't ours to change,
+           the native one is set by shfile_exec_unix. */
+        if (g_sh_embedded_host)
+        {
+            struct stat st;
+            rc = stat(abspath, &st);
+            if (!rc && !S_ISDIR(st.st_mode))
+            {
+                errno = ENOTDIR;
+                rc = -1;
+            }
+            if (!rc)
+                rc = access(abspath, X_OK);
+        }
+        else
+# endif
         rc = chdir(abspath);
         if (!rc)
         {
@@ -1914,6 +2107,12 @@ shdir *shfile_opendir(shfdtab *pfdtab, const char *dir)
     else
         errno = ENOSYS;
     return pdir;
+#elif defined(SHFILE_IN_USE)
+    char abspath[SHFILE_MAX_PATH];
+    TRACE2((NULL, "shfile_opendir: dir='%s'\n", dir));
+    if (shfile_make_path(pfdtab, dir, &abspath[0]))
+        return NULL;
+    return (shdir *)opendir(abspath);
 #else
     TRACE2((NULL, "shfile_opendir: dir='%s'\n", dir));
     return (shdir *)opendir(dir);
@@ -130,6 +130,13 @@ typedef struct shfdtab
 } shfdtab;
 
 int shfile_init(shfdtab *, shfdtab *);
+#ifdef SH_EMBEDDED_MODE
+int shfile_init_embedded(shfdtab *, int const *);
+# ifdef SH_THREADED_SUBSHELLS
+int shfile_init_subshell(shfdtab *, shfdtab *);
+# endif
+void shfile_uninit(shfdtab *);
+#endif
 void shfile_fork_win(shfdtab *pfdtab, int set, intptr_t *hndls);
 void *shfile_exec_win(shfdtab *pfdtab, int prepare, unsigned short *sizep, intptr_t *hndls);
 int shfile_exec_unix(shfdtab *pfdtab);
@@ -376,7 +376,69 @@ static void shheap_unlink_free(shmemhdr *mem)
     mem->next2 = mem->prev2 = SHHEAP_POISON_NULL(0x42);
 }
 
-#endif /* SHHEAP_IN_USE */
+#elif defined(SH_EMBEDDED_MODE)
+
+/** The size of the block header, a multiple of the malloc alignment. */
+# define SHHEAP_NODE_SIZE       16
+
+/**
+ * Links a new block into the list of the shell.
+ *
+ * Blocks allocated without a shell aren't tracked and just point to
+ * themselves so that unlinking them is harmless.
+ *
+ * @returns Pointer to the user part of the block, NULL if @a node is NULL.
+ * @param   psh     The shell instance, NULL if none.
+ * @param   node    The block.
+ */
+static void *shheap_link(shinstance *psh, shheapnode *node)
+{
+    if (!node)
+        return NULL;
+    if (psh)
+    {
+        node->prev = &psh->heapblocks;
+        node->next = psh->heapblocks.next;
+        node->next->prev = node;
+        psh->heapblocks.next = node;
+    }
+    else
+        node->next = node->prev = node;
+    return (char *)node + SHHEAP_NODE_SIZE;
+}
+
+/**
+ * Unlinks a block from the list it is on.
+ *
+ * @returns Pointer to the block header.
+ * @param   ptr     The user pointer.
+ */
+static shheapnode *shheap_unlink(void *ptr)
+{
+    shheapnode *node = (shheapnode *)((char *)ptr - SHHEAP_NODE_SIZE);
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    return node;
+}
+
+/**
+ * Frees all the blocks owned by a shell instance that is being destroyed.
+ *
+ * @param   psh     The shell instance.
+ */
+void shheap_free_all(shinstance *psh)
+{
+    shheapnode *node = psh->heapblocks.next;
+    while (node != &psh->heapblocks)
+    {
+        shheapnode *next = node->next;
+        free(node);
+        node = next;
+    }
+    psh->heapblocks.next = psh->heapblocks.prev = &psh->heapblocks;
+}
+
+#endif /* SH_EMBEDDED_MODE */
 
 
 /** free() */
@@ -460,6 +522,10 @@ void sh_free(shinstance *psh, void *ptr)
 
     SHHEAP_CHECK();
     shmtx_leave(&g_sh_heap_mtx, &tmp);
+#elif defined(SH_EMBEDDED_MODE)
+    if (ptr)
+        free(shheap_unlink(ptr));
+    (void)psh;
 #else
     if (ptr)
         free(ptr);
@@ -522,6 +588,8 @@ void *sh_malloc(shinstance *psh, size_t size)
 
     return mem + 1;
 
+#elif defined(SH_EMBEDDED_MODE)
+    return shheap_link(psh, (shheapnode *)malloc(SHHEAP_NODE_SIZE + size));
 #else
     (void)psh;
     return malloc(size);
@@ -537,6 +605,8 @@ void *sh_calloc(shinstance *psh, size_t num, size_t item_size)
     if (pv)
         pv = memset(pv, '\0', size);
     return pv;
+#elif defined(SH_EMBEDDED_MODE)
+    return shheap_link(psh, (shheapnode *)calloc(1, SHHEAP_NODE_SIZE + num * item_size));
 #else
     (void)psh;
     return calloc(num, item_size);
@@ -574,6 +644,34 @@ void *sh_realloc(shinstance *psh, void *old, size_t new_size)
         pv = NULL;
     }
     return pv;
+#elif defined(SH_EMBEDDED_MODE)
+    shheapnode *node;
+    shheapnode *prev;
+    shheapnode *new_node;
+    if (!old)
+        return sh_malloc(psh, new_size);
+    if (!new_size)
+    {
+        sh_free(psh, old);
+        return NULL;
+    }
+
+    /* Reinsert it at the same list position (or none if untracked). */
+    node = shheap_unlink(old);
+    prev = node->next != node ? node->prev : NULL;
+    new_node = (shheapnode *)realloc(node, SHHEAP_NODE_SIZE + new_size);
+    if (new_node)
+        node = new_node;
+    if (prev)
+    {
+        node->prev = prev;
+        node->next = prev->next;
+        node->next->prev = node;
+        prev->next = node;
+    }
+    else
+        node->next = node->prev = node;
+    return new_node ? (char *)new_node + SHHEAP_NODE_SIZE : NULL;
 #else
     return realloc(old, new_size);
 #endif
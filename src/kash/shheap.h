@@ -30,6 +30,21 @@
 
 #include "shtypes.h"
 
+#ifdef SH_EMBEDDED_MODE
+/**
+ * Heap block list node.
+ *
+ * In embedded mode each block is prefixed by one of these and linked into
+ * the list of the shell that allocated it, so the lot can be freed when the
+ * shell instance is destroyed.
+ */
+typedef struct shheapnode
+{
+    struct shheapnode  *next;
+    struct shheapnode  *prev;
+} shheapnode;
+#endif
+
 /* heap */
 int shheap_init(void *phead);
 void *shheap_get_head(void);
@@ -40,6 +55,9 @@ void *sh_calloc(shinstance *, size_t, size_t);
 void *sh_realloc(shinstance *, void *, size_t);
 char *sh_strdup(shinstance *, const char *);
 void  sh_free(shinstance *, void *);
+#ifdef SH_EMBEDDED_MODE
+void  shheap_free_all(shinstance *);
+#endif
 
 #endif
 
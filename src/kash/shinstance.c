@@ -46,6 +46,64 @@ extern pid_t shfork_do(shinstance *psh); /* shforkA-win.asm */
 #if !defined(HAVE_SYS_SIGNAME) && defined(DEBUG)
 extern void init_sys_signame(void);
 #endif
+#ifdef SH_EMBEDDED_MODE
+# include <pthread.h>
+# include <setjmp.h>
+# include <time.h>
+#endif
+#ifdef SH_THREADED_SUBSHELLS
+# include "alias.h"
+# include "cd.h"
+# include "input.h"
+# include "trap.h"
+#endif
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+#ifdef SH_THREADED_SUBSHELLS
+/** The stack size of subshell threads. */
+# define SH_SUBSHELL_STACK_SIZE     (2*1024*1024)
+/** The first fake process id for subshell threads. */
+# define SH_SUBSHELL_FIRST_PID      0x20000000
+/** The last fake process id for subshell threads. */
+# define SH_SUBSHELL_LAST_PID       0x3fffffff
+#endif
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+#ifdef SH_EMBEDDED_MODE
+/**
+ * A child process of a shell running in the host process.
+ *
+ * The host (kmk) reaps all its children with waitpid(-1), so the children of
+ * the shells are recorded here for the host to hand back the status of the
+ * ones it picks up (sh_embedded_child_reaped).
+ */
+typedef struct shembchild
+{
+    pid_t               pid;            /**< The process id. */
+    int                 status;         /**< The wait status if reaped. */
+    int                 reaped;         /**< Set when the child has been reaped. */
+    shinstance         *psh;            /**< The shell it belongs to, NULL if the shell is gone. */
+    int                 thread;         /**< Set if it's a subshell thread and not a process. */
+} shembchild;
+
+# ifdef SH_THREADED_SUBSHELLS
+/**
+ * What sh_int_subshell_thread is started with.
+ */
+typedef struct shsubshellthread
+{
+    shinstance         *psh;            /**< The subshell. */
+    void              (*pfn)(shinstance *, void *); /**< The subshell code. */
+    void               *pvUser;         /**< The argument to pfn. */
+} shsubshellthread;
+# endif
+#endif
 
 
 /*******************************************************************************
@@ -86,31 +144,106 @@ struct shsigstate
     int num_masked;
 }                   g_sig_state[NSIG];
 
+#ifdef SH_EMBEDDED_MODE
+/** Set while executing in the host process, see shinstance.h. */
+int                 g_sh_embedded_host = 0;
+/** Makes sure sh_embedded_init only does its job once. */
+static pthread_once_t g_sh_emb_once = PTHREAD_ONCE_INIT;
+/** Held shared while forking and recording the child, and exclusively by the
+ * host when handing over a child it reaped, so that it cannot get hold of a
+ * status before the child has been recorded. */
+static pthread_rwlock_t g_sh_emb_fork_lock = PTHREAD_RWLOCK_INITIALIZER;
+/** Protects the child table below. */
+static pthread_mutex_t g_sh_emb_mtx = PTHREAD_MUTEX_INITIALIZER;
+/** Broadcasted when the host has reaped one of the children or a shell has
+ * got a signal pending (shinstance::embsigpending). */
+static pthread_cond_t g_sh_emb_cond = PTHREAD_COND_INITIALIZER;
+/** The children of the shells in the host process. */
+static shembchild  *g_sh_emb_children;
+/** The number of entries in g_sh_emb_children. */
+static unsigned     g_sh_emb_num_children;
+/** The number of allocated entries in g_sh_emb_children. */
+static unsigned     g_sh_emb_max_children;
+/** The number of entries reserved by forks in progress. */
+static unsigned     g_sh_emb_reserved_children;
+# ifdef SH_THREADED_SUBSHELLS
+/** The next fake process id for a subshell thread, protected by g_sh_emb_mtx.
+ * These are kept clear of real pids and of the ones kmk hands out. */
+static pid_t        g_sh_emb_next_thread_pid = SH_SUBSHELL_FIRST_PID;
+# endif
+#endif
+
+
+
+#ifdef SH_EMBEDDED_MODE
+
+/* The shells run on threads in the host process, so these are for real.
+   They are recursive because the signal code takes g_sh_mtx recursively. */
+
+int shmtx_init(shmtx *pmtx)
+{
+    pthread_mutexattr_t attr;
+    int rc;
+    assert(sizeof(pthread_mutex_t) <= sizeof(pmtx->u));
+    rc = pthread_mutexattr_init(&attr);
+    if (!rc)
+    {
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        rc = pthread_mutex_init((pthread_mutex_t *)&pmtx->u, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    if (rc)
+    {
+        errno = rc;
+        return -1;
+    }
+    return 0;
+}
+
+void shmtx_delete(shmtx *pmtx)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)&pmtx->u);
+}
+
+void shmtx_enter(shmtx *pmtx, shmtxtmp *ptmp)
+{
+    pthread_mutex_lock((pthread_mutex_t *)&pmtx->u);
+    ptmp->i = 0;
+}
+
+void shmtx_leave(shmtx *pmtx, shmtxtmp *ptmp)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)&pmtx->u);
+    ptmp->i = 432;
+}
 
+#else /* !SH_EMBEDDED_MODE */
 
 int shmtx_init(shmtx *pmtx)
 {
-    pmtx->b[0] = 0;
+    pmtx->u.b[0] = 0;
     return 0;
 }
 
 void shmtx_delete(shmtx *pmtx)
 {
-    pmtx->b[0] = 0;
+    pmtx->u.b[0] = 0;
 }
 
 void shmtx_enter(shmtx *pmtx, shmtxtmp *ptmp)
 {
-    pmtx->b[0] = 0;
+    pmtx->u.b[0] = 0;
     ptmp->i = 0;
 }
 
 void shmtx_leave(shmtx *pmtx, shmtxtmp *ptmp)
 {
-    pmtx->b[0] = 0;
+    pmtx->u.b[0] = 0;
     ptmp->i = 432;
 }
 
+#endif /* !SH_EMBEDDED_MODE */
+
 /**
  * Links the shell instance.
  *
@@ -137,7 +270,7 @@ static void sh_int_link(shinstance *psh)
     shmtx_leave(&g_sh_mtx, &tmp);
 }
 
-#if 0
+#ifdef SH_EMBEDDED_MODE
 /**
  * Unlink the shell instance.
  *
@@ -223,16 +356,18 @@ static int sh_clone_string_vector(shinstance *psh, char ***dstp, char **src)
 }
 
 /**
- * Creates a root shell instance.
+ * Creates a shell instance.
  *
  * @param   inherit     The shell to inherit from. If NULL inherit from environment and such.
  * @param   argc        The argument count.
  * @param   argv        The argument vector.
  * @param   envp        The environment vector.
+ * @param   embfds      The stdin, stdout and stderr to use for a shell running
+ *                      in the host process (SH_EMBEDDED_MODE), NULL otherwise.
  *
- * @returns pointer to root shell on success, NULL on failure.
+ * @returns pointer to the shell on success, NULL on failure.
  */
-shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, char **envp)
+static shinstance *sh_int_create_shell(shinstance *inherit, int argc, char **argv, char **envp, int const *embfds)
 {
     shinstance *psh;
     int i;
@@ -244,12 +379,24 @@ shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, cha
     if (psh)
     {
         /* Init it enought for sh_destroy() to not get upset */
-          /* ... */
+#ifdef SH_EMBEDDED_MODE
+        psh->heapblocks.next = psh->heapblocks.prev = &psh->heapblocks;
+#endif
 
         /* Call the basic initializers. */
         if (    !sh_clone_string_vector(psh, &psh->shenviron, envp)
             &&  !sh_clone_string_vector(psh, &psh->argptr, argv)
+#ifdef SH_EMBEDDED_MODE
+            &&  !(embfds
+                  ? shfile_init_embedded(&psh->fdtab, embfds)
+# ifdef SH_THREADED_SUBSHELLS
+                  : inherit && g_sh_embedded_host
+                  ? shfile_init_subshell(&psh->fdtab, &inherit->fdtab)
+# endif
+                  : shfile_init(&psh->fdtab, inherit ? &inherit->fdtab : NULL)))
+#else
             &&  !shfile_init(&psh->fdtab, inherit ? &inherit->fdtab : NULL))
+#endif
         {
             /* the special stuff. */
 #ifdef _MSC_VER
@@ -261,10 +408,13 @@ shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, cha
             for (i = 0; i < NSIG; i++)
                 psh->sigactions[i].sh_handler = SH_SIG_UNK;
             if (inherit)
-                psh->sigmask = psh->sigmask;
+            {
+                memcpy(psh->sigactions, inherit->sigactions, sizeof(psh->sigactions));
+                psh->sigmask = inherit->sigmask;
+            }
             else
             {
-#if defined(_MSC_VER)
+#if defined(_MSC_VER) || defined(SH_EMBEDDED_MODE)
                 sh_sigemptyset(&psh->sigmask);
 #else
                 sigprocmask(SIG_SETMASK, NULL, &psh->sigmask);
@@ -311,11 +461,727 @@ shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, cha
             return psh;
         }
 
+#ifdef SH_EMBEDDED_MODE
+        shheap_free_all(psh);
+#endif
         sh_destroy(psh);
     }
+    (void)embfds;
+    return NULL;
+}
+
+/**
+ * Creates a root shell instance.
+ *
+ * @param   inherit     The shell to inherit from. If NULL inherit from environment and such.
+ * @param   argc        The argument count.
+ * @param   argv        The argument vector.
+ * @param   envp        The environment vector.
+ *
+ * @returns pointer to root shell on success, NULL on failure.
+ */
+shinstance *sh_create_root_shell(shinstance *inherit, int argc, char **argv, char **envp)
+{
+    return sh_int_create_shell(inherit, argc, argv, envp, NULL);
+}
+
+#ifdef SH_EMBEDDED_MODE
+
+/**
+ * One time initialization of the embedded mode, sh_embedded_init worker.
+ */
+static void sh_int_embedded_init_once(void)
+{
+    shmtx_init(&g_sh_mtx);
+    shthread_set_shell(NULL); /* allocates the TLS entry */
+    g_sh_embedded_host = 1;
+}
+
+/**
+ * Initializes the embedded mode, called before creating shells in the host
+ * process.
+ */
+void sh_embedded_init(void)
+{
+    pthread_once(&g_sh_emb_once, sh_int_embedded_init_once);
+}
+
+/**
+ * Creates a shell instance running on a thread in the host process.
+ *
+ * @returns pointer to the shell on success, NULL on failure.
+ * @param   argc        The argument count.
+ * @param   argv        The argument vector.
+ * @param   envp        The environment vector.
+ * @param   fds         The native stdin, stdout and stderr descriptors, -1
+ *                      if closed.  These are duplicated.
+ * @param   pid         The fake process id of the shell, unique among the
+ *                      shells in the host process.
+ */
+shinstance *sh_create_embedded_shell(int argc, char **argv, char **envp, int const *fds, pid_t pid)
+{
+    shinstance *psh = sh_int_create_shell(NULL, argc, argv, envp, fds);
+    if (psh)
+        psh->pid = pid;
+    return psh;
+}
+
+/**
+ * Destroys a shell instance created by sh_create_embedded_shell.
+ *
+ * Children that haven't been waited for are left to the host to reap.
+ *
+ * @param   psh         The shell instance.
+ */
+void sh_destroy_embedded_shell(shinstance *psh)
+{
+    unsigned i;
+
+    sh_int_unlink(psh);
+
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    i = g_sh_emb_num_children;
+    while (i-- > 0)
+        if (g_sh_emb_children[i].psh == psh)
+        {
+            if (g_sh_emb_children[i].reaped)
+                g_sh_emb_children[i] = g_sh_emb_children[--g_sh_emb_num_children];
+            else
+                g_sh_emb_children[i].psh = NULL;
+        }
+    pthread_mutex_unlock(&g_sh_emb_mtx);
+
+    shfile_uninit(&psh->fdtab);
+    shheap_free_all(psh);
+    sh_destroy(psh);
+}
+
+/**
+ * Hands the status of a child that is done to the shell it belongs to, or
+ * forgets about it if that shell is gone.
+ *
+ * Caller owns g_sh_emb_mtx.
+ *
+ * @returns 1 if found in the child table, 0 if not.
+ * @param   pid         The (fake) process id.
+ * @param   status      The wait status.
+ */
+static int sh_int_embedded_child_done_locked(pid_t pid, int status)
+{
+    unsigned i;
+    for (i = 0; i < g_sh_emb_num_children; i++)
+        if (g_sh_emb_children[i].pid == pid)
+        {
+            if (g_sh_emb_children[i].psh)
+            {
+                g_sh_emb_children[i].status = status;
+                g_sh_emb_children[i].reaped = 1;
+                pthread_cond_broadcast(&g_sh_emb_cond);
+            }
+            else
+                g_sh_emb_children[i] = g_sh_emb_children[--g_sh_emb_num_children];
+            return 1;
+        }
+    return 0;
+}
+
+/**
+ * Called by the host when it has reaped a child process, to check whether it
+ * belongs to one of the shells.
+ *
+ * @returns 1 if it is a shell child (the status has been handed over), 0 if
+ *          not.
+ * @param   pid         The process id.
+ * @param   status      The wait status.
+ */
+int sh_embedded_child_reaped(pid_t pid, int status)
+{
+    int found;
+
+    if (!g_sh_embedded_host)
+        return 0;
+
+    pthread_rwlock_wrlock(&g_sh_emb_fork_lock);
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    found = sh_int_embedded_child_done_locked(pid, status);
+    pthread_mutex_unlock(&g_sh_emb_mtx);
+    pthread_rwlock_unlock(&g_sh_emb_fork_lock);
+    return found;
+}
+
+/**
+ * Makes sure there is room for one more entry in the child table.
+ *
+ * Caller owns g_sh_emb_mtx.
+ *
+ * @returns 0 on success, -1 and errno on failure.
+ */
+static int sh_int_embedded_grow_children_locked(void)
+{
+    if (g_sh_emb_num_children + g_sh_emb_reserved_children >= g_sh_emb_max_children)
+    {
+        unsigned new_max = g_sh_emb_max_children ? g_sh_emb_max_children * 2 : 64;
+        void *pv = realloc(g_sh_emb_children, new_max * sizeof(g_sh_emb_children[0]));
+        if (!pv)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        g_sh_emb_children = (shembchild *)pv;
+        g_sh_emb_max_children = new_max;
+    }
+    return 0;
+}
+
+/**
+ * Prepares for creating a child process, reserving an entry for it in the
+ * child table.
+ *
+ * Must be followed by sh_int_embedded_post_fork in the parent.
+ *
+ * @returns 0 on success, -1 and errno on failure.
+ */
+static int sh_int_embedded_pre_fork(void)
+{
+    int rc;
+    pthread_rwlock_rdlock(&g_sh_emb_fork_lock);
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    rc = sh_int_embedded_grow_children_locked();
+    if (!rc)
+        g_sh_emb_reserved_children++;
+    pthread_mutex_unlock(&g_sh_emb_mtx);
+    if (rc)
+        pthread_rwlock_unlock(&g_sh_emb_fork_lock);
+    return rc;
+}
+
+/**
+ * Records the new child in the parent after a fork or vfork.
+ *
+ * @param   psh         The shell instance.
+ * @param   pid         The process id, -1 if the fork failed.
+ */
+static void sh_int_embedded_post_fork(shinstance *psh, pid_t pid)
+{
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    g_sh_emb_reserved_children--;
+    if (pid > 0)
+    {
+        shembchild *child = &g_sh_emb_children[g_sh_emb_num_children++];
+        child->pid    = pid;
+        child->status = 0;
+        child->reaped = 0;
+        child->psh    = psh;
+        child->thread = 0;
+    }
+    pthread_mutex_unlock(&g_sh_emb_mtx);
+    pthread_rwlock_unlock(&g_sh_emb_fork_lock);
+}
+
+/**
+ * Turns the child side of a fork in the host process into a normal forked
+ * shell process.
+ *
+ * The other shells (threads) don't exist here, and the signal dispositions
+ * and mask that the shell has only been recording are applied for real.
+ *
+ * @param   psh         The shell instance.
+ */
+static void sh_int_embedded_forked_child(shinstance *psh)
+{
+    shinstance *pshother;
+    unsigned fd, fd2;
+    int signo;
+
+    /* Close what the other shells have open, so we don't keep their pipes
+       alive.  (Unless it's ours too, in case we caught a table mid-update.) */
+    for (pshother = g_sh_head; pshother; pshother = pshother->next)
+        if (pshother != psh)
+            for (fd = 0; fd < pshother->fdtab.size; fd++)
+                if (pshother->fdtab.tab[fd].fd != -1)
+                {
+                    intptr_t native = pshother->fdtab.tab[fd].native;
+                    for (fd2 = 0; fd2 < psh->fdtab.size; fd2++)
+                        if (psh->fdtab.tab[fd2].fd != -1 && psh->fdtab.tab[fd2].native == native)
+                            break;
+                    if (fd2 >= psh->fdtab.size)
+                        close((int)native);
+                }
+
+    g_sh_embedded_host = 0;
+    pthread_rwlock_init(&g_sh_emb_fork_lock, NULL);
+    pthread_mutex_init(&g_sh_emb_mtx, NULL);
+    pthread_cond_init(&g_sh_emb_cond, NULL);
+    g_sh_emb_num_children = 0;
+    g_sh_emb_reserved_children = 0;
+    shmtx_init(&g_sh_mtx);
+    shmtx_init(&psh->fdtab.mtx);
+
+    psh->next = psh->prev = NULL;
+    g_sh_head = g_sh_tail = g_sh_root = psh;
+    g_num_shells = 1;
+
+    memset(g_sig_state, 0, sizeof(g_sig_state));
+    for (signo = 1; signo < NSIG; signo++)
+    {
+        shsigaction_t shsa = psh->sigactions[signo];
+        struct sigaction sa;
+        if (signo == SIGKILL || signo == SIGSTOP)
+            continue;
+
+        /* Drop the signal handlers of the host. */
+        if (   !sigaction(signo, NULL, &sa)
+            && sa.sa_handler != SIG_DFL
+            && sa.sa_handler != SIG_IGN)
+        {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            sigemptyset(&sa.sa_mask);
+            sigaction(signo, &sa, NULL);
+        }
+
+        psh->sigactions[signo].sh_handler = SH_SIG_UNK;
+        if (shsa.sh_handler != SH_SIG_UNK)
+            sh_sigaction(psh, signo, &shsa, NULL);
+    }
+    sigprocmask(SIG_SETMASK, &psh->sigmask, NULL);
+}
+
+/**
+ * Sets up the signal dispositions for executing a program in a child vfork'ed
+ * by the host process.
+ *
+ * Only system calls here, the memory is shared with the parent.
+ *
+ * @param   psh         The shell instance.
+ */
+static void sh_int_embedded_exec_signals(shinstance *psh)
+{
+    int signo;
+    for (signo = 1; signo < NSIG; signo++)
+    {
+        shsig_t handler = psh->sigactions[signo].sh_handler;
+        struct sigaction sa;
+        if (   signo == SIGKILL
+            || signo == SIGSTOP
+            || sigaction(signo, NULL, &sa))
+            continue;
+        if (handler == SH_SIG_IGN)
+        {
+            if (sa.sa_handler == SIG_IGN)
+                continue;
+            sa.sa_handler = SIG_IGN;
+        }
+        else if (sa.sa_handler == SIG_DFL)
+            continue;
+        else if (sa.sa_handler == SIG_IGN && handler == SH_SIG_UNK)
+            continue; /* inherited */
+        else
+            sa.sa_handler = SIG_DFL;
+        sa.sa_flags = 0;
+        sigemptyset(&sa.sa_mask);
+        sigaction(signo, &sa, NULL);
+    }
+}
+
+/**
+ * fork() in the host process.
+ *
+ * @returns See fork().
+ * @param   psh         The shell instance.
+ */
+static pid_t sh_int_embedded_fork(shinstance *psh)
+{
+    sigset_t all, saved;
+    pid_t pid;
+
+    if (sh_int_embedded_pre_fork())
+        return -1;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    pid = fork();
+    if (pid == 0)
+    {
+        sh_int_embedded_forked_child(psh); /* sets the signal mask */
+        return 0;
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    sh_int_embedded_post_fork(psh, pid);
+    return pid;
+}
+
+/**
+ * Waits on g_sh_emb_cond for a little while.
+ *
+ * Caller owns g_sh_emb_mtx.  The timeout is just a safety net in case the
+ * host is busy elsewhere and doesn't get around to reaping.
+ */
+static void sh_int_embedded_wait_cond(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 10 * 1000 * 1000;
+    if (ts.tv_nsec >= 1000 * 1000 * 1000)
+    {
+        ts.tv_nsec -= 1000 * 1000 * 1000;
+        ts.tv_sec++;
+    }
+    pthread_cond_timedwait(&g_sh_emb_cond, &g_sh_emb_mtx, &ts);
+}
+
+/**
+ * waitpid() in the host process.
+ *
+ * Only the children of the given shell are considered, and they may be
+ * reaped by either this thread or the host.
+ *
+ * @returns See waitpid().
+ * @param   psh         The shell instance.
+ * @param   pid         The specific child to wait for, or -1 for any.
+ * @param   statusp     Where to return the wait status.
+ * @param   flags       WNOHANG and/or WUNTRACED.
+ */
+static pid_t sh_int_embedded_waitpid(shinstance *psh, pid_t pid, int *statusp, int flags)
+{
+    int host_has_it = 0;
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    for (;;)
+    {
+        shembchild *child;
+        unsigned    num_mine = 0;
+        pid_t       pid_mine = -1;
+        pid_t       pidret;
+        int         status;
+        unsigned    i;
+
+        /* Terminate if another thread signalled us, see sh_sig_do_default. */
+        if (psh->embsigpending && psh->embexit && psh == shthread_get_shell())
+        {
+            pthread_mutex_unlock(&g_sh_emb_mtx);
+            TRACE2((psh, "sh_waitpid: terminating on pending signal %d\n", psh->embsigpending));
+            psh->embstatus = psh->embsigpending;
+            longjmp(*(jmp_buf *)psh->embexit, 1);
+        }
+
+        for (i = 0; i < g_sh_emb_num_children; i++)
+        {
+            child = &g_sh_emb_children[i];
+            if (child->psh != psh || (pid != -1 && child->pid != pid))
+                continue;
+            if (!child->reaped && !child->thread)
+            {
+                pidret = waitpid(child->pid, &status, WNOHANG | (flags & WUNTRACED));
+                if (pidret == child->pid)
+                {
+                    if (WIFSTOPPED(status))
+                    {
+                        pthread_mutex_unlock(&g_sh_emb_mtx);
+                        *statusp = status;
+                        return pidret;
+                    }
+                    child->status = status;
+                    child->reaped = 1;
+                }
+            }
+            if (child->reaped)
+            {
+                pidret = child->pid;
+                *statusp = child->status;
+                *child = g_sh_emb_children[--g_sh_emb_num_children];
+                pthread_mutex_unlock(&g_sh_emb_mtx);
+                return pidret;
+            }
+            num_mine++;
+            if (!child->thread)
+                pid_mine = child->pid;
+        }
+
+        if (!num_mine)
+        {
+            pthread_mutex_unlock(&g_sh_emb_mtx);
+            errno = ECHILD;
+            return -1;
+        }
+        if (flags & WNOHANG)
+        {
+            pthread_mutex_unlock(&g_sh_emb_mtx);
+            return 0;
+        }
+
+        if (num_mine == 1 && pid_mine != -1 && !host_has_it)
+        {
+            /* Block in waitpid.  If the host beats us to it, we get ECHILD
+               and the status is handed over thru the table. */
+            pthread_mutex_unlock(&g_sh_emb_mtx);
+            pidret = waitpid(pid_mine, &status, flags & WUNTRACED);
+            pthread_mutex_lock(&g_sh_emb_mtx);
+            if (pidret == pid_mine)
+            {
+                for (i = 0; i < g_sh_emb_num_children; i++)
+                    if (g_sh_emb_children[i].pid == pid_mine)
+                    {
+                        child = &g_sh_emb_children[i];
+                        if (WIFSTOPPED(status))
+                        {
+                            pthread_mutex_unlock(&g_sh_emb_mtx);
+                            *statusp = status;
+                            return pidret;
+                        }
+                        child->status = status;
+                        child->reaped = 1;
+                        break;
+                    }
+            }
+            else
+                host_has_it = 1;
+        }
+        else
+            sh_int_embedded_wait_cond();
+    }
+}
+
+/**
+ * execve() in the host process.
+ *
+ * The program is run in a vfork'ed child and the shell then exits with its
+ * status, as if the shell process had been replaced by it.
+ *
+ * @returns -1 and errno if the program couldn't be executed, in which case
+ *          the caller may try elsewhere.  Doesn't return on success.
+ * @param   psh         The shell instance.
+ * @param   exe         The executable.
+ * @param   argv        The arguments.
+ * @param   envp        The environment.
+ */
+static int sh_int_embedded_execve(shinstance *psh, const char *exe, const char * const *argv, const char * const *envp)
+{
+    volatile int err = 0;
+    sigset_t all, saved;
+    pid_t pid;
+    int status;
+
+    if (sh_int_embedded_pre_fork())
+        return -1;
+
+    /* No host signal handlers in the child while it shares our memory. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    pid = vfork();
+    if (pid == 0)
+    {
+        /* The child, sharing memory with the parent.  Only system calls. */
+        sh_int_embedded_exec_signals(psh);
+        if (!shfile_exec_unix(&psh->fdtab))
+        {
+            sigprocmask(SIG_SETMASK, &psh->sigmask, NULL);
+            execve(exe, (char **)argv, (char **)envp);
+        }
+        err = errno ? errno : ENOEXEC;
+        _exit(127);
+    }
+    if (pid < 0)
+        err = errno;
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    sh_int_embedded_post_fork(psh, pid);
+    if (pid < 0)
+    {
+        errno = err;
+        return -1;
+    }
+
+    do
+        status = 0;
+    while (   sh_int_embedded_waitpid(psh, pid, &status, 0) == pid
+           && WIFSTOPPED(status));
+    if (err)
+    {
+        errno = err;
+        return -1;
+    }
+
+    TRACE2((psh, "sh_execve: child exited, status=%#x\n", status));
+    psh->embstatus = status;
+    longjmp(*(jmp_buf *)psh->embexit, 1);
+}
+
+# ifdef SH_THREADED_SUBSHELLS
+
+/**
+ * Creates a subshell that is to run on a thread in the host process, as a
+ * copy of the given shell.
+ *
+ * This is called on the thread of the parent, so everything belonging to the
+ * subshell is explicitly allocated on its behalf.
+ *
+ * @returns pointer to the subshell on success, NULL and errno on failure.
+ * @param   inherit     The parent shell.
+ */
+shinstance *sh_create_subshell(shinstance *inherit)
+{
+    static char *s_apszNoArgs[1] = { NULL };
+    struct parsefile *pf;
+    shinstance *psh;
+
+    psh = sh_int_create_shell(inherit, 0, s_apszNoArgs, inherit->shenviron, NULL);
+    if (!psh)
+        return NULL;
+    psh->parent = inherit;
+
+    /* The modules with state of their own. */
+    subshellinitvar(psh, inherit);
+    subshellinitalias(psh, inherit);
+    subshellinitexec(psh, inherit);
+    subshellinitoptions(psh, inherit);
+    subshellinittrap(psh, inherit);
+    subshellinitcd(psh, inherit);
+
+    /* eval.c */
+    psh->commandname     = inherit->commandname ? sh_strdup(psh, inherit->commandname) : NULL;
+    psh->exitstatus      = inherit->exitstatus;
+    psh->back_exitstatus = inherit->back_exitstatus;
+    psh->funcnest        = inherit->funcnest;
+    psh->loopnest        = inherit->loopnest;
+    psh->suppressint     = inherit->suppressint;
+
+    /* input.c - the files the parent is reading commands from are closed,
+       as popallfiles and closescript would in a forked child. */
+    psh->basepf.nextc = psh->basepf.buf = psh->basebuf;
+    for (pf = inherit->parsefile; pf; pf = pf->prev)
+        if (pf->fd > 0)
+            shfile_close(&psh->fdtab, pf->fd);
+
+    /* jobs.c */
+    psh->backgndpid      = inherit->backgndpid;
+
+    /* main.c */
+    psh->rootpid         = inherit->rootpid;
+    psh->rootshell       = inherit->rootshell;
+    psh->psh_rootshell   = inherit->psh_rootshell;
+
+    /* redir.c */
+    psh->fd0_redirected  = inherit->fd0_redirected;
+
+    /* show.c */
+    psh->tracefd         = inherit->tracefd;
+
+    return psh;
+}
+
+/**
+ * The subshell thread.
+ *
+ * @returns NULL.
+ * @param   pvUser      The shsubshellthread structure, owned by the subshell.
+ */
+static void *sh_int_subshell_thread(void *pvUser)
+{
+    shsubshellthread *pCtx = (shsubshellthread *)pvUser;
+    shinstance *psh = pCtx->psh;
+    pid_t const pid = psh->pid;
+    jmp_buf exitloc;
+    int status;
+
+    shthread_set_shell(psh);
+    psh->embexit = &exitloc;
+    if (!setjmp(exitloc))
+    {
+        pCtx->pfn(psh, pCtx->pvUser);
+        sh__exit(psh, psh->exitstatus);
+    }
+    status = psh->embstatus;
+    shthread_set_shell(NULL);
+    sh_destroy_embedded_shell(psh);
+
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    sh_int_embedded_child_done_locked(pid, status);
+    pthread_mutex_unlock(&g_sh_emb_mtx);
     return NULL;
 }
 
+/**
+ * Starts a subshell created by sh_create_subshell on a thread of its own.
+ *
+ * The subshell is recorded as a child of the parent with a fake process id,
+ * so it can be waited for just like a forked one.  All signals are blocked on
+ * the thread, the subshell only gets the ones it raises itself.
+ *
+ * @returns The fake process id on success.  -1 and errno on failure, in which
+ *          case the subshell has been destroyed.
+ * @param   psh         The subshell.
+ * @param   pfn         What to run on the thread.  This must not return, but
+ *                      exit the shell.
+ * @param   pvUser      The argument to pfn.
+ */
+pid_t sh_thread_subshell(shinstance *psh, void (*pfn)(shinstance *, void *), void *pvUser)
+{
+    shsubshellthread *pCtx;
+    pthread_attr_t attr;
+    pthread_t tid;
+    sigset_t all, saved;
+    shembchild *child;
+    pid_t pid;
+    int rc;
+
+    pCtx = (shsubshellthread *)sh_malloc(psh, sizeof(*pCtx));
+    if (!pCtx)
+    {
+        sh_destroy_embedded_shell(psh);
+        errno = ENOMEM;
+        return -1;
+    }
+    pCtx->psh    = psh;
+    pCtx->pfn    = pfn;
+    pCtx->pvUser = pvUser;
+
+    /* Record the child before there is a thread that can finish. */
+    pthread_mutex_lock(&g_sh_emb_mtx);
+    if (sh_int_embedded_grow_children_locked())
+    {
+        pthread_mutex_unlock(&g_sh_emb_mtx);
+        sh_destroy_embedded_shell(psh);
+        errno = ENOMEM;
+        return -1;
+    }
+    pid = g_sh_emb_next_thread_pid;
+    g_sh_emb_next_thread_pid = pid < SH_SUBSHELL_LAST_PID ? pid + 1 : SH_SUBSHELL_FIRST_PID;
+    child = &g_sh_emb_children[g_sh_emb_num_children++];
+    child->pid    = pid;
+    child->status = 0;
+    child->reaped = 0;
+    child->psh    = psh->parent;
+    child->thread = 1;
+    pthread_mutex_unlock(&g_sh_emb_mtx);
+    psh->pid = pid;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, SH_SUBSHELL_STACK_SIZE);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    rc = pthread_create(&tid, &attr, sh_int_subshell_thread, pCtx);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    pthread_attr_destroy(&attr);
+    if (rc)
+    {
+        unsigned i;
+        pthread_mutex_lock(&g_sh_emb_mtx);
+        for (i = 0; i < g_sh_emb_num_children; i++)
+            if (g_sh_emb_children[i].pid == pid)
+            {
+                g_sh_emb_children[i] = g_sh_emb_children[--g_sh_emb_num_children];
+                break;
+            }
+        pthread_mutex_unlock(&g_sh_emb_mtx);
+        sh_destroy_embedded_shell(psh);
+        errno = rc;
+        return -1;
+    }
+    return pid;
+}
+
+# endif /* SH_THREADED_SUBSHELLS */
+#endif /* SH_EMBEDDED_MODE */
+
 /** getenv() */
 char *sh_getenv(shinstance *psh, const char *var)
 {
@@ -386,6 +1252,10 @@ static void sh_int_lazy_init_sigaction(shinstance *psh, int signo)
                 shold.sh_mask = old.sa_mask;
                 if (old.sa_handler == SIG_DFL)
                     shold.sh_handler = SH_SIG_DFL;
+#ifdef SH_EMBEDDED_MODE
+                else if (old.sa_handler != SIG_IGN && g_sh_embedded_host)
+                    shold.sh_handler = SH_SIG_DFL; /* the host's handler */
+#endif
                 else
                 {
                     assert(old.sa_handler == SIG_IGN);
@@ -421,6 +1291,11 @@ static void sh_int_lazy_init_sigaction(shinstance *psh, int signo)
                     signo, sys_signame[signo], g_sig_state[signo].sa.sa_handler, g_sig_state[signo].sa.sa_flags));
 
             /* update all shells */
+#ifdef SH_EMBEDDED_MODE
+            if (g_sh_embedded_host)
+                psh->sigactions[signo] = shold;
+            else
+#endif
             for (cur = g_sh_head; cur; cur = cur->next)
             {
                 assert(cur->sigactions[signo].sh_handler == SH_SIG_UNK);
@@ -440,7 +1315,38 @@ static void sh_int_lazy_init_sigaction(shinstance *psh, int signo)
  */
 static void sh_sig_do_default(shinstance *psh, int signo)
 {
+#ifdef SH_EMBEDDED_MODE
+    /* A shell in the host process can terminate itself, which is what the
+       default action of most signals amounts to, but nothing more.  A shell
+       on another thread (the parent of a subshell doing 'kill $$') cannot be
+       unwound from here, so it is left to pick up the signal the next time
+       it waits for a child. */
+    if (   g_sh_embedded_host
+        && psh->embexit
+        && signo != SIGCHLD
+        && signo != SIGCONT
+        && signo != SIGSTOP
+        && signo != SIGTSTP
+        && signo != SIGTTIN
+        && signo != SIGTTOU
+        && signo != SIGURG
+        && signo != SIGWINCH)
+    {
+        if (psh == shthread_get_shell())
+        {
+            TRACE2((psh, "sh_sig_do_default: terminating on signal %d\n", signo));
+            psh->embstatus = signo;
+            longjmp(*(jmp_buf *)psh->embexit, 1);
+        }
+        pthread_mutex_lock(&g_sh_emb_mtx);
+        psh->embsigpending = signo;
+        pthread_cond_broadcast(&g_sh_emb_cond);
+        pthread_mutex_unlock(&g_sh_emb_mtx);
+        return;
+    }
+#endif
     /** @todo */
+    (void)psh; (void)signo;
 }
 
 /**
@@ -540,6 +1446,19 @@ int sh_sigaction(shinstance *psh, int signo, const struct shsigaction *newp, str
     if (oldp)
         *oldp = psh->sigactions[signo];
 
+#ifdef SH_EMBEDDED_MODE
+    /*
+     * The host process owns the real signal handling, so just record it.
+     * The forked children apply it (sh_int_embedded_forked_child).
+     */
+    if (g_sh_embedded_host)
+    {
+        if (newp)
+            psh->sigactions[signo] = *newp;
+        return 0;
+    }
+#endif
+
     /*
      * Set the new one if it has changed.
      *
@@ -712,11 +1631,18 @@ int sh_sigprocmask(shinstance *psh, int operation, shsigset_t const *newp, shsig
     }
 
 #if defined(SH_FORKED_MODE) && !defined(_MSC_VER)
-    rc = sigprocmask(operation, newp, oldp);
-    if (!rc && newp)
-        psh->sigmask = *newp;
-
-#else
+# ifdef SH_EMBEDDED_MODE
+    if (!g_sh_embedded_host)
+# endif
+    {
+        rc = sigprocmask(operation, newp, oldp);
+        if (!rc && newp)
+            psh->sigmask = *newp;
+        return rc;
+    }
+#endif
+#if !defined(SH_FORKED_MODE) || defined(_MSC_VER) || defined(SH_EMBEDDED_MODE)
+    rc = 0;
     if (oldp)
         *oldp = psh->sigmask;
     if (newp)
@@ -740,7 +1666,7 @@ int sh_sigprocmask(shinstance *psh, int operation, shsigset_t const *newp, shsig
                 break;
         }
 
-# if defined(_MSC_VER)
+# if defined(_MSC_VER) || defined(SH_EMBEDDED_MODE)
         rc = 0;
 # else
         rc = sigprocmask(operation, &mask, NULL);
@@ -782,6 +1708,17 @@ void sh_raise_sigint(shinstance *psh)
     TRACE2((psh, "sh_raise(SIGINT) returns\n"));
 }
 
+#ifdef SH_EMBEDDED_MODE
+void sh_raise_sigpipe(shinstance *psh)
+{
+    TRACE2((psh, "sh_raise(SIGPIPE)\n"));
+
+    sh_sig_do_signal(psh, psh, SIGPIPE, 0 /* no lock */);
+
+    TRACE2((psh, "sh_raise(SIGPIPE) returns\n"));
+}
+#endif
+
 int sh_kill(shinstance *psh, pid_t pid, int signo)
 {
     shinstance *pshDst;
@@ -799,6 +1736,15 @@ int sh_kill(shinstance *psh, pid_t pid, int signo)
         if (pshDst->pid == pid)
         {
             TRACE2((psh, "sh_kill(%d, %d): pshDst=%p\n", pid, signo, pshDst));
+#ifdef SH_EMBEDDED_MODE
+            /* The default action may terminate us (sh_sig_do_default). */
+            if (pshDst == psh)
+            {
+                shmtx_leave(&g_sh_mtx, &tmp);
+                sh_sig_do_signal(psh, pshDst, signo, 0 /* no lock */);
+                return 0;
+            }
+#endif
             sh_sig_do_signal(psh, pshDst, signo, 1 /* locked */);
 
             shmtx_leave(&g_sh_mtx, &tmp);
@@ -920,6 +1866,11 @@ pid_t sh_fork(shinstance *psh)
     pid = -1;
     errno = ENOSYS;
 # else
+#  ifdef SH_EMBEDDED_MODE
+    if (g_sh_embedded_host)
+        pid = sh_int_embedded_fork(psh);
+    else
+#  endif
     pid = fork();
 # endif
 
@@ -1045,6 +1996,11 @@ pid_t sh_waitpid(shinstance *psh, pid_t pid, int *statusp, int flags)
     pidret = -1;
     errno = ENOSYS;
 # else
+#  ifdef SH_EMBEDDED_MODE
+    if (g_sh_embedded_host)
+        pidret = sh_int_embedded_waitpid(psh, pid, statusp, flags);
+    else
+#  endif
     pidret = waitpid(pid, statusp, flags);
 # endif
 
@@ -1063,6 +2019,13 @@ SH_NORETURN_1 void sh__exit(shinstance *psh, int rc)
     (void)psh;
 
 #if defined(SH_FORKED_MODE)
+# ifdef SH_EMBEDDED_MODE
+    if (g_sh_embedded_host && psh->embexit)
+    {
+        psh->embstatus = (rc & 0xff) << 8;
+        longjmp(*(jmp_buf *)psh->embexit, 1);
+    }
+# endif
     _exit(rc);
 
 #else
@@ -1100,9 +2063,16 @@ int sh_execve(shinstance *psh, const char *exe, const char * const *argv, const
     rc = -1;
 
 # else
-    rc = shfile_exec_unix(&psh->fdtab);
-    if (!rc)
-        rc = execve(exe, (char **)argv, (char **)envp);
+#  ifdef SH_EMBEDDED_MODE
+    if (g_sh_embedded_host)
+        rc = sh_int_embedded_execve(psh, exe, argv, envp);
+    else
+#  endif
+    {
+        rc = shfile_exec_unix(&psh->fdtab);
+        if (!rc)
+            rc = execve(exe, (char **)argv, (char **)envp);
+    }
 # endif
 
 #else
@@ -1490,7 +2460,17 @@ int sh_setrlimit(shinstance *psh, int resid, const shrlimit *limp)
     int rc = -1;
     errno = ENOSYS;
 # else
-    int rc = setrlimit(resid, limp);
+    int rc;
+#  ifdef SH_EMBEDDED_MODE
+    /* Would apply to the whole host process. */
+    if (g_sh_embedded_host)
+    {
+        errno = ENOSYS;
+        rc = -1;
+    }
+    else
+#  endif
+    rc = setrlimit(resid, limp);
 # endif
 
 #else
@@ -147,6 +147,12 @@ struct shinstance
     char              **shenviron;      /**< The environment vector. */
     int                 num_children;   /**< Number of children in the array. */
     shchild            *children;       /**< The child array. */
+#ifdef SH_EMBEDDED_MODE
+    shheapnode          heapblocks;     /**< The heap blocks owned by this shell (see shheap.c). */
+    void               *embexit;        /**< The jmp_buf sh__exit returns to in the host process, NULL if none. */
+    int                 embstatus;      /**< The wait status of the shell, set by sh__exit. */
+    volatile int        embsigpending;  /**< Fatal signal sent from another thread, see sh_sig_do_default. */
+#endif
 
     /* alias.c */
 #define ATABSIZE 39
@@ -195,6 +201,7 @@ struct shinstance
     /* exec.c */
     struct tblentry    *cmdtable[CMDTABLESIZE];
     int                 builtinloc/* = -1*/;    /**< index in path of %builtin, or -1 */
+    struct tblentry   **lastcmdentry;   /**< set by cmdlookup for delete_cmd_entry */
 
     /* input.h */
     int                 plinno/* = 1 */;/**< input line number */
@@ -349,6 +356,20 @@ struct shinstance
 
 
 extern shinstance *sh_create_root_shell(shinstance *, int, char **, char **);
+#ifdef SH_EMBEDDED_MODE
+/** Set while executing in the process the shell is embedded in (kmk), clear
+ * in processes forked off by the shell. */
+extern int g_sh_embedded_host;
+void sh_embedded_init(void);
+shinstance *sh_create_embedded_shell(int, char **, char **, int const *, pid_t);
+void sh_destroy_embedded_shell(shinstance *);
+int sh_embedded_child_reaped(pid_t, int);
+int sh_embedded_main(int, char **, char **, int const *, pid_t);
+# ifdef SH_THREADED_SUBSHELLS
+shinstance *sh_create_subshell(shinstance *);
+pid_t sh_thread_subshell(shinstance *, void (*)(shinstance *, void *), void *);
+# endif
+#endif
 
 /* environment & pwd.h */
 char *sh_getenv(shinstance *, const char *);
@@ -401,6 +422,9 @@ int sh_sigismember(shsigset_t const *, int);
 int sh_sigprocmask(shinstance *, int, shsigset_t const *, shsigset_t *);
 SH_NORETURN_1 void sh_abort(shinstance *) SH_NORETURN_2;
 void sh_raise_sigint(shinstance *);
+#ifdef SH_EMBEDDED_MODE
+void sh_raise_sigpipe(shinstance *);
+#endif
 int sh_kill(shinstance *, pid_t, int);
 int sh_killpg(shinstance *, pid_t, int);
 
@@ -31,7 +31,11 @@
 
 typedef struct shmtx
 {
-    char b[64];
+    union
+    {
+        char        b[64];
+        KU64        au64[8];            /**< Alignment (SH_EMBEDDED_MODE keeps a pthread_mutex_t here). */
+    } u;
 } shmtx;
 
 typedef struct shmtxtmp { int i; } shmtxtmp;
@@ -234,6 +234,25 @@ clear_traps(shinstance *psh, int vforked)
 }
 
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * Copy the traps and signal modes of the parent shell into a subshell that
+ * is to run on a thread of its own.  The traps are cleared by forkchild()
+ * just like in a forked subshell.
+ */
+
+void
+subshellinittrap(shinstance *psh, shinstance *inherit)
+{
+	int i;
+
+	for (i = 0; i <= NSIG; i++)
+		psh->trap[i] = inherit->trap[i] ? savestr(psh, inherit->trap[i]) : NULL;
+	memcpy(psh->sigmode, inherit->sigmode, sizeof(psh->sigmode));
+}
+#endif
+
+
 
 /*
  * Set the signal handler for the specified signal.  The routine figures
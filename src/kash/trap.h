@@ -38,6 +38,9 @@
 
 int trapcmd(struct shinstance *, int, char **);
 void clear_traps(struct shinstance *, int);
+#ifdef SH_THREADED_SUBSHELLS
+void subshellinittrap(struct shinstance *, struct shinstance *);
+#endif
 void setsignal(struct shinstance *, int, int);
 void ignoresig(struct shinstance *, int, int);
 void onsig(struct shinstance *, int);
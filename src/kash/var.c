@@ -270,6 +270,40 @@ initvar(shinstance *psh)
 	}
 }
 
+#ifdef SH_THREADED_SUBSHELLS
+/*
+ * Copy the variables of the parent shell into a subshell that is to run on
+ * a thread of its own.  The builtin variables live in the shell instance,
+ * so they are mapped to the ones in the subshell by their offset.
+ */
+
+void
+subshellinitvar(shinstance *psh, shinstance *inherit)
+{
+	struct var *const *srcp;
+	struct var **vpp;
+	struct var *src;
+	struct var *vp;
+
+	for (srcp = inherit->vartab; srcp < &inherit->vartab[VTABSIZE]; srcp++) {
+		vpp = &psh->vartab[srcp - inherit->vartab];
+		for (src = *srcp; src; src = src->next) {
+			if ((char *)src >= (char *)inherit
+			 && (char *)src < (char *)(inherit + 1))
+				vp = (struct var *)((char *)psh + ((char *)src - (char *)inherit));
+			else
+				vp = ckmalloc(psh, sizeof(*vp));
+			*vp = *src;
+			vp->text = savestr(psh, src->text);
+			*vpp = vp;
+			vpp = &vp->next;
+		}
+		*vpp = NULL;
+	}
+	psh->localvars = NULL;
+}
+#endif
+
 /*
  * Safe version of setvar, returns 1 on success 0 on failure.
  */
@@ -626,8 +660,13 @@ showvars(shinstance *psh, const char *name, int flag, int show_value)
 	struct var *vp;
 	const char *p;
 
+#ifdef SH_EMBEDDED_MODE
+	struct var **list = NULL;	/* the shells are threads; freed with the shell if interrupted */
+	int list_len = 0;
+#else
 	static struct var **list;	/* static in case we are interrupted */
 	static int list_len;
+#endif
 	int count = 0;
 
 	if (!list) {
@@ -664,6 +703,9 @@ showvars(shinstance *psh, const char *name, int flag, int show_value)
 		}
 		out1c(psh, '\n');
 	}
+#ifdef SH_EMBEDDED_MODE
+	ckfree(psh, list);
+#endif
 	return 0;
 }
 
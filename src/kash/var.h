@@ -126,6 +126,9 @@ extern struct var vhistsize;
 #define mpathset(psh)	(((psh)->vmpath.flags & VUNSET) == 0)
 
 void initvar(struct shinstance *);
+#ifdef SH_THREADED_SUBSHELLS
+void subshellinitvar(struct shinstance *, struct shinstance *);
+#endif
 void setvar(struct shinstance *, const char *, const char *, int);
 void setvareq(struct shinstance *, char *, int);
 struct strlist;
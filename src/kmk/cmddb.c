@@ -0,0 +1,499 @@
+#ifdef CONFIG_WITH_CMD_DB
+/* $Id$ */
+/** @file
+ * cmddb - Command line fingerprint database.
+ *
+ * Native replacement for the per-target '.auto-dep' makefiles written by
+ * KB_FN_AUTO_CMD_DEPS: instead of saving the previous command text and
+ * comparing it with $(comp-cmds-ex) on the next run, $(comp-cmds-db target,
+ * not-equal-return) hashes the expanded commands of the target and looks the
+ * digest up in a single database file named by KMK_CMD_DB.
+ *
+ * The database is a binary open addressed hash table of fixed size records
+ * (64-bit key derived from the absolute target name, 128-bit MD5 digest of
+ * the commands).  It is mapped read-only for the lookups.  Digests are only
+ * recorded once the commands have completed successfully, and merged into
+ * the file under a lock when kmk exits.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "makeint.h"
+#include <assert.h>
+#include <fcntl.h>
+#ifdef WINDOWS32
+# include <io.h>
+# include <sys/locking.h>
+#else
+# include <sys/mman.h>
+# include <sys/file.h>
+#endif
+
+#include "filedef.h"
+#include "variable.h"
+#include "hash.h"
+#include "debug.h"
+#include "../lib/md5.h"
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/* The file signature. */
+#define CMDDB_MAGIC         "kmkcmdb\001"
+
+/* The minimum number of records in the file (power of two). */
+#define CMDDB_MIN_RECORDS   1024
+
+/* Initial size of the update hash table. */
+#define CMDDB_BUCKETS       1024
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/* The file header. */
+struct cmddb_header
+  {
+    char magic[8];              /* CMDDB_MAGIC */
+    unsigned int records;       /* Number of records, power of two. */
+    unsigned int used;          /* Number of records in use. */
+  };
+
+/* A record, both in the file and in memory.  An all zero key marks an
+   unused record in the file. */
+struct cmddb_record
+  {
+    unsigned char key[8];       /* MD5 of the absolute target name (part). */
+    unsigned char digest[16];   /* MD5 of the expanded commands. */
+  };
+
+/* An update made by this instance. */
+struct cmddb_entry
+  {
+    struct cmddb_record rec;
+    int done;                   /* Set when the commands completed. */
+  };
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/* Whether we've checked KMK_CMD_DB.
+   1 if it's set and the database is loaded, -1 if not set. */
+static int cmddb_state = 0;
+
+/* The absolute name of the database file (heap). */
+static char *cmddb_filename;
+
+/* The database view (mapping or heap) and its size.  */
+static unsigned char *cmddb_view;
+static size_t cmddb_view_size;
+
+/* The fingerprints calculated by this instance, keyed by record key. */
+static struct hash_table cmddb_updates;
+
+/* Number of completed updates not yet saved. */
+static unsigned int cmddb_dirty;
+
+
+static unsigned long
+cmddb_hash_1 (const void *key)
+{
+  const unsigned char *p = ((struct cmddb_entry const *) key)->rec.key;
+  return p[0] | (p[1] << 8) | ((unsigned long) p[2] << 16)
+       | ((unsigned long) p[3] << 24);
+}
+
+static unsigned long
+cmddb_hash_2 (const void *key)
+{
+  const unsigned char *p = ((struct cmddb_entry const *) key)->rec.key;
+  return (p[4] | (p[5] << 8) | ((unsigned long) p[6] << 16)
+          | ((unsigned long) p[7] << 24)) | 1;
+}
+
+static int
+cmddb_hash_cmp (const void *x, const void *y)
+{
+  return memcmp (((struct cmddb_entry const *) x)->rec.key,
+                 ((struct cmddb_entry const *) y)->rec.key, 8);
+}
+
+/* Returns the index of the home slot for KEY in a table of RECORDS. */
+static unsigned int
+cmddb_slot (const unsigned char *key, unsigned int records)
+{
+  return (key[0] | (key[1] << 8) | ((unsigned int) key[2] << 16)
+          | ((unsigned int) key[3] << 24)) & (records - 1);
+}
+
+/* Validates a database image, returning the record count or 0.  */
+static unsigned int
+cmddb_validate (const unsigned char *view, size_t size)
+{
+  struct cmddb_header hdr;
+
+  if (!view || size < sizeof (hdr))
+    return 0;
+  memcpy (&hdr, view, sizeof (hdr));
+  if (   memcmp (hdr.magic, CMDDB_MAGIC, sizeof (hdr.magic))
+      || !hdr.records
+      || (hdr.records & (hdr.records - 1))
+      || size != sizeof (hdr) + (size_t) hdr.records * sizeof (struct cmddb_record))
+    return 0;
+  return hdr.records;
+}
+
+/* Looks up KEY in the database image VIEW.  */
+static const struct cmddb_record *
+cmddb_find (const unsigned char *view, size_t size, const unsigned char *key)
+{
+  unsigned int records = cmddb_validate (view, size);
+  const struct cmddb_record *recs;
+  unsigned int i, n;
+
+  if (!records)
+    return NULL;
+  recs = (const struct cmddb_record *) (view + sizeof (struct cmddb_header));
+  i = cmddb_slot (key, records);
+  for (n = 0; n < records; n++, i = (i + 1) & (records - 1))
+    {
+      static const unsigned char zero_key[8];
+      if (!memcmp (recs[i].key, key, 8))
+        return &recs[i];
+      if (!memcmp (recs[i].key, zero_key, 8))
+        break;
+    }
+  return NULL;
+}
+
+/* Maps (or reads) the database file, returning NULL if it doesn't exist or
+   is empty.  */
+static unsigned char *
+cmddb_map (size_t *sizep)
+{
+  struct stat st;
+  unsigned char *view;
+  int fd;
+
+  *sizep = 0;
+  fd = open (cmddb_filename, O_RDONLY | O_BINARY);
+  if (fd < 0)
+    return NULL;
+  if (fstat (fd, &st) != 0 || st.st_size <= 0)
+    {
+      close (fd);
+      return NULL;
+    }
+#ifndef WINDOWS32
+  view = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (view == MAP_FAILED)
+    view = NULL;
+#else
+  view = xmalloc (st.st_size);
+  if (read (fd, view, st.st_size) != st.st_size)
+    {
+      free (view);
+      view = NULL;
+    }
+#endif
+  close (fd);
+  if (view)
+    *sizep = st.st_size;
+  return view;
+}
+
+static void
+cmddb_unmap (unsigned char *view, size_t size)
+{
+  if (!view)
+    return;
+#ifndef WINDOWS32
+  munmap (view, size);
+#else
+  (void) size;
+  free (view);
+#endif
+}
+
+/* Checks KMK_CMD_DB and maps the database the first time around.
+   Returns nonzero if we've got a database.  */
+static int
+cmddb_init (void)
+{
+  struct variable *v;
+  char *name;
+  char buf[GET_PATH_MAX];
+
+  if (cmddb_state)
+    return cmddb_state > 0;
+  cmddb_state = -1;
+
+  v = lookup_variable ("KMK_CMD_DB", sizeof ("KMK_CMD_DB") - 1);
+  if (!v || !v->value_length)
+    return 0;
+  if (v->recursive && memchr (v->value, '$', v->value_length))
+    name = allocated_variable_expand (v->value);
+  else
+    name = xstrdup (v->value);
+  if (!*name || !abspath (name, buf))
+    {
+      free (name);
+      return 0;
+    }
+  free (name);
+
+  cmddb_filename = xstrdup (buf);
+  hash_init (&cmddb_updates, CMDDB_BUCKETS, cmddb_hash_1, cmddb_hash_2,
+             cmddb_hash_cmp);
+  cmddb_view = cmddb_map (&cmddb_view_size);
+  cmddb_state = 1;
+  DB (DB_BASIC, (_("Mapped %lu bytes of command fingerprints from '%s'.\n"),
+                 (unsigned long) cmddb_view_size, cmddb_filename));
+  return 1;
+}
+
+/* Checks whether the expanded commands CMDS (LEN chars) of FILE match the
+   fingerprint recorded the last time they completed.  The new fingerprint
+   is remembered and will be recorded if the commands are run and succeed.
+   Returns nonzero if the commands changed or nothing was recorded.  */
+int
+cmd_db_check (struct file *file, const char *cmds, size_t len)
+{
+  struct MD5Context ctx;
+  struct cmddb_entry *entry;
+  struct cmddb_entry key;
+  const struct cmddb_record *old;
+  char buf[GET_PATH_MAX];
+  const char *name;
+  unsigned char digest[16];
+  static const unsigned char zero_key[8];
+
+  if (!cmddb_init ())
+    {
+      static int warned = 0;
+      if (!warned)
+        {
+          warned = 1;
+          OS (error, reading_file,
+              _("$(comp-cmds-db ) used for '%s' without KMK_CMD_DB; treating commands as changed"),
+              file->name);
+        }
+      return 1;
+    }
+
+  /* The key: target names are relative to the current directory, so use
+     the absolute name to keep sub-makes apart.  */
+  name = abspath (file->name, buf);
+  if (!name)
+    name = file->name;
+  MD5Init (&ctx);
+  MD5Update (&ctx, (const unsigned char *) name, strlen (name));
+  MD5Final (digest, &ctx);
+  memcpy (key.rec.key, digest, 8);
+  if (!memcmp (key.rec.key, zero_key, 8))
+    key.rec.key[0] = 1;
+
+  MD5Init (&ctx);
+  MD5Update (&ctx, (const unsigned char *) cmds, (unsigned) len);
+  MD5Final (digest, &ctx);
+
+  entry = hash_find_item (&cmddb_updates, &key);
+  if (entry && entry->done)
+    old = &entry->rec;
+  else
+    old = cmddb_find (cmddb_view, cmddb_view_size, key.rec.key);
+
+  if (!entry)
+    {
+      entry = xmalloc (sizeof (*entry));
+      memcpy (entry->rec.key, key.rec.key, 8);
+      hash_insert (&cmddb_updates, entry);
+    }
+  else if (entry->done)
+    {
+      /* Copy the old digest before overwriting it.  */
+      memcpy (key.rec.digest, entry->rec.digest, 16);
+      old = &key.rec;
+      cmddb_dirty--;
+    }
+  memcpy (entry->rec.digest, digest, 16);
+  entry->done = 0;
+  file->cmd_db = entry;
+
+  return !old || memcmp (old->digest, digest, 16) != 0;
+}
+
+/* Records the fingerprint calculated for FILE by cmd_db_check now that its
+   commands have completed successfully.  */
+void
+cmd_db_record (struct file *file)
+{
+  struct cmddb_entry *entry = file->cmd_db;
+  if (entry && !entry->done)
+    {
+      entry->done = 1;
+      cmddb_dirty++;
+    }
+}
+
+/* Inserts REC into the table RECS of RECORDS entries, replacing any record
+   with the same key.  Returns 1 if a new record was used, else 0.  */
+static int
+cmddb_insert (struct cmddb_record *recs, unsigned int records,
+              const struct cmddb_record *rec)
+{
+  static const unsigned char zero_key[8];
+  unsigned int i = cmddb_slot (rec->key, records);
+  for (;;)
+    {
+      if (!memcmp (recs[i].key, zero_key, 8))
+        {
+          recs[i] = *rec;
+          return 1;
+        }
+      if (!memcmp (recs[i].key, rec->key, 8))
+        {
+          recs[i] = *rec;
+          return 0;
+        }
+      i = (i + 1) & (records - 1);
+    }
+}
+
+/* Writes the fingerprints recorded by this instance to the database.  The
+   file is re-read under a lock so updates made by concurrent kmk instances
+   aren't lost, and replaced atomically by renaming a temporary file.  */
+void
+cmd_db_save (void)
+{
+  struct cmddb_header hdr;
+  struct cmddb_record *recs;
+  struct cmddb_entry **slot;
+  struct cmddb_entry **end;
+  unsigned char *view;
+  size_t view_size;
+  unsigned int old_records;
+  unsigned int records;
+  unsigned int i;
+  char *lockname;
+  char *tmpname;
+  int lock_fd;
+  int fd;
+  int ok;
+
+  if (cmddb_state <= 0 || !cmddb_dirty)
+    return;
+  cmddb_dirty = 0;
+
+  lockname = xmalloc (strlen (cmddb_filename) + 32);
+  tmpname = xmalloc (strlen (cmddb_filename) + 32);
+  sprintf (lockname, "%s.lock", cmddb_filename);
+  sprintf (tmpname, "%s.%ld.tmp", cmddb_filename, (long) getpid ());
+
+  lock_fd = open (lockname, O_RDWR | O_CREAT | O_BINARY, 0666);
+#ifndef WINDOWS32
+  if (lock_fd >= 0)
+    while (flock (lock_fd, LOCK_EX) != 0 && errno == EINTR)
+      /* nothing */;
+#else
+  if (lock_fd >= 0)
+    while (_locking (lock_fd, _LK_LOCK, 1) != 0 && errno == EDEADLOCK)
+      /* _LK_LOCK gives up after 10 seconds, keep trying. */;
+#endif
+
+  /* Merge the current file content with our updates.  */
+  view = cmddb_map (&view_size);
+  old_records = cmddb_validate (view, view_size);
+  hdr.used = 0;
+  if (old_records)
+    memcpy (&hdr, view, sizeof (hdr));
+
+  records = CMDDB_MIN_RECORDS;
+  while (records / 2 < hdr.used + cmddb_updates.ht_fill)
+    records *= 2;
+  recs = xcalloc ((size_t) records * sizeof (*recs));
+
+  memcpy (hdr.magic, CMDDB_MAGIC, sizeof (hdr.magic));
+  hdr.records = records;
+  hdr.used = 0;
+  if (old_records)
+    {
+      static const unsigned char zero_key[8];
+      const struct cmddb_record *old =
+        (const struct cmddb_record *) (view + sizeof (hdr));
+      for (i = 0; i < old_records; i++)
+        if (memcmp (old[i].key, zero_key, 8))
+          hdr.used += cmddb_insert (recs, records, &old[i]);
+    }
+  cmddb_unmap (view, view_size);
+
+  slot = (struct cmddb_entry **) cmddb_updates.ht_vec;
+  end = slot + cmddb_updates.ht_size;
+  for (; slot < end; slot++)
+    if (!HASH_VACANT (*slot) && (*slot)->done)
+      hdr.used += cmddb_insert (recs, records, &(*slot)->rec);
+
+  fd = open (tmpname, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+  if (fd < 0)
+    OSS (error, NILF, _("KMK_CMD_DB: failed to create '%s': %s"),
+         tmpname, strerror (errno));
+  else
+    {
+      size_t cb = (size_t) records * sizeof (*recs);
+      ok = write (fd, &hdr, sizeof (hdr)) == (ssize_t) sizeof (hdr)
+        && write (fd, recs, cb) == (ssize_t) cb;
+      ok = close (fd) == 0 && ok;
+#ifdef WINDOWS32
+      if (ok)
+        unlink (cmddb_filename);
+#endif
+      if (!ok || rename (tmpname, cmddb_filename) != 0)
+        {
+          OSS (error, NILF, _("KMK_CMD_DB: failed to write '%s': %s"),
+               cmddb_filename, strerror (errno));
+          unlink (tmpname);
+        }
+    }
+  free (recs);
+
+  if (lock_fd >= 0)
+    {
+#ifndef WINDOWS32
+      flock (lock_fd, LOCK_UN);
+#else
+      _locking (lock_fd, _LK_UNLCK, 1);
+#endif
+      close (lock_fd);
+    }
+  free (lockname);
+  free (tmpname);
+}
+
+#endif /* CONFIG_WITH_CMD_DB */
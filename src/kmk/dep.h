@@ -173,12 +173,24 @@ struct dep *copy_dep_chain (const struct dep *d);
 
 struct goaldep *read_all_makefiles (const char **makefiles);
 void eval_buffer (char *buffer, const floc *floc IF_WITH_VALUE_LENGTH(COMMA char *eos));
+#ifdef CONFIG_WITH_COMPILER
+void eval_buffer_for_compiler (char *buffer, char *eos, const floc *flocp,
+                               int count_lines);
+char *eval_prep_line_for_compiler (char *line, unsigned int linelen);
+void eval_include_for_compiler (char *names, int noerror, const floc *flocp);
+#endif
 enum update_status update_goal_chain (struct goaldep *goals);
+#ifdef CONFIG_WITH_DIRCACHE
+void prefetch_goal_mtimes (struct goaldep *goals);
+#endif
 
 #ifdef CONFIG_WITH_INCLUDEDEP
 /* incdep.c */
-enum incdep_op { incdep_read_it, incdep_queue, incdep_flush };
+enum incdep_op { incdep_read_it, incdep_queue, incdep_flush, incdep_prefetch };
 void eval_include_dep (const char *name, floc *f, enum incdep_op op);
+char *incdep_take_prefetched_makefile (const char *name, size_t *sizep,
+                                       FILE_TIMESTAMP *mtimep);
 void incdep_flush_and_term (void);
+extern int incdep_threads_option;
 #endif
 
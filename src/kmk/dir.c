@@ -1410,6 +1410,9 @@ print_dir_data_base (void)
 
 void print_dir_stats (void)
 {
+# ifdef CONFIG_WITH_DIRCACHE
+  dir_cache_print_stats ();
+# endif
   /** @todo normal dir stats.  */
 }
 #endif
@@ -1565,7 +1568,11 @@ dir_setup_glob (glob_t *gl)
   gl->gl_opendir = open_dirstream;
   gl->gl_readdir = read_dirstream;
   gl->gl_closedir = free;
+#ifdef CONFIG_WITH_DIRCACHE
+  gl->gl_stat = dir_cache_stat;
+#else
   gl->gl_stat = local_stat;
+#endif
 #ifdef __EMX__ /* The FreeBSD implementation actually uses gl_lstat!! */
   gl->gl_lstat = local_stat;
 #endif
@@ -1598,5 +1605,8 @@ hash_init_directories (void)
   alloccache_init (&dirfile_cache, sizeof (struct dirfile),
                    "dirfile", NULL, NULL);
 #endif /* CONFIG_WITH_ALLOC_CACHES */
+#ifdef CONFIG_WITH_DIRCACHE
+  dir_cache_init ();
+#endif
 }
 
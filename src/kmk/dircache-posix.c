@@ -0,0 +1,1197 @@
+/* $Id$ */
+/** @file
+ * Directory and stat cache for POSIX hosts.
+ *
+ * This is the POSIX counterpart to the kFsCache usage in dir-nt-bird.c.  It
+ * caches stat() results per path and, for directories seeing repeated misses,
+ * the sorted list of names in the directory so that further misses can be
+ * answered without hitting the file system.
+ *
+ * The cache is invalidated using revision counters: everything after each job
+ * (or only the volatile directories when such have been configured), unless
+ * inotify is available, in which case only the directories that actually
+ * changed gets invalidated.
+ *
+ * To hide the stat latency of network file systems, dir_cache_prefetch can
+ * fill the cache for a batch of paths using a few threads before the remake
+ * pass asks for them one by one.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "makeint.h"
+#include "hash.h"
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#if defined(__linux__) || defined(__linux)
+# include <sys/inotify.h>
+# define DIRCACHE_WITH_INOTIFY
+#endif
+#include "kmkbuiltin.h"
+#include "kmkbuiltin/err.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Initial number of buckets in the path hash table. */
+#define DIRCACHE_PATH_BUCKETS       8191
+/** Initial number of buckets in the directory hash table. */
+#define DIRCACHE_DIR_BUCKETS        1021
+/** Number of misses in a directory before we load its name listing. */
+#define DIRCACHE_LIST_AFTER_MISSES  2
+/** Number of paths a prefetch thread grabs at a time. */
+#define DIRCACHE_PREFETCH_CHUNK     32
+/** Max number of prefetch threads. */
+#define DIRCACHE_PREFETCH_MAX_THREADS 64
+
+#ifdef DIRCACHE_WITH_INOTIFY
+/** The events we watch directories for.  Anything that may change the stat
+ * result of a directory member or the list of members. */
+# define DIRCACHE_INOTIFY_MASK      (  IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF \
+                                     | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#endif
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Revision snapshot taken when caching something.
+ */
+typedef struct DIRCACHEREV
+{
+    /** g_uAllRev. */
+    unsigned            uAll;
+    /** The directory revision (DIRCACHEDIR::uRev). */
+    unsigned            uDir;
+    /** g_uJobRev. */
+    unsigned            uJob;
+    /** g_uVolatileRev. */
+    unsigned            uVolatile;
+    /** g_uMissingRev. */
+    unsigned            uMissing;
+    /** Set if the path is a symbolic link.  The target may live in some other
+     * directory, so the inotify watch doesn't cover it and only uJob counts. */
+    unsigned            fSymlink;
+} DIRCACHEREV;
+
+/**
+ * A directory.
+ */
+typedef struct DIRCACHEDIR
+{
+    /** The path as used in lookups ("." for the current directory).  */
+    const char         *pszPath;
+    /** The length of the path. */
+    unsigned            cchPath;
+    /** The revision of this directory, incremented when inotify says
+     * something changed in it. */
+    unsigned            uRev;
+    /** Set if the directory is considered volatile. */
+    int                 fVolatile;
+    /** The inotify watch descriptor, -1 if not watched. */
+    int                 wd;
+    /** Next directory sharing the same watch descriptor (same directory
+     * reached thru a different path). */
+    struct DIRCACHEDIR *pNextSameWd;
+    /** The g_uJobRev of the last failed watch attempt (to avoid retrying it
+     * for every lookup). */
+    unsigned            uWatchFailedJobRev;
+    /** Number of misses since we last loaded the listing. */
+    unsigned            cMisses;
+    /** The status of the name listing: -1 if not loaded, 0 if loaded and
+     * valid, otherwise the errno value from opendir (ENOENT / ENOTDIR). */
+    int                 iListErr;
+    /** The revision snapshot of the listing. */
+    DIRCACHEREV         ListRev;
+    /** Number of names in the listing. */
+    unsigned            cNames;
+    /** Sorted array of names in the listing. */
+    char              **papszNames;
+    /** The string buffer for papszNames. */
+    char               *pszNameBuf;
+    /** The path storage. */
+    char                szPath[1];
+} DIRCACHEDIR;
+typedef DIRCACHEDIR *PDIRCACHEDIR;
+
+/**
+ * A cached stat result.
+ */
+typedef struct DIRCACHEENTRY
+{
+    /** The path (points to szPath). */
+    const char         *pszPath;
+    /** The length of the path. */
+    unsigned            cchPath;
+    /** The directory containing this entry. */
+    PDIRCACHEDIR        pDir;
+    /** The revision snapshot, stale (uAll != g_uAllRev) if nothing is cached. */
+    DIRCACHEREV         Rev;
+    /** The errno value if the stat failed, otherwise 0. */
+    int                 iErr;
+    /** The stat result if iErr is 0. */
+    struct stat         St;
+    /** The path storage. */
+    char                szPath[1];
+} DIRCACHEENTRY;
+typedef DIRCACHEENTRY *PDIRCACHEENTRY;
+
+/**
+ * Work shared by the dir_cache_prefetch threads.
+ */
+typedef struct DIRCACHEPREFETCH
+{
+    /** The entries to stat. */
+    PDIRCACHEENTRY     *papEntries;
+    /** Number of entries. */
+    unsigned            cEntries;
+    /** The next entry to hand out. */
+    unsigned            iNext;
+    /** Protects iNext. */
+    pthread_mutex_t     Mtx;
+} DIRCACHEPREFETCH;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Set if the cache is enabled (KMK_DIRCACHE != 0). */
+static int              g_fEnabled = 0;
+/** Set after initialization. */
+static int              g_fInitialized = 0;
+/** The main thread, we only let it access the cache. */
+static pthread_t        g_hMainThread;
+/** Path -> DIRCACHEENTRY. */
+static struct hash_table g_PathHash;
+/** Directory path -> DIRCACHEDIR. */
+static struct hash_table g_DirHash;
+
+/** Revision invalidating everything. */
+static unsigned         g_uAllRev = 0;
+/** Revision incremented after each job.  With inotify this only affects
+ * directories we don't have a watch on. */
+static unsigned         g_uJobRev = 0;
+/** Revision incremented after each job when there are volatile
+ * directories and we don't have inotify. */
+static unsigned         g_uVolatileRev = 0;
+/** Revision invalidating all negative results. */
+static unsigned         g_uMissingRev = 0;
+/** Set by dir_cache_volatile_dir to indicate that the user has marked the
+ * volatile parts of the file system, so only these needs flushing after
+ * jobs. */
+static int              g_fHaveVolatileDirs = 0;
+/** The volatile directory prefixes. */
+static char           **g_papszVolatileDirs = NULL;
+/** Number of volatile directory prefixes. */
+static unsigned         g_cVolatileDirs = 0;
+
+#ifdef DIRCACHE_WITH_INOTIFY
+/** The inotify file descriptor, -1 if not used. */
+static int              g_fdInotify = -1;
+/** Watch descriptor to directory table (chained via pNextSameWd). */
+static PDIRCACHEDIR    *g_papWdDirs = NULL;
+/** Number of entries in g_papWdDirs. */
+static unsigned         g_cWdDirs = 0;
+#endif
+
+/** @name Statistics
+ * @{ */
+static unsigned long    g_cLookups = 0;
+static unsigned long    g_cHits = 0;
+static unsigned long    g_cListingHits = 0;
+static unsigned long    g_cStats = 0;
+static unsigned long    g_cPrefetched = 0;
+static unsigned long    g_cListings = 0;
+static unsigned long    g_cInvalidations = 0;
+static unsigned long    g_cWatches = 0;
+static unsigned long    g_cInotifyEvents = 0;
+static unsigned long    g_cInotifyOverflows = 0;
+/** @} */
+
+
+/*********************************************************************************************************************************
+*   Internal Functions                                                                                                           *
+*********************************************************************************************************************************/
+static PDIRCACHEDIR dirCacheLookupDir(const char *pszPath, unsigned cchPath, int fCreate);
+
+
+static unsigned long dirCacheEntryHash1(const void *pvKey)
+{
+    PDIRCACHEENTRY pEntry = (PDIRCACHEENTRY)pvKey;
+    unsigned long uHash = 0;
+    STRING_N_HASH_1(pEntry->pszPath, pEntry->cchPath, uHash);
+    return uHash;
+}
+
+static unsigned long dirCacheEntryHash2(const void *pvKey)
+{
+    PDIRCACHEENTRY pEntry = (PDIRCACHEENTRY)pvKey;
+    unsigned long uHash = 0;
+    STRING_N_HASH_2(pEntry->pszPath, pEntry->cchPath, uHash);
+    return uHash;
+}
+
+static int dirCacheEntryCompare(const void *pvKey1, const void *pvKey2)
+{
+    PDIRCACHEENTRY pEntry1 = (PDIRCACHEENTRY)pvKey1;
+    PDIRCACHEENTRY pEntry2 = (PDIRCACHEENTRY)pvKey2;
+    if (pEntry1->cchPath != pEntry2->cchPath)
+        return pEntry1->cchPath < pEntry2->cchPath ? -1 : 1;
+    return memcmp(pEntry1->pszPath, pEntry2->pszPath, pEntry1->cchPath);
+}
+
+static unsigned long dirCacheDirHash1(const void *pvKey)
+{
+    PDIRCACHEDIR pDir = (PDIRCACHEDIR)pvKey;
+    unsigned long uHash = 0;
+    STRING_N_HASH_1(pDir->pszPath, pDir->cchPath, uHash);
+    return uHash;
+}
+
+static unsigned long dirCacheDirHash2(const void *pvKey)
+{
+    PDIRCACHEDIR pDir = (PDIRCACHEDIR)pvKey;
+    unsigned long uHash = 0;
+    STRING_N_HASH_2(pDir->pszPath, pDir->cchPath, uHash);
+    return uHash;
+}
+
+static int dirCacheDirCompare(const void *pvKey1, const void *pvKey2)
+{
+    PDIRCACHEDIR pDir1 = (PDIRCACHEDIR)pvKey1;
+    PDIRCACHEDIR pDir2 = (PDIRCACHEDIR)pvKey2;
+    if (pDir1->cchPath != pDir2->cchPath)
+        return pDir1->cchPath < pDir2->cchPath ? -1 : 1;
+    return memcmp(pDir1->pszPath, pDir2->pszPath, pDir1->cchPath);
+}
+
+
+/**
+ * Finds the last slash in a string (memrchr isn't everywhere).
+ */
+static const char *dirCacheFindLastSlash(const char *pch, size_t cch)
+{
+    while (cch-- > 0)
+        if (pch[cch] == '/')
+            return &pch[cch];
+    return NULL;
+}
+
+
+/**
+ * Initializes the cache.
+ *
+ * Must be called on the main thread before any other API.  Reads the
+ * KMK_DIRCACHE and KMK_DIRCACHE_INOTIFY environment variables, setting either
+ * to '0' disables the cache or the inotify use respectively.
+ */
+void dir_cache_init(void)
+{
+    const char *pszEnv;
+    if (g_fInitialized)
+        return;
+    g_fInitialized = 1;
+    g_hMainThread = pthread_self();
+
+    pszEnv = getenv("KMK_DIRCACHE");
+    g_fEnabled = !pszEnv || strcmp(pszEnv, "0") != 0;
+    if (!g_fEnabled)
+        return;
+
+    hash_init(&g_PathHash, DIRCACHE_PATH_BUCKETS, dirCacheEntryHash1, dirCacheEntryHash2, dirCacheEntryCompare);
+    hash_init(&g_DirHash, DIRCACHE_DIR_BUCKETS, dirCacheDirHash1, dirCacheDirHash2, dirCacheDirCompare);
+
+#ifdef DIRCACHE_WITH_INOTIFY
+    pszEnv = getenv("KMK_DIRCACHE_INOTIFY");
+    if (!pszEnv || strcmp(pszEnv, "0") != 0)
+        g_fdInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+
+/**
+ * Checks if we're on the main thread and the cache is enabled.
+ */
+static int dirCacheIsUsable(void)
+{
+    return g_fEnabled
+        && pthread_equal(pthread_self(), g_hMainThread);
+}
+
+
+/**
+ * Checks whether the given path is within one of the volatile directories.
+ */
+static int dirCacheIsVolatilePath(const char *pszPath, unsigned cchPath)
+{
+    unsigned i;
+    for (i = 0; i < g_cVolatileDirs; i++)
+    {
+        const char *pszPrefix = g_papszVolatileDirs[i];
+        unsigned    cchPrefix = (unsigned)strlen(pszPrefix);
+        if (   cchPrefix <= cchPath
+            && memcmp(pszPath, pszPrefix, cchPrefix) == 0
+            && (cchPrefix == cchPath || pszPath[cchPrefix] == '/'))
+            return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Takes a revision snapshot for the given directory.
+ */
+static void dirCacheSnapshot(PDIRCACHEDIR pDir, DIRCACHEREV *pRev)
+{
+    pRev->uAll      = g_uAllRev;
+    pRev->uDir      = pDir->uRev;
+    pRev->uJob      = g_uJobRev;
+    pRev->uVolatile = g_uVolatileRev;
+    pRev->uMissing  = g_uMissingRev;
+    pRev->fSymlink  = 0;
+}
+
+
+/**
+ * Checks if a revision snapshot is still valid.
+ *
+ * @returns 1 if valid, 0 if stale.
+ * @param   pDir        The directory the snapshot belongs to.
+ * @param   pRev        The snapshot.
+ * @param   fNegative   Set if the snapshot is for a negative result, which is
+ *                      also invalidated by dir_cache_invalid_missing().
+ */
+static int dirCacheIsValid(PDIRCACHEDIR pDir, DIRCACHEREV const *pRev, int fNegative)
+{
+    if (   pRev->uAll != g_uAllRev
+        || pRev->uDir != pDir->uRev)
+        return 0;
+    if (fNegative && pRev->uMissing != g_uMissingRev)
+        return 0;
+#ifdef DIRCACHE_WITH_INOTIFY
+    if (g_fdInotify >= 0)
+        return (pDir->wd >= 0 && !pRev->fSymlink) || pRev->uJob == g_uJobRev;
+#endif
+    if (pDir->fVolatile && pRev->uVolatile != g_uVolatileRev)
+        return 0;
+    return 1;
+}
+
+
+/**
+ * Bumps the revision of a directory and of its parent (whose stat of the
+ * directory itself becomes stale).
+ */
+static void dirCacheBumpDir(PDIRCACHEDIR pDir)
+{
+    const char *pszSlash;
+    pDir->uRev++;
+
+    pszSlash = dirCacheFindLastSlash(pDir->pszPath, pDir->cchPath);
+    if (pszSlash)
+    {
+        PDIRCACHEDIR pParent = dirCacheLookupDir(pDir->pszPath, pszSlash != pDir->pszPath
+                                                 ? (unsigned)(pszSlash - pDir->pszPath) : 1, 0 /*fCreate*/);
+        if (pParent && pParent != pDir)
+            pParent->uRev++;
+    }
+    else if (pDir->cchPath != 1 || pDir->pszPath[0] != '.')
+    {
+        PDIRCACHEDIR pParent = dirCacheLookupDir(".", 1, 0 /*fCreate*/);
+        if (pParent)
+            pParent->uRev++;
+    }
+}
+
+
+#ifdef DIRCACHE_WITH_INOTIFY
+
+/**
+ * Tries to add an inotify watch for the directory.
+ */
+static void dirCacheWatchDir(PDIRCACHEDIR pDir)
+{
+    int wd;
+    if (   g_fdInotify < 0
+        || pDir->wd >= 0
+        || pDir->uWatchFailedJobRev == g_uJobRev)
+        return;
+
+    wd = inotify_add_watch(g_fdInotify, pDir->pszPath, DIRCACHE_INOTIFY_MASK);
+    if (wd >= 0)
+    {
+        if ((unsigned)wd >= g_cWdDirs)
+        {
+            unsigned cNew = (wd + 64) & ~63U;
+            g_papWdDirs = (PDIRCACHEDIR *)xrealloc(g_papWdDirs, cNew * sizeof(g_papWdDirs[0]));
+            memset(&g_papWdDirs[g_cWdDirs], 0, (cNew - g_cWdDirs) * sizeof(g_papWdDirs[0]));
+            g_cWdDirs = cNew;
+        }
+        pDir->wd = wd;
+        pDir->pNextSameWd = g_papWdDirs[wd];
+        g_papWdDirs[wd] = pDir;
+        g_cWatches++;
+
+        /* Whatever we cached while not watching may have changed since. */
+        pDir->uRev++;
+    }
+    else
+        pDir->uWatchFailedJobRev = g_uJobRev;
+}
+
+
+/**
+ * Drains the inotify queue, bumping the revisions of the directories that
+ * changed.
+ */
+static void dirCacheDrainInotify(void)
+{
+    union
+    {
+        struct inotify_event Event;
+        char ab[16384];
+    } uBuf;
+    for (;;)
+    {
+        ssize_t cbRead = read(g_fdInotify, &uBuf, sizeof(uBuf));
+        size_t  off;
+        if (cbRead <= 0)
+        {
+            if (cbRead < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (off = 0; off < (size_t)cbRead; )
+        {
+            struct inotify_event const *pEvent = (struct inotify_event const *)&uBuf.ab[off];
+            g_cInotifyEvents++;
+            if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+                g_cInotifyOverflows++;
+                g_uAllRev++;
+            }
+            else if (pEvent->wd >= 0 && (unsigned)pEvent->wd < g_cWdDirs)
+            {
+                PDIRCACHEDIR pDir = g_papWdDirs[pEvent->wd];
+                if (pEvent->mask & IN_IGNORED)
+                {
+                    /* The watch is gone (directory deleted or unmounted). */
+                    g_papWdDirs[pEvent->wd] = NULL;
+                    while (pDir)
+                    {
+                        PDIRCACHEDIR pNext = pDir->pNextSameWd;
+                        pDir->wd = -1;
+                        pDir->pNextSameWd = NULL;
+                        dirCacheBumpDir(pDir);
+                        pDir = pNext;
+                    }
+                }
+                else
+                    for (; pDir; pDir = pDir->pNextSameWd)
+                        dirCacheBumpDir(pDir);
+            }
+            off += sizeof(*pEvent) + pEvent->len;
+        }
+    }
+}
+
+#endif /* DIRCACHE_WITH_INOTIFY */
+
+
+/**
+ * Looks up a directory record.
+ *
+ * @returns Pointer to the directory record, NULL if not found and @a fCreate
+ *          is clear.
+ * @param   pszPath     The directory path (not necessarily terminated).
+ * @param   cchPath     The length of the path.
+ * @param   fCreate     Whether to create it if not found.
+ */
+static PDIRCACHEDIR dirCacheLookupDir(const char *pszPath, unsigned cchPath, int fCreate)
+{
+    DIRCACHEDIR     Key;
+    PDIRCACHEDIR   *ppSlot;
+    PDIRCACHEDIR    pDir;
+
+    Key.pszPath = pszPath;
+    Key.cchPath = cchPath;
+    ppSlot = (PDIRCACHEDIR *)hash_find_slot(&g_DirHash, &Key);
+    if (!HASH_VACANT(*ppSlot))
+        return *ppSlot;
+    if (!fCreate)
+        return NULL;
+
+    pDir = (PDIRCACHEDIR)xmalloc(offsetof(DIRCACHEDIR, szPath) + cchPath + 1);
+    memcpy(pDir->szPath, pszPath, cchPath);
+    pDir->szPath[cchPath]   = '\0';
+    pDir->pszPath           = pDir->szPath;
+    pDir->cchPath           = cchPath;
+    pDir->uRev              = 0;
+    pDir->fVolatile         = dirCacheIsVolatilePath(pszPath, cchPath);
+    pDir->wd                = -1;
+    pDir->pNextSameWd       = NULL;
+    pDir->uWatchFailedJobRev = ~0U;
+    pDir->cMisses           = 0;
+    pDir->iListErr          = -1;
+    pDir->cNames            = 0;
+    pDir->papszNames        = NULL;
+    pDir->pszNameBuf        = NULL;
+    hash_insert_at(&g_DirHash, pDir, ppSlot);
+    return pDir;
+}
+
+
+static int dirCacheCompareNames(const void *pv1, const void *pv2)
+{
+    return strcmp(*(char * const *)pv1, *(char * const *)pv2);
+}
+
+
+/**
+ * (Re)loads the name listing of a directory.
+ */
+static void dirCacheLoadListing(PDIRCACHEDIR pDir)
+{
+    DIR    *pDirStream;
+    size_t  cbBuf   = 0;
+    size_t  cbAlloc = 0;
+    char   *pszBuf  = NULL;
+    unsigned cNames = 0;
+
+    free(pDir->papszNames);
+    free(pDir->pszNameBuf);
+    pDir->papszNames = NULL;
+    pDir->pszNameBuf = NULL;
+    pDir->cNames     = 0;
+    pDir->cMisses    = 0;
+    g_cListings++;
+
+    /* Take the snapshot first so that we don't miss changes made while
+       reading the directory. */
+    dirCacheSnapshot(pDir, &pDir->ListRev);
+
+    pDirStream = opendir(pDir->pszPath);
+    if (!pDirStream)
+    {
+        pDir->iListErr = errno == ENOENT || errno == ENOTDIR ? errno : -1;
+        return;
+    }
+
+    for (;;)
+    {
+        struct dirent *pEnt = readdir(pDirStream);
+        size_t cchName;
+        if (!pEnt)
+            break;
+        cchName = strlen(pEnt->d_name);
+        if (cbBuf + cchName + 1 > cbAlloc)
+        {
+            cbAlloc = cbAlloc ? cbAlloc * 2 : 4096;
+            if (cbAlloc < cbBuf + cchName + 1)
+                cbAlloc = cbBuf + cchName + 1;
+            pszBuf = (char *)xrealloc(pszBuf, cbAlloc);
+        }
+        memcpy(&pszBuf[cbBuf], pEnt->d_name, cchName + 1);
+        cbBuf += cchName + 1;
+        cNames++;
+    }
+    closedir(pDirStream);
+
+    pDir->pszNameBuf = pszBuf;
+    pDir->cNames     = cNames;
+    if (cNames)
+    {
+        unsigned i;
+        size_t   off = 0;
+        pDir->papszNames = (char **)xmalloc(cNames * sizeof(pDir->papszNames[0]));
+        for (i = 0; i < cNames; i++)
+        {
+            pDir->papszNames[i] = &pszBuf[off];
+            off += strlen(&pszBuf[off]) + 1;
+        }
+        qsort(pDir->papszNames, cNames, sizeof(pDir->papszNames[0]), dirCacheCompareNames);
+    }
+    pDir->iListErr = 0;
+}
+
+
+/**
+ * Checks a valid listing for the presence of a name.
+ *
+ * @returns 0 if present (or unknown), ENOENT or ENOTDIR if known to be absent.
+ */
+static int dirCacheCheckListing(PDIRCACHEDIR pDir, const char *pszName)
+{
+    if (pDir->iListErr > 0)
+        return pDir->iListErr == ENOTDIR ? ENOTDIR : ENOENT;
+    if (pDir->iListErr == 0)
+    {
+        if (!bsearch(&pszName, pDir->papszNames, pDir->cNames, sizeof(pDir->papszNames[0]), dirCacheCompareNames))
+            return ENOENT;
+    }
+    return 0;
+}
+
+
+/**
+ * Looks up (creating if necessary) the cache entry for a path.
+ *
+ * @returns Pointer to the entry, NULL if the path isn't suitable for caching.
+ * @param   pszPath     The path.
+ * @param   ppszName    Where to return the final component.
+ */
+static PDIRCACHEENTRY dirCacheLookupEntry(const char *pszPath, const char **ppszName)
+{
+    DIRCACHEENTRY   Key;
+    PDIRCACHEENTRY *ppSlot;
+    PDIRCACHEENTRY  pEntry;
+    size_t          cchPath = strlen(pszPath);
+    const char     *pszName;
+    PDIRCACHEDIR    pDir;
+
+    /* Only plain paths with a real final component. */
+    if (   cchPath == 0
+        || cchPath >= 0x10000000
+        || pszPath[cchPath - 1] == '/')
+        return NULL;
+    pszName = dirCacheFindLastSlash(pszPath, cchPath);
+    pszName = pszName ? pszName + 1 : pszPath;
+    *ppszName = pszName;
+
+    Key.pszPath = pszPath;
+    Key.cchPath = (unsigned)cchPath;
+    ppSlot = (PDIRCACHEENTRY *)hash_find_slot(&g_PathHash, &Key);
+    if (!HASH_VACANT(*ppSlot))
+        return *ppSlot;
+
+    if (pszName == pszPath)
+        pDir = dirCacheLookupDir(".", 1, 1 /*fCreate*/);
+    else if (pszName - 1 == pszPath)
+        pDir = dirCacheLookupDir("/", 1, 1 /*fCreate*/);
+    else
+        pDir = dirCacheLookupDir(pszPath, (unsigned)(pszName - 1 - pszPath), 1 /*fCreate*/);
+
+    pEntry = (PDIRCACHEENTRY)xmalloc(offsetof(DIRCACHEENTRY, szPath) + cchPath + 1);
+    memcpy(pEntry->szPath, pszPath, cchPath + 1);
+    pEntry->pszPath  = pEntry->szPath;
+    pEntry->cchPath  = (unsigned)cchPath;
+    pEntry->pDir     = pDir;
+    pEntry->Rev.uAll = g_uAllRev - 1;
+    pEntry->iErr     = 0;
+    hash_insert_at(&g_PathHash, pEntry, ppSlot);
+    return pEntry;
+}
+
+
+/**
+ * Does the stat() call for an entry after its snapshot has been taken.
+ *
+ * With inotify, lstat() is used first so symbolic links can be flagged in
+ * the snapshot (see DIRCACHEREV::fSymlink), costing an extra call for links
+ * only.
+ *
+ * @returns 0 on success, -1 with errno set on failure.
+ * @param   pEntry      The entry.
+ */
+static int dirCacheStatEntry(PDIRCACHEENTRY pEntry)
+{
+    int rc;
+#ifdef DIRCACHE_WITH_INOTIFY
+    if (g_fdInotify >= 0)
+    {
+        EINTRLOOP(rc, lstat(pEntry->pszPath, &pEntry->St));
+        if (rc != 0 || !S_ISLNK(pEntry->St.st_mode))
+            return rc;
+        pEntry->Rev.fSymlink = 1;
+    }
+#endif
+    EINTRLOOP(rc, stat(pEntry->pszPath, &pEntry->St));
+    return rc;
+}
+
+
+/**
+ * Cached stat().
+ *
+ * Used by name_mtime, glob and friends on the main thread.  Falls back on a
+ * plain stat() call on other threads or when the cache is disabled.
+ *
+ * @returns 0 on success, -1 with errno set on failure.
+ * @param   pszPath     The path to stat.
+ * @param   pStat       Where to return the stat info.
+ */
+int dir_cache_stat(const char *pszPath, struct stat *pStat)
+{
+    PDIRCACHEENTRY  pEntry;
+    PDIRCACHEDIR    pDir;
+    const char     *pszName;
+    int             rc;
+
+    if (!dirCacheIsUsable())
+    {
+        EINTRLOOP(rc, stat(pszPath, pStat));
+        return rc;
+    }
+
+    g_cLookups++;
+    pEntry = dirCacheLookupEntry(pszPath, &pszName);
+    if (!pEntry)
+    {
+        EINTRLOOP(rc, stat(pszPath, pStat));
+        return rc;
+    }
+    pDir = pEntry->pDir;
+#ifdef DIRCACHE_WITH_INOTIFY
+    dirCacheWatchDir(pDir);
+#endif
+
+    /* Cached result still valid? */
+    if (dirCacheIsValid(pDir, &pEntry->Rev, pEntry->iErr != 0))
+    {
+        g_cHits++;
+        if (pEntry->iErr == 0)
+        {
+            *pStat = pEntry->St;
+            return 0;
+        }
+        errno = pEntry->iErr;
+        return -1;
+    }
+
+    /* Can the directory listing tell us it's missing? */
+    if (   pDir->iListErr != -1
+        && strcmp(pszName, ".") != 0
+        && strcmp(pszName, "..") != 0
+        && dirCacheIsValid(pDir, &pDir->ListRev, 1 /*fNegative*/))
+    {
+        int iErr = dirCacheCheckListing(pDir, pszName);
+        if (iErr)
+        {
+            g_cListingHits++;
+            dirCacheSnapshot(pDir, &pEntry->Rev);
+            pEntry->iErr = iErr;
+            errno = iErr;
+            return -1;
+        }
+    }
+
+    /* Ask the file system. */
+    g_cStats++;
+    dirCacheSnapshot(pDir, &pEntry->Rev);
+    rc = dirCacheStatEntry(pEntry);
+    if (rc == 0)
+    {
+        pEntry->iErr = 0;
+        *pStat = pEntry->St;
+        return 0;
+    }
+
+    pEntry->iErr = errno;
+    if (pEntry->iErr == ENOENT || pEntry->iErr == ENOTDIR)
+    {
+        /* Directories with repeated misses (include paths, vpath) gets their
+           listing loaded so the next miss is free. */
+        if (   ++pDir->cMisses >= DIRCACHE_LIST_AFTER_MISSES
+            && !dirCacheIsValid(pDir, &pDir->ListRev, 1 /*fNegative*/))
+            dirCacheLoadListing(pDir);
+    }
+    else
+        pEntry->Rev.uAll = g_uAllRev - 1; /* don't cache odd errors */
+    errno = pEntry->iErr;
+    return -1;
+}
+
+
+/**
+ * Prefetch thread: stats entries until there are no more.
+ *
+ * Each entry is handed to exactly one thread and the main thread waits for
+ * them all, so the results can be written straight into the entries.
+ */
+static void *dirCachePrefetchWorker(void *pvUser)
+{
+    DIRCACHEPREFETCH *pWork = (DIRCACHEPREFETCH *)pvUser;
+    for (;;)
+    {
+        unsigned i, iEnd;
+        pthread_mutex_lock(&pWork->Mtx);
+        i = pWork->iNext;
+        iEnd = i + DIRCACHE_PREFETCH_CHUNK < pWork->cEntries ? i + DIRCACHE_PREFETCH_CHUNK : pWork->cEntries;
+        pWork->iNext = iEnd;
+        pthread_mutex_unlock(&pWork->Mtx);
+        if (i >= iEnd)
+            break;
+
+        for (; i < iEnd; i++)
+        {
+            PDIRCACHEENTRY pEntry = pWork->papEntries[i];
+            int rc = dirCacheStatEntry(pEntry);
+            pEntry->iErr = rc == 0 ? 0 : errno;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Stats a batch of paths in parallel and caches the results, so that the
+ * following dir_cache_stat calls for them are hits.
+ *
+ * Paths with a valid cached result are skipped.  This does nothing if the
+ * cache isn't usable or there are less than two threads.
+ *
+ * @param   papszPaths  The paths.
+ * @param   cPaths      Number of paths.
+ * @param   cThreads    Number of threads to use, including the calling one.
+ */
+void dir_cache_prefetch(const char * const *papszPaths, unsigned cPaths, unsigned cThreads)
+{
+    DIRCACHEPREFETCH    Work;
+    pthread_t           ahThreads[DIRCACHE_PREFETCH_MAX_THREADS];
+    unsigned            cStarted = 0;
+    unsigned            i;
+
+    if (!dirCacheIsUsable() || cThreads < 2 || !cPaths)
+        return;
+    if (cThreads > DIRCACHE_PREFETCH_MAX_THREADS)
+        cThreads = DIRCACHE_PREFETCH_MAX_THREADS;
+
+    /* Collect the entries needing a stat.  The snapshot is taken before the
+       stat, as in dir_cache_stat, and marks the entry as queued so
+       duplicates are skipped. */
+    Work.papEntries = (PDIRCACHEENTRY *)xmalloc(cPaths * sizeof(Work.papEntries[0]));
+    Work.cEntries   = 0;
+    Work.iNext      = 0;
+    for (i = 0; i < cPaths; i++)
+    {
+        const char    *pszName;
+        PDIRCACHEENTRY pEntry = dirCacheLookupEntry(papszPaths[i], &pszName);
+        if (!pEntry)
+            continue;
+#ifdef DIRCACHE_WITH_INOTIFY
+        dirCacheWatchDir(pEntry->pDir);
+#endif
+        if (dirCacheIsValid(pEntry->pDir, &pEntry->Rev, pEntry->iErr != 0))
+            continue;
+        dirCacheSnapshot(pEntry->pDir, &pEntry->Rev);
+        pEntry->iErr = 0;
+        Work.papEntries[Work.cEntries++] = pEntry;
+    }
+
+    if (Work.cEntries)
+    {
+        pthread_mutex_init(&Work.Mtx, NULL);
+        if (cThreads > Work.cEntries / DIRCACHE_PREFETCH_CHUNK + 1)
+            cThreads = Work.cEntries / DIRCACHE_PREFETCH_CHUNK + 1;
+        while (cStarted + 1 < cThreads)
+        {
+            if (pthread_create(&ahThreads[cStarted], NULL, dirCachePrefetchWorker, &Work) != 0)
+                break;
+            cStarted++;
+        }
+        dirCachePrefetchWorker(&Work);
+        for (i = 0; i < cStarted; i++)
+            pthread_join(ahThreads[i], NULL);
+        pthread_mutex_destroy(&Work.Mtx);
+
+        /* Don't cache odd errors, see dir_cache_stat. */
+        for (i = 0; i < Work.cEntries; i++)
+        {
+            PDIRCACHEENTRY pEntry = Work.papEntries[i];
+            if (pEntry->iErr != 0 && pEntry->iErr != ENOENT && pEntry->iErr != ENOTDIR)
+                pEntry->Rev.uAll = g_uAllRev - 1;
+        }
+        g_cStats      += Work.cEntries;
+        g_cPrefetched += Work.cEntries;
+    }
+    free(Work.papEntries);
+}
+
+
+/**
+ * Checks if the cache knows the path to be missing, without asking the file
+ * system.
+ *
+ * @returns 1 if known to be missing, 0 if present or unknown.
+ * @param   pszPath     The path, not necessarily terminated.
+ * @param   cchPath     The length of the path.
+ */
+int dir_cache_is_known_missing(const char *pszPath, unsigned int cchPath)
+{
+    DIRCACHEENTRY   Key;
+    PDIRCACHEENTRY  pEntry;
+    PDIRCACHEDIR    pDir;
+    const char     *pszName;
+    char            szName[256];
+    unsigned        cchName;
+
+    if (!dirCacheIsUsable() || !cchPath)
+        return 0;
+
+    Key.pszPath = pszPath;
+    Key.cchPath = (unsigned)cchPath;
+    pEntry = (PDIRCACHEENTRY)hash_find_item(&g_PathHash, &Key);
+    if (pEntry)
+        return pEntry->iErr != 0
+            && dirCacheIsValid(pEntry->pDir, &pEntry->Rev, 1 /*fNegative*/);
+
+    pszName = dirCacheFindLastSlash(pszPath, cchPath);
+    if (pszName == pszPath)
+        pDir = dirCacheLookupDir("/", 1, 0 /*fCreate*/);
+    else if (pszName)
+        pDir = dirCacheLookupDir(pszPath, (unsigned)(pszName - pszPath), 0 /*fCreate*/);
+    else
+        pDir = dirCacheLookupDir(".", 1, 0 /*fCreate*/);
+    pszName = pszName ? pszName + 1 : pszPath;
+    cchName = (unsigned)(pszPath + cchPath - pszName);
+    if (   pDir
+        && pDir->iListErr != -1
+        && cchName > 0
+        && cchName < sizeof(szName)
+        && dirCacheIsValid(pDir, &pDir->ListRev, 1 /*fNegative*/))
+    {
+        memcpy(szName, pszName, cchName);
+        szName[cchName] = '\0';
+        if (strcmp(szName, ".") != 0 && strcmp(szName, "..") != 0)
+            return dirCacheCheckListing(pDir, szName) != 0;
+    }
+    return 0;
+}
+
+
+/**
+ * Called after a job has completed.
+ *
+ * Without inotify, this invalidates the whole cache, or only the volatile
+ * directories if any have been specified.
+ */
+void dir_cache_invalid_after_job(void)
+{
+    if (!dirCacheIsUsable())
+        return;
+    g_cInvalidations++;
+#ifdef DIRCACHE_WITH_INOTIFY
+    if (g_fdInotify >= 0)
+    {
+        dirCacheDrainInotify();
+        g_uJobRev++;
+        return;
+    }
+#endif
+    if (g_fHaveVolatileDirs)
+        g_uVolatileRev++;
+    else
+        g_uAllRev++;
+}
+
+
+/**
+ * Invalidate the whole directory cache
+ *
+ * Used by $(dircache-ctl invalidate)
+ */
+void dir_cache_invalid_all(void)
+{
+    if (!dirCacheIsUsable())
+        return;
+    g_cInvalidations++;
+    g_uAllRev++;
+}
+
+
+/**
+ * Invalidate missing bits of the directory cache.
+ *
+ * Used by $(dircache-ctl invalidate-missing)
+ */
+void dir_cache_invalid_missing(void)
+{
+    if (!dirCacheIsUsable())
+        return;
+    g_cInvalidations++;
+    g_uMissingRev++;
+}
+
+
+/**
+ * Invalidate the volatile bits of the directory cache.
+ */
+void dir_cache_invalid_volatile(void)
+{
+    if (!dirCacheIsUsable())
+        return;
+    g_cInvalidations++;
+    if (g_fHaveVolatileDirs)
+        g_uVolatileRev++;
+    else
+        g_uAllRev++;
+}
+
+
+static void dirCacheUpdateVolatileFlag(const void *pvItem)
+{
+    PDIRCACHEDIR pDir = (PDIRCACHEDIR)pvItem;
+    pDir->fVolatile = dirCacheIsVolatilePath(pDir->pszPath, pDir->cchPath);
+}
+
+
+/**
+ * Used by $(dircache-ctl ) to mark a directory subtree as volatile.
+ *
+ * The first call changes the rest of the cache to be considered non-volatile.
+ * The path must be given the same way as it is used by the makefiles (no
+ * normalization is done).
+ *
+ * @returns 0 on success, -1 on failure.
+ * @param   pszDir      The directory path.
+ */
+int dir_cache_volatile_dir(const char *pszDir)
+{
+    size_t cchDir = strlen(pszDir);
+    if (!dirCacheIsUsable())
+        return 0;
+    while (cchDir > 1 && pszDir[cchDir - 1] == '/')
+        cchDir--;
+    if (!cchDir)
+        return -1;
+
+    g_papszVolatileDirs = (char **)xrealloc(g_papszVolatileDirs, (g_cVolatileDirs + 1) * sizeof(g_papszVolatileDirs[0]));
+    g_papszVolatileDirs[g_cVolatileDirs++] = xstrndup(pszDir, cchDir);
+    g_fHaveVolatileDirs = 1;
+    hash_map(&g_DirHash, dirCacheUpdateVolatileFlag);
+
+    /* Anything cached so far was taken under different rules. */
+    g_uAllRev++;
+    return 0;
+}
+
+
+/**
+ * Invalidates a deleted directory so the cache can close handles to it.
+ *
+ * Used by the rm and rmdir built-ins.  These may run on a worker thread, in
+ * which case we rely on the invalidation done when the job is reaped.
+ *
+ * @returns 0 on success, -1 on failure.
+ * @param   pszDir      The directory to invalidate as deleted.
+ */
+int dir_cache_deleted_directory(const char *pszDir)
+{
+    if (!dirCacheIsUsable())
+        return 0;
+    g_cInvalidations++;
+    g_uAllRev++;
+    (void)pszDir;
+    return 0;
+}
+
+
+/**
+ * Prints the cache statistics.
+ */
+void dir_cache_print_stats(void)
+{
+    FILE *pOut = stdout;
+    if (!g_fEnabled)
+        return;
+    fputs("\n"
+          "# POSIX dir cache stats:\n", pOut);
+    fprintf(pOut, "#  %lu paths, %lu directories\n", g_PathHash.ht_fill, g_DirHash.ht_fill);
+    fprintf(pOut, "#  %lu lookups: %lu (%lu%%) hits, %lu (%lu%%) listing hits, %lu (%lu%%) stat calls\n",
+            g_cLookups,
+            g_cHits,        g_cHits        * 100 / (g_cLookups ? g_cLookups : 1),
+            g_cListingHits, g_cListingHits * 100 / (g_cLookups ? g_cLookups : 1),
+            g_cStats,       g_cStats       * 100 / (g_cLookups ? g_cLookups : 1));
+    fprintf(pOut, "#  %lu directory listings loaded, %lu invalidations\n", g_cListings, g_cInvalidations);
+    if (g_cPrefetched)
+        fprintf(pOut, "#  %lu paths prefetched\n", g_cPrefetched);
+#ifdef DIRCACHE_WITH_INOTIFY
+    if (g_fdInotify >= 0)
+        fprintf(pOut, "#  inotify: %lu watches, %lu events, %lu overflows\n",
+                g_cWatches, g_cInotifyEvents, g_cInotifyOverflows);
+    else
+        fputs("#  inotify: not used\n", pOut);
+#endif
+}
+
+
+/**
+ * The dircache built-in.
+ *
+ * Same commands as the $(dircache-ctl ) function.
+ */
+int kmk_builtin_dircache(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
+{
+    if (argc >= 2)
+    {
+        const char *pszCmd = argv[1];
+        if (strcmp(pszCmd, "invalidate") == 0)
+        {
+            if (argc == 2)
+            {
+                dir_cache_invalid_all();
+                return 0;
+            }
+            errx(pCtx, 2, "the 'invalidate' command takes no arguments!\n");
+        }
+        else if (strcmp(pszCmd, "invalidate-missing") == 0)
+        {
+            if (argc == 2)
+            {
+                dir_cache_invalid_missing ();
+                return 0;
+            }
+            errx(pCtx, 2, "the 'invalidate-missing' command takes no arguments!\n");
+        }
+        else if (strcmp(pszCmd, "volatile") == 0)
+        {
+            int i;
+            for (i = 2; i < argc; i++)
+                dir_cache_volatile_dir(argv[i]);
+            return 0;
+        }
+        else if (strcmp(pszCmd, "deleted") == 0)
+        {
+            int i;
+            for (i = 2; i < argc; i++)
+                dir_cache_deleted_directory(argv[i]);
+            return 0;
+        }
+        else
+            errx(pCtx, 2, "Invalid command '%s'!\n", pszCmd);
+    }
+    else
+        errx(pCtx, 2, "No command given!\n");
+
+    (void)envp;
+    return 2;
+}
+
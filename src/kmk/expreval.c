@@ -57,6 +57,8 @@
 #define EXPR_MAX_OPERATORS  72
 /** The max operand depth. */
 #define EXPR_MAX_OPERANDS   128
+/** The max number of compiled expressions we keep around. */
+#define EXPR_MAX_CACHED_PROGS   4096
 
 
 /*******************************************************************************
@@ -102,6 +104,9 @@ typedef struct
 {
     /** The variable type. */
     EXPRVARTYPE enmType;
+    /** Set if the string is a plain $(name) or ${name} variable reference that
+     * can be resolved directly (see expr_expand_var_ref). */
+    unsigned char fVarRef;
     /** The variable. */
     union
     {
@@ -151,6 +156,47 @@ typedef struct
 /** Pointer to a const operator. */
 typedef EXPROP const *PCEXPROP;
 
+/**
+ * Compiled expression instruction.
+ *
+ * The instructions are executed in order, operands are pushed onto the
+ * operand stack and operators are applied to it.
+ */
+typedef struct EXPRINSTR
+{
+    /** The operator, NULL if operand. */
+    PCEXPROP pOp;
+    /** The operand type. */
+    EXPRVARTYPE enmType;
+    /** Whether the operand is a plain variable reference. */
+    unsigned char fVarRef;
+    /** The offset of the operand string into EXPRPROG::pszExpr. */
+    unsigned int off;
+    /** The length of the operand string. */
+    unsigned int cch;
+} EXPRINSTR;
+/** Pointer to a compiled expression instruction. */
+typedef EXPRINSTR *PEXPRINSTR;
+
+/**
+ * Compiled expression (postfix program).
+ */
+typedef struct EXPRPROG
+{
+    /** The expression source (heap copy), this is the hash key. */
+    char *pszExpr;
+    /** Number of instructions. */
+    unsigned int cInstrs;
+    /** Number of allocated instructions. */
+    unsigned int cAllocated;
+    /** The instructions. */
+    PEXPRINSTR paInstrs;
+} EXPRPROG;
+/** Pointer to a compiled expression. */
+typedef EXPRPROG *PEXPRPROG;
+/** Pointer to a const compiled expression. */
+typedef EXPRPROG const *PCEXPRPROG;
+
 /**
  * Expression evaluator instance.
  */
@@ -166,8 +212,13 @@ typedef struct EXPR
     PCEXPROP pPending;
     /** Top of the operator stack. */
     int iOp;
-    /** Top of the operand stack. */
+    /** Top of the operand stack.
+     * When compiling, this is the depth the stack would have. */
     int iVar;
+    /** The program being compiled, NULL when evaluating. */
+    PEXPRPROG pProg;
+    /** Set if the compilation failed. */
+    int fCompileError;
     /** The operator stack. */
     PCEXPROP apOps[EXPR_MAX_OPERATORS];
     /** The operand stack. */
@@ -183,6 +234,8 @@ typedef struct EXPR
 static char g_auchOpStartCharMap[256];
 /** Whether we've initialized the map. */
 static int g_fExprInitializedMap = 0;
+/** The compiled expressions, keyed by the expression text. */
+static struct hash_table g_ExprProgs;
 
 
 /*******************************************************************************
@@ -208,6 +261,14 @@ static void expr_error(PEXPR pThis, const char *pszError, ...)
     char szTmp[256];
     va_list va;
 
+    /* When compiling we just give up quietly, the interpreter will
+       complain when it gets to the same spot. */
+    if (pThis->pProg)
+    {
+        pThis->fCompileError = 1;
+        return;
+    }
+
     va_start(va, pszError);
     vsprintf(szTmp, pszError, va);
     va_end(va);
@@ -463,6 +524,7 @@ static void expr_var_init_substring(PEXPRVAR pVar, const char *psz, size_t cch,
         enmType = kExprVar_QuotedSimpleString;
 
     pVar->enmType = enmType;
+    pVar->fVarRef = 0;
     pVar->uVal.psz = xmalloc(cch + 1);
     memcpy(pVar->uVal.psz, psz, cch);
     pVar->uVal.psz[cch] = '\0';
@@ -513,6 +575,64 @@ static void expr_var_assign_string(PEXPRVAR pVar, const char *psz, EXPRVARTYPE e
 #endif /* unused */
 
 
+/**
+ * Checks if a string is a plain $(name) or ${name} variable reference.
+ *
+ * @returns 1 if it is, 0 if not.
+ * @param   psz     The string.
+ * @param   cch     The string length.
+ */
+static int expr_is_var_ref(const char *psz, size_t cch)
+{
+    size_t off;
+    if (    cch < 4
+        ||  psz[0] != '$'
+        ||  (psz[1] == '(' ? psz[cch - 1] != ')' : psz[1] != '{' || psz[cch - 1] != '}'))
+        return 0;
+    for (off = 2; off < cch - 1; off++)
+    {
+        char ch = psz[off];
+        if (    ISSPACE(ch)
+            ||  ch == '$' || ch == ':'
+            ||  ch == '(' || ch == ')' || ch == '{' || ch == '}')
+            return 0;
+    }
+    return 1;
+}
+
+
+/**
+ * Expands a plain variable reference (see expr_is_var_ref).
+ *
+ * This does what reference_variable does for non-recursive variables and
+ * leaves anything else to allocated_variable_expand.
+ *
+ * @returns Heap string with the expansion.
+ * @param   pszRef  The variable reference.
+ */
+static char *expr_expand_var_ref(const char *pszRef)
+{
+    const char         *pszName = pszRef + 2;
+    unsigned int        cchName = strlen(pszName) - 1;
+    struct variable    *pMakeVar = lookup_variable(pszName, cchName);
+    if (!pMakeVar)
+    {
+        warn_undefined(pszName, cchName);
+        return xstrdup("");
+    }
+    if (!pMakeVar->recursive || IS_VARIABLE_RECURSIVE_WITHOUT_DOLLAR(pMakeVar))
+    {
+#ifdef CONFIG_WITH_VALUE_LENGTH
+        char *psz = xmalloc(pMakeVar->value_length + 1);
+        return memcpy(psz, pMakeVar->value, pMakeVar->value_length + 1);
+#else
+        return xstrdup(pMakeVar->value);
+#endif
+    }
+    return allocated_variable_expand(pszRef);
+}
+
+
 /**
  * Simplifies a string variable.
  *
@@ -537,7 +657,10 @@ static void expr_var_make_simple_string(PEXPRVAR pVar)
             char *psz;
             assert(strchr(pVar->uVal.psz, '$'));
 
-            psz = allocated_variable_expand(pVar->uVal.psz);
+            if (pVar->fVarRef)
+                psz = expr_expand_var_ref(pVar->uVal.psz);
+            else
+                psz = allocated_variable_expand(pVar->uVal.psz);
             free(pVar->uVal.psz);
             pVar->uVal.psz = psz;
 
@@ -1809,6 +1932,82 @@ static EXPRRET expr_get_binary_or_eoe_or_rparen(PEXPR pThis)
 
 
 
+/**
+ * Appends an instruction to the program being compiled.
+ *
+ * @returns Pointer to the new instruction.
+ * @param   pThis       The evaluator instance.
+ * @param   pOp         The operator, NULL if operand.
+ */
+static PEXPRINSTR expr_emit(PEXPR pThis, PCEXPROP pOp)
+{
+    PEXPRPROG  pProg = pThis->pProg;
+    PEXPRINSTR pInstr;
+    if (pProg->cInstrs >= pProg->cAllocated)
+    {
+        pProg->cAllocated = pProg->cAllocated ? pProg->cAllocated * 2 : 8;
+        pProg->paInstrs = (PEXPRINSTR)xrealloc(pProg->paInstrs, pProg->cAllocated * sizeof(pProg->paInstrs[0]));
+    }
+    pInstr = &pProg->paInstrs[pProg->cInstrs++];
+    pInstr->pOp = pOp;
+    pInstr->enmType = kExprVar_Invalid;
+    pInstr->fVarRef = 0;
+    pInstr->off = 0;
+    pInstr->cch = 0;
+    return pInstr;
+}
+
+
+/**
+ * Pushes an operand onto the operand stack, or emits an instruction for
+ * doing so if we're compiling.
+ *
+ * @param   pThis       The evaluator instance.
+ * @param   psz         The start of the operand string.
+ * @param   cch         The length of the operand string.
+ * @param   enmType     The string type.
+ */
+static void expr_push_operand(PEXPR pThis, const char *psz, size_t cch, EXPRVARTYPE enmType)
+{
+    if (!pThis->pProg)
+        expr_var_init_substring(&pThis->aVars[++pThis->iVar], psz, cch, enmType);
+    else
+    {
+        PEXPRINSTR pInstr = expr_emit(pThis, NULL);
+        pInstr->enmType = enmType;
+        pInstr->fVarRef = (   enmType == kExprVar_String
+                           || enmType == kExprVar_QuotedString)
+                       && expr_is_var_ref(psz, cch);
+        pInstr->off = (unsigned int)(psz - pThis->pszExpr);
+        pInstr->cch = (unsigned int)cch;
+        pThis->iVar++;
+    }
+}
+
+
+/**
+ * Applies an operator to the operand stack, or emits an instruction for
+ * doing so if we're compiling.
+ *
+ * Parentheses are dealt with while compiling since they only affect the
+ * parsing.
+ *
+ * @returns status code.
+ * @param   pThis       The evaluator instance.
+ * @param   pOp         The operator.
+ */
+static EXPRRET expr_apply_op(PEXPR pThis, PCEXPROP pOp)
+{
+    if (    !pThis->pProg
+        ||  pOp->pfn == expr_op_left_parenthesis)
+        return pOp->pfn(pThis);
+
+    expr_emit(pThis, pOp);
+    pThis->iVar -= pOp->cArgs - 1;
+    return kExprRet_Ok;
+}
+
+
 /**
  * Get the next token, it should be an unary operator or an operand.
  *
@@ -1882,7 +2081,7 @@ static EXPRRET expr_get_unary_or_operand(PEXPR pThis)
             pszStart = ++psz;
             while (*psz && *psz != '"')
                 psz++;
-            expr_var_init_substring(&pThis->aVars[++pThis->iVar], pszStart, psz - pszStart, kExprVar_QuotedString);
+            expr_push_operand(pThis, pszStart, psz - pszStart, kExprVar_QuotedString);
             if (*psz)
                 psz++;
         }
@@ -1891,7 +2090,7 @@ static EXPRRET expr_get_unary_or_operand(PEXPR pThis)
             pszStart = ++psz;
             while (*psz && *psz != '\'')
                 psz++;
-            expr_var_init_substring(&pThis->aVars[++pThis->iVar], pszStart, psz - pszStart, kExprVar_QuotedSimpleString);
+            expr_push_operand(pThis, pszStart, psz - pszStart, kExprVar_QuotedSimpleString);
             if (*psz)
                 psz++;
         }
@@ -1943,7 +2142,7 @@ static EXPRRET expr_get_unary_or_operand(PEXPR pThis)
             }
 
             if (rc == kExprRet_Ok)
-                expr_var_init_substring(&pThis->aVars[++pThis->iVar], pszStart, psz - pszStart, kExprVar_String);
+                expr_push_operand(pThis, pszStart, psz - pszStart, kExprVar_String);
         }
     }
     else
@@ -2001,7 +2200,7 @@ static EXPRRET expr_eval(PEXPR pThis)
         {
             pOp = pThis->apOps[pThis->iOp--];
             assert(pThis->iVar + 1 >= pOp->cArgs);
-            rc = pOp->pfn(pThis);
+            rc = expr_apply_op(pThis, pOp);
             if (rc < kExprRet_Ok)
                 break;
         }
@@ -2063,12 +2262,132 @@ static PEXPR expr_create(char const *pszExpr)
     pThis->pPending = NULL;
     pThis->iVar = -1;
     pThis->iOp = -1;
+    pThis->pProg = NULL;
+    pThis->fCompileError = 0;
 
     expr_map_init();
     return pThis;
 }
 
 
+/**
+ * Executes a compiled expression.
+ *
+ * @returns status code.
+ * @param   pThis       The instance (fresh).
+ * @param   pProg       The compiled expression.
+ */
+static EXPRRET expr_exec(PEXPR pThis, PCEXPRPROG pProg)
+{
+    PEXPRINSTR   pInstr = pProg->paInstrs;
+    unsigned int cLeft  = pProg->cInstrs;
+    for (; cLeft > 0; cLeft--, pInstr++)
+    {
+        if (!pInstr->pOp)
+        {
+            PEXPRVAR pVar = &pThis->aVars[++pThis->iVar];
+            expr_var_init_substring(pVar, pProg->pszExpr + pInstr->off, pInstr->cch, pInstr->enmType);
+            pVar->fVarRef = pInstr->fVarRef;
+        }
+        else
+        {
+            EXPRRET rc = pInstr->pOp->pfn(pThis);
+            if (rc < kExprRet_Ok)
+                return rc;
+        }
+    }
+    assert(pThis->iVar == 0);
+    return kExprRet_Ok;
+}
+
+
+/** @callback_method_impl{hash_func_t} */
+static unsigned long expr_prog_hash_1(const void *pvKey)
+{
+    return_STRING_HASH_1(((PCEXPRPROG)pvKey)->pszExpr);
+}
+
+
+/** @callback_method_impl{hash_func_t} */
+static unsigned long expr_prog_hash_2(const void *pvKey)
+{
+    return_STRING_HASH_2(((PCEXPRPROG)pvKey)->pszExpr);
+}
+
+
+/** @callback_method_impl{hash_cmp_func_t} */
+static int expr_prog_hash_cmp(const void *pvKey1, const void *pvKey2)
+{
+    return strcmp(((PCEXPRPROG)pvKey1)->pszExpr, ((PCEXPRPROG)pvKey2)->pszExpr);
+}
+
+
+/**
+ * Gets the compiled version of an expression, compiling and caching it if
+ * necessary.
+ *
+ * @returns Pointer to the compiled expression.  NULL if the expression
+ *          cannot be compiled (syntax error) or the cache is full, in which
+ *          case the caller should use expr_eval.
+ * @param   pszExpr     The expression.
+ */
+static PCEXPRPROG expr_get_prog(const char *pszExpr)
+{
+    EXPRPROG    Key;
+    PEXPRPROG  *ppSlot;
+    PEXPRPROG   pProg;
+    PEXPR       pThis;
+
+    if (!g_ExprProgs.ht_vec)
+        hash_init(&g_ExprProgs, 512, expr_prog_hash_1, expr_prog_hash_2, expr_prog_hash_cmp);
+
+    Key.pszExpr = (char *)pszExpr;
+    ppSlot = (PEXPRPROG *)hash_find_slot(&g_ExprProgs, &Key);
+    if (!HASH_VACANT(*ppSlot))
+        return *ppSlot;
+    if (g_ExprProgs.ht_fill >= EXPR_MAX_CACHED_PROGS)
+        return NULL;
+
+    /*
+     * Compile it by running the evaluator in compile mode.
+     */
+    pProg = (PEXPRPROG)xcalloc(sizeof(*pProg));
+    pThis = expr_create(pszExpr);
+    pThis->pProg = pProg;
+    if (    expr_eval(pThis) < kExprRet_Ok
+        ||  pThis->fCompileError
+        ||  pThis->iVar != 0)
+    {
+        free(pProg->paInstrs);
+        free(pProg);
+        pProg = NULL;
+    }
+    else
+    {
+        pProg->pszExpr = xstrdup(pszExpr);
+        hash_insert_at(&g_ExprProgs, pProg, ppSlot);
+    }
+    pThis->iVar = -1; /* nothing on the operand stack to delete */
+    expr_destroy(pThis);
+    return pProg;
+}
+
+
+/**
+ * Evaluates an expression, using the compiled version if possible.
+ *
+ * @returns status code.
+ * @param   pThis       The instance (fresh).
+ */
+static EXPRRET expr_eval_cached(PEXPR pThis)
+{
+    PCEXPRPROG pProg = expr_get_prog(pThis->pszExpr);
+    if (pProg)
+        return expr_exec(pThis, pProg);
+    return expr_eval(pThis);
+}
+
+
 /**
  * Evaluates the given if expression.
  *
@@ -2089,7 +2408,7 @@ int expr_eval_if_conditionals(const char *line, const floc *flocp)
     int rc = -1;
     PEXPR pExpr = expr_create(line);
     pExpr->pFileLoc = flocp;
-    if (expr_eval(pExpr) >= kExprRet_Ok)
+    if (expr_eval_cached(pExpr) >= kExprRet_Ok)
     {
         /*
          * Convert the result (on top of the stack) to boolean and
@@ -2121,7 +2440,7 @@ char *expr_eval_to_string(char *o, const char *expr)
      * it have a go at it.
      */
     PEXPR pExpr = expr_create(expr);
-    if (expr_eval(pExpr) >= kExprRet_Ok)
+    if (expr_eval_cached(pExpr) >= kExprRet_Ok)
     {
         /*
          * Convert the result (on top of the stack) to a string
@@ -929,6 +929,13 @@ snap_deps (void)
       for (f2 = d->file; f2 != 0; f2 = f2->prev)
         f2->low_resolution_time = 1;
 
+#ifdef CONFIG_WITH_CMD_DB
+  for (f = lookup_file (".CMD_DB"); f != 0; f = f->prev)
+    for (d = f->deps; d != 0; d = d->next)
+      for (f2 = d->file; f2 != 0; f2 = f2->prev)
+        f2->cmd_db_target = 1;
+#endif
+
   for (f = lookup_file (".PHONY"); f != 0; f = f->prev)
     for (d = f->deps; d != 0; d = d->next)
       for (f2 = d->file; f2 != 0; f2 = f2->prev)
@@ -70,6 +70,14 @@ struct file
 #ifdef CONFIG_WITH_COMPILER
     struct kmk_cc_evalprog *evalprog; /* Pointer to evalval/evalctx "program". */
 #endif
+#ifdef CONFIG_WITH_JOB_HISTORY
+    unsigned long crit_path_ms; /* Estimated critical path thru this file
+                                   (ms), valid when crit_path_done is set.  */
+#endif
+#ifdef CONFIG_WITH_CMD_DB
+    struct cmddb_entry *cmd_db; /* Command fingerprint from $(comp-cmds-db ),
+                                   recorded when the commands succeed.  */
+#endif
 
     FILE_TIMESTAMP last_mtime;  /* File's modtime, if already known.  */
     FILE_TIMESTAMP mtime_before_update; /* File's modtime before any updating
@@ -129,6 +137,15 @@ struct file
 #endif
 #if defined (CONFIG_WITH_COMPILER) || defined (CONFIG_WITH_MAKE_STATS)
     unsigned int eval_count:14; /* Times evaluated as a makefile. */
+#endif
+#ifdef CONFIG_WITH_JOB_HISTORY
+    unsigned int crit_path_done:1; /* Nonzero if crit_path_ms has been (or
+                                   is being) calculated. */
+#endif
+#ifdef CONFIG_WITH_CMD_DB
+    unsigned int cmd_db_target:1; /* Nonzero if .MUST_MAKE uses
+                                   $(comp-cmds-db ), i.e. the file is a
+                                   prerequisite of .CMD_DB.  */
 #endif
   };
 
@@ -36,7 +36,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifdef KMK_HELPERS
 # include "kbuild.h"
 #endif
-#ifdef CONFIG_WITH_PRINTF
+#if defined (CONFIG_WITH_PRINTF) || defined (CONFIG_WITH_KMK_BUILTIN_SHELL)
 # include "kmkbuiltin.h"
 #endif
 #ifdef CONFIG_WITH_XARGS /* bird */
@@ -225,6 +225,10 @@ patsubst_expand_pat (char *o, const char *text,
   const char *t;
   unsigned int len;
   int doneany = 0;
+#ifdef CONFIG_WITH_SPLIT_WORDS
+  struct word_list list;
+  unsigned int i;
+#endif
 
   /* Record the length of REPLACE before and after the % so we don't have to
      compute these lengths more than once.  */
@@ -249,9 +253,18 @@ patsubst_expand_pat (char *o, const char *text,
   pattern_prepercent_len = pattern_percent - pattern - 1;
   pattern_postpercent_len = strlen (pattern_percent);
 
+#ifdef CONFIG_WITH_SPLIT_WORDS
+  split_words (&list, text);
+  for (i = 0; i < list.count; i++)
+    {
+      int fail = 0;
+      t = list.words[i].str;
+      len = list.words[i].len;
+#else
   while ((t = find_next_token (&text, &len)) != 0)
     {
       int fail = 0;
+#endif
 
       /* Is it big enough to match?  */
       if (len < pattern_prepercent_len + pattern_postpercent_len)
@@ -303,6 +316,9 @@ patsubst_expand_pat (char *o, const char *text,
           doneany = 1;
         }
     }
+#ifdef CONFIG_WITH_SPLIT_WORDS
+  free_word_list (&list);
+#endif
 #ifndef CONFIG_WITH_VALUE_LENGTH
   if (doneany)
     /* Kill the last space.  */
@@ -1508,6 +1524,7 @@ func_while (char *o, char **argv, const char *funcname UNUSED)
 
 #endif /* CONFIG_WITH_LOOP_FUNCTIONS */
 
+#ifndef CONFIG_WITH_SPLIT_WORDS
 struct a_word
 {
   struct a_word *next;
@@ -1677,6 +1694,162 @@ func_filter_filterout (char *o, char **argv, const char *funcname)
   return o;
 }
 
+#else  /* CONFIG_WITH_SPLIT_WORDS */
+
+/* A pattern of filter / filter-out. */
+struct a_pattern
+{
+  const char *str;
+  unsigned int length;
+  unsigned int prelen;          /* The length before the '%'. */
+  unsigned int sfxlen;          /* The length after the '%'. */
+  int percent;                  /* Nonzero if it has a '%'. */
+  unsigned int hash;            /* The hash of a literal. */
+  int chain;                    /* Next literal with the same hash slot, -1 if none. */
+};
+
+/* Hashes the LEN bytes at STR for the literal pattern set.  */
+MY_INLINE unsigned int
+filter_hash (const char *str, unsigned int len)
+{
+  unsigned int hash = len;
+  while (len-- > 0)
+    hash = hash * 31 + (unsigned char) *str++;
+  return hash;
+}
+
+/* Do filter / filter-out on word lists split in one go by split_words.
+
+   The patterns containing '%' are matched against every word, comparing
+   the prefix and suffix directly.  The literals are put into a hash set
+   and each word is looked up there once, making it O(words + patterns)
+   rather than O(words * patterns).  */
+static char *
+func_filter_filterout (char *o, char **argv, const char *funcname)
+{
+  int const is_filter = funcname[CSTRLEN ("filter")] == '\0';
+  struct word_list patlist;
+  struct word_list wordlist;
+  struct a_pattern *pats;
+  unsigned char *matched;
+  int *slots = NULL;
+  unsigned int slot_mask = 0;
+  unsigned int literals = 0;
+  unsigned int wildcards = 0;
+  unsigned int i;
+  unsigned int j;
+  int doneany = 0;
+
+  split_words (&wordlist, argv[1]);
+  if (!wordlist.count)
+    return o;
+  split_words (&patlist, argv[0]);
+
+  /* Chop ARGV[0] up into patterns.  We don't need to preserve it because
+     our caller frees all the argument memory anyway.  */
+  pats = xmalloc ((patlist.count ? patlist.count : 1) * sizeof (*pats));
+  for (i = 0; i < patlist.count; i++)
+    {
+      char *p = (char *) patlist.words[i].str;
+      const char *percent;
+
+      p[patlist.words[i].len] = '\0';
+      percent = find_percent (p);
+      /* find_percent() might shorten the string so LEN is wrong.  */
+      pats[i].str = p;
+      pats[i].length = strlen (p);
+      pats[i].percent = percent != NULL;
+      if (percent)
+        {
+          pats[i].prelen = percent - p;
+          pats[i].sfxlen = pats[i].length - pats[i].prelen - 1;
+          wildcards++;
+        }
+      else
+        {
+          pats[i].hash = filter_hash (p, pats[i].length);
+          literals++;
+        }
+    }
+
+  /* Put the literals in a hash set when there are enough of them.  */
+  if (literals >= 2 && literals * wordlist.count >= 10)
+    {
+      unsigned int size = 16;
+      while (size < literals * 2)
+        size *= 2;
+      slot_mask = size - 1;
+      slots = xmalloc (size * sizeof (*slots));
+      memset (slots, 0xff, size * sizeof (*slots));
+      for (i = 0; i < patlist.count; i++)
+        if (!pats[i].percent)
+          {
+            unsigned int slot = pats[i].hash & slot_mask;
+            pats[i].chain = slots[slot];
+            slots[slot] = i;
+          }
+    }
+
+  matched = xcalloc (wordlist.count);
+  for (j = 0; j < wordlist.count; j++)
+    {
+      const char *str = wordlist.words[j].str;
+      unsigned int len = wordlist.words[j].len;
+
+      if (slots)
+        {
+          int k = slots[filter_hash (str, len) & slot_mask];
+          for (; k >= 0; k = pats[k].chain)
+            if (pats[k].length == len && !memcmp (pats[k].str, str, len))
+              {
+                matched[j] = 1;
+                break;
+              }
+          if (matched[j] || !wildcards)
+            continue;
+        }
+
+      for (i = 0; i < patlist.count; i++)
+        {
+          const struct a_pattern *pat = &pats[i];
+          if (pat->percent)
+            {
+              if (   len >= pat->prelen + pat->sfxlen
+                  && !memcmp (str, pat->str, pat->prelen)
+                  && !memcmp (str + len - pat->sfxlen,
+                              pat->str + pat->prelen + 1, pat->sfxlen))
+                break;
+            }
+          else if (!slots && pat->length == len && !memcmp (pat->str, str, len))
+            break;
+        }
+      if (i < patlist.count)
+        matched[j] = 1;
+    }
+
+  /* Output the words that matched (or didn't, for filter-out).  */
+  for (j = 0; j < wordlist.count; j++)
+    if (matched[j] == is_filter)
+      {
+        o = variable_buffer_output (o, wordlist.words[j].str,
+                                    wordlist.words[j].len);
+        o = variable_buffer_output (o, " ", 1);
+        doneany = 1;
+      }
+  if (doneany)
+    /* Kill the last space.  */
+    --o;
+
+  free (matched);
+  free (slots);
+  free (pats);
+  free_word_list (&patlist);
+  free_word_list (&wordlist);
+  return o;
+}
+
+#endif /* CONFIG_WITH_SPLIT_WORDS */
+
 
 static char *
 func_strip (char *o, char **argv, const char *funcname UNUSED)
@@ -1760,6 +1933,7 @@ func_error (char *o, char **argv, const char *funcname)
 /*
   chop argv[0] into words, and sort them.
  */
+#ifndef CONFIG_WITH_SPLIT_WORDS
 static char *
 func_sort (char *o, char **argv, const char *funcname UNUSED)
 {
@@ -1842,6 +2016,157 @@ func_sort (char *o, char **argv, const char *funcname UNUSED)
   return o;
 }
 
+#else  /* CONFIG_WITH_SPLIT_WORDS */
+
+/* Gets the sort key of word W at DEPTH, -1 at the end of the word.  The
+   first character is compared as a plain char, the rest as unsigned char,
+   which is the order alpha_compare gives.  (The first key is biased to
+   keep it positive, words are never empty.)  */
+MY_INLINE int
+sort_key (const struct word_ref *w, unsigned int depth)
+{
+  if (depth >= w->len)
+    return -1;
+  if (depth == 0)
+    return (int) (char) w->str[0] + 256;
+  return (unsigned char) w->str[depth];
+}
+
+/* Compares the words A and B from DEPTH on.  */
+static int
+sort_compare_words (const struct word_ref *a, const struct word_ref *b,
+                    unsigned int depth)
+{
+  for (;; depth++)
+    {
+      int const ka = sort_key (a, depth);
+      int const kb = sort_key (b, depth);
+      if (ka != kb)
+        return ka < kb ? -1 : 1;
+      if (ka < 0)
+        return 0;
+    }
+}
+
+/* Sorts the COUNT words at WORDS that are known to be equal up to DEPTH,
+   using multikey quicksort: a three-way partitioning on the character at
+   DEPTH, so each character is only looked at about once per word instead
+   of once per string comparison.  */
+static void
+sort_words (struct word_ref *words, unsigned int count, unsigned int depth)
+{
+  while (count > 1)
+    {
+      struct word_ref tmp;
+      unsigned int lt, gt, i;
+      int pivot;
+
+      if (count < 12)
+        {
+          /* Insertion sort for the small partitions.  */
+          for (i = 1; i < count; i++)
+            {
+              unsigned int j = i;
+              tmp = words[i];
+              while (j > 0 && sort_compare_words (&words[j - 1], &tmp, depth) > 0)
+                {
+                  words[j] = words[j - 1];
+                  j--;
+                }
+              words[j] = tmp;
+            }
+          return;
+        }
+
+      /* Partition into less than, equal to and greater than the pivot
+         character (median of three).  */
+      {
+        int const k1 = sort_key (&words[0], depth);
+        int const k2 = sort_key (&words[count / 2], depth);
+        int const k3 = sort_key (&words[count - 1], depth);
+        pivot = k1 < k2 ? (k2 < k3 ? k2 : k1 < k3 ? k3 : k1)
+                        : (k1 < k3 ? k1 : k2 < k3 ? k3 : k2);
+      }
+      lt = i = 0;
+      gt = count;
+      while (i < gt)
+        {
+          int const key = sort_key (&words[i], depth);
+          if (key < pivot)
+            {
+              tmp = words[lt]; words[lt++] = words[i]; words[i++] = tmp;
+            }
+          else if (key > pivot)
+            {
+              tmp = words[--gt]; words[gt] = words[i]; words[i] = tmp;
+            }
+          else
+            i++;
+        }
+
+      sort_words (words, lt, depth);
+      if (pivot >= 0)
+        sort_words (&words[lt], gt - lt, depth + 1);
+      words += gt;
+      count -= gt;
+    }
+}
+
+static char *
+func_sort (char *o, char **argv, const char *funcname UNUSED)
+{
+  struct word_list list;
+  unsigned int count;
+  unsigned int i;
+
+  split_words (&list, argv[0]);
+  count = list.count;
+  if (count)
+    {
+      struct word_ref const *words = list.words;
+      sort_words (list.words, count, 0);
+
+      /* Now write the sorted list, uniquified.  */
+#ifdef CONFIG_WITH_RSORT
+      if (strcmp (funcname, "rsort"))
+        {
+          /* sort */
+#endif
+          for (i = 0; i < count; ++i)
+            if (   i == count - 1
+                || words[i + 1].len != words[i].len
+                || memcmp (words[i].str, words[i + 1].str, words[i].len))
+              {
+                o = variable_buffer_output (o, words[i].str, words[i].len);
+                o = variable_buffer_output (o, " ", 1);
+              }
+#ifdef CONFIG_WITH_RSORT
+        }
+      else
+        {
+          /* rsort - reverse the result */
+          i = count;
+          while (i-- > 0)
+            if (   i == 0
+                || words[i - 1].len != words[i].len
+                || memcmp (words[i].str, words[i - 1].str, words[i].len))
+              {
+                o = variable_buffer_output (o, words[i].str, words[i].len);
+                o = variable_buffer_output (o, " ", 1);
+              }
+        }
+#endif
+
+      /* Kill the last space.  */
+      --o;
+    }
+
+  free_word_list (&list);
+  return o;
+}
+
+#endif /* CONFIG_WITH_SPLIT_WORDS */
+
 /*
   $(if condition,true-part[,false-part])
 
@@ -2080,6 +2405,9 @@ func_evalval (char *o, char **argv, const char *funcname)
       int var_ctx;
       size_t off;
       const floc *reading_file_saved = reading_file;
+# ifdef CONFIG_WITH_COMPILER
+      int rc = -1;
+# endif
 # ifdef CONFIG_WITH_MAKE_STATS
       unsigned long long uStartTick = CURRENT_CLOCK_TICK();
 #  ifndef CONFIG_WITH_COMPILER
@@ -2099,13 +2427,17 @@ func_evalval (char *o, char **argv, const char *funcname)
 
       v->evalval_count++;
       if (   v->evalprog
+#  ifdef CONFIG_WITH_COMPILE_EVERYTHING
+          || (v->evalval_count == 1 && kmk_cc_compile_variable_for_eval (v)))
+#  else
           || (v->evalval_count == 3 && kmk_cc_compile_variable_for_eval (v)))
+#  endif
         {
           install_variable_buffer (&buf, &len); /* Really necessary? */
-          kmk_exec_eval_variable (v);
+          rc = kmk_exec_eval_variable (v);
           restore_variable_buffer (buf, len);
         }
-      else
+      if (rc != 0)
 # endif
       {
         /* Make a copy of the value to the variable buffer first since
@@ -2497,11 +2829,48 @@ func_shell_base (char *o, char **argv, int trim_newlines)
 
 #else
 #ifndef _AMIGA
+# if defined (CONFIG_WITH_KMK_BUILTIN_SHELL) && defined (CONFIG_WITH_OUTPUT_IN_MEMORY) /* bird */
+/* Runs COMMAND_ARGV in-process if it is a simple kmk_builtin_* command,
+   saving a fork+exec of the shell.  Returns the updated variable buffer
+   position, or NULL if the command has to go thru the shell.  */
+static char *
+func_shell_builtin (char *o, char **command_argv, int trim_newlines)
+{
+  struct output out;
+  char *buffer;
+  size_t len;
+  unsigned int i;
+  int argc = 0;
+  int exit_code;
+
+  while (command_argv[argc])
+    argc++;
+
+  output_init (&out);
+  out.syncout = 1;
+  if (kmk_builtin_command_for_shell (argc, command_argv, &out, &exit_code) != 0)
+    return NULL;
+
+  buffer = output_take_out (&out, &len);
+  i = (unsigned int) len;
+  buffer[i] = '\0';
+  fold_newlines (buffer, &i, trim_newlines);
+  o = variable_buffer_output (o, buffer, i);
+  free (buffer);
+
+  shell_completed (exit_code, 0);
+  return o;
+}
+# endif
+
 char *
 func_shell_base (char *o, char **argv, int trim_newlines)
 {
   char *batch_filename = NULL;
   int errfd;
+#ifdef OUTPUT_WITH_PIPES
+  struct output *errout;
+#endif
 #ifdef __MSDOS__
   FILE *fpipe;
 #endif
@@ -2530,6 +2899,24 @@ func_shell_base (char *o, char **argv, int trim_newlines)
 #endif
       return o;
     }
+
+# if defined (CONFIG_WITH_KMK_BUILTIN_SHELL) && defined (CONFIG_WITH_OUTPUT_IN_MEMORY) /* bird */
+  /* Run simple built-in commands without spawning anything.  */
+  if (!batch_filename
+      && !strncmp (command_argv[0], "kmk_builtin_", sizeof ("kmk_builtin_") - 1))
+    {
+      char *o2 = func_shell_builtin (o, command_argv, trim_newlines);
+      if (o2)
+        {
+#  ifdef WINDOWS32
+          just_print_flag = j_p_f;
+#  endif
+          free (command_argv[0]);
+          free (command_argv);
+          return o2;
+        }
+    }
+# endif
 #endif /* !__MSDOS__ */
 
   /* Using a target environment for 'shell' loses in cases like:
@@ -2560,7 +2947,17 @@ func_shell_base (char *o, char **argv, int trim_newlines)
   /* Set up the output in case the shell writes something.  */
   output_start ();
 
-#ifdef CONFIG_WITH_OUTPUT_IN_MEMORY
+#ifdef OUTPUT_WITH_PIPES
+  /* Let the output thread collect stderr, like the temp file would.  */
+  errout = NULL;
+  errfd = -1;
+  if (output_context && output_context->syncout
+      && output_pipe_open (output_context) == 0)
+    {
+      errout = output_context;
+      errfd = errout->child_err;
+    }
+#elif defined (CONFIG_WITH_OUTPUT_IN_MEMORY)
   errfd = -1; /** @todo fixme */
 #else
   errfd = (output_context && output_context->err >= 0
@@ -2607,12 +3004,26 @@ func_shell_base (char *o, char **argv, int trim_newlines)
   {
     struct output out;
     out.syncout = 1;
+# ifdef OUTPUT_WITH_PIPES
+    out.child_out = pipedes[1];
+    out.child_err = errfd;
+# else
     out.out = pipedes[1];
     out.err = errfd;
+# endif
 
     pid = child_execute_job (&out, 1, command_argv, envp);
   }
 
+# ifdef OUTPUT_WITH_PIPES
+  if (errout)
+    {
+      output_pipe_close_child (errout);
+      if (pid < 0)
+        output_pipe_wait (errout);
+    }
+# endif
+
   if (pid < 0)
     {
       perror_with_name (error_prefix, "fork");
@@ -2679,6 +3090,10 @@ func_shell_base (char *o, char **argv, int trim_newlines)
        shell_function_completed to the status of our child shell.  */
     while (shell_function_completed == 0)
       reap_children (1, 0);
+#ifdef OUTPUT_WITH_PIPES
+    if (errout)
+      output_pipe_wait (errout);
+#endif
 
     if (batch_filename)
       {
@@ -3089,6 +3504,9 @@ func_file (char *o, char **argv, const char *funcname UNUSED)
         }
       if (fclose (fp))
         OSS (fatal, reading_file, _("close: %s: %s"), fn, strerror (errno));
+#ifdef CONFIG_WITH_DIRCACHE
+      dir_cache_invalid_after_job ();
+#endif
     }
   else if (fn[0] == '<')
     {
@@ -4524,6 +4942,46 @@ func_comp_cmds_ex (char *o, char **argv, const char *funcname)
 }
 #endif
 
+#if defined (CONFIG_WITH_CMD_DB) && defined (CONFIG_WITH_COMMANDS_FUNC)
+/*
+  $(comp-cmds-db target,not-equal-return)
+
+  Compares a fingerprint of the expanded commands of the target with the
+  one recorded in the KMK_CMD_DB database the last time they completed
+  successfully, returning the string in the second argument if they
+  differ or if nothing was recorded.  If equal, nothing is returned.
+
+  The commands are expanded as by $(commands target).  The target should
+  also be made a prerequisite of .CMD_DB so the fingerprint is recorded
+  when it is remade before .MUST_MAKE is consulted.
+*/
+static char *
+func_comp_cmds_db (char *o, char **argv, const char *funcname UNUSED)
+{
+  struct file *file = lookup_file (argv[0]);
+  unsigned int off = o - variable_buffer;
+  char *end;
+  int changed;
+
+  if (!file)
+    {
+      OS (error, reading_file, _("$(comp-cmds-db ) invoked on unknown target '%s'"), argv[0]);
+      return variable_buffer_output (o, argv[1], strlen (argv[1]));
+    }
+  file->cmd_db_target = 1;
+
+  /* Expand the commands into the variable buffer, hash them and drop them
+     again.  (The buffer may be reallocated, thus the offset.)  */
+  end = func_commands (o, argv, "commands");
+  changed = cmd_db_check (file, variable_buffer + off,
+                          end - (variable_buffer + off));
+  o = variable_buffer + off;
+  if (changed)
+    o = variable_buffer_output (o, argv[1], strlen (argv[1]));
+  return o;
+}
+#endif
+
 #ifdef CONFIG_WITH_DATE
 # if defined (_MSC_VER) /* FIXME: !defined (HAVE_STRPTIME) */
 char *strptime(const char *s, const char *format, struct tm *tm)
@@ -5717,7 +6175,7 @@ func_set_umask (char *o, char **argv UNUSED, const char *funcname UNUSED)
 char *
 func_dircache_ctl (char *o, char **argv UNUSED, const char *funcname UNUSED)
 {
-# ifdef KBUILD_OS_WINDOWS
+# if defined (KBUILD_OS_WINDOWS) || defined (CONFIG_WITH_DIRCACHE)
   const char *cmd = argv[0];
   while (ISBLANK (*cmd))
     cmd++;
@@ -5890,6 +6348,9 @@ static struct function_table_entry function_table_init[] =
   FT_ENTRY ("comp-cmds",     3,  3,  1,  func_comp_vars),
   FT_ENTRY ("comp-cmds-ex",  3,  3,  1,  func_comp_cmds_ex),
 #endif
+#if defined (CONFIG_WITH_CMD_DB) && defined (CONFIG_WITH_COMMANDS_FUNC)
+  FT_ENTRY ("comp-cmds-db",  2,  2,  1,  func_comp_cmds_db),
+#endif
 #ifdef CONFIG_WITH_DATE
   FT_ENTRY ("date",          0,  1,  1,  func_date),
   FT_ENTRY ("date-utc",      0,  3,  1,  func_date),
@@ -6140,6 +6601,18 @@ handle_function (char **op, const char **stringp, const char *nameend, const cha
 #endif /* CONFIG_WITH_VALUE_LENGTH */
 
 #ifdef CONFIG_WITH_COMPILER
+/* Calls a function defined by a loaded object (alloc_fn) on behalf of the
+   "compiler", which only deals in make_function_ptr_t.  */
+static char *
+func_alloc_fn_for_compiler (char *o, char **argv, const char *funcname)
+{
+  const struct function_table_entry *entry_p = lookup_function (funcname, strlen (funcname));
+  int argc = 0;
+  while (argv[argc])
+    argc++;
+  return expand_builtin_function (o, argc, argv, entry_p);
+}
+
 /* Used by the "compiler" to get all info about potential functions. */
 make_function_ptr_t
 lookup_function_for_compiler (const char *name, unsigned int len,
@@ -6153,7 +6626,9 @@ lookup_function_for_compiler (const char *name, unsigned int len,
   *maxargsp  = entry_p->maximum_args;
   *expargsp  = entry_p->expand_args;
   *funcnamep = entry_p->name;
-  return entry_p->func_ptr;
+  if (entry_p->alloc_fn)
+    return func_alloc_fn_for_compiler;
+  return entry_p->fptr.func_ptr;
 }
 #endif /* CONFIG_WITH_COMPILER */
 
@@ -254,6 +254,11 @@ pattern_search (struct file *file, int archive,
 
   unsigned int ri;  /* uninit checks OK */
   struct rule *rule;
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  const struct rule_index_entry *candidates;
+  unsigned int ncandidates;
+  unsigned int ci;
+#endif
 
   char *pathdir = NULL;
   unsigned long pathlen;
@@ -299,9 +304,19 @@ pattern_search (struct file *file, int archive,
      Put them in TRYRULES.  */
 
   nrules = 0;
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  /* Only look at the target patterns which end with the same character as
+     FILENAME, or with '%'.  */
+  candidates = pattern_rule_index_lookup (filename, namelen, &ncandidates);
+  for (ci = 0; ci < ncandidates; ci++)
+    {
+      unsigned int ti = candidates[ci].ti;
+      rule = candidates[ci].rule;
+#else
   for (rule = pattern_rules; rule != 0; rule = rule->next)
     {
       unsigned int ti;
+#endif
 
       /* If the pattern rule has deps but no commands, ignore it.
          Users cancel built-in rules by redefining them without commands.  */
@@ -316,7 +331,9 @@ pattern_search (struct file *file, int archive,
           continue;
         }
 
+#ifndef CONFIG_WITH_PATTERN_RULE_INDEX
       for (ti = 0; ti < rule->num; ++ti)
+#endif
         {
           const char *target = rule->targets[ti];
           const char *suffix = rule->suffixes[ti];
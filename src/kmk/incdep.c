@@ -54,6 +54,7 @@
 #include "variable.h"
 #include "rule.h"
 #include "debug.h"
+#include "hash.h"
 #include "strcache2.h"
 
 #ifdef HAVE_FCNTL_H
@@ -69,6 +70,10 @@
 # define PARSE_IN_WORKER
 #endif
 
+#ifdef CONFIG_WITH_KDEPDB
+# include "kdepdb.h"
+#endif
+
 #ifdef INCDEP_USE_KFSCACHE
 # include "nt/kFsCache.h"
 extern PKFSCACHE g_pFsCache; /* dir-nt-bird.c for now */
@@ -100,7 +105,7 @@ struct incdep_variable_in_set
 {
     struct incdep_variable_in_set *next;
     /* the parameters */
-    struct strcache2_entry *name_entry;     /* dep strcache - WRONG */
+    const char *name;                       /* file strcache */
     const char *value;                      /* xmalloc'ed */
     unsigned int value_length;
     int duplicate_value;                    /* 0 */
@@ -115,7 +120,7 @@ struct incdep_variable_def
     struct incdep_variable_def *next;
     /* the parameters */
     const floc *flocp;                      /* NILF */
-    struct strcache2_entry *name_entry;     /* dep strcache - WRONG */
+    const char *name;                       /* file strcache */
     char *value;                            /* xmalloc'ed, free it */
     unsigned int value_length;
     enum variable_origin origin;
@@ -128,8 +133,8 @@ struct incdep_recorded_file
     struct incdep_recorded_file *next;
 
     /* the parameters */
-    struct strcache2_entry *filename_entry; /* dep strcache; converted to a nameseq record. */
-    struct dep *deps;                       /* All the names are dep strcache entries. */
+    const char *filename;                   /* file strcache */
+    struct dep *deps;                       /* All the names are in the file strcache. */
     const floc *flocp;                     /* NILF */
 };
 
@@ -142,6 +147,16 @@ struct incdep
   char *file_end;
 
   int worker_tid;
+
+  /* Makefiles queued by include-prefetch: the name (strcache) as
+     eval_makefile will look for it, the stats of the file when it was read,
+     and whether it has been read yet (protected by incdep_mtx).  NULL for
+     dependency files. */
+  const char *makefile;
+  off_t makefile_size;
+  FILE_TIMESTAMP makefile_mtime;
+  int makefile_done;
+
 #ifdef PARSE_IN_WORKER
   unsigned int err_line_no;
   const char *err_msg;
@@ -197,6 +212,9 @@ static int incdep_initialized;
 static struct incdep * volatile incdep_head_todo;
 static struct incdep * volatile incdep_tail_todo;
 
+/* the number of files in the todo list. */
+static unsigned volatile incdep_num_todo;
+
 /* the number of files that are currently being read. */
 static int volatile incdep_num_reading;
 
@@ -207,7 +225,7 @@ static struct incdep * volatile incdep_tail_done;
 
 /* The handles to the worker threads. */
 #ifdef HAVE_PTHREAD
-# define INCDEP_MAX_THREADS 1
+# define INCDEP_MAX_THREADS 32
 static pthread_t incdep_threads[INCDEP_MAX_THREADS];
 
 #elif defined (WINDOWS32)
@@ -221,10 +239,18 @@ static TID incdep_threads[INCDEP_MAX_THREADS];
 
 static struct alloccache incdep_rec_caches[INCDEP_MAX_THREADS];
 static struct alloccache incdep_dep_caches[INCDEP_MAX_THREADS];
-static struct strcache2 incdep_dep_strcaches[INCDEP_MAX_THREADS];
-static struct strcache2 incdep_var_strcaches[INCDEP_MAX_THREADS];
 static unsigned incdep_num_threads;
 
+/* the max number of worker threads we'll start, calculated by incdep_init. */
+static unsigned incdep_max_threads;
+
+/* Start another worker thread for each INCDEP_FILES_PER_THREAD files
+   waiting in the todo list, up to incdep_max_threads. */
+#define INCDEP_FILES_PER_THREAD 16
+
+/* The max number of files a worker grabs from the todo list at a time. */
+#define INCDEP_MAX_BATCH 32
+
 /* flag indicating whether the worker threads should terminate or not. */
 static int volatile incdep_terminate;
 
@@ -233,6 +259,18 @@ static int volatile incdep_terminate;
 static malloc_zone_t *incdep_zone;
 #endif
 
+/* The makefiles queued by include-prefetch that haven't yet been taken by
+   eval_makefile, keyed by name.  Only accessed by the main thread. */
+static struct hash_table incdep_prefetched;
+
+#ifdef CONFIG_WITH_KDEPDB
+/* The dependency database given by KMK_DEPDB, NULL if none or if it
+   couldn't be opened. */
+static PKDEPDB incdep_db;
+/* The KMK_DEPDB value incdep_db corresponds to (heap). */
+static char *incdep_db_name;
+#endif
+
 
 /*******************************************************************************
 *   Internal Functions                                                         *
@@ -501,6 +539,7 @@ incdep_read_file (struct incdep *cur, floc *f)
   size_t const cbFile = (size_t)cur->pFileObj->Stats.st_size;
 
   assert(cur->pFileObj->fHaveStats);
+  cur->makefile_size = cbFile;
   cur->file_base = incdep_xmalloc (cur, cbFile + 1);
   if (cur->file_base)
     {
@@ -539,6 +578,10 @@ incdep_read_file (struct incdep *cur, floc *f)
   if (!fstat (fd, &st))
 # endif
     {
+      cur->makefile_size = st.st_size;
+# ifndef KBUILD_OS_WINDOWS
+      cur->makefile_mtime = FILE_TIMESTAMP_STAT_MODTIME (cur->name, st);
+# endif
       cur->file_base = incdep_xmalloc (cur, st.st_size + 1);
       if (read (fd, cur->file_base, st.st_size) == st.st_size)
         {
@@ -588,42 +631,75 @@ incdep_worker (int thrd)
 
   while (!incdep_terminate)
    {
-      /* get job from the todo list. */
-
-      struct incdep *cur = incdep_head_todo;
-      if (!cur)
+      /* get a batch of jobs from the todo list.  The batch size is scaled
+         so the files are spread over all the threads while keeping the
+         lock traffic down when there are lots of files queued. */
+
+      struct incdep *head = incdep_head_todo;
+      struct incdep *tail;
+      struct incdep *cur;
+      struct incdep *next;
+      unsigned batch;
+      unsigned i;
+      if (!head)
         {
           incdep_wait_todo ();
           continue;
         }
-      if (cur->next)
-        incdep_head_todo = cur->next;
-      else
-        incdep_head_todo = incdep_tail_todo = NULL;
-      incdep_num_reading++;
 
-      /* read the file. */
+      batch = incdep_num_todo / (incdep_num_threads * 2);
+      if (batch > INCDEP_MAX_BATCH)
+        batch = INCDEP_MAX_BATCH;
+      else if (batch < 1)
+        batch = 1;
+      tail = head;
+      for (i = 1; i < batch && tail->next; i++)
+        tail = tail->next;
+      incdep_head_todo = tail->next;
+      if (!incdep_head_todo)
+        incdep_tail_todo = NULL;
+      tail->next = NULL;
+      incdep_num_todo -= i;
+      incdep_num_reading += i;
+
+      /* read the files. */
 
       incdep_unlock ();
-      cur->worker_tid = thrd;
+      for (cur = head; cur; cur = cur->next)
+        {
+          cur->worker_tid = thrd;
 
-      incdep_read_file (cur, NILF);
+          incdep_read_file (cur, NILF);
 #ifdef PARSE_IN_WORKER
-      eval_include_dep_file (cur, NILF);
+          if (!cur->makefile)
+            eval_include_dep_file (cur, NILF);
 #endif
 
-      cur->worker_tid = -1;
+          cur->worker_tid = -1;
+        }
       incdep_lock ();
 
-      /* insert finished job into the done list. */
+      /* insert the finished jobs into the done list.  Prefetched makefiles
+         are just flagged, eval_makefile picks them up by name.  Either way
+         we signal the done condition below, incdep_flush_it and
+         incdep_take_prefetched_makefile may be waiting on them. */
 
-      incdep_num_reading--;
-      cur->next = NULL;
-      if (incdep_tail_done)
-        incdep_tail_done->next = cur;
-      else
-        incdep_head_done = cur;
-      incdep_tail_done = cur;
+      incdep_num_reading -= i;
+      for (cur = head; cur; cur = next)
+        {
+          next = cur->next;
+          cur->next = NULL;
+          if (cur->makefile)
+            cur->makefile_done = 1;
+          else
+            {
+              if (incdep_tail_done)
+                incdep_tail_done->next = cur;
+              else
+                incdep_head_done = cur;
+              incdep_tail_done = cur;
+            }
+        }
 
       incdep_signal_done ();
    }
@@ -720,9 +796,10 @@ incdep_are_threads_enabled (void)
   return 1;
 }
 
-/* Creates the the worker threads. */
+/* Starts worker threads till there are at least NUM_WANTED of them or we
+   hit incdep_max_threads.  Called by the main thread. */
 static void
-incdep_init (floc *f)
+incdep_start_threads (unsigned num_wanted, floc *f)
 {
   unsigned i;
 #if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
@@ -734,11 +811,76 @@ incdep_init (floc *f)
   uintptr_t hThread;
 
 #elif defined (__OS2__)
-  int rc;
   int tid;
 #endif
   (void)f;
 
+  if (num_wanted > incdep_max_threads)
+    num_wanted = incdep_max_threads;
+
+  for (i = incdep_num_threads; i < num_wanted; i++)
+    {
+      /* init caches */
+      unsigned rec_size = sizeof (struct incdep_variable_in_set);
+      if (rec_size < sizeof (struct incdep_variable_def))
+        rec_size = sizeof (struct incdep_variable_def);
+      if (rec_size < sizeof (struct incdep_recorded_file))
+        rec_size = sizeof (struct incdep_recorded_file);
+      alloccache_init (&incdep_rec_caches[i], rec_size, "incdep rec",
+                       incdep_cache_allocator, (void *)(size_t)i);
+      alloccache_init (&incdep_dep_caches[i], sizeof(struct dep), "incdep dep",
+                       incdep_cache_allocator, (void *)(size_t)i);
+
+      /* the worker threads reads incdep_num_threads for the batch size. */
+      incdep_lock ();
+      incdep_num_threads = i + 1;
+      incdep_unlock ();
+
+      /* create the thread. */
+#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
+      rc = pthread_attr_init (&attr);
+      if (rc)
+        ON (fatal, f, _("pthread_attr_init failed: err=%d"), rc);
+      /*rc = pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE); */
+      rc = pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+      if (rc)
+        ON (fatal, f, _("pthread_attr_setdetachstate failed: err=%d"), rc);
+      rc = pthread_create (&incdep_threads[i], &attr,
+                           incdep_worker_pthread, (void *)(size_t)i);
+      if (rc)
+        ON (fatal, f, _("pthread_mutex_init failed: err=%d"), rc);
+      pthread_attr_destroy (&attr);
+
+#elif defined (WINDOWS32)
+      tid = 0;
+      hThread = _beginthreadex (NULL, 128*1024, incdep_worker_windows,
+                                (void *)i, 0, &tid);
+      if (hThread == 0 || hThread == ~(uintptr_t)0)
+        ON (fatal, f, _("_beginthreadex failed: err=%d"), errno);
+      incdep_threads[i] = (HANDLE)hThread;
+
+#elif defined (__OS2__)
+      tid = _beginthread (incdep_worker_os2, NULL, 128*1024, (void *)i);
+      if (tid <= 0)
+        ON (fatal, f, _("_beginthread failed: err=%d"), errno);
+      incdep_threads[i] = tid;
+#endif
+    }
+}
+
+/* Creates the the lock and event/condvars and figures out how many worker
+   threads we can use.  The threads are started by incdep_start_threads. */
+static void
+incdep_init (floc *f)
+{
+#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
+  int rc;
+
+#elif defined (__OS2__)
+  int rc;
+#endif
+  (void)f;
+
   /* heap hacks */
 
 #ifdef __APPLE__
@@ -784,77 +926,29 @@ incdep_init (floc *f)
   incdep_hev_done_waiters = 0;
 #endif
 
-  /* create the worker threads and associated per thread data. */
+  /* figure out how many worker threads to use.  Unless overridden by the
+     --incdep-threads option, we use one thread less than the number of job
+     slots or (when the jobserver hands out the slots) CPUs online. */
 
   incdep_terminate = 0;
+  incdep_num_threads = 0;
+  incdep_num_todo = 0;
   if (incdep_are_threads_enabled())
     {
-      incdep_num_threads = sizeof (incdep_threads) / sizeof (incdep_threads[0]);
-      if (incdep_num_threads + 1 > job_slots)
-        incdep_num_threads = job_slots <= 1 ? 1 : job_slots - 1;
-      for (i = 0; i < incdep_num_threads; i++)
+      unsigned max_threads;
+      if (incdep_threads_option > 0)
+        max_threads = incdep_threads_option;
+      else
         {
-          /* init caches */
-          unsigned rec_size = sizeof (struct incdep_variable_in_set);
-          if (rec_size < sizeof (struct incdep_variable_def))
-            rec_size = sizeof (struct incdep_variable_def);
-          if (rec_size < sizeof (struct incdep_recorded_file))
-            rec_size = sizeof (struct incdep_recorded_file);
-          alloccache_init (&incdep_rec_caches[i], rec_size, "incdep rec",
-                           incdep_cache_allocator, (void *)(size_t)i);
-          alloccache_init (&incdep_dep_caches[i], sizeof(struct dep), "incdep dep",
-                           incdep_cache_allocator, (void *)(size_t)i);
-          strcache2_init (&incdep_dep_strcaches[i],
-                          "incdep dep", /* name */
-                          65536,        /* hash size */
-                          0,            /* default segment size*/
-#ifdef HAVE_CASE_INSENSITIVE_FS
-                          1,            /* case insensitive */
-#else
-                          0,            /* case insensitive */
-#endif
-                          0);           /* thread safe */
-
-          strcache2_init (&incdep_var_strcaches[i],
-                          "incdep var", /* name */
-                          32768,        /* hash size */
-                          0,            /* default segment size*/
-                          0,            /* case insensitive */
-                          0);           /* thread safe */
-
-          /* create the thread. */
-#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
-          rc = pthread_attr_init (&attr);
-          if (rc)
-            ON (fatal, f, _("pthread_attr_init failed: err=%d"), rc);
-          /*rc = pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE); */
-          rc = pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
-          if (rc)
-            ON (fatal, f, _("pthread_attr_setdetachstate failed: err=%d"), rc);
-          rc = pthread_create (&incdep_threads[i], &attr,
-                               incdep_worker_pthread, (void *)(size_t)i);
-          if (rc)
-            ON (fatal, f, _("pthread_mutex_init failed: err=%d"), rc);
-          pthread_attr_destroy (&attr);
-
-#elif defined (WINDOWS32)
-          tid = 0;
-          hThread = _beginthreadex (NULL, 128*1024, incdep_worker_windows,
-                                    (void *)i, 0, &tid);
-          if (hThread == 0 || hThread == ~(uintptr_t)0)
-            ON (fatal, f, _("_beginthreadex failed: err=%d"), errno);
-          incdep_threads[i] = (HANDLE)hThread;
-
-#elif defined (__OS2__)
-          tid = _beginthread (incdep_worker_os2, NULL, 128*1024, (void *)i);
-          if (tid <= 0)
-            ON (fatal, f, _("_beginthread failed: err=%d"), errno);
-          incdep_threads[i] = tid;
-#endif
+          max_threads = job_slots ? job_slots : get_online_cpu_count ();
+          max_threads = max_threads <= 1 ? 1 : max_threads - 1;
         }
+      if (max_threads > sizeof (incdep_threads) / sizeof (incdep_threads[0]))
+        max_threads = sizeof (incdep_threads) / sizeof (incdep_threads[0]);
+      incdep_max_threads = max_threads;
     }
   else
-    incdep_num_threads = 0;
+    incdep_max_threads = 0;
 
   incdep_initialized = 1;
 }
@@ -889,11 +983,21 @@ incdep_flush_and_term (void)
       /* terminate or join up the allocation caches. */
       alloccache_term (&incdep_rec_caches[i], incdep_cache_deallocator, (void *)(size_t)i);
       alloccache_join (&dep_cache, &incdep_dep_caches[i]);
-      strcache2_term (&incdep_dep_strcaches[i]);
-      strcache2_term (&incdep_var_strcaches[i]);
     }
   incdep_num_threads = 0;
 
+  /* drop prefetched makefiles that were never included. */
+
+  if (incdep_prefetched.ht_vec)
+    {
+      struct incdep **slot = (struct incdep **) incdep_prefetched.ht_vec;
+      struct incdep **end = slot + incdep_prefetched.ht_size;
+      for (; slot < end; slot++)
+        if (!HASH_VACANT (*slot))
+          incdep_freeit (*slot);
+      hash_free (&incdep_prefetched, 0);
+    }
+
   /* destroy the lock and condition variables / event objects. */
 
   /* later */
@@ -902,18 +1006,6 @@ incdep_flush_and_term (void)
 }
 
 #ifdef PARSE_IN_WORKER
-/* Flushes a strcache entry returning the actual string cache entry.
-   The input is freed! */
-static const char *
-incdep_flush_strcache_entry (struct strcache2_entry *entry)
-{
-  if (!entry->user)
-    entry->user = (void *) strcache2_add_hashed_file (&file_strcache,
-                                                      (const char *)(entry + 1),
-                                                      entry->length, entry->hash);
-  return (const char *)entry->user;
-}
-
 /* Flushes the recorded instructions. */
 static void
 incdep_flush_recorded_instructions (struct incdep *cur)
@@ -941,9 +1033,8 @@ incdep_flush_recorded_instructions (struct incdep *cur)
     do
       {
         void *free_me = rec_vis;
-        unsigned int name_length = rec_vis->name_entry->length;
-        define_variable_in_set (incdep_flush_strcache_entry (rec_vis->name_entry),
-                                name_length,
+        define_variable_in_set (rec_vis->name,
+                                strcache2_get_len (&file_strcache, rec_vis->name),
                                 rec_vis->value,
                                 rec_vis->value_length,
                                 rec_vis->duplicate_value,
@@ -965,7 +1056,7 @@ incdep_flush_recorded_instructions (struct incdep *cur)
       {
         void *free_me = rec_vd;
         do_variable_definition_2 (rec_vd->flocp,
-                                  incdep_flush_strcache_entry (rec_vd->name_entry),
+                                  rec_vd->name,
                                   rec_vd->value,
                                   rec_vd->value_length,
                                   0,
@@ -986,12 +1077,7 @@ incdep_flush_recorded_instructions (struct incdep *cur)
     do
       {
         void *free_me = rec_f;
-        struct dep *dep;
-
-        for (dep = rec_f->deps; dep; dep = dep->next)
-          dep->name = incdep_flush_strcache_entry ((struct strcache2_entry *)dep->name);
-
-        incdep_commit_recorded_file (incdep_flush_strcache_entry (rec_f->filename_entry),
+        incdep_commit_recorded_file (rec_f->filename,
                                      rec_f->deps,
                                      rec_f->flocp);
 
@@ -1038,9 +1124,9 @@ incdep_dep_strcache (struct incdep *cur, const char *str, int len)
     }
   else
     {
-      /* Add it out the strcache of the thread. */
-      ret = strcache2_add (&incdep_dep_strcaches[cur->worker_tid], str, len);
-      ret = (const char *)strcache2_get_entry(&incdep_dep_strcaches[cur->worker_tid], ret);
+      /* Worker thread: the file strcache is thread safe, so add it there
+         directly instead of copying it again when flushing the records. */
+      ret = strcache2_add_file (&file_strcache, str, len);
     }
   return ret;
 }
@@ -1059,9 +1145,8 @@ incdep_var_strcache (struct incdep *cur, const char *str, int len)
     }
   else
     {
-      /* Add it out the strcache of the thread. */
-      ret = strcache2_add (&incdep_var_strcaches[cur->worker_tid], str, len);
-      ret = (const char *)strcache2_get_entry(&incdep_var_strcaches[cur->worker_tid], ret);
+      /* Worker thread: add it to the (thread safe) file strcache. */
+      ret = strcache2_add_file (&file_strcache, str, len);
     }
   return ret;
 }
@@ -1090,7 +1175,7 @@ incdep_record_variable_in_set (struct incdep *cur,
     {
       struct incdep_variable_in_set *rec =
         (struct incdep_variable_in_set *)incdep_alloc_rec (cur);
-      rec->name_entry = (struct strcache2_entry *)name;
+      rec->name = name;
       rec->value = value;
       rec->value_length = value_length;
       rec->duplicate_value = duplicate_value;
@@ -1130,7 +1215,7 @@ incdep_record_variable_def (struct incdep *cur,
       struct incdep_variable_def *rec =
         (struct incdep_variable_def *)incdep_alloc_rec (cur);
       rec->flocp = flocp;
-      rec->name_entry = (struct strcache2_entry *)name;
+      rec->name = name;
       rec->value = value;
       rec->value_length = value_length;
       rec->origin = origin;
@@ -1218,7 +1303,7 @@ incdep_record_file (struct incdep *cur,
       struct incdep_recorded_file *rec =
         (struct incdep_recorded_file *) incdep_alloc_rec (cur);
 
-      rec->filename_entry = (struct strcache2_entry *)filename;
+      rec->filename = filename;
       rec->deps = deps;
       rec->flocp = flocp;
 
@@ -1739,9 +1824,17 @@ incdep_flush_it (floc *f)
             incdep_head_todo = cur->next;
           else
             incdep_head_todo = incdep_tail_todo = NULL;
+          incdep_num_todo--;
+          cur->next = NULL;
           incdep_unlock ();
 
           incdep_read_file (cur, f);
+          if (cur->makefile)
+            {
+              incdep_lock ();
+              cur->makefile_done = 1;
+              continue;
+            }
           eval_include_dep_file (cur, f);
           incdep_freeit (cur);
 
@@ -1750,14 +1843,18 @@ incdep_flush_it (floc *f)
         }
 
       /* if the todo list and done list are empty we're either done
-         or will have to wait for the thread(s) to finish. */
+         or will have to wait for the thread(s) to finish.  Makefiles
+         queued by include-prefetch never end up on the done list, so
+         we must also stop waiting when there is nothing being read. */
       if (!cur && !incdep_num_reading)
           break; /* done */
       if (!cur)
         {
-          while (!incdep_head_done)
+          while (!incdep_head_done && incdep_num_reading)
             incdep_wait_done ();
           cur = incdep_head_done;
+          if (!cur)
+            continue;
         }
 
       /* we grab the entire done list and work thru it. */
@@ -1782,6 +1879,212 @@ incdep_flush_it (floc *f)
 }
 
 
+#ifdef CONFIG_WITH_KDEPDB
+
+/* Returns the dependency database given by the KMK_DEPDB variable, opening
+   it (read-only) the first time around and whenever the value changes.
+   Returns NULL if not set or if the database couldn't be opened. */
+static PKDEPDB
+incdep_get_db (floc *f)
+{
+  struct variable *v = lookup_variable ("KMK_DEPDB", sizeof ("KMK_DEPDB") - 1);
+  char *name;
+  int rc;
+
+  if (!v || !v->value_length)
+    return NULL;
+  if (v->recursive && memchr (v->value, '$', v->value_length))
+    name = allocated_variable_expand (v->value);
+  else
+    name = xstrdup (v->value);
+
+  if (incdep_db_name && !strcmp (name, incdep_db_name))
+    {
+      free (name);
+      return incdep_db;
+    }
+
+  /* (Re)open it.  Failures are remembered so we don't retry for every
+     includedep statement. */
+  kDepDbClose (incdep_db);
+  incdep_db = NULL;
+  free (incdep_db_name);
+  incdep_db_name = name;
+  if (*name)
+    {
+      rc = kDepDbOpen (&incdep_db, name, 0 /* fWrite */);
+      if (rc && rc != ENOENT)
+        OSS (error, f, _("KMK_DEPDB: failed to open '%s': %s"), name, strerror (rc));
+    }
+  return incdep_db;
+}
+
+/* State for incdep_db_query_callback. */
+struct incdep_db_query
+{
+  floc *flocp;
+  const char *target;
+  struct dep *deps;
+  struct dep **nextdep;
+};
+
+/* Commits the target that has been gathered so far. */
+static void
+incdep_db_query_flush (struct incdep_db_query *q)
+{
+  if (q->target)
+    {
+      incdep_commit_recorded_file (q->target, q->deps, q->flocp);
+      q->target = NULL;
+      q->deps = NULL;
+      q->nextdep = &q->deps;
+    }
+}
+
+/* kDepDbQuery callback that enters the targets and dependencies the same
+   way eval_include_dep_file does. */
+static void
+incdep_db_query_callback (void *pvUser, int fTarget, const char *name, unsigned name_len)
+{
+  struct incdep_db_query *q = (struct incdep_db_query *)pvUser;
+  if (fTarget)
+    {
+      incdep_db_query_flush (q);
+      q->target = strcache_add_len (name, name_len);
+    }
+  else
+    {
+      struct dep *dep = alloccache_calloc (&dep_cache);
+      dep->name = strcache_add_len (name, name_len);
+      dep->includedep = 1;
+      *q->nextdep = dep;
+      q->nextdep = &dep->next;
+    }
+}
+
+/* Looks up NAME in the dependency database and enters its rules.  If the
+   dependency file exists and was written after the database entry, the
+   file is used instead.  Returns 1 if found, 0 if not. */
+static int
+incdep_try_db (PKDEPDB db, const char *name, unsigned int name_len, floc *f)
+{
+  struct incdep_db_query q;
+  unsigned long long ns_not_before = 0;
+  struct stat st;
+  char *tmp;
+  int rc;
+
+  tmp = alloca (name_len + 1);
+  memcpy (tmp, name, name_len);
+  tmp[name_len] = '\0';
+  if (stat (tmp, &st) == 0)
+    {
+      ns_not_before = (unsigned long long) st.st_mtime * 1000000000;
+# ifdef ST_MTIM_NSEC
+      ns_not_before += st.ST_MTIM_NSEC;
+# else
+      ns_not_before += 999999999; /* Let the file win within the second. */
+# endif
+    }
+
+  q.flocp = f;
+  q.target = NULL;
+  q.deps = NULL;
+  q.nextdep = &q.deps;
+  rc = kDepDbQuery (db, name, name_len, ns_not_before,
+                    incdep_db_query_callback, &q);
+  incdep_db_query_flush (&q);
+  if (!rc)
+    return 1;
+  if (rc != ENOENT)
+    OSS (error, f, _("KMK_DEPDB: failed to query '%s': %s"), tmp, strerror (rc));
+  return 0;
+}
+
+#endif /* CONFIG_WITH_KDEPDB */
+
+/* Hash callbacks for incdep_prefetched. */
+static unsigned long
+incdep_prefetched_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((struct incdep const *) key)->makefile);
+}
+
+static unsigned long
+incdep_prefetched_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((struct incdep const *) key)->makefile);
+}
+
+static int
+incdep_prefetched_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((struct incdep const *) x)->makefile,
+                         ((struct incdep const *) y)->makefile);
+}
+
+/* Hands over the content of the makefile NAME if it was queued by
+   include-prefetch, waiting for it to be read if necessary.  Returns NULL
+   if it wasn't queued or couldn't be read.  Otherwise the caller gets a
+   zero terminated heap buffer (free() it) with the size in *SIZEP and the
+   modification time in *MTIMEP (0 if unknown) of the file at the time it
+   was read, for checking that it hasn't changed since.  */
+char *
+incdep_take_prefetched_makefile (const char *name, size_t *sizep,
+                                 FILE_TIMESTAMP *mtimep)
+{
+  struct incdep key;
+  struct incdep *cur;
+  char *buf;
+
+  if (!incdep_prefetched.ht_fill)
+    return NULL;
+  key.makefile = name;
+  cur = hash_find_item (&incdep_prefetched, &key);
+  if (!cur)
+    return NULL;
+  hash_delete (&incdep_prefetched, cur);
+
+  incdep_lock ();
+  if (!cur->makefile_done)
+    {
+      /* Still on the todo list?  Then read it ourselves rather than waiting
+         for the workers to get to it (or if there are no workers).  */
+      struct incdep *prev = NULL;
+      struct incdep *it = incdep_head_todo;
+      while (it && it != cur)
+        {
+          prev = it;
+          it = it->next;
+        }
+      if (it)
+        {
+          if (prev)
+            prev->next = cur->next;
+          else
+            incdep_head_todo = cur->next;
+          if (incdep_tail_todo == cur)
+            incdep_tail_todo = prev;
+          incdep_num_todo--;
+          cur->next = NULL;
+          incdep_unlock ();
+          incdep_read_file (cur, NILF);
+          incdep_lock ();
+        }
+      else
+        while (!cur->makefile_done)
+          incdep_wait_done ();
+    }
+  incdep_unlock ();
+
+  buf = cur->file_base;
+  *sizep = cur->file_end - cur->file_base;
+  *mtimep = cur->makefile_mtime;
+  cur->file_base = cur->file_end = NULL;
+  incdep_freeit (cur);
+  return buf;
+}
+
 /* splits up a list of file names and feeds it to eval_include_dep_file,
    employing threads to try speed up the file reading. */
 void
@@ -1793,11 +2096,21 @@ eval_include_dep (const char *names, floc *f, enum incdep_op op)
   const char *names_iterator = names;
   const char *name;
   unsigned int name_len;
+  unsigned int num_files = 0;
+  unsigned int num_todo;
+#ifdef CONFIG_WITH_KDEPDB
+  PKDEPDB db = incdep_get_db (f);
+#endif
 
   /* loop through NAMES, creating a todo list out of them. */
 
   while ((name = find_next_token (&names_iterator, &name_len)) != 0)
     {
+#ifdef CONFIG_WITH_KDEPDB
+       /* The dependency database takes precedence over older files. */
+       if (db && op != incdep_prefetch && incdep_try_db (db, name, name_len, f))
+         continue;
+#endif
 #ifdef INCDEP_USE_KFSCACHE
        KFSLOOKUPERROR enmError;
        PKFSOBJ pFileObj = kFsCacheLookupWithLengthA (g_pFsCache, name, name_len, &enmError);
@@ -1812,6 +2125,11 @@ eval_include_dep (const char *names, floc *f, enum incdep_op op)
        cur = xmalloc (sizeof (*cur));            /* not incdep_xmalloc here */
        cur->pFileObj = pFileObj;
 #else
+# ifdef CONFIG_WITH_DIRCACHE
+       /* Skip files the directory cache already knows are missing. */
+       if (dir_cache_is_known_missing (name, name_len))
+         continue;
+# endif
        cur = xmalloc (sizeof (*cur) + name_len); /* not incdep_xmalloc here */
        memcpy (cur->name, name, name_len);
        cur->name[name_len] = '\0';
@@ -1819,6 +2137,10 @@ eval_include_dep (const char *names, floc *f, enum incdep_op op)
 
        cur->file_base = cur->file_end = NULL;
        cur->worker_tid = -1;
+       cur->makefile = NULL;
+       cur->makefile_size = 0;
+       cur->makefile_mtime = 0;
+       cur->makefile_done = 0;
 #ifdef PARSE_IN_WORKER
        cur->err_line_no = 0;
        cur->err_msg = NULL;
@@ -1830,12 +2152,27 @@ eval_include_dep (const char *names, floc *f, enum incdep_op op)
        cur->recorded_file_tail = NULL;
 #endif
 
+       if (op == incdep_prefetch)
+         {
+           cur->makefile = strcache_add_len (name, name_len);
+           if (!incdep_prefetched.ht_vec)
+             hash_init (&incdep_prefetched, 256, incdep_prefetched_hash_1,
+                        incdep_prefetched_hash_2, incdep_prefetched_hash_cmp);
+           if (hash_find_item (&incdep_prefetched, cur))
+             {
+               incdep_freeit (cur); /* already queued */
+               continue;
+             }
+           hash_insert (&incdep_prefetched, cur);
+         }
+
        cur->next = NULL;
        if (tail)
          tail->next = cur;
        else
          head = cur;
        tail = cur;
+       num_files++;
     }
 
 #ifdef ELECTRIC_HEAP
@@ -1851,8 +2188,16 @@ eval_include_dep (const char *names, floc *f, enum incdep_op op)
         {
           struct incdep *next = cur->next;
           incdep_read_file (cur, f);
-          eval_include_dep_file (cur, f);
-          incdep_freeit (cur);
+          if (cur->makefile)
+            {
+              cur->makefile_done = 1;
+              cur->next = NULL;
+            }
+          else
+            {
+              eval_include_dep_file (cur, f);
+              incdep_freeit (cur);
+            }
           cur = next;
         }
     }
@@ -1867,15 +2212,26 @@ eval_include_dep (const char *names, floc *f, enum incdep_op op)
 
       incdep_lock ();
 
-      if (incdep_tail_todo)
-        incdep_tail_todo->next = head;
-      else
-        incdep_head_todo = head;
-      incdep_tail_todo = tail;
+      if (head) /* (may be empty when everything came from the database) */
+        {
+          if (incdep_tail_todo)
+            incdep_tail_todo->next = head;
+          else
+            incdep_head_todo = head;
+          incdep_tail_todo = tail;
+        }
+      incdep_num_todo += num_files;
+      num_todo = incdep_num_todo;
 
       incdep_signal_todo ();
       incdep_unlock ();
 
+      /* start more threads if there is enough work for them. */
+
+      if (incdep_num_threads < incdep_max_threads)
+        incdep_start_threads ((num_todo + INCDEP_FILES_PER_THREAD - 1)
+                              / INCDEP_FILES_PER_THREAD, f);
+
       /* flush the todo queue if we're requested to do so. */
 
       if (op == incdep_flush)
@@ -132,6 +132,14 @@ static void vmsWaitForChildren (int *);
 # include <process.h>
 #endif
 
+#if defined (CONFIG_WITH_POSIX_SPAWN) && defined (GETLOADAVG_PRIVILEGED)
+# undef CONFIG_WITH_POSIX_SPAWN /* child_access must run in the child. */
+#endif
+#ifdef CONFIG_WITH_POSIX_SPAWN
+# include <spawn.h>
+# include "hash.h"
+#endif
+
 #if defined (HAVE_SYS_WAIT_H) || defined (HAVE_UNION_WAIT)
 # include <sys/wait.h>
 #endif
@@ -228,6 +236,9 @@ int getloadavg (double loadavg[], int nelem);
 
 static void free_child (struct child *);
 static void start_job_command (struct child *child);
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+static pid_t embedded_shell_job (struct child *child, char **argv);
+#endif
 static int load_too_high (void);
 static int job_next_command (struct child *);
 static int start_waiting_job (struct child *);
@@ -742,6 +753,36 @@ reap_children (int block, int err)
               /* A Posix failure can be exactly translated */
               if ((c->cstatus & VMS_POSIX_EXIT_MASK) == VMS_POSIX_EXIT_MASK)
                 status = (c->cstatus >> 3 & 255) << 8;
+#elif defined (CONFIG_WITH_KMK_BUILTIN) && !defined (KBUILD_OS_OS2) /* bird */
+              /* Jobs submitted to kWorker instances and built-in commands
+                 running on worker threads complete without any process
+                 dying, so check for those first and don't block in wait()
+                 while any of them are outstanding.  */
+              pid = kmk_builtin_async_reap (&status);
+              while (pid == 0)
+                {
+                  unsigned int async_busy = kmk_builtin_async_busy ();
+                  if (!block || async_busy)
+                    EINTRLOOP (pid, waitpid (-1, &status, WNOHANG));
+                  else
+                    EINTRLOOP (pid, wait (&status));
+                  if (pid > 0)
+                    {
+                      if (!kmk_builtin_child_reaped (pid, status))
+                        break;
+                      pid = 0; /* an embedded shell's child, not ours */
+                      continue;
+                    }
+                  if (pid < 0 && (errno != ECHILD || !async_busy))
+                    break;
+                  if (!block)
+                    {
+                      pid = 0;
+                      break;
+                    }
+                  kmk_builtin_async_wait ();
+                  pid = kmk_builtin_async_reap (&status);
+                }
 #else
 #ifdef WAIT_NOHANG
               if (!block)
@@ -909,6 +950,11 @@ reap_children (int block, int err)
 #endif /* WINDOWS32 */
         }
 
+#ifdef CONFIG_WITH_DIRCACHE
+      /* The job may have changed the file system. */
+      dir_cache_invalid_after_job ();
+#endif
+
       /* Check if this is the child of the 'shell' function.  */
       if (!remote && pid == shell_function_pid)
         {
@@ -927,6 +973,11 @@ reap_children (int block, int err)
            Ignore it; it was inherited from our invoker.  */
         continue;
 
+#ifdef OUTPUT_WITH_PIPES
+      /* Collect the rest of its output before adding to it.  */
+      output_pipe_wait (&c->output);
+#endif
+
       /* Determine the failure status: 0 for success, 1 for updating target in
          question mode, 2 for anything else.  */
       if (exit_sig == 0 && exit_code == 0)
@@ -1116,6 +1167,27 @@ free_child (struct child *child)
 {
 #ifdef CONFIG_WITH_PRINT_TIME_SWITCH
   print_job_time (child);
+#endif
+#ifdef CONFIG_WITH_JOB_HISTORY
+  if (   !handling_fatal_signal
+      && child->start_ts != -1
+      && child->file->update_status == us_success
+      && !just_print_flag && !question_flag && !touch_flag)
+    job_history_record (child->file, nano_timestamp () - child->start_ts);
+#endif
+#ifdef CONFIG_WITH_CMD_DB
+  if (   !handling_fatal_signal
+      && child->file->update_status == us_success
+      && !just_print_flag && !question_flag && !touch_flag)
+    {
+# ifdef CONFIG_WITH_EXPLICIT_MULTITARGET
+      struct file *f2;
+      for (f2 = child->file; f2; f2 = f2->multi_next)
+        cmd_db_record (f2);
+# else
+      cmd_db_record (child->file);
+# endif
+    }
 #endif
   output_close (&child->output);
 
@@ -1530,7 +1602,12 @@ start_job_command (struct child *child)
 
           /* synchronous command execution? */
           if (!argv_spawn)
-            goto next_command;
+            {
+# ifdef CONFIG_WITH_DIRCACHE
+              dir_cache_invalid_after_job ();
+# endif
+              goto next_command;
+            }
         }
 
       /* failure? */
@@ -1614,8 +1691,28 @@ start_job_command (struct child *child)
 
       jobserver_pre_child (flags & COMMANDS_RECURSE);
 
+#ifdef OUTPUT_WITH_PIPES
+      if (child->output.syncout)
+        output_pipe_open (&child->output);
+#endif
+
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+      child->pid = -1;
+      if (!(flags & COMMANDS_RECURSE))
+        child->pid = embedded_shell_job (child, argv);
+      if (child->pid < 0)
+#endif
       child->pid = child_execute_job (&child->output, child->good_stdin, argv, child->environment);
 
+#ifdef OUTPUT_WITH_PIPES
+      if (child->output.child_out >= 0)
+        {
+          output_pipe_close_child (&child->output);
+          if (child->pid < 0)
+            output_pipe_wait (&child->output);
+        }
+#endif
+
       environ = parent_environ; /* Restore value child may have clobbered.  */
       jobserver_post_child (flags & COMMANDS_RECURSE);
 
@@ -2447,6 +2544,273 @@ child_execute_job (struct output *out, int good_stdin, char **argv, char **envp)
 
 #elif !defined (_AMIGA) && !defined (__MSDOS__) && !defined (VMS)
 
+# ifdef CONFIG_WITH_POSIX_SPAWN /* bird */
+/* Launching jobs with posix_spawn.
+
+   With a big kmk process vfork+execvp is slow: the parent is suspended
+   while the child walks PATH, doing one failing execve after the other.
+   Instead the executable is resolved in the parent, where the result is
+   cached by name until PATH changes, and the job is started with a single
+   posix_spawn call using pre-built attributes.  Anything out of the
+   ordinary (not found, scripts without #!, spawn failures) goes down the
+   old vfork path, which deals with it and reports errors the usual way.
+
+   Note that since the resolved names are cached, an executable showing up
+   earlier in PATH during the build won't be noticed.  */
+
+/* A resolved executable. */
+struct spawn_exe
+  {
+    const char *name;           /* argv[0] (strcache). */
+    const char *path;           /* The absolute path (strcache). */
+  };
+
+static struct hash_table spawn_exe_table;
+
+/* The PATH value the cache entries were resolved with (heap). */
+static char *spawn_exe_path;
+
+/* The attributes used for every job.  */
+static posix_spawnattr_t spawn_attr;
+
+/* -1 if posix_spawn isn't usable, 1 if initialized. */
+static int spawn_state;
+
+static unsigned long
+spawn_exe_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((struct spawn_exe const *) key)->name);
+}
+
+static unsigned long
+spawn_exe_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((struct spawn_exe const *) key)->name);
+}
+
+static int
+spawn_exe_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((struct spawn_exe const *) x)->name,
+                         ((struct spawn_exe const *) y)->name);
+}
+
+/* Sets up the spawn attributes and the cache.  Returns nonzero if
+   posix_spawn can be used.  */
+static int
+spawn_init (void)
+{
+  sigset_t empty;
+  short flags = POSIX_SPAWN_SETSIGMASK;
+
+  if (spawn_state)
+    return spawn_state > 0;
+  spawn_state = -1;
+
+  /* The child starts out with no signals blocked, like after unblock_sigs.  */
+  sigemptyset (&empty);
+#  ifdef POSIX_SPAWN_USEVFORK
+  flags |= POSIX_SPAWN_USEVFORK;
+#  endif
+  if (   posix_spawnattr_init (&spawn_attr) != 0
+      || posix_spawnattr_setsigmask (&spawn_attr, &empty) != 0
+      || posix_spawnattr_setflags (&spawn_attr, flags) != 0)
+    return 0;
+
+  hash_init (&spawn_exe_table, 64, spawn_exe_hash_1, spawn_exe_hash_2,
+             spawn_exe_hash_cmp);
+  spawn_state = 1;
+  return 1;
+}
+
+/* Checks if PATH is an executable file.  */
+static int
+spawn_is_executable (const char *path)
+{
+  struct stat st;
+  return stat (path, &st) == 0
+      && S_ISREG (st.st_mode)
+      && access (path, X_OK) == 0;
+}
+
+/* Resolves NAME to an absolute path the way execvp would, using the PATH
+   in ENVP.  Returns NULL if not found or if the result would depend on the
+   current directory.  */
+static const char *
+spawn_resolve (const char *name, char **envp)
+{
+  struct spawn_exe key;
+  struct spawn_exe *exe;
+  const char *path = NULL;
+  const char *dir;
+  char **env;
+  size_t name_len;
+  char buf[GET_PATH_MAX];
+
+  if (strchr (name, '/'))
+    return name;
+
+  for (env = envp; *env; env++)
+    if (!strncmp (*env, "PATH=", 5))
+      {
+        path = *env + 5;
+        break;
+      }
+  if (!path || !*path)
+    return NULL;
+
+  /* Drop the cache when PATH changes.  */
+  if (!spawn_exe_path || strcmp (spawn_exe_path, path))
+    {
+      hash_free (&spawn_exe_table, 1);
+      hash_init (&spawn_exe_table, 64, spawn_exe_hash_1, spawn_exe_hash_2,
+                 spawn_exe_hash_cmp);
+      free (spawn_exe_path);
+      spawn_exe_path = xstrdup (path);
+    }
+
+  key.name = name;
+  exe = hash_find_item (&spawn_exe_table, &key);
+  if (exe)
+    return exe->path;
+
+  name_len = strlen (name);
+  for (dir = path; ; )
+    {
+      const char *end = strchr (dir, PATH_SEPARATOR_CHAR);
+      size_t dir_len = end ? (size_t) (end - dir) : strlen (dir);
+
+      /* Relative entries (incl. empty ones meaning '.') make the result
+         depend on the current directory, leave those to execvp.  */
+      if (dir_len == 0 || *dir != '/')
+        return NULL;
+      if (dir_len + 1 + name_len < sizeof (buf))
+        {
+          memcpy (buf, dir, dir_len);
+          buf[dir_len] = '/';
+          memcpy (&buf[dir_len + 1], name, name_len + 1);
+          if (spawn_is_executable (buf))
+            {
+              exe = xmalloc (sizeof (*exe));
+              exe->name = strcache_add (name);
+              exe->path = strcache_add (buf);
+              hash_insert (&spawn_exe_table, exe);
+              return exe->path;
+            }
+        }
+      if (!end)
+        return NULL;
+      dir = end + 1;
+    }
+}
+
+/* Tries to start ARGV with posix_spawn, redirecting FDIN, FDOUT and FDERR
+   to the standard handles.  Returns the PID, or -1 if the caller should
+   do it the old way.  */
+static pid_t
+spawn_job (char **argv, char **envp, int fdin, int fdout, int fderr)
+{
+  posix_spawn_file_actions_t actions;
+  const char *exe;
+  pid_t pid;
+  int rc;
+
+  if (!spawn_init ())
+    return -1;
+  exe = spawn_resolve (argv[0], envp);
+  if (!exe)
+    return -1;
+
+  if (posix_spawn_file_actions_init (&actions) != 0)
+    return -1;
+  rc = 0;
+  if (fdin != FD_STDIN)
+    rc = posix_spawn_file_actions_adddup2 (&actions, fdin, FD_STDIN);
+  if (!rc && fdout != FD_STDOUT)
+    rc = posix_spawn_file_actions_adddup2 (&actions, fdout, FD_STDOUT);
+  if (!rc && fderr != FD_STDERR)
+    rc = posix_spawn_file_actions_adddup2 (&actions, fderr, FD_STDERR);
+
+  if (!rc)
+    {
+#  ifdef SET_STACK_SIZE
+      /* The child gets the original stack limit.  Nothing else runs on
+         this thread while it's lowered, so it doesn't affect us.  */
+      struct rlimit cur;
+      int restore = 0;
+      if (stack_limit.rlim_cur && getrlimit (RLIMIT_STACK, &cur) == 0)
+        restore = setrlimit (RLIMIT_STACK, &stack_limit) == 0;
+#  endif
+
+      rc = posix_spawn (&pid, exe, &actions, &spawn_attr, argv, envp);
+
+#  ifdef SET_STACK_SIZE
+      if (restore)
+        setrlimit (RLIMIT_STACK, &cur);
+#  endif
+    }
+  posix_spawn_file_actions_destroy (&actions);
+
+  if (rc != 0)
+    {
+      DB (DB_JOBS, (_("posix_spawn (%s) failed (%s), using execvp.\n"),
+                    exe, strerror (rc)));
+      return -1;
+    }
+  return pid;
+}
+# endif /* CONFIG_WITH_POSIX_SPAWN */
+
+# ifdef CONFIG_WITH_KASH_EMBEDDED
+/* Runs the command line in ARGV with the kash linked into kmk on a worker
+   thread if ARGV[0] is kmk_ash, so that only the external programs it runs
+   need a process.  Recursive make lines are never passed here as they need
+   the jobserver handles.  Returns the fake PID of the job, or -1 if the
+   caller should fork the shell as usual.  */
+static pid_t
+embedded_shell_job (struct child *child, char **argv)
+{
+  struct output *out = &child->output;
+  const char *shell = get_default_kbuild_shell ();
+  size_t len = strlen (argv[0]);
+  int fds[3];
+  int argc;
+  pid_t pid;
+
+  if (strcmp (argv[0], shell) != 0
+      && (len < sizeof ("/kmk_ash") - 1
+          || strcmp (&argv[0][len - sizeof ("/kmk_ash") + 1], "/kmk_ash") != 0))
+    return -1;
+
+  /* Same standard handles as child_execute_job would give it.  */
+  fds[0] = child->good_stdin ? FD_STDIN : get_bad_stdin ();
+  fds[1] = FD_STDOUT;
+  fds[2] = FD_STDERR;
+  if (out->syncout)
+    {
+#ifdef OUTPUT_WITH_PIPES
+      if (out->child_out >= 0)
+        fds[1] = out->child_out;
+      if (out->child_err >= 0)
+        fds[2] = out->child_err;
+#else
+      if (out->out >= 0)
+        fds[1] = out->out;
+      if (out->err >= 0)
+        fds[2] = out->err;
+#endif
+    }
+  if (fds[0] < 0)
+    return -1;
+
+  for (argc = 0; argv[argc]; argc++)
+    ;
+  if (kmk_builtin_thread_submit_shell (argc, argv, child->environment, fds, child, &pid) != 0)
+    return -1;
+  return pid;
+}
+# endif /* CONFIG_WITH_KASH_EMBEDDED */
+
 /* POSIX:
    Create a child process executing the command in ARGV.
    ENVP is the environment of the new program.  Returns the PID or -1.  */
@@ -2462,12 +2826,25 @@ child_execute_job (struct output *out, int good_stdin, char **argv, char **envp)
   /* Divert child output if we want to capture it.  */
   if (out && out->syncout)
     {
+#ifdef OUTPUT_WITH_PIPES
+      if (out->child_out >= 0)
+        fdout = out->child_out;
+      if (out->child_err >= 0)
+        fderr = out->child_err;
+#else
       if (out->out >= 0)
         fdout = out->out;
       if (out->err >= 0)
         fderr = out->err;
+#endif
     }
 
+#ifdef CONFIG_WITH_POSIX_SPAWN
+  pid = spawn_job (argv, envp, fdin, fdout, fderr);
+  if (pid > 0)
+    return pid;
+#endif
+
   pid = vfork();
   if (pid != 0)
     return pid;
@@ -0,0 +1,404 @@
+#ifdef CONFIG_WITH_JOB_HISTORY
+/* $Id$ */
+/** @file
+ * jobhist - Job duration history and critical path estimates.
+ *
+ * When KMK_JOB_HISTORY names a file, the time it took to run the commands of
+ * each target is recorded there when kmk exits.  In parallel builds the
+ * history is used to estimate the longest (critical) path thru the
+ * dependencies of each file, and remake.c visits the prerequisites with the
+ * longest path first so that the long chains (typically ending in a big link)
+ * get their jobs started as early as possible instead of being left for the
+ * tail of the build.
+ *
+ * The file is a simple text file with one '<milliseconds> <target>' line per
+ * target, with the target name made absolute so that kmk instances started
+ * in different directories can share the file.  Updates from concurrent kmk instances sharing the file are merged
+ * at save time, but there is no locking, so a sample may occasionally get
+ * lost.  That's harmless as it's only used for ordering.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "makeint.h"
+#include <assert.h>
+
+#include "filedef.h"
+#include "dep.h"
+#include "job.h"
+#include "variable.h"
+#include "hash.h"
+#include "debug.h"
+
+#ifndef CONFIG_WITH_PRINT_TIME_SWITCH
+# error "CONFIG_WITH_JOB_HISTORY requires CONFIG_WITH_PRINT_TIME_SWITCH (child::start_ts)"
+#endif
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/* The first line of the history file. */
+#define JOBHIST_SIGNATURE   "# kmk job history v2"
+
+/* Initial size of the history hash table. */
+#define JOBHIST_BUCKETS     4096
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/* A history entry. */
+struct jobhist_entry
+  {
+    const char *name;           /* The absolute target name (strcache). */
+    unsigned long ms;           /* The average duration in milliseconds. */
+    int dirty;                  /* Nonzero if updated by this instance. */
+  };
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/* Whether we've checked KMK_JOB_HISTORY.
+   1 if it's set and the history is loaded, -1 if not set. */
+static int jobhist_state = 0;
+
+/* The absolute name of the history file (heap). */
+static char *jobhist_filename;
+
+/* The history entries, keyed by absolute target name. */
+static struct hash_table jobhist_table;
+
+/* Number of entries updated during this run. */
+static unsigned int jobhist_dirty;
+
+
+static unsigned long
+jobhist_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((struct jobhist_entry const *) key)->name);
+}
+
+static unsigned long
+jobhist_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((struct jobhist_entry const *) key)->name);
+}
+
+static int
+jobhist_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((struct jobhist_entry const *) x)->name,
+                         ((struct jobhist_entry const *) y)->name);
+}
+
+/* Looks up NAME, returning NULL if not found. */
+static struct jobhist_entry *
+jobhist_lookup (const char *name)
+{
+  struct jobhist_entry key;
+  struct jobhist_entry *entry;
+
+  key.name = name;
+  entry = hash_find_item (&jobhist_table, &key);
+  return entry;
+}
+
+/* Returns the absolute name (strcache) of FILE, which the history is keyed
+   on, or NULL if it cannot be made absolute.  */
+static const char *
+jobhist_key (struct file *file)
+{
+  char buf[GET_PATH_MAX];
+
+  if (file->name[0] == '/')
+    return file->name;
+  if (!abspath (file->name, buf))
+    return NULL;
+  return strcache_add (buf);
+}
+
+/* Reads the history file and enters the entries that aren't already in the
+   table.  If OVERWRITE_CLEAN is set, entries we haven't updated ourselves
+   are refreshed from the file.  */
+static void
+jobhist_read (int overwrite_clean)
+{
+  char line[GET_PATH_MAX + 64];
+  FILE *fp = fopen (jobhist_filename, "r");
+  if (!fp)
+    return;
+
+  if (   fgets (line, sizeof (line), fp)
+      && !strncmp (line, JOBHIST_SIGNATURE, sizeof (JOBHIST_SIGNATURE) - 1))
+    while (fgets (line, sizeof (line), fp))
+      {
+        char *name;
+        char *end;
+        unsigned long ms = strtoul (line, &name, 10);
+        struct jobhist_entry *entry;
+
+        if (name == line || *name != ' ')
+          continue;
+        name++;
+        end = strchr (name, '\n');
+        if (!end || end == name)
+          continue;
+        *end = '\0';
+
+        name = (char *) strcache_add_len (name, end - name);
+        entry = jobhist_lookup (name);
+        if (!entry)
+          {
+            entry = xmalloc (sizeof (*entry));
+            entry->name = name;
+            entry->dirty = 0;
+            entry->ms = ms;
+            hash_insert (&jobhist_table, entry);
+          }
+        else if (overwrite_clean && !entry->dirty)
+          entry->ms = ms;
+      }
+
+  fclose (fp);
+}
+
+/* Checks KMK_JOB_HISTORY and loads the history the first time around.
+   Returns nonzero if we're keeping history.  */
+static int
+jobhist_init (void)
+{
+  struct variable *v;
+  char *name;
+  char buf[GET_PATH_MAX];
+
+  if (jobhist_state)
+    return jobhist_state > 0;
+  jobhist_state = -1;
+
+  v = lookup_variable ("KMK_JOB_HISTORY", sizeof ("KMK_JOB_HISTORY") - 1);
+  if (!v || !v->value_length)
+    return 0;
+  if (v->recursive && memchr (v->value, '$', v->value_length))
+    name = allocated_variable_expand (v->value);
+  else
+    name = xstrdup (v->value);
+  if (!*name || !abspath (name, buf))
+    {
+      free (name);
+      return 0;
+    }
+  free (name);
+
+  jobhist_filename = xstrdup (buf);
+  hash_init (&jobhist_table, JOBHIST_BUCKETS, jobhist_hash_1, jobhist_hash_2,
+             jobhist_hash_cmp);
+  jobhist_read (0);
+  jobhist_state = 1;
+  DB (DB_BASIC, (_("Loaded %lu job history entries from '%s'.\n"),
+                 jobhist_table.ht_fill, jobhist_filename));
+  return 1;
+}
+
+/* Records that the commands for FILE took ELAPSED nanoseconds to run.  */
+void
+job_history_record (struct file *file, big_int elapsed)
+{
+  struct jobhist_entry *entry;
+  const char *name;
+  unsigned long ms;
+
+  if (!jobhist_init ())
+    return;
+  name = jobhist_key (file);
+  if (!name)
+    return;
+
+  ms = (unsigned long) (elapsed / 1000000);
+  entry = jobhist_lookup (name);
+  if (!entry)
+    {
+      entry = xmalloc (sizeof (*entry));
+      entry->name = name;
+      entry->ms = ms;
+      entry->dirty = 0;
+      hash_insert (&jobhist_table, entry);
+    }
+  else
+    /* Simple smoothing so a single odd run doesn't skew things.  */
+    entry->ms = (entry->ms + ms + 1) / 2;
+  if (!entry->dirty)
+    {
+      entry->dirty = 1;
+      jobhist_dirty++;
+    }
+}
+
+/* Writes the history file if anything was recorded.  The file is re-read
+   first so that updates by other kmk instances using the same history
+   aren't lost.  */
+void
+job_history_save (void)
+{
+  char *tmpname;
+  FILE *fp;
+  struct jobhist_entry **slot;
+  struct jobhist_entry **end;
+  int ok;
+
+  if (jobhist_state <= 0 || !jobhist_dirty)
+    return;
+  jobhist_dirty = 0;
+
+  jobhist_read (1);
+
+  tmpname = xmalloc (strlen (jobhist_filename) + 32);
+  sprintf (tmpname, "%s.%ld.tmp", jobhist_filename, (long) getpid ());
+  fp = fopen (tmpname, "w");
+  if (!fp)
+    {
+      OSS (error, NILF, _("KMK_JOB_HISTORY: failed to create '%s': %s"),
+           tmpname, strerror (errno));
+      free (tmpname);
+      return;
+    }
+
+  fputs (JOBHIST_SIGNATURE "\n", fp);
+  slot = (struct jobhist_entry **) jobhist_table.ht_vec;
+  end = slot + jobhist_table.ht_size;
+  for (; slot < end; slot++)
+    if (!HASH_VACANT (*slot))
+      fprintf (fp, "%lu %s\n", (*slot)->ms, (*slot)->name);
+
+  ok = !ferror (fp);
+  ok = fclose (fp) == 0 && ok;
+  if (!ok || rename (tmpname, jobhist_filename) != 0)
+    {
+      OSS (error, NILF, _("KMK_JOB_HISTORY: failed to write '%s': %s"),
+           jobhist_filename, strerror (errno));
+      unlink (tmpname);
+    }
+  free (tmpname);
+}
+
+/* Returns the estimated length in milliseconds of the longest chain of
+   commands that has to run to update FILE, i.e. the recorded duration of
+   FILE plus the longest path thru any of its prerequisites.  The result is
+   cached in the file structure.  */
+static unsigned long
+jobhist_crit_path (struct file *file)
+{
+  struct jobhist_entry *entry;
+  const char *name;
+  struct dep *d;
+  unsigned long longest = 0;
+
+  if (file->crit_path_done)
+    return file->crit_path_ms; /* (0 when called recursively for a loop.) */
+  file->crit_path_done = 1;
+
+  for (d = file->deps; d != 0; d = d->next)
+    if (d->file && !d->ignore_mtime)
+      {
+        unsigned long ms = jobhist_crit_path (d->file);
+        if (ms > longest)
+          longest = ms;
+      }
+
+  name = jobhist_key (file);
+  entry = name ? jobhist_lookup (name) : NULL;
+  if (entry)
+    longest += entry->ms;
+  file->crit_path_ms = longest;
+  return longest;
+}
+
+/* Sort element for job_history_sort_deps. */
+struct jobhist_sort_entry
+  {
+    struct dep *dep;
+    unsigned long ms;           /* The critical path thru dep. */
+    unsigned int idx;           /* The original position, for stability. */
+  };
+
+/* qsort callback for job_history_sort_deps: longest path first, otherwise
+   keep the makefile order.  */
+static int
+jobhist_dep_cmp (const void *pv1, const void *pv2)
+{
+  struct jobhist_sort_entry const *e1 = (struct jobhist_sort_entry const *) pv1;
+  struct jobhist_sort_entry const *e2 = (struct jobhist_sort_entry const *) pv2;
+  if (e1->ms != e2->ms)
+    return e1->ms < e2->ms ? 1 : -1;
+  return e1->idx < e2->idx ? -1 : e1->idx > e2->idx;
+}
+
+/* Returns a NULL terminated array (heap) with the dependencies in DEPS
+   ordered by the critical path thru them, longest first.  Returns NULL if
+   there is no point in reordering them (serial build, .NOTPARALLEL in
+   effect, no history, or nothing to gain), in which case the caller should
+   just walk the list.  */
+struct dep **
+job_history_sort_deps (struct dep *deps)
+{
+  struct jobhist_sort_entry *order;
+  struct dep **sorted;
+  struct dep *d;
+  unsigned int count = 0;
+  unsigned int i;
+  int any = 0;
+
+  if (job_slots == 1 || not_parallel || !deps || !deps->next)
+    return NULL;
+  if (!jobhist_init () || !jobhist_table.ht_fill)
+    return NULL;
+
+  for (d = deps; d != 0; d = d->next)
+    {
+      count++;
+      if (jobhist_crit_path (d->file))
+        any = 1;
+    }
+  if (!any)
+    return NULL;
+
+  order = xmalloc (count * sizeof (*order));
+  for (i = 0, d = deps; d != 0; d = d->next, i++)
+    {
+      order[i].dep = d;
+      order[i].ms = d->file->crit_path_ms;
+      order[i].idx = i;
+    }
+  qsort (order, count, sizeof (*order), jobhist_dep_cmp);
+
+  sorted = xmalloc ((count + 1) * sizeof (*sorted));
+  for (i = 0; i < count; i++)
+    sorted[i] = order[i].dep;
+  sorted[count] = NULL;
+  free (order);
+  return sorted;
+}
+
+#endif /* CONFIG_WITH_JOB_HISTORY */
@@ -1,6 +1,19 @@
 /* $Id: incdep.c 2283 2009-02-24 04:54:00Z bird $ */
 /** @file
  * kdepdb - Dependency database.
+ *
+ * The database replaces the per-object dependency files that the compilers
+ * and the kDepObj/kDepPre tools produce.  Each entry is keyed by the name of
+ * the dependency file it replaces and holds the rules ('target: deps') that
+ * the file would have contained, serialized as string table indexes.  The
+ * files are memory mapped, so looking up an entry doesn't involve any parsing
+ * or file I/O once the database has been opened.
+ *
+ * The database is shared between processes (and threads) using a lock file,
+ * readers take a shared lock and writers an exclusive one.  There is no
+ * journalling, so if a writer dies half way thru an update the database may
+ * end up corrupted.  Corruption is detected (most of the time) and reported
+ * as EIO / EINVAL, and the fix is to delete the database files.
  */
 
 /*
@@ -26,31 +39,22 @@
 /*******************************************************************************
 *   Header Files                                                               *
 *******************************************************************************/
-#include "makeint.h"
-#include "../lib/k/kDefs.h"
-#include "../lib/k/kTypes.h"
+#include "k/kDefs.h"
+#include "k/kTypes.h"
 #include <assert.h>
-#include <glob.h>
-
-#include "dep.h"
-#include "filedef.h"
-#include "job.h"
-#include "commands.h"
-#include "variable.h"
-#include "rule.h"
-#include "debug.h"
-#include "strcache2.h"
-
-#ifdef HAVE_FCNTL_H
-# include <fcntl.h>
-#else
-# include <sys/file.h>
-#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
-#if K_OS == K_WINDOWS
+#include "kdepdb.h"
+
+#if K_OS == K_OS_WINDOWS
 # include <Windows.h>
 #else
+# include <fcntl.h>
+# include <time.h>
 # include <unistd.h>
+# include <sys/file.h>
 # include <sys/mman.h>
 #endif
 
@@ -77,6 +81,18 @@ KDEPDB_ASSERT_SIZE(KU16, 2);
 KDEPDB_ASSERT_SIZE(KU32, 4);
 KDEPDB_ASSERT_SIZE(KU64, 8);
 
+/** The initial number of hash table entries. */
+#define KDEPDB_HASH_INITIAL_ENTRIES     1024
+/** The initial size of the string table and directory files. */
+#define KDEPDB_INITIAL_SIZE             (64*1024)
+/** The files are grown in chunks of this size. */
+#define KDEPDB_GROW_SIZE                (256*1024)
+/** The data file block size. */
+#define KDEPDB_DATA_BLOCK_SIZE          64
+/** The number of wasted data blocks required before we consider compacting
+ * the data file. */
+#define KDEPDB_COMPACT_MIN_BLOCKS       16384
+
 
 /*******************************************************************************
 *   Structures and Typedefs                                                    *
@@ -109,13 +125,13 @@ KDEPDB_ASSERT_SIZE(KDEPDBHDR, 32);
 #define KDEPDBHDR_VERSION_MAJOR     0
 /** The current minor file format version number.
  * Numbers above 240 indicate unsupported development variants. */
-#define KDEPDBHDR_VERSION_MINOR     240
+#define KDEPDBHDR_VERSION_MINOR     241
 
 
 /**
  * Hash table file.
  *
- * The hash table is recreated in a new file when we have to grow it.
+ * The hash table is rebuilt in place (growing the file) when it gets too full.
  */
 typedef struct KDEPDBHASH
 {
@@ -123,7 +139,7 @@ typedef struct KDEPDBHASH
     KDEPDBHDR       Hdr;
     /** The number of hash table entries. */
     KU32            cEntries;
-    /** The number of hash table entries with content. */
+    /** The number of hash table entries with content (incl. deleted ones). */
     KU32            cUsedEntries;
     /** The number of collisions on insert. */
     KU32            cCollisions;
@@ -166,6 +182,13 @@ typedef struct KDEPDBSTRING
 } KDEPDBSTRING;
 KDEPDB_ASSERT_SIZE(KDEPDBSTRING, 32);
 
+/** Calculates the number of string table entries needed for a string of the
+ * given length.  Long strings simply continue into the following entries. */
+#define KDEPDB_STRING_ENTRIES(cch) \
+    (  (cch) < sizeof(((KDEPDBSTRING *)0)->szString) \
+     ? KU32_C(1) \
+     : KU32_C(1) + ((cch) + 1 - sizeof(((KDEPDBSTRING *)0)->szString) + sizeof(KDEPDBSTRING) - 1) / sizeof(KDEPDBSTRING) )
+
 
 /**
  * String table file.
@@ -178,8 +201,10 @@ typedef struct KDEPDBSTRTAB
     KDEPDBHDR       Hdr;
     /** The end of the valid string table indexes. */
     KU32            iStringEnd;
-    /** Reserved member \#7. */
-    KU32            uReserved7;
+    /** The database generation number.
+     * This is incremented by every update of the database, so readers know
+     * when they need to check whether any of the files have grown. */
+    KU32            uGeneration;
     /** Reserved member \#6. */
     KU32            uReserved6;
     /** Reserved member \#5. */
@@ -260,23 +285,13 @@ typedef struct KDEPDBDIR
 KDEPDB_ASSERT_SIZE(KDEPDBDIR, 32+32+32);
 
 
-/**
- * A block allocation bitmap.
- *
- * This can track 2^(12+8) = 2^20 = 1M blocks.
- */
-typedef struct KDEPDBDATABITMAP
-{
-    /** Bitmap where each bit is a block.
-     * 0 indicates unused blocks and 1 indicates used ones. */
-    KU8             bm[4096];
-} KDEPDBDATABITMAP;
-KDEPDB_ASSERT_SIZE(KDEPDBDATABITMAP, 4096);
-
 /**
  * Data file.
  *
- * The block numbering starts with this structure as block 0.
+ * The block numbering starts with this structure as block 0.  Blocks are
+ * allocated from the end of the file, the blocks of streams that are
+ * rewritten and no longer fit are counted as wasted and reclaimed by
+ * compacting the file when there are enough of them.
  */
 typedef struct KDEPDBDATA
 {
@@ -284,10 +299,11 @@ typedef struct KDEPDBDATA
     KDEPDBHDR       Hdr;
     /** The size of a block. */
     KU32            cbBlock;
-    /** Reserved member \#7. */
-    KU32            uReserved7;
-    /** Reserved member \#6. */
-    KU32            uReserved6;
+    /** The number of allocated blocks, including the header block(s). */
+    KU32            cBlocks;
+    /** The number of wasted blocks, i.e. allocated blocks that aren't
+     * referenced by any directory entry. */
+    KU32            cWastedBlocks;
     /** Reserved member \#5. */
     KU32            uReserved5;
     /** Reserved member \#4. */
@@ -298,28 +314,31 @@ typedef struct KDEPDBDATA
     KU32            uReserved2;
     /** Reserved member \#1. */
     KU32            uReserved1;
-
-    /** Block numbers for the allocation bitmaps.  */
-    KU32            aiBitmaps[4096];
 } KDEPDBDATA;
+KDEPDB_ASSERT_SIZE(KDEPDBDATA, 32+32);
 
 /** The end of the valid block indexes (exclusive). */
 #define KDEPDB_BLOCK_IDX_END            KU32_C(0xfffffff0)
-/** The index of an unallocated bitmap block. */
-#define KDEPDB_BLOCK_IDX_UNALLOCATED    KU32_C(0xffffffff)
 
 
 /**
  * Stream storing dependencies.
  *
- * The stream name gives the output file name, so all that we need is the list
- * of files it depends on. These are serialized as a list of string table
- * indexes.
+ * The stream name gives the dependency file name, so all that we need is the
+ * rules that file would contain.  These are serialized as a list of string
+ * table indexes.  The time the entry was stored is kept so that a dependency
+ * file written afterwards can take precedence.
  */
 typedef struct KDEPDBDEPSTREAM
 {
-    /** String table indexes for the dependencies. */
-    KU32            aiDeps[1];
+    /** When the entry was stored, nanoseconds since 1970-01-01 UTC (low and
+     * high parts). */
+    KU32            auTimestamp[2];
+    /** The number of rules. */
+    KU32            cRules;
+    /** The rules.  Each rule is the string table index of the target, followed
+     * by the number of dependencies and that many string table indexes. */
+    KU32            au[1];
 } KDEPDBDEPSTREAM;
 
 
@@ -339,6 +358,10 @@ typedef struct KDEPDBFH
 #endif
     /** The current file size. */
     KU32        cb;
+    /** The size of the current mapping. */
+    KU32        cbMapped;
+    /** Whether the file is open for writing. */
+    KBOOL       fWrite;
 } KDEPDBFH;
 
 
@@ -368,22 +391,16 @@ typedef struct KDEPDBINTSTRTAB
  */
 typedef struct KDEPDBINTDATASET
 {
-    /** The hash file. */
-    KDEPDBHASH      pHash;
-    /** The size of the hash file. */
-    KU32            cbHash;
-    /** The size of the directory file. */
-    KU32            cbDir;
-    /** The mapping of the directory file. */
-    KDEPDBHASH      pDir;
-    /** The data file. */
-    KDEPDBDATA      pData;
-    /** The size of the data file. */
-    KU32            cbData;
+    /** The mapping of the hash file. */
+    KDEPDBHASH     *pHash;
     /** The handle of the hash file. */
     KDEPDBFH        hHash;
+    /** The mapping of the directory file. */
+    KDEPDBDIR      *pDir;
     /** The handle of the directory file. */
     KDEPDBFH        hDir;
+    /** The mapping of the data file. */
+    KDEPDBDATA     *pData;
     /** The handle of the data file. */
     KDEPDBFH        hData;
 } KDEPDBINTDATASET;
@@ -392,21 +409,39 @@ typedef struct KDEPDBINTDATASET
 /**
  * The database instance.
  *
- * To simplifiy things the database uses 8 files for storing the different kinds
- * of data. This greatly reduces the complexity compared to a single file
- * solution.
+ * To simplifiy things the database uses several files for storing the
+ * different kinds of data. This greatly reduces the complexity compared to a
+ * single file solution.
  */
 typedef struct KDEPDB
 {
     /** The string table. */
     KDEPDBINTSTRTAB     StrTab;
-    /** The variable data set. */
+    /** The dependency data set. */
     KDEPDBINTDATASET    DepSet;
-    /** The command data set. */
-    KDEPDBINTDATASET    CmdSet;
+    /** The lock file handle. */
+    KDEPDBFH            hLock;
+    /** The lock recursion count. */
+    unsigned            cLocks;
+    /** Whether we've got an exclusive lock. */
+    KBOOL               fExclusive;
+    /** Whether the database was opened for writing. */
+    KBOOL               fWrite;
+    /** The generation number our mappings correspond to. */
+    KU32                uGeneration;
 } KDEPDB;
 
 
+/**
+ * Value to hash callback used when rebuilding hash tables.
+ *
+ * @returns The hash of the item the hash table value refers to.
+ * @param   pDb         The database.
+ * @param   uValue      The hash table value.
+ */
+typedef KU32 FNKDEPDBHASHVALUE(PKDEPDB pDb, KU32 uValue);
+
+
 /*******************************************************************************
 *   Internal Functions                                                         *
 *******************************************************************************/
@@ -414,19 +449,21 @@ static void *kDepDbAlloc(KSIZE cb);
 static void kDepDbFree(void *pv);
 static void kDepDbFHInit(KDEPDBFH *pFH);
 static int  kDepDbFHUpdateSize(KDEPDBFH *pFH);
-static int  kDepDbFHOpen(KDEPDBFH *pFH, const char *pszFilename, KBOOL fCreate, KBOOL *pfNew);
+static int  kDepDbFHOpen(KDEPDBFH *pFH, const char *pszFilename, KBOOL fWrite, KBOOL *pfCreated);
 static int  kDepDbFHClose(KDEPDBFH *pFH);
-static int  kDepDbFHWriteAt(KDEPDBFH *pFH, KU32 off, void const *pvBuf, KSIZE cbBuf);
 static int  kDepDbFHMap(KDEPDBFH *pFH, void **ppvMap);
 static int  kDepDbFHUnmap(KDEPDBFH *pFH, void **ppvMap);
 static int  kDepDbFHGrow(KDEPDBFH *pFH, KSIZE cbNew, void **ppvMap);
+static int  kDepDbFHLock(KDEPDBFH *pFH, KBOOL fExclusive);
+static int  kDepDbFHUnlock(KDEPDBFH *pFH);
 static KU32 kDepDbHashString(const char *pszString, size_t cchString);
+static int  kDepDbUnlock(PKDEPDB pDb);
 
 
-/** xmalloc wrapper. */
+/** malloc wrapper. */
 static void *kDepDbAlloc(KSIZE cb)
 {
-    return xmalloc(cb);
+    return malloc(cb);
 }
 
 /** free wrapper. */
@@ -447,11 +484,13 @@ static void kDepDbFHInit(KDEPDBFH *pFH)
 {
 #if K_OS == K_OS_WINDOWS
     pFH->hFile   = INVALID_HANDLE_VALUE;
-    pFH->hMapObj = INVALID_HANDLE_VALUE;
+    pFH->hMapObj = NULL;
 #else
     pFH->fd = -1;
 #endif
     pFH->cb = 0;
+    pFH->cbMapped = 0;
+    pFH->fWrite = K_FALSE;
 }
 
 /**
@@ -468,14 +507,14 @@ static int  kDepDbFHUpdateSize(KDEPDBFH *pFH)
     DWORD   dwLow;
 
     SetLastError(0);
-    dwLow = GetFileSize(File, &High);
+    dwLow = GetFileSize(pFH->hFile, &dwHigh);
     rc = GetLastError();
     if (rc)
     {
         pFH->cb = 0;
         return (int)rc;
     }
-    if (High)
+    if (dwHigh)
         pFH->cb = KU32_MAX;
     else
         pFH->cb = dwLow;
@@ -502,10 +541,11 @@ static int  kDepDbFHUpdateSize(KDEPDBFH *pFH)
  *
  * @param   pFH             The file handle structure.
  * @param   pszFilename     The name of the file.
- * @param   fCreate         Whether we should create the file or not.
+ * @param   fWrite          Whether to open the file for writing, creating it
+ *                          if necessary.
  * @param   pfCreated       Where to return whether we created it or not.
  */
-static int  kDepDbFHOpen(KDEPDBFH *pFH, const char *pszFilename, KBOOL fCreate, KBOOL *pfCreated)
+static int  kDepDbFHOpen(KDEPDBFH *pFH, const char *pszFilename, KBOOL fWrite, KBOOL *pfCreated)
 {
     int                 rc;
 #if K_OS == K_OS_WINDOWS
@@ -513,25 +553,29 @@ static int  kDepDbFHOpen(KDEPDBFH *pFH, const char *pszFilename, KBOOL fCreate,
 
     SecAttr.bInheritHandle = FALSE;
     SecAttr.lpSecurityDescriptor = NULL;
-    SecAttr.nLength = 0;
+    SecAttr.nLength = sizeof(SecAttr);
     pFH->cb = 0;
+    pFH->fWrite = fWrite;
     SetLastError(0);
-    pFH->hFile = CreateFile(pszFilename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, &SecAttr,
-                            fCreate ? OPEN_ALWAYS : OPEN_EXISTING, 0, NULL);
+    pFH->hFile = CreateFile(pszFilename, fWrite ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, &SecAttr,
+                            fWrite ? OPEN_ALWAYS : OPEN_EXISTING, 0, NULL);
     if (pFH->hFile == INVALID_HANDLE_VALUE)
-        return GetLastError();
+        return GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_PATH_NOT_FOUND
+             ? ENOENT : (int)GetLastError();
     *pfCreated = GetLastError() == 0;
 
 #else
-    int fFlags = O_RDWR;
+    int fFlags = fWrite ? O_RDWR : O_RDONLY;
 # ifdef O_BINARY
     fFlags |= O_BINARY;
 # endif
     pFH->cb = 0;
+    pFH->fWrite = fWrite;
     pFH->fd = open(pszFilename, fFlags, 0);
     if (pFH->fd >= 0)
         *pfCreated = K_FALSE;
-    else if (!fCreate)
+    else if (!fWrite)
         return errno;
     else
     {
@@ -579,44 +623,9 @@ static int  kDepDbFHClose(KDEPDBFH *pFH)
     return 0;
 }
 
-/**
- * Writes to a file.
- *
- * @returns 0 on success. Some non-zero native error code on failure.
- *
- * @param   pFH         The file handle structure.
- * @param   off         The offset into the file to start writing at.
- * @param   pvBuf       What to write.
- * @param   cbBuf       How much to write.
- */
-static int  kDepDbFHWriteAt(KDEPDBFH *pFH, KU32 off, void const *pvBuf, KSIZE cbBuf)
-{
-#if K_OS == K_OS_WINDOWS
-    ULONG cbWritten;
-
-    if (SetFilePointer(pFH->hFile, off, NULL, FILE_CURRENT) == INVALID_SET_FILE_POINTER)
-        return GetLastError();
-
-    if (!WriteFile(pFH->hFile, pvBuf, cbBuf, &cbWritten, NULL))
-        return GetLastError();
-    if (cbWritten != cbBuf)
-        return -1;
-
-#else
-    ssize_t cbWritten;
-    if (lseek(pFH->fd, off, SEEK_SET) == -1)
-        return errno;
-    errno = 0;
-    cbWritten = write(pFH->fd, pvBuf, cbBuf);
-    if ((size_t)cbWritten != cbBuf)
-        return errno ? errno : EIO;
-#endif
-    return kDepDbFHUpdateSize(pFH);
-}
-
 
 /**
- * Creates a memory mapping of the file.
+ * Creates a memory mapping of the whole file.
  *
  * @returns 0 on success. Some non-zero native error code on failure.
  *
@@ -625,23 +634,44 @@ static int  kDepDbFHWriteAt(KDEPDBFH *pFH, KU32 off, void const *pvBuf, KSIZE cb
  */
 static int  kDepDbFHMap(KDEPDBFH *pFH, void **ppvMap)
 {
+    if (!pFH->cb || pFH->cb == KU32_MAX)
+    {
+        *ppvMap = NULL;
+        return EINVAL;
+    }
 #if K_OS == K_OS_WINDOWS
-    *ppvMap = NULL;
-    return -1;
+    pFH->hMapObj = CreateFileMapping(pFH->hFile, NULL, pFH->fWrite ? PAGE_READWRITE : PAGE_READONLY, 0, pFH->cb, NULL);
+    if (!pFH->hMapObj)
+    {
+        *ppvMap = NULL;
+        return GetLastError();
+    }
+    *ppvMap = MapViewOfFile(pFH->hMapObj, pFH->fWrite ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, pFH->cb);
+    if (!*ppvMap)
+    {
+        int rc = GetLastError();
+        CloseHandle(pFH->hMapObj);
+        pFH->hMapObj = NULL;
+        return rc;
+    }
 #else
-    *ppvMap = mmap(NULL, pFH->cb, PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, pFH->fd, 0);
+    *ppvMap = mmap(NULL, pFH->cb, pFH->fWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_FILE | MAP_SHARED, pFH->fd, 0);
     if (*ppvMap == (void *)-1)
     {
         *ppvMap = NULL;
         return errno;
     }
 #endif
+    pFH->cbMapped = pFH->cb;
     return 0;
 }
 
 
 /**
- * Flushes and destroys a memory of the file.
+ * Destroys a memory mapping of the file.
+ *
+ * The mapping is shared, so there is no need to flush it for other processes
+ * to see the changes.
  *
  * @returns 0 on success. Some non-zero native error code on failure.
  *
@@ -651,48 +681,157 @@ static int  kDepDbFHMap(KDEPDBFH *pFH, void **ppvMap)
  */
 static int  kDepDbFHUnmap(KDEPDBFH *pFH, void **ppvMap)
 {
+    if (!*ppvMap)
+        return 0;
 #if K_OS == K_OS_WINDOWS
-    return -1;
+    if (!UnmapViewOfFile(*ppvMap))
+        return GetLastError();
+    CloseHandle(pFH->hMapObj);
+    pFH->hMapObj = NULL;
 #else
-    if (msync(*ppvMap, pFH->cb, MS_SYNC) == -1)
-        return errno;
-    if (munmap(*ppvMap, pFH->cb) == -1)
+    if (munmap(*ppvMap, pFH->cbMapped) == -1)
         return errno;
-    *ppvMap = NULL;
 #endif
+    *ppvMap = NULL;
+    pFH->cbMapped = 0;
     return 0;
 }
 
 
 /**
- * Grows the memory mapping of the file.
+ * Grows the file and the memory mapping of it.
  *
- * The content of the new space is undefined.
+ * The content of the new space is zero.
  *
  * @returns 0 on success. Some non-zero native error code on failure.
  *
  * @param   pFH         The file handle structure.
- * @param   cbNew       The new mapping size.
+ * @param   cbNew       The new file and mapping size.
  * @param   ppvMap      The pointer to the mapping pointer. This may change and
  *                      may be set to NULL on failure.
  */
 static int  kDepDbFHGrow(KDEPDBFH *pFH, KSIZE cbNew, void **ppvMap)
 {
+    int rc;
 #if K_OS == K_OS_WINDOWS
-    return -1;
-#else
-    if ((KU32)cbNew != cbNew)
+    LARGE_INTEGER offNew;
+#endif
+
+    if ((KU32)cbNew != cbNew || cbNew == KU32_MAX)
         return ERANGE;
     if (cbNew <= pFH->cb)
         return 0;
 
-    if (munmap(*ppvMap, pFH->cb) == -1)
+    rc = kDepDbFHUnmap(pFH, ppvMap);
+    if (rc)
+        return rc;
+
+#if K_OS == K_OS_WINDOWS
+    offNew.QuadPart = cbNew;
+    if (   !SetFilePointerEx(pFH->hFile, offNew, NULL, FILE_BEGIN)
+        || !SetEndOfFile(pFH->hFile))
+        return GetLastError();
+#else
+    if (ftruncate(pFH->fd, cbNew) == -1)
         return errno;
-    *ppvMap = NULL;
+#endif
 
-    pFH->cb = cbNew;
+    pFH->cb = (KU32)cbNew;
     return kDepDbFHMap(pFH, ppvMap);
+}
+
+
+/**
+ * Remaps the file if it has changed size since it was mapped.
+ *
+ * @returns 0 on success. Some non-zero native error code on failure.
+ *
+ * @param   pFH         The file handle structure.
+ * @param   ppvMap      The pointer to the mapping pointer.
+ */
+static int  kDepDbFHRemap(KDEPDBFH *pFH, void **ppvMap)
+{
+    int rc = kDepDbFHUpdateSize(pFH);
+    if (!rc && (pFH->cb != pFH->cbMapped || !*ppvMap))
+    {
+        rc = kDepDbFHUnmap(pFH, ppvMap);
+        if (!rc)
+            rc = kDepDbFHMap(pFH, ppvMap);
+    }
+    return rc;
+}
+
+
+/**
+ * Locks the file, waiting for the lock to become available.
+ *
+ * The lock is associated with the open file (not the process), so different
+ * handles to the same file will exclude one another also within a process.
+ *
+ * @returns 0 on success. Some non-zero native error code on failure.
+ *
+ * @param   pFH         The file handle structure.
+ * @param   fExclusive  Whether to take an exclusive (write) or shared (read)
+ *                      lock.
+ */
+static int  kDepDbFHLock(KDEPDBFH *pFH, KBOOL fExclusive)
+{
+#if K_OS == K_OS_WINDOWS
+    OVERLAPPED Overlapped;
+
+    memset(&Overlapped, 0, sizeof(Overlapped));
+    if (!LockFileEx(pFH->hFile, fExclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &Overlapped))
+        return GetLastError();
+#elif defined(LOCK_EX)
+    while (flock(pFH->fd, fExclusive ? LOCK_EX : LOCK_SH) != 0)
+        if (errno != EINTR)
+            return errno;
+#else
+    struct flock Lock;
+
+    memset(&Lock, 0, sizeof(Lock));
+    Lock.l_type   = fExclusive ? F_WRLCK : F_RDLCK;
+    Lock.l_whence = SEEK_SET;
+    Lock.l_start  = 0;
+    Lock.l_len    = 1;
+    while (fcntl(pFH->fd, F_SETLKW, &Lock) != 0)
+        if (errno != EINTR)
+            return errno;
+#endif
+    return 0;
+}
+
+
+/**
+ * Unlocks the file.
+ *
+ * @returns 0 on success. Some non-zero native error code on failure.
+ *
+ * @param   pFH         The file handle structure.
+ */
+static int  kDepDbFHUnlock(KDEPDBFH *pFH)
+{
+#if K_OS == K_OS_WINDOWS
+    OVERLAPPED Overlapped;
+
+    memset(&Overlapped, 0, sizeof(Overlapped));
+    if (!UnlockFileEx(pFH->hFile, 0, 1, 0, &Overlapped))
+        return GetLastError();
+#elif defined(LOCK_EX)
+    if (flock(pFH->fd, LOCK_UN) != 0)
+        return errno;
+#else
+    struct flock Lock;
+
+    memset(&Lock, 0, sizeof(Lock));
+    Lock.l_type   = F_UNLCK;
+    Lock.l_whence = SEEK_SET;
+    Lock.l_start  = 0;
+    Lock.l_len    = 1;
+    if (fcntl(pFH->fd, F_SETLK, &Lock) != 0)
+        return errno;
 #endif
+    return 0;
 }
 
 
@@ -779,6 +918,128 @@ static KU32 kDepDbHashString(const char *pszString, size_t cchString)
 }
 
 
+/**
+ * Rebuilds a hash table with twice the number of entries.
+ *
+ * This gets rid of all the deleted entries as well.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   pFH             The handle of the hash file.
+ * @param   ppHash          Pointer to the hash file mapping pointer.
+ * @param   pfnHashValue    Callback for getting the hash of a value.
+ */
+static int kDepDbHashReHash(PKDEPDB pDb, KDEPDBFH *pFH, KDEPDBHASH **ppHash, FNKDEPDBHASHVALUE *pfnHashValue)
+{
+    KDEPDBHASH     *pHash       = *ppHash;
+    KU32 const      cEntriesOld = K_LE2H_U32(pHash->cEntries);
+    KU32           *pauOld;
+    KU32            cEntriesNew;
+    KU32            cCollisions = 0;
+    KU32            cUsed       = 0;
+    KU32            i;
+    int             rc;
+
+    /*
+     * Calc the size of the new hash table.
+     */
+    if (cEntriesOld >= KU32_C(0x20000000))
+        return ERANGE;
+    cEntriesNew = KDEPDB_HASH_INITIAL_ENTRIES;
+    while (cEntriesNew <= cEntriesOld)
+        cEntriesNew <<= 1;
+
+    /*
+     * Save the old table, grow the file and populate the new table.
+     */
+    pauOld = kDepDbAlloc(cEntriesOld * sizeof(KU32));
+    if (!pauOld)
+        return ENOMEM;
+    memcpy(pauOld, pHash->auEntries, cEntriesOld * sizeof(KU32));
+
+    rc = kDepDbFHGrow(pFH, K_OFFSETOF(KDEPDBHASH, auEntries) + cEntriesNew * sizeof(KU32), (void **)ppHash);
+    if (!rc)
+    {
+        pHash = *ppHash;
+        for (i = 0; i < cEntriesNew; i++)
+            pHash->auEntries[i] = K_H2LE_U32(KDEPDBHASH_UNUSED);
+
+        for (i = 0; i < cEntriesOld; i++)
+        {
+            KU32 const uValue = K_LE2H_U32(pauOld[i]);
+            if (uValue < KDEPDBHASH_END)
+            {
+                KU32 iHash = pfnHashValue(pDb, uValue) % cEntriesNew;
+                while (pHash->auEntries[iHash] != K_H2LE_U32(KDEPDBHASH_UNUSED))
+                {
+                    iHash = (iHash + 1) % cEntriesNew;
+                    cCollisions++;
+                }
+                pHash->auEntries[iHash] = K_H2LE_U32(uValue);
+                cUsed++;
+            }
+        }
+
+        pHash->cEntries     = K_H2LE_U32(cEntriesNew);
+        pHash->cUsedEntries = K_H2LE_U32(cUsed);
+        pHash->cCollisions  = K_H2LE_U32(cCollisions);
+    }
+
+    kDepDbFree(pauOld);
+    return rc;
+}
+
+
+/**
+ * Checks if a hash table needs rebuilding after an insert and does so.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   pFH             The handle of the hash file.
+ * @param   ppHash          Pointer to the hash file mapping pointer.
+ * @param   pfnHashValue    Callback for getting the hash of a value.
+ */
+static int kDepDbHashMaybeReHash(PKDEPDB pDb, KDEPDBFH *pFH, KDEPDBHASH **ppHash, FNKDEPDBHASHVALUE *pfnHashValue)
+{
+    KDEPDBHASH const *pHash = *ppHash;
+    if (K_LE2H_U32(pHash->cUsedEntries) > K_LE2H_U32(pHash->cEntries) / 3 * 2)
+        return kDepDbHashReHash(pDb, pFH, ppHash, pfnHashValue);
+    return 0;
+}
+
+
+/**
+ * Checks that a hash table is sane.
+ *
+ * @returns K_TRUE if sane, K_FALSE if not.
+ * @param   pHash           The hash table mapping.
+ * @param   cbFile          The size of the hash file.
+ */
+static KBOOL kDepDbHashIsValid(KDEPDBHASH const *pHash, KU32 cbFile)
+{
+    KU32 const cEntries = K_LE2H_U32(pHash->cEntries);
+    return cbFile >= K_OFFSETOF(KDEPDBHASH, auEntries)
+        && cEntries > 0
+        && cEntries <= (cbFile - K_OFFSETOF(KDEPDBHASH, auEntries)) / sizeof(KU32);
+}
+
+
+/** Gets the string at the given string table index. */
+#define KDEPDB_STRTAB_STRING(pStrTab, iString) \
+    ((const char *)&(pStrTab)->pStrTab->aStrings[(iString)].szString[0])
+
+/** Gets the length of the string at the given string table index. */
+#define KDEPDB_STRTAB_LENGTH(pStrTab, iString) \
+    K_LE2H_U32((pStrTab)->pStrTab->aStrings[(iString)].cchString)
+
+
+/** FNKDEPDBHASHVALUE for the string table hash. */
+static KU32 kDepDbStrTabHashValue(PKDEPDB pDb, KU32 iString)
+{
+    return K_LE2H_U32(pDb->StrTab.pStrTab->aStrings[iString].uHash);
+}
+
+
 /***
  * Looks up a string in the string table.
  *
@@ -797,6 +1058,8 @@ static KU32 kDepDbStrTabLookupHashed(KDEPDBINTSTRTAB const *pStrTab, const char
     KDEPDBHASH const   *pHash      = pStrTab->pHash;
     KDEPDBSTRING const *paStrings  = &pStrTab->pStrTab->aStrings[0];
     KU32 const          iStringEnd = K_LE2H_U32(pStrTab->pStrTab->iStringEnd);
+    KU32 const          cEntries   = K_LE2H_U32(pHash->cEntries);
+    KU32                cLeft      = cEntries;
     KU32                iHash;
 
     /* sanity */
@@ -806,8 +1069,8 @@ static KU32 kDepDbStrTabLookupHashed(KDEPDBINTSTRTAB const *pStrTab, const char
     /*
      * Hash lookup of the string.
      */
-    iHash = uHash % pHash->cEntries;
-    for (;;)
+    iHash = uHash % cEntries;
+    while (cLeft-- > 0)
     {
         KU32 iString = K_LE2H_U32(pHash->auEntries[iHash]);
         if (iString < iStringEnd)
@@ -824,100 +1087,9 @@ static KU32 kDepDbStrTabLookupHashed(KDEPDBINTSTRTAB const *pStrTab, const char
             return KDEPDBG_STRTAB_IDX_ERROR;
 
         /* advance */
-        iHash = (iHash + 1) % pHash->cEntries;
-    }
-}
-
-
-/**
- * Doubles the hash table size and rehashes it.
- *
- * @returns 0 on success, -1 on failure.
- * @param   pStrTab         The string table.
- * @todo    Rebuild from string table, we'll be accessing it anyways.
- */
-static int kDepDbStrTabReHash(KDEPDBINTSTRTAB *pStrTab)
-{
-    KDEPDBSTRING const *paStrings   = &pStrTab->pStrTab->aStrings[0];
-    KU32 const          iStringEnd  = K_LE2H_U32(pStrTab->pStrTab->iStringEnd);
-    KDEPDBHASH         *pHash       = pStrTab->pHash;
-    KDEPDBHASH          HashHdr     = *pHash;
-    KU32               *pauNew;
-    KU32                cEntriesNew;
-    KU32                i;
-
-    /*
-     * Calc the size of the new hash table.
-     */
-    if (pHash->cEntries >= KU32_C(0x80000000))
-        return -1;
-    cEntriesNew = 1024;
-    while (cEntriesNew <= pHash->cEntries)
-        cEntriesNew <<= 1;
-
-    /*
-     * Allocate and initialize an empty hash table in memory.
-     */
-    pauNew = kDepDbAlloc(cEntriesNew * sizeof(KU32));
-    if (!pauNew)
-        return -1;
-    i = cEntriesNew;
-    while (i-- > 0)
-        pauNew[i] = KDEPDBHASH_UNUSED;
-
-    /*
-     * Popuplate the new table.
-     */
-    HashHdr.cEntries     = K_LE2H_U32(cEntriesNew);
-    HashHdr.cCollisions  = 0;
-    HashHdr.cUsedEntries = 0;
-    i = pHash->cEntries;
-    while (i-- > 0)
-    {
-        KU32 iString = K_LE2H_U32(pHash->auEntries[i]);
-        if (iString < iStringEnd)
-        {
-            KU32 iHash = (paStrings[iString].uHash % cEntriesNew);
-            if (pauNew[iHash] != K_H2LE_U32(KDEPDBHASH_UNUSED))
-            {
-                do
-                {
-                    iHash = (iHash + 1) % cEntriesNew;
-                    HashHdr.cCollisions++;
-                } while (pauNew[iHash] != K_H2LE_U32(KDEPDBHASH_UNUSED));
-            }
-            pauNew[iHash] = iString;
-            HashHdr.cUsedEntries++;
-        }
-        else if (   iString != KDEPDBHASH_UNUSED
-                 && iString != KDEPDBHASH_DELETED)
-        {
-            kDepDbFree(pauNew);
-            return -1;
-        }
-    }
-    HashHdr.cCollisions  = K_H2LE_U32(HashHdr.cCollisions);
-    HashHdr.cUsedEntries = K_H2LE_U32(HashHdr.cUsedEntries);
-
-    /*
-     * Unmap the hash, write the new hash table and map it again.
-     */
-    if (!kDepDbFHUnmap(&pStrTab->hHash, (void **)&pStrTab->pHash))
-    {
-        if (   !kDepDbFHWriteAt(&pStrTab->hHash, 0, &HashHdr, K_OFFSETOF(KDEPDBHASH, auEntries))
-            && !kDepDbFHWriteAt(&pStrTab->hHash, K_OFFSETOF(KDEPDBHASH, auEntries), pauNew, sizeof(pauNew[0]) * cEntriesNew))
-        {
-            kDepDbFree(pauNew);
-            pauNew = NULL;
-            if (!kDepDbFHMap(&pStrTab->hHash, (void **)&pStrTab->pHash))
-                return 0;
-        }
-        else
-            kDepDbFHWriteAt(&pStrTab->hHash, 0, "\0\0\0\0", 4); /* file is screwed, trash the magic. */
+        iHash = (iHash + 1) % cEntries;
     }
-
-    kDepDbFree(pauNew);
-    return -1;
+    return KDEPDBG_STRTAB_IDX_ERROR;
 }
 
 
@@ -929,17 +1101,20 @@ static int kDepDbStrTabReHash(KDEPDBINTSTRTAB *pStrTab)
  * @returns String index on success,
  * @retval  KDEPDBG_STRTAB_IDX_ERROR on I/O and inconsistency errors.
  *
- * @param   pStrTab     The string table.
+ * @param   pDb         The database (for rehashing).
  * @param   pszString   The string to add.
  * @param   cchStringIn The length of the string.
  * @param   uHash       The hash of the string.
  */
-static KU32 kDepDbStrTabAddHashed(KDEPDBINTSTRTAB *pStrTab, const char *pszString, size_t cchStringIn, KU32 uHash)
+static KU32 kDepDbStrTabAddHashed(PKDEPDB pDb, const char *pszString, size_t cchStringIn, KU32 uHash)
 {
+    KDEPDBINTSTRTAB    *pStrTab     = &pDb->StrTab;
     KU32 const          cchString   = (KU32)cchStringIn;
     KDEPDBHASH         *pHash       = pStrTab->pHash;
     KDEPDBSTRING       *paStrings   = &pStrTab->pStrTab->aStrings[0];
     KU32 const          iStringEnd  = K_LE2H_U32(pStrTab->pStrTab->iStringEnd);
+    KU32 const          cHashEntries = K_LE2H_U32(pHash->cEntries);
+    KU32                cLeft       = cHashEntries;
     KU32                iInsertAt   = KDEPDBHASH_UNUSED;
     KU32                cCollisions = 0;
     KU32                iHash;
@@ -948,16 +1123,18 @@ static KU32 kDepDbStrTabAddHashed(KDEPDBINTSTRTAB *pStrTab, const char *pszStrin
     KDEPDBSTRING       *pNewString;
 
     /* sanity */
-    if (cchString != cchStringIn)
-        return KDEPDBG_STRTAB_IDX_NOT_FOUND;
+    if (cchString != cchStringIn || cchString >= KU32_C(0x10000000))
+        return KDEPDBG_STRTAB_IDX_ERROR;
 
     /*
      * Hash lookup of the string, finding either an existing copy or where to
      * insert the new string at in the hash table.
      */
-    iHash = uHash % pHash->cEntries;
+    iHash = uHash % cHashEntries;
     for (;;)
     {
+        if (cLeft-- == 0)
+            return KDEPDBG_STRTAB_IDX_ERROR;
         iString = K_LE2H_U32(pHash->auEntries[iHash]);
         if (iString < iStringEnd)
         {
@@ -979,27 +1156,24 @@ static KU32 kDepDbStrTabAddHashed(KDEPDBINTSTRTAB *pStrTab, const char *pszStrin
 
         /* advance */
         cCollisions++;
-        iHash = (iHash + 1) % pHash->cEntries;
+        iHash = (iHash + 1) % cHashEntries;
     }
 
     /*
      * Add string to the string table.
      * The string table file is grown in 256KB increments and ensuring at least 64KB unused new space.
      */
-    cEntries = cchString + 1 <= sizeof(paStrings[0].szString)
-             ? 1
-             : (cchString + 1 - sizeof(paStrings[0].szString) + sizeof(KDEPDBSTRING) - 1) / sizeof(KDEPDBSTRING);
+    cEntries = KDEPDB_STRING_ENTRIES(cchString);
+    if (iStringEnd + cEntries >= KDEPDBG_STRTAB_IDX_END)
+        return KDEPDBG_STRTAB_IDX_ERROR;
     if (iStringEnd + cEntries > pStrTab->iStringAlloced)
     {
-        KSIZE cbNewSize      = K_ALIGN_Z((iStringEnd + cEntries) * sizeof(KDEPDBSTRING) + 64*1024, 256*1024);
-        KU32  iStringAlloced = (pStrTab->hStrTab.cb - K_OFFSETOF(KDEPDBSTRTAB, aStrings)) / sizeof(KDEPDBSTRING);
-        if (    iStringAlloced <= pStrTab->iStringAlloced
-            ||  iStringAlloced >= KDEPDBG_STRTAB_IDX_END
-            ||  iStringAlloced >= KDEPDBHASH_END)
-            return KDEPDBG_STRTAB_IDX_ERROR;
+        KSIZE cbNewSize = K_ALIGN_Z(  K_OFFSETOF(KDEPDBSTRTAB, aStrings)
+                                    + (KSIZE)(iStringEnd + cEntries) * sizeof(KDEPDBSTRING) + 64*1024,
+                                    KDEPDB_GROW_SIZE);
         if (kDepDbFHGrow(&pStrTab->hStrTab, cbNewSize, (void **)&pStrTab->pStrTab) != 0)
             return KDEPDBG_STRTAB_IDX_ERROR;
-        pStrTab->iStringAlloced = iStringAlloced;
+        pStrTab->iStringAlloced = (pStrTab->hStrTab.cb - K_OFFSETOF(KDEPDBSTRTAB, aStrings)) / sizeof(KDEPDBSTRING);
         paStrings = &pStrTab->pStrTab->aStrings[0];
     }
 
@@ -1014,11 +1188,11 @@ static KU32 kDepDbStrTabAddHashed(KDEPDBINTSTRTAB *pStrTab, const char *pszStrin
     /*
      * Insert hash table entry, rehash it if necessary.
      */
+    if (K_LE2H_U32(pHash->auEntries[iInsertAt]) == KDEPDBHASH_UNUSED)
+        pHash->cUsedEntries = K_H2LE_U32(K_LE2H_U32(pHash->cUsedEntries) + 1);
     pHash->auEntries[iInsertAt] = K_H2LE_U32(iStringEnd);
-    pHash->cUsedEntries = K_H2LE_U32(K_LE2H_U32(pHash->cUsedEntries) + 1);
     pHash->cCollisions  = K_H2LE_U32(K_LE2H_U32(pHash->cCollisions)  + cCollisions);
-    if (    K_LE2H_U32(pHash->cUsedEntries) > K_LE2H_U32(pHash->cEntries) / 3 * 2
-        &&  kDepDbStrTabReHash(pStrTab) != 0)
+    if (kDepDbHashMaybeReHash(pDb, &pStrTab->hHash, &pStrTab->pHash, kDepDbStrTabHashValue) != 0)
         return KDEPDBG_STRTAB_IDX_ERROR;
 
     return iStringEnd;
@@ -1033,55 +1207,1083 @@ static KU32 kDepDbStrTabLookupN(KDEPDBINTSTRTAB const *pStrTab, const char *pszS
 
 
 /** Wrapper for kDepDbStrTabAddHashed.  */
-static KU32 kDepDbStrTabAddN(KDEPDBINTSTRTAB *pStrTab, const char *pszString, size_t cchString)
+static KU32 kDepDbStrTabAdd(PKDEPDB pDb, const char *pszString)
 {
-    return kDepDbStrTabAddHashed(pStrTab, pszString, cchString, kDepDbHashString(pszString, cchString));
+    size_t const cchString = strlen(pszString);
+    return kDepDbStrTabAddHashed(pDb, pszString, cchString, kDepDbHashString(pszString, cchString));
 }
 
 
-/** Wrapper for kDepDbStrTabLookupHashed.  */
-static KU32 kDepDbStrTabLookup(KDEPDBINTSTRTAB const *pStrTab, const char *pszString)
+/**
+ * Opens one of the database files, creating and initializing the header if
+ * necessary.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @retval  ENOENT if the file doesn't exist and we're not allowed to create it.
+ * @retval  EINVAL if the file header is invalid.
+ *
+ * @param   pDb             The database.
+ * @param   pFH             The file handle.
+ * @param   ppvMap          Where to return the mapping.
+ * @param   pszFilenameBase The database filename base.
+ * @param   pszSuffix       The filename suffix.  The internal file name is
+ *                          the suffix without the leading dot.
+ * @param   cbInitial       The initial size of the file.
+ * @param   pfNew           Where to return whether the file was initialized
+ *                          (caller must initialize the content).
+ */
+static int kDepDbFileOpen(PKDEPDB pDb, KDEPDBFH *pFH, void **ppvMap, const char *pszFilenameBase,
+                          const char *pszSuffix, KU32 cbInitial, KBOOL *pfNew)
 {
-    return kDepDbStrTabLookupN(pStrTab, pszString, strlen(pszString));
-}
+    size_t const    cchFilenameBase = strlen(pszFilenameBase);
+    size_t const    cchSuffix       = strlen(pszSuffix);
+    const char     *pszName         = pszSuffix + 1;
+    char            szPath[4096];
+    KDEPDBHDR      *pHdr;
+    KBOOL           fCreated;
+    int             rc;
+
+    *pfNew  = K_FALSE;
+    *ppvMap = NULL;
 
+    if (cchFilenameBase + cchSuffix + 1 > sizeof(szPath))
+        return ENAMETOOLONG;
+    memcpy(szPath, pszFilenameBase, cchFilenameBase);
+    memcpy(&szPath[cchFilenameBase], pszSuffix, cchSuffix + 1);
 
-/** Wrapper for kDepDbStrTabAddHashed.  */
-static KU32 kDepDbStrTabAdd(KDEPDBINTSTRTAB *pStrTab, const char *pszString)
-{
-    return kDepDbStrTabAddN(pStrTab, pszString, strlen(pszString));
+    rc = kDepDbFHOpen(pFH, szPath, pDb->fWrite, &fCreated);
+    if (rc)
+        return rc;
+
+    /*
+     * New (or never initialized) file?
+     */
+    if (pFH->cb == 0)
+    {
+        if (!pDb->fWrite)
+            return ENOENT;
+        rc = kDepDbFHGrow(pFH, cbInitial, ppvMap);
+        if (rc)
+            return rc;
+        pHdr = (KDEPDBHDR *)*ppvMap;
+        memcpy(pHdr->szMagic, KDEPDBHDR_MAGIC, sizeof(pHdr->szMagic));
+        pHdr->uVerMajor = KDEPDBHDR_VERSION_MAJOR;
+        pHdr->uVerMinor = KDEPDBHDR_VERSION_MINOR;
+        strncpy((char *)pHdr->szName, pszName, sizeof(pHdr->szName));
+        *pfNew = K_TRUE;
+        return 0;
+    }
+
+    /*
+     * Existing file, check the header.
+     */
+    if (pFH->cb < sizeof(KDEPDBHDR))
+        return EINVAL;
+    rc = kDepDbFHMap(pFH, ppvMap);
+    if (rc)
+        return rc;
+    pHdr = (KDEPDBHDR *)*ppvMap;
+    if (    memcmp(pHdr->szMagic, KDEPDBHDR_MAGIC, sizeof(pHdr->szMagic))
+        ||  pHdr->uVerMajor != KDEPDBHDR_VERSION_MAJOR
+        ||  pHdr->uVerMinor != KDEPDBHDR_VERSION_MINOR
+        ||  strncmp((const char *)pHdr->szName, pszName, sizeof(pHdr->szName)))
+        return EINVAL;
+    return 0;
 }
 
 
 /**
- * Opens the string table files, creating them if necessary.
+ * Opens a hash table file, creating it if necessary.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   pFH             The file handle.
+ * @param   ppHash          Where to return the mapping.
+ * @param   pszFilenameBase The database filename base.
+ * @param   pszSuffix       The filename suffix.
  */
-static int kDepDbStrTabInit(KDEPDBINTSTRTAB *pStrTab, const char *pszFilenameBase)
+static int kDepDbHashInit(PKDEPDB pDb, KDEPDBFH *pFH, KDEPDBHASH **ppHash, const char *pszFilenameBase, const char *pszSuffix)
 {
-    size_t  cchFilenameBase = strlen(pszFilenameBase);
-    char    szPath[4096];
-    int     rc;
     KBOOL   fNew;
+    int     rc = kDepDbFileOpen(pDb, pFH, (void **)ppHash, pszFilenameBase, pszSuffix,
+                                K_OFFSETOF(KDEPDBHASH, auEntries) + KDEPDB_HASH_INITIAL_ENTRIES * sizeof(KU32), &fNew);
+    if (!rc && fNew)
+    {
+        KDEPDBHASH *pHash = *ppHash;
+        KU32        i;
+
+        pHash->cEntries     = K_H2LE_U32(KDEPDB_HASH_INITIAL_ENTRIES);
+        pHash->cUsedEntries = 0;
+        pHash->cCollisions  = 0;
+        for (i = 0; i < KDEPDB_HASH_INITIAL_ENTRIES; i++)
+            pHash->auEntries[i] = K_H2LE_U32(KDEPDBHASH_UNUSED);
+    }
+    return rc;
+}
 
-    /* Basic member init, so kDepDbStrTabTerm always works. */
-    pStrTab->pHash = NULL;
-    kDepDbFHInit(&pStrTab->hHash);
-    pStrTab->pStrTab = NULL;
-    kDepDbFHInit(&pStrTab->hStrTab);
-    pStrTab->iStringAlloced = 0;
-
-    /* check the length. */
-    if (cchFilenameBase + sizeof(".strtab.hash") > sizeof(szPath))
-        return -1;
+
+/**
+ * Opens the string table files, creating them if necessary.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   pszFilenameBase The database filename base.
+ */
+static int kDepDbStrTabInit(PKDEPDB pDb, const char *pszFilenameBase)
+{
+    KDEPDBINTSTRTAB    *pStrTab = &pDb->StrTab;
+    KBOOL               fNew;
+    int                 rc;
+
+    rc = kDepDbFileOpen(pDb, &pStrTab->hStrTab, (void **)&pStrTab->pStrTab, pszFilenameBase, ".strtab",
+                        KDEPDB_INITIAL_SIZE, &fNew);
+    if (!rc && fNew)
+    {
+        pStrTab->pStrTab->iStringEnd  = 0;
+        pStrTab->pStrTab->uGeneration = 0;
+    }
+    if (!rc)
+        rc = kDepDbHashInit(pDb, &pStrTab->hHash, &pStrTab->pHash, pszFilenameBase, ".strtab.hash");
+    return rc;
+}
+
+
+/**
+ * Opens the files of a data set, creating them if necessary.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   pSet            The data set.
+ * @param   pszFilenameBase The database filename base.
+ * @param   pszDir          The directory file suffix.
+ * @param   pszHash         The directory hash file suffix.
+ * @param   pszData         The data file suffix.
+ */
+static int kDepDbDataSetInit(PKDEPDB pDb, KDEPDBINTDATASET *pSet, const char *pszFilenameBase,
+                             const char *pszDir, const char *pszHash, const char *pszData)
+{
+    KBOOL   fNew;
+    int     rc;
+
+    rc = kDepDbFileOpen(pDb, &pSet->hDir, (void **)&pSet->pDir, pszFilenameBase, pszDir, KDEPDB_INITIAL_SIZE, &fNew);
+    if (!rc && fNew)
+    {
+        pSet->pDir->cEntries  = 0;
+        pSet->pDir->iFreeHead = K_H2LE_U32(KU32_MAX);
+    }
+    if (!rc)
+        rc = kDepDbHashInit(pDb, &pSet->hHash, &pSet->pHash, pszFilenameBase, pszHash);
+    if (!rc)
+    {
+        rc = kDepDbFileOpen(pDb, &pSet->hData, (void **)&pSet->pData, pszFilenameBase, pszData, KDEPDB_GROW_SIZE, &fNew);
+        if (!rc && fNew)
+        {
+            pSet->pData->cbBlock       = K_H2LE_U32(KDEPDB_DATA_BLOCK_SIZE);
+            pSet->pData->cBlocks       = K_H2LE_U32((sizeof(KDEPDBDATA) + KDEPDB_DATA_BLOCK_SIZE - 1) / KDEPDB_DATA_BLOCK_SIZE);
+            pSet->pData->cWastedBlocks = 0;
+        }
+    }
+    return rc;
+}
+
+
+/**
+ * Closes the files of a data set.
+ *
+ * @param   pSet            The data set.
+ */
+static void kDepDbDataSetTerm(KDEPDBINTDATASET *pSet)
+{
+    kDepDbFHUnmap(&pSet->hHash, (void **)&pSet->pHash);
+    kDepDbFHClose(&pSet->hHash);
+    kDepDbFHUnmap(&pSet->hDir, (void **)&pSet->pDir);
+    kDepDbFHClose(&pSet->hDir);
+    kDepDbFHUnmap(&pSet->hData, (void **)&pSet->pData);
+    kDepDbFHClose(&pSet->hData);
+}
+
+
+/**
+ * Validates the database headers against the file sizes.
+ *
+ * This is done whenever the mappings have been updated, so the rest of the
+ * code can trust the counts in the headers.
+ *
+ * @returns 0 if valid, EINVAL if not.
+ * @param   pDb             The database.
+ */
+static int kDepDbValidate(PKDEPDB pDb)
+{
+    KDEPDBINTSTRTAB const  *pStrTab = &pDb->StrTab;
+    KDEPDBINTDATASET const *pSet    = &pDb->DepSet;
+    KU32                    cbBlock;
+    KU32                    cBlocks;
+    KU32                    iFreeHead;
+
+    /* The string table. */
+    if (!kDepDbHashIsValid(pStrTab->pHash, pStrTab->hHash.cbMapped))
+        return EINVAL;
+    if (    pStrTab->hStrTab.cbMapped < K_OFFSETOF(KDEPDBSTRTAB, aStrings)
+        ||  K_LE2H_U32(pStrTab->pStrTab->iStringEnd)
+          > (pStrTab->hStrTab.cbMapped - K_OFFSETOF(KDEPDBSTRTAB, aStrings)) / sizeof(KDEPDBSTRING))
+        return EINVAL;
+
+    /* The directory. */
+    if (!kDepDbHashIsValid(pSet->pHash, pSet->hHash.cbMapped))
+        return EINVAL;
+    iFreeHead = K_LE2H_U32(pSet->pDir->iFreeHead);
+    if (    pSet->hDir.cbMapped < K_OFFSETOF(KDEPDBDIR, aEntries)
+        ||  K_LE2H_U32(pSet->pDir->cEntries)
+          > (pSet->hDir.cbMapped - K_OFFSETOF(KDEPDBDIR, aEntries)) / sizeof(KDEPDBDIRENTRY)
+        ||  (iFreeHead != KU32_MAX && iFreeHead >= K_LE2H_U32(pSet->pDir->cEntries)))
+        return EINVAL;
+
+    /* The data. */
+    if (pSet->hData.cbMapped < sizeof(KDEPDBDATA))
+        return EINVAL;
+    cbBlock = K_LE2H_U32(pSet->pData->cbBlock);
+    cBlocks = K_LE2H_U32(pSet->pData->cBlocks);
+    if (    cbBlock < sizeof(KDEPDBDATA)
+        ||  (cbBlock & 3)
+        ||  cBlocks == 0
+        ||  (KU64)cBlocks * cbBlock > pSet->hData.cbMapped
+        ||  K_LE2H_U32(pSet->pData->cWastedBlocks) >= cBlocks)
+        return EINVAL;
+
+    return 0;
+}
+
+
+/**
+ * Updates the mappings if any of the files have been changed by another
+ * process or thread since we last looked.
+ *
+ * Must be called while holding the lock.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ */
+static int kDepDbSync(PKDEPDB pDb)
+{
+    KDEPDBINTSTRTAB    *pStrTab = &pDb->StrTab;
+    KDEPDBINTDATASET   *pSet    = &pDb->DepSet;
+    int                 rc;
+
+    /* The string table never shrinks, so the header is always accessible. */
+    if (    pStrTab->pStrTab
+        &&  K_LE2H_U32(pStrTab->pStrTab->uGeneration) == pDb->uGeneration)
+        return 0;
+
+    rc = kDepDbFHRemap(&pStrTab->hStrTab, (void **)&pStrTab->pStrTab);
+    if (!rc)
+        rc = kDepDbFHRemap(&pStrTab->hHash, (void **)&pStrTab->pHash);
+    if (!rc)
+        rc = kDepDbFHRemap(&pSet->hDir, (void **)&pSet->pDir);
+    if (!rc)
+        rc = kDepDbFHRemap(&pSet->hHash, (void **)&pSet->pHash);
+    if (!rc)
+        rc = kDepDbFHRemap(&pSet->hData, (void **)&pSet->pData);
+    if (!rc)
+        rc = kDepDbValidate(pDb);
+    if (!rc)
+    {
+        pStrTab->iStringAlloced = (pStrTab->hStrTab.cb - K_OFFSETOF(KDEPDBSTRTAB, aStrings)) / sizeof(KDEPDBSTRING);
+        pDb->uGeneration = K_LE2H_U32(pStrTab->pStrTab->uGeneration);
+    }
+    else
+        pDb->uGeneration = KU32_MAX - 1; /* make sure we check again. */
+    return rc;
+}
+
+
+/**
+ * Locks the database.
+ *
+ * Recursive locking is allowed as long as an exclusive lock isn't requested
+ * while holding a shared one.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   fExclusive      Whether an exclusive lock (writing) is needed.
+ */
+static int kDepDbLock(PKDEPDB pDb, KBOOL fExclusive)
+{
+    int rc;
+
+    if (pDb->cLocks > 0)
+    {
+        if (fExclusive && !pDb->fExclusive)
+            return EDEADLK;
+        pDb->cLocks++;
+        return 0;
+    }
+
+    rc = kDepDbFHLock(&pDb->hLock, fExclusive);
+    if (!rc)
+    {
+        pDb->cLocks     = 1;
+        pDb->fExclusive = fExclusive;
+        rc = kDepDbSync(pDb);
+        if (rc)
+            kDepDbUnlock(pDb);
+    }
+    return rc;
+}
+
+
+/**
+ * Unlocks the database.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ */
+static int kDepDbUnlock(PKDEPDB pDb)
+{
+    assert(pDb->cLocks > 0);
+    if (--pDb->cLocks > 0)
+        return 0;
+    pDb->fExclusive = K_FALSE;
+    return kDepDbFHUnlock(&pDb->hLock);
+}
+
+
+/**
+ * Bumps the generation number after an update.
+ *
+ * Must be called while holding the exclusive lock.
+ *
+ * @param   pDb             The database.
+ */
+static void kDepDbBumpGeneration(PKDEPDB pDb)
+{
+    if (pDb->StrTab.pStrTab)
+    {
+        pDb->uGeneration = K_LE2H_U32(pDb->StrTab.pStrTab->uGeneration) + 1;
+        if (pDb->uGeneration >= KU32_MAX - 1)
+            pDb->uGeneration = 0;
+        pDb->StrTab.pStrTab->uGeneration = K_H2LE_U32(pDb->uGeneration);
+    }
+}
+
+
+/**
+ * Gets the current time for stamping entries.
+ *
+ * On Linux the coarse clock is used as that is what the file systems use for
+ * the modification times we are compared with.
+ *
+ * @returns Nanoseconds since 1970-01-01 UTC.
+ */
+static KU64 kDepDbNanoTimestamp(void)
+{
+#if K_OS == K_OS_WINDOWS
+    FILETIME    Now;
+    KU64        u64;
+    GetSystemTimeAsFileTime(&Now);
+    u64 = ((KU64)Now.dwHighDateTime << 32) | Now.dwLowDateTime;
+    return (u64 - KU64_C(116444736000000000)) * 100;
+#else
+    struct timespec Now;
+# ifdef CLOCK_REALTIME_COARSE
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &Now) != 0)
+# endif
+        clock_gettime(CLOCK_REALTIME, &Now);
+    return (KU64)Now.tv_sec * 1000000000 + Now.tv_nsec;
+#endif
+}
+
+
+/** FNKDEPDBHASHVALUE for directory hash tables. */
+static KU32 kDepDbDepSetHashValue(PKDEPDB pDb, KU32 iEntry)
+{
+    KU32 const iName = K_LE2H_U32(pDb->DepSet.pDir->aEntries[iEntry].iName);
+    return K_LE2H_U32(pDb->StrTab.pStrTab->aStrings[iName].uHash);
+}
+
+
+/**
+ * Looks up a directory entry.
+ *
+ * @returns Directory entry index.
+ * @retval  KDEPDBHASH_UNUSED if not found.
+ * @retval  KDEPDBHASH_END on internal inconsistency.
+ *
+ * @param   pSet            The data set.
+ * @param   iName           The string table index of the entry name.
+ * @param   uHash           The hash of the entry name.
+ * @param   piSlot          Where to return the hash table slot of the entry
+ *                          or, if not found, where to insert it.
+ */
+static KU32 kDepDbDirLookup(KDEPDBINTDATASET const *pSet, KU32 iName, KU32 uHash, KU32 *piSlot)
+{
+    KDEPDBHASH const   *pHash       = pSet->pHash;
+    KU32 const          cEntries    = K_LE2H_U32(pHash->cEntries);
+    KU32 const          cDirEntries = K_LE2H_U32(pSet->pDir->cEntries);
+    KU32                cLeft       = cEntries;
+    KU32                iInsertAt   = KDEPDBHASH_UNUSED;
+    KU32                iHash       = uHash % cEntries;
+
+    while (cLeft-- > 0)
+    {
+        KU32 const iEntry = K_LE2H_U32(pHash->auEntries[iHash]);
+        if (iEntry < cDirEntries)
+        {
+            if (K_LE2H_U32(pSet->pDir->aEntries[iEntry].iName) == iName)
+            {
+                *piSlot = iHash;
+                return iEntry;
+            }
+        }
+        else if (iEntry == KDEPDBHASH_UNUSED)
+        {
+            if (iInsertAt == KDEPDBHASH_UNUSED)
+                iInsertAt = iHash;
+            break;
+        }
+        else if (iEntry == KDEPDBHASH_DELETED)
+        {
+            if (iInsertAt == KDEPDBHASH_UNUSED)
+                iInsertAt = iHash;
+        }
+        else
+            return KDEPDBHASH_END;
+
+        /* advance */
+        iHash = (iHash + 1) % cEntries;
+    }
+
+    if (iInsertAt == KDEPDBHASH_UNUSED)
+        return KDEPDBHASH_END;
+    *piSlot = iInsertAt;
+    return KDEPDBHASH_UNUSED;
+}
+
+
+/**
+ * Allocates a directory entry.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pSet            The data set.
+ * @param   piEntry         Where to return the entry index.
+ */
+static int kDepDbDirAllocEntry(KDEPDBINTDATASET *pSet, KU32 *piEntry)
+{
+    KDEPDBDIR  *pDir   = pSet->pDir;
+    KU32        iEntry = K_LE2H_U32(pDir->iFreeHead);
+    int         rc;
+
+    /* Recycle a free entry. */
+    if (iEntry != KU32_MAX)
+    {
+        KU32 const iNext = K_LE2H_U32(pDir->aEntries[iEntry].iStartBlock);
+        if (iNext != KU32_MAX && iNext >= K_LE2H_U32(pDir->cEntries))
+            return EIO;
+        pDir->iFreeHead = K_H2LE_U32(iNext);
+        *piEntry = iEntry;
+        return 0;
+    }
+
+    /* Append a new one, growing the file if necessary. */
+    iEntry = K_LE2H_U32(pDir->cEntries);
+    if (iEntry >= KDEPDBHASH_END)
+        return ERANGE;
+    if (K_OFFSETOF(KDEPDBDIR, aEntries) + (KSIZE)(iEntry + 1) * sizeof(KDEPDBDIRENTRY) > pSet->hDir.cb)
+    {
+        rc = kDepDbFHGrow(&pSet->hDir,
+                          K_ALIGN_Z(K_OFFSETOF(KDEPDBDIR, aEntries) + (KSIZE)(iEntry + 1) * sizeof(KDEPDBDIRENTRY),
+                                    KDEPDB_GROW_SIZE),
+                          (void **)&pSet->pDir);
+        if (rc)
+            return rc;
+        pDir = pSet->pDir;
+    }
+    pDir->cEntries = K_H2LE_U32(iEntry + 1);
+    *piEntry = iEntry;
+    return 0;
+}
+
+
+/**
+ * Compacts the data file by moving all the streams down to the start of the
+ * file, reclaiming all wasted blocks.
+ *
+ * The file isn't shrunk, the space is simply reused by later allocations.
+ *
+ * @param   pSet            The data set.
+ */
+static void kDepDbDataCompact(KDEPDBINTDATASET *pSet)
+{
+    KU8 * const         pbData      = (KU8 *)pSet->pData;
+    KU32 const          cbBlock     = K_LE2H_U32(pSet->pData->cbBlock);
+    KU32 const          cBlocks     = K_LE2H_U32(pSet->pData->cBlocks);
+    KU32 const          iFirst      = (sizeof(KDEPDBDATA) + cbBlock - 1) / cbBlock;
+    KU32 const          cDirEntries = K_LE2H_U32(pSet->pDir->cEntries);
+    KDEPDBDIRENTRY     *paEntries   = &pSet->pDir->aEntries[0];
+    KU32                cInUse      = 0;
+    KU32                iNext;
+    KU32                i;
+    KU8                *pbTmp;
+
+    /*
+     * Count and validate the blocks in use first.
+     */
+    for (i = 0; i < cDirEntries; i++)
+        if (K_LE2H_U32(paEntries[i].iName) != KDEPDBG_STRTAB_IDX_INVALID)
+        {
+            KU32 const iStart = K_LE2H_U32(paEntries[i].iStartBlock);
+            KU32 const cEntryBlocks = K_LE2H_U32(paEntries[i].cBlocks);
+            if (!cEntryBlocks)
+                continue;
+            if (    iStart < iFirst
+                ||  iStart >= cBlocks
+                ||  cEntryBlocks > cBlocks - iStart)
+                return;
+            cInUse += cEntryBlocks;
+        }
+    if (cInUse > cBlocks - iFirst)
+        return;
+
+    /*
+     * Copy the streams into a temporary buffer in directory order and then
+     * back into the file.
+     */
+    pbTmp = kDepDbAlloc((KSIZE)cInUse * cbBlock + 1);
+    if (!pbTmp)
+        return;
+    iNext = iFirst;
+    for (i = 0; i < cDirEntries; i++)
+        if (   K_LE2H_U32(paEntries[i].iName) != KDEPDBG_STRTAB_IDX_INVALID
+            && K_LE2H_U32(paEntries[i].cBlocks) != 0)
+        {
+            KU32 const cEntryBlocks = K_LE2H_U32(paEntries[i].cBlocks);
+            memcpy(&pbTmp[(KSIZE)(iNext - iFirst) * cbBlock],
+                   &pbData[(KSIZE)K_LE2H_U32(paEntries[i].iStartBlock) * cbBlock],
+                   (KSIZE)cEntryBlocks * cbBlock);
+            paEntries[i].iStartBlock = K_H2LE_U32(iNext);
+            iNext += cEntryBlocks;
+        }
+    memcpy(&pbData[(KSIZE)iFirst * cbBlock], pbTmp, (KSIZE)cInUse * cbBlock);
+    kDepDbFree(pbTmp);
+
+    pSet->pData->cBlocks       = K_H2LE_U32(iNext);
+    pSet->pData->cWastedBlocks = 0;
+}
+
+
+/**
+ * Allocates a sequence of data blocks at the end of the data file.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pSet            The data set.
+ * @param   cBlocks         The number of blocks to allocate.
+ * @param   piStartBlock    Where to return the index of the first block.
+ */
+static int kDepDbDataAlloc(KDEPDBINTDATASET *pSet, KU32 cBlocks, KU32 *piStartBlock)
+{
+    KU32 const  cbBlock = K_LE2H_U32(pSet->pData->cbBlock);
+    KU32        cBlocksUsed;
+    KU32        cWasted;
+    int         rc;
+
+    /* Compact the file when more than half of it is wasted. */
+    cBlocksUsed = K_LE2H_U32(pSet->pData->cBlocks);
+    cWasted     = K_LE2H_U32(pSet->pData->cWastedBlocks);
+    if (cWasted >= KDEPDB_COMPACT_MIN_BLOCKS && cWasted > cBlocksUsed / 2)
+    {
+        kDepDbDataCompact(pSet);
+        cBlocksUsed = K_LE2H_U32(pSet->pData->cBlocks);
+    }
+
+    /* Grow the file if necessary. */
+    if (cBlocks >= KDEPDB_BLOCK_IDX_END - cBlocksUsed)
+        return ERANGE;
+    if ((KU64)(cBlocksUsed + cBlocks) * cbBlock > pSet->hData.cb)
+    {
+        KU64 const cbNew = K_ALIGN_Z((KU64)(cBlocksUsed + cBlocks) * cbBlock + 64*1024, KDEPDB_GROW_SIZE);
+        if (cbNew >= KU32_MAX)
+            return ERANGE;
+        rc = kDepDbFHGrow(&pSet->hData, (KSIZE)cbNew, (void **)&pSet->pData);
+        if (rc)
+            return rc;
+    }
+
+    *piStartBlock = cBlocksUsed;
+    pSet->pData->cBlocks = K_H2LE_U32(cBlocksUsed + cBlocks);
+    return 0;
+}
+
+
+/**
+ * Stores a stream in a data set, replacing any existing one with the same name.
+ *
+ * Must be called while holding the exclusive lock.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database.
+ * @param   pSet            The data set.
+ * @param   pszName         The stream name.
+ * @param   pvData          The stream data.
+ * @param   cbData          The size of the stream data.
+ */
+static int kDepDbDataSetPut(PKDEPDB pDb, KDEPDBINTDATASET *pSet, const char *pszName, const void *pvData, KU32 cbData)
+{
+    KU32 const          iName = kDepDbStrTabAdd(pDb, pszName);
+    KU32                uHash;
+    KU32                iSlot;
+    KU32                iEntry;
+    KU32                cbBlock;
+    KU32                cBlocks;
+    KU32                iStartBlock;
+    KDEPDBDIRENTRY     *pEntry;
+    int                 rc;
+
+    if (iName >= KDEPDBG_STRTAB_IDX_END)
+        return EIO;
+    uHash = K_LE2H_U32(pDb->StrTab.pStrTab->aStrings[iName].uHash);
+
+    /*
+     * Find the directory entry, creating a new one if necessary.
+     */
+    iEntry = kDepDbDirLookup(pSet, iName, uHash, &iSlot);
+    if (iEntry == KDEPDBHASH_END)
+        return EIO;
+    if (iEntry == KDEPDBHASH_UNUSED)
+    {
+        rc = kDepDbDirAllocEntry(pSet, &iEntry);
+        if (rc)
+            return rc;
+        pEntry = &pSet->pDir->aEntries[iEntry];
+        pEntry->iName       = K_H2LE_U32(iName);
+        pEntry->cbData      = 0;
+        pEntry->cBlocks     = 0;
+        pEntry->iStartBlock = K_H2LE_U32(KU32_MAX);
+
+        if (K_LE2H_U32(pSet->pHash->auEntries[iSlot]) == KDEPDBHASH_UNUSED)
+            pSet->pHash->cUsedEntries = K_H2LE_U32(K_LE2H_U32(pSet->pHash->cUsedEntries) + 1);
+        pSet->pHash->auEntries[iSlot] = K_H2LE_U32(iEntry);
+        rc = kDepDbHashMaybeReHash(pDb, &pSet->hHash, &pSet->pHash, kDepDbDepSetHashValue);
+        if (rc)
+            return rc;
+    }
+    pEntry = &pSet->pDir->aEntries[iEntry];
+
+    /*
+     * Reuse the current blocks if the new data fits, otherwise waste them
+     * and allocate new ones at the end.
+     */
+    cbBlock = K_LE2H_U32(pSet->pData->cbBlock);
+    cBlocks = (cbData + cbBlock - 1) / cbBlock;
+    if (K_LE2H_U32(pEntry->cBlocks) >= cBlocks && K_LE2H_U32(pEntry->cBlocks) > 0)
+        iStartBlock = K_LE2H_U32(pEntry->iStartBlock);
+    else
+    {
+        if (pEntry->cBlocks)
+        {
+            pSet->pData->cWastedBlocks = K_H2LE_U32(K_LE2H_U32(pSet->pData->cWastedBlocks) + K_LE2H_U32(pEntry->cBlocks));
+            pEntry->cbData      = 0;
+            pEntry->cBlocks     = 0;
+            pEntry->iStartBlock = K_H2LE_U32(KU32_MAX);
+        }
+        rc = kDepDbDataAlloc(pSet, cBlocks, &iStartBlock);
+        if (rc)
+            return rc;
+        pEntry->cBlocks = K_H2LE_U32(cBlocks);
+    }
+    if ((KU64)(iStartBlock + cBlocks) * cbBlock > pSet->hData.cb)
+        return EIO;
+
+    memcpy((KU8 *)pSet->pData + (KSIZE)iStartBlock * cbBlock, pvData, cbData);
+    pEntry->iStartBlock = K_H2LE_U32(iStartBlock);
+    pEntry->cbData      = K_H2LE_U32(cbData);
+    return 0;
+}
+
+
+/**
+ * Finds a stream in a data set.
+ *
+ * Must be called while holding the lock.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @retval  ENOENT if not found.
+ * @param   pDb             The database.
+ * @param   pSet            The data set.
+ * @param   pszName         The stream name.
+ * @param   cchName         The length of the stream name.
+ * @param   piEntry         Where to return the directory entry index.
+ * @param   piSlot          Where to return the hash table slot.
+ */
+static int kDepDbDataSetFind(PKDEPDB pDb, KDEPDBINTDATASET const *pSet, const char *pszName, size_t cchName,
+                             KU32 *piEntry, KU32 *piSlot)
+{
+    KU32 const iName = kDepDbStrTabLookupN(&pDb->StrTab, pszName, cchName);
+    KU32       iEntry;
+
+    if (iName >= KDEPDBG_STRTAB_IDX_END)
+        return iName == KDEPDBG_STRTAB_IDX_NOT_FOUND ? ENOENT : EIO;
+
+    iEntry = kDepDbDirLookup(pSet, iName, K_LE2H_U32(pDb->StrTab.pStrTab->aStrings[iName].uHash), piSlot);
+    if (iEntry >= KDEPDBHASH_END)
+        return iEntry == KDEPDBHASH_UNUSED ? ENOENT : EIO;
+    *piEntry = iEntry;
+    return 0;
+}
+
+
+/**
+ * Opens a dependency database, creating it if necessary and allowed.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @retval  ENOENT if the database doesn't exist and @a fWrite is clear.
+ *
+ * @param   ppDb            Where to return the database handle.
+ * @param   pszFilenameBase The database filename base.  The various database
+ *                          files are created by appending suffixes to this.
+ * @param   fWrite          Whether the database will be modified.
+ */
+int kDepDbOpen(PKDEPDB *ppDb, const char *pszFilenameBase, int fWrite)
+{
+    PKDEPDB     pDb;
+    char        szPath[4096];
+    size_t      cchFilenameBase = strlen(pszFilenameBase);
+    KBOOL       fCreated;
+    int         rc;
+
+    *ppDb = NULL;
+    if (cchFilenameBase + sizeof(".lock") > sizeof(szPath))
+        return ENAMETOOLONG;
+
+    pDb = (PKDEPDB)kDepDbAlloc(sizeof(*pDb));
+    if (!pDb)
+        return ENOMEM;
+    memset(pDb, 0, sizeof(*pDb));
+    kDepDbFHInit(&pDb->StrTab.hHash);
+    kDepDbFHInit(&pDb->StrTab.hStrTab);
+    kDepDbFHInit(&pDb->DepSet.hHash);
+    kDepDbFHInit(&pDb->DepSet.hDir);
+    kDepDbFHInit(&pDb->DepSet.hData);
+    kDepDbFHInit(&pDb->hLock);
+    pDb->fWrite = fWrite != 0;
 
     /*
-     * Open the string table first.
+     * Open and lock the lock file.  The lock is exclusive when writing since
+     * we may have to create and initialize the other files.
      */
     memcpy(szPath, pszFilenameBase, cchFilenameBase);
-    memcpy(&szPath[cchFilenameBase], ".strtab", sizeof(".strtab"));
-    rc = kDepDbFHOpen(&pStrTab->hStrTab, szPath, K_TRUE, &fNew);
+    memcpy(&szPath[cchFilenameBase], ".lock", sizeof(".lock"));
+    rc = kDepDbFHOpen(&pDb->hLock, szPath, pDb->fWrite, &fCreated);
+    if (!rc)
+        rc = kDepDbFHLock(&pDb->hLock, pDb->fWrite);
+    if (!rc)
+    {
+        pDb->cLocks     = 1;
+        pDb->fExclusive = pDb->fWrite;
+
+        rc = kDepDbStrTabInit(pDb, pszFilenameBase);
+        if (!rc)
+            rc = kDepDbDataSetInit(pDb, &pDb->DepSet, pszFilenameBase, ".deps.dir", ".deps.hash", ".deps.data");
+        if (!rc)
+            rc = kDepDbValidate(pDb);
+        if (!rc)
+        {
+            pDb->StrTab.iStringAlloced = (pDb->StrTab.hStrTab.cb - K_OFFSETOF(KDEPDBSTRTAB, aStrings)) / sizeof(KDEPDBSTRING);
+            pDb->uGeneration = K_LE2H_U32(pDb->StrTab.pStrTab->uGeneration);
+        }
 
+        kDepDbUnlock(pDb);
+    }
 
-    return -1;
+    if (!rc)
+    {
+        *ppDb = pDb;
+        return 0;
+    }
+    kDepDbClose(pDb);
+    return rc;
 }
 
+
+/**
+ * Closes a dependency database.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database handle.  NULL is ignored.
+ */
+int kDepDbClose(PKDEPDB pDb)
+{
+    if (!pDb)
+        return 0;
+    assert(pDb->cLocks == 0);
+
+    kDepDbDataSetTerm(&pDb->DepSet);
+    kDepDbFHUnmap(&pDb->StrTab.hHash, (void **)&pDb->StrTab.pHash);
+    kDepDbFHClose(&pDb->StrTab.hHash);
+    kDepDbFHUnmap(&pDb->StrTab.hStrTab, (void **)&pDb->StrTab.pStrTab);
+    kDepDbFHClose(&pDb->StrTab.hStrTab);
+    kDepDbFHClose(&pDb->hLock);
+    kDepDbFree(pDb);
+    return 0;
+}
+
+
+/**
+ * Stores the rules of a dependency file in the database.
+ *
+ * Any existing entry with the same name is replaced.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @param   pDb             The database handle.
+ * @param   pszName         The entry name, i.e. the dependency file name.
+ * @param   paRules         The rules.
+ * @param   cRules          The number of rules.
+ */
+int kDepDbPut(PKDEPDB pDb, const char *pszName, KDEPDBRULE const *paRules, unsigned cRules)
+{
+    KU32       *pau;
+    KU32        cu;
+    KU32        iu;
+    unsigned    iRule;
+    unsigned    iDep;
+    int         rc;
+
+    if (!pDb->fWrite)
+        return EACCES;
+
+    /*
+     * Calc the stream size and allocate a buffer for it.
+     */
+    cu = 3;
+    for (iRule = 0; iRule < cRules; iRule++)
+    {
+        if (paRules[iRule].cDeps >= KU32_C(0x04000000) - cu)
+            return ERANGE;
+        cu += 2 + paRules[iRule].cDeps;
+    }
+    pau = (KU32 *)kDepDbAlloc(cu * sizeof(KU32));
+    if (!pau)
+        return ENOMEM;
+
+    /*
+     * Translate the strings to string table indexes and store the stream.
+     */
+    rc = kDepDbLock(pDb, K_TRUE);
+    if (!rc)
+    {
+        KU64 const nsNow = kDepDbNanoTimestamp();
+        pau[0] = K_H2LE_U32((KU32)nsNow);
+        pau[1] = K_H2LE_U32((KU32)(nsNow >> 32));
+        pau[2] = K_H2LE_U32(cRules);
+        iu = 3;
+        for (iRule = 0; iRule < cRules && !rc; iRule++)
+        {
+            KU32 iString = kDepDbStrTabAdd(pDb, paRules[iRule].pszTarget);
+            if (iString >= KDEPDBG_STRTAB_IDX_END)
+                rc = EIO;
+            pau[iu++] = K_H2LE_U32(iString);
+            pau[iu++] = K_H2LE_U32(paRules[iRule].cDeps);
+            for (iDep = 0; iDep < paRules[iRule].cDeps && !rc; iDep++)
+            {
+                iString = kDepDbStrTabAdd(pDb, paRules[iRule].papszDeps[iDep]);
+                if (iString >= KDEPDBG_STRTAB_IDX_END)
+                    rc = EIO;
+                pau[iu++] = K_H2LE_U32(iString);
+            }
+        }
+        if (!rc)
+            rc = kDepDbDataSetPut(pDb, &pDb->DepSet, pszName, pau, cu * sizeof(KU32));
+
+        kDepDbBumpGeneration(pDb);
+        kDepDbUnlock(pDb);
+    }
+
+    kDepDbFree(pau);
+    return rc;
+}
+
+
+/**
+ * Deletes an entry from the database.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @retval  ENOENT if not found.
+ * @param   pDb             The database handle.
+ * @param   pszName         The entry name.
+ */
+int kDepDbDelete(PKDEPDB pDb, const char *pszName)
+{
+    KDEPDBINTDATASET   *pSet = &pDb->DepSet;
+    KU32                iEntry;
+    KU32                iSlot;
+    int                 rc;
+
+    if (!pDb->fWrite)
+        return EACCES;
+
+    rc = kDepDbLock(pDb, K_TRUE);
+    if (!rc)
+    {
+        rc = kDepDbDataSetFind(pDb, pSet, pszName, strlen(pszName), &iEntry, &iSlot);
+        if (!rc)
+        {
+            KDEPDBDIRENTRY *pEntry = &pSet->pDir->aEntries[iEntry];
+
+            pSet->pHash->auEntries[iSlot] = K_H2LE_U32(KDEPDBHASH_DELETED);
+            pSet->pData->cWastedBlocks = K_H2LE_U32(K_LE2H_U32(pSet->pData->cWastedBlocks) + K_LE2H_U32(pEntry->cBlocks));
+
+            pEntry->iName       = K_H2LE_U32(KDEPDBG_STRTAB_IDX_INVALID);
+            pEntry->cbData      = K_H2LE_U32(KU32_MAX);
+            pEntry->cBlocks     = K_H2LE_U32(KU32_MAX);
+            pEntry->iStartBlock = pSet->pDir->iFreeHead;
+            pSet->pDir->iFreeHead = K_H2LE_U32(iEntry);
+
+            kDepDbBumpGeneration(pDb);
+        }
+        kDepDbUnlock(pDb);
+    }
+    return rc;
+}
+
+
+/**
+ * Queries the rules of a dependency file entry.
+ *
+ * @returns 0 on success, some non-zero native error code on failure.
+ * @retval  ENOENT if not found or stored before @a nsNotBefore.
+ * @retval  EIO if the entry is corrupt, in which case the callback is not
+ *          called at all.
+ *
+ * @param   pDb             The database handle.
+ * @param   pszName         The entry name.  Doesn't need to be terminated.
+ * @param   cchName         The length of the entry name.
+ * @param   nsNotBefore     Ignore the entry if it was stored before this time
+ *                          (nanoseconds since 1970-01-01 UTC), typically the
+ *                          modification time of the dependency file.  Pass
+ *                          0 to always use it.
+ * @param   pfnCallback     The callback which gets the targets and their
+ *                          dependencies.
+ * @param   pvUser          The user argument for the callback.
+ */
+int kDepDbQuery(PKDEPDB pDb, const char *pszName, size_t cchName, unsigned long long nsNotBefore,
+                FNKDEPDBQUERY *pfnCallback, void *pvUser)
+{
+    KDEPDBINTSTRTAB const  *pStrTab = &pDb->StrTab;
+    KDEPDBINTDATASET const *pSet    = &pDb->DepSet;
+    KU32                    iEntry;
+    KU32                    iSlot;
+    int                     rc;
+
+    rc = kDepDbLock(pDb, K_FALSE);
+    if (rc)
+        return rc;
+
+    rc = kDepDbDataSetFind(pDb, pSet, pszName, cchName, &iEntry, &iSlot);
+    if (!rc)
+    {
+        KDEPDBDIRENTRY const   *pEntry     = &pSet->pDir->aEntries[iEntry];
+        KU32 const              cbBlock    = K_LE2H_U32(pSet->pData->cbBlock);
+        KU32 const              iStart     = K_LE2H_U32(pEntry->iStartBlock);
+        KU32 const              cBlocks    = K_LE2H_U32(pEntry->cBlocks);
+        KU32 const              cbData     = K_LE2H_U32(pEntry->cbData);
+        KU32 const              iStringEnd = K_LE2H_U32(pStrTab->pStrTab->iStringEnd);
+        KU32 const             *pau;
+        KU32                    cu;
+        KU32                    iu;
+        KU32                    cRules;
+        KU32                    iRule;
+
+        /*
+         * Validate the whole stream before making any callbacks.
+         */
+        if (    iStart == 0
+            ||  (KU64)iStart + cBlocks > K_LE2H_U32(pSet->pData->cBlocks)
+            ||  cbData > (KU64)cBlocks * cbBlock
+            ||  cbData < 3 * sizeof(KU32)
+            ||  (cbData & 3))
+            rc = EIO;
+        else
+        {
+            pau = (KU32 const *)((KU8 const *)pSet->pData + (KSIZE)iStart * cbBlock);
+            cu  = cbData / sizeof(KU32);
+            if (    nsNotBefore
+                &&  (((KU64)K_LE2H_U32(pau[1]) << 32) | K_LE2H_U32(pau[0])) < nsNotBefore)
+                rc = ENOENT;
+            cRules = K_LE2H_U32(pau[2]);
+            for (iu = 3, iRule = 0; iRule < cRules && !rc; iRule++)
+            {
+                KU32 cDeps;
+                if (cu - iu < 2 || K_LE2H_U32(pau[iu]) >= iStringEnd)
+                    rc = EIO;
+                else
+                {
+                    cDeps = K_LE2H_U32(pau[iu + 1]);
+                    iu += 2;
+                    if (cDeps > cu - iu)
+                        rc = EIO;
+                    else
+                        while (cDeps-- > 0)
+                            if (K_LE2H_U32(pau[iu++]) >= iStringEnd)
+                                rc = EIO;
+                }
+            }
+            if (!rc && iu != cu)
+                rc = EIO;
+
+            /*
+             * Return the rules.
+             */
+            for (iu = 3, iRule = 0; iRule < cRules && !rc; iRule++)
+            {
+                KU32 iString = K_LE2H_U32(pau[iu]);
+                KU32 cDeps   = K_LE2H_U32(pau[iu + 1]);
+                pfnCallback(pvUser, 1, KDEPDB_STRTAB_STRING(pStrTab, iString), KDEPDB_STRTAB_LENGTH(pStrTab, iString));
+                iu += 2;
+                while (cDeps-- > 0)
+                {
+                    iString = K_LE2H_U32(pau[iu++]);
+                    pfnCallback(pvUser, 0, KDEPDB_STRTAB_STRING(pStrTab, iString), KDEPDB_STRTAB_LENGTH(pStrTab, iString));
+                }
+            }
+        }
+    }
+
+    kDepDbUnlock(pDb);
+    return rc;
+}
+
+
+/**
+ * Enumerates the names of all the entries in the database.
+ *
+ * The callback may call kDepDbQuery, but must not modify the database.
+ *
+ * @returns 0 on success, the callback's return value if it stopped the
+ *          enumeration, or some non-zero native error code on failure.
+ * @param   pDb             The database handle.
+ * @param   pfnCallback     The callback.
+ * @param   pvUser          The user argument for the callback.
+ */
+int kDepDbEnum(PKDEPDB pDb, FNKDEPDBENUM *pfnCallback, void *pvUser)
+{
+    KDEPDBINTSTRTAB const  *pStrTab = &pDb->StrTab;
+    KDEPDBINTDATASET const *pSet    = &pDb->DepSet;
+    KU32                    cEntries;
+    KU32                    iStringEnd;
+    KU32                    i;
+    int                     rc;
+
+    rc = kDepDbLock(pDb, K_FALSE);
+    if (rc)
+        return rc;
+
+    cEntries   = K_LE2H_U32(pSet->pDir->cEntries);
+    iStringEnd = K_LE2H_U32(pStrTab->pStrTab->iStringEnd);
+    for (i = 0; i < cEntries && !rc; i++)
+    {
+        KU32 const iName = K_LE2H_U32(pSet->pDir->aEntries[i].iName);
+        if (iName < iStringEnd)
+            rc = pfnCallback(pDb, pvUser, KDEPDB_STRTAB_STRING(pStrTab, iName), KDEPDB_STRTAB_LENGTH(pStrTab, iName));
+    }
+
+    kDepDbUnlock(pDb);
+    return rc;
+}
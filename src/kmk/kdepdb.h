@@ -0,0 +1,80 @@
+/* $Id$ */
+/** @file
+ * kdepdb - Dependency database.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef ___kdepdb_h
+#define ___kdepdb_h
+
+#include <stddef.h>
+
+/** Handle to an open dependency database. */
+typedef struct KDEPDB *PKDEPDB;
+
+/**
+ * A rule in a dependency entry, i.e. one 'target: deps' line.
+ */
+typedef struct KDEPDBRULE
+{
+    /** The target name. */
+    const char         *pszTarget;
+    /** The number of dependencies. */
+    unsigned            cDeps;
+    /** The dependencies. */
+    const char * const *papszDeps;
+} KDEPDBRULE;
+
+/**
+ * Callback used by kDepDbQuery to return the rules of an entry.
+ *
+ * The rules are returned one target at a time, followed by the dependencies of
+ * that target.  The strings are read-only and only valid during the callback.
+ *
+ * @param   pvUser          The user argument.
+ * @param   fTarget         Set if @a pszName is a target name, clear if it is a
+ *                          dependency of the last target.
+ * @param   pszName         The zero terminated name.
+ * @param   cchName         The length of the name.
+ */
+typedef void FNKDEPDBQUERY(void *pvUser, int fTarget, const char *pszName, unsigned cchName);
+
+/**
+ * Callback used by kDepDbEnum to return the names of all the entries.
+ *
+ * @returns 0 to continue, non-zero to stop and return this value.
+ * @param   pDb             The database handle (for kDepDbQuery).
+ * @param   pvUser          The user argument.
+ * @param   pszName         The zero terminated entry name.
+ * @param   cchName         The length of the name.
+ */
+typedef int FNKDEPDBENUM(PKDEPDB pDb, void *pvUser, const char *pszName, unsigned cchName);
+
+int kDepDbOpen(PKDEPDB *ppDb, const char *pszFilenameBase, int fWrite);
+int kDepDbClose(PKDEPDB pDb);
+int kDepDbPut(PKDEPDB pDb, const char *pszName, KDEPDBRULE const *paRules, unsigned cRules);
+int kDepDbDelete(PKDEPDB pDb, const char *pszName);
+int kDepDbQuery(PKDEPDB pDb, const char *pszName, size_t cchName, unsigned long long nsNotBefore,
+                FNKDEPDBQUERY *pfnCallback, void *pvUser);
+int kDepDbEnum(PKDEPDB pDb, FNKDEPDBENUM *pfnCallback, void *pvUser);
+
+#endif
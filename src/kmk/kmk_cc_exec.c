@@ -40,6 +40,7 @@
 # include <stdint.h>
 #endif
 #include <stdarg.h>
+#include <setjmp.h>
 #include <assert.h>
 #include "k/kDefs.h"
 #include "k/kTypes.h"
@@ -144,7 +145,7 @@ extern int KMK_CC_STATIC_ASSERT_EX_VAR[1];
 /** @defgroup grp_kmk_cc_evalprog Makefile Evaluation
  * @{
  */
-#define KMK_CC_EVAL_LOGGING_ENABLED
+//#define KMK_CC_EVAL_LOGGING_ENABLED
 #ifdef KMK_CC_EVAL_LOGGING_ENABLED
 # define KMK_CC_EVAL_DPRINTF_UNPACK(...)            __VA_ARGS__
 # define KMK_CC_EVAL_DPRINTF(a)                     fprintf(stderr, KMK_CC_EVAL_DPRINTF_UNPACK a)
@@ -613,6 +614,8 @@ typedef enum KMKCCEVALINSTR
     kKmkCcEvalInstr_includedep_queue,
     /** includedep-flush file1 [file2...] - KMKCCEVALINCLUDE. */
     kKmkCcEvalInstr_includedep_flush,
+    /** include-prefetch file1 [file2...] - KMKCCEVALINCLUDE. */
+    kKmkCcEvalInstr_include_prefetch,
 
     /** Recipe without commands (defines dependencies) - KMKCCEVALRECIPE. */
     kKmkCcEvalInstr_recipe_no_commands,
@@ -639,12 +642,16 @@ typedef enum KMKCCEVALINSTR
     kKmkCcEvalInstr_vpath_clear_all,
 
     /** Make 'code' needing expanding and evaluation - KMKCCEVALEXPAND.
-     * @note That this could in theory be used to start a recipe.  This will be
-     *       detected by the interpreter and loading will for now fail.  A
-     *       strategy for implement support for it would require picking up
-     *       potential commands following the statements too. */
+     * @note This is only used for lines consisting of a single call to a
+     *       function that never expands to anything, like $(eval ...), since
+     *       anything else could start a rule. */
     kKmkCcEvalInstr_expand,
 
+    /** Makefile text handed to the interpreter - KMKCCEVALINTERPRET. */
+    kKmkCcEvalInstr_interpret,
+    /** The end of the program - KMKCCEVALCORE. */
+    kKmkCcEvalInstr_return,
+
     /** The end of valid instructions (exclusive). */
     kKmkCcEvalInstr_End
 } KMKCCEVALINSTR;
@@ -691,13 +698,14 @@ typedef struct kmk_cc_eval_assign
     uint8_t                 fLocal;
     /** Whether the 'private' qualifier was used. */
     uint8_t                 fPrivate;
+    /** Pointer to the next instruction. */
+    PKMKCCEVALCORE          pNext;
     /** The variable name.
-     * @remarks Plain text names are in variable_strcache. */
+     * Always subject to expansion. */
     KMKCCEXPSUBPROGORPLAIN  Variable;
-    /** The value or value expression. */
+    /** The value or value expression.
+     * Only compiled for kKmkCcEvalInstr_assign_simple. */
     KMKCCEXPSUBPROGORPLAIN  Value;
-    /** Pointer to the next instruction. */
-    PKMKCCEVALCORE          pNext;
 } KMKCCEVALASSIGN;
 typedef KMKCCEVALASSIGN *PKMKCCEVALASSIGN;
 
@@ -728,6 +736,8 @@ typedef struct kmk_cc_eval_variables
     uint32_t                cVars;
     /** Whether the 'local' qualifier was used (undefine only). */
     uint8_t                 fLocal;
+    /** Whether the 'override' qualifier was used (undefine only). */
+    uint8_t                 fOverride;
     /** Pointer to the next instruction. */
     PKMKCCEVALCORE          pNext;
     /** The variable names.
@@ -783,10 +793,8 @@ typedef struct kmk_cc_eval_ifdef_dynamic
 {
     /** The 'if' core structure. */
     KMKCCEVALIFCORE         IfCore;
-    /** Alignment padding, MBZ. */
-    KU32                    uPadding;
-    /** The subprogram that will give us the variable name. */
-    KMKCCEXPSUBPROG         NameSubprog;
+    /** The variable name expression. */
+    KMKCCEXPSUBPROGORPLAIN  Name;
 } KMKCCEVALIFDEFDYNAMIC;
 typedef KMKCCEVALIFDEFDYNAMIC *PKMKCCEVALIFDEFDYNAMIC;
 
@@ -824,7 +832,8 @@ typedef KMKCCEVALIF1OF *PKMKCCEVALIF1OF;
 /**
  * Instruction format for kKmkCcEvalInstr_if.
  *
- * @todo Parse and compile the expression.  At least strip whitespace in it.
+ * The expression is compiled and cached by expreval.c the first time it is
+ * evaluated, keyed by szExpr.
  */
 typedef struct kmk_cc_eval_if_expr
 {
@@ -843,7 +852,8 @@ typedef KMKCCEVALIFEXPR *PKMKCCEVALIFEXPR;
 /**
  * Instruction format for kKmkCcEvalInstr_include,
  * kKmkCcEvalInstr_include_silent, kKmkCcEvalInstr_includedep,
- * kKmkCcEvalInstr_includedep_queue, kKmkCcEvalInstr_includedep_flush.
+ * kKmkCcEvalInstr_includedep_queue, kKmkCcEvalInstr_includedep_flush,
+ * kKmkCcEvalInstr_include_prefetch.
  */
 typedef struct kmk_cc_eval_include
 {
@@ -977,11 +987,39 @@ typedef struct kmk_cc_eval_expand
     KMKCCEVALCORE           Core;
     /** Alignment padding, MBZ. */
     KU32                    uPadding;
+    /** Pointer to the next instruction. */
+    PKMKCCEVALCORE          pNext;
     /** The expansion subprogram that to execute and evaluate the output of. */
     KMKCCEXPSUBPROG         Subprog;
 } KMKCCEVALEXPAND;
 typedef KMKCCEVALEXPAND *PKMKCCEVALEXPAND;
 
+/**
+ * Instruction format for kKmkCcEvalInstr_interpret.
+ */
+typedef struct kmk_cc_eval_interpret
+{
+    /** The core instruction. */
+    KMKCCEVALCORE           Core;
+    /** The length of the makefile text. */
+    uint32_t                cchText;
+    /** The makefile text (zero terminated). */
+    const char             *pszText;
+    /** Pointer to the next instruction (the text is after this one). */
+    PKMKCCEVALCORE          pNext;
+} KMKCCEVALINTERPRET;
+typedef KMKCCEVALINTERPRET *PKMKCCEVALINTERPRET;
+
+/** @name KMK_CC_EVAL_OPERAND_XXX - Values for KMKCCEXPSUBPROGORPLAIN::bUser in
+ *        evaluation instructions.
+ * @{ */
+/** Plain text, or compiled expansion subprogram. */
+#define KMK_CC_EVAL_OPERAND_PLAIN                   0
+/** Plain text that must be expanded by the interpreter at runtime, as the
+ * expansion compiler would complain about it at compile time. */
+#define KMK_CC_EVAL_OPERAND_EXPAND                  1
+/** @} */
+
 
 /**
  * Makefile evaluation program.
@@ -996,6 +1034,10 @@ typedef struct kmk_cc_evalprog
     const char             *pszFilename;
     /** The name of the variable containing this program, if applicable.  */
     const char             *pszVarName;
+    /** The command prefix character the program was compiled for. */
+    char                    chCmdPrefix;
+    /** Whether to track line numbers (file) or not (variable). */
+    uint8_t                 fLineNumbers;
 #ifdef KMK_CC_STRICT
     /** The hash of the input string.  Used to check that we get all the change
      * notifications we require. */
@@ -1018,6 +1060,7 @@ static uint32_t g_cVarForEvalCompilations = 0;
 static uint32_t g_cVarForEvalExecs = 0;
 static uint32_t g_cFileForEvalCompilations = 0;
 static uint32_t g_cFileForEvalExecs = 0;
+static uint32_t g_cEvalChunkRuns = 0;
 #ifdef KMK_CC_WITH_STATS
 static uint32_t g_cBlockAllocated = 0;
 static uint32_t g_cbAllocated = 0;
@@ -1064,6 +1107,7 @@ static const char * const g_apszEvalKeywords[] =
     "includedep",
     "includedep-queue",
     "includedep-flush",
+    "include-prefetch",
     "local",
     "override",
     "private",
@@ -1105,6 +1149,7 @@ static const char * const g_apszEvalInstrNms[] =
     "includedep",
     "includedep_queue",
     "includedep_flush",
+    "include_prefetch",
     "recipe_no_commands",
     "recipe_start_normal",
     "recipe_start_double_colon",
@@ -1115,6 +1160,9 @@ static const char * const g_apszEvalInstrNms[] =
     "vpath",
     "vpath_clear_pattern",
     "vpath_clear_all",
+    "expand",
+    "interpret",
+    "return",
 };
 
 /*********************************************************************************************************************************
@@ -1122,6 +1170,7 @@ static const char * const g_apszEvalInstrNms[] =
 *********************************************************************************************************************************/
 static int kmk_cc_exp_compile_subprog(PKMKCCBLOCK *ppBlockTail, const char *pchStr, uint32_t cchStr, PKMKCCEXPSUBPROG pSubprog);
 static char *kmk_exec_expand_subprog_to_tmp(PKMKCCEXPSUBPROG pSubprog, uint32_t *pcch);
+static int kmk_cc_eval_is_exp_compilable(const char *pchStr, uint32_t cchStr);
 
 
 /**
@@ -1212,7 +1261,7 @@ void kmk_cc_print_stats(void)
 
     printf(_("# Variables compiled for string expansion: %6u\n"), g_cVarForExpandCompilations);
     printf(_("# Variables string expansion runs:         %6u\n"), g_cVarForExpandExecs);
-    printf(_("# String expansion runs per compile:       %6u\n"), g_cVarForExpandExecs / g_cVarForExpandCompilations);
+    printf(_("# String expansion runs per compile:       %6u\n"), g_cVarForExpandCompilations ? g_cVarForExpandExecs / g_cVarForExpandCompilations : 0);
 #ifdef KMK_CC_WITH_STATS
     printf(_("#          Single alloc block exp progs:   %6u (%u%%)\n"
              "#             Two alloc block exp progs:   %6u (%u%%)\n"
@@ -1234,10 +1283,11 @@ void kmk_cc_print_stats(void)
 #endif
     printf(_("# Variables compiled for string eval:      %6u\n"), g_cVarForEvalCompilations);
     printf(_("# Variables string eval runs:              %6u\n"), g_cVarForEvalExecs);
-    printf(_("# String evals runs per compile:           %6u\n"), g_cVarForEvalExecs / g_cVarForEvalCompilations);
+    printf(_("# String evals runs per compile:           %6u\n"), g_cVarForEvalCompilations ? g_cVarForEvalExecs / g_cVarForEvalCompilations : 0);
     printf(_("# Files compiled:                          %6u\n"), g_cFileForEvalCompilations);
     printf(_("# Files runs:                              %6u\n"), g_cFileForEvalExecs);
-    printf(_("# Files eval runs per compile:             %6u\n"), g_cFileForEvalExecs / g_cFileForEvalCompilations);
+    printf(_("# Files eval runs per compile:             %6u\n"), g_cFileForEvalCompilations ? g_cFileForEvalExecs / g_cFileForEvalCompilations : 0);
+    printf(_("# Interpreted eval chunk runs:             %6u\n"), g_cEvalChunkRuns);
 #ifdef KMK_CC_WITH_STATS
     printf(_("#         Single alloc block eval progs:   %6u (%u%%)\n"
              "#            Two alloc block eval progs:   %6u (%u%%)\n"
@@ -2225,20 +2275,20 @@ static int kmk_cc_exp_compile_common(PKMKCCBLOCK *ppBlockTail, const char *pchSt
                             }
                             if (cArgs < cMinArgs)
                             {
-                                fatal(NULL, _("Function '%s' takes a minimum of %d arguments: %d given"),
-                                      pszFunction, (int)cMinArgs, (int)cArgs);
+                                OSNN(fatal, NILF, _("Function '%s' takes a minimum of %d arguments: %d given"),
+                                     pszFunction, (int)cMinArgs, (int)cArgs);
                                 return -1; /* not reached */
                             }
                             if (cDepth != 0)
                             {
-                                fatal(NULL, chOpen == '('
-                                      ? _("Missing closing parenthesis calling '%s'") : _("Missing closing braces calling '%s'"),
-                                      pszFunction);
+                                OS(fatal, NILF, chOpen == '('
+                                   ? _("Missing closing parenthesis calling '%s'") : _("Missing closing braces calling '%s'"),
+                                   pszFunction);
                                 return -1; /* not reached */
                             }
                             if (cMaxDepth > 16 && fExpandArgs)
                             {
-                                fatal(NULL, _("Too many levels of nested function arguments expansions: %s"), pszFunction);
+                                OS(fatal, NILF, _("Too many levels of nested function arguments expansions: %s"), pszFunction);
                                 return -1; /* not reached */
                             }
                             if (!fExpandArgs || cDollars == 0)
@@ -2305,10 +2355,10 @@ static int kmk_cc_exp_compile_common(PKMKCCBLOCK *ppBlockTail, const char *pchSt
                                 }
                             }
                             if (cDepth > 0) /* After warning, we just assume they're all there. */
-                                error(NULL, chOpen == '(' ? _("Missing closing parenthesis ") : _("Missing closing braces"));
+                                O(error, NILF, chOpen == '(' ? _("Missing closing parenthesis ") : _("Missing closing braces"));
                             if (cMaxDepth >= 16)
                             {
-                                fatal(NULL, _("Too many levels of nested variable expansions: '%.*s'"), (int)cchName + 2, pchStr - 1);
+                                fatal(NILF, cchName + 2, _("Too many levels of nested variable expansions: '%.*s'"), (int)cchName + 2, pchStr - 1);
                                 return -1; /* not reached */
                             }
                             if (cDollars == 0)
@@ -2333,7 +2383,7 @@ static int kmk_cc_exp_compile_common(PKMKCCBLOCK *ppBlockTail, const char *pchSt
                 }
                 else
                 {
-                    error(NULL, _("Unexpected end of string after $"));
+                    O(error, NILF, _("Unexpected end of string after $"));
                     break;
                 }
             }
@@ -2781,8 +2831,8 @@ static char *kmk_exec_expand_instruction_stream_to_var_buf(PKMKCCEXPCORE pInstrC
                 return pchDst;
 
             default:
-                fatal(NULL, _("Unknown string expansion opcode: %d (%#x)"),
-                      (int)pInstrCore->enmOpcode, (int)pInstrCore->enmOpcode);
+                ONN(fatal, NILF, _("Unknown string expansion opcode: %d (%#x)"),
+                    (int)pInstrCore->enmOpcode, (int)pInstrCore->enmOpcode);
                 return NULL;
         }
     }
@@ -2906,69 +2956,28 @@ char *kmk_exec_expand_to_var_buf(struct variable *pVar, char *pchDst)
  *
  */
 
-static size_t kmk_cc_eval_detect_eol_style(char *pchFirst, char *pchSecond, const char *pszContent, size_t cchContent)
-{
-    /* Look for LF first. */
-    const char *pszTmp = (const char *)memchr(pszContent, '\n', cchContent);
-    if (pszTmp)
-    {
-        /* CRLF? */
-        if (pszTmp != pszContent && pszTmp[-1] == '\r')
-        {
-            *pchFirst = '\r';
-            *pchSecond = '\n';
-            return 2;
-        }
-
-        /* No, LF or LFCR. (pszContent is zero terminated, so no bounds checking necessary.) */
-        *pchFirst = '\n';
-        if (pszTmp[1] != '\r')
-        {
-            *pchSecond = 0;
-            return 1;
-        }
-        *pchSecond = '\r';
-        return 2;
-    }
-
-    /* Probably no EOLs here. */
-    if (memchr(pszContent, '\r', cchContent) == NULL)
-    {
-        *pchSecond = *pchFirst = 0;
-        return 0;
-    }
-
-    /* kind of unlikely */
-    *pchFirst  = '\r';
-    *pchSecond = 0;
-    return 1;
-}
-
-
-#if 0
-/**
- * Checks whether we've got an EOL escape sequence or not.
+/*
+ * The compiler deals natively with the directives that can be carried out
+ * without access to the interpreter's parsing state: variable assignments,
+ * define (recursive and conditional flavors only), export, unexport, undefine,
+ * the include family, the conditionals and lines consisting of a single call
+ * to a function that never expands to anything, like $(eval ...) and
+ * $(info ...).  Everything else (rules and their recipes, vpath, load, != and
+ * so on) is collected into chunks of makefile text that are handed to the
+ * interpreter at runtime.
  *
- * @returns non-zero if escaped EOL, 0 if not (i.e. actual EOL).
- * @param   pszContent          The string pointer @a offEol is relative to.
- * @param   offEol              The offset of the first EOL char.
+ * Each line is collapsed and stripped of comments by
+ * eval_prep_line_for_compiler() before we parse it, just like eval() does it,
+ * so the parser need not concern itself with escaped end-of-line sequences.
+ * Variable assignments are cross-checked against parse_variable_definition()
+ * before anything is emitted for them.
+ *
+ * The interpreter keeps the last rule around until a directive which records
+ * it comes along, so a recipe line cannot be compiled in any other way than
+ * as part of the chunk containing its rule.  Likewise, the compiler gives up
+ * (kmk_cc_eval_fatal) and leaves the whole input to the interpreter when it
+ * runs into anything it cannot reproduce exactly, like syntax errors.
  */
-static unsigned kmk_cc_eval_is_eol_escape_seq(const char *pszContent, size_t offEol)
-{
-    /* The caller has already checked out two backslashes. */
-    size_t offFirstBackslash = offEol;
-    KMK_CC_ASSERT(offFirstBackslash >= 2);
-    offFirstBackslash -= 2;
-
-    /* Find the first backslash. */
-    while (offFirstBackslash > 0 && pszContent[offFirstBackslash - 1] == '\\')
-        offFirstBackslash--;
-
-    /* Odd number -> escaped EOL; Even number -> real EOL; */
-    return (offEol - offFirstBackslash) & 1;
-}
-#endif
-
 
 
 /**
@@ -2981,23 +2990,8 @@ typedef enum kmk_cc_eval_token
 
     /** Plain word. */
     kKmkCcEvalToken_WordPlain,
-    /** Plain word with one or more escaped EOLs. (Currently not possible.) */
-    kKmkCcEvalToken_WordPlainWithEscEol,
     /** Word that maybe in need of expanding. */
     kKmkCcEvalToken_WordWithDollar,
-    /** Word that is in need of expanding and include one or more escped EOLs. */
-    kKmkCcEvalToken_WordWithDollarAndEscEol,
-
-    /** Recipe colon. */
-    kKmkCcEvalToken_colon,
-    /** Recipe double colon.   */
-    kKmkCcEvalToken_double_colon,
-    /** Recipe multi target plus. */
-    kKmkCcEvalToken_plus,
-    /** Recipe multi target plus-maybe (+|). */
-    kKmkCcEvalToken_plus_maybe,
-    /** Recipe semicolon. */
-    kKmkCcEvalToken_semicolon,
 
     /** End of valid token values (not included). */
     kKmkCcEvalToken_End
@@ -3019,100 +3013,71 @@ typedef KMKCCEVALWORD *PKMKCCEVALWORD;
 typedef KMKCCEVALWORD const *PCKMKCCEVALWORD;
 
 
-/**
- * Escaped end-of-line sequence in the current line.
- */
-typedef struct KMKCCEVALESCEOL
-{
-    /** Offset at which the EOL escape sequence starts for a non-command line. */
-    size_t              offEsc;
-    /** Offset of the newline sequence. */
-    size_t              offEol;
-} KMKCCEVALESCEOL;
-typedef KMKCCEVALESCEOL *PKMKCCEVALESCEOL;
-
+/** Value of KMKCCEVALCOMPILER::offChunk when there is no pending chunk. */
+#define KMK_CC_EVAL_NO_CHUNK    (~(size_t)0)
 
 /**
- * String copy segment.
+ * Makefile evaluation compiler state.
  */
-typedef struct KMKCCEVALSTRCPYSEG
-{
-    /** The start. */
-    const char         *pchSrc;
-    /** The number of chars to copy and whether to prepend space.
-     * Negative values indicates that we should prepend a space. */
-    ssize_t             cchSrcAndPrependSpace;
-} KMKCCEVALSTRCPYSEG;
-typedef KMKCCEVALSTRCPYSEG *PKMKCCEVALSTRCPYSEG;
-typedef KMKCCEVALSTRCPYSEG const *PCKMKCCEVALSTRCPYSEG;
-
-
 typedef struct KMKCCEVALCOMPILER
 {
     /** Pointer to the KMKCCEVALPROG::pBlockTail member.  */
     PKMKCCBLOCK        *ppBlockTail;
+    /** The program being compiled. */
+    PKMKCCEVALPROG      pEvalProg;
+    /** Pointer to the content. */
+    const char         *pszContent;
+    /** The amount of input to parse. */
+    size_t              cchContent;
+    /** The command prefix character. */
+    char                chCmdPrefix;
 
-    /** @name Line parsing state.
+    /** @name Current line.
      * @{ */
-    /** Offset of newline escape sequences in the current line.
-     * This is only applicable if cEscEols is not zero.  */
-    PKMKCCEVALESCEOL    paEscEols;
-    /** The number of number of paEscEols entries we've allocated. */
-    unsigned            cEscEolsAllocated;
-    /** Number of escaped EOLs (line count - 1). */
-    unsigned            cEscEols;
-    /** The paEscEols entry corresponding to the current parsing location.
-     * Still to be seen how accurate this can be made to be. */
-    unsigned            iEscEol;
-
-    /** The current line number for error handling / debugging (1-based). */
+    /** The current line number (1-based). */
     unsigned            iLine;
-    /** The start offset (into pchContent) of the current line. */
+    /** The number of physical lines making up the current line. */
+    unsigned            cLines;
+    /** The start offset (into pszContent) of the current line. */
     size_t              offLine;
-    /** Length of the current line, sans the final EOL and comments. */
-    size_t              cchLine;
-    /** Length of the current line, sans the final EOL but with comments. */
-    size_t              cchLineWithComments;
-    /** For 'define' only, the start offset of the next line.  Modified to the
-     * line following 'endef'. */
+    /** The end offset of the current line (exclusive, sans newline). */
+    size_t              offEol;
+    /** The start offset of the next line. */
     size_t              offNext;
-
-    /** The first char in an EOL sequence.
-     * We ASSUMES that this char won't appear in any other sequence in the file,
-     * thus skipping matching any subsequent chars. */
-    char                chFirstEol;
-    /** The second char in an EOL sequence, if applicable. */
-    char                chSecondEol;
-
-    /** The length of the EOL sequence. */
-    size_t              cchEolSeq;
-    /** The minimum length of an esacped EOL sequence (cchEolSeq + 1). */
-    size_t              cchEscEolSeq;
-
-    /** String copy segments. */
-    PKMKCCEVALSTRCPYSEG paStrCopySegs;
-    /** The number of segments that has been prepared. */
-    unsigned            cStrCopySegs;
-    /** The number of segments we've allocated. */
-    unsigned            cStrCopySegsAllocated;
+    /** Scratch buffer for preparing lines. */
+    char               *pszScratch;
+    /** The size of the scratch buffer. */
+    size_t              cbScratch;
     /** @} */
 
+    /** @name Tokenized words.
+     * @{ */
+    /** The number of words in paWords. */
+    unsigned            cWords;
+    /** The number of words allocated. */
+    unsigned            cWordsAllocated;
+    /** The words (see kmk_cc_eval_parse_words). */
+    PKMKCCEVALWORD      paWords;
+    /** @} */
 
-    /** @name Recipe state.
+    /** @name Define body.
      * @{ */
-    /** Set if we're working on a recipe. */
-    PKMKCCEVALRECIPE    pRecipe;
-    /** Set for ignoring recipes without targets (SunOS 4 Make). */
-    uint8_t             fNoTargetRecipe;
-    /** The command prefix character. */
-    char                chCmdPrefix;
+    /** Buffer for assembling the value of a define. */
+    char               *pszDefValue;
+    /** The size of the define value buffer. */
+    size_t              cbDefValue;
     /** @} */
 
-    /** @name Tokenzied words.
+    /** @name Interpreter chunk.
      * @{ */
-    unsigned            cWords;
-    unsigned            cWordsAllocated;
-    PKMKCCEVALWORD      paWords;
+    /** The start offset of the pending chunk, KMK_CC_EVAL_NO_CHUNK if none. */
+    size_t              offChunk;
+    /** The end offset of the pending chunk (exclusive). */
+    size_t              offChunkEnd;
+    /** The line number of the first line in the pending chunk. */
+    unsigned            iChunkLine;
+    /** Set if the interpreter may be sitting on a rule expecting recipe lines. */
+    uint8_t             fRuleMaybePending;
     /** @} */
 
     /** @name Conditionals.
@@ -3123,218 +3088,432 @@ typedef struct KMKCCEVALCOMPILER
     PKMKCCEVALIFCORE    apIfs[KMK_CC_EVAL_MAX_IF_DEPTH];
     /** @} */
 
-    /** The program being compiled. */
-    PKMKCCEVALPROG      pEvalProg;
-    /** Pointer to the content. */
-    const char         *pszContent;
-    /** The amount of input to parse. */
-    size_t              cchContent;
+    /** Where kmk_cc_eval_fatal takes us when giving up. */
+    jmp_buf             JmpBuf;
 } KMKCCEVALCOMPILER;
 typedef KMKCCEVALCOMPILER *PKMKCCEVALCOMPILER;
 
 
-static void kmk_cc_eval_init_compiler(PKMKCCEVALCOMPILER pCompiler, PKMKCCEVALPROG pEvalProg, unsigned iLine,
-                                      const char *pszContent, size_t cchContent)
+/**
+ * Gives up compiling, leaving the input to the interpreter.
+ *
+ * The interpreter will report the actual problem (if any) in its own words
+ * when it gets to it, so the message is only for debug logging.
+ *
+ * @param   pCompiler   The compiler state.
+ * @param   pchWhere    Where in the current line the problem is, NULL if not
+ *                      applicable.
+ * @param   pszMsg      The message format string.
+ * @param   ...         Message format arguments.
+ */
+static KMK_CC_FN_NO_RETURN void kmk_cc_eval_fatal(PKMKCCEVALCOMPILER pCompiler, const char *pchWhere, const char *pszMsg, ...)
 {
-    pCompiler->ppBlockTail      = &pEvalProg->pBlockTail;
-
-    pCompiler->pRecipe          = NULL;
-    pCompiler->fNoTargetRecipe  = 0;
-    pCompiler->chCmdPrefix      = cmd_prefix;
+#ifdef KMK_CC_EVAL_LOGGING_ENABLED
+    va_list va;
+    if (pchWhere && pCompiler->pszScratch)
+        fprintf(stderr, "%s:%u:%u: giving up: ", pCompiler->pEvalProg->pszFilename, pCompiler->iLine,
+                (unsigned)(pchWhere - pCompiler->pszScratch) + 1);
+    else
+        fprintf(stderr, "%s:%u: giving up: ", pCompiler->pEvalProg->pszFilename, pCompiler->iLine);
+    va_start(va, pszMsg);
+    vfprintf(stderr, pszMsg, va);
+    va_end(va);
+    fputs("\n", stderr);
+#else
+    (void)pchWhere; (void)pszMsg;
+#endif
+    longjmp(pCompiler->JmpBuf, 1);
+}
 
-    pCompiler->cWordsAllocated  = 0;
-    pCompiler->paWords          = NULL;
 
-    pCompiler->cEscEolsAllocated = 0;
-    pCompiler->paEscEols        = NULL;
-    pCompiler->iLine            = iLine;
+/**
+ * Checks the function arguments for kmk_cc_eval_is_exp_compilable.
+ *
+ * This splits the arguments the same way as kmk_cc_exp_emit_dyn_function.
+ *
+ * @returns 1 if it's safe to compile, 0 if not.
+ * @param   pchArgs     The arguments.
+ * @param   cchArgs     The length of the arguments.
+ * @param   cArgs       The number of arguments found.
+ * @param   chOpen      The char used to open the function call.
+ * @param   chClose     The char used to close the function call.
+ * @param   cMaxArgs    Maximum number of arguments the function takes.
+ */
+static int kmk_cc_eval_are_exp_args_compilable(const char *pchArgs, uint32_t cchArgs, uint32_t cArgs,
+                                               char chOpen, char chClose, unsigned char cMaxArgs)
+{
+    uint32_t const  cActualArgs = cArgs <= cMaxArgs || !cMaxArgs ? cArgs : cMaxArgs;
+    uint32_t        iArg        = 0;
+    for (;;)
+    {
+        char     ch         = '\0';
+        uint8_t  fDollar    = 0;
+        int32_t  cDepth     = 0;
+        uint32_t cchThisArg = 0;
+        while (cchThisArg < cchArgs)
+        {
+            ch = pchArgs[cchThisArg];
+            if (ch == chClose)
+            {
+                if (cDepth > 0)
+                    cDepth--;
+            }
+            else if (ch == chOpen)
+                cDepth++;
+            else if (ch == ',' && cDepth == 0 && iArg + 1 < cActualArgs)
+                break;
+            else if (ch == '$')
+                fDollar = 1;
+            cchThisArg++;
+        }
+        if (fDollar && !kmk_cc_eval_is_exp_compilable(pchArgs, cchThisArg))
+            return 0;
+        iArg++;
+        if (ch != ',')
+            return 1;
+        pchArgs += cchThisArg + 1;
+        cchArgs -= cchThisArg + 1;
+    }
+}
 
-    pCompiler->cStrCopySegsAllocated = 0;
-    pCompiler->paStrCopySegs    = NULL;
 
-    pCompiler->cIfs             = 0;
+/**
+ * Checks whether kmk_cc_exp_compile_subprog can digest a string without
+ * complaining about it.
+ *
+ * The string expansion compiler reports unbalanced parentheses, missing
+ * function arguments and excessive nesting at compile time, whereas the
+ * interpreter only does so if and when the string is actually expanded.  It
+ * also treats function names directly followed by the closing parenthesis as
+ * function calls, which the interpreter does not.  Strings failing this check
+ * are left to the interpreter to expand at runtime.
+ *
+ * This follows kmk_cc_exp_compile_common closely.
+ *
+ * @returns 1 if it's safe to compile, 0 if not.
+ * @param   pchStr      The string.
+ * @param   cchStr      The length of the string.
+ */
+static int kmk_cc_eval_is_exp_compilable(const char *pchStr, uint32_t cchStr)
+{
+    while (cchStr > 0)
+    {
+        uint32_t    offDollar;
+        uint32_t    cDollars;
+        const char *pchDollar = memchr(pchStr, '$', cchStr);
+        if (!pchDollar)
+            return 1;
 
-    pCompiler->pEvalProg        = pEvalProg;
-    pCompiler->pszContent       = pszContent;
-    pCompiler->cchContent       = cchContent;
+        offDollar = (uint32_t)(pchDollar - pchStr);
+        cDollars  = 1;
+        while (   offDollar + cDollars < cchStr
+               && pchStr[offDollar + cDollars] == '$')
+            cDollars++;
+        pchStr += offDollar + cDollars;
+        cchStr -= offDollar + cDollars;
 
-    /* Detect EOL style. */
-    pCompiler->cchEolSeq        = kmk_cc_eval_detect_eol_style(&pCompiler->chFirstEol, &pCompiler->chSecondEol,
-                                                               pszContent, cchContent);
-    pCompiler->cchEscEolSeq     = 1 + pCompiler->cchEolSeq;
-}
+        if (cDollars & 1)
+        {
+            char chOpen;
+            if (cchStr == 0)
+                return 0; /* Unexpected end of string after $ */
 
+            chOpen = *pchStr;
+            if (chOpen == '(' || chOpen == '{')
+            {
+                make_function_ptr_t pfnFunction;
+                const char         *pszFunction;
+                unsigned char       cMaxArgs;
+                unsigned char       cMinArgs;
+                char                fExpandArgs;
+                char const          chClose   = chOpen == '(' ? ')' : '}';
+                char                ch        = 0;
+                uint32_t            cchName   = 0;
+                uint32_t            cDepth    = 1;
+                uint32_t            cMaxDepth = 1;
+                cDollars = 0;
+
+                pchStr++;
+                cchStr--;
+
+                while (cchName < cchStr)
+                {
+                    ch = pchStr[cchName];
+                    if (!func_char_map[(unsigned char)ch])
+                        break;
+                    cchName++;
+                }
 
-static void kmk_cc_eval_delete_compiler(PKMKCCEVALCOMPILER pCompiler)
-{
-    if (pCompiler->paWords)
-        free(pCompiler->paWords);
-    if (pCompiler->paEscEols)
-        free(pCompiler->paEscEols);
+                if (   cchName >= MIN_FUNCTION_LENGTH
+                    && cchName <= MAX_FUNCTION_LENGTH
+                    && (ISBLANK(ch) || ch == chClose || cchName == cchStr)
+                    && (pfnFunction = lookup_function_for_compiler(pchStr, cchName, &cMinArgs, &cMaxArgs,
+                                                                   &fExpandArgs, &pszFunction)) != NULL)
+                {
+                    /* Function call. */
+                    uint32_t cArgs = 1;
+                    if (ch == chClose || cchName == cchStr)
+                        return 0;
+
+                    cchName++;
+                    while (cchName < cchStr && ISBLANK(pchStr[cchName]))
+                        cchName++;
+                    pchStr += cchName;
+                    cchStr -= cchName;
+                    cchName = 0;
+
+                    while (cchName < cchStr)
+                    {
+                        ch = pchStr[cchName];
+                        if (ch == ',')
+                        {
+                            if (cDepth == 1)
+                                cArgs++;
+                        }
+                        else if (ch == chClose)
+                        {
+                            if (!--cDepth)
+                                break;
+                        }
+                        else if (ch == chOpen)
+                        {
+                            if (++cDepth > cMaxDepth)
+                                cMaxDepth = cDepth;
+                        }
+                        else if (ch == '$')
+                            cDollars++;
+                        cchName++;
+                    }
+                    if (   cArgs < cMinArgs
+                        || cDepth != 0
+                        || (cMaxDepth > 16 && fExpandArgs))
+                        return 0;
+                    if (   fExpandArgs
+                        && cDollars != 0
+                        && !kmk_cc_eval_are_exp_args_compilable(pchStr, cchName, cArgs, chOpen, chClose, cMaxArgs))
+                        return 0;
+                }
+                else
+                {
+                    /* Variable reference. */
+                    if (ch == chClose)
+                        cDepth = 0;
+                    else
+                    {
+                        while (cchName < cchStr)
+                        {
+                            ch = pchStr[cchName];
+                            if (ch == chClose)
+                            {
+                                if (!--cDepth)
+                                    break;
+                            }
+                            else if (ch == chOpen)
+                            {
+                                if (++cDepth > cMaxDepth)
+                                    cMaxDepth = cDepth;
+                            }
+                            else if (ch == '$')
+                                cDollars++;
+                            cchName++;
+                        }
+                    }
+                    if (cDepth != 0 || cMaxDepth >= 16)
+                        return 0;
+                    if (cDollars != 0 && !kmk_cc_eval_is_exp_compilable(pchStr, cchName))
+                        return 0;
+                }
+                pchStr += cchName + 1;
+                cchStr -= cchName + 1;
+            }
+            else
+            {
+                /* Single character variable name. */
+                pchStr++;
+                cchStr--;
+            }
+        }
+    }
+    return 1;
 }
 
 
 /**
- * Translates a makefile source pointer to a line number and offset.
+ * Initializes an operand of an evaluation instruction.
+ *
+ * The string is duplicated into the program, so the caller must call
+ * kmk_cc_block_realign() when done with the instruction.
  *
- * @returns Line number (1-based)
  * @param   pCompiler   The compiler state.
- * @param   pszWhere    There location to translate.
- * @param   piColumn    Where to return the line offset (1-based).
+ * @param   pOperand    The operand to initialize.
+ * @param   pchString   The string.
+ * @param   cchString   The length of the string.
+ * @param   fExpand     Whether the string should be expanded at runtime.  If
+ *                      clear the operand is always plain.
  */
-static unsigned kmk_cc_eval_translate_location(PKMKCCEVALCOMPILER pCompiler, const char *pchWhere, unsigned *piColumn)
+static void kmk_cc_eval_init_operand(PKMKCCEVALCOMPILER pCompiler, PKMKCCEXPSUBPROGORPLAIN pOperand,
+                                     const char *pchString, size_t cchString, int fExpand)
 {
-    unsigned iLine   = pCompiler->iLine;
-    size_t   offLine = pCompiler->offLine;
-    size_t   off     = pchWhere - pCompiler->pszContent;
-    unsigned i       = 0;
-    while (   i   < pCompiler->cEscEols
-           && off > pCompiler->paEscEols[i].offEol)
+    const char *pszCopy = kmk_cc_block_strdup(pCompiler->ppBlockTail, pchString, (uint32_t)cchString);
+    pOperand->fPlainIsInVarStrCache  = 0;
+    pOperand->bUser                  = KMK_CC_EVAL_OPERAND_PLAIN;
+    pOperand->bUser2                 = 0;
+    if (   fExpand
+        && memchr(pchString, '$', cchString)
+        && kmk_cc_eval_is_exp_compilable(pszCopy, (uint32_t)cchString))
+    {
+        int rc;
+        pOperand->fSubprog = 1;
+        kmk_cc_block_realign(pCompiler->ppBlockTail);
+        rc = kmk_cc_exp_compile_subprog(pCompiler->ppBlockTail, pszCopy, (uint32_t)cchString, &pOperand->u.Subprog);
+        KMK_CC_ASSERT(rc == 0); (void)rc;
+    }
+    else
     {
-        offLine = pCompiler->paEscEols[i].offEol + 1 + pCompiler->cchEolSeq;
-        iLine++;
-        i++;
+        pOperand->fSubprog    = 0;
+        pOperand->u.Plain.psz = pszCopy;
+        pOperand->u.Plain.cch = (uint32_t)cchString;
+        if (fExpand && memchr(pchString, '$', cchString))
+            pOperand->bUser = KMK_CC_EVAL_OPERAND_EXPAND;
     }
-    KMK_CC_ASSERT(off <= pCompiler->cchContent);
-    if (piColumn)
-        *piColumn = (unsigned)(off - offLine) + 1;
-    return iLine;
 }
 
 
-static void KMK_CC_FN_NO_RETURN kmk_cc_eval_fatal(PKMKCCEVALCOMPILER pCompiler, const char *pchWhere, const char *pszMsg, ...)
+/**
+ * Emits the pending interpreter chunk, if any.
+ *
+ * @param   pCompiler   The compiler state.
+ */
+static void kmk_cc_eval_flush_chunk(PKMKCCEVALCOMPILER pCompiler)
 {
-    va_list  va;
-    log_working_directory(1);
-
-    /*
-     * If we have a pointer location, use it to figure out the exact line and column.
-     */
-    if (pchWhere)
+    if (pCompiler->offChunk != KMK_CC_EVAL_NO_CHUNK)
     {
-        unsigned iColumn;
-        unsigned iLine = kmk_cc_eval_translate_location(pCompiler, pchWhere, &iColumn);
+        size_t const        cchText = pCompiler->offChunkEnd - pCompiler->offChunk;
+        PKMKCCEVALINTERPRET pInstr  = (PKMKCCEVALINTERPRET)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
+        pInstr->Core.enmOpcode = kKmkCcEvalInstr_interpret;
+        pInstr->Core.iLine     = pCompiler->iChunkLine;
+        pInstr->cchText        = (uint32_t)cchText;
+        pInstr->pszText        = kmk_cc_block_strdup(pCompiler->ppBlockTail, &pCompiler->pszContent[pCompiler->offChunk],
+                                                     (uint32_t)cchText);
+        kmk_cc_block_realign(pCompiler->ppBlockTail);
+        pInstr->pNext          = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
+        KMK_CC_EVAL_DPRINTF(("%u: interpret %u bytes\n", pInstr->Core.iLine, pInstr->cchText));
 
-        if (pCompiler->pEvalProg->pszVarName)
-            fprintf(stderr, "%s:%u:%u: *** fatal parsing error in %s: ",
-                    pCompiler->pEvalProg->pszFilename, iLine, iColumn, pCompiler->pEvalProg->pszVarName);
-        else
-            fprintf(stderr, "%s:%u:%u: *** fatal parsing error: ",
-                    pCompiler->pEvalProg->pszFilename, iLine, iColumn);
+        pCompiler->offChunk    = KMK_CC_EVAL_NO_CHUNK;
     }
-    else if (pCompiler->pEvalProg->pszVarName)
-        fprintf(stderr, "%s:%u: *** fatal parsing error in %s: ",
-                pCompiler->pEvalProg->pszFilename, pCompiler->iLine, pCompiler->pEvalProg->pszVarName);
-    else
-        fprintf(stderr, "%s:%u: *** fatal parsing error: ",
-                pCompiler->pEvalProg->pszFilename, pCompiler->iLine);
-
-    /*
-     * Print the message and die.
-     */
-    va_start(va, pszMsg);
-    vfprintf(stderr, pszMsg, va);
-    va_end(va);
-    fputs(".  Stop.\n", stderr);
-
-    for (;;)
-        die(2);
 }
 
 
-static KMK_CC_FN_NO_RETURN void
-kmk_cc_eval_fatal_eol(PKMKCCEVALCOMPILER pCompiler, const char *pchEol, unsigned iLine, size_t offLine)
-{
-    pCompiler->iLine   = iLine;
-    pCompiler->offLine = offLine;
-
-    for (;;)
-        kmk_cc_eval_fatal(pCompiler, pchEol, "Missing 2nd EOL character: found %#x instead of %#x\n",
-                          pchEol, pCompiler->chSecondEol);
+/**
+ * Allocates an instruction, emitting any pending chunk first.
+ *
+ * @returns Pointer to the instruction core.
+ * @param   pCompiler   The compiler state.
+ * @param   cb          The size of the instruction.
+ * @param   enmOpcode   The instruction opcode.
+ */
+static PKMKCCEVALCORE kmk_cc_eval_alloc_instr(PKMKCCEVALCOMPILER pCompiler, size_t cb, KMKCCEVALINSTR enmOpcode)
+{
+    PKMKCCEVALCORE pCore;
+    kmk_cc_eval_flush_chunk(pCompiler);
+    pCore = kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, (uint32_t)cb);
+    pCore->enmOpcode = enmOpcode;
+    pCore->iLine     = pCompiler->iLine;
+    KMK_CC_EVAL_DPRINTF(("%u: %s\n", pCore->iLine, g_apszEvalInstrNms[enmOpcode]));
+    return pCore;
 }
 
 
-static void kmk_cc_eval_warn(PKMKCCEVALCOMPILER pCompiler, const char *pchWhere, const char *pszMsg, ...)
+/**
+ * Adds the current line to the pending chunk, starting a new one if needed.
+ *
+ * @param   pCompiler   The compiler state.
+ * @param   fEndsRule   Whether the interpreter will record any waiting rule
+ *                      before dealing with this line.  If not, we cannot
+ *                      start a new chunk while there might be one waiting.
+ */
+static void kmk_cc_eval_add_chunk_line(PKMKCCEVALCOMPILER pCompiler, int fEndsRule)
 {
-    va_list  va;
-
-    log_working_directory(1);
-
-    /*
-     * If we have a pointer location, use it to figure out the exact line and column.
-     */
-    if (pchWhere)
+    if (pCompiler->offChunk == KMK_CC_EVAL_NO_CHUNK)
     {
-        unsigned iColumn;
-        unsigned iLine = kmk_cc_eval_translate_location(pCompiler, pchWhere, &iColumn);
-
-        if (pCompiler->pEvalProg->pszVarName)
-            fprintf(stderr, "%s:%u:%u: *** warning in %s: ",
-                    pCompiler->pEvalProg->pszFilename, iLine, iColumn, pCompiler->pEvalProg->pszVarName);
-        else
-            fprintf(stderr, "%s:%u:%u: *** warning: ",
-                    pCompiler->pEvalProg->pszFilename, iLine, iColumn);
+        if (!fEndsRule && pCompiler->fRuleMaybePending)
+            kmk_cc_eval_fatal(pCompiler, NULL, "Rule may be pending, cannot start a new chunk");
+        pCompiler->offChunk   = pCompiler->offLine;
+        pCompiler->iChunkLine = pCompiler->iLine;
     }
-    else if (pCompiler->pEvalProg->pszVarName)
-        fprintf(stderr, "%s:%u: *** warning in %s: ",
-                pCompiler->pEvalProg->pszFilename, pCompiler->iLine, pCompiler->pEvalProg->pszVarName);
-    else
-        fprintf(stderr, "%s:%u: *** warning: ",
-                pCompiler->pEvalProg->pszFilename, pCompiler->iLine);
-
-    /*
-     * Print the message.
-     */
-    va_start(va, pszMsg);
-    vfprintf(stderr, pszMsg, va);
-    va_end(va);
-    fputs(".\n", stderr);
+    pCompiler->offChunkEnd       = pCompiler->offEol;
+    pCompiler->fRuleMaybePending = 1;
 }
 
 
 /**
- * Compiles a string expansion subprogram.
+ * Finds the end of the logical line starting at @a offLine.
  *
+ * Lines are split the same way as readstring() does it.
+ *
+ * @returns The offset of the next line.
  * @param   pCompiler   The compiler state.
- * @param   pszExpr     The expression to compile.
- * @param   cchExpr     The length of the expression.
- * @param   pSubprog    The subprogram to compile.
+ * @param   offLine     The start of the line.
+ * @param   poffEol     Where to return the end of the line (sans newline).
+ * @param   pcLines     Where to return the number of physical lines.
  */
-static void kmk_cc_eval_compile_string_exp_subprog(PKMKCCEVALCOMPILER pCompiler, const char *pszExpr, size_t cchExpr,
-                                                   PKMKCCEXPSUBPROG pSubprog)
+static size_t kmk_cc_eval_find_eol(PKMKCCEVALCOMPILER pCompiler, size_t offLine, size_t *poffEol, unsigned *pcLines)
 {
-    int rc = kmk_cc_exp_compile_subprog(pCompiler->ppBlockTail, pszExpr, cchExpr, pSubprog);
-    if (rc == 0)
-        return;
-    kmk_cc_eval_fatal(pCompiler, NULL, "String expansion compile error");
+    const char * const  pszContent = pCompiler->pszContent;
+    size_t const        cchContent = pCompiler->cchContent;
+    size_t              off        = offLine;
+    unsigned            cLines     = 1;
+    for (;;)
+    {
+        size_t      offNewline;
+        size_t      offBackslash;
+        int         fEscaped   = 0;
+        const char *pchNewline = (const char *)memchr(&pszContent[off], '\n', cchContent - off);
+        if (!pchNewline)
+        {
+            *poffEol = cchContent;
+            *pcLines = cLines;
+            return cchContent;
+        }
+
+        offNewline   = pchNewline - pszContent;
+        offBackslash = offNewline;
+        while (offBackslash > off && pszContent[offBackslash - 1] == '\\')
+        {
+            offBackslash--;
+            fEscaped = !fEscaped;
+        }
+        if (!fEscaped)
+        {
+            *poffEol = offNewline;
+            *pcLines = cLines;
+            return offNewline + 1;
+        }
+
+        off = offNewline + 1;
+        cLines++;
+    }
 }
 
 
 /**
- * Initializes a subprogam or plain operand structure.
+ * Gets a scratch buffer of at least @a cb bytes.
  *
+ * @returns Pointer to the scratch buffer.
  * @param   pCompiler   The compiler state.
- * @param   pOperand    The subprogram or plain structure to init.
- * @param   pszString   The string.
- * @param   cchString   The length of the string.
- * @param   fPlain      Whether it's plain or not.  If not, we'll compile it.
+ * @param   cb          The required size.
  */
-static void kmk_cc_eval_init_subprogram_or_plain(PKMKCCEVALCOMPILER pCompiler, PKMKCCEXPSUBPROGORPLAIN pOperand,
-                                                 const char *pszString, size_t cchString, int fPlain)
+static char *kmk_cc_eval_get_scratch(PKMKCCEVALCOMPILER pCompiler, size_t cb)
 {
-    pOperand->fPlainIsInVarStrCache  = 0;
-    pOperand->bUser                  = 0;
-    pOperand->bUser2                 = 0;
-    pOperand->fSubprog               = fPlain;
-    if (fPlain)
+    if (cb > pCompiler->cbScratch)
     {
-        pOperand->u.Plain.cch = cchString;
-        pOperand->u.Plain.psz = pszString;
+        pCompiler->cbScratch  = (cb + 255) & ~(size_t)255;
+        pCompiler->pszScratch = (char *)xrealloc(pCompiler->pszScratch, pCompiler->cbScratch);
     }
-    else
-        kmk_cc_eval_compile_string_exp_subprog(pCompiler, pszString, cchString, &pOperand->u.Subprog);
+    return pCompiler->pszScratch;
 }
 
+
 /**
  * Initializes an array of subprogram-or-plain (spp) operands from a word array.
  *
@@ -3349,28 +3528,14 @@ static void kmk_cc_eval_init_subprogram_or_plain(PKMKCCEVALCOMPILER pCompiler, P
  * @param   paDst       The destination subprogram-or-plain array.
  */
 static void kmk_cc_eval_init_spp_array_from_duplicated_words(PKMKCCEVALCOMPILER pCompiler, unsigned cWords,
-                                                             PKMKCCEVALWORD paSrc, PKMKCCEXPSUBPROGORPLAIN paDst)
+                                                             PCKMKCCEVALWORD paSrc, PKMKCCEXPSUBPROGORPLAIN paDst)
 {
     unsigned i;
     for (i = 0; i < cWords; i++)
     {
-        const char *pszCopy = kmk_cc_block_strdup(pCompiler->ppBlockTail, paSrc[i].pchWord, paSrc[i].cchWord);
-        paDst[i].fPlainIsInVarStrCache  = 0;
-        paDst[i].bUser                  = 0;
-        paDst[i].bUser2                 = 0;
-        if (paSrc[i].enmToken == kKmkCcEvalToken_WordWithDollar)
-        {
-            paDst[i].fSubprog    = 1;
-            kmk_cc_block_realign(pCompiler->ppBlockTail);
-            kmk_cc_eval_compile_string_exp_subprog(pCompiler, pszCopy, paSrc[i].cchWord, &paDst[i].u.Subprog);
-        }
-        else
-        {
-            paDst[i].fSubprog    = 0;
-            paDst[i].u.Plain.cch = paSrc[i].cchWord;
-            paDst[i].u.Plain.psz = pszCopy;
-        }
-        KMK_CC_EVAL_DPRINTF(("  %s\n", pszCopy));
+        kmk_cc_eval_init_operand(pCompiler, &paDst[i], paSrc[i].pchWord, paSrc[i].cchWord,
+                                 paSrc[i].enmToken == kKmkCcEvalToken_WordWithDollar /*fExpand*/);
+        KMK_CC_EVAL_DPRINTF(("  %.*s\n", (int)paSrc[i].cchWord, paSrc[i].pchWord));
     }
 }
 
@@ -3484,18 +3649,16 @@ static void kmk_cc_eval_init_spp_array_from_duplicated_words(PKMKCCEVALCOMPILER
     (   (a_cchLeft) == (a_cchConst) \
      && KMK_CC_WORD_COMP_CONST_##a_cchConst(a_pchLeft, a_pszConst) )
 
-/** See if a starting of a given length starts with a constant word. */
-#define KMK_CC_EVAL_WORD_COMP_IS_EOL(a_pCompiler, a_pchLine, a_cchLine) \
+/** See if we're at the end of a word (end of line or space). */
+#define KMK_CC_EVAL_WORD_COMP_IS_EOL(a_pchLine, a_cchLine) \
     (   (a_cchLine) == 0 \
-     || KMK_CC_EVAL_IS_SPACE((a_pchLine)[0]) \
-     || ((a_pchLine)[0] == '\\' && (a_pchLine)[1] == (a_pCompiler)->chFirstEol) ) \
+     || KMK_CC_EVAL_IS_SPACE((a_pchLine)[0]) )
 
 /** See if a starting of a given length starts with a constant word. */
-#define KMK_CC_EVAL_WORD_COMP_CONST(a_pCompiler, a_pchLine, a_cchLine, a_pszWord, a_cchWord) \
+#define KMK_CC_EVAL_WORD_COMP_CONST(a_pchLine, a_cchLine, a_pszWord, a_cchWord) \
     (    (a_cchLine) >= (a_cchWord) \
       && (   (a_cchLine) == (a_cchWord) \
-          || KMK_CC_EVAL_IS_SPACE((a_pchLine)[a_cchWord]) \
-          || ((a_pchLine)[a_cchWord] == '\\' && (a_pchLine)[(a_cchWord) + 1] == (a_pCompiler)->chFirstEol) ) \
+          || KMK_CC_EVAL_IS_SPACE((a_pchLine)[a_cchWord]) ) \
       && KMK_CC_WORD_COMP_CONST_##a_cchWord(a_pchLine, a_pszWord) )
 /** @} */
 
@@ -3503,165 +3666,28 @@ static void kmk_cc_eval_init_spp_array_from_duplicated_words(PKMKCCEVALCOMPILER
 /**
  * Checks if a_ch is a space after a word.
  *
- * Since there is always a terminating zero, the user can safely access a char
- * beyond @a a_cchLeft.  However, that byte isn't necessarily a zero terminator
- * character, so we have to check @a a_cchLeft whether we're at the end of the
- * parsing input string.
- *
  * @returns true / false.
- * @param   a_pCompiler     The compiler instance data.
  * @param   a_ch            The character to inspect.
- * @param   a_ch2           The character following it, in case of escaped EOL.
  * @param   a_cchLeft       The number of chars left to parse (from @a a_ch).
  */
-#define KMK_CC_EVAL_IS_SPACE_AFTER_WORD(a_pCompiler, a_ch, a_ch2, a_cchLeft) \
-    (   a_cchLeft == 0 \
-     || KMK_CC_EVAL_IS_SPACE(a_ch) \
-     || ((a_ch) == '\\' && (a_ch2) == (a_pCompiler)->chFirstEol) )
+#define KMK_CC_EVAL_IS_SPACE_AFTER_WORD(a_ch, a_cchLeft) \
+    (   (a_cchLeft) == 0 \
+     || KMK_CC_EVAL_IS_SPACE(a_ch) )
 
 
 /**
- * Common path for space skipping worker functions when escaped EOLs may be
- * involed.
+ * Worker for KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD and KMK_CC_EVAL_SKIP_SPACES
+ * when there are two or more spaces in a row.
  *
  * @returns Points to the first non-space character or end of input.
- * @param   pchWord         The current position. There is some kind of char
- * @param   cchLeft         The current number of chars left to parse in the
- *                          current line.
- * @param   pcchLeft        Where to store the updated @a cchLeft value.
- * @param   pCompiler       The compiler instance data.
+ * @param   pchWord         The current position.
+ * @param   pcchLeft        The current number of chars left to parse in the
+ *                          current line.  Will be updated.
  */
-static const char *kmk_cc_eval_skip_spaces_with_esc_eol(const char *pchWord, size_t cchLeft, size_t *pcchLeft,
-                                                        PKMKCCEVALCOMPILER pCompiler)
+static const char *kmk_cc_eval_skip_spaces_slow(const char *pchWord, size_t *pcchLeft)
 {
-    /*
-     * Skip further spaces. We unrolls 4 loops here.
-     * ASSUMES cchEscEolSeq is either 2 or 3!
-     */
-    KMK_CC_ASSERT(pCompiler->cchEscEolSeq == 2 || pCompiler->cchEscEolSeq == 3);
-    KMK_CC_ASSERT(pCompiler->iEscEol < pCompiler->cEscEols);
-    while (cchLeft >= 4)
-    {
-        /* First char. */
-        char ch = pchWord[0];
-        if (KMK_CC_EVAL_IS_SPACE(ch))
-        { /* maybe likely */ }
-        else if (   ch == '\\'
-                 && pchWord[1] == pCompiler->chFirstEol)
-        {
-            pchWord += pCompiler->cchEscEolSeq;
-            cchLeft -= pCompiler->cchEscEolSeq;
-            pCompiler->iEscEol++;
-            continue;
-        }
-        else
-        {
-            *pcchLeft = cchLeft;
-            return pchWord;
-        }
-
-        /* Second char. */
-        ch = pchWord[1];
-        if (KMK_CC_EVAL_IS_SPACE(ch))
-        { /* maybe likely */ }
-        else if (   ch == '\\'
-                 && pchWord[2] == pCompiler->chFirstEol)
-        {
-            pchWord += 1 + pCompiler->cchEscEolSeq;
-            cchLeft -= 1 + pCompiler->cchEscEolSeq;
-            pCompiler->iEscEol++;
-            continue;
-        }
-        else
-        {
-            *pcchLeft = cchLeft - 1;
-            return pchWord + 1;
-        }
-
-        /* Third char. */
-        ch = pchWord[2];
-        if (KMK_CC_EVAL_IS_SPACE(ch))
-        { /* maybe likely */ }
-        else if (   ch == '\\'
-                 && pchWord[3] == pCompiler->chFirstEol
-                 && cchLeft >= 2 + pCompiler->cchEscEolSeq)
-        {
-            pchWord += 2 + pCompiler->cchEscEolSeq;
-            cchLeft -= 2 + pCompiler->cchEscEolSeq;
-            pCompiler->iEscEol++;
-            continue;
-        }
-        else
-        {
-            *pcchLeft = cchLeft - 2;
-            return pchWord + 2;
-        }
-
-        /* Third char. */
-        ch = pchWord[3];
-        if (KMK_CC_EVAL_IS_SPACE(ch))
-        {
-            pchWord += 4;
-            cchLeft -= 4;
-        }
-        else if (   ch == '\\'
-                 && cchLeft >= 3 + pCompiler->cchEscEolSeq
-                 && pchWord[4] == pCompiler->chFirstEol)
-        {
-            pchWord += 3 + pCompiler->cchEscEolSeq;
-            cchLeft -= 3 + pCompiler->cchEscEolSeq;
-            pCompiler->iEscEol++;
-        }
-        else
-        {
-            *pcchLeft = cchLeft - 3;
-            return pchWord + 3;
-        }
-    }
-
-    /*
-     * Simple loop for the final three chars.
-     */
-    while (cchLeft > 0)
-    {
-        /* First char. */
-        char ch = *pchWord;
-        if (KMK_CC_EVAL_IS_SPACE(ch))
-        {
-            pchWord += 1;
-            cchLeft -= 1;
-        }
-        else if (   ch == '\\'
-                 && cchLeft > pCompiler->cchEolSeq
-                 && pchWord[1] == pCompiler->chFirstEol)
-        {
-            pchWord += pCompiler->cchEscEolSeq;
-            cchLeft -= pCompiler->cchEscEolSeq;
-            pCompiler->iEscEol++;
-        }
-        else
-            break;
-    }
-
-    *pcchLeft = cchLeft;
-    return pchWord;
-}
-
+    size_t cchLeft = *pcchLeft;
 
-/**
- * Common path for space skipping worker functions when no escaped EOLs need
- * considering.
- *
- * @returns Points to the first non-space character or end of input.
- * @param   pchWord         The current position. There is some kind of char
- * @param   cchLeft         The current number of chars left to parse in the
- *                          current line.
- * @param   pcchLeft        Where to store the updated @a cchLeft value.
- * @param   pCompiler       The compiler instance data.
- */
-static const char *kmk_cc_eval_skip_spaces_without_esc_eol(const char *pchWord, size_t cchLeft, size_t *pcchLeft,
-                                                           PKMKCCEVALCOMPILER pCompiler)
-{
     /*
      * 4x loop unroll.
      */
@@ -3704,554 +3730,106 @@ static const char *kmk_cc_eval_skip_spaces_without_esc_eol(const char *pchWord,
     }
 
     /*
-     * The last 3. Not entirely sure if this yield good code.
+     * The last 3. Not entirely sure if this yield any performance benefit.
      */
-    switch (cchLeft & 3)
+    while (cchLeft > 0 && KMK_CC_EVAL_IS_SPACE(*pchWord))
     {
-        case 3:
-            if (!KMK_CC_EVAL_IS_SPACE(*pchWord))
-                break;
-            pchWord++;
-            cchLeft--;
-        case 2:
-            if (!KMK_CC_EVAL_IS_SPACE(*pchWord))
-                break;
-            pchWord++;
-            cchLeft--;
-        case 1:
-            if (!KMK_CC_EVAL_IS_SPACE(*pchWord))
-                break;
-            pchWord++;
-            cchLeft--;
-        case 0:
-            break;
+        pchWord++;
+        cchLeft--;
     }
-
     *pcchLeft = cchLeft;
     return pchWord;
 }
 
 
 /**
- * Used to skip spaces after a word.
+ * Skips to the end of a variable name.
  *
- * We ASSUME that the first char is a space or that we've reached the end of the
- * string (a_cchLeft == 0).
+ * This is used for the first word after a keyword, so the current char is
+ * known to be a space or we're at the end of the input.
  *
- * @param   a_pCompiler     The compiler instance data.
  * @param   a_pchWord       The current input position, this will be moved to
  *                          the start of the next word or end of the input.
  * @param   a_cchLeft       The number of chars left to parse.  This will be
  *                          updated.
  */
-#define KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(a_pCompiler, a_pchWord, a_cchLeft) \
+#define KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(a_pchWord, a_cchLeft) \
     do { \
-        /* Skip the first char which is known to be a space, end of line or end of input. */ \
+        /* Skip the first char which is known to be a space or end of input. */ \
         if ((a_cchLeft) > 0) \
         { \
-            char const chSkipBlanksFirst = *(a_pchWord); \
-            KMK_CC_ASSERT(KMK_CC_EVAL_IS_SPACE_AFTER_WORD(a_pCompiler, chSkipBlanksFirst, (a_pchWord)[1], a_cchLeft)); \
-            if (chSkipBlanksFirst != '\\') \
-            { \
-                (a_pchWord) += 1; \
-                (a_cchLeft) -= 1; \
-                \
-                /* Another space or escaped EOL? Then there are probably more then, so call worker function. */ \
-                if ((a_cchLeft) > 0) \
-                { \
-                    char const chSkipBlanksSecond = *(a_pchWord); \
-                    if (KMK_CC_EVAL_IS_SPACE_OR_BACKSLASH(chSkipBlanksSecond)) \
-                        (a_pchWord) = kmk_cc_eval_skip_spaces_after_word_slow(a_pchWord, &(a_cchLeft), \
-                                                                              chSkipBlanksSecond, a_pCompiler); \
-                } \
-            } \
-            else /* escape sequences can be complicated. */ \
-                (a_pchWord) = kmk_cc_eval_skip_spaces_after_word_slow(a_pchWord, &(a_cchLeft), \
-                                                                      chSkipBlanksFirst, a_pCompiler); \
+            KMK_CC_ASSERT(KMK_CC_EVAL_IS_SPACE_AFTER_WORD(*(a_pchWord), a_cchLeft)); \
+            (a_pchWord) += 1; \
+            (a_cchLeft) -= 1; \
+            \
+            /* Another space? Then there are probably more, so call worker function. */ \
+            if ((a_cchLeft) > 0 && KMK_CC_EVAL_IS_SPACE(*(a_pchWord))) \
+                (a_pchWord) = kmk_cc_eval_skip_spaces_slow(a_pchWord, &(a_cchLeft)); \
         } \
     } while (0)
 
-/**
- * The slow path of KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD.
- *
- * This is called to handles escaped EOL sequences, as these can involve
- * multiple backslashes and therefore doesn't led themselves well to inlined
- * code.
- *
- * The other case this is used for is to handle more than once space, since it's
- * likely that when there are two there might be more.  No point in inlining
- * that, better do some loop unrolling instead.
- *
- * @returns Points to the first non-space character or end of input.
- * @param   pchWord             The current position. There is some kind of char
- * @param   pcchLeft            Pointer to the cchLeft variable, this is both
- *                              input and output.
- * @param   ch                  The current character.
- * @param   pCompiler           The compiler instance data.
- */
-static const char *kmk_cc_eval_skip_spaces_after_word_slow(const char *pchWord, size_t *pcchLeft, char ch,
-                                                           PKMKCCEVALCOMPILER pCompiler)
-{
-    size_t cchLeft = *pcchLeft;
-
-    /*
-     * It's all very simple when we don't have to consider escaped EOLs.
-     */
-    if (pCompiler->iEscEol >= pCompiler->cEscEols)
-    {
-        if (ch != '\\')
-        {
-            pchWord += 1;
-            cchLeft -= 1;
-        }
-        else
-            return pchWord;
-        return kmk_cc_eval_skip_spaces_without_esc_eol(pchWord, cchLeft, pcchLeft, pCompiler);
-    }
-
-    /*
-     * Skip the pending space or EOL found by the caller.  We need to
-     * confirm the EOL.
-     *
-     * Note! We only need to care about simple backslash+EOL sequences here
-     *       since we're either at the end of a validated word, or we've already
-     *       skipped one space.  In the former case, someone else has already
-     *       validated the escape esequence, in the latter case multiple
-     *       backslashes would indicate a new word that that we should return.
-     */
-    if (ch != '\\')
-    {
-        pchWord += 1;
-        cchLeft -= 1;
-    }
-    else if (   cchLeft >= pCompiler->cchEscEolSeq
-             && pchWord[1] == pCompiler->chFirstEol)
-    {
-        KMK_CC_ASSERT(pCompiler->cchEolSeq == 1 || pchWord[2] == pCompiler->chSecondEol);
-        pchWord += pCompiler->cchEscEolSeq;
-        cchLeft -= pCompiler->cchEscEolSeq;
-        pCompiler->iEscEol++;
-
-        if (pCompiler->iEscEol < pCompiler->cEscEols)
-        { /* likely */ }
-        else return kmk_cc_eval_skip_spaces_without_esc_eol(pchWord, cchLeft, pcchLeft, pCompiler);
-    }
-    else
-        return pchWord;
-    return kmk_cc_eval_skip_spaces_with_esc_eol(pchWord, cchLeft, pcchLeft, pCompiler);
-}
-
 
 /**
- * Skip zero or more spaces.
- *
- * This macro deals with a single space, if there are more or we're hittin some
- * possible escaped EOL sequence, work is deferred to a worker function.
+ * Skips zero or more spaces.
  *
- * @param   a_pCompiler The compiler state.
  * @param   a_pchWord   The current input position. Advanced past spaces.
  * @param   a_cchLeft   The amount of input left to parse. Will be updated.
  */
-#define KMK_CC_EVAL_SKIP_SPACES(a_pCompiler, a_pchWord, a_cchLeft) \
+#define KMK_CC_EVAL_SKIP_SPACES(a_pchWord, a_cchLeft) \
     do { \
-        if ((a_cchLeft) > 0) \
+        if ((a_cchLeft) > 0 && KMK_CC_EVAL_IS_SPACE(*(a_pchWord))) \
         { \
-            char chSkipSpaces = *(a_pchWord); \
-            if (KMK_CC_EVAL_IS_SPACE_OR_BACKSLASH(chSkipSpaces)) \
-            { \
-                if (chSkipSpaces != '\\') \
-                { \
-                    (a_pchWord) += 1; \
-                    (a_cchLeft) -= 1; \
-                    chSkipSpaces = *(a_pchWord); \
-                    if (KMK_CC_EVAL_IS_SPACE_OR_BACKSLASH(chSkipSpaces)) \
-                        (a_pchWord) = kmk_cc_eval_skip_spaces_slow(a_pchWord, &(a_cchLeft), chSkipSpaces, a_pCompiler); \
-                } \
-                else \
-                    (a_pchWord) = kmk_cc_eval_skip_spaces_slow(a_pchWord, &(a_cchLeft), chSkipSpaces, a_pCompiler); \
-            } \
+            (a_pchWord) += 1; \
+            (a_cchLeft) -= 1; \
+            if ((a_cchLeft) > 0 && KMK_CC_EVAL_IS_SPACE(*(a_pchWord))) \
+                (a_pchWord) = kmk_cc_eval_skip_spaces_slow(a_pchWord, &(a_cchLeft)); \
         } \
     } while (0)
 
 
 /**
- * Worker for KMK_CC_EVAL_SKIP_SPACES.
- *
- * @returns Points to the first non-space character or end of input.
- * @param   pchWord             The current position. There is some kind of char
- * @param   pcchLeft            Pointer to the cchLeft variable, this is both
- *                              input and output.
- * @param   ch                  The current character.
- * @param   pCompiler           The compiler instance data.
- */
-static const char *kmk_cc_eval_skip_spaces_slow(const char *pchWord, size_t *pcchLeft, char ch, PKMKCCEVALCOMPILER pCompiler)
-{
-    size_t cchLeft = *pcchLeft;
-#ifdef KMK_CC_STRICT
-    size_t offWordCcStrict = pchWord - pCompiler->pszContent;
-#endif
-    KMK_CC_ASSERT(cchLeft > 0);
-    KMK_CC_ASSERT(cchLeft <= pCompiler->cchLine);
-    KMK_CC_ASSERT(*pchWord == ch);
-    KMK_CC_ASSERT(KMK_CC_EVAL_IS_SPACE_OR_BACKSLASH(ch));
-    KMK_CC_ASSERT(offWordCcStrict >= pCompiler->offLine);
-    KMK_CC_ASSERT(offWordCcStrict < pCompiler->offLine + pCompiler->cchLine);
-    KMK_CC_ASSERT(   pCompiler->iEscEol >= pCompiler->cEscEols
-                  || offWordCcStrict <= pCompiler->paEscEols[pCompiler->iEscEol].offEsc);
-    KMK_CC_ASSERT(   pCompiler->iEscEol >= pCompiler->cEscEols
-                  || pCompiler->iEscEol == 0
-                  || offWordCcStrict >= pCompiler->paEscEols[pCompiler->iEscEol - 1].offEol + pCompiler->cchEolSeq);
-
-    /*
-     * If we don't need to consider escaped EOLs, things are much much simpler.
-     */
-    if (pCompiler->iEscEol >= pCompiler->cEscEols)
-    {
-        if (ch != '\\')
-        {
-            pchWord++;
-            cchLeft--;
-        }
-        else
-            return pchWord;
-        return kmk_cc_eval_skip_spaces_without_esc_eol(pchWord, cchLeft, pcchLeft, pCompiler);
-    }
-
-    /*
-     * Possible escaped EOL complications.
-     */
-    if (ch != '\\')
-    {
-        pchWord++;
-        cchLeft--;
-    }
-    else
-    {
-        size_t          cchSkip;
-        size_t          offWord;
-        unsigned        iEscEol = pCompiler->iEscEol;
-        if (iEscEol >= pCompiler->cEscEols)
-            return pchWord;
-
-        offWord = pchWord - pCompiler->pszContent;
-        if (offWord < pCompiler->paEscEols[iEscEol].offEsc)
-            return pchWord;
-        KMK_CC_ASSERT(offWord == pCompiler->paEscEols[iEscEol].offEsc);
-
-        cchSkip  = pCompiler->paEscEols[iEscEol].offEol + pCompiler->cchEolSeq - offWord;
-        pchWord += cchSkip;
-        cchLeft -= cchSkip;
-        pCompiler->iEscEol = ++iEscEol;
-
-        if (iEscEol < pCompiler->cEscEols)
-        { /* likely */ }
-        else return kmk_cc_eval_skip_spaces_without_esc_eol(pchWord, cchLeft, pcchLeft, pCompiler);
-    }
-    return kmk_cc_eval_skip_spaces_with_esc_eol(pchWord, cchLeft, pcchLeft, pCompiler);
-}
-
-
-#if 0 /* unused - probably forever. */
-/**
- * Skips to the end of a variable name.
+ * Skips a variable reference or function call in a variable name.
  *
- * This may advance pCompiler->iEscEol.
+ * Like parse_variable_definition(), we only count parentheses of the same
+ * kind as the opening one.
  *
- * @returns Pointer to the first char after the variable name.
+ * @returns Offset of the first char following the reference.
  * @param   pCompiler   The compiler state.
- * @param   pchWord     The current position. Must be at the start of the
- *                      variable name.
- * @param   cchLeft     The number of chars left to parse in the current line.
- * @param   pcchLeft    The to store the updated count of characters left to
- *                      parse.
- * @param   pfPlain     Where to store the plain variable name indicator.
- *                      Returns 0 if plain, and 1 if there are variable
- *                      references in it.
- */
-static const char *kmk_cc_eval_skip_var_name(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
-                                             size_t *pcchLeft, int *pfPlain)
-{
-    const char * const  pszContent = pCompiler->pszContent;
-    size_t              off        = pchWord - pszContent;
-    size_t const        offLineEnd = off + cchLeft;
-    int                 fPlain     = 1;
-    unsigned            iEscEol    = pCompiler->iEscEol;
-
-    /* Check our expectations. */
-    KMK_CC_ASSERT(cchLeft);
-    KMK_CC_ASSERT(!KMK_CC_EVAL_IS_SPACE(*pchWord));
-    KMK_CC_ASSERT(iEscEol <= pCompiler->cEscEols);
-    KMK_CC_ASSERT(   iEscEol >= pCompiler->cEscEols
-                  || off < pCompiler->paEscEols[iEscEol].offEol);
-    KMK_CC_ASSERT(off >= (iEscEol == 0 ? pCompiler->offLine : pCompiler->paEscEols[iEscEol - 1].offEol + pCompiler->cchEolSeq));
-
-    /*
-     * The outer loop parses plain text.  Variable expansion ($) is handled
-     * by the inner loop.
-     */
-    while (off < offLineEnd)
-    {
-        char ch = pszContent[off];
-        if (!KMK_CC_EVAL_IS_SPACE_DOLLAR_OR_SLASH(ch))
-            off++;
-        else if (KMK_CC_EVAL_IS_SPACE(ch))
-            break;
-        else if (ch == '$')
-        {
-            off++;
-            if (off < offLineEnd)
-            {
-                char const chOpen = pszContent[off];
-                if (chOpen == '(' || chOpen == '{')
-                {
-                    /*
-                     * Got a $(VAR) or ${VAR} to deal with here.  This may
-                     * include nested variable references and span multiple
-                     * lines (at least for function calls).
-                     *
-                     * We scan forward till we've found the corresponding
-                     * closing parenthesis, considering any open parentheses
-                     * of the same kind as worth counting, even if there are
-                     * no dollar preceeding them, just like GNU make does.
-                     */
-                    size_t const offStart = off - 1;
-                    char const   chClose  = chOpen == '(' ? ')' : '}';
-                    unsigned     cOpen    = 1;
-                    off++;
-                    for (;;)
-                    {
-                        if (off < offLineEnd)
-                        {
-                            ch = pszContent[off];
-                            if (!(KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch)))
-                                off++;
-                            else
-                            {
-                                off++;
-                                if (ch == chClose)
-                                {
-                                    if (--cOpen == 0)
-                                        break;
-                                }
-                                else if (ch == chOpen)
-                                    cOpen++;
-                                else if (   ch == '\\'
-                                         && iEscEol < pCompiler->cEscEols
-                                         && off == pCompiler->paEscEols[iEscEol].offEsc)
-                                {
-                                    off = pCompiler->paEscEols[iEscEol].offEol + pCompiler->cchEolSeq;
-                                    pCompiler->iEscEol = ++iEscEol;
-                                }
-                            }
-                        }
-                        else if (cOpen == 1)
-                            kmk_cc_eval_fatal(pCompiler, &pszContent[offStart],
-                                              "Variable reference is missing '%c'", chClose);
-                        else
-                            kmk_cc_eval_fatal(pCompiler, &pszContent[offStart],
-                                              "%u variable references are missing '%c'", cOpen, chClose);
-                    }
-                }
-                /* Single char variable name. */
-                else if (!KMK_CC_EVAL_IS_SPACE(chOpen))
-                {  /* likely */ }
-                else
-                    kmk_cc_eval_fatal(pCompiler, &pszContent[off], "Expected variable name after '$', not end of line");
-            }
-            else
-                kmk_cc_eval_fatal(pCompiler, &pszContent[off], "Expected variable name after '$', not end of line");
-            fPlain = 0;
-        }
-        /* Deal with potential escaped EOL. */
-        else if (   ch != '\\'
-                 || iEscEol >= pCompiler->cEscEols
-                 || off != pCompiler->paEscEols[iEscEol].offEsc )
-            off++;
-        else
-            break;
-    }
-
-    *pcchLeft = offLineEnd - off;
-    *pfPlain  = fPlain;
-    return &pszContent[off];
-}
-#endif /* unused */
-
-
-#if 0  /* unused atm */
-/**
- * Prepares for copying a command line.
- *
- * The current version of this code will not modify any of the paEscEols
- * entries, unlike our kmk_cc_eval_prep_normal_line sibling function.
- *
- * @returns The number of chars that will be copied by
- *          kmk_cc_eval_copy_prepped_command_line().
- * @param   pCompiler   The compiler instance data.
- * @param   pchLeft     Pointer to the first char to copy from the current line.
- *                      This does not have to the start of a word.
- * @param   cchLeft     The number of chars left on the current line starting at
- *                      @a pchLeft.
+ * @param   pch         The string.
+ * @param   cchLeft     The length of the string.
+ * @param   off         The offset of the dollar.
  */
-static size_t kmk_cc_eval_prep_command_line(PKMKCCEVALCOMPILER pCompiler, const char * const pchLeft, size_t cchLeft)
-{
-    size_t          cchRet;
-    unsigned        iEscEol  = pCompiler->iEscEol;
-    unsigned const  cEscEols = pCompiler->cEscEols;
-
-    KMK_CC_ASSERT(cchLeft > 0);
-    KMK_CC_ASSERT(iEscEol <= cEscEols);
-
-    if (iEscEol >= cEscEols)
-    {
-        /*
-         * No escaped EOLs left, dead simple.
-         */
-        cchRet = cchLeft;
-    }
-    else
-    {
-        /*
-         * Compared to the normal prepping of a line, this is actually
-         * really simple.  We need to account for two kind of conversions:
-         *      - One leading tab is skipped after escaped EOL.
-         *      - Convert EOL to LF.
-         */
-        const char * const  pszContent = pCompiler->pszContent;
-        size_t       const  cchEolSeq  = pCompiler->cchEolSeq;
-
-#ifdef KMK_CC_STRICT
-        size_t const offLeft   = pchLeft - pszContent;
-        KMK_CC_ASSERT(offLeft + cchLeft <= pCompiler->offLine + pCompiler->cchLine);
-        KMK_CC_ASSERT(offLeft + cchLeft <= pCompiler->cchContent);
-        KMK_CC_ASSERT(offLeft <  pCompiler->paEscEols[iEscEol].offEsc);
-        KMK_CC_ASSERT(offLeft >= (iEscEol ? pCompiler->paEscEols[cEscEols - 1].offEol + pCompiler->cchEolSeq : pCompiler->offLine));
-#endif
-
-        cchRet = cchLeft;
-        if (cchEolSeq > 1)
-            cchRet -= (cchEolSeq - 1) * cEscEols;
-        do
-        {
-            if (pszContent[pCompiler->paEscEols[cchEolSeq].offEol])
-                cchRet--;
-            iEscEol++;
-        } while (iEscEol < cEscEols);
-    }
-    return cchRet;
-}
-
-
-/**
- * Copies a command line to the buffer @a pszDst points to.
- *
- * Must only be used immediately after kmk_cc_eval_prep_command_line().
- *
- * @returns
- * @param   pCompiler   The compiler instance data.
- * @param   pchLeft     Pointer to the first char to copy from the current line.
- *                      This does not have to the start of a word.
- * @param   cchPrepped  The return value of kmk_cc_eval_prep_command_line().
- * @param   pszDst      The destination buffer, must be at least @a cchPrepped
- *                      plus one (terminator) char big.
- */
-static void kmk_cc_eval_copy_prepped_command_line(PKMKCCEVALCOMPILER pCompiler, const char *pchLeft,
-                                                  size_t cchPrepped, char *pszDst)
-{
-    unsigned        iEscEol  = pCompiler->iEscEol;
-    unsigned const  cEscEols = pCompiler->cEscEols;
-    if (iEscEol >= cEscEols)
-    {
-        /* Single line. */
-        memcpy(pszDst, pchLeft, cchPrepped);
-        pszDst[cchPrepped] = '\0';
-    }
-    else
-    {
-        /* Multiple lines with normalized EOL and maybe one stripped leading TAB. */
-        char * const        pszDstStart = pszDst;
-        const char * const  pszContent  = pCompiler->pszContent;
-        size_t const        cchEolSeq   = pCompiler->cchEolSeq;
-        size_t              offLeft     = pchLeft - pCompiler->pszContent;
-        size_t              cchCopy;
-
-        do
-        {
-            size_t offEol = pCompiler->paEscEols[iEscEol].offEsc;
-            cchCopy = offEol - offLeft;
-            KMK_CC_ASSERT(offEol >= offLeft);
-
-            memcpy(pszDst, &pszContent[offLeft], cchCopy);
-            pszDst += cchCopy;
-            *pszDst += '\n';
-
-            offLeft = offEol + cchEolSeq;
-            if (pszContent[offLeft] == '\t')
-                offLeft++;
-        } while (iEscEol < cEscEols);
-
-        cchCopy = cchPrepped - (pszDst - pszDstStart);
-        KMK_CC_ASSERT(cchCopy <= cchPrepped);
-        memcpy(pszDst, &pszContent[offLeft], cchCopy);
-        pszDst += cchCopy;
-
-        *pszDst = '\0';
-        KMK_CC_ASSERT(pszDst == &pszDstStart[cchPrepped]);
-    }
-}
-#endif /* unused atm */
-
-
 static size_t kmk_cc_eval_parse_var_exp(PKMKCCEVALCOMPILER pCompiler, const char *pch, size_t cchLeft, size_t off)
 {
     off++;
     if (off < cchLeft)
     {
-        char const chOpen = pch[++off];
+        char const chOpen = pch[off++];
         if (chOpen == '(' || chOpen == '{')
         {
             /*
-             * Got a $(VAR) or ${VAR} to deal with here.  This may include nested
-             * variable references and span multiple lines (at least for function
-             * calls).
-             *
-             * We scan forward till we've found the corresponding closing
-             * parenthesis, considering any open parentheses of the same kind as
-             * worth counting, even if there are no dollar preceeding them, just
-             * like GNU make does.
+             * Got a $(VAR) or ${VAR} to deal with here.  We scan forward till
+             * we've found the corresponding closing parenthesis, considering any
+             * open parentheses of the same kind as worth counting, even if there
+             * are no dollar preceeding them, just like GNU make does.
              */
-            size_t const offStart = off - 1;
+            size_t const offStart = off - 2;
             char const   chClose  = chOpen == '(' ? ')' : '}';
             unsigned     cOpen    = 1;
-            off++;
             for (;;)
             {
                 if (off < cchLeft)
                 {
-                    char ch = pch[off];
-                    if (!(KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch)))
-                        off++;
-                    else
+                    char const ch = pch[off++];
+                    if (!KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch))
+                    { /* likely */ }
+                    else if (ch == chClose)
                     {
-                        off++;
-                        if (ch == chClose)
-                        {
-                            if (--cOpen == 0)
-                                break;
-                        }
-                        else if (ch == chOpen)
-                            cOpen++;
-                        else if (   ch == '\\'
-                                 && pCompiler->iEscEol < pCompiler->cEscEols
-                                 &&    (size_t)(&pch[off] - pCompiler->pszContent)
-                                    == pCompiler->paEscEols[pCompiler->iEscEol].offEsc)
-                        {
-                            off += pCompiler->paEscEols[pCompiler->iEscEol].offEol
-                                 - pCompiler->paEscEols[pCompiler->iEscEol].offEsc
-                                 + pCompiler->cchEolSeq;
-                            pCompiler->iEscEol++;
-                        }
+                        if (--cOpen == 0)
+                            break;
                     }
+                    else if (ch == chOpen)
+                        cOpen++;
                 }
                 else if (cOpen == 1)
                     kmk_cc_eval_fatal(pCompiler, &pch[offStart], "Variable reference is missing '%c'", chClose);
@@ -4260,14 +3838,10 @@ static size_t kmk_cc_eval_parse_var_exp(PKMKCCEVALCOMPILER pCompiler, const char
                                       "%u variable references are missing '%c'", cOpen, chClose);
             }
         }
-        /* Single char variable name. */
-        else if (!KMK_CC_EVAL_IS_SPACE(chOpen))
-        {  /* likely */ }
-        else
-            kmk_cc_eval_fatal(pCompiler, &pch[off], "Expected variable name after '$', not space ");
+        /* else: Single char variable name ('$$' included). */
     }
     else
-        kmk_cc_eval_fatal(pCompiler, &pch[off], "Expected variable name after '$', end of line");
+        kmk_cc_eval_fatal(pCompiler, &pch[off - 1], "Expected variable name after '$', end of line");
     return off;
 }
 
@@ -4276,23 +3850,22 @@ static size_t kmk_cc_eval_parse_var_exp(PKMKCCEVALCOMPILER pCompiler, const char
  */
 #define KMK_CC_EVAL_ENSURE_WORDS(a_pCompiler, a_cRequiredWords) \
     do { \
-        if ((a_cRequiredWords) < (a_pCompiler)->cWordsAllocated) \
+        if ((a_cRequiredWords) <= (a_pCompiler)->cWordsAllocated) \
         { /* likely */ } \
         else \
         { \
-            unsigned cEnsureWords = ((a_cRequiredWords) + 3 /*15*/) & ~(unsigned)3/*15*/; \
-            KMK_CC_ASSERT((a_cRequiredWords) < 0x8000); \
+            unsigned cEnsureWords = ((a_cRequiredWords) + 15) & ~(unsigned)15; \
             (a_pCompiler)->paWords = (PKMKCCEVALWORD)xrealloc((a_pCompiler)->paWords, \
                                                               cEnsureWords * sizeof((a_pCompiler)->paWords)[0]); \
+            (a_pCompiler)->cWordsAllocated = cEnsureWords; \
         } \
     } while (0)
 
 
 /**
- * Word parser helper function for dealing with dollars, simple variant that
- * doesn't need to take multiple lines into account.
+ * Word parser helper function for dealing with dollars.
  *
- * @returns New word length placing us after the
+ * @returns New word length placing us after the variable reference.
  * @param   pCompiler   The compiler state.
  * @param   cchWord     Offset of the dollar into pchWord.
  * @param   pchWord     The word we're currently parsing.
@@ -4306,8 +3879,8 @@ K_INLINE size_t kmk_cc_eval_parse_along_dollar_simple(PKMKCCEVALCOMPILER pCompil
     if (cchWord < cchLeft)
     {
         /*
-         * Got a $(VAR) or ${VAR} to deal with here.  This may include nested variable
-         * references and span multiple lines (at least for function calls).
+         * Got a $(VAR) or ${VAR} to deal with here.  This may include nested
+         * variable references.
          *
          * We scan forward till we've found the corresponding closing parenthesis,
          * considering any open parentheses of the same kind as worth counting, even
@@ -4317,173 +3890,36 @@ K_INLINE size_t kmk_cc_eval_parse_along_dollar_simple(PKMKCCEVALCOMPILER pCompil
          */
         unsigned   cOpens = 1;
         char const chOpen = pchWord[cchWord++];
+        char       chClose;
         if (chOpen == '(')
-        {
-            for (;;)
-            {
-                if (cchWord < cchLeft)
-                {
-                    char const ch = pchWord[cchWord++];
-                    if (!KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch))
-                    { /* likely */ }
-                    else if (ch == ')')
-                    {
-                        if (--cOpens == 0)
-                            return cchWord;
-                    }
-                    else if (ch == '(')
-                       cOpens++;
-                }
-                else
-                    break;
-            }
-        }
+            chClose = ')';
         else if (chOpen == '{')
+            chClose = '}';
+        else
+            return cchWord;
+
+        while (cchWord < cchLeft)
         {
-            for (;;)
+            char const ch = pchWord[cchWord++];
+            if (!KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch))
+            { /* likely */ }
+            else if (ch == chClose)
             {
-                if (cchWord < cchLeft)
-                {
-                    char const ch = pchWord[cchWord++];
-                    if (!KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch))
-                    { /* likely */ }
-                    else if (ch == '}')
-                    {
-                        if (--cOpens == 0)
-                            return cchWord;
-                    }
-                    else if (ch == '{')
-                       cOpens++;
-                }
-                else
-                    break;
+                if (--cOpens == 0)
+                    return cchWord;
             }
+            else if (ch == chOpen)
+               cOpens++;
         }
-        else
-            return cchWord;
-
-        /* Unterminated. */
-        if (cOpens == 1)
-            kmk_cc_eval_fatal(pCompiler, &pchWord[cchStart],
-                              "Variable reference is missing '%c'", chOpen == '(' ? ')' : '}');
-        else
-            kmk_cc_eval_fatal(pCompiler, &pchWord[cchStart],
-                              "%u variable references are missing '%c'", cOpens, chOpen == '(' ? ')' : '}');
-    }
-    else
-        kmk_cc_eval_warn(pCompiler, &pchWord[cchWord - 1], "found '$' at end of line");
-    return cchWord;
-}
-
-
-/**
- * Word parser helper function for dealing with dollars, complicated variant
- * that takes escaped EOLs into account.
- *
- * @returns New word length placing us after the
- * @param   pCompiler   The compiler state.
- * @param   cchWord     Offset of the dollar into pchWord.
- * @param   pchWord     The word we're currently parsing.
- * @param   cchLeft     How much we've got left to parse.
- */
-static size_t kmk_cc_eval_parse_along_dollar_esc_eol(PKMKCCEVALCOMPILER pCompiler, size_t cchWord,
-                                                     const char *pchWord, size_t cchLeft)
-{
-    const size_t cchStart = cchWord;
-    cchWord++;
-    if (cchWord < cchLeft)
-    {
-        /*
-         * Got a $(VAR) or ${VAR} to deal with here.  This may include nested variable
-         * references and span multiple lines (at least for function calls).
-         *
-         * We scan forward till we've found the corresponding closing parenthesis,
-         * considering any open parentheses of the same kind as worth counting, even
-         * if there are no dollar preceeding them, just like GNU make does.
-         *
-         * We leave the other parenthesis type to the expansion compiler to deal with.
-         */
-        unsigned   cOpens = 1;
-        char const chOpen = pchWord[cchWord++];
-        if (chOpen == '(')
-        {
-            for (;;)
-            {
-                if (cchWord < cchLeft)
-                {
-                    char const ch = pchWord[cchWord++];
-                    if (!KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch))
-                    { /* likely */ }
-                    else if (ch == ')')
-                    {
-                        if (--cOpens == 0)
-                            return cchWord;
-                    }
-                    else if (ch == '(')
-                       cOpens++;
-                    else if (ch == '\\')
-                    {
-                        unsigned const iEscEol = pCompiler->iEscEol;
-                        if (   iEscEol < pCompiler->cEscEols
-                            && (size_t)(&pchWord[cchWord] - pCompiler->pszContent) == pCompiler->paEscEols[iEscEol].offEsc)
-                        {
-                            cchWord += pCompiler->paEscEols[iEscEol].offEol
-                                     - pCompiler->paEscEols[iEscEol].offEsc
-                                     + pCompiler->cchEolSeq;
-                            pCompiler->iEscEol = iEscEol + 1;
-                        }
-                    }
-                }
-                else
-                    break;
-            }
-        }
-        else if (chOpen == '{')
-        {
-            for (;;)
-            {
-                if (cchWord < cchLeft)
-                {
-                    char const ch = pchWord[cchWord++];
-                    if (!KMK_CC_EVAL_IS_PAREN_OR_SLASH(ch))
-                    { /* likely */ }
-                    else if (ch == '}')
-                    {
-                        if (--cOpens == 0)
-                            return cchWord;
-                    }
-                    else if (ch == '{')
-                       cOpens++;
-                    else if (ch == '\\')
-                    {
-                        unsigned const iEscEol = pCompiler->iEscEol;
-                        if (   iEscEol < pCompiler->cEscEols
-                            && (size_t)(&pchWord[cchWord] - pCompiler->pszContent) == pCompiler->paEscEols[iEscEol].offEsc)
-                        {
-                            cchWord += pCompiler->paEscEols[iEscEol].offEol
-                                     - pCompiler->paEscEols[iEscEol].offEsc
-                                     + pCompiler->cchEolSeq;
-                            pCompiler->iEscEol = iEscEol + 1;
-                        }
-                    }
-                }
-                else
-                    break;
-            }
-        }
-        else
-            return cchWord;
 
         /* Unterminated. */
         if (cOpens == 1)
-            kmk_cc_eval_fatal(pCompiler, &pchWord[cchStart],
-                              "Variable reference is missing '%c'", chOpen == '(' ? ')' : '}');
+            kmk_cc_eval_fatal(pCompiler, &pchWord[cchStart], "Variable reference is missing '%c'", chClose);
         else
             kmk_cc_eval_fatal(pCompiler, &pchWord[cchStart],
-                              "%u variable references are missing '%c'", cOpens, chOpen == '(' ? ')' : '}');
+                              "%u variable references are missing '%c'", cOpens, chClose);
     }
-    else
-        kmk_cc_eval_warn(pCompiler, &pchWord[cchWord - 1], "found '$' at end of line");
+    /* else: '$' at the end of the line expands to nothing. */
     return cchWord;
 }
 
@@ -4491,8 +3927,8 @@ static size_t kmk_cc_eval_parse_along_dollar_esc_eol(PKMKCCEVALCOMPILER pCompile
 /**
  * Parses the remainder of the line into simple words.
  *
- * The resulting words are classified as either kKmkCcEvalToken_WordPlain,
- * kKmkCcEvalToken_WordWithDollar, or kKmkCcEvalToken_WordWithDollarAndEscEol.
+ * The resulting words are classified as either kKmkCcEvalToken_WordPlain or
+ * kKmkCcEvalToken_WordWithDollar.
  *
  * @returns Number of words.
  * @param   pCompiler   The compiler state.
@@ -4502,2885 +3938,1518 @@ static size_t kmk_cc_eval_parse_along_dollar_esc_eol(PKMKCCEVALCOMPILER pCompile
  */
 static unsigned kmk_cc_eval_parse_words(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-    unsigned iEscEol  = pCompiler->iEscEol;
-    unsigned cEscEols = pCompiler->cEscEols;
-    unsigned cWords   = 0;
+    unsigned cWords = 0;
 
     /* Precoditions. */
     KMK_CC_ASSERT(cchLeft > 0);
     KMK_CC_ASSERT(!KMK_CC_EVAL_IS_SPACE(*pchWord));
 
-    /*
-     * If we don't have to deal with escaped EOLs, the find-end-of word search
-     * becomes a little bit simpler.  Since this function will be used a lot
-     * for simple lines with single words, this could maybe save a nano second
-     * or two.
-     */
-    if (iEscEol >= cEscEols)
+    do
     {
-        do
-        {
-            size_t          cchSkipAfter = 0;
-            size_t          cchWord      = 0;
-            KMKCCEVALTOKEN  enmToken     = kKmkCcEvalToken_WordPlain;
+        size_t          cchWord  = 0;
+        KMKCCEVALTOKEN  enmToken = kKmkCcEvalToken_WordPlain;
 
-            /* Find the end of the current word. */
-            while (cchWord < cchLeft)
+        /* Find the end of the current word. */
+        while (cchWord < cchLeft)
+        {
+            char ch = pchWord[cchWord];
+            if (!KMK_CC_EVAL_IS_SPACE_OR_DOLLAR(ch))
+                cchWord++;
+            else if (ch == '$')
             {
-                char ch = pchWord[cchWord];
-                if (!KMK_CC_EVAL_IS_SPACE_OR_DOLLAR(ch))
-                    cchWord++;
-                else if (ch == '$')
-                {
-#ifdef XXXX
-                    cchWord = kmk_cc_eval_parse_var_exp(pCompiler, pchWord, cchLeft, cchWord);
-                    enmToken = kKmkCcEvalToken_WordWithDollar;
-#else
-                    enmToken = kKmkCcEvalToken_WordWithDollar;
-                    cchWord = kmk_cc_eval_parse_along_dollar_simple(pCompiler, cchWord, pchWord, cchLeft);
-#endif
-                }
-                else
-                    break;
+                enmToken = kKmkCcEvalToken_WordWithDollar;
+                cchWord  = kmk_cc_eval_parse_along_dollar_simple(pCompiler, cchWord, pchWord, cchLeft);
             }
+            else
+                break;
+        }
 
-            /* Add the word. */
-            KMK_CC_EVAL_ENSURE_WORDS(pCompiler, cWords + 1);
-            pCompiler->paWords[cWords].pchWord            = pchWord;
-            pCompiler->paWords[cWords].cchWord            = cchWord;
-            pCompiler->paWords[cWords].enmToken           = enmToken;
-            cWords++;
-
-            /* Skip the work and any trailing blanks. */
-            cchWord += cchSkipAfter;
-            pchWord += cchWord;
-            cchLeft -= cchWord;
-            KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        } while (cchLeft > 0);
-    }
-    /*
-     * Have to deal with escaped EOLs.
-     */
-    else
-    {
-        const char *pszContent = pCompiler->pszContent;
-        do
-        {
-            size_t          cchSkipAfter = 0;
-            size_t          cchWord      = 0;
-            KMKCCEVALTOKEN  enmToken     = kKmkCcEvalToken_WordPlain;
+        /* Add the word. */
+        KMK_CC_EVAL_ENSURE_WORDS(pCompiler, cWords + 1);
+        pCompiler->paWords[cWords].pchWord  = pchWord;
+        pCompiler->paWords[cWords].cchWord  = (uint32_t)cchWord;
+        pCompiler->paWords[cWords].enmToken = enmToken;
+        cWords++;
 
-            /* Find the end of the current word. */
-            while (cchWord < cchLeft)
-            {
-                char ch = pchWord[cchWord];
-                if (!KMK_CC_EVAL_IS_SPACE_DOLLAR_OR_SLASH(ch))
-                    cchWord++;
-                else if (ch == '$')
-#ifdef XXXX
-                {
-                    const unsigned iEscEolBefore = pCompiler->iEscEol;
-                    cchWord = kmk_cc_eval_parse_var_exp(pCompiler, pchWord, cchLeft, cchWord);
-                    enmToken = pCompiler->iEscEol == iEscEolBefore
-                             ? kKmkCcEvalToken_WordWithDollar : kKmkCcEvalToken_WordWithDollarAndEscEol;
-                }
-#else
-                {
-                    enmToken = kKmkCcEvalToken_WordWithDollar;
-                    cchWord = kmk_cc_eval_parse_along_dollar_esc_eol(pCompiler, cchWord, pchWord, cchLeft);
-                }
-#endif
-                else if (ch != '\\')
-                    break;
-                else if ((size_t)(&pchWord[cchWord] - pszContent) != pCompiler->paEscEols[iEscEol].offEsc)
-                    cchWord++;
-                else
-                {
-                    cchSkipAfter = pCompiler->paEscEols[iEscEol].offEol - pCompiler->paEscEols[iEscEol].offEsc
-                                 + pCompiler->cchEolSeq;
-                    iEscEol++;
-                    break;
-                }
-            }
+        /* Skip the work and any trailing blanks. */
+        pchWord += cchWord;
+        cchLeft -= cchWord;
+        KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    } while (cchLeft > 0);
 
-            /* Add the word. */
-            KMK_CC_EVAL_ENSURE_WORDS(pCompiler, cWords + 1);
-            pCompiler->paWords[cWords].pchWord  = pchWord;
-            pCompiler->paWords[cWords].cchWord  = cchWord;
-            pCompiler->paWords[cWords].enmToken = enmToken;
-            cWords++;
-
-            /* Skip the work and any trailing blanks. */
-            cchWord += cchSkipAfter;
-            pchWord += cchWord;
-            cchLeft -= cchWord;
-            KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        } while (cchLeft > 0);
-    }
     pCompiler->cWords = cWords;
     return cWords;
 }
 
 
 /**
- * Parses the remainder of the line into target words.
- *
- * The resulting words are classified as either kKmkCcEvalToken_WordPlain or
- * kKmkCcEvalToken_WordWithDollar.
+ * Checks whether all the words from kmk_cc_eval_parse_words are plain and free
+ * of backslashes, i.e. whether splitting them up front is safe.
  *
- * @returns Number of words.
+ * @returns 1 if they are, 0 if not.
  * @param   pCompiler   The compiler state.
- * @param   pchWord     Where to start, we expect this to be at a word.
- * @param   cchLeft     The number of chars left to parse on this line.
- *                      This is expected to be non-zero.
  */
-static unsigned kmk_cc_eval_parse_recipe_words(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
+static int kmk_cc_eval_are_words_plain(PKMKCCEVALCOMPILER pCompiler)
 {
-    unsigned iEscEol  = pCompiler->iEscEol;
-    unsigned cEscEols = pCompiler->cEscEols;
-    unsigned cWords   = 0;
-
-    /* Precoditions. */
-    KMK_CC_ASSERT(cchLeft > 0);
-    KMK_CC_ASSERT(!KMK_CC_EVAL_IS_SPACE(*pchWord));
-
-    /*
-     * If we don't have to deal with escaped EOLs, the find-end-of word search
-     * becomes a little bit simpler.  Since this function will be used a lot
-     * for simple lines with single words, this could maybe save a nano second
-     * or two.
-     */
-    if (iEscEol >= cEscEols)
-    {
-        do
-        {
-            size_t          cchSkipAfter = 0;
-            size_t          cchWord      = 0;
-            KMKCCEVALTOKEN  enmToken     = kKmkCcEvalToken_WordPlain;
-
-            /* Find the end of the current word. */
-            while (cchWord < cchLeft)
-            {
-                char ch = pchWord[cchWord];
-                if (!KMK_CC_EVAL_IS_SPACE_OR_DOLLAR(ch))
-                    cchWord++;
-                else if (ch == '$')
-                {
-                    enmToken = kKmkCcEvalToken_WordWithDollar;
-                    cchWord = kmk_cc_eval_parse_along_dollar_simple(pCompiler, cchWord, pchWord, cchLeft);
-                }
-                else
-                    break;
-            }
-
-            /* Add the word. */
-            KMK_CC_EVAL_ENSURE_WORDS(pCompiler, cWords + 1);
-            pCompiler->paWords[cWords].pchWord  = pchWord;
-            pCompiler->paWords[cWords].cchWord  = cchWord;
-            pCompiler->paWords[cWords].enmToken = enmToken;
-            cWords++;
-
-            /* Skip the work and any trailing blanks. */
-            cchWord += cchSkipAfter;
-            pchWord += cchWord;
-            cchLeft -= cchWord;
-            KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        } while (cchLeft > 0);
-    }
-    /*
-     * Have to deal with escaped EOLs.
-     */
-    else
-    {
-        const char *pszContent = pCompiler->pszContent;
-        do
-        {
-            size_t          cchSkipAfter = 0;
-            size_t          cchWord      = 0;
-            KMKCCEVALTOKEN  enmToken     = kKmkCcEvalToken_WordPlain;
-
-            /* Find the end of the current word. */
-            while (cchWord < cchLeft)
-            {
-                char ch = pchWord[cchWord];
-                if (!KMK_CC_EVAL_IS_SPACE_DOLLAR_OR_SLASH(ch))
-                    cchWord++;
-                else if (ch == '$')
-                {
-                    enmToken = kKmkCcEvalToken_WordWithDollar;
-                    cchWord = kmk_cc_eval_parse_along_dollar_esc_eol(pCompiler, cchWord, pchWord, cchLeft);
-                }
-                else if (ch != '\\')
-                    break;
-                else if ((size_t)(&pchWord[cchWord] - pszContent) != pCompiler->paEscEols[iEscEol].offEsc)
-                    cchWord++;
-                else
-                {
-                    cchSkipAfter = pCompiler->paEscEols[iEscEol].offEol - pCompiler->paEscEols[iEscEol].offEsc
-                                 + pCompiler->cchEolSeq;
-                    iEscEol++;
-                    break;
-                }
-            }
-
-            /* Add the word. */
-            KMK_CC_EVAL_ENSURE_WORDS(pCompiler, cWords + 1);
-            pCompiler->paWords[cWords].pchWord  = pchWord;
-            pCompiler->paWords[cWords].cchWord  = cchWord;
-            pCompiler->paWords[cWords].enmToken = enmToken;
-            cWords++;
-
-            /* Skip the work and any trailing blanks. */
-            cchWord += cchSkipAfter;
-            pchWord += cchWord;
-            cchLeft -= cchWord;
-            KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        } while (cchLeft > 0);
-    }
-    pCompiler->cWords = cWords;
-    return cWords;
+    unsigned iWord;
+    for (iWord = 0; iWord < pCompiler->cWords; iWord++)
+        if (   pCompiler->paWords[iWord].enmToken != kKmkCcEvalToken_WordPlain
+            || memchr(pCompiler->paWords[iWord].pchWord, '\\', pCompiler->paWords[iWord].cchWord))
+            return 0;
+    return 1;
 }
 
-
-
-
 /**
- * Gather string from segments and optional space insertion trick.
+ * Common worker for all the conditionals, pushing or linking it.
+ *
+ * Must be called after the operands have been initialized and the allocator
+ * realigned.
  *
- * @param   pszDst          The destination buffer.
- * @param   paSegs          The source segments.
- * @param   cSegs           The number of segments.
- * @param   cchDstPrepped   The size of pszDst, excluding the terminator.
+ * @param   pCompiler   The compiler state.
+ * @param   pIfCore     The new IF statement.
+ * @param   fInElse     Set if this is an 'else if' (rather than just 'if').
  */
-static void kmk_cc_eval_strcpyv(char *pszDst, PCKMKCCEVALSTRCPYSEG paSegs, unsigned cSegs, size_t cchDstPrepped)
+static void kmk_cc_eval_do_if_core(PKMKCCEVALCOMPILER pCompiler, PKMKCCEVALIFCORE pIfCore, int fInElse)
 {
-    const char *pszDstStart = pszDst;
-    unsigned    iSeg = 0;
-    while (iSeg < cSegs)
+    unsigned iIf = pCompiler->cIfs;
+    if (!fInElse)
     {
-        size_t cchToCopy;
-        if (paSegs[iSeg].cchSrcAndPrependSpace >= 0)
-            cchToCopy = paSegs[iSeg].cchSrcAndPrependSpace;
-        else
+        /* Push an IF statement. */
+        if (iIf < KMK_CC_EVAL_MAX_IF_DEPTH)
         {
-            cchToCopy = -paSegs[iSeg].cchSrcAndPrependSpace;
-            *pszDst++ = ' ';
+            pCompiler->cIfs = iIf + 1;
+            pCompiler->apIfs[iIf] = pIfCore;
+            pIfCore->pPrevCond = NULL;
         }
-
-        memcpy(pszDst, paSegs[iSeg].pchSrc, cchToCopy);
-        pszDst += cchToCopy;
-
-        iSeg++;
+        else
+            kmk_cc_eval_fatal(pCompiler, NULL, "Too deep conditional nesting (max %u)", KMK_CC_EVAL_MAX_IF_DEPTH);
+    }
+    else
+    {
+        /* Link an IF statement. */
+        KMK_CC_ASSERT(iIf > 0);
+        iIf--;
+        pIfCore->pPrevCond    = pCompiler->apIfs[iIf];
+        pCompiler->apIfs[iIf] = pIfCore;
     }
-    *pszDst = '\0';
-    KMK_CC_ASSERT(pszDst == &pszDstStart[cchDstPrepped]); K_NOREF(pszDstStart); K_NOREF(cchDstPrepped);
+    pIfCore->pNextTrue    = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
+    pIfCore->pNextFalse   = NULL; /* This is set by else or endif. */
+    pIfCore->pTrueEndJump = NULL; /* This is set by else or endif. */
 }
 
 
+#ifdef CONFIG_WITH_IF_CONDITIONALS
 /**
- * Allocate a byte buffer and ocpy the prepared string segments into it.
- *
- * The caller must call kmk_cc_block_realign!
+ * Deals with 'if expr' and 'else if expr' statements.
  *
- * @returns Pointer to the duplicated string.
- * @param   pCompiler       The compiler instance data.
- * @param   cchPrepped      The length of the prepped string segments.
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after 'if'.
+ * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   fInElse     Set if this is an 'else if' (rather than just 'if').
  */
-static char *kmk_cc_eval_strdup_prepped(PKMKCCEVALCOMPILER pCompiler, size_t cchPrepped)
+static int kmk_cc_eval_do_if(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse)
 {
-    char *pszCopy = kmk_cc_block_byte_alloc(pCompiler->ppBlockTail, cchPrepped + 1);
-    kmk_cc_eval_strcpyv(pszCopy, pCompiler->paStrCopySegs, pCompiler->cStrCopySegs, cchPrepped);
-    return pszCopy;
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (cchLeft > 0 && cchLeft < 0xffff)
+    {
+        PKMKCCEVALIFEXPR pInstr;
+        pInstr = (PKMKCCEVALIFEXPR)kmk_cc_eval_alloc_instr(pCompiler, KMKCCEVALIFEXPR_SIZE(cchLeft), kKmkCcEvalInstr_if);
+        pInstr->cchExpr = (uint16_t)cchLeft;
+        memcpy(pInstr->szExpr, pchWord, cchLeft);
+        pInstr->szExpr[cchLeft] = '\0';
+        kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
+    }
+    else if (cchLeft == 0)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Expected expression after 'if' directive");
+    else
+        kmk_cc_eval_fatal(pCompiler, pchWord, "Too long 'if' expression");
+    return 1;
 }
+#endif /* CONFIG_WITH_IF_CONDITIONALS */
 
 
 /**
- * Strip trailing spaces from prepped copy
+ * Deals with 'ifdef', 'ifndef', 'else ifdef' and 'else ifndef' statements.
  *
- * @param   paSegs          The segments to strip trailing chars from.
- * @param   pcSegs          The number of segments (in/out).
- * @param   pcchDstPrepped  The total number of chars prepped (in/out).
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after 'ifdef' or 'ifndef'.
+ * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   fInElse     Set if this is an 'else if' (rather than just 'if').
+ * @param   fPositiveStmt   Set if 'ifdef', clear if 'ifndef'.
  */
-static void kmk_cc_eval_strip_right_v(PKMKCCEVALSTRCPYSEG paSegs, unsigned *pcSegs, size_t *pcchDstPrepped)
+static int kmk_cc_eval_do_ifdef(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse,
+                                int fPositiveStmt)
 {
-    /*
-     * Work our way thru the segments, from the end obviously.
-     */
-    size_t   cchDstPrepped = *pcchDstPrepped;
-    unsigned cSegs         = *pcSegs;
-    while (cSegs > 0)
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (cchLeft)
     {
-        unsigned    iSeg   = cSegs - 1;
-        const char *pszSrc = paSegs[iSeg].pchSrc;
-        size_t      cchSrc = paSegs[iSeg].cchSrcAndPrependSpace >= 0
-                           ? paSegs[iSeg].cchSrcAndPrependSpace : -paSegs[iSeg].cchSrcAndPrependSpace;
-        if (cchSrc)
+        /*
+         * GNU make expands the whole remainder and requires it to be a single
+         * word, so when there is something to expand, we have to check at runtime.
+         */
+        unsigned const cWords = kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft);
+        if (!memchr(pchWord, '$', cchLeft))
         {
-            /*
-             * Check for trailing spaces.
-             */
-            size_t cchSrcOrg;
-            if (!KMK_CC_EVAL_IS_SPACE(pszSrc[cchSrc - 1]))
-            {
-                /* Special case: No trailing spaces at all. No need to update
-                                 input/output variables. */
-                if (cSegs == *pcSegs)
-                    return;
-                break;
-            }
-
-            /* Skip the rest of the trailing spaces. */
-            cchSrcOrg = cchSrc;
-            do
-                cchSrc--;
-            while (cchSrc > 0 && KMK_CC_EVAL_IS_SPACE(pszSrc[cchSrc - 1]));
-
-            if (cchSrc > 0)
-            {
-                /*
-                 * There are non-space chars in this segment. So, update the
-                 * segment and total char count and we're done.
-                 */
-                cchDstPrepped -= cchSrcOrg - cchSrc;
-                if (paSegs[iSeg].cchSrcAndPrependSpace < 0)
-                    paSegs[iSeg].cchSrcAndPrependSpace = -(ssize_t)cchSrc;
-                else
-                    paSegs[iSeg].cchSrcAndPrependSpace = cchSrc;
-                break;
-            }
-
-            /*
-             * Skip the whole segment.
-             */
-            cchDstPrepped -= cchSrcOrg + (paSegs[iSeg].cchSrcAndPrependSpace < 0);
+            PKMKCCEVALIFDEFPLAIN pInstr;
+            if (cWords != 1)
+                kmk_cc_eval_fatal(pCompiler, pCompiler->paWords[1].pchWord,
+                                  "Bogus stuff after '%s' variable name", fPositiveStmt ? "ifdef" : "ifndef");
+
+            pInstr = (PKMKCCEVALIFDEFPLAIN)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pInstr),
+                                                                   fPositiveStmt ? kKmkCcEvalInstr_ifdef_plain
+                                                                   : kKmkCcEvalInstr_ifndef_plain);
+            pInstr->pszName = strcache2_add(&variable_strcache, pCompiler->paWords[0].pchWord,
+                                            pCompiler->paWords[0].cchWord);
+            kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
+        }
+        else
+        {
+            PKMKCCEVALIFDEFDYNAMIC pInstr;
+            pInstr = (PKMKCCEVALIFDEFDYNAMIC)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pInstr),
+                                                                     fPositiveStmt ? kKmkCcEvalInstr_ifdef_dynamic
+                                                                     : kKmkCcEvalInstr_ifndef_dynamic);
+            kmk_cc_eval_init_operand(pCompiler, &pInstr->Name, pchWord, cchLeft, 1 /*fExpand*/);
+            kmk_cc_block_realign(pCompiler->ppBlockTail);
+            kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
         }
-        cSegs--;
     }
-    *pcchDstPrepped = cchDstPrepped;
-    *pcSegs         = cSegs;
+    else
+        kmk_cc_eval_fatal(pCompiler, NULL, "Expected variable name after '%s'", fPositiveStmt ? "ifdef" : "ifndef");
+    return 1;
 }
 
-/**
- * Helper for ensuring that we've got sufficient number of string copy segments.
- */
-#define KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(a_pCompiler, a_cRequiredSegs) \
-    do { \
-        if ((a_cRequiredSegs) < (a_pCompiler)->cStrCopySegsAllocated) \
-        { /* likely */ } \
-        else \
-        { \
-            unsigned cEnsureSegs = ((a_cRequiredSegs) + 3 /*15*/) & ~(unsigned)3/*15*/; \
-            KMK_CC_ASSERT((a_cRequiredSegs) < 0x8000); \
-            (a_pCompiler)->paStrCopySegs = (PKMKCCEVALSTRCPYSEG)xmalloc(cEnsureSegs * sizeof((a_pCompiler)->paStrCopySegs)[0]); \
-        } \
-    } while (0)
-
 
 /**
- * Prepares for copying a normal line, extended version.
- *
- * This does not assume that we start on a word, it can handle any starting
- * character.  It can also prepare partial copies.
+ * Deals with the ifeq, ifneq, if1of and ifn1of statements (and their 'else'
+ * variants), parsing the arguments like conditional_line() does.
  *
- * In addition to the returned information, this will store instruction in
- * paEscEols for the following kmk_cc_eval_strcpyv() call.
- *
- * This will advance pCompiler->iEscEol, so that it's possible to use the common
- * macros and helpers for parsing what comes afterwards.
- *
- * @returns The number of chars that will be copied by kmk_cc_eval_strcpyv().
- * @param   pCompiler               The compiler instance data.
- * @param   pchWord                 Pointer to the first char to copy from the
- *                                  current line. This must be the start of a
- *                                  word.
- * @param   cchLeft                 The number of chars left on the current line
- *                                  starting at @a pchWord.
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after the directive.
+ * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   fInElse     Set if this is an 'else if' (rather than just 'if').
+ * @param   enmOpcode   The instruction to emit.
  */
-static size_t kmk_cc_eval_prep_normal_line_ex(PKMKCCEVALCOMPILER pCompiler, const char * const pchWord, size_t cchLeft)
+static int kmk_cc_eval_do_ifeq(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse,
+                               KMKCCEVALINSTR enmOpcode)
 {
-    size_t          cchRet;
-    unsigned        iEscEol  = pCompiler->iEscEol;
-    unsigned const  cEscEols = pCompiler->cEscEols;
+    PKMKCCEVALIFEQ  pInstr;
+    const char     *pszLine;
+    const char     *pszLeft;
+    size_t          cchLeftArg;
+    const char     *pszRight;
+    size_t          cchRightArg;
+    char            chTerm;
 
-    KMK_CC_ASSERT(iEscEol <= cEscEols);
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (!cchLeft)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Expected '(' or quoted string after conditional directive");
+    KMK_CC_ASSERT(pchWord[cchLeft] == '\0');
+    pszLine = pchWord;
 
-    if (cchLeft > 0)
-    {
-        /*
-         * If there are no escaped EOLs left, just copy exactly
-         * what was passed in.
-         */
-        if (iEscEol >= cEscEols)
-        {
-            KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, 1);
-            pCompiler->cStrCopySegs = 1;
-            pCompiler->paStrCopySegs[0].pchSrc = pchWord;
-            pCompiler->paStrCopySegs[0].cchSrcAndPrependSpace = cchRet = cchLeft;
-        }
-        /*
-         * Ok, we have to deal with escaped EOLs and do the proper
-         * replacement of escaped newlines with space.  The deal is that we
-         * collaps all whitespace before and after one or more newlines into a
-         * single space.  (FreeBSD make does this differently, by the by.)
-         */
-        else
-        {
-            const char * const  pszContent    = pCompiler->pszContent;
-            size_t              offWord       = pchWord - pCompiler->pszContent;
-            size_t const        offLineEnd    = offWord + cchLeft;             /* Note! Not necessarily end of line.*/
-            size_t              offEsc;
-            size_t              fPendingSpace = 0;
-            unsigned            cSegs         = 0;
-            size_t              cchSeg;
-
-            /* Go nuts checking our preconditions here. */
-            KMK_CC_ASSERT(offWord >= pCompiler->offLine);
-            KMK_CC_ASSERT(offWord + cchLeft <= pCompiler->offLine + pCompiler->cchLine);
-            KMK_CC_ASSERT(offWord + cchLeft <= pCompiler->cchContent);
-            KMK_CC_ASSERT(offWord <= pCompiler->paEscEols[iEscEol].offEsc);
-            KMK_CC_ASSERT(offWord >= (iEscEol ? pCompiler->paEscEols[cEscEols - 1].offEol + pCompiler->cchEolSeq
-                                              : pCompiler->offLine));
-            KMK_CC_ASSERT(offWord <  offLineEnd);
-
-            /* Make sure we've got more than enough segments to fill in. */
-            KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, cEscEols - iEscEol + 2);
-
-            /*
-             * All but the last line.
-             */
-            cchRet = 0;
-            do
-            {
-                KMK_CC_ASSERT(offWord < offLineEnd);
-                offEsc = pCompiler->paEscEols[iEscEol].offEsc;
-                if (offWord < offEsc)
-                {
-                    /* Strip trailing spaces. */
-                    while (offEsc > offWord && KMK_CC_EVAL_IS_SPACE(pszContent[offEsc - 1]))
-                        offEsc--;
-                    cchSeg = offEsc - offWord;
-                    if (cchSeg)
-                    {
-                        /* Add segment. */
-                        pCompiler->paStrCopySegs[cSegs].pchSrc = &pszContent[offWord];
-                        if (offEsc < offLineEnd)
-                        {
-                            pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace
-                                                                                  ? -(ssize_t)cchSeg : (ssize_t)cchSeg;
-                            cchRet       += cchSeg + fPendingSpace;
-                            cSegs        += 1;
-                            fPendingSpace = 1;
-                        }
-                        else
-                        {
-                            cchSeg = offLineEnd - offWord;
-                            pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace
-                                                                                  ? -(ssize_t)cchSeg : (ssize_t)cchSeg;
-                            pCompiler->cStrCopySegs = cSegs + 1;
-                            pCompiler->iEscEol      = iEscEol;
-                            return cchRet + cchSeg + fPendingSpace;
-                        }
-                    }
-                }
-                else
-                    KMK_CC_ASSERT(offWord == offEsc);
+    chTerm = *pszLine == '(' ? ',' : *pszLine;
+    if (chTerm != ',' && chTerm != '"' && chTerm != '\'')
+        kmk_cc_eval_fatal(pCompiler, pszLine, "Expected '(' or quoted string after conditional directive");
 
-                /* Next line. */
-                offWord = pCompiler->paEscEols[iEscEol].offEol + pCompiler->cchEolSeq;
-                iEscEol++;
+    /* The first string. */
+    pszLeft = ++pszLine;
+    if (chTerm == ',')
+    {
+        int cDepth = 0;
+        for (; *pszLine != '\0'; ++pszLine)
+            if (*pszLine == '(')
+                ++cDepth;
+            else if (*pszLine == ')')
+                --cDepth;
+            else if (*pszLine == ',' && cDepth <= 0)
+                break;
+    }
+    else
+        while (*pszLine != '\0' && *pszLine != chTerm)
+            ++pszLine;
+    if (*pszLine == '\0')
+        kmk_cc_eval_fatal(pCompiler, pszLeft, "Unterminated first conditional argument");
 
-                /* Strip leading spaces. */
-                while (offWord < offLineEnd && KMK_CC_EVAL_IS_SPACE(pszContent[offWord]))
-                    offWord++;
-                if (offWord >= offLineEnd)
-                {
-                    pCompiler->cStrCopySegs = cSegs;
-                    pCompiler->iEscEol      = iEscEol;
-                    return cchRet;
-                }
-            } while (iEscEol < cEscEols);
+    if (chTerm == ',')
+    {
+        const char *pszEnd = pszLine++;
+        while (ISBLANK(pszEnd[-1]))
+            --pszEnd;
+        cchLeftArg = pszEnd - pszLeft;
+    }
+    else
+    {
+        cchLeftArg = pszLine - pszLeft;
+        pszLine++;
+        NEXT_TOKEN(pszLine);
+    }
 
-            /*
-             * The last line.
-             */
-            cchSeg      = offLineEnd - offWord;
-            cchRet     += cchSeg;
-            pCompiler->paStrCopySegs[cSegs].pchSrc                = &pszContent[offWord];
-            pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace
-                                                                  ? -(ssize_t)cchSeg : (ssize_t)cchSeg;
-            pCompiler->cStrCopySegs = cSegs + 1;
-            pCompiler->iEscEol      = iEscEol;
-        }
+    /* The second string. */
+    chTerm = chTerm == ',' ? ')' : *pszLine;
+    if (chTerm != ')' && chTerm != '"' && chTerm != '\'')
+        kmk_cc_eval_fatal(pCompiler, pszLine, "Expected quoted string as second conditional argument");
+    if (chTerm == ')')
+    {
+        int cDepth = 0;
+        pszRight = next_token(pszLine);
+        for (pszLine = pszRight; *pszLine != '\0'; ++pszLine)
+            if (*pszLine == '(')
+                ++cDepth;
+            else if (*pszLine == ')')
+            {
+                if (cDepth <= 0)
+                    break;
+                --cDepth;
+            }
     }
-    /*
-     * Odd case: Nothing to copy.
-     */
     else
     {
-        cchRet = 0;
-        pCompiler->cStrCopySegs = 0;
+        pszRight = ++pszLine;
+        while (*pszLine != '\0' && *pszLine != chTerm)
+            ++pszLine;
     }
-    return cchRet;
+    if (*pszLine == '\0')
+        kmk_cc_eval_fatal(pCompiler, pszRight, "Unterminated second conditional argument");
+    cchRightArg = pszLine - pszRight;
+
+    /* There shall be nothing following it. */
+    pszLine++;
+    NEXT_TOKEN(pszLine);
+    if (*pszLine != '\0')
+        kmk_cc_eval_fatal(pCompiler, pszLine, "Extraneous text after conditional");
+
+    /* Emit the instruction.  (KMKCCEVALIF1OF is layed out the same way.) */
+    pInstr = (PKMKCCEVALIFEQ)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pInstr), enmOpcode);
+    kmk_cc_eval_init_operand(pCompiler, &pInstr->Left, pszLeft, cchLeftArg, 1 /*fExpand*/);
+    kmk_cc_eval_init_operand(pCompiler, &pInstr->Right, pszRight, cchRightArg, 1 /*fExpand*/);
+    kmk_cc_block_realign(pCompiler->ppBlockTail);
+    kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
+    return 1;
 }
 
 
 /**
- * Prepares for copying a normal line, from the given position all the way to
- * the end.
- *
- * In addition to the returned information, this will store instruction in
- * paStrCopySegs and cSTrCopySeg for the following kmk_cc_eval_strcpyv() call.
+ * Deals with 'else' and 'else ifxxx' statements.
  *
- * @returns The number of chars that will be copied by kmk_cc_eval_strcpyv().
- * @param   pCompiler               The compiler instance data.
- * @param   pchWord                 Pointer to the first char to copy from the
- *                                  current line. This must be the start of a
- *                                  word.
- * @param   cchLeft                 The number of chars left on the current line
- *                                  starting at @a pchWord.
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after 'else'.
+ * @param   cchLeft     The number of chars left to parse on this line.
  */
-static size_t kmk_cc_eval_prep_normal_line(PKMKCCEVALCOMPILER pCompiler, const char * const pchWord, size_t cchLeft)
+static int kmk_cc_eval_do_else(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-    size_t          cchRet;
-    unsigned        iEscEol  = pCompiler->iEscEol;
-    unsigned const  cEscEols = pCompiler->cEscEols;
-
-    KMK_CC_ASSERT(cchLeft > 0);
-    KMK_CC_ASSERT(!KMK_CC_EVAL_IS_SPACE(*pchWord)); /* The fact that we're standing at a word, is exploited below. */
-    KMK_CC_ASSERT(iEscEol <= cEscEols);
+    PKMKCCEVALIFCORE    pIfCore;
+    PKMKCCEVALJUMP      pJump;
 
     /*
-     * If there are no escaped EOLs left, just copy what was specified,
-     * optionally sans any trailing spaces.
+     * There must be an 'if' on the stack and no 'else' yet.
      */
-    if (iEscEol >= cEscEols)
-    {
-        cchRet = cchLeft;
+    if (pCompiler->cIfs == 0)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Found 'else' without matching 'if'");
+    pIfCore = pCompiler->apIfs[pCompiler->cIfs - 1];
+    if (pIfCore->pTrueEndJump)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Only one 'else' per conditional");
+
+    /* Emit a jump instruction that will take us from the 'True' block to the 'endif'. */
+    pJump = (PKMKCCEVALJUMP)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pJump), kKmkCcEvalInstr_jump);
+    pJump->pNext          = NULL;
+    pIfCore->pTrueEndJump = pJump;
+
+    /* The next instruction is the first in the 'False' block of the current 'if'.
+       Should this be an 'else if', this will be the 'if' instruction emitted below. */
+    pIfCore->pNextFalse   = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
 
-        KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, 1);
-        pCompiler->cStrCopySegs = 1;
-        pCompiler->paStrCopySegs[0].pchSrc = pchWord;
-        pCompiler->paStrCopySegs[0].cchSrcAndPrependSpace = cchRet;
-    }
     /*
-     * Ok, we have to deal with escaped EOLs and do the proper
-     * replacement of escaped newlines with space.  The deal is that we
-     * collaps all whitespace before and after one or more newlines into a
-     * single space.  (FreeBSD make does this differently, by the by.)
+     * Anything following the 'else' must be another conditional.
      */
-    else
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (cchLeft)
     {
-        const char *pszContent = pCompiler->pszContent;
-        size_t      offWord    = pchWord - pCompiler->pszContent;
-        size_t      offEsc;
-        size_t      fPendingSpace;
-        size_t      cchSeg;
-        unsigned    cSegs      = 0;
-
-        /* Go nuts checking our preconditions here. */
-        KMK_CC_ASSERT(offWord >= pCompiler->offLine);
-        KMK_CC_ASSERT(offWord + cchLeft <= pCompiler->offLine + pCompiler->cchLine);
-        KMK_CC_ASSERT(offWord + cchLeft <= pCompiler->cchContent);
-        KMK_CC_ASSERT(offWord <  pCompiler->paEscEols[iEscEol].offEsc);
-        KMK_CC_ASSERT(offWord >= (iEscEol ? pCompiler->paEscEols[iEscEol - 1].offEol + pCompiler->cchEolSeq : pCompiler->offLine));
-
-        /* Make sure we've got more than enough segments to fill in. */
-        KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, cEscEols - iEscEol + 2);
-
-        /*
-         * First line - We're at the start of a word, so no left stripping needed.
-         */
-        offEsc = pCompiler->paEscEols[iEscEol].offEsc;
-        KMK_CC_ASSERT(offEsc > offWord);
-        while (KMK_CC_EVAL_IS_SPACE(pszContent[offEsc - 1]))
-            offEsc--;
-        KMK_CC_ASSERT(offEsc > offWord);
-
-        fPendingSpace = 1;
-        cchRet        = offEsc - offWord;
-        pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = cchRet;
-        pCompiler->paStrCopySegs[cSegs].pchSrc                = pchWord;
-        cSegs++;
-
-        offWord = pCompiler->paEscEols[iEscEol].offEol + pCompiler->cchEolSeq;
-        iEscEol++;
-
-        /*
-         * All but the last line.
-         */
-        while (iEscEol < cEscEols)
+        if (   cchLeft >= 2
+            && KMK_CC_WORD_COMP_CONST_2(pchWord, "if"))
         {
-            offEsc = pCompiler->paEscEols[iEscEol].offEsc;
+            pchWord += 2;
+            cchLeft -= 2;
 
-            /* Strip leading spaces. */
-            while (offWord < offEsc && KMK_CC_EVAL_IS_SPACE(pszContent[offWord]))
-                offWord++;
+#ifdef CONFIG_WITH_IF_CONDITIONALS
+            if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pchWord, cchLeft))
+                return kmk_cc_eval_do_if(pCompiler, pchWord, cchLeft, 1 /* in else */);
+#endif
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "eq", 2))
+                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 2, cchLeft - 2, 1 /* in else */, kKmkCcEvalInstr_ifeq);
 
-            if (offWord < offEsc)
-            {
-                /* Strip trailing spaces. */
-                while (KMK_CC_EVAL_IS_SPACE(pszContent[offEsc - 1]))
-                    offEsc--;
-                cchSeg = offEsc - offWord;
-                pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace ? -(ssize_t)cchSeg : (ssize_t)cchSeg;
-                cchRet += cchSeg + fPendingSpace;
-                pCompiler->paStrCopySegs[cSegs].pchSrc                = &pszContent[offWord];
-                cSegs  += 1;
-                fPendingSpace = 1;
-            }
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "def", 3))
+                return kmk_cc_eval_do_ifdef(pCompiler, pchWord + 3, cchLeft - 3, 1 /* in else */, 1 /* positive */);
 
-            /* Next. */
-            offWord = pCompiler->paEscEols[iEscEol].offEol + pCompiler->cchEolSeq;
-            iEscEol++;
-        }
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "neq", 3))
+                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 3, cchLeft - 3, 1 /* in else */, kKmkCcEvalInstr_ifneq);
 
-        /*
-         * Final line. We must calculate the end of line offset our selves here.
-         */
-        offEsc = &pchWord[cchLeft] - pszContent;
-        while (offWord < offEsc && KMK_CC_EVAL_IS_SPACE(pszContent[offWord]))
-            offWord++;
+#ifdef CONFIG_WITH_SET_CONDITIONALS
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "1of", 3))
+                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 3, cchLeft - 3, 1 /* in else */, kKmkCcEvalInstr_if1of);
+#endif
 
-        if (offWord < offEsc)
-        {
-            cchSeg = offEsc - offWord;
-            pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace ? -(ssize_t)cchSeg : (ssize_t)cchSeg;
-            cchRet += cchSeg + fPendingSpace;
-            pCompiler->paStrCopySegs[cSegs].pchSrc                = &pszContent[offWord];
-            cSegs  += 1;
-        }
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "ndef", 4))
+                return kmk_cc_eval_do_ifdef(pCompiler, pchWord + 4, cchLeft - 4, 1 /* in else */, 0 /* positive */);
 
-        pCompiler->cStrCopySegs = cSegs;
+#ifdef CONFIG_WITH_SET_CONDITIONALS
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "n1of", 4))
+                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 4, cchLeft - 4, 1 /* in else */, kKmkCcEvalInstr_ifn1of);
+#endif
+            pchWord -= 2;
+            cchLeft += 2;
+        }
+        kmk_cc_eval_fatal(pCompiler, pchWord, "Expected conditional directive after 'else'");
     }
-    return cchRet;
+    return 1;
 }
 
 
 /**
- * Common worker for all kmk_cc_eval_do_if*() functions.
+ * Deals with the 'endif' statement.
  *
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
  * @param   pCompiler   The compiler state.
- * @param   pIfCore     The new IF statement.
- * @param   fInElse     Set if this is an 'else if' (rather than just 'if').
+ * @param   pchWord     First char after 'endif'.
+ * @param   cchLeft     The number of chars left to parse on this line.
  */
-static void kmk_cc_eval_do_if_core(PKMKCCEVALCOMPILER pCompiler, PKMKCCEVALIFCORE pIfCore, int fInElse)
+static int kmk_cc_eval_do_endif(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-    unsigned iIf = pCompiler->cIfs;
-    if (!fInElse)
+    PKMKCCEVALCORE   pNextInstr;
+    PKMKCCEVALIFCORE pIfCore;
+
+    /* Not allowed to be followed by anything. */
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (cchLeft)
+        kmk_cc_eval_fatal(pCompiler, pchWord, "Extraneous text after 'endif'");
+    if (pCompiler->cIfs == 0)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Found 'endif' without matching 'if'");
+    pIfCore = pCompiler->apIfs[--pCompiler->cIfs]; /* POP! */
+
+    /* Update the jump targets for all IFs at this level. */
+    kmk_cc_eval_flush_chunk(pCompiler);
+    pNextInstr = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
+    do
     {
-        /* Push an IF statement. */
-        if (iIf < KMK_CC_EVAL_MAX_IF_DEPTH)
+        if (pIfCore->pTrueEndJump)
         {
-            pCompiler->cIfs = iIf + 1;
-            pCompiler->apIfs[iIf] = pIfCore;
-            pIfCore->pPrevCond = NULL;
+            /* Make the true block jump here, to the 'endif'. The false block is already here. */
+            pIfCore->pTrueEndJump->pNext = pNextInstr;
+            KMK_CC_ASSERT(pIfCore->pNextFalse);
         }
         else
-            kmk_cc_eval_fatal(pCompiler, NULL, "Too deep IF nesting");
-    }
-    else if (iIf > 0)
-    {
-        /* Link an IF statement. */
-        iIf--;
-        pIfCore->pPrevCond    = pCompiler->apIfs[iIf];
-        pCompiler->apIfs[iIf] = pIfCore;
-    }
-    else
-        kmk_cc_eval_fatal(pCompiler, NULL, "'else if' without 'if'");
-    pIfCore->pNextTrue    = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
-    pIfCore->pNextFalse   = NULL; /* This is set by else or endif. */
-    pIfCore->pTrueEndJump = NULL; /* This is set by else or endif. */
+        {
+            /* No 'else'. The false-case jump here, to the 'endif'. */
+            KMK_CC_ASSERT(!pIfCore->pNextFalse);
+            pIfCore->pNextFalse = pNextInstr;
+        }
+        pIfCore = pIfCore->pPrevCond;
+    } while (pIfCore);
+    return 1;
 }
 
-
 /**
- * Deals with 'if expr' and 'else if expr' statements.
+ * Deals with the 'include' family of statements.
  *
  * @returns 1 to indicate we've handled a keyword (see
  *          kmk_cc_eval_try_handle_keyword).
  * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'if'.
+ * @param   pchWord     First char after the directive.
  * @param   cchLeft     The number of chars left to parse on this line.
- * @param   fInElse     Set if this is an 'else if' (rather than just 'if').
+ * @param   enmOpcode   The instruction opcode.
  */
-static int kmk_cc_eval_do_if(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse)
+static int kmk_cc_eval_do_include(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
+                                  KMKCCEVALINSTR enmOpcode)
 {
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
+    PKMKCCEVALINCLUDE pInstr;
+
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (   enmOpcode == kKmkCcEvalInstr_include
+        || enmOpcode == kKmkCcEvalInstr_include_silent)
     {
-        PKMKCCEVALIFEXPR pInstr;
-        size_t           cchExpr = kmk_cc_eval_prep_normal_line(pCompiler, pchWord, cchLeft);
-        kmk_cc_eval_strip_right_v(pCompiler->paStrCopySegs, &pCompiler->cStrCopySegs, &cchExpr);
-
-        pInstr = (PKMKCCEVALIFEXPR)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, KMKCCEVALIFEXPR_SIZE(cchExpr));
-        kmk_cc_eval_strcpyv(pInstr->szExpr, pCompiler->paStrCopySegs, pCompiler->cStrCopySegs, cchExpr);
-        pInstr->cchExpr = cchExpr;
-        pInstr->IfCore.Core.enmOpcode = kKmkCcEvalInstr_if;
-        pInstr->IfCore.Core.iLine     = pCompiler->iLine;
-        kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
+        /*
+         * Plain file names can be split up front, anything else is expanded
+         * and split at runtime.
+         */
+        unsigned const cWords = cchLeft ? kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft) : 0;
+        if (cWords > 0 && kmk_cc_eval_are_words_plain(pCompiler))
+        {
+            pInstr = (PKMKCCEVALINCLUDE)kmk_cc_eval_alloc_instr(pCompiler, KMKCCEVALINCLUDE_SIZE(cWords), enmOpcode);
+            pInstr->cFiles = cWords;
+            kmk_cc_eval_init_spp_array_from_duplicated_words(pCompiler, cWords, pCompiler->paWords, pInstr->aFiles);
+        }
+        else
+        {
+            pInstr = (PKMKCCEVALINCLUDE)kmk_cc_eval_alloc_instr(pCompiler, KMKCCEVALINCLUDE_SIZE(1), enmOpcode);
+            pInstr->cFiles = 1;
+            kmk_cc_eval_init_operand(pCompiler, &pInstr->aFiles[0], pchWord, cchLeft, 1 /*fExpand*/);
+        }
+
+        /* The include family records any waiting rule. */
+        if (pCompiler->cIfs == 0)
+            pCompiler->fRuleMaybePending = 0;
     }
     else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Expected expression after 'if' directive");
+    {
+        /*
+         * The includedep family doesn't record waiting rules, so it must join
+         * any pending chunk.  Like the interpreter, it takes the whole remainder
+         * as a single file name, stripping trailing spaces off plain names here.
+         */
+        if (pCompiler->offChunk != KMK_CC_EVAL_NO_CHUNK)
+        {
+            kmk_cc_eval_add_chunk_line(pCompiler, 0 /*fEndsRule*/);
+            return 1;
+        }
+        if (!memchr(pchWord, '$', cchLeft))
+            while (cchLeft > 0 && ISSPACE(pchWord[cchLeft - 1]))
+                cchLeft--;
+
+        pInstr = (PKMKCCEVALINCLUDE)kmk_cc_eval_alloc_instr(pCompiler, KMKCCEVALINCLUDE_SIZE(1), enmOpcode);
+        pInstr->cFiles = 1;
+        kmk_cc_eval_init_operand(pCompiler, &pInstr->aFiles[0], pchWord, cchLeft, 1 /*fExpand*/);
+    }
+    kmk_cc_block_realign(pCompiler->ppBlockTail);
+    pInstr->pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
     return 1;
 }
 
 
 /**
- * Deals with 'ifdef var', 'ifndef var', 'else ifdef var' and 'else ifndef var'
- * statements.
+ * Deals with 'vpath', leaving it to the interpreter.
  *
  * @returns 1 to indicate we've handled a keyword (see
  *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler       The compiler state.
- * @param   pchWord         First char after 'if[n]def'.
- * @param   cchLeft         The number of chars left to parse on this line.
- * @param   fInElse         Set if this is an 'else if' (rather than just 'if').
- * @param   fPositiveStmt   Set if 'ifdef', clear if 'ifndef'.
+ * @param   pCompiler   The compiler state.
  */
-static int kmk_cc_eval_do_ifdef(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse, int fPositiveStmt)
+static int kmk_cc_eval_do_vpath(PKMKCCEVALCOMPILER pCompiler)
 {
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
-    {
-        /*
-         * Skip to the end of the variable name.
-         * GNU make just does normal word parsing, so lets do that too.
-         */
-        unsigned const  iSavedEscEol = pCompiler->iEscEol;
-        unsigned        cWords = kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft);
-        if (cWords == 0)
-        {
-            PCKMKCCEVALWORD pWord = pCompiler->paWords;
-            if (pWord->enmToken == kKmkCcEvalToken_WordPlain)
-            {
-                PKMKCCEVALIFDEFPLAIN pInstr;
-                pInstr = (PKMKCCEVALIFDEFPLAIN)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-                pInstr->IfCore.Core.enmOpcode = fPositiveStmt ? kKmkCcEvalInstr_ifdef_plain : kKmkCcEvalInstr_ifndef_plain;
-                pInstr->IfCore.Core.iLine     = pCompiler->iLine;
-                pInstr->pszName = strcache2_add(&variable_strcache, pWord->pchWord, pWord->cchWord);
-                kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
-            }
-            else
-            {
-                PKMKCCEVALIFDEFDYNAMIC  pInstr;
-                size_t                  cchCopy;
-                char const             *pszCopy;
-
-                pInstr = (PKMKCCEVALIFDEFDYNAMIC)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
+    kmk_cc_eval_add_chunk_line(pCompiler, 1 /*fEndsRule*/);
+    return 1;
+}
 
-                /** @todo Make the subprogram embed necessary strings. */
-                if (pWord->enmToken != kKmkCcEvalToken_WordWithDollar)
-                {
-                    pszCopy = kmk_cc_block_strdup(pCompiler->ppBlockTail, pWord->pchWord, pWord->cchWord);
-                    cchCopy = pWord->cchWord;
-                }
-                else
-                {
-                    KMK_CC_ASSERT(pWord->enmToken == kKmkCcEvalToken_WordWithDollarAndEscEol);
-                    pCompiler->iEscEol = iSavedEscEol;
-                    cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pWord->pchWord, cchLeft);
-                    pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, cchCopy);
-                }
-                kmk_cc_block_realign(pCompiler->ppBlockTail);
 
-                pInstr->IfCore.Core.enmOpcode = fPositiveStmt ? kKmkCcEvalInstr_ifdef_dynamic : kKmkCcEvalInstr_ifndef_dynamic;
-                pInstr->IfCore.Core.iLine     = pCompiler->iLine;
-                pInstr->uPadding              = 0;
-                kmk_cc_eval_compile_string_exp_subprog(pCompiler, pszCopy, cchCopy, &pInstr->NameSubprog);
+/**
+ * Worker for 'export', 'unexport' and 'undefine' with a variable list.
+ *
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     The first variable name.
+ * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   enmOpcode   The instruction opcode.
+ * @param   fQualifiers The qualifiers.
+ */
+static int kmk_cc_eval_do_with_variable_list(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
+                                             KMKCCEVALINSTR enmOpcode, unsigned fQualifiers)
+{
+    PKMKCCEVALVARIABLES pInstr;
+    unsigned const      cWords = kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft);
+    KMK_CC_ASSERT(cWords > 0);
 
-                kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
-            }
-        }
-        else
-        {
-            KMK_CC_ASSERT(cWords > 1);
-            kmk_cc_eval_fatal(pCompiler, pCompiler->paWords[1].pchWord,
-                              "Bogus stuff after 'if%sdef' variable name", fPositiveStmt ? "" : "n");
-        }
+    /* 'undefine' takes the whole remainder as one name, the others split it
+       after expansion. */
+    if (   enmOpcode != kKmkCcEvalInstr_undefine
+        && kmk_cc_eval_are_words_plain(pCompiler))
+    {
+        pInstr = (PKMKCCEVALVARIABLES)kmk_cc_eval_alloc_instr(pCompiler, KMKCCEVALVARIABLES_SIZE(cWords), enmOpcode);
+        pInstr->cVars = cWords;
+        kmk_cc_eval_init_spp_array_from_duplicated_words(pCompiler, cWords, pCompiler->paWords, pInstr->aVars);
     }
     else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Expected expression after 'if' directive");
+    {
+        pInstr = (PKMKCCEVALVARIABLES)kmk_cc_eval_alloc_instr(pCompiler, KMKCCEVALVARIABLES_SIZE(1), enmOpcode);
+        pInstr->cVars = 1;
+        kmk_cc_eval_init_operand(pCompiler, &pInstr->aVars[0], pchWord, cchLeft, 1 /*fExpand*/);
+    }
+    pInstr->fLocal    = 0;
+    pInstr->fOverride = (fQualifiers & KMK_CC_EVAL_QUALIFIER_OVERRIDE) != 0;
+    kmk_cc_block_realign(pCompiler->ppBlockTail);
+    pInstr->pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
+
+    /* The interpreter records any waiting rule first. */
+    if (pCompiler->cIfs == 0)
+        pCompiler->fRuleMaybePending = 0;
     return 1;
 }
 
 
 /**
- * Deals with 'ifeq (a,b)', 'ifeq "a" "b"', 'ifneq (a,b)', 'ifneq "a" "b"',
- * 'else ifeq (a,b)', 'else ifeq "a" "b"', 'else ifneq (a,b)' and
- * 'else ifneq "a" "b"' statements.
+ * Parses a 'undefine variable [..]' expression.
+ *
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after 'undefine'.
+ * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   fQualifiers The qualifiers.
+ */
+static int kmk_cc_eval_do_var_undefine(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
+                                       unsigned fQualifiers)
+{
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (!cchLeft)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Expected variable name after 'undefine'");
+    return kmk_cc_eval_do_with_variable_list(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_undefine, fQualifiers);
+}
+
+
+/**
+ * Parses a 'unexport [variable]' expression.
  *
  * @returns 1 to indicate we've handled a keyword (see
  *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler       The compiler state.
- * @param   pchWord         First char after 'if[n]eq'.
- * @param   cchLeft         The number of chars left to parse on this line.
- * @param   fInElse         Set if this is an 'else if' (rather than just 'if').
- * @param   fPositiveStmt   Set if 'ifeq', clear if 'ifneq'.
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after 'unexport'.
+ * @param   cchLeft     The number of chars left to parse on this line.
  */
-static int kmk_cc_eval_do_ifeq(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse, int fPositiveStmt)
+static int kmk_cc_eval_do_var_unexport(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
     if (cchLeft)
-    {
-        /*
-         * There are two forms:
-         *
-         *   ifeq (string1, string2)
-         *   ifeq "string1" 'string2'
-         *
-         */
-        const char * const  pchEnd = &pchWord[cchLeft];
-        PKMKCCEVALIFEQ      pInstr = (PKMKCCEVALIFEQ)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
+        return kmk_cc_eval_do_with_variable_list(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_unexport, 0);
 
-        struct
-        {
-            char           *pszCopy;
-            size_t          cchCopy;
-            int             fPlain;
-        } Left, Right;
+    /* We're unexporting all variables. */
+    kmk_cc_eval_alloc_instr(pCompiler, sizeof(KMKCCEVALCORE), kKmkCcEvalInstr_unexport_all);
+    if (pCompiler->cIfs == 0)
+        pCompiler->fRuleMaybePending = 0;
+    return 1;
+}
 
-        char ch = *pchWord;
-        if (ch == '(')
-        {
-            int      cCounts;
-            size_t   off;
 
-            /*
-             * The left side ends with a comma.  We respect parentheses, but
-             * not curly brackets.
-             */
+/**
+ * Emits a variable assignment instruction.
+ *
+ * @param   pCompiler   The compiler state.
+ * @param   pchVarNm    The variable name.
+ * @param   cchVarNm    The length of the variable name.
+ * @param   pchValue    The value.
+ * @param   cchValue    The length of the value.
+ * @param   enmFlavor   The assignment flavor.
+ * @param   fQualifiers The qualifiers.
+ */
+static void kmk_cc_eval_do_assign(PKMKCCEVALCOMPILER pCompiler, const char *pchVarNm, size_t cchVarNm,
+                                  const char *pchValue, size_t cchValue, enum variable_flavor enmFlavor,
+                                  unsigned fQualifiers)
+{
+    PKMKCCEVALASSIGN    pInstr;
+    KMKCCEVALINSTR      enmOpcode;
+    switch (enmFlavor)
+    {
+        case f_recursive:   enmOpcode = kKmkCcEvalInstr_assign_recursive; break;
+        case f_simple:      enmOpcode = kKmkCcEvalInstr_assign_simple; break;
+        case f_append:      enmOpcode = kKmkCcEvalInstr_assign_append; break;
+#ifdef CONFIG_WITH_PREPEND_ASSIGNMENT
+        case f_prepend:     enmOpcode = kKmkCcEvalInstr_assign_prepend; break;
+#endif
+        case f_conditional: enmOpcode = kKmkCcEvalInstr_assign_if_new; break;
+        default:
+            kmk_cc_eval_fatal(pCompiler, pchVarNm, "Unexpected assignment flavor %d", (int)enmFlavor);
+    }
 
-            /* Skip the parenthesis. */
-            pchWord++;
-            cchLeft--;
+    pInstr = (PKMKCCEVALASSIGN)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pInstr), enmOpcode);
+    pInstr->fExport   = (fQualifiers & KMK_CC_EVAL_QUALIFIER_EXPORT)   != 0;
+    pInstr->fOverride = (fQualifiers & KMK_CC_EVAL_QUALIFIER_OVERRIDE) != 0;
+    pInstr->fPrivate  = (fQualifiers & KMK_CC_EVAL_QUALIFIER_PRIVATE)  != 0;
+    pInstr->fLocal    = (fQualifiers & KMK_CC_EVAL_QUALIFIER_LOCAL)    != 0;
+    kmk_cc_eval_init_operand(pCompiler, &pInstr->Variable, pchVarNm, cchVarNm, 1 /*fExpand*/);
+    kmk_cc_eval_init_operand(pCompiler, &pInstr->Value, pchValue, cchValue, enmFlavor == f_simple /*fExpand*/);
+    kmk_cc_block_realign(pCompiler->ppBlockTail);
+    pInstr->pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
 
-            /* Find the comma, checking for non-plainness. */
-            cCounts = 0;
-            Left.fPlain = 1;
-            for (off = 0; off < cchLeft; off++)
-            {
-                ch = pchWord[off];
-                if (!KMK_CC_EVAL_IS_PAREN_COMMA_OR_DOLLAR(ch))
-                { /* likely */ }
-                else if (ch == '$')
-                    Left.fPlain = 0;
-                else if (ch == '(')
-                    cCounts++;
-                else if (ch == ')')
-                    cCounts--; /** @todo warn if it goes negative. */
-                else if (ch == ',' && cCounts == 0)
-                    break;
-                else
-                    KMK_CC_ASSERT(cCounts > 0);
-            }
-            if (ch == ',' && cCounts == 0) { /* likely */ }
-            else kmk_cc_eval_fatal(pCompiler, &pchWord[off], "Expected ',' before end of line");
+    /* The interpreter records any waiting rule before non-local assignments. */
+    if (!pInstr->fLocal && pCompiler->cIfs == 0)
+        pCompiler->fRuleMaybePending = 0;
+}
 
-            /* Copy out the string. */
-            Left.cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchWord, off);
-            kmk_cc_eval_strip_right_v(pCompiler->paStrCopySegs, &pCompiler->cStrCopySegs, &Left.cchCopy);
-            Left.pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, Left.cchCopy);
 
-            /* Skip past the comma and any following spaces. */
-            pchWord += off + 1;
-            cchLeft -= off + 1;
-            if (   cchLeft /** @todo replace with straight 'isspace' that takes escaped EOLs into account. */
-                && KMK_CC_EVAL_IS_SPACE_AFTER_WORD(pCompiler, pchWord[0], pchWord[1], cchLeft))
-                KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
+/**
+ * Tries to emit a line consisting of a single function call that expands to
+ * nothing, like $(eval ...) or $(info ...), as an expand instruction.
+ *
+ * The interpreter deals with such lines as rules that turn out to be empty,
+ * so we restrict this to the functions known to never produce any output and
+ * let the executor check that it was right.
+ *
+ * @returns 1 if emitted, 0 if not.
+ * @param   pCompiler   The compiler state.
+ * @param   pchSubprog  The start of the line (after leading spaces).
+ * @param   cchSubprog  The number of chars left on the line.
+ */
+static int kmk_cc_eval_emit_expand(PKMKCCEVALCOMPILER pCompiler, const char *pchSubprog, size_t cchSubprog)
+{
+    static const struct
+    {
+        const char *psz;
+        size_t      cch;
+    } s_aFunctions[] =
+    {
+        { "eval", 4 }, { "evalctx", 7 }, { "evalval", 7 }, { "evalvalctx", 10 },
+        { "info", 4 }, { "warning", 7 }, { "error", 5 },
+    };
+    PKMKCCEVALEXPAND    pInstr;
+    const char         *pszCopy;
+    char                chOpen;
+    char                chClose;
+    unsigned            cOpen;
+    unsigned            i;
+    size_t              off;
+    int                 rc;
+
+    while (cchSubprog > 0 && KMK_CC_EVAL_IS_SPACE(pchSubprog[cchSubprog - 1]))
+        cchSubprog--;
 
-            /*
-             * Ditto for the right side, only it ends with a closing parenthesis.
-             */
-            cCounts = 1;
-            Right.fPlain = 1;
-            for (off = 0; off < cchLeft; off++)
-            {
-                ch = pchWord[off];
-                if (!KMK_CC_EVAL_IS_PAREN_COMMA_OR_DOLLAR(ch))
-                { /* likely */ }
-                else if (ch == '$')
-                    Right.fPlain = 0;
-                else if (ch == '(')
-                    cCounts++;
-                else if (ch == ')')
-                {
-                    if (--cCounts == 0)
-                        break;
-                }
-                else
-                    KMK_CC_ASSERT(cCounts > 0 || ch == ',');
-            }
-            if (ch == ')' && cCounts == 0) { /* likely */ }
-            else kmk_cc_eval_fatal(pCompiler, &pchWord[off], "Expected ')' before end of line");
+    /*
+     * Keep clear of recipe lines and anything involving the semicolon,
+     * comment and quoting logic of the rule parser.
+     */
+    if (   cchSubprog < 4
+        || pchSubprog[0] != '$'
+        || (pchSubprog[1] != '(' && pchSubprog[1] != '{')
+        || pCompiler->pszContent[pCompiler->offLine] == pCompiler->chCmdPrefix
+        || memchr(pchSubprog, ';', cchSubprog)
+        || memchr(pchSubprog, '#', cchSubprog)
+        || memchr(pchSubprog, '\\', cchSubprog))
+        return 0;
 
-            /* Copy out the string. */
-            Right.cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchWord, off);
-            kmk_cc_eval_strip_right_v(pCompiler->paStrCopySegs, &pCompiler->cStrCopySegs, &Right.cchCopy);
-            Right.pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, Right.cchCopy);
+    /*
+     * Must be one of the functions, and its closing parenthesis must end the line.
+     */
+    for (i = 0; i < K_ELEMENTS(s_aFunctions); i++)
+        if (   cchSubprog > 2 + s_aFunctions[i].cch
+            && memcmp(&pchSubprog[2], s_aFunctions[i].psz, s_aFunctions[i].cch) == 0
+            && ISBLANK(pchSubprog[2 + s_aFunctions[i].cch]))
+            break;
+    if (i >= K_ELEMENTS(s_aFunctions))
+        return 0;
 
-            /* Skip past the parenthesis. */
-            pchWord += off + 1;
-            cchLeft -= off + 1;
-        }
-        else if (ch == '"' || ch == '\'')
+    chOpen  = pchSubprog[1];
+    chClose = chOpen == '(' ? ')' : '}';
+    cOpen   = 1;
+    for (off = 2; off < cchSubprog; off++)
+    {
+        char const ch = pchSubprog[off];
+        if (ch == chClose)
         {
-            const char *pchTmp;
-
-            /*
-             * Quoted left side.
-             */
-            /* Skip leading quote. */
-            pchWord++;
-            cchLeft--;
-
-            /* Locate the end quote. */
-            pchTmp = (const char *)memchr(pchWord, ch, cchLeft);
-            if (pchTmp) { /* likely */ }
-            else kmk_cc_eval_fatal(pCompiler, pchWord - 1, "Unbalanced quote in first if%seq string", fPositiveStmt ? "" : "n");
-
-            Left.cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchWord, pchTmp - pchWord);
-            Left.pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, Left.cchCopy);
-            Left.fPlain  = memchr(Left.pszCopy, '$', Left.cchCopy) == NULL;
-
-            /* skip end quote */
-            pchWord  = pchTmp + 1;
-            cchLeft  = pchEnd - pchWord;
-
-            /* Skip anything inbetween the left and right hand side (not mandatory). */
-            if (   cchLeft /** @todo replace with straight 'isspace' that takes escaped EOLs into account. */
-                && KMK_CC_EVAL_IS_SPACE_AFTER_WORD(pCompiler, pchWord[0], pchWord[1], cchLeft))
-                KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-
-            /*
-             * Quoted right side.
-             */
-            if (   cchLeft > 0
-                && ( (ch = *pchWord) != '"' || ch == '\'') )
-            {
-                /* Skip leading quote. */
-                pchWord++;
-                cchLeft--;
-
-                /* Locate the end quote. */
-                pchTmp = (const char *)memchr(pchWord, ch, cchLeft);
-                if (pchTmp) { /* likely */ }
-                else kmk_cc_eval_fatal(pCompiler, pchWord - 1, "Unbalanced quote in second if%seq string", fPositiveStmt ? "" : "n");
-
-                Right.cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchWord, pchTmp - pchWord);
-                Right.pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, Right.cchCopy);
-                Right.fPlain  = memchr(Right.pszCopy, '$', Right.cchCopy) == NULL;
-
-                /* skip end quote */
-                pchWord  = pchTmp + 1;
-                cchLeft  = pchEnd - pchWord;
-            }
-            else
-                kmk_cc_eval_fatal(pCompiler, pchWord, "Expected a second quoted string for 'if%seq'",
-                                  fPositiveStmt ? "" : "n");
-        }
-        else
-            kmk_cc_eval_fatal(pCompiler, pchWord, "Expected parentheses or quoted string after 'if%seq'",
-                              fPositiveStmt ? "" : "n");
-        kmk_cc_block_realign(pCompiler->ppBlockTail);
-
-        /*
-         * Initialize the instruction.
-         */
-        pInstr->IfCore.Core.enmOpcode = fPositiveStmt ? kKmkCcEvalInstr_ifeq : kKmkCcEvalInstr_ifneq;
-        pInstr->IfCore.Core.iLine     = pCompiler->iLine;
-        kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Left, Left.pszCopy, Left.cchCopy, Left.fPlain);
-        kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Right, Right.pszCopy, Right.cchCopy, Right.fPlain);
-        kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
-
-        /*
-         * Make sure there is nothing following the variable name.
-         */
-        KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        if (cchLeft)
-            kmk_cc_eval_fatal(pCompiler, pchWord, "Bogus stuff after 'if%sdef' variable name", fPositiveStmt ? "" : "n");
-    }
-    else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Expected expression after 'if' directive");
-    return 1;
-}
-
-
-/**
- * Deals with 'if1of (set-a,set-b)', 'ifn1of (set-a,set-b)',
- * 'else if1of (set-a,set-b)' and 'else ifn1of (set-a,set-b)' statements.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler       The compiler state.
- * @param   pchWord         First char after 'if[n]1of'.
- * @param   cchLeft         The number of chars left to parse on this line.
- * @param   fInElse         Set if this is an 'else if' (rather than just 'if').
- * @param   fPositiveStmt   Set if 'if1of', clear if 'ifn1of'.
- */
-static int kmk_cc_eval_do_if1of(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, int fInElse, int fPositiveStmt)
-{
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
-    {
-        /*
-         * This code is (currently) very similar to kmk_cc_eval_do_ifeq.
-         * However, we may want to add hashing optimizations of plain text,
-         * and we don't want to support the quoted form as it is not necessary
-         * and may interfere with support for quoted words later on.
-         */
-        PKMKCCEVALIF1OF     pInstr = (PKMKCCEVALIF1OF)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-
-        struct
-        {
-            char           *pszCopy;
-            size_t          cchCopy;
-            int             fPlain;
-        } Left, Right;
-
-        char ch = *pchWord;
-        if (ch == '(')
-        {
-            int      cCounts;
-            size_t   off;
-
-            /*
-             * The left side ends with a comma.  We respect parentheses, but
-             * not curly brackets.
-             */
-
-            /* Skip the parenthesis. */
-            pchWord++;
-            cchLeft--;
-
-            /* Find the comma, checking for non-plainness. */
-            cCounts = 0;
-            Left.fPlain = 1;
-            for (off = 0; off < cchLeft; off++)
-            {
-                ch = pchWord[off];
-                if (!KMK_CC_EVAL_IS_PAREN_COMMA_OR_DOLLAR(ch))
-                { /* likely */ }
-                else if (ch == '$')
-                    Left.fPlain = 0;
-                else if (ch == '(')
-                    cCounts++;
-                else if (ch == ')')
-                    cCounts--; /** @todo warn if it goes negative. */
-                else if (ch == ',' && cCounts == 0)
-                    break;
-                else
-                    KMK_CC_ASSERT(cCounts > 0);
-            }
-            if (ch == ',' && cCounts == 0) { /* likely */ }
-            else kmk_cc_eval_fatal(pCompiler, &pchWord[off], "Expected ',' before end of line");
-
-            /* Copy out the string. */
-            Left.cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchWord, off);
-            kmk_cc_eval_strip_right_v(pCompiler->paStrCopySegs, &pCompiler->cStrCopySegs, &Left.cchCopy);
-            Left.pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, Left.cchCopy);
-
-            /* Skip past the comma and any following spaces. */
-            pchWord += off + 1;
-            cchLeft -= off + 1;
-            if (   cchLeft /** @todo replace with straight 'isspace' that takes escaped EOLs into account. */
-                && KMK_CC_EVAL_IS_SPACE_AFTER_WORD(pCompiler, pchWord[0], pchWord[1], cchLeft))
-                KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-
-            /*
-             * Ditto for the right side, only it ends with a closing parenthesis.
-             */
-            cCounts = 1;
-            Right.fPlain = 1;
-            for (off = 0; off < cchLeft; off++)
-            {
-                ch = pchWord[off];
-                if (!KMK_CC_EVAL_IS_PAREN_COMMA_OR_DOLLAR(ch))
-                { /* likely */ }
-                else if (ch == '$')
-                    Right.fPlain = 0;
-                else if (ch == '(')
-                    cCounts++;
-                else if (ch == ')')
-                {
-                    if (--cCounts == 0)
-                        break;
-                }
-                else
-                    KMK_CC_ASSERT(cCounts > 0 || ch == ',');
-            }
-            if (ch == ')' && cCounts == 0) { /* likely */ }
-            else kmk_cc_eval_fatal(pCompiler, &pchWord[off], "Expected ')' before end of line");
-
-            /* Copy out the string. */
-            Right.cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchWord, off);
-            kmk_cc_eval_strip_right_v(pCompiler->paStrCopySegs, &pCompiler->cStrCopySegs, &Right.cchCopy);
-            Right.pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, Right.cchCopy);
-
-            /* Skip past the parenthesis. */
-            pchWord += off + 1;
-            cchLeft -= off + 1;
-        }
-        else
-            kmk_cc_eval_fatal(pCompiler, pchWord, "Expected parentheses after 'if%s1of'", fPositiveStmt ? "" : "n");
-        kmk_cc_block_realign(pCompiler->ppBlockTail);
-
-        /*
-         * Initialize the instruction.
-         */
-        pInstr->IfCore.Core.enmOpcode = fPositiveStmt ? kKmkCcEvalInstr_if1of : kKmkCcEvalInstr_ifn1of;
-        pInstr->IfCore.Core.iLine     = pCompiler->iLine;
-        kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Left, Left.pszCopy, Left.cchCopy, Left.fPlain);
-        kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Right, Right.pszCopy, Right.cchCopy, Right.fPlain);
-        kmk_cc_eval_do_if_core(pCompiler, &pInstr->IfCore, fInElse);
-
-        /*
-         * Make sure there is nothing following the variable name.
-         */
-        KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        if (cchLeft)
-            kmk_cc_eval_fatal(pCompiler, pchWord, "Bogus stuff after 'if%s1of' variable name", fPositiveStmt ? "" : "n");
-    }
-    else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Expected expression after 'if' directive");
-    return 1;
-}
-
-
-/**
- * Deals with 'else' and 'else ifxxx' statements.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'define'.
- * @param   cchLeft     The number of chars left to parse on this line.
- */
-static int kmk_cc_eval_do_else(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
-{
-    /*
-     * There must be an 'if' on the stack.
-     */
-    unsigned iIf = pCompiler->cIfs;
-    if (iIf > 0)
-    {
-        PKMKCCEVALIFCORE pIfCore = pCompiler->apIfs[--iIf];
-        if (!pIfCore->pTrueEndJump)
-        {
-            /* Emit a jump instruction that will take us from the 'True' block to the 'endif'. */
-            PKMKCCEVALJUMP  pInstr = (PKMKCCEVALJUMP)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-            pInstr->Core.enmOpcode = kKmkCcEvalInstr_jump;
-            pInstr->Core.iLine     = pCompiler->iLine;
-            pInstr->pNext          = NULL;
-            pIfCore->pTrueEndJump  = pInstr;
-
-            /* The next instruction is the first in the 'False' block of the current 'if'.
-               Should this be an 'else if', this will be the 'if' instruction emitted below. */
-            pIfCore->pNextFalse    = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
-        }
-        else if (iIf == 0)
-            kmk_cc_eval_fatal(pCompiler, pchWord, "2nd 'else' for 'if' at line %u", pIfCore->Core.iLine);
-        else
-            kmk_cc_eval_fatal(pCompiler, pchWord, "2nd 'else' in a row - missing 'endif' for 'if' at line %u?",
-                              pIfCore->Core.iLine);
-    }
-    else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "'else' without 'if'");
-
-    /*
-     * Check for 'else ifxxx'. There can be nothing else following an else.
-     */
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
-    {
-        if (   cchLeft > 2
-            && KMK_CC_WORD_COMP_CONST_2(pchWord, "if"))
-        {
-            pchWord += 2;
-            cchLeft -= 2;
-
-            if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pCompiler, pchWord, cchLeft))
-                return kmk_cc_eval_do_if(pCompiler, pchWord, cchLeft, 1 /* in else */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "eq", 2))
-                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 2, cchLeft - 2, 1 /* in else */, 1 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "def", 3))
-                return kmk_cc_eval_do_ifdef(pCompiler, pchWord + 3, cchLeft - 3, 1 /* in else */, 1 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "neq", 3))
-                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 3, cchLeft - 3, 1 /* in else */, 0 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "1of", 3))
-                return kmk_cc_eval_do_if1of(pCompiler, pchWord + 3, cchLeft - 3, 1 /* in else */, 1 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "ndef", 4))
-                return kmk_cc_eval_do_ifdef(pCompiler, pchWord + 4, cchLeft - 4, 1 /* in else */, 0 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "n1of", 4))
-                return kmk_cc_eval_do_if1of(pCompiler, pchWord + 4, cchLeft - 4, 1 /* in else */, 0 /* positive */);
-
-            pchWord -= 2;
-            cchLeft += 2;
+            if (--cOpen == 0)
+                break;
         }
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Bogus stuff after 'else'");
+        else if (ch == chOpen)
+            cOpen++;
     }
-
-    return 1;
-}
-
-
-/**
- * Deals with the 'endif' statement.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'define'.
- * @param   cchLeft     The number of chars left to parse on this line.
- */
-static int kmk_cc_eval_do_endif(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
-{
-    /*
-     * There must be an 'if' on the stack.  We'll POP it.
-     */
-    unsigned iIf = pCompiler->cIfs;
-    if (iIf > 0)
-    {
-        PKMKCCEVALCORE   pNextInstr;
-        PKMKCCEVALIFCORE pIfCore = pCompiler->apIfs[--iIf];
-        pCompiler->cIfs = iIf; /* POP! */
-
-        /* Update the jump targets for all IFs at this level. */
-        pNextInstr = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
-        do
-        {
-            if (pIfCore->pTrueEndJump)
-            {
-                /* Make the true block jump here, to the 'endif'. The false block is already here. */
-                pIfCore->pTrueEndJump->pNext = pNextInstr;
-                KMK_CC_ASSERT(pIfCore->pNextFalse);
-            }
-            else
-            {
-                /* No 'else'. The false-case jump here, to the 'endif'. */
-                KMK_CC_ASSERT(!pIfCore->pNextFalse);
-                pIfCore->pNextFalse = pNextInstr;
-            }
-
-            pIfCore = pIfCore->pPrevCond;
-        } while (pIfCore);
-    }
-    else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "'endif' without 'if'");
+    if (   off + 1 != cchSubprog
+        || !kmk_cc_eval_is_exp_compilable(pchSubprog, (uint32_t)cchSubprog))
+        return 0;
 
     /*
-     * There shouldn't be anything trailing an 'endif'.
+     * Emit it.
      */
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (!cchLeft) { /* likely */ }
-    else kmk_cc_eval_fatal(pCompiler, pchWord, "Bogus stuff after 'else'");
-
-    return 1;
-}
-
-
-/**
- * Parses a 'include file...', 'sinclude file...', '-include file...',
- * 'includedep file...', 'includedep-queue file...' and
- * 'includedep-flush file...'
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after the include directive.
- * @param   cchLeft     The number of chars left to parse on this line.
- * @param   enmOpcode   The opcode for the include directive we're parsing.
- */
-static int kmk_cc_eval_do_include(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, KMKCCEVALINSTR enmOpcode)
-{
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
-    {
-        /*
-         * Split what's left up into words.
-         */
-/** @todo GNU make supports escape sequences for spaces here (they confusingly refers to this as quoting).  So, it's possible
- * to include C:/Program\ Files/kBuild/footer.kmk if we wanted to.  It my intention to add support for double and/or single
- * quoted files names to offer an alternative way of addressing this. */
-        unsigned cWords = kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft);
-        KMK_CC_EVAL_DPRINTF(("%s: cWords=%d\n", g_apszEvalInstrNms[enmOpcode], cWords));
-        if (cWords)
-        {
-            PKMKCCEVALINCLUDE pInstr = (PKMKCCEVALINCLUDE)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail,
-                                                                                  KMKCCEVALINCLUDE_SIZE(cWords));
-            pInstr->Core.enmOpcode = enmOpcode;
-            pInstr->Core.iLine     = pCompiler->iLine;
-            pInstr->cFiles         = cWords;
-            kmk_cc_eval_init_spp_array_from_duplicated_words(pCompiler, cWords, pCompiler->paWords, pInstr->aFiles);
-            kmk_cc_block_realign(pCompiler->ppBlockTail);
-        }
-        else
-            KMK_CC_ASSERT(0);
-    }
-    else
-        KMK_CC_EVAL_DPRINTF(("%s: include without args\n", g_apszEvalInstrNms[enmOpcode]));
-    return 1;
-}
-
-
-static int kmk_cc_eval_do_vpath(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
-{
-    kmk_cc_eval_fatal(pCompiler, NULL, "vpath directive is not implemented\n");
-    return 1;
-}
-
-
-/**
- * Called when any previous recipe must have ended and can be finalized.
- *
- * This occurs when encountering an assignement, a new recipe or the end of the
- * complication unit.
- *
- * @param   pCompiler   The compiler state.
- */
-static void kmk_cc_eval_end_of_recipe(PKMKCCEVALCOMPILER pCompiler, const char *pchWord)
-{
-    if (pCompiler->pRecipe)
-    {
-        /** @todo do stuff here. */
-        kmk_cc_eval_fatal(pCompiler, pchWord, "end-of-recipe handling not implemented yet");
-    }
-}
-
-
-static void kmk_cc_eval_handle_command(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
-{
-    kmk_cc_eval_fatal(pCompiler, pchWord, "command handling not implemented yet");
-}
-
+    pInstr = (PKMKCCEVALEXPAND)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pInstr), kKmkCcEvalInstr_expand);
+    pInstr->uPadding = 0;
+    pszCopy = kmk_cc_block_strdup(pCompiler->ppBlockTail, pchSubprog, (uint32_t)cchSubprog);
+    kmk_cc_block_realign(pCompiler->ppBlockTail);
+    rc = kmk_cc_exp_compile_subprog(pCompiler->ppBlockTail, pszCopy, (uint32_t)cchSubprog, &pInstr->Subprog);
+    KMK_CC_ASSERT(rc == 0); (void)rc;
+    kmk_cc_block_realign(pCompiler->ppBlockTail);
+    pInstr->pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
 
-/**
- * Pick up the recipe parsing at the colon.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchWord0    The first word.
- * @param   cchWord0    The length of the first word.
- * @param   enmToken0   The classification of the first word.
- * @param   pchColon    The colon.
- * @param   cchLeft     How much is left, starting at the colon.
- */
-static int kmk_cc_eval_handle_recipe_cont_colon(PKMKCCEVALCOMPILER pCompiler, const char *pchWord0, size_t cchWord0,
-                                                KMKCCEVALTOKEN enmToken0, const char *pchColon, size_t cchLeft)
-{
-    kmk_cc_eval_fatal(pCompiler, pchWord0, "recipe handling not implemented yet (#1)");
+    /* The interpreter records any waiting rule before expanding the line. */
+    if (pCompiler->cIfs == 0)
+        pCompiler->fRuleMaybePending = 0;
     return 1;
 }
 
 
 /**
- * Pick up the recipe parsing at the 2nd word (after it was determined not to be
- * an assignment operator after all).
+ * Deals with a line that is most likely a rule by adding it to the
+ * interpreter chunk.
  *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
+ * @returns 1 to indicate we've handled the line.
  * @param   pCompiler   The compiler state.
- * @param   pchWord0    The first word.
- * @param   cchWord0    The length of the first word.
- * @param   pchWord     Where to continue parsing.
- * @param   cchLeft     How much is left to parse.
+ * @param   pchWord     The start of the line (after leading spaces).
+ * @param   cchLeft     The number of chars left on the line.
  */
-static int kmk_cc_eval_handle_recipe_cont_2nd_word(PKMKCCEVALCOMPILER pCompiler, const char *pchWord0, size_t cchWord0,
-                                                   const char *pchWord, size_t cchLeft)
+static int kmk_cc_eval_handle_recipe(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-//    const char *pchColon = memchr()
-
-    kmk_cc_eval_fatal(pCompiler, pchWord, "recipe handling not implemented yet (#2)");
-    return 1;
-}
-
-
-static void kmk_cc_eval_handle_recipe(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
-{
-    const char *pszColon = NULL;//memchr(pchWord, cchLeft);
-    if (pszColon)
-    {
-
-
-        kmk_cc_eval_fatal(pCompiler, pchWord, "recipe handling not implemented yet (#3)");
-    }
-    else if (pchWord[0] == '$')
-    {
-
-    }
-    else
-        kmk_cc_eval_fatal(pCompiler, pchWord,
-                          "Not variable assignment. Could be a complicated indirect recipe definition, however that's currently not supported.");
-
-}
-
+    /* The kBuild-define-xxx and friends are stateful, leave them alone. */
+    if (cchLeft > 7 && KMK_CC_WORD_COMP_CONST_7(pchWord, "kBuild-"))
+        kmk_cc_eval_fatal(pCompiler, pchWord, "kBuild language extensions are left to the interpreter");
 
-
-/**
- * Common worker for handling export (non-assign), undefine and unexport.
- *
- * For instructions using the KMKCCEVALVARIABLES structure.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchWord     First non-space chare after the keyword.
- * @param   cchLeft     The number of chars left to parse on this line.
- * @param   fQualifiers The qualifiers.
- */
-static int kmk_cc_eval_do_with_variable_list(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
-                                             KMKCCEVALINSTR enmOpcode, unsigned fQualifiers)
-{
-    if (cchLeft)
-    {
-        /*
-         * Parse the variable name list.  GNU make is using normal word
-         * handling here, so we can share code with the include directives.
-         */
-        unsigned cWords = kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft);
-#ifdef KMK_CC_EVAL_LOGGING_ENABLED
-        unsigned iWord;
-        KMK_CC_EVAL_DPRINTF(("%s: cWords=%d\n", g_apszEvalInstrNms[enmOpcode], cWords));
-        for (iWord = 0; iWord < cWords; iWord++)
-            KMK_CC_EVAL_DPRINTF(("  word[%u]: len=%#05x t=%d '%*.*s'\n", iWord, (int)pCompiler->paWords[iWord].cchWord,
-                                 (int)pCompiler->paWords[iWord].enmToken, (int)pCompiler->paWords[iWord].cchWord,
-                                 (int)pCompiler->paWords[iWord].cchWord, pCompiler->paWords[iWord].pchWord));
-#endif
-        if (cWords)
-        {
-            PKMKCCEVALVARIABLES pInstr = (PKMKCCEVALVARIABLES)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail,
-                                                                                      KMKCCEVALVARIABLES_SIZE(cWords));
-            pInstr->Core.enmOpcode = enmOpcode;
-            pInstr->Core.iLine     = pCompiler->iLine;
-            pInstr->cVars          = cWords;
-            kmk_cc_eval_init_spp_array_from_duplicated_words(pCompiler, cWords, pCompiler->paWords, pInstr->aVars);
-            kmk_cc_block_realign(pCompiler->ppBlockTail);
-        }
-        else
-            KMK_CC_ASSERT(0);
-    }
-    /* else: NOP */
+    kmk_cc_eval_add_chunk_line(pCompiler, 1 /*fEndsRule*/);
     return 1;
 }
 
 
 /**
- * Parses a '[qualifiers] undefine variable [..]' expression.
- *
- * A 'undefine' directive is final, any qualifiers must preceed it.  So, we just
- * have to extract the variable names now.
+ * Deals with a line we didn't find an assignment operator in.
  *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
+ * @returns 1 to indicate we've handled the line.
  * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'define'.
- * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   pchLine     The start of the line (after leading spaces and
+ *                      qualifiers).
+ * @param   cchLine     The number of chars left on the line.
  * @param   fQualifiers The qualifiers.
  */
-static int kmk_cc_eval_do_var_undefine(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, unsigned fQualifiers)
+static int kmk_cc_eval_handle_non_assignment(PKMKCCEVALCOMPILER pCompiler, const char *pchLine, size_t cchLine,
+                                             unsigned fQualifiers)
 {
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (!cchLeft)
-        kmk_cc_eval_fatal(pCompiler, pchWord, "undefine requires a variable name");
-
-    /** @todo GNU make doesn't actually do the list thing for undefine, it seems
-     *        to assume everything after it is a single variable...  Going with
-     *        simple common code for now. */
-    return kmk_cc_eval_do_with_variable_list(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_undefine, fQualifiers);
+    struct variable VarDef;
+    if (fQualifiers || parse_variable_definition(pchLine, &VarDef))
+        kmk_cc_eval_fatal(pCompiler, pchLine, "Assignment parsing mismatch");
+    return kmk_cc_eval_handle_recipe(pCompiler, pchLine, cchLine);
 }
 
 
 /**
- * Parses a '[qualifiers] unexport variable [..]' expression.
- *
- * A 'unexport' directive is final, any qualifiers must preceed it.  So, we just
- * have to extract the variable names now.
+ * Parses what is likely a variable assignment, though it may also be a rule
+ * (with target specific variables) or a function call.
  *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
+ * @returns 1 to indicate we've handled the line.
  * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'define'.
- * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   pchWord     The start of the line (after leading spaces and
+ *                      qualifiers).
+ * @param   cchLeft     The number of chars left on the line.
  * @param   fQualifiers The qualifiers.
  */
-static int kmk_cc_eval_do_var_unexport(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, unsigned fQualifiers)
+static int kmk_cc_eval_handle_assignment_or_recipe(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
+                                                   unsigned fQualifiers)
 {
-    PKMKCCEVALCORE pInstr;
-
-    /*
-     * Join paths with undefine and export, unless it's an unexport all directive.
-     */
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
-        return kmk_cc_eval_do_with_variable_list(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_unexport, fQualifiers);
+    const char * const      pchVarNm    = pchWord;
+    size_t const            cchLine     = cchLeft;
+    size_t                  cchVarNm;
+    size_t                  cch         = 0;
+    enum variable_flavor    enmFlavor;
+    struct variable         VarDef;
+    char                    ch;
 
     /*
-     * We're unexporting all variables.
-     */
-    pInstr = kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-    pInstr->enmOpcode = kKmkCcEvalInstr_unexport_all;
-    pInstr->iLine     = pCompiler->iLine;
-    return 1;
-}
-
-
-/**
- * Parse the value of a 'define' at pCompiler->offNext.
- *
- * This will update 'offNext' to the start of the line following the 'endef'
- * matching the 'define' of the value.
- *
- * The value is prepared for kmk_cc_eval_strcpyv.
- *
- * @returns The value length that we've prepared for copying.
- * @param   pCompiler           The compiler state.
- * @param   pfPlainValue        Where to return whether this is a plain value or
- *                              one needing expansion.
- */
-static size_t kmk_cc_eval_parse_define_value(PKMKCCEVALCOMPILER pCompiler, int *pfPlainValue)
-{
-    /*
-     * Now we need to find the matching 'endef', we support nested ones.
-     *
-     * We look for the lines starting with 'endef' and 'define', like GNU
-     * make does even if we really should also be checking for variable
-     * qualifiers too.
-     *
-     * As we go on looking, we prepare the value in paStrCopySegs.
-     *
-     * Note! We duplicate code/logic from the top level compile loop here.
+     * The variable name ends at a space or the assignment operator.
+     * Variable references are skipped without looking inside them.
      */
-    const char * const  pszContent   = pCompiler->pszContent;
-    size_t              cchContent   = pCompiler->cchContent;
-    int const           chFirstEol   = pCompiler->chFirstEol;
-    size_t const        cchEolSeq    = pCompiler->cchEolSeq;
-
-    unsigned            cNestings    = 1;
-    size_t              offNext      = pCompiler->offNext;
-    unsigned            iLine        = pCompiler->iLine;
-
-    unsigned            cSegs        = 0;
-    size_t              cchValue     = 0;
-    int                 fPlainValue  = 1;
-
     for (;;)
     {
-        /*
-         * Find end of line, preparing to copy it.
-         */
-        if (offNext < cchContent)
+        if (cch < cchLeft)
         {
-            unsigned const  cSegsAtStartOfLine  = cSegs;
-            size_t const    cchValueStartOfLine = cchValue;
-            size_t          offFirstWord        = offNext;
-            const char     *pchLine             = &pszContent[offNext];
-            size_t          cchLine;
-            const char     *pchTmp;
-
-            pCompiler->cEscEols = 0;
-            pCompiler->iEscEol  = 0;
-
-            /* Add newline if necessary and make sure we've got a segment handy. */
-            KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, cSegs + 2);
-            if (cSegs)
+            ch = pchWord[cch];
+            if (!KMK_CC_EVAL_IS_SPACE_DOLLAR_SLASH_OR_ASSIGN(ch))
             {
-                cchValue++;
-                pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = 1;
-                pCompiler->paStrCopySegs[cSegs].pchSrc = "\n";
-                cSegs++;
+                cch++;
+                continue;
             }
-
-            /* Simple case: No escaped EOL, nor the end of the input. */
-            pchTmp = (const char *)memchr(&pszContent[offNext], chFirstEol, cchContent - offNext);
-            if (   pchTmp
-                && (   &pszContent[offNext] == pchTmp
-                    || pchTmp[-1] != '\\'))
+            if (ch == '$')
             {
-                if (   cchEolSeq == 1
-                    || pchTmp[1] == pCompiler->chSecondEol)
-                {
-                    offNext = pchTmp - pszContent;
-                    cchLine = pchTmp - pchLine;
-
-                    cchValue += cchLine;
-                    pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = cchLine;
-                    pCompiler->paStrCopySegs[cSegs].pchSrc = pchLine;
-                    cSegs++;
-
-                    while (offFirstWord < offNext && KMK_CC_EVAL_IS_SPACE(pszContent[offFirstWord]))
-                        offFirstWord++;
-
-                    offNext += cchEolSeq;
-                }
-                else
-                    kmk_cc_eval_fatal_eol(pCompiler, pchTmp, iLine, offNext);
+                cch = kmk_cc_eval_parse_var_exp(pCompiler, pchWord, cchLeft, cch);
+                continue;
             }
-            /* The complicated, less common cases. */
-            else
+            if (ch == '\\')
+            {
+                /* Escaped EOLs have been collapsed already. */
+                cch++;
+                continue;
+            }
+            if (ch == ':')
             {
-                size_t fPendingSpace = 0;
-                for (;;)
+                /* ':=' and '::=' ends the name, otherwise it's a rule. */
+                if (   cch + 1 < cchLeft
+                    && (   pchWord[cch + 1] == '='
+                        || (pchWord[cch + 1] == ':' && cch + 2 < cchLeft && pchWord[cch + 2] == '=')))
                 {
-                    /* Find the first non-space char on this line.  We always need it. */
-                    size_t offThisFirstWord = offNext;
-                    size_t offEol = pchTmp ? pchTmp - pszContent : cchContent;
-                    if (offFirstWord == offNext)
-                    {
-                        while (offFirstWord < offEol && KMK_CC_EVAL_IS_SPACE(pszContent[offFirstWord]))
-                            offFirstWord++;
-                        if (pCompiler->cEscEols > 0)
-                            offThisFirstWord = offFirstWord;
-                    }
-                    else
-                        while (offThisFirstWord < offEol && KMK_CC_EVAL_IS_SPACE(pszContent[offThisFirstWord]))
-                            offThisFirstWord++;
-
-                    /* We normally need one, so just make sure once. */
-                    KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, cSegs + 1);
-
-                    if (pchTmp)
-                    {
-                        if (   cchEolSeq == 1
-                            || pchTmp[1] == pCompiler->chSecondEol)
-                        {
-                            size_t const offThis = offNext;
-                            size_t offEsc;
-                            int fDone;
-                            offNext = pchTmp - pszContent;
-
-                            /* Is it an escape sequence? */
-                            if (   !offNext
-                                || pchTmp[-1] != '\\')
-                                fDone = 1;
-                            else if (offNext < 2 || pchTmp[-2] != '\\')
-                            {
-                                offEsc = offNext - 1;
-                                fDone = 0;
-                            }
-                            else
-                            {
-                                /* Count how many backslashes there are. Must be odd number to be an escape
-                                   sequence.  Normally we keep half of them, except for command lines.  */
-                                size_t cSlashes = 2;
-                                while (offNext >= cSlashes && pchTmp[0 - cSlashes] == '\\')
-                                    cSlashes--;
-                                fDone = !(cSlashes & 1);
-                                offEsc = offNext - (cSlashes >> 1);
-                            }
-
-                            /* Anything to copy? */
-/** @todo fixme tomorrow! */
-                            cchLine = offThisFirstWord - offNext;
-                            if (cchLine)
-                            {
-                                pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace
-                                                                                      ? -(ssize_t)cchLine : (ssize_t)cchLine;
-                                pCompiler->paStrCopySegs[cSegs].pchSrc = &pszContent[offThisFirstWord];
-                                cSegs++;
-                            }
-
-                            if (fDone)
-                            {
-                                cchLine = &pszContent[offNext] - pchLine;
-                                offNext += cchEolSeq;
-                                break;
-                            }
-
-                            /* Record it. */
-                            if (pCompiler->cEscEols < pCompiler->cEscEolsAllocated) { /* likely */ }
-                            else
-                            {
-                                KMK_CC_ASSERT(pCompiler->cEscEols == pCompiler->cEscEolsAllocated);
-                                pCompiler->cEscEolsAllocated = pCompiler->cEscEolsAllocated
-                                                             ? pCompiler->cEscEolsAllocated * 2 : 2;
-                                pCompiler->paEscEols = (PKMKCCEVALESCEOL)xrealloc(pCompiler->paEscEols,
-                                                                                    pCompiler->cEscEolsAllocated
-                                                                                  * sizeof(pCompiler->paEscEols[0]));
-                            }
-                            pCompiler->paEscEols[pCompiler->cEscEols].offEsc = offEsc;
-                            pCompiler->paEscEols[pCompiler->cEscEols].offEol = offNext;
-                            pCompiler->cEscEols++;
-
-                            /* Anything to copy? */
-                            cchLine = offThisFirstWord - offNext;
-                            if (cchLine)
-                            {
-                            }
-
-                            /* Advance. */
-                            offNext += cchEolSeq;
-                            if (offFirstWord == offEsc)
-                            {
-                                offFirstWord = offNext;
-                                pCompiler->iEscEol++;
-                            }
-                        }
-                        else
-                            kmk_cc_eval_fatal_eol(pCompiler, pchTmp, pCompiler->iLine, off);
-                    }
-                    else
-                    {
-                        /* End of input. Happens only once per compilation, nothing to optimize for. */
-
-                        if (offFirstWord == offNext)
-                            while (offFirstWord < cchContent && KMK_CC_EVAL_IS_SPACE(pszContent[offFirstWord]))
-                                offFirstWord++;
-
-                        KMK_CC_EVAL_ENSURE_STRCOPY_SEGS(pCompiler, cSegs + 2);
-                        if (cSegs == cSegsAtStartOfLine)
-                        {
-                            /* No escaped EOLs. */
-                            cchLine = &pszContent[cchContent] - pchLine;
-                            cchValue += cchLine;
-                            pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = cchLine;
-                            pCompiler->paStrCopySegs[cSegs].pchSrc = pchLine;
-                            cSegs++;
-                        }
-                        else
-                        {
-                            if (offFirstWordThisLine < cchContent)
-                            {
-                                cchLine = cchContent - offFirstWordThisLine;
-                                cchValue += cchLine;
-                                pCompiler->paStrCopySegs[cSegs].cchSrcAndPrependSpace = fPendingSpace
-                                                                                      ? -(ssize_t)cchLine : (ssize_t)cchLine;
-                                pCompiler->paStrCopySegs[cSegs].pchSrc = &pszContent[offFirstWordThisLine];
-                                cSegs++;
-                            }
-                            cchLine = &pszContent[cchContent] - pchLine;
-                        }
-                        offNext = cchContent;
-                        break;
-                    }
-                    pchTmp = (const char *)memchr(&pszContent[offNext], chFirstEol, cchContent - offNext);
+                    cchVarNm = cch;
+                    break;
                 }
+                return kmk_cc_eval_handle_non_assignment(pCompiler, pchVarNm, cchLine, fQualifiers);
             }
-            KMK_CC_ASSERT(offNext       <= cchContent);
-            KMK_CC_ASSERT(offNext       >= off + cchLine);
-            KMK_CC_ASSERT(off + cchLine <= cchContent && cchLine <= cchContent);
-            KMK_CC_ASSERT(offFirstWord  <= off + cchLine);
-            KMK_CC_ASSERT(offFirstWord  >= off);
-            KMK_CC_ASSERT(pszContent[offFirstWord] != ' ' && pszContent[offFirstWord] != '\t');
-
-            KMK_CC_EVAL_DPRINTF(("#%03u: %*.*s\n", pCompiler->iLine, (int)cchLine, (int)cchLine, &pszContent[off]));
-
-            /*
-             * Look for 'endef' and 'define' directives.
-             */
-            cchLine -= offFirstWord - off;
-            if (   cchLine >= 5 /* shortest word is 5 chars ('endef', 'local') */
-                && pchLine[0] != pCompiler->chCmdPrefix)
+            if (ch == '=')
             {
-                pchTmp = &pszContent[offFirstWord];
-                if (!KMK_CC_EVAL_IS_1ST_IN_VARIABLE_KEYWORD(*pchTmp))
-                { /* Kind of likely (and saves one indent). */ }
-                else if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchTmp, cchLine, "endef", 5))
+                /* Back up over the first char of a two char operator. */
+                if (cch > 0)
                 {
-                    cNestings--;
-                    if (cNestings == 0)
-                    {
-                        cchValue = cchValueStartOfLine;
-                        cSegs    = cSegsAtStartOfLine;
-                        break;
-                    }
+                    char const chPrev = pchWord[cch - 1];
+                    if (   chPrev == '+'
+                        || chPrev == '?'
+#ifdef CONFIG_WITH_PREPEND_ASSIGNMENT
+                        || chPrev == '<'
+#endif
+                        || chPrev == '!')
+                        cch--;
                 }
-                else
-                    for (;;)
-                    {
-                        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchTmp, cchLine, "define", 6))
-                        {
-                            cNestings++;
-                            break;
-                        }
-
-                        /* GNU make doesn't do this, but I think it makes sense. */
-                        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchTmp, cchLine, "local", 5))
-                        {
-                            pchTmp  += 5;
-                            cchLine -= 5;
-                        }
-                        else if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchTmp, cchLine, "export", 6))
-                        {
-                            pchTmp  += 6;
-                            cchLine -= 6;
-                        }
-                        else if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchTmp, cchLine, "private", 7))
-                        {
-                            pchTmp  += 7;
-                            cchLine -= 7;
-                        }
-                        else if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchTmp, cchLine, "override", 8))
-                        {
-                            pchTmp  += 8;
-                            cchLine -= 8;
-                        }
-                        else
-                            break;
-                        KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchTmp, cchLine);
-                    }
+                cchVarNm = cch;
+                break;
             }
-
-            /*
-             * Advance to the next line.
-             */
-            iLine += pCompiler->cEscEols + 1;
+            KMK_CC_ASSERT(KMK_CC_EVAL_IS_SPACE(ch));
         }
-        else
-            kmk_cc_eval_fatal(pCompiler, NULL, )
+        cchVarNm = cch;
+        break;
     }
+    pchWord += cchVarNm;
+    cchLeft -= cchVarNm;
+    KMK_CC_EVAL_SKIP_SPACES(pchWord, cchLeft);
 
     /*
-     * Update globals and return values.
+     * The assignment operator.
      */
-    pCompiler->offNext      = offNext;
-    pCompiler->iLine        = iLine;
-    pCompiler->cStrCopySegs = cSegs;
-
-    *pfPlainValue = fPlainValue;
-    return cchValue;
-}
-
-/**
- * Parses a 'define variable' expression.
- *
- * A 'define' directive is final, any qualifiers must preceed it.  So, we just
- * have to extract the variable name now, well and find the corresponding
- * 'endef'.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'define'.
- * @param   cchLeft     The number of chars left to parse on this line.
- * @param   fQualifiers The qualifiers.
- */
-static int kmk_cc_eval_do_var_define(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft, unsigned fQualifiers)
-{
-    /*
-     * Now comes the variable name.  It may optionally be followed by an
-     * assignment operator to indicate what kind of variable is being defined.
-     */
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    unsigned cWords = cchLeft ? kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft) : 0;
-    if (cWords >= 1)
+    if (cchLeft >= 1 && pchWord[0] == '=')
     {
-        /*
-         * Check for variable assignment operator.  Kind of tedious...
-         */
-        KMKCCEVALINSTR  enmOpcode;
-        PKMKCCEVALWORD  pVarWord = pCompiler->paWords;
-        if (   cWords == 1
-            && (   pVarWord->cchWord == 0
-                || pVarWord->pchWord[pVarWord->cchWord - 1] != '='))
-            enmOpcode = kKmkCcEvalInstr_define_recursive; /* very likely */
-        else if (   pVarWord->cchWord > 0
-                 && pVarWord->pchWord[pVarWord->cchWord - 1] == '=')
-        {
-            if (pVarWord->cchWord == 1)
-                enmOpcode = kKmkCcEvalInstr_define_recursive;
-            else
-            {
-                char chPenultimate = pVarWord->pchWord[pVarWord->cchWord - 2];
-                if (chPenultimate == '?')
-                    enmOpcode = kKmkCcEvalInstr_define_if_new;
-                else if (chPenultimate == ':')
-                    enmOpcode = kKmkCcEvalInstr_assign_simple;
-                else if (chPenultimate == '+')
-                    enmOpcode = kKmkCcEvalInstr_assign_append;
-                else if (chPenultimate == '<')
-                    enmOpcode = kKmkCcEvalInstr_assign_prepend;
-                else
-                    enmOpcode = kKmkCcEvalInstr_define_recursive;
-            }
-            pVarWord->cchWord -= enmOpcode == kKmkCcEvalInstr_define_recursive ? 1 : 2;
-            if (cWords > 1)
-                kmk_cc_eval_fatal(pCompiler, pCompiler->paWords[1].pchWord,
-                                  "Bogus stuff after 'define' variable name and assignment operator");
-        }
-        else
-        {
-            PCKMKCCEVALWORD pOpWord = &pCompiler->paWords[1];
-            KMK_CC_ASSERT(cWords > 1);
-            if (   pOpWord->cchWord == 1
-                && pOpWord->pchWord[0] == '=')
-                enmOpcode = kKmkCcEvalInstr_define_recursive;
-            else if (   pOpWord->cchWord == 2
-                     && pOpWord->pchWord[1] == '=')
-            {
-                char chFirst = pVarWord->pchWord[0];
-                if (chFirst == '?')
-                    enmOpcode = kKmkCcEvalInstr_define_if_new;
-                else if (chFirst == ':')
-                    enmOpcode = kKmkCcEvalInstr_assign_simple;
-                else if (chFirst == '+')
-                    enmOpcode = kKmkCcEvalInstr_assign_append;
-                else if (chFirst == '<')
-                    enmOpcode = kKmkCcEvalInstr_assign_prepend;
-                else
-                    kmk_cc_eval_fatal(pCompiler, pOpWord->pchWord, "Bogus stuff after 'define' variable name");
-            }
-            else
-                kmk_cc_eval_fatal(pCompiler, pOpWord->pchWord, "Bogus stuff after 'define' variable name");
-            if (cWords > 2)
-                kmk_cc_eval_fatal(pCompiler, pCompiler->paWords[2].pchWord,
-                                  "Bogus stuff after 'define' variable name and assignment operator");
-        }
-
-        /*
-         * The variable name must not be empty.
-         */
-        if (pVarWord->cchWord)
-        {
-            int const           fPlainVarNm = pVarWord->enmToken == kKmkCcEvalToken_WordPlain;
-            const char *        pchVarNm    = pVarWord->pchWord;
-            size_t              cchVarNm    = pVarWord->cchWord;
-            PKMKCCEVALASSIGN    pInstr;
-            size_t              cchValue;
-            const char         *pszValue;
-            int                 fPlainValue;
-
-            if (   enmOpcode == kKmkCcEvalInstr_define_recursive
-                || enmOpcode == kKmkCcEvalInstr_define_if_new)
-            {
-                PKMKCCEVALASSIGNDEF pInstrDef;
-                pInstrDef = (PKMKCCEVALASSIGNDEF)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstrDef));
-                pInstr = &pInstrDef->AssignCore;
-                pInstrDef->pEvalProg = NULL; /** @todo consider this later at some point, need some trial and error approach. */
-            }
-            else
-                pInstr = (PKMKCCEVALASSIGN)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-
-            pInstr->Core.enmOpcode = enmOpcode;
-            pInstr->Core.iLine     = pCompiler->iLine;
-            pInstr->fExport        = (fQualifiers & KMK_CC_EVAL_QUALIFIER_EXPORT)   != 0;
-            pInstr->fOverride      = (fQualifiers & KMK_CC_EVAL_QUALIFIER_OVERRIDE) != 0;
-            pInstr->fPrivate       = (fQualifiers & KMK_CC_EVAL_QUALIFIER_PRIVATE)  != 0;
-            pInstr->fLocal         = (fQualifiers & KMK_CC_EVAL_QUALIFIER_LOCAL)    != 0;
-
-            cchValue = kmk_cc_eval_parse_define_value(pCompiler, &fPlainValue);
-            pszValue = kmk_cc_eval_strdup_prepped(pCompiler, cchValue);
-            if (fPlainVarNm)
-                pchVarNm = strcache2_add(&variable_strcache, pchVarNm, cchVarNm);
-            else
-            {
-/** @todo fix work copying. */
-//                pCompiler->iEscEol = iEscEolVarNm;
-                cchVarNm = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchVarNm, cchVarNm);
-                pchVarNm = kmk_cc_eval_strdup_prepped(pCompiler, cchVarNm);
-            }
-            kmk_cc_block_realign(pCompiler->ppBlockTail);
-            KMK_CC_EVAL_DPRINTF(("%s: define '%s'\n%s\nendef\n", g_apszEvalInstrNms[enmOpcode], pchVarNm, pszValue));
-
-            kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Variable, pchVarNm, cchVarNm, fPlainVarNm);
-            kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Value, pszValue, cchValue, fPlainValue);
-
-            pInstr->pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
-        }
-        else
-            kmk_cc_eval_fatal(pCompiler, pchWord, "Empty variable name after 'define'");
+        enmFlavor = f_recursive;
+        pchWord += 1;
+        cchLeft -= 1;
+    }
+    else if (cchLeft >= 2 && pchWord[1] == '=' && pchWord[0] == ':')
+    {
+        enmFlavor = f_simple;
+        pchWord += 2;
+        cchLeft -= 2;
+    }
+    else if (cchLeft >= 2 && pchWord[1] == '=' && pchWord[0] == '+')
+    {
+        enmFlavor = f_append;
+        pchWord += 2;
+        cchLeft -= 2;
+    }
+#ifdef CONFIG_WITH_PREPEND_ASSIGNMENT
+    else if (cchLeft >= 2 && pchWord[1] == '=' && pchWord[0] == '<')
+    {
+        enmFlavor = f_prepend;
+        pchWord += 2;
+        cchLeft -= 2;
+    }
+#endif
+    else if (cchLeft >= 2 && pchWord[1] == '=' && pchWord[0] == '?')
+    {
+        enmFlavor = f_conditional;
+        pchWord += 2;
+        cchLeft -= 2;
+    }
+    else if (cchLeft >= 2 && pchWord[1] == '=' && pchWord[0] == '!')
+    {
+        enmFlavor = f_shell;
+        pchWord += 2;
+        cchLeft -= 2;
+    }
+    else if (cchLeft >= 3 && pchWord[0] == ':' && pchWord[1] == ':' && pchWord[2] == '=')
+    {
+        enmFlavor = f_simple;
+        pchWord += 3;
+        cchLeft -= 3;
     }
     else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Expected variable name after 'define'");
-    return 1;
-}
-
+    {
+        /* A lone function call, perhaps? */
+        if (   !fQualifiers
+            && *pchVarNm == '$'
+            && kmk_cc_eval_emit_expand(pCompiler, pchVarNm, cchLine))
+            return 1;
+        return kmk_cc_eval_handle_non_assignment(pCompiler, pchVarNm, cchLine, fQualifiers);
+    }
+    KMK_CC_EVAL_SKIP_SPACES(pchWord, cchLeft);
 
-/**
- * Emits a 'expand(-and-eval)' instruction.
- *
- * @returns 1 to indicate we've handled a keyword (see
- *          kmk_cc_eval_try_handle_keyword).
- * @param   pCompiler   The compiler state.
- * @param   pchSubprog  The subprogram that needs expanding.
- * @param   cchSubprog  The length of the subprogram.
- * @param   iEscEol     The escaped EOL index corresponding to pchSubprog.
- */
-static int kmk_cc_eval_emit_expand(PKMKCCEVALCOMPILER pCompiler, const char *pchSubprog, size_t cchSubprog, unsigned iEscEolVarNm)
-{
     /*
-     * We're unexporting all variables.
+     * Check that the interpreter sees it exactly the same way.
      */
-    size_t           cchCopy;
-    char            *pszCopy;
-    PKMKCCEVALEXPAND pInstr;
-
-    pCompiler->iEscEol = iEscEolVarNm;
-    cchCopy = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchSubprog, cchSubprog);
-    pszCopy = kmk_cc_eval_strdup_prepped(pCompiler, cchCopy);
-    kmk_cc_block_realign(pCompiler->ppBlockTail);
-
-    pInstr = (PKMKCCEVALEXPAND)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-    pInstr->Core.enmOpcode = kKmkCcEvalInstr_expand;
-    pInstr->Core.iLine     = pCompiler->iLine;
-    pInstr->uPadding       = 0;
-    /** @todo Make the subprogram embed necessary strings. */
-    kmk_cc_eval_compile_string_exp_subprog(pCompiler, pszCopy, cchCopy, &pInstr->Subprog);
-
+    if (   !parse_variable_definition(pchVarNm, &VarDef)
+        || VarDef.name   != pchVarNm
+        || VarDef.length != cchVarNm
+        || VarDef.flavor != enmFlavor
+        || VarDef.value  != pchWord)
+        kmk_cc_eval_fatal(pCompiler, pchVarNm, "Assignment parsing mismatch");
+
+    if (enmFlavor != f_shell)
+        kmk_cc_eval_do_assign(pCompiler, pchVarNm, cchVarNm, pchWord, cchLeft, enmFlavor, fQualifiers);
+    else
+        kmk_cc_eval_add_chunk_line(pCompiler, !(fQualifiers & KMK_CC_EVAL_QUALIFIER_LOCAL) /*fEndsRule*/);
     return 1;
 }
-
-
-static int kmk_cc_eval_handle_assignment_or_recipe(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
-                                                   unsigned fQualifiers)
+
+/**
+ * Scans the body of a define, up to and including the matching 'endef'.
+ *
+ * Since we cannot tell whether the interpreter will process the define as
+ * part of an ignored conditional branch or not, we require it to end at the
+ * same line either way.  Nested defines are left to the interpreter.
+ *
+ * @returns The length of the value (in pszDefValue) when @a fWantValue is set,
+ *          otherwise 0.
+ * @param   pCompiler   The compiler state.  The current line is extended to
+ *                      include the 'endef' line on success.
+ * @param   fWantValue  Whether to assemble the value like do_define() does.
+ */
+static size_t kmk_cc_eval_scan_define_body(PKMKCCEVALCOMPILER pCompiler, int fWantValue)
 {
-    /*
-     * We're currently at a word which may or may not be a variable name
-     * followed by an assignment operator, alternatively it must be a recipe.
-     * We need to figure this out and deal with it in the most efficient
-     * manner as this is a very common occurence.
-     */
-    unsigned const  iEscEolVarNm = pCompiler->iEscEol;
-    int             fPlainVarNm  = 1;
-    const char     *pchVarNm     = pchWord;
-    size_t          cchVarNm;
-    size_t          cch = 0;
-    size_t          cchSubprog = 0;
-    char            ch;
+    const char * const  pszContent = pCompiler->pszContent;
+    char const          chCmdPrefix = pCompiler->chCmdPrefix;
+    size_t              off        = pCompiler->offNext;
+    unsigned            cLines     = pCompiler->cLines;
+    size_t              cchValue   = 0;
 
-    /*
-     * The variable name.  Complicate by there being no requirement of a space
-     * preceeding the assignment operator, as well as that the variable name
-     * may include variable references with spaces (function++) in them.
-     */
-    for (;;)
+    if (fWantValue && !pCompiler->pszDefValue)
     {
-        if (cch < cchLeft)
-        { /*likely*/ }
-        else
-        {
-            /* Single word, join paths with word + whitespace. */
-            KMK_CC_ASSERT(cch == cchLeft);
-            cchVarNm = cch;
-            pchWord += cch;
-            cchLeft -= cch;
-            break;
-        }
+        pCompiler->cbDefValue  = 256;
+        pCompiler->pszDefValue = (char *)xmalloc(pCompiler->cbDefValue);
+    }
 
-        ch = pchWord[cch];
-        if (!KMK_CC_EVAL_IS_SPACE_DOLLAR_SLASH_OR_ASSIGN(ch))
-            cch++;
-        /* Space? */
-        else if (KMK_CC_EVAL_IS_SPACE(ch))
-        {
-            cchVarNm = cch;
-            pchWord += cch;
-            cchLeft -= cch;
-            KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-            break;
-        }
-        /* Variable expansion may contain spaces, so handle specially. */
-        else if (ch == '$')
-        {
-            size_t const offStart = cch;
-            cch = kmk_cc_eval_parse_var_exp(pCompiler, pchWord, cchLeft, cch);
-            cchSubprog += cch - offStart;
-            fPlainVarNm = 0;
-        }
-        /* Check out potential recipe, simple assignment or DOS drive letter separator. */
-        else if (ch == ':')
+    while (off < pCompiler->cchContent)
+    {
+        size_t      offEol;
+        unsigned    cLinesThis;
+        size_t      offNext    = kmk_cc_eval_find_eol(pCompiler, off, &offEol, &cLinesThis);
+        size_t      cchLine    = offEol - off;
+        char       *pszCollapsed = kmk_cc_eval_get_scratch(pCompiler, (cchLine + 1) * 2);
+        char       *pszPrepped   = pszCollapsed + cchLine + 1;
+        char       *pszEol;
+        const char *p;
+        const char *p2;
+        int         fDefineEnd = 0;
+        int         fIgnoredEnd;
+
+        cLines += cLinesThis;
+
+        /* What do_define sees. */
+        memcpy(pszCollapsed, &pszContent[off], cchLine);
+        pszCollapsed[cchLine] = '\0';
+        pszEol = collapse_continuations(pszCollapsed, (unsigned int)cchLine);
+
+        memcpy(pszPrepped, &pszContent[off], cchLine);
+        pszPrepped[cchLine] = '\0';
+        eval_prep_line_for_compiler(pszPrepped, (unsigned int)cchLine);
+
+        if (pszCollapsed[0] != chCmdPrefix)
         {
-            if (   cch + 1 < cchLeft
-                && pchWord[cch + 1] != '=')
+            size_t cch;
+            p = next_token(pszCollapsed);
+            cch = pszEol - p;
+            if (   (cch == 6 || (cch > 6 && ISBLANK(p[6])))
+                && strneq(p, "define", 6))
+                kmk_cc_eval_fatal(pCompiler, NULL, "Nested define");
+            if (   (cch == 5 || (cch > 5 && ISBLANK(p[5])))
+                && strneq(p, "endef", 5))
             {
-                cchVarNm = cch;
-                pchWord += cch;
-                cchLeft -= cch;
-                break;
+                /* The comment free part is the same up to and including the 'endef'. */
+                if (*next_token(&pszPrepped[p - pszCollapsed + 5]) != '\0')
+                    kmk_cc_eval_fatal(pCompiler, NULL, "Extraneous text after 'endef'");
+                fDefineEnd = 1;
             }
-#ifdef HAVE_DOS_PATHS
-            /* Don't confuse the first colon in:
-                    C:/Windows/System32/Kernel32.dll: C:/Windows/System32/NtDll.dll
-               for a recipe, it is only the second one which counts. */
-            if (   cch == 1
-                && isalpha((unsigned char)pchWord[0]))
-                cch++;
-            else
-#endif
-            if (!fQualifiers)
-                return kmk_cc_eval_handle_recipe_cont_colon(pCompiler, pchWord, cch,
-                                                            fPlainVarNm
-                                                            ? kKmkCcEvalToken_WordPlain : kKmkCcEvalToken_WordWithDollar,
-                                                            pchWord + cch, cchLeft - cch);
-            /** @todo we may have words already preparsed here so restarting is easy...  */
-            return 0; /* retry with preceeding keywords */
         }
-        /* Check out assignment operator. */
-        else if (ch == '=')
+
+        /* What eval sees when ignoring the define. */
+        p = pszPrepped;
+        NEXT_TOKEN(p);
+        p2 = end_of_token(p);
+        fIgnoredEnd = p2 - p == 5 && strneq(p, "endef", 5);
+        if (fIgnoredEnd)
         {
-            if (cch > 0)
-            {
-                char chPrev = pchWord[cch - 1];
-                if (chPrev == ':' || chPrev == '+' || chPrev == '?' || chPrev == '<')
-                    cch--;
-                cchVarNm = cch;
-                pchWord += cch;
-                cchLeft -= cch;
-                break;
-            }
-            kmk_cc_eval_fatal(pCompiler, pchWord, "Empty variable name.");
+            NEXT_TOKEN(p2);
+            fIgnoredEnd = *p2 == '\0';
         }
-        /* Check out potential escaped EOL sequence. */
-        else if (ch == '\\')
+
+        if (   fDefineEnd != fIgnoredEnd
+            || (fIgnoredEnd && pszCollapsed[0] == chCmdPrefix))
+            kmk_cc_eval_fatal(pCompiler, NULL, "Ambiguous 'endef'");
+
+        if (fDefineEnd)
         {
-            unsigned const iEscEol = pCompiler->iEscEol;
-            if (iEscEol >= pCompiler->cEscEols)
-                cch++;
-            else
+            pCompiler->offEol  = offEol;
+            pCompiler->offNext = offNext;
+            pCompiler->cLines  = cLines;
+            return cchValue ? cchValue - 1 : 0;
+        }
+
+        /* Add the line to the value, separating lines with a newline. */
+        if (fWantValue)
+        {
+            size_t const cchCollapsed = pszEol - pszCollapsed;
+            if (cchValue + cchCollapsed + 1 > pCompiler->cbDefValue)
             {
-                size_t offCur = &pchWord[cch] - pCompiler->pszContent;
-                if (offCur < pCompiler->paEscEols[iEscEol].offEol)
-                    cch++;
-                else
-                {
-                    cchVarNm = cch;
-                    KMK_CC_ASSERT(offCur == pCompiler->paEscEols[iEscEol].offEol);
-                    cch = pCompiler->paEscEols[iEscEol].offEol + pCompiler->cchEolSeq - offCur;
-                    pCompiler->iEscEol = iEscEol + 1;
-                    pchWord += cch;
-                    cchLeft -= cch;
-                    KMK_CC_EVAL_SKIP_SPACES(pCompiler, pchWord, cchLeft);
-                    break;
-                }
+                pCompiler->cbDefValue  = (cchValue + cchCollapsed + 1 + 255) & ~(size_t)255;
+                pCompiler->pszDefValue = (char *)xrealloc(pCompiler->pszDefValue, pCompiler->cbDefValue);
             }
+            memcpy(&pCompiler->pszDefValue[cchValue], pszCollapsed, cchCollapsed);
+            cchValue += cchCollapsed;
+            pCompiler->pszDefValue[cchValue++] = '\n';
         }
-        else
-            KMK_CC_ASSERT(0);
+        off = offNext;
     }
 
+    kmk_cc_eval_fatal(pCompiler, NULL, "Missing 'endef'");
+}
+
+
+/**
+ * Deals with a 'define' (or 'local define') and the lines up to the matching
+ * 'endef'.
+ *
+ * The recursive and conditional flavors are compiled into a define instruction,
+ * the others are turned into an interpreter chunk.
+ *
+ * @returns 1 to indicate we've handled a keyword (see
+ *          kmk_cc_eval_try_handle_keyword).
+ * @param   pCompiler   The compiler state.
+ * @param   pchWord     First char after 'define'.
+ * @param   cchLeft     The number of chars left to parse on this line.
+ * @param   fQualifiers The qualifiers.
+ */
+static int kmk_cc_eval_do_var_define(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
+                                     unsigned fQualifiers)
+{
+    int const               fLocal    = (fQualifiers & KMK_CC_EVAL_QUALIFIER_LOCAL) != 0;
+    enum variable_flavor    enmFlavor = f_recursive;
+    const char             *pchVarNm;
+    size_t                  cchVarNm;
+    int                     fNative;
+    struct variable         VarDef;
+
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (!cchLeft)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Expected variable name after 'define'");
+
     /*
-     * Check for assignment operator.
+     * Like do_define(), the whole remainder is the name unless there is an
+     * assignment operator, which must then end the line.
      */
-    if (cchLeft)
+    if (!parse_variable_definition(pchWord, &VarDef))
     {
-        size_t              cchValue;
-        PKMKCCEVALASSIGN    pInstr;
-        KMKCCEVALINSTR      enmOpcode;
-        int                 fPlainValue;
-        char               *pszValue;
+        pchVarNm = pchWord;
+        cchVarNm = cchLeft;
+        fNative  = 1;
+    }
+    else
+    {
+        pchVarNm  = VarDef.name;
+        cchVarNm  = VarDef.length;
+        enmFlavor = VarDef.flavor;
+        fNative   = (enmFlavor == f_recursive || enmFlavor == f_conditional) && *VarDef.value == '\0';
+    }
+    if (cchVarNm == 0)
+        kmk_cc_eval_fatal(pCompiler, pchWord, "Empty variable name");
 
-        ch = *pchWord;
-        if (ch == '=')
-        {
-            enmOpcode = kKmkCcEvalInstr_assign_recursive;
-            pchWord++;
-            cchLeft--;
-        }
-        else if (cchLeft >= 2 && pchWord[1] == '=')
-        {
-            if (ch == ':')
-                enmOpcode = kKmkCcEvalInstr_assign_simple;
-            else if (ch == '+')
-                enmOpcode = kKmkCcEvalInstr_assign_append;
-            else if (ch == '<')
-                enmOpcode = kKmkCcEvalInstr_assign_prepend;
-            else if (ch == '?')
-                enmOpcode = kKmkCcEvalInstr_assign_if_new;
-            else if (!fQualifiers)
-                return kmk_cc_eval_handle_recipe_cont_2nd_word(pCompiler, pchVarNm, cchVarNm, pchWord, cchLeft);
-            else
-                return 0; /* retry without preceding keywords */
-            pchWord += 2;
-            cchLeft -= 2;
-        }
-        else if (!fQualifiers)
-            return kmk_cc_eval_handle_recipe_cont_2nd_word(pCompiler, pchVarNm, cchVarNm, pchWord, cchLeft);
-        else
-            return 0; /* retry without preceding keywords */
+    /* 'local define' doesn't record waiting rules, so it must join any pending chunk. */
+    if (fLocal && pCompiler->offChunk != KMK_CC_EVAL_NO_CHUNK)
+        fNative = 0;
 
-        /*
-         * Skip leading spaces, if any and prep the value for copying.
-         */
-        KMK_CC_EVAL_SKIP_SPACES(pCompiler, pchWord, cchLeft);
-        cchValue    = kmk_cc_eval_prep_normal_line(pCompiler, pchWord, cchLeft);
-        fPlainValue = memchr(pchWord, '$', cchLeft) == NULL;
+    if (fNative)
+    {
+        PKMKCCEVALASSIGNDEF pInstr;
+        size_t              cchValue;
 
-        /*
-         * Emit the instruction.
-         */
-        kmk_cc_eval_end_of_recipe(pCompiler, pchWord);
-
-        pInstr = (PKMKCCEVALASSIGN)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-        pInstr->Core.enmOpcode = enmOpcode;
-        pInstr->Core.iLine     = pCompiler->iLine;
-        pInstr->fExport        = (fQualifiers & KMK_CC_EVAL_QUALIFIER_EXPORT)   != 0;
-        pInstr->fOverride      = (fQualifiers & KMK_CC_EVAL_QUALIFIER_OVERRIDE) != 0;
-        pInstr->fPrivate       = (fQualifiers & KMK_CC_EVAL_QUALIFIER_PRIVATE)  != 0;
-        pInstr->fLocal         = (fQualifiers & KMK_CC_EVAL_QUALIFIER_LOCAL)    != 0;
-
-        /* We copy the value before messing around with the variable name since
-           we have to do more iEolEsc saves & restores the other way around. */
-        pszValue = kmk_cc_eval_strdup_prepped(pCompiler, cchValue);
-        if (fPlainVarNm)
-            pchVarNm = strcache2_add(&variable_strcache, pchVarNm, cchVarNm);
-        else
-        {
-            pCompiler->iEscEol = iEscEolVarNm;
-            cchVarNm = kmk_cc_eval_prep_normal_line_ex(pCompiler, pchVarNm, cchVarNm);
-            pchVarNm = kmk_cc_eval_strdup_prepped(pCompiler, cchVarNm);
-        }
+        pInstr = (PKMKCCEVALASSIGNDEF)kmk_cc_eval_alloc_instr(pCompiler, sizeof(*pInstr),
+                                                              enmFlavor == f_conditional ? kKmkCcEvalInstr_define_if_new
+                                                              : kKmkCcEvalInstr_define_recursive);
+        pInstr->AssignCore.fExport   = (fQualifiers & KMK_CC_EVAL_QUALIFIER_EXPORT)   != 0;
+        pInstr->AssignCore.fOverride = (fQualifiers & KMK_CC_EVAL_QUALIFIER_OVERRIDE) != 0;
+        pInstr->AssignCore.fPrivate  = (fQualifiers & KMK_CC_EVAL_QUALIFIER_PRIVATE)  != 0;
+        pInstr->AssignCore.fLocal    = fLocal;
+        pInstr->pEvalProg            = NULL;
+
+        /* The name lives in the scratch buffer, so copy it before scanning the body. */
+        kmk_cc_eval_init_operand(pCompiler, &pInstr->AssignCore.Variable, pchVarNm, cchVarNm, 1 /*fExpand*/);
+        cchValue = kmk_cc_eval_scan_define_body(pCompiler, 1 /*fWantValue*/);
+        kmk_cc_eval_init_operand(pCompiler, &pInstr->AssignCore.Value, pCompiler->pszDefValue, cchValue, 0 /*fExpand*/);
         kmk_cc_block_realign(pCompiler->ppBlockTail);
-        KMK_CC_EVAL_DPRINTF(("%s: '%s' '%s'\n", g_apszEvalInstrNms[enmOpcode], pchVarNm, pszValue));
+        pInstr->AssignCore.pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
 
-        kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Variable, pchVarNm, cchVarNm, fPlainVarNm);
-        kmk_cc_eval_init_subprogram_or_plain(pCompiler, &pInstr->Value, pszValue, cchValue, fPlainValue);
-
-        pInstr->pNext = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(*pCompiler->ppBlockTail);
+        if (!fLocal && pCompiler->cIfs == 0)
+            pCompiler->fRuleMaybePending = 0;
     }
-    /*
-     * This could be one or more function calls.
-     */
-    else if (!fPlainVarNm && cchVarNm == cchSubprog && fQualifiers == 0)
-        return kmk_cc_eval_emit_expand(pCompiler, pchVarNm, cchVarNm, iEscEolVarNm);
-    else if (!fPlainVarNm)
-        kmk_cc_eval_fatal(pCompiler, pchWord,
-                          "Not variable assignment. Could be a complicated indirect recipe definition, however that's currently not supported.");
     else
-        kmk_cc_eval_fatal(pCompiler, pchWord, "Neither recipe nor variable assignment");
+    {
+        kmk_cc_eval_scan_define_body(pCompiler, 0 /*fWantValue*/);
+        kmk_cc_eval_add_chunk_line(pCompiler, !fLocal /*fEndsRule*/);
+    }
     return 1;
 }
 
 
+#ifdef CONFIG_WITH_LOCAL_VARIABLES
 /**
- * Parses a 'local [override] variable = value', 'local define variable', and
- * 'local undefine variable [...]' expressions.
- *
- * The 'local' directive must be first and it does not permit any qualifiers at
- * the moment.  Should any be added later, they will have to come after 'local'.
+ * Deals with a 'local' statement.
  *
  * @returns 1 to indicate we've handled a keyword (see
  *          kmk_cc_eval_try_handle_keyword).
  * @param   pCompiler   The compiler state.
  * @param   pchWord     First char after 'local'.
  * @param   cchLeft     The number of chars left to parse on this line.
- * @param   fQualifiers The qualifiers.
  */
 static int kmk_cc_eval_do_var_local(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-    if (cchLeft)
+    struct variable VarDef;
+
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
+    if (!cchLeft)
+        kmk_cc_eval_fatal(pCompiler, NULL, "Empty 'local' directive");
+
+    if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "define", 6))
     {
-        /*
-         * Check for 'local define' and 'local undefine'
-         */
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "define", 6))   /* final */
-            return kmk_cc_eval_do_var_define(pCompiler, pchWord + 6, cchLeft + 6, KMK_CC_EVAL_QUALIFIER_LOCAL);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "undefine", 8))   /* final */
-            return kmk_cc_eval_do_var_undefine(pCompiler, pchWord + 8, cchLeft + 8, KMK_CC_EVAL_QUALIFIER_LOCAL);
+        /* When ignoring, eval skips 'local define' but not its body, so only at the top. */
+        if (pCompiler->cIfs > 0)
+            kmk_cc_eval_fatal(pCompiler, pchWord, "'local define' inside a conditional");
+        return kmk_cc_eval_do_var_define(pCompiler, pchWord + 6, cchLeft - 6, KMK_CC_EVAL_QUALIFIER_LOCAL);
+    }
 
-        /*
-         * Simpler to just join paths with the rest here, even if we could
-         * probably optimize the parsing a little if we liked.
-         */
+    /* Local assignments don't record waiting rules, so they must join any pending chunk. */
+    if (   pCompiler->offChunk == KMK_CC_EVAL_NO_CHUNK
+        && parse_variable_definition(pchWord, &VarDef)
+        && VarDef.flavor != f_shell)
         return kmk_cc_eval_handle_assignment_or_recipe(pCompiler, pchWord, cchLeft, KMK_CC_EVAL_QUALIFIER_LOCAL);
-    }
-    kmk_cc_eval_fatal(pCompiler, pchWord, "Expected variable name, assignment operator and value after 'local'");
+
+    kmk_cc_eval_add_chunk_line(pCompiler, 0 /*fEndsRule*/);
     return 1;
 }
+#endif /* CONFIG_WITH_LOCAL_VARIABLES */
 
 
 /**
- * We've found one variable qualification keyword, now continue parsing and see
- * if this is some kind of variable assignment expression or not.
+ * Deals with assignments and 'define'/'undefine' preceded by 'export',
+ * 'override' and 'private' qualifiers, like parse_var_assignment() does.
  *
- * @returns 1 if variable assignment, 0 if not.
+ * @returns 1 if handled, 0 if not a qualified assignment.
  * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after the first qualifier.
+ * @param   pchWord     The start of the first qualifier, or the first char
+ *                      after it.
  * @param   cchLeft     The number of chars left to parse on this line.
- * @param   fQualifiers The qualifier.
+ * @param   fQualifiers The qualifiers already found.
  */
 static int kmk_cc_eval_try_handle_var_with_keywords(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft,
                                                     unsigned fQualifiers)
 {
     for (;;)
     {
-        KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
-        if (cchLeft)
-        {
-            char ch = *pchWord;
-            if (KMK_CC_EVAL_IS_1ST_IN_VARIABLE_KEYWORD(ch))
-            {
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "define", 6))   /* final */
-                    return kmk_cc_eval_do_var_define(pCompiler, pchWord + 6, cchLeft - 6, fQualifiers);
+        struct variable VarDef;
 
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "undefine", 8)) /* final */
-                    return kmk_cc_eval_do_var_undefine(pCompiler, pchWord + 8, cchLeft -86, fQualifiers);
-
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "unexport", 8)) /* final */
-                    return kmk_cc_eval_do_var_unexport(pCompiler, pchWord + 8, cchLeft - 8, fQualifiers);
-
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "export", 6))
-                {
-                    if (!(fQualifiers & KMK_CC_EVAL_QUALIFIER_EXPORT))
-                        fQualifiers |= KMK_CC_EVAL_QUALIFIER_EXPORT;
-                    else
-                        kmk_cc_eval_warn(pCompiler, pchWord, "'export' qualifier repeated");
-                    pchWord += 6;
-                    cchLeft -= 6;
-                    continue;
-                }
+        KMK_CC_EVAL_SKIP_SPACES(pchWord, cchLeft);
+        if (!cchLeft)
+            return 0;
 
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "override", 8))
-                {
-                    if (!(fQualifiers & KMK_CC_EVAL_QUALIFIER_OVERRIDE))
-                        fQualifiers |= KMK_CC_EVAL_QUALIFIER_OVERRIDE;
-                    else
-                        kmk_cc_eval_warn(pCompiler, pchWord, "'override' qualifier repeated");
-                    pchWord += 8;
-                    cchLeft -= 8;
-                    continue;
-                }
+        if (   memchr(pchWord, '=', cchLeft)
+            && parse_variable_definition(pchWord, &VarDef))
+            return kmk_cc_eval_handle_assignment_or_recipe(pCompiler, pchWord, cchLeft, fQualifiers);
 
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "private", 7))
-                {
-                    if (!(fQualifiers & KMK_CC_EVAL_QUALIFIER_PRIVATE))
-                        fQualifiers |= KMK_CC_EVAL_QUALIFIER_PRIVATE;
-                    else
-                        kmk_cc_eval_warn(pCompiler, pchWord, "'private' qualifier repeated");
-                    pchWord += 7;
-                    cchLeft -= 7;
-                    continue;
-                }
-            }
+        if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "define", 6))
+            return kmk_cc_eval_do_var_define(pCompiler, pchWord + 6, cchLeft - 6, fQualifiers);
+        if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "undefine", 8))
+            return kmk_cc_eval_do_var_undefine(pCompiler, pchWord + 8, cchLeft - 8, fQualifiers);
 
-            /*
-             * Not a keyword, likely variable name followed by an assignment
-             * operator and a value.  Do a rough check for the assignment operator
-             * and join paths with the unqualified assignment handling code.
-             */
-            {
-                const char *pchEqual = (const char *)memchr(pchWord, '=', cchLeft);
-                if (pchEqual)
-                    return kmk_cc_eval_handle_assignment_or_recipe(pCompiler, pchWord, cchLeft, fQualifiers);
-            }
-            return 0;
+        if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "export", 6))
+        {
+            fQualifiers |= KMK_CC_EVAL_QUALIFIER_EXPORT;
+            pchWord += 6;
+            cchLeft -= 6;
+        }
+        else if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "override", 8))
+        {
+            fQualifiers |= KMK_CC_EVAL_QUALIFIER_OVERRIDE;
+            pchWord += 8;
+            cchLeft -= 8;
+        }
+        else if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "private", 7))
+        {
+            fQualifiers |= KMK_CC_EVAL_QUALIFIER_PRIVATE;
+            pchWord += 7;
+            cchLeft -= 7;
         }
         else
-            kmk_cc_eval_fatal(pCompiler, NULL,
-                              "Expected assignment operator or variable directive after variable qualifier(s)\n");
+            return 0;
     }
 }
 
 
 /**
- * Parses 'export [variable]' and 'export [qualifiers] variable = value'
- * expressions.
- *
- * When we find the 'export' directive at the start of a line, we need to
- * continue parsing with till we can tell the difference between the two forms.
+ * Deals with 'export' statements, both the qualifier and the list variants.
  *
  * @returns 1 to indicate we've handled a keyword (see
  *          kmk_cc_eval_try_handle_keyword).
  * @param   pCompiler   The compiler state.
- * @param   pchWord     First char after 'define'.
+ * @param   pchWord     First char after 'export'.
  * @param   cchLeft     The number of chars left to parse on this line.
  */
 static int kmk_cc_eval_handle_var_export(PKMKCCEVALCOMPILER pCompiler, const char *pchWord, size_t cchLeft)
 {
-    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pCompiler, pchWord, cchLeft);
+    if (kmk_cc_eval_try_handle_var_with_keywords(pCompiler, pchWord, cchLeft, KMK_CC_EVAL_QUALIFIER_EXPORT))
+        return 1;
 
+    KMK_CC_EVAL_SKIP_SPACES_AFTER_WORD(pchWord, cchLeft);
     if (cchLeft)
-    {
-        unsigned iSavedEscEol;
-        unsigned cWords;
-
-        /*
-         * We need to figure out whether this is an assignment or a export statement,
-         * in the latter case join paths with 'export' and 'undefine'.
-         */
-        const char *pchEqual = (const char *)memchr(pchWord, '=', cchLeft);
-        if (!pchEqual)
-            return kmk_cc_eval_do_with_variable_list(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_export, 0 /*fQualifiers*/);
-
-        /*
-         * Found an '=', could be an assignment.  Let's take the easy way out
-         * and just parse the whole statement into words like we would do if
-         * it wasn't an assignment, and then check the words out for
-         * assignment keywords and operators.
-         */
-        iSavedEscEol = pCompiler->iEscEol;
-        cWords       = kmk_cc_eval_parse_words(pCompiler, pchWord, cchLeft);
-        if (cWords)
-        {
-            PKMKCCEVALVARIABLES pInstr;
-            PKMKCCEVALWORD pWord = pCompiler->paWords;
-            unsigned       iWord = 0;
-            while (iWord < cWords)
-            {
-                /* Trailing assignment operator or terminal assignment directive ('undefine'
-                   and 'unexport' makes no sense here but GNU make ignores that). */
-                if (   (   pWord->cchWord > 1
-                        && pWord->pchWord[pWord->cchWord - 1] == '=')
-                    || KMK_CC_STRCMP_CONST(pWord->pchWord, pWord->cchWord, "define", 6)
-                    || KMK_CC_STRCMP_CONST(pWord->pchWord, pWord->cchWord, "undefine", 8)
-                    || KMK_CC_STRCMP_CONST(pWord->pchWord, pWord->cchWord, "unexport", 8) )
-                {
-                    pCompiler->iEscEol = iSavedEscEol;
-                    return kmk_cc_eval_try_handle_var_with_keywords(pCompiler, pchWord, cchLeft, KMK_CC_EVAL_QUALIFIER_EXPORT);
-                }
-
-                /* If not a variable assignment qualifier, it must be a variable name
-                   followed by an assignment operator. */
-                if (iWord + 1 < cWords)
-                {
-                    if (   !KMK_CC_STRCMP_CONST(pWord->pchWord, pWord->cchWord, "export", 6)
-                        && !KMK_CC_STRCMP_CONST(pWord->pchWord, pWord->cchWord, "private", 7)
-                        && !KMK_CC_STRCMP_CONST(pWord->pchWord, pWord->cchWord, "override", 8))
-                    {
-                        pWord++;
-                        if (   pWord->cchWord > 0
-                            && (   pWord->pchWord[0] == '='
-                                || (   pWord->cchWord > 1
-                                    && pWord->pchWord[1] == '='
-                                    && (   pWord->pchWord[0] == ':'
-                                        || pWord->pchWord[0] == '+'
-                                        || pWord->pchWord[0] == '?'
-                                        || pWord->pchWord[0] == '<') ) ) )
-                        {
-                            pCompiler->iEscEol = iSavedEscEol;
-                            return kmk_cc_eval_try_handle_var_with_keywords(pCompiler, pchWord, cchLeft,
-                                                                            KMK_CC_EVAL_QUALIFIER_EXPORT);
-                        }
-                        break;
-                    }
-                }
-                else
-                    break;
-                /* next */
-                pWord++;
-                iWord++;
-            }
+        return kmk_cc_eval_do_with_variable_list(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_export, 0);
 
-            /*
-             * It's not an assignment.
-             * (This is the same as kmk_cc_eval_do_with_variable_list does.)
-             */
-            pInstr = (PKMKCCEVALVARIABLES)kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, KMKCCEVALVARIABLES_SIZE(cWords));
-            pInstr->Core.enmOpcode = kKmkCcEvalInstr_export;
-            pInstr->Core.iLine     = pCompiler->iLine;
-            pInstr->cVars          = cWords;
-            kmk_cc_eval_init_spp_array_from_duplicated_words(pCompiler, cWords, pCompiler->paWords, pInstr->aVars);
-            kmk_cc_block_realign(pCompiler->ppBlockTail);
-        }
-        else
-            KMK_CC_ASSERT(0);
-    }
-    else
-    {
-        /*
-         * We're exporting all variables.
-         */
-        PKMKCCEVALCORE pInstr = kmk_cc_block_alloc_eval(pCompiler->ppBlockTail, sizeof(*pInstr));
-        pInstr->enmOpcode = kKmkCcEvalInstr_export_all;
-        pInstr->iLine     = pCompiler->iLine;
-    }
+    /* We're exporting all variables. */
+    kmk_cc_eval_alloc_instr(pCompiler, sizeof(KMKCCEVALCORE), kKmkCcEvalInstr_export_all);
+    if (pCompiler->cIfs == 0)
+        pCompiler->fRuleMaybePending = 0;
     return 1;
 }
 
 
 /**
- * When entering this function we know that the first two character in the first
- * word both independently occurs in keywords.
+ * Tries to handle the line as a directive.
  *
- * @returns 1 if make directive or qualified variable assignment, 0 if neither.
+ * @returns 1 if handled, 0 if not a directive.
  * @param   pCompiler   The compiler state.
- * @param   ch          The first char.
- * @param   pchWord     Pointer to the first word.
- * @param   cchLeft     Number of characters left to parse starting at
- *                      @a cchLeft.
+ * @param   ch          The first char of the line.
+ * @param   pchWord     The start of the line (after leading spaces).
+ * @param   cchLeft     The number of chars left on the line.
  */
-int kmk_cc_eval_try_handle_keyword(PKMKCCEVALCOMPILER pCompiler, char ch, const char *pchWord, size_t cchLeft)
+static int kmk_cc_eval_try_handle_keyword(PKMKCCEVALCOMPILER pCompiler, char ch, const char *pchWord, size_t cchLeft)
 {
-    unsigned iSavedEscEol = pCompiler->iEscEol;
-
-    KMK_CC_ASSERT(cchLeft >= 2);
-    KMK_CC_ASSERT(ch == pchWord[0]);
-    KMK_CC_ASSERT(KMK_CC_EVAL_IS_1ST_IN_KEYWORD(pchWord[0]));
-    KMK_CC_ASSERT(KMK_CC_EVAL_IS_2ND_IN_KEYWORD(pchWord[1]));
+    struct variable VarDef;
 
-    /*
-     * If it's potentially a variable related keyword, check that out first.
-     */
-    if (KMK_CC_EVAL_IS_1ST_IN_VARIABLE_KEYWORD(ch))
-    {
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "local", 5))
-            return kmk_cc_eval_do_var_local(pCompiler, pchWord + 5, cchLeft - 5);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "define", 6))
-            return kmk_cc_eval_do_var_define(pCompiler, pchWord + 6, cchLeft - 6, 0);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "export", 6))
-            return kmk_cc_eval_handle_var_export(pCompiler, pchWord + 6, cchLeft - 6);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "undefine", 8))
-            return kmk_cc_eval_do_var_undefine(pCompiler, pchWord + 8, cchLeft - 8, 0);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "unexport", 8))
-            return kmk_cc_eval_do_var_unexport(pCompiler, pchWord + 8, cchLeft - 8, 0);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "override", 8))
-        {
-            if (kmk_cc_eval_try_handle_var_with_keywords(pCompiler, pchWord + 8, cchLeft - 8, KMK_CC_EVAL_QUALIFIER_OVERRIDE))
-                return 1;
-            pCompiler->iEscEol = iSavedEscEol;
-        }
-        else if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "private", 7))
-        {
-            if (kmk_cc_eval_try_handle_var_with_keywords(pCompiler, pchWord + 7, cchLeft - 7, KMK_CC_EVAL_QUALIFIER_PRIVATE))
-                return 1;
-            pCompiler->iEscEol = iSavedEscEol;
-        }
-    }
+    /* Variables may be named like directives, see parse_var_assignment(). */
+    if (   memchr(pchWord, '=', cchLeft)
+        && parse_variable_definition(pchWord, &VarDef))
+        return 0;
 
-    /*
-     * Check out the other keywords.
-     */
-    if (ch == 'i') /* Lots of directives starting with 'i'. */
+    switch (ch)
     {
-        char ch2 = pchWord[1];
-        pchWord += 2;
-        cchLeft -= 2;
-
-        /* 'if...' */
-        if (ch2 == 'f')
-        {
-            if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pCompiler, pchWord, cchLeft))
-                return kmk_cc_eval_do_if(pCompiler, pchWord, cchLeft, 0 /* in else */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "eq", 2))
-                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 2, cchLeft - 2, 0 /* in else */, 1 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "def", 3))
-                return kmk_cc_eval_do_ifdef(pCompiler, pchWord + 3, cchLeft - 3, 0 /* in else */, 1 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "neq", 3))
-                return kmk_cc_eval_do_ifeq( pCompiler, pchWord + 3, cchLeft - 3, 0 /* in else */, 0 /* positive */);
-
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "1of", 3))
-                return kmk_cc_eval_do_if1of(pCompiler, pchWord + 3, cchLeft - 3, 0 /* in else */, 1 /* positive */);
+        case 'd':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "define", 6))
+                return kmk_cc_eval_do_var_define(pCompiler, pchWord + 6, cchLeft - 6, 0);
+            break;
 
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "ndef", 4))
-                return kmk_cc_eval_do_ifdef(pCompiler, pchWord + 4, cchLeft - 4, 0 /* in else */, 0 /* positive */);
+        case 'e':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "export", 6))
+                return kmk_cc_eval_handle_var_export(pCompiler, pchWord + 6, cchLeft - 6);
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "else", 4))
+                return kmk_cc_eval_do_else(pCompiler, pchWord + 4, cchLeft - 4);
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "endif", 5))
+                return kmk_cc_eval_do_endif(pCompiler, pchWord + 5, cchLeft - 5);
+            break;
 
-            if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "n1of", 4))
-                return kmk_cc_eval_do_if1of(pCompiler, pchWord + 4, cchLeft - 4, 0 /* in else */, 0 /* positive */);
-        }
-        /* include... */
-        else if (ch2 == 'n' && cchLeft >= 5 && KMK_CC_WORD_COMP_CONST_5(pchWord, "clude") ) /* 'in...' */
-        {
-            pchWord += 5;
-            cchLeft -= 5;
-            if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pCompiler, pchWord, cchLeft))
-                return kmk_cc_eval_do_include(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_include);
-            if (cchLeft >= 3 && KMK_CC_WORD_COMP_CONST_3(pchWord, "dep"))
+        case 'i':
+            if (pchWord[1] == 'f')
             {
-                pchWord += 3;
-                cchLeft -= 3;
-                if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pCompiler, pchWord, cchLeft))
-                    return kmk_cc_eval_do_include(pCompiler, pchWord, cchLeft, kKmkCcEvalInstr_includedep);
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "-queue", 6))
-                    return kmk_cc_eval_do_include(pCompiler, pchWord + 6, cchLeft - 6, kKmkCcEvalInstr_includedep_queue);
-                if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "-flush", 6))
-                    return kmk_cc_eval_do_include(pCompiler, pchWord + 6, cchLeft - 6, kKmkCcEvalInstr_includedep_flush);
+                const char *pchAfter = pchWord + 2;
+                size_t      cchAfter = cchLeft - 2;
+#ifdef CONFIG_WITH_IF_CONDITIONALS
+                if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pchAfter, cchAfter))
+                    return kmk_cc_eval_do_if(pCompiler, pchAfter, cchAfter, 0 /* in else */);
+#endif
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchAfter, cchAfter, "eq", 2))
+                    return kmk_cc_eval_do_ifeq( pCompiler, pchAfter + 2, cchAfter - 2, 0 /* in else */, kKmkCcEvalInstr_ifeq);
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchAfter, cchAfter, "def", 3))
+                    return kmk_cc_eval_do_ifdef(pCompiler, pchAfter + 3, cchAfter - 3, 0 /* in else */, 1 /* positive */);
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchAfter, cchAfter, "neq", 3))
+                    return kmk_cc_eval_do_ifeq( pCompiler, pchAfter + 3, cchAfter - 3, 0 /* in else */, kKmkCcEvalInstr_ifneq);
+#ifdef CONFIG_WITH_SET_CONDITIONALS
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchAfter, cchAfter, "1of", 3))
+                    return kmk_cc_eval_do_ifeq( pCompiler, pchAfter + 3, cchAfter - 3, 0 /* in else */, kKmkCcEvalInstr_if1of);
+#endif
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchAfter, cchAfter, "ndef", 4))
+                    return kmk_cc_eval_do_ifdef(pCompiler, pchAfter + 4, cchAfter - 4, 0 /* in else */, 0 /* positive */);
+#ifdef CONFIG_WITH_SET_CONDITIONALS
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchAfter, cchAfter, "n1of", 4))
+                    return kmk_cc_eval_do_ifeq( pCompiler, pchAfter + 4, cchAfter - 4, 0 /* in else */, kKmkCcEvalInstr_ifn1of);
+#endif
             }
-        }
-    }
-    else if (ch == 'e') /* A few directives starts with 'e'. */
-    {
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "else", 4))
-            return kmk_cc_eval_do_else(pCompiler, pchWord + 4, cchLeft - 4);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "endif", 5))
-            return kmk_cc_eval_do_endif(pCompiler, pchWord + 5, cchLeft - 5);
-        /* export and endef are handled elsewhere, though stray endef's may end up here... */
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "export", 6));
-
-    }
-    else /* the rest. */
-    {
-        if (   KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "sinclude", 8)
-            || KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "-include", 8))
-            return kmk_cc_eval_do_include(pCompiler, pchWord + 8, cchLeft - 8, kKmkCcEvalInstr_include_silent);
-        if (KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "vpath", 5))
-            return kmk_cc_eval_do_vpath(pCompiler, pchWord + 5, cchLeft - 5);
-
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "local", 5));
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "define", 6));
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "private", 7));
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "override", 8));
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "unexport", 8));
-        KMK_CC_ASSERT(!KMK_CC_EVAL_WORD_COMP_CONST(pCompiler, pchWord, cchLeft, "undefine", 8));
-    }
-
-    pCompiler->iEscEol = iSavedEscEol;
-    return 0;
-}
-
-
-
-
-static int kmk_cc_eval_compile_worker(PKMKCCEVALPROG pEvalProg, const char *pszContent, size_t cchContent, unsigned iLine)
-{
-    const char *pchTmp;
-
-    /*
-     * Compiler state.
-     */
-    KMKCCEVALCOMPILER   Compiler;
-    kmk_cc_eval_init_compiler(&Compiler, pEvalProg, iLine, pszContent, cchContent);
-    KMK_CC_EVAL_DPRINTF(("\nkmk_cc_eval_compile_worker - begin (%s/%s/%d)\n", pEvalProg->pszFilename, pEvalProg->pszVarName, iLine));
-
-    {
-        /*
-         * Line state.
-         */
-        size_t              cchLine;                                /* The length of the current line (w/o comments). */
-        size_t              offNext = 0;                            /* The offset of the next line. */
-        size_t              off     = 0;                            /* The offset into pszContent of the current line. */
-
-        /* Try for some register/whatever optimzations. */
-        int const           chFirstEol = Compiler.chFirstEol;
-        size_t const        cchEolSeq  = Compiler.cchEolSeq;
-
-        /*
-         * Process input lines.
-         *
-         * The code here concerns itself with getting the next line in an efficient
-         * manner, very basic classification and trying out corresponding handlers.
-         * The real work is done in the handlers.
-         */
-        while (offNext < cchContent)
-        {
-            size_t offFirstWord;
-
-            /*
-             * Find the end of the next line.
-             */
-            KMK_CC_ASSERT(off == offNext);
-
-            /* Simple case: No escaped EOL, nor the end of the input. */
-            pchTmp = (const char *)memchr(&pszContent[offNext], chFirstEol, cchContent - offNext);
-            if (   pchTmp
-                && (   &pszContent[offNext] == pchTmp
-                    || pchTmp[-1] != '\\') )
+            else if (cchLeft >= 7 && KMK_CC_WORD_COMP_CONST_7(pchWord, "include"))
             {
-                if (   cchEolSeq == 1
-                    || pchTmp[1] == Compiler.chSecondEol)
-                {
-                    /* Frequent: Blank line. */
-                    if (&pszContent[offNext] == pchTmp)
-                    {
-                        KMK_CC_EVAL_DPRINTF(("#%03u: <empty>\n", Compiler.iLine));
-                        Compiler.iLine++;
-                        off = offNext += cchEolSeq;
-                        continue;
-                    }
-                    if (pszContent[offNext] == '#')
-                    {
-                        KMK_CC_EVAL_DPRINTF(("#%03u: <comment-col-0>\n", Compiler.iLine));
-                        Compiler.iLine++;
-                        offNext = pchTmp - pszContent;
-                        off = offNext += cchEolSeq;
-                        continue;
-                    }
+                if (KMK_CC_EVAL_WORD_COMP_IS_EOL(pchWord + 7, cchLeft - 7))
+                    return kmk_cc_eval_do_include(pCompiler, pchWord + 7, cchLeft - 7, kKmkCcEvalInstr_include);
+#ifdef CONFIG_WITH_INCLUDEDEP
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "includedep", 10))
+                    return kmk_cc_eval_do_include(pCompiler, pchWord + 10, cchLeft - 10, kKmkCcEvalInstr_includedep);
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "includedep-queue", 16))
+                    return kmk_cc_eval_do_include(pCompiler, pchWord + 16, cchLeft - 16, kKmkCcEvalInstr_includedep_queue);
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "includedep-flush", 16))
+                    return kmk_cc_eval_do_include(pCompiler, pchWord + 16, cchLeft - 16, kKmkCcEvalInstr_includedep_flush);
+                if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "include-prefetch", 16))
+                    return kmk_cc_eval_do_include(pCompiler, pchWord + 16, cchLeft - 16, kKmkCcEvalInstr_include_prefetch);
+#endif
+            }
+            break;
+
+#ifdef CONFIG_WITH_LOCAL_VARIABLES
+        case 'l':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "local", 5))
+                return kmk_cc_eval_do_var_local(pCompiler, pchWord + 5, cchLeft - 5);
+            break;
+#endif
 
-                    offNext  = pchTmp - pszContent;
-                    cchLine  = offNext - off;
+        case 'o':
+        case 'p':
+            return kmk_cc_eval_try_handle_var_with_keywords(pCompiler, pchWord, cchLeft, 0);
 
-                    offFirstWord = off;
-                    while (offFirstWord < offNext && KMK_CC_EVAL_IS_SPACE(pszContent[offFirstWord]))
-                        offFirstWord++;
+        case 'u':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "undefine", 8))
+                return kmk_cc_eval_do_var_undefine(pCompiler, pchWord + 8, cchLeft - 8, 0);
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "unexport", 8))
+                return kmk_cc_eval_do_var_unexport(pCompiler, pchWord + 8, cchLeft - 8);
+            break;
 
-                    offNext += cchEolSeq;
-                    Compiler.cEscEols = 0;
-                    Compiler.iEscEol  = 0;
-                }
-                else
-                    kmk_cc_eval_fatal_eol(&Compiler, pchTmp, Compiler.iLine, off);
-            }
-            /* The complicated, less common cases. */
-            else
-            {
-                Compiler.cEscEols = 0;
-                Compiler.iEscEol  = 0;
-                offFirstWord = offNext;
-                for (;;)
-                {
-                    if (pchTmp)
-                    {
-                        if (   cchEolSeq == 1
-                            || pchTmp[1] == Compiler.chSecondEol)
-                        {
-                            size_t offEsc;
-                            if (offFirstWord != offNext)
-                                offNext = pchTmp - pszContent;
-                            else
-                            {
-                                offNext = pchTmp - pszContent;
-                                while (offFirstWord < offNext && KMK_CC_EVAL_IS_SPACE(pszContent[offFirstWord]))
-                                    offFirstWord++;
-                            }
+        case 's':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "sinclude", 8))
+                return kmk_cc_eval_do_include(pCompiler, pchWord + 8, cchLeft - 8, kKmkCcEvalInstr_include_silent);
+            break;
 
+        case '-':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "-include", 8))
+                return kmk_cc_eval_do_include(pCompiler, pchWord + 8, cchLeft - 8, kKmkCcEvalInstr_include_silent);
+            break;
 
-                            /* Is it an escape sequence? */
-                            if (   !offNext
-                                || pchTmp[-1] != '\\')
-                            {
-                                cchLine  = offNext - off;
-                                offNext += cchEolSeq;
-                                break;
-                            }
-                            if (offNext < 2 || pchTmp[-2] != '\\')
-                                offEsc = offNext - 1;
-                            else
-                            {
-                                /* Count how many backslashes there are. Must be odd number to be an escape
-                                   sequence.  Normally we keep half of them, except for command lines.  */
-                                size_t cSlashes = 2;
-                                while (offNext >= cSlashes && pchTmp[0 - cSlashes] == '\\')
-                                    cSlashes--;
-                                if (!(cSlashes & 1))
-                                {
-                                    cchLine  = offNext - off;
-                                    offNext += cchEolSeq;
-                                    break;
-                                }
-                                offEsc = offNext - (cSlashes >> 1);
-                            }
+        case 'v':
+            if (KMK_CC_EVAL_WORD_COMP_CONST(pchWord, cchLeft, "vpath", 5))
+                return kmk_cc_eval_do_vpath(pCompiler);
+            break;
+    }
+    return 0;
+}
 
-                            /* Record it. */
-                            if (Compiler.cEscEols < Compiler.cEscEolsAllocated) { /* likely */ }
-                            else
-                            {
-                                KMK_CC_ASSERT(Compiler.cEscEols == Compiler.cEscEolsAllocated);
-                                Compiler.cEscEolsAllocated = Compiler.cEscEolsAllocated
-                                                           ? Compiler.cEscEolsAllocated * 2 : 2;
-                                Compiler.paEscEols = (PKMKCCEVALESCEOL)xrealloc(Compiler.paEscEols,
-                                                                                  Compiler.cEscEolsAllocated
-                                                                                * sizeof(Compiler.paEscEols[0]));
-                            }
-                            Compiler.paEscEols[Compiler.cEscEols].offEsc = offEsc;
-                            Compiler.paEscEols[Compiler.cEscEols].offEol = offNext;
-                            Compiler.cEscEols++;
 
-                            /* Advance. */
-                            offNext += cchEolSeq;
-                            if (offFirstWord == offEsc)
-                            {
-                                offFirstWord = offNext;
-                                Compiler.iEscEol++;
-                            }
-                        }
-                        else
-                            kmk_cc_eval_fatal_eol(&Compiler, pchTmp, Compiler.iLine, off);
-                    }
-                    else
-                    {
-                        /* End of input. Happens only once per compilation, nothing to optimize for. */
-                        if (offFirstWord == offNext)
-                            while (offFirstWord < cchContent && KMK_CC_EVAL_IS_SPACE(pszContent[offFirstWord]))
-                                offFirstWord++;
-                        offNext = cchContent;
-                        cchLine = cchContent - off;
-                        break;
-                    }
-                    pchTmp = (const char *)memchr(&pszContent[offNext], chFirstEol, cchContent - offNext);
-                }
-            }
-            KMK_CC_ASSERT(offNext       <= cchContent);
-            KMK_CC_ASSERT(offNext       >= off + cchLine);
-            KMK_CC_ASSERT(off + cchLine <= cchContent && cchLine <= cchContent);
-            KMK_CC_ASSERT(offFirstWord  <= off + cchLine);
-            KMK_CC_ASSERT(offFirstWord  >= off);
-            KMK_CC_ASSERT(pszContent[offFirstWord] != ' ' && pszContent[offFirstWord] != '\t');
+/**
+ * Compiles the current line, doing what eval() does with it.
+ *
+ * @param   pCompiler   The compiler state.
+ */
+static void kmk_cc_eval_compile_line(PKMKCCEVALCOMPILER pCompiler)
+{
+    size_t const    cchLine = pCompiler->offEol - pCompiler->offLine;
+    char           *pszLine;
+    const char     *pchWord;
+    size_t          cchLeft;
 
-            KMK_CC_EVAL_DPRINTF(("#%03u: %*.*s\n", Compiler.iLine, (int)cchLine, (int)cchLine, &pszContent[off]));
+    /* Skip empty lines. */
+    if (cchLine == 0)
+        return;
 
-            /*
-             * Skip blank lines.
-             */
-            if (offFirstWord < off + cchLine)
-            {
-                /*
-                 * Command? Ignore command prefix if no open recipe (SunOS 4 behavior).
-                 */
-                if (   pszContent[off] == Compiler.chCmdPrefix
-                    && (Compiler.pRecipe || Compiler.fNoTargetRecipe))
-                {
-                    if (!Compiler.fNoTargetRecipe)
-                        kmk_cc_eval_handle_command(&Compiler, &pszContent[off], cchLine);
-                }
-                /*
-                 * Since it's not a command line, we can now skip comment lines
-                 * even with a tab indentation.  If it's not a comment line, we
-                 * tentatively strip any trailing comment.
-                 */
-                else if (pszContent[offFirstWord] != '#')
-                {
-                    const char *pchWord = &pszContent[offFirstWord];
-                    size_t      cchLeft = off + cchLine - offFirstWord;
-                    char        ch;
+    /* Recipe lines must go along with their rule.  If there is no rule
+       pending, the interpreter doesn't treat the line as a recipe. */
+    if (pCompiler->pszContent[pCompiler->offLine] == pCompiler->chCmdPrefix)
+    {
+        if (pCompiler->offChunk != KMK_CC_EVAL_NO_CHUNK)
+        {
+            kmk_cc_eval_add_chunk_line(pCompiler, 1 /*fEndsRule*/);
+            return;
+        }
+        if (pCompiler->fRuleMaybePending)
+            kmk_cc_eval_fatal(pCompiler, NULL, "Recipe line without a chunk");
+    }
 
-                    Compiler.cchLineWithComments = cchLine;
-                    pchTmp = (const char *)memchr(pchWord, '#', cchLeft);
-                    if (pchTmp)
-                    {
-                        cchLeft = pchTmp - pchWord;
-                        cchLine = pchTmp - &pszContent[off];
-                    }
-                    Compiler.cchLine = cchLine; /** @todo only used by assertions. */
-                    Compiler.offLine = off;     /** @todo only used by fatal errors. */
+    /* Collapse continuations, remove comments and skip leading spaces. */
+    pszLine = kmk_cc_eval_get_scratch(pCompiler, cchLine + 1);
+    memcpy(pszLine, &pCompiler->pszContent[pCompiler->offLine], cchLine);
+    pszLine[cchLine] = '\0';
+    cchLeft = eval_prep_line_for_compiler(pszLine, (unsigned int)cchLine) - pszLine;
+    pchWord = pszLine;
+    KMK_CC_EVAL_SKIP_SPACES(pchWord, cchLeft);
+    if (!cchLeft)
+        return;
 
-#ifdef KMK_CC_STRICT
-                    Compiler.cWords = 0x424242;
-#endif
+    /*
+     * Directives, assignments, single function calls and finally rules.
+     */
+    if (   cchLeft >= 2
+        && KMK_CC_EVAL_IS_1ST_IN_KEYWORD(pchWord[0])
+        && KMK_CC_EVAL_IS_2ND_IN_KEYWORD(pchWord[1])
+        && kmk_cc_eval_try_handle_keyword(pCompiler, pchWord[0], pchWord, cchLeft))
+        return;
 
-                    /*
-                     * If not a directive or variable qualifier, it's either a variable
-                     * assignment or a recipe.
-                     */
-                    ch = *pchWord;
-                    if (   !KMK_CC_EVAL_IS_1ST_IN_KEYWORD(ch)
-                        || !KMK_CC_EVAL_IS_2ND_IN_KEYWORD(pchWord[1]))
-                    {
-                        if (memchr(pchWord, '=', cchLeft))
-                            kmk_cc_eval_handle_assignment_or_recipe(&Compiler, pchWord, cchLeft, 0 /*fQualifiers*/);
-                        else
-                            kmk_cc_eval_handle_recipe(&Compiler, pchWord, cchLeft);
-                    }
-                    else
-                    {
-                        /* Possible directive or variable qualifier. */
-                        Compiler.offNext = offNext;
-                        if (kmk_cc_eval_try_handle_keyword(&Compiler, ch, pchWord, cchLeft))
-                            offNext = Compiler.offNext;
-                        /* No, that wasn't it... */
-                        else if (memchr(pchWord, '=', cchLeft))
-                            kmk_cc_eval_handle_assignment_or_recipe(&Compiler, pchWord, cchLeft, 0 /*fQualifiers*/);
-                        else
-                            kmk_cc_eval_handle_recipe(&Compiler, pchTmp, pchWord, cchLeft);
-                    }
-                }
-            }
+    if (memchr(pchWord, '=', cchLeft))
+        kmk_cc_eval_handle_assignment_or_recipe(pCompiler, pchWord, cchLeft, 0 /*fQualifiers*/);
+    else if (   *pchWord != '$'
+             || !kmk_cc_eval_emit_expand(pCompiler, pchWord, cchLeft))
+        kmk_cc_eval_handle_recipe(pCompiler, pchWord, cchLeft);
+}
 
-            /*
-             * Advance to the next line.
-             */
-            off             = offNext;
-            Compiler.iLine += Compiler.cEscEols + 1;
+
+/**
+ * Compiles all the lines, giving up via kmk_cc_eval_fatal if necessary.
+ *
+ * @returns 0 on success, -1 if the content should be left to the interpreter.
+ * @param   pCompiler   The compiler state.
+ */
+static int kmk_cc_eval_compile_lines(PKMKCCEVALCOMPILER pCompiler)
+{
+    if (setjmp(pCompiler->JmpBuf) == 0)
+    {
+        while (pCompiler->offLine < pCompiler->cchContent)
+        {
+            pCompiler->offNext = kmk_cc_eval_find_eol(pCompiler, pCompiler->offLine, &pCompiler->offEol,
+                                                      &pCompiler->cLines);
+            kmk_cc_eval_compile_line(pCompiler);
+            pCompiler->iLine  += pCompiler->cLines;
+            pCompiler->offLine = pCompiler->offNext;
         }
+
+        /* Unbalanced conditionals are for the interpreter to complain about. */
+        if (pCompiler->cIfs != 0)
+            kmk_cc_eval_fatal(pCompiler, NULL, "Missing 'endif'");
+        kmk_cc_eval_alloc_instr(pCompiler, sizeof(KMKCCEVALCORE), kKmkCcEvalInstr_return);
+        return 0;
     }
+    return -1;
+}
+
+
+/**
+ * Compiles the makefile content into the given program.
+ *
+ * @returns 0 on success, -1 if the content should be left to the interpreter.
+ * @param   pEvalProg   The program.
+ * @param   pszContent  The content (zero terminated).
+ * @param   cchContent  The length of the content.
+ */
+static int kmk_cc_eval_compile_worker(PKMKCCEVALPROG pEvalProg, const char *pszContent, size_t cchContent)
+{
+    KMKCCEVALCOMPILER   Compiler;
+    int                 rc;
 
     /*
-     * Check whether
+     * Things the interpreter deals with that we don't care to.  Note that we
+     * treat vertical tabs and form feeds as spaces while the interpreter's
+     * word splitting doesn't.
      */
+    if (   memchr(pszContent, '\r', cchContent)
+        || memchr(pszContent, '\v', cchContent)
+        || memchr(pszContent, '\f', cchContent)
+        || strlen(pszContent) != cchContent
+        || (cchContent >= 3 && memcmp(pszContent, "\xef\xbb\xbf", 3) == 0)
+        || strstr(pszContent, ".RECIPEPREFIX"))
+    {
+        KMK_CC_EVAL_DPRINTF(("kmk_cc_eval_compile_worker: unsupported content in %s/%s\n",
+                             pEvalProg->pszFilename, pEvalProg->pszVarName));
+        return -1;
+    }
 
-    kmk_cc_eval_delete_compiler(&Compiler);
-    KMK_CC_EVAL_DPRINTF(("kmk_cc_eval_compile_worker - done (%s/%s)\n\n", pEvalProg->pszFilename, pEvalProg->pszVarName));
-    return 0;
+    /*
+     * Compiler state.
+     */
+    Compiler.ppBlockTail        = &pEvalProg->pBlockTail;
+    Compiler.pEvalProg          = pEvalProg;
+    Compiler.pszContent         = pszContent;
+    Compiler.cchContent         = cchContent;
+    Compiler.chCmdPrefix        = pEvalProg->chCmdPrefix;
+    Compiler.iLine              = 1;
+    Compiler.cLines             = 0;
+    Compiler.offLine            = 0;
+    Compiler.offEol             = 0;
+    Compiler.offNext            = 0;
+    Compiler.pszScratch         = NULL;
+    Compiler.cbScratch          = 0;
+    Compiler.cWords             = 0;
+    Compiler.cWordsAllocated    = 0;
+    Compiler.paWords            = NULL;
+    Compiler.pszDefValue        = NULL;
+    Compiler.cbDefValue         = 0;
+    Compiler.offChunk           = KMK_CC_EVAL_NO_CHUNK;
+    Compiler.offChunkEnd        = 0;
+    Compiler.iChunkLine         = 0;
+    Compiler.fRuleMaybePending  = 0;
+    Compiler.cIfs               = 0;
+    KMK_CC_EVAL_DPRINTF(("\nkmk_cc_eval_compile_worker - begin (%s/%s)\n", pEvalProg->pszFilename, pEvalProg->pszVarName));
+
+    rc = kmk_cc_eval_compile_lines(&Compiler);
+
+    free(Compiler.pszScratch);
+    free(Compiler.paWords);
+    free(Compiler.pszDefValue);
+    KMK_CC_EVAL_DPRINTF(("kmk_cc_eval_compile_worker - done (%s/%s) -> %d\n\n", pEvalProg->pszFilename, pEvalProg->pszVarName, rc));
+    return rc;
 }
 
 
-
 static PKMKCCEVALPROG kmk_cc_eval_compile(const char *pszContent, size_t cchContent,
                                           const char *pszFilename, unsigned iLine, const char *pszVarName)
 {
@@ -7396,6 +5465,8 @@ static PKMKCCEVALPROG kmk_cc_eval_compile(const char *pszContent, size_t cchCont
         pEvalProg->pFirstInstr  = (PKMKCCEVALCORE)kmk_cc_block_get_next_ptr(pBlock);
         pEvalProg->pszFilename  = pszFilename ? pszFilename : "<unknown>";
         pEvalProg->pszVarName   = pszVarName;
+        pEvalProg->chCmdPrefix  = cmd_prefix;
+        pEvalProg->fLineNumbers = pszVarName == NULL;
         pEvalProg->cRefs        = 1;
 #ifdef KMK_CC_STRICT
         pEvalProg->uInputHash   = kmk_cc_debug_string_hash_n(0, pszContent, cchContent);
@@ -7405,7 +5476,7 @@ static PKMKCCEVALPROG kmk_cc_eval_compile(const char *pszContent, size_t cchCont
          * Do the actual compiling.
          */
 #ifdef CONFIG_WITH_EVAL_COMPILER
-        if (kmk_cc_eval_compile_worker(pEvalProg, pszContent, cchContent, iLine) == 0)
+        if (kmk_cc_eval_compile_worker(pEvalProg, pszContent, cchContent) == 0)
 #else
         if (0)
 #endif
@@ -7474,15 +5545,15 @@ struct kmk_cc_evalprog   *kmk_cc_compile_file_for_eval(FILE *pFile, const char *
     if (!fstat(fileno(pFile), &st))
     {
         if (   st.st_size > (off_t)KMK_CC_EVAL_MAX_COMPILE_SIZE
-            && st.st_size < 0)
-            fatal(NULL, _("Makefile too large to compile: %ld bytes (%#lx) - max %uMB"),
+            || st.st_size < 0)
+            fatal(NILF, INTSTR_LENGTH * 3, _("Makefile too large to compile: %ld bytes (%#lx) - max %uMB"),
                   (long)st.st_size, (long)st.st_size, KMK_CC_EVAL_MAX_COMPILE_SIZE / 1024 / 1024);
         cchContent = (size_t)st.st_size;
         pszContent = (char *)xmalloc(cchContent + 1);
 
         cchContent = fread(pszContent, 1, cchContent, pFile);
         if (ferror(pFile))
-            fatal(NULL, _("Read error: %s"), strerror(errno));
+            OS(fatal, NILF, _("Read error: %s"), strerror(errno));
     }
     else
     {
@@ -7491,11 +5562,11 @@ struct kmk_cc_evalprog   *kmk_cc_compile_file_for_eval(FILE *pFile, const char *
         {
             cbAllocated *= 2;
             if (cbAllocated > KMK_CC_EVAL_MAX_COMPILE_SIZE)
-                fatal(NULL, _("Makefile too large to compile: max %uMB"), KMK_CC_EVAL_MAX_COMPILE_SIZE / 1024 / 1024);
+                ON(fatal, NILF, _("Makefile too large to compile: max %uMB"), KMK_CC_EVAL_MAX_COMPILE_SIZE / 1024 / 1024);
             pszContent = (char *)xrealloc(pszContent, cbAllocated);
             cchContent += fread(&pszContent[cchContent], 1, cbAllocated - 1 - cchContent, pFile);
             if (ferror(pFile))
-                fatal(NULL, _("Read error: %s"), strerror(errno));
+                OS(fatal, NILF, _("Read error: %s"), strerror(errno));
         } while (!feof(pFile));
     }
     pszContent[cchContent] = '\0';
@@ -7513,28 +5584,511 @@ struct kmk_cc_evalprog   *kmk_cc_compile_file_for_eval(FILE *pFile, const char *
 }
 
 
+/**
+ * Gets the value of an evaluation instruction operand.
+ *
+ * @returns Pointer to the zero terminated value.
+ * @param   pOperand    The operand.
+ * @param   pcch        Where to return the length of the value.
+ * @param   ppszFree    Where to return what to free when done with the value.
+ */
+static char *kmk_exec_eval_operand(PKMKCCEXPSUBPROGORPLAIN pOperand, uint32_t *pcch, char **ppszFree)
+{
+    char *pszRet;
+    if (pOperand->fSubprog)
+        pszRet = *ppszFree = kmk_exec_expand_subprog_to_tmp(&pOperand->u.Subprog, pcch);
+    else if (pOperand->bUser == KMK_CC_EVAL_OPERAND_EXPAND)
+    {
+        unsigned int cch;
+        pszRet = *ppszFree = allocated_variable_expand_2(pOperand->u.Plain.psz, pOperand->u.Plain.cch, &cch);
+        *pcch  = cch;
+    }
+    else
+    {
+        pszRet    = (char *)pOperand->u.Plain.psz;
+        *pcch     = pOperand->u.Plain.cch;
+        *ppszFree = NULL;
+    }
+    return pszRet;
+}
+
+
+/**
+ * Executes an assignment instruction.
+ *
+ * @param   pInstr      The instruction.
+ * @param   pLoc        The current location.
+ */
+static void kmk_exec_eval_assign(PKMKCCEVALASSIGN pInstr, const floc *pLoc)
+{
+    static const enum variable_flavor s_aenmFlavors[] =
+    {
+        f_recursive, f_simple, f_append,
+#ifdef CONFIG_WITH_PREPEND_ASSIGNMENT
+        f_prepend,
+#else
+        f_bogus,
+#endif
+        f_conditional
+    };
+    enum variable_flavor const  enmFlavor = s_aenmFlavors[pInstr->Core.enmOpcode - kKmkCcEvalInstr_assign_recursive];
+    enum variable_origin const  enmOrigin = pInstr->fLocal ? o_local : pInstr->fOverride ? o_override : o_file;
+    struct variable            *pVar;
+    uint32_t                    cchName;
+    char                       *pszNameFree;
+    char                       *pszName = kmk_exec_eval_operand(&pInstr->Variable, &cchName, &pszNameFree);
+    if (*pszName == '\0')
+        O(fatal, pLoc, _("empty variable name"));
+
+    if (pInstr->Value.fSubprog)
+    {
+        uint32_t cchValue;
+        char    *pszValue = kmk_exec_expand_subprog_to_tmp(&pInstr->Value.u.Subprog, &cchValue);
+        pVar = do_variable_definition_2(pLoc, pszName, pszValue, cchValue, 1 /*simple_value*/, pszValue,
+                                        enmOrigin, enmFlavor, 0 /*target_var*/);
+    }
+    else
+        pVar = do_variable_definition_2(pLoc, pszName, pInstr->Value.u.Plain.psz, pInstr->Value.u.Plain.cch,
+                                        0 /*simple_value*/, NULL, enmOrigin, enmFlavor, 0 /*target_var*/);
+    assert(pVar != NULL);
+    if (pInstr->fExport)
+        pVar->export = v_export;
+    if (pInstr->fPrivate)
+        pVar->private_var = 1;
+
+    if (pszNameFree)
+        free(pszNameFree);
+}
+
+
+/**
+ * Executes a define instruction, mirroring the tail of do_define().
+ *
+ * @param   pInstr      The instruction.
+ * @param   pLoc        The current location.
+ */
+static void kmk_exec_eval_define(PKMKCCEVALASSIGNDEF pInstr, const floc *pLoc)
+{
+    PKMKCCEVALASSIGN const      pAssign   = &pInstr->AssignCore;
+    enum variable_flavor const  enmFlavor = pAssign->Core.enmOpcode == kKmkCcEvalInstr_define_if_new
+                                          ? f_conditional : f_recursive;
+    enum variable_origin const  enmOrigin = pAssign->fLocal ? o_local : pAssign->fOverride ? o_override : o_file;
+    struct variable            *pVar;
+    uint32_t                    cchName;
+    char                       *pszNameFree;
+    char                       *pszName = kmk_exec_eval_operand(&pAssign->Variable, &cchName, &pszNameFree);
+    char                       *pszEnd  = pszName + cchName;
+
+    /* The name is the expansion with leading and trailing blanks stripped. */
+    pszName = next_token(pszName);
+    if (*pszName == '\0')
+        O(fatal, pLoc, _("empty variable name"));
+    while (pszEnd - 1 > pszName && ISBLANK(pszEnd[-1]))
+        pszEnd--;
+    if (*pszEnd != '\0')
+    {
+        if (pszNameFree)
+            *pszEnd = '\0';
+        else
+            pszName = pszNameFree = xstrndup(pszName, pszEnd - pszName);
+    }
+
+    pVar = do_variable_definition_2(pLoc, pszName, pAssign->Value.u.Plain.psz, pAssign->Value.u.Plain.cch,
+                                    0 /*simple_value*/, NULL, enmOrigin, enmFlavor, 0 /*target_var*/);
+    assert(pVar != NULL);
+    if (pAssign->fExport)
+        pVar->export = v_export;
+    if (pAssign->fPrivate)
+        pVar->private_var = 1;
+
+    if (pszNameFree)
+        free(pszNameFree);
+}
+
+
+/**
+ * Executes an export or unexport instruction.
+ *
+ * @param   pInstr      The instruction.
+ * @param   pLoc        The current location.
+ */
+static void kmk_exec_eval_export(PKMKCCEVALVARIABLES pInstr, const floc *pLoc)
+{
+    int const   fExport = pInstr->Core.enmOpcode == kKmkCcEvalInstr_export;
+    uint32_t    iVar;
+    for (iVar = 0; iVar < pInstr->cVars; iVar++)
+    {
+        uint32_t    cchNames;
+        char       *pszFree;
+        const char *pszNames = kmk_exec_eval_operand(&pInstr->aVars[iVar], &cchNames, &pszFree);
+        const char *pszName;
+        unsigned int cchName;
+        while ((pszName = find_next_token(&pszNames, &cchName)) != NULL)
+        {
+            struct variable *pVar = lookup_variable(pszName, cchName);
+            if (!pVar)
+                pVar = define_variable_global(pszName, cchName, "", o_file, 0, pLoc);
+            pVar->export = fExport ? v_export : v_noexport;
+        }
+        if (pszFree)
+            free(pszFree);
+    }
+}
+
+
+/**
+ * Executes an undefine instruction, mirroring do_undefine().
+ *
+ * @param   pInstr      The instruction.
+ * @param   pLoc        The current location.
+ */
+static void kmk_exec_eval_undefine(PKMKCCEVALVARIABLES pInstr, const floc *pLoc)
+{
+    uint32_t    iVar;
+    for (iVar = 0; iVar < pInstr->cVars; iVar++)
+    {
+        uint32_t    cchName;
+        char       *pszFree;
+        char       *pszName = kmk_exec_eval_operand(&pInstr->aVars[iVar], &cchName, &pszFree);
+        char       *pszEnd;
+
+        pszName = next_token(pszName);
+        if (*pszName == '\0')
+            O(fatal, pLoc, _("empty variable name"));
+        pszEnd = strchr(pszName, '\0');
+        while (pszEnd > pszName && ISBLANK(pszEnd[-1]))
+            pszEnd--;
+
+        undefine_variable_global(pszName, pszEnd - pszName, pInstr->fOverride ? o_override : o_file);
+        if (pszFree)
+            free(pszFree);
+    }
+}
+
+
+/**
+ * Evaluates an ifdef or ifndef instruction.
+ *
+ * @returns 1 if the variable is defined with a non-empty value, 0 if not.
+ * @param   pIfCore     The instruction.
+ * @param   pLoc        The current location.
+ */
+static int kmk_exec_eval_is_defined(PKMKCCEVALIFCORE pIfCore, const floc *pLoc)
+{
+    struct variable *pVar;
+    if (   pIfCore->Core.enmOpcode == kKmkCcEvalInstr_ifdef_plain
+        || pIfCore->Core.enmOpcode == kKmkCcEvalInstr_ifndef_plain)
+        pVar = lookup_variable_strcached(((PKMKCCEVALIFDEFPLAIN)pIfCore)->pszName);
+    else
+    {
+        uint32_t    cchName;
+        char       *pszFree;
+        char       *pszName = kmk_exec_eval_operand(&((PKMKCCEVALIFDEFDYNAMIC)pIfCore)->Name, &cchName, &pszFree);
+        char       *pszNameEnd = end_of_token(pszName);
+        const char *pszTmp     = pszNameEnd;
+        NEXT_TOKEN(pszTmp);
+        if (*pszTmp != '\0')
+            O(fatal, pLoc, _("invalid syntax in conditional"));
+
+        pVar = lookup_variable(pszName, pszNameEnd - pszName);
+        if (pszFree)
+            free(pszFree);
+    }
+    return pVar != NULL && *pVar->value != '\0';
+}
+
+
+/**
+ * Evaluates an ifeq, ifneq, if1of or ifn1of instruction.
+ *
+ * @returns 1 if equal / there is a common item, 0 if not.
+ * @param   pInstr      The instruction.
+ */
+static int kmk_exec_eval_is_equal(PKMKCCEVALIFEQ pInstr)
+{
+    uint32_t    cchLeft;
+    char       *pszLeftFree;
+    char       *pszLeft  = kmk_exec_eval_operand(&pInstr->Left, &cchLeft, &pszLeftFree);
+    uint32_t    cchRight;
+    char       *pszRightFree;
+    char       *pszRight = kmk_exec_eval_operand(&pInstr->Right, &cchRight, &pszRightFree);
+    int         fRet;
+
+    if (   pInstr->IfCore.Core.enmOpcode == kKmkCcEvalInstr_ifeq
+        || pInstr->IfCore.Core.enmOpcode == kKmkCcEvalInstr_ifneq)
+        fRet = cchLeft == cchRight && memcmp(pszLeft, pszRight, cchLeft) == 0;
+    else
+    {
+        /* Is any word in the left set also found in the right set? */
+        const char  *pszLeftIter = pszLeft;
+        const char  *pszWord;
+        unsigned int cchWord;
+        fRet = 0;
+        while (!fRet && (pszWord = find_next_token(&pszLeftIter, &cchWord)) != NULL)
+        {
+            const char  *pszRightIter = pszRight;
+            const char  *pszWord2;
+            unsigned int cchWord2;
+            while ((pszWord2 = find_next_token(&pszRightIter, &cchWord2)) != NULL)
+                if (cchWord2 == cchWord && memcmp(pszWord2, pszWord, cchWord) == 0)
+                {
+                    fRet = 1;
+                    break;
+                }
+        }
+    }
+
+    if (pszLeftFree)
+        free(pszLeftFree);
+    if (pszRightFree)
+        free(pszRightFree);
+    return fRet;
+}
+
+
+/**
+ * Executes an include or includedep instruction.
+ *
+ * @param   pInstr      The instruction.
+ * @param   pLoc        The current location.
+ */
+static void kmk_exec_eval_include(PKMKCCEVALINCLUDE pInstr, floc *pLoc)
+{
+    uint32_t iFile;
+    for (iFile = 0; iFile < pInstr->cFiles; iFile++)
+    {
+        uint32_t    cchFiles;
+        char       *pszFree;
+        char       *pszFiles = kmk_exec_eval_operand(&pInstr->aFiles[iFile], &cchFiles, &pszFree);
+        if (   pInstr->Core.enmOpcode == kKmkCcEvalInstr_include
+            || pInstr->Core.enmOpcode == kKmkCcEvalInstr_include_silent)
+        {
+            /* The name list is modified while parsing it. */
+            if (!pszFree)
+                pszFiles = pszFree = xstrdup(pszFiles);
+            eval_include_for_compiler(pszFiles, pInstr->Core.enmOpcode == kKmkCcEvalInstr_include_silent, pLoc);
+        }
+#ifdef CONFIG_WITH_INCLUDEDEP
+        else
+        {
+            enum incdep_op const enmOp = pInstr->Core.enmOpcode == kKmkCcEvalInstr_includedep ? incdep_read_it
+                                       : pInstr->Core.enmOpcode == kKmkCcEvalInstr_includedep_queue ? incdep_queue
+                                       : pInstr->Core.enmOpcode == kKmkCcEvalInstr_include_prefetch ? incdep_prefetch
+                                       : incdep_flush;
+            if (pszFree)
+            {
+                /* Trim the expanded name like the interpreter does. */
+                char *pszEnd = pszFiles + cchFiles;
+                while (ISSPACE(*pszFiles))
+                    pszFiles++;
+                while (pszEnd > pszFiles && ISSPACE(pszEnd[-1]))
+                    pszEnd--;
+                *pszEnd = '\0';
+            }
+            eval_include_dep(pszFiles, pLoc, enmOp);
+        }
+#endif
+        if (pszFree)
+            free(pszFree);
+    }
+}
+
+
+/**
+ * Executes a makefile evaluation program.
+ *
+ * @returns 0 on success, -1 if the program cannot be used and the caller
+ *          should fall back on the interpreter.
+ * @param   pProg       The program.
+ */
+static int kmk_exec_eval_prog(PKMKCCEVALPROG pProg)
+{
+    PKMKCCEVALCORE  pInstr = pProg->pFirstInstr;
+    const floc     *pSavedReadingFile = reading_file;
+    floc            Loc;
+    unsigned long   uBaseLine;
+
+    /* The recipe prefix is baked into the program. */
+    if (pProg->chCmdPrefix != cmd_prefix)
+        return -1;
+
+    if (reading_file)
+        Loc = *reading_file;
+    else
+    {
+        Loc.filenm = NULL;
+        Loc.lineno = 1;
+        Loc.offset = 0;
+    }
+    uBaseLine    = Loc.lineno;
+    reading_file = &Loc;
+    pProg->cRefs++;
+
+    for (;;)
+    {
+        KMKCCEVALINSTR const enmOpcode = pInstr->enmOpcode;
+        if (enmOpcode == kKmkCcEvalInstr_jump)
+        {
+            pInstr = ((PKMKCCEVALJUMP)pInstr)->pNext;
+            continue;
+        }
+        if (pProg->fLineNumbers)
+            Loc.lineno = uBaseLine + pInstr->iLine - 1;
+
+        switch (enmOpcode)
+        {
+            case kKmkCcEvalInstr_assign_recursive:
+            case kKmkCcEvalInstr_assign_simple:
+            case kKmkCcEvalInstr_assign_append:
+            case kKmkCcEvalInstr_assign_prepend:
+            case kKmkCcEvalInstr_assign_if_new:
+                kmk_exec_eval_assign((PKMKCCEVALASSIGN)pInstr, &Loc);
+                pInstr = ((PKMKCCEVALASSIGN)pInstr)->pNext;
+                break;
+
+            case kKmkCcEvalInstr_define_recursive:
+            case kKmkCcEvalInstr_define_if_new:
+                kmk_exec_eval_define((PKMKCCEVALASSIGNDEF)pInstr, &Loc);
+                pInstr = ((PKMKCCEVALASSIGNDEF)pInstr)->AssignCore.pNext;
+                break;
+
+            case kKmkCcEvalInstr_export:
+            case kKmkCcEvalInstr_unexport:
+                kmk_exec_eval_export((PKMKCCEVALVARIABLES)pInstr, &Loc);
+                pInstr = ((PKMKCCEVALVARIABLES)pInstr)->pNext;
+                break;
+
+            case kKmkCcEvalInstr_export_all:
+            case kKmkCcEvalInstr_unexport_all:
+                export_all_variables = enmOpcode == kKmkCcEvalInstr_export_all;
+                pInstr = (PKMKCCEVALCORE)((uintptr_t)pInstr + sizeof(KMKCCEVALCORE));
+                break;
+
+            case kKmkCcEvalInstr_undefine:
+                kmk_exec_eval_undefine((PKMKCCEVALVARIABLES)pInstr, &Loc);
+                pInstr = ((PKMKCCEVALVARIABLES)pInstr)->pNext;
+                break;
+
+            case kKmkCcEvalInstr_ifdef_plain:
+            case kKmkCcEvalInstr_ifdef_dynamic:
+            case kKmkCcEvalInstr_ifndef_plain:
+            case kKmkCcEvalInstr_ifndef_dynamic:
+            {
+                PKMKCCEVALIFCORE pIfCore = (PKMKCCEVALIFCORE)pInstr;
+                int fTrue = kmk_exec_eval_is_defined(pIfCore, &Loc);
+                if (enmOpcode == kKmkCcEvalInstr_ifndef_plain || enmOpcode == kKmkCcEvalInstr_ifndef_dynamic)
+                    fTrue = !fTrue;
+                pInstr = fTrue ? pIfCore->pNextTrue : pIfCore->pNextFalse;
+                break;
+            }
+
+            case kKmkCcEvalInstr_ifeq:
+            case kKmkCcEvalInstr_ifneq:
+            case kKmkCcEvalInstr_if1of:
+            case kKmkCcEvalInstr_ifn1of:
+            {
+                PKMKCCEVALIFCORE pIfCore = (PKMKCCEVALIFCORE)pInstr;
+                int fTrue = kmk_exec_eval_is_equal((PKMKCCEVALIFEQ)pInstr);
+                if (enmOpcode == kKmkCcEvalInstr_ifneq || enmOpcode == kKmkCcEvalInstr_ifn1of)
+                    fTrue = !fTrue;
+                pInstr = fTrue ? pIfCore->pNextTrue : pIfCore->pNextFalse;
+                break;
+            }
+
+#ifdef CONFIG_WITH_IF_CONDITIONALS
+            case kKmkCcEvalInstr_if:
+            {
+                PKMKCCEVALIFEXPR pIfExpr = (PKMKCCEVALIFEXPR)pInstr;
+                int rc = expr_eval_if_conditionals(pIfExpr->szExpr, &Loc);
+                if (rc == -1)
+                    O(fatal, &Loc, _("invalid syntax in conditional"));
+                pInstr = rc == 0 ? pIfExpr->IfCore.pNextTrue : pIfExpr->IfCore.pNextFalse;
+                break;
+            }
+#endif
+
+            case kKmkCcEvalInstr_include:
+            case kKmkCcEvalInstr_include_silent:
+            case kKmkCcEvalInstr_includedep:
+            case kKmkCcEvalInstr_includedep_queue:
+            case kKmkCcEvalInstr_includedep_flush:
+            case kKmkCcEvalInstr_include_prefetch:
+                kmk_exec_eval_include((PKMKCCEVALINCLUDE)pInstr, &Loc);
+                pInstr = ((PKMKCCEVALINCLUDE)pInstr)->pNext;
+                break;
+
+            case kKmkCcEvalInstr_expand:
+            {
+                /* Only used for function calls expanding to nothing, but check like the interpreter would. */
+                PKMKCCEVALEXPAND pExpand = (PKMKCCEVALEXPAND)pInstr;
+                uint32_t cchResult;
+                char *pszResult = kmk_exec_expand_subprog_to_tmp(&pExpand->Subprog, &cchResult);
+                if (*next_token(pszResult) != '\0')
+                    O(fatal, &Loc, _("missing separator"));
+                free(pszResult);
+                pInstr = pExpand->pNext;
+                break;
+            }
+
+            case kKmkCcEvalInstr_interpret:
+            {
+                /* The interpreter modifies the text, so give it a copy. */
+                PKMKCCEVALINTERPRET pInterpret = (PKMKCCEVALINTERPRET)pInstr;
+                char *pszCopy = (char *)xmalloc(pInterpret->cchText + 1);
+                g_cEvalChunkRuns++;
+                memcpy(pszCopy, pInterpret->pszText, pInterpret->cchText + 1);
+                eval_buffer_for_compiler(pszCopy, pszCopy + pInterpret->cchText, &Loc, pProg->fLineNumbers);
+                free(pszCopy);
+                pInstr = pInterpret->pNext;
+                break;
+            }
+
+            case kKmkCcEvalInstr_return:
+                reading_file = pSavedReadingFile;
+                if (--pProg->cRefs == 0)
+                    kmk_cc_block_free_list(pProg->pBlockTail);
+                return 0;
+
+            default:
+                fatal(&Loc, INTSTR_LENGTH * 2, _("Unknown eval instruction %d at line %u!\n"),
+                      enmOpcode, pInstr->iLine);
+        }
+    }
+}
+
+
 /**
  * Equivalent of eval_buffer, only it's using the evalprog of the variable.
  *
+ * @returns 0 on success, -1 if the caller should use eval_buffer instead.
  * @param   pVar        Pointer to the variable. Must have a program.
  */
-void kmk_exec_eval_variable(struct variable *pVar)
+int kmk_exec_eval_variable(struct variable *pVar)
 {
+    int rc;
     KMK_CC_ASSERT(pVar->evalprog);
-    assert(0);
+    KMK_CC_ASSERT(pVar->evalprog->uInputHash == kmk_cc_debug_string_hash(0, pVar->value));
+    rc = kmk_exec_eval_prog(pVar->evalprog);
+    if (rc == 0)
+        g_cVarForEvalExecs++;
+    return rc;
 }
 
 
 /**
  * Worker for eval_makefile.
  *
+ * @returns 0 on success, -1 if the caller should interpret the file instead.
  * @param   pEvalProg   The program pointer.
  */
-void kmk_exec_eval_file(struct kmk_cc_evalprog *pEvalProg)
+int kmk_exec_eval_file(struct kmk_cc_evalprog *pEvalProg)
 {
+    int rc;
     KMK_CC_ASSERT(pEvalProg);
-    assert(0);
-
+    rc = kmk_exec_eval_prog(pEvalProg);
+    if (rc == 0)
+        g_cFileForEvalExecs++;
+    return rc;
 }
 
 
@@ -7561,8 +6115,11 @@ void  kmk_cc_variable_changed(struct variable *pVar)
 
     if (pVar->evalprog)
     {
-        kmk_cc_block_free_list(pVar->evalprog->pBlockTail);
+        /* The program may be running (evalval of itself), in which case it is freed upon return. */
+        PKMKCCEVALPROG pEvalProg = pVar->evalprog;
         pVar->evalprog = NULL;
+        if (--pEvalProg->cRefs == 0)
+            kmk_cc_block_free_list(pEvalProg->pBlockTail);
     }
 
     if (pProg)
@@ -7570,7 +6127,7 @@ void  kmk_cc_variable_changed(struct variable *pVar)
         if (pProg->cRefs == 1)
             kmk_cc_block_free_list(pProg->pBlockTail);
         else
-            fatal(NULL, _("Modifying a variable (%s) while its expansion program is running is not supported"), pVar->name);
+            OS(fatal, NILF, _("Modifying a variable (%s) while its expansion program is running is not supported"), pVar->name);
         pVar->expandprog = NULL;
     }
 }
@@ -7589,8 +6146,11 @@ void  kmk_cc_variable_deleted(struct variable *pVar)
 
     if (pVar->evalprog)
     {
-        kmk_cc_block_free_list(pVar->evalprog->pBlockTail);
+        /* The program may be running (evalval of itself), in which case it is freed upon return. */
+        PKMKCCEVALPROG pEvalProg = pVar->evalprog;
         pVar->evalprog = NULL;
+        if (--pEvalProg->cRefs == 0)
+            kmk_cc_block_free_list(pEvalProg->pBlockTail);
     }
 
     if (pProg)
@@ -7598,7 +6158,7 @@ void  kmk_cc_variable_deleted(struct variable *pVar)
         if (pProg->cRefs == 1)
             kmk_cc_block_free_list(pProg->pBlockTail);
         else
-            fatal(NULL, _("Deleting a variable (%s) while its expansion program is running is not supported"), pVar->name);
+            OS(fatal, NILF, _("Deleting a variable (%s) while its expansion program is running is not supported"), pVar->name);
         pVar->expandprog = NULL;
     }
 }
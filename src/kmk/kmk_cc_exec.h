@@ -38,8 +38,8 @@ extern struct kmk_cc_expandprog *kmk_cc_compile_variable_for_expand(struct varia
 extern struct kmk_cc_evalprog   *kmk_cc_compile_variable_for_eval(struct variable *pVar);
 extern struct kmk_cc_evalprog   *kmk_cc_compile_file_for_eval(FILE *pFile, const char *pszFilename);
 extern char *kmk_exec_expand_to_var_buf(struct variable *pVar, char *pchDst);
-extern void kmk_exec_eval_file(struct kmk_cc_evalprog *pProg);
-extern void kmk_exec_eval_variable(struct variable *pVar);
+extern int  kmk_exec_eval_file(struct kmk_cc_evalprog *pProg);
+extern int  kmk_exec_eval_variable(struct variable *pVar);
 extern void kmk_cc_variable_changed(struct variable *pVar);
 extern void kmk_cc_variable_deleted(struct variable *pVar);
 
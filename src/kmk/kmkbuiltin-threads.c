@@ -0,0 +1,485 @@
+/* $Id$ */
+/** @file
+ * kMk Builtin command execution on worker threads, POSIX.
+ *
+ * This is the POSIX counterpart to the built-in part of w32/winchildren.c.
+ * Built-in commands marked as multi thread safe are queued to a pool of
+ * worker threads instead of being executed synchronously on the main thread.
+ * Each queued command gets a fake process ID that reap_children() gets back
+ * from kmk_builtin_async_reap() once the command has completed, just like for a
+ * real child process.  The worker threads send the process a SIGCHLD after
+ * completing a command, so the main thread wakes up from its pselect calls.
+ *
+ * With CONFIG_WITH_KASH_EMBEDDED the pool also runs kmk_ash command lines,
+ * using the copy of kash that is linked into kmk (sh_embedded_main).
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "makeint.h"
+#include "job.h"
+#include "kmkbuiltin.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef CONFIG_WITH_KMK_BUILTIN_THREADS
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The first fake process ID.  This is above PID_MAX_LIMIT on linux and the
+ * pid ranges of the other systems we care about, so kill_children() and
+ * friends will not hit anything real. */
+#define KMKBUILTINTHREAD_FIRST_PID      ((pid_t)0x40000000)
+/** The last fake process ID before wrapping around. */
+#define KMKBUILTINTHREAD_LAST_PID       ((pid_t)0x7ffffff0)
+/** The worker thread stack size.  The shell recurses on the parse tree. */
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+# define KMKBUILTINTHREAD_STACK_SIZE    (2*1024*1024)
+#else
+# define KMKBUILTINTHREAD_STACK_SIZE    (256*1024)
+#endif
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * A built-in command queued for or running on a worker thread.
+ */
+typedef struct KMKBUILTINTHREADJOB
+{
+    /** Next job in the pending or completed list. */
+    struct KMKBUILTINTHREADJOB *pNext;
+    /** The built-in command entry, NULL for a shell command line. */
+    PCKMKBUILTINENTRY           pBuiltIn;
+    /** The make child structure (output). */
+    struct child               *pMkChild;
+    /** The fake process ID. */
+    pid_t                       pid;
+    /** The umask when the command was queued, see kmk_builtin_thread_umask. */
+    mode_t                      fUmask;
+    /** The exit code, or the wait status for a shell command line. */
+    int                         iExitCode;
+    /** The number of arguments. */
+    int                         cArgs;
+    /** The argument vector (copy, the strings follows the vector).  */
+    char                      **papszArgs;
+    /** The environment, owned by pMkChild and valid till it is reaped. */
+    char                      **papszEnv;
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+    /** The standard handles for a shell command line (copies we close). */
+    int                         aFds[3];
+#endif
+} KMKBUILTINTHREADJOB;
+/** Pointer to a built-in thread job. */
+typedef KMKBUILTINTHREADJOB *PKMKBUILTINTHREADJOB;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Protects the job lists and counters below (not g_cOutstanding). */
+static pthread_mutex_t      g_Mtx = PTHREAD_MUTEX_INITIALIZER;
+/** Signalled when a job is added to the pending list. */
+static pthread_cond_t       g_CondPending = PTHREAD_COND_INITIALIZER;
+/** Head of the pending job list (FIFO). */
+static PKMKBUILTINTHREADJOB g_pPendingHead = NULL;
+/** Where to link in the next pending job. */
+static PKMKBUILTINTHREADJOB *g_ppPendingTail = &g_pPendingHead;
+/** Number of pending jobs. */
+static unsigned             g_cPending = 0;
+/** Head of the completed job list (LIFO, order doesn't matter). */
+static PKMKBUILTINTHREADJOB g_pCompletedHead = NULL;
+/** Number of worker threads. */
+static unsigned             g_cThreads = 0;
+/** Number of worker threads waiting for work. */
+static unsigned             g_cIdleThreads = 0;
+
+/** Number of jobs submitted but not yet reaped (main thread only). */
+static unsigned             g_cOutstanding = 0;
+/** The next fake process ID (main thread only). */
+static pid_t                g_pidNext = KMKBUILTINTHREAD_FIRST_PID;
+/** The process umask as of when nothing was last running on the worker
+ * threads (main thread only), see kmk_builtin_thread_umask. */
+static mode_t               g_fProcessUmask = 022;
+
+
+
+/**
+ * Worker thread: runs one built-in command.
+ *
+ * @param   pJob                The job.
+ */
+static void kmkBuiltinThreadRunJob(PKMKBUILTINTHREADJOB pJob)
+{
+    PCKMKBUILTINENTRY pBuiltIn = pJob->pBuiltIn;
+    KMKBUILTINCTX Ctx;
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+    if (!pBuiltIn)
+    {
+        int i;
+        pJob->iExitCode = sh_embedded_main(pJob->cArgs, pJob->papszArgs, pJob->papszEnv, pJob->aFds, pJob->pid);
+        for (i = 0; i < 3; i++)
+            if (pJob->aFds[i] != -1)
+                close(pJob->aFds[i]);
+        return;
+    }
+#endif
+    Ctx.pszProgName = pBuiltIn->uName.s.sz;
+    Ctx.pOut        = pJob->pMkChild ? &pJob->pMkChild->output : NULL;
+    Ctx.pvWorker    = pJob;
+
+    if (pBuiltIn->uFnSignature == FN_SIG_MAIN)
+        pJob->iExitCode = pBuiltIn->u.pfnMain(pJob->cArgs, pJob->papszArgs, pJob->papszEnv, &Ctx);
+    else
+    {
+        assert(0);
+        pJob->iExitCode = 98;
+    }
+}
+
+
+/**
+ * Worker thread procedure.
+ *
+ * @returns NULL, never returns.
+ * @param   pvUser              Ignored.
+ */
+static void *kmkBuiltinThreadProc(void *pvUser)
+{
+    (void)pvUser;
+    pthread_mutex_lock(&g_Mtx);
+    for (;;)
+    {
+        PKMKBUILTINTHREADJOB pJob;
+        while (!g_pPendingHead)
+        {
+            g_cIdleThreads++;
+            pthread_cond_wait(&g_CondPending, &g_Mtx);
+            g_cIdleThreads--;
+        }
+
+        pJob = g_pPendingHead;
+        g_pPendingHead = pJob->pNext;
+        if (!g_pPendingHead)
+            g_ppPendingTail = &g_pPendingHead;
+        g_cPending--;
+        pthread_mutex_unlock(&g_Mtx);
+
+        kmkBuiltinThreadRunJob(pJob);
+
+        pthread_mutex_lock(&g_Mtx);
+        pJob->pNext = g_pCompletedHead;
+        g_pCompletedHead = pJob;
+
+        /* Wake up the main thread.  It keeps SIGCHLD blocked except while
+           waiting in pselect, so the signal cannot get lost. */
+        kill(getpid(), SIGCHLD);
+    }
+    return NULL;
+}
+
+
+/**
+ * Creates another worker thread.
+ *
+ * Caller owns g_Mtx.
+ *
+ * @returns 0 on success, pthread status code on failure.
+ */
+static int kmkBuiltinThreadCreate(void)
+{
+    pthread_attr_t  Attr;
+    pthread_t       hThread;
+    sigset_t        SigMaskAll;
+    sigset_t        SigMaskSaved;
+    int             rc;
+
+    /* The workers should never handle any signals, that's the main thread's job. */
+    sigfillset(&SigMaskAll);
+    pthread_sigmask(SIG_SETMASK, &SigMaskAll, &SigMaskSaved);
+
+    rc = pthread_attr_init(&Attr);
+    if (rc == 0)
+    {
+        pthread_attr_setdetachstate(&Attr, PTHREAD_CREATE_DETACHED);
+        pthread_attr_setstacksize(&Attr, KMKBUILTINTHREAD_STACK_SIZE);
+        rc = pthread_create(&hThread, &Attr, kmkBuiltinThreadProc, NULL);
+        pthread_attr_destroy(&Attr);
+        if (rc == 0)
+            g_cThreads++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &SigMaskSaved, NULL);
+    return rc;
+}
+
+
+/**
+ * Allocates a job, copying the arguments since they are freed on return.
+ *
+ * @returns The job.
+ * @param   pBuiltIn        The kmk built-in command entry, NULL for shell.
+ * @param   cArgs           The number of arguments in papszArgs.
+ * @param   papszArgs       The argument vector.
+ * @param   papszEnv        The environment vector, optional.
+ * @param   pMkChild        The make child structure.
+ */
+static PKMKBUILTINTHREADJOB kmkBuiltinThreadNewJob(PCKMKBUILTINENTRY pBuiltIn, int cArgs, char **papszArgs,
+                                                   char **papszEnv, struct child *pMkChild)
+{
+    PKMKBUILTINTHREADJOB pJob;
+    size_t  cbStrings = 0;
+    char   *pszDst;
+    int     i;
+
+    for (i = 0; i < cArgs; i++)
+        cbStrings += strlen(papszArgs[i]) + 1;
+    pJob = (PKMKBUILTINTHREADJOB)xmalloc(sizeof(*pJob) + (cArgs + 1) * sizeof(char *) + cbStrings);
+    pJob->pNext     = NULL;
+    pJob->pBuiltIn  = pBuiltIn;
+    pJob->pMkChild  = pMkChild;
+    pJob->iExitCode = 0;
+    pJob->cArgs     = cArgs;
+    pJob->papszArgs = (char **)(pJob + 1);
+    pJob->papszEnv  = papszEnv;
+    pszDst = (char *)&pJob->papszArgs[cArgs + 1];
+    for (i = 0; i < cArgs; i++)
+    {
+        size_t cb = strlen(papszArgs[i]) + 1;
+        pJob->papszArgs[i] = (char *)memcpy(pszDst, papszArgs[i], cb);
+        pszDst += cb;
+    }
+    pJob->papszArgs[cArgs] = NULL;
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+    pJob->aFds[0] = pJob->aFds[1] = pJob->aFds[2] = -1;
+#endif
+
+    pJob->fUmask = kmk_builtin_thread_umask(NULL);
+    return pJob;
+}
+
+
+/**
+ * Queues a job and makes sure there is a thread to pick it up.
+ *
+ * @returns 0 on success, -1 if there are no worker threads (caller frees).
+ * @param   pJob            The job.
+ * @param   pPid            Where to return the fake process ID.
+ */
+static int kmkBuiltinThreadQueueJob(PKMKBUILTINTHREADJOB pJob, pid_t *pPid)
+{
+    int rc;
+
+    pJob->pid = g_pidNext;
+    g_pidNext = g_pidNext < KMKBUILTINTHREAD_LAST_PID ? g_pidNext + 1 : KMKBUILTINTHREAD_FIRST_PID;
+
+    pthread_mutex_lock(&g_Mtx);
+    *g_ppPendingTail = pJob;
+    g_ppPendingTail  = &pJob->pNext;
+    g_cPending++;
+    if (g_cIdleThreads >= g_cPending)
+        rc = 0;
+    else
+        rc = kmkBuiltinThreadCreate();
+    if (rc == 0 || g_cThreads > 0)
+    {
+        pthread_cond_signal(&g_CondPending);
+        pthread_mutex_unlock(&g_Mtx);
+
+        g_cOutstanding++;
+        *pPid = pJob->pid;
+        return 0;
+    }
+
+    /* No threads, unlink it again and let the caller run it synchronously. */
+    g_pPendingHead  = NULL;
+    g_ppPendingTail = &g_pPendingHead;
+    g_cPending      = 0;
+    pthread_mutex_unlock(&g_Mtx);
+    return -1;
+}
+
+
+/**
+ * Queues a built-in command for execution on a worker thread.
+ *
+ * Called by kmk_builtin_command_parsed() on the main thread.  The caller
+ * should execute the command synchronously if this fails.
+ *
+ * @returns 0 on success, -1 if the command couldn't be queued.
+ * @param   pBuiltIn        The kmk built-in command entry.
+ * @param   cArgs           The number of arguments in papszArgs.
+ * @param   papszArgs       The argument vector.  This is copied.
+ * @param   papszEnv        The environment vector, optional.  This must stay
+ *                          valid till the child has been reaped, which is the
+ *                          case for struct child::environment.
+ * @param   pMkChild        The make child structure.
+ * @param   pPid            Where to return the fake process ID.
+ */
+int kmk_builtin_thread_submit(PCKMKBUILTINENTRY pBuiltIn, int cArgs, char **papszArgs, char **papszEnv,
+                              struct child *pMkChild, pid_t *pPid)
+{
+    PKMKBUILTINTHREADJOB pJob;
+
+    assert(pBuiltIn->fMtSafe && pBuiltIn->uFnSignature == FN_SIG_MAIN);
+
+    pJob = kmkBuiltinThreadNewJob(pBuiltIn, cArgs, papszArgs, papszEnv, pMkChild);
+    if (kmkBuiltinThreadQueueJob(pJob, pPid) == 0)
+        return 0;
+    free(pJob);
+    return -1;
+}
+
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+
+/**
+ * Queues a kmk_ash command line for execution by the embedded kash on a
+ * worker thread.
+ *
+ * Called by start_job_command() on the main thread.  The caller should
+ * fork+exec the shell as usual if this fails.
+ *
+ * @returns 0 on success, -1 if the command couldn't be queued.
+ * @param   cArgs           The number of arguments in papszArgs.
+ * @param   papszArgs       The shell argument vector.  This is copied.
+ * @param   papszEnv        The environment vector, see
+ *                          kmk_builtin_thread_submit.
+ * @param   paFds           The standard input, output and error handles.
+ *                          These are duplicated, the caller can close them
+ *                          upon return.
+ * @param   pMkChild        The make child structure.
+ * @param   pPid            Where to return the fake process ID.
+ */
+int kmk_builtin_thread_submit_shell(int cArgs, char **papszArgs, char **papszEnv, int const *paFds,
+                                    struct child *pMkChild, pid_t *pPid)
+{
+    PKMKBUILTINTHREADJOB pJob = kmkBuiltinThreadNewJob(NULL, cArgs, papszArgs, papszEnv, pMkChild);
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        pJob->aFds[i] = fcntl(paFds[i], F_DUPFD_CLOEXEC, 3);
+        if (pJob->aFds[i] == -1)
+            break;
+    }
+    if (   i == 3
+        && kmkBuiltinThreadQueueJob(pJob, pPid) == 0)
+        return 0;
+
+    while (i-- > 0)
+        close(pJob->aFds[i]);
+    free(pJob);
+    return -1;
+}
+
+#endif /* CONFIG_WITH_KASH_EMBEDDED */
+
+
+/**
+ * Gets the next completed built-in command, if any.
+ *
+ * Main thread only.
+ *
+ * @returns The fake process ID of the completed command, 0 if none.
+ * @param   piStatus            Where to return the wait status.
+ */
+pid_t kmk_builtin_thread_reap(int *piStatus)
+{
+    PKMKBUILTINTHREADJOB pJob;
+    pid_t pid;
+
+    if (g_cOutstanding == 0)
+        return 0;
+
+    pthread_mutex_lock(&g_Mtx);
+    pJob = g_pCompletedHead;
+    if (pJob)
+        g_pCompletedHead = pJob->pNext;
+    pthread_mutex_unlock(&g_Mtx);
+    if (!pJob)
+        return 0;
+
+    g_cOutstanding--;
+    pid = pJob->pid;
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+    if (!pJob->pBuiltIn)
+        *piStatus = pJob->iExitCode;
+    else
+#endif
+    *piStatus = (pJob->iExitCode >= 0 && pJob->iExitCode <= 255 ? pJob->iExitCode : 255) << 8;
+    free(pJob);
+    return pid;
+}
+
+
+/**
+ * Gets the number of built-in commands submitted but not yet reaped.
+ *
+ * Main thread only.
+ */
+unsigned kmk_builtin_thread_busy(void)
+{
+    return g_cOutstanding;
+}
+
+
+/**
+ * Gets the umask without temporarily changing it.
+ *
+ * The only way to query the umask is to set it, which a command running on a
+ * worker thread must not do, as the main thread may fork children at any time.
+ * Likewise, the main thread must not do it while commands running on worker
+ * threads may be creating files.  So, the process umask is only queried when
+ * nothing is running on the worker threads.  (kmk itself never changes it
+ * for good.)
+ *
+ * @returns The umask at the time the command was queued, or the process umask
+ *          if @a pvWorker is NULL.
+ * @param   pvWorker            KMKBUILTINCTX::pvWorker, NULL when called on
+ *                              the main thread.
+ */
+mode_t kmk_builtin_thread_umask(void *pvWorker)
+{
+    if (pvWorker)
+        return ((PKMKBUILTINTHREADJOB)pvWorker)->fUmask;
+    if (g_cOutstanding == 0)
+    {
+        g_fProcessUmask = umask(0);
+        umask(g_fProcessUmask);
+    }
+    return g_fProcessUmask;
+}
+
+#endif /* CONFIG_WITH_KMK_BUILTIN_THREADS */
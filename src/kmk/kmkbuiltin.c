@@ -44,6 +44,7 @@
 # include "w32/winchildren.h"
 #endif
 #include "kmkbuiltin/err.h"
+#include "kmkbuiltin/fastcopy.h"
 #include "kmkbuiltin.h"
 
 #ifndef _MSC_VER
@@ -253,7 +254,7 @@ static const KMKBUILTINENTRY g_aBuiltIns[] =
     BUILTIN_ENTRY(kmk_builtin_echo,     "echo",         FN_SIG_MAIN,            0, 0),
     BUILTIN_ENTRY(kmk_builtin_install,  "install",      FN_SIG_MAIN,            1, 0),
     BUILTIN_ENTRY(kmk_builtin_kDepObj,  "kDepObj",      FN_SIG_MAIN,            1, 0),
-#ifdef KBUILD_OS_WINDOWS
+#ifndef KBUILD_OS_OS2
     BUILTIN_ENTRY(kmk_builtin_kSubmit,  "kSubmit",      FN_SIG_MAIN_SPAWNS,     0, 1),
 #endif
     BUILTIN_ENTRY(kmk_builtin_mkdir,    "mkdir",        FN_SIG_MAIN,            0, 0),
@@ -264,6 +265,7 @@ static const KMKBUILTINENTRY g_aBuiltIns[] =
     BUILTIN_ENTRY(kmk_builtin_test,     "test",         FN_SIG_MAIN_TO_SPAWN,   0, 0),
     /* Less frequently used commands: */
     BUILTIN_ENTRY(kmk_builtin_kDepIDB,  "kDepIDB",      FN_SIG_MAIN,            0, 0),
+    BUILTIN_ENTRY(kmk_builtin_kDepDb,   "kDepDb",       FN_SIG_MAIN,            1, 0),
     BUILTIN_ENTRY(kmk_builtin_chmod,    "chmod",        FN_SIG_MAIN,            0, 0),
     BUILTIN_ENTRY(kmk_builtin_cp,       "cp",           FN_SIG_MAIN,            1, 1),
     BUILTIN_ENTRY(kmk_builtin_expr,     "expr",         FN_SIG_MAIN,            0, 0),
@@ -287,169 +289,211 @@ struct
 #endif
 
 
-int kmk_builtin_command_parsed(int argc, char **argv, struct child *pChild, char ***ppapszArgvToSpawn, pid_t *pPidSpawned)
+/**
+ * Looks up a built-in command.
+ *
+ * @returns Pointer to the table entry, NULL if not found.
+ * @param   pszCmd      The command name without the kmk_builtin_ prefix.
+ */
+static PCKMKBUILTINENTRY kmk_builtin_lookup(const char *pszCmd)
 {
-    /*
-     * Check and skip the prefix.
-     */
-    static const char s_szPrefix[] = "kmk_builtin_";
-    const char *pszCmd = argv[0];
-    if (strncmp(pszCmd, s_szPrefix, sizeof(s_szPrefix) - 1) == 0)
-    {
-        struct KMKBUILTINENTRY const *pEntry;
-        size_t cchAndStart;
+    struct KMKBUILTINENTRY const *pEntry;
+    size_t cchAndStart;
 #if K_ENDIAN == K_ENDIAN_BIG
-        size_t cch;
+    size_t cch;
 #endif
-        int    cLeft;
-
-        pszCmd += sizeof(s_szPrefix) - 1;
+    int    cLeft;
 
-        /*
-         * Calc the length and start word to avoid calling memcmp/strcmp on each entry.
-         */
+    /*
+     * Calc the length and start word to avoid calling memcmp/strcmp on each entry.
+     */
 #if K_ARCH_BITS != 64 && K_ARCH_BITS != 32
 # error "PORT ME!"
 #endif
-        cchAndStart = strlen(pszCmd);
+    cchAndStart = strlen(pszCmd);
 #if K_ENDIAN == K_ENDIAN_BIG
-        cch = cchAndStart;
-        cchAndStart <<= K_ARCH_BITS - 8;
-        switch (cch)
-        {
-            default:                                   /* fall thru */
+    cch = cchAndStart;
+    cchAndStart <<= K_ARCH_BITS - 8;
+    switch (cch)
+    {
+        default:                                   /* fall thru */
 # if K_ARCH_BITS >= 64
-            case 7: cchAndStart |= (size_t)pszCmd[6];                       /* fall thru */
-            case 6: cchAndStart |= (size_t)pszCmd[5] << (K_ARCH_BITS - 56); /* fall thru */
-            case 5: cchAndStart |= (size_t)pszCmd[4] << (K_ARCH_BITS - 48); /* fall thru */
-            case 4: cchAndStart |= (size_t)pszCmd[3] << (K_ARCH_BITS - 40); /* fall thru */
+        case 7: cchAndStart |= (size_t)pszCmd[6];                       /* fall thru */
+        case 6: cchAndStart |= (size_t)pszCmd[5] << (K_ARCH_BITS - 56); /* fall thru */
+        case 5: cchAndStart |= (size_t)pszCmd[4] << (K_ARCH_BITS - 48); /* fall thru */
+        case 4: cchAndStart |= (size_t)pszCmd[3] << (K_ARCH_BITS - 40); /* fall thru */
 # endif
-            /* fall thru - gcc 8.2.0 is confused by # endif */
-            case 3: cchAndStart |= (size_t)pszCmd[2] << (K_ARCH_BITS - 32); /* fall thru */
-            case 2: cchAndStart |= (size_t)pszCmd[1] << (K_ARCH_BITS - 24); /* fall thru */
-            case 1: cchAndStart |= (size_t)pszCmd[0] << (K_ARCH_BITS - 16); /* fall thru */
-            case 0: break;
-        }
+        /* fall thru - gcc 8.2.0 is confused by # endif */
+        case 3: cchAndStart |= (size_t)pszCmd[2] << (K_ARCH_BITS - 32); /* fall thru */
+        case 2: cchAndStart |= (size_t)pszCmd[1] << (K_ARCH_BITS - 24); /* fall thru */
+        case 1: cchAndStart |= (size_t)pszCmd[0] << (K_ARCH_BITS - 16); /* fall thru */
+        case 0: break;
+    }
 #else
-        switch (cchAndStart)
-        {
-            default:                                        /* fall thru */
+    switch (cchAndStart)
+    {
+        default:                                        /* fall thru */
 # if K_ARCH_BITS >= 64
-            case 7: cchAndStart |= (size_t)pszCmd[6] << 56; /* fall thru */
-            case 6: cchAndStart |= (size_t)pszCmd[5] << 48; /* fall thru */
-            case 5: cchAndStart |= (size_t)pszCmd[4] << 40; /* fall thru */
-            case 4: cchAndStart |= (size_t)pszCmd[3] << 32; /* fall thru */
+        case 7: cchAndStart |= (size_t)pszCmd[6] << 56; /* fall thru */
+        case 6: cchAndStart |= (size_t)pszCmd[5] << 48; /* fall thru */
+        case 5: cchAndStart |= (size_t)pszCmd[4] << 40; /* fall thru */
+        case 4: cchAndStart |= (size_t)pszCmd[3] << 32; /* fall thru */
 # endif
-            /* fall thru - gcc 8.2.0 is confused by # endif */
-            case 3: cchAndStart |= (size_t)pszCmd[2] << 24; /* fall thru */
-            case 2: cchAndStart |= (size_t)pszCmd[1] << 16; /* fall thru */
-            case 1: cchAndStart |= (size_t)pszCmd[0] <<  8; /* fall thru */
-            case 0: break;
-        }
+        /* fall thru - gcc 8.2.0 is confused by # endif */
+        case 3: cchAndStart |= (size_t)pszCmd[2] << 24; /* fall thru */
+        case 2: cchAndStart |= (size_t)pszCmd[1] << 16; /* fall thru */
+        case 1: cchAndStart |= (size_t)pszCmd[0] <<  8; /* fall thru */
+        case 0: break;
+    }
 #endif
 
-        /*
-         * Look up the builtin command in the table.
-         */
-        pEntry  = &g_aBuiltIns[0];
-        cLeft   = sizeof(g_aBuiltIns) / sizeof(g_aBuiltIns[0]);
-        while (cLeft-- > 0)
-            if (   pEntry->uName.cchAndStart != cchAndStart
-                || (   pEntry->uName.s.cch >= sizeof(cchAndStart)
-                    && memcmp(pEntry->uName.s.sz, pszCmd, pEntry->uName.s.cch) != 0) )
-                pEntry++;
-            else
+    /*
+     * Look up the builtin command in the table.
+     */
+    pEntry  = &g_aBuiltIns[0];
+    cLeft   = sizeof(g_aBuiltIns) / sizeof(g_aBuiltIns[0]);
+    while (cLeft-- > 0)
+        if (   pEntry->uName.cchAndStart != cchAndStart
+            || (   pEntry->uName.s.cch >= sizeof(cchAndStart)
+                && memcmp(pEntry->uName.s.sz, pszCmd, pEntry->uName.s.cch) != 0) )
+            pEntry++;
+        else
+            return pEntry;
+    return NULL;
+}
+
+
+int kmk_builtin_command_parsed(int argc, char **argv, struct child *pChild, char ***ppapszArgvToSpawn, pid_t *pPidSpawned)
+{
+    /*
+     * Check and skip the prefix.
+     */
+    static const char s_szPrefix[] = "kmk_builtin_";
+    const char *pszCmd = argv[0];
+    if (strncmp(pszCmd, s_szPrefix, sizeof(s_szPrefix) - 1) == 0)
+    {
+        struct KMKBUILTINENTRY const *pEntry;
+
+        pszCmd += sizeof(s_szPrefix) - 1;
+        pEntry = kmk_builtin_lookup(pszCmd);
+        if (pEntry)
+        {
+            /*
+             * That's a match!
+             *
+             * First get the environment if it is actually needed.  This is
+             * especially important when we run on a worker thread as it must
+             * not under any circumstances do stuff like target_environment.
+             */
+            int    rc;
+            char **papszEnvVars = NULL;
+            if (pEntry->fNeedEnv)
             {
-                /*
-                 * That's a match!
-                 *
-                 * First get the environment if it is actually needed.  This is
-                 * especially important when we run on a worker thread as it must
-                 * not under any circumstances do stuff like target_environment.
-                 */
-                int    rc;
-                char **papszEnvVars = NULL;
-                if (pEntry->fNeedEnv)
-                {
-                    papszEnvVars = pChild->environment;
-                    if (!papszEnvVars)
-                        pChild->environment = papszEnvVars = target_environment(pChild->file);
-                }
+                papszEnvVars = pChild->environment;
+                if (!papszEnvVars)
+                    pChild->environment = papszEnvVars = target_environment(pChild->file);
+            }
 
 #if defined(KBUILD_OS_WINDOWS) && defined(CONFIG_NEW_WIN_CHILDREN)
-                /*
-                 * If the built-in is multi thread safe, we will run it on a job slot thread.
-                 */
-                if (pEntry->fMtSafe)
-                {
-                    rc = MkWinChildCreateBuiltIn(pEntry, argc, argv, papszEnvVars, pChild, pPidSpawned);
+            /*
+             * If the built-in is multi thread safe, we will run it on a job slot thread.
+             */
+            if (pEntry->fMtSafe)
+            {
+                rc = MkWinChildCreateBuiltIn(pEntry, argc, argv, papszEnvVars, pChild, pPidSpawned);
 # ifdef CONFIG_WITH_KMK_BUILTIN_STATS
-                    g_aBuiltInStats[pEntry - &g_aBuiltIns[0]].cAsyncTimes++;
+                g_aBuiltInStats[pEntry - &g_aBuiltIns[0]].cAsyncTimes++;
 # endif
-                }
-                else
+            }
+            else
 #endif
+#ifdef CONFIG_WITH_KMK_BUILTIN_THREADS
+            /*
+             * Same on POSIX systems, except that built-ins spawning processes
+             * stay on the main thread (redirect changes the CWD and file
+             * descriptors of the process).
+             */
+            if (   pEntry->fMtSafe
+                && pEntry->uFnSignature == FN_SIG_MAIN
+                && pChild
+                && pPidSpawned
+                && kmk_builtin_thread_submit(pEntry, argc, argv, papszEnvVars, pChild, pPidSpawned) == 0)
+            {
+                rc = 0;
+# ifdef CONFIG_WITH_KMK_BUILTIN_STATS
+                g_aBuiltInStats[pEntry - &g_aBuiltIns[0]].cAsyncTimes++;
+# endif
+            }
+            else
+#endif
+            {
+                /*
+                 * Call the worker function, making sure to preserve umask.
+                 */
+#ifdef CONFIG_WITH_KMK_BUILTIN_STATS
+                big_int nsStart = print_stats_flag ? nano_timestamp() : 0;
+#endif
+                KMKBUILTINCTX Ctx;
+#ifdef CONFIG_WITH_KMK_BUILTIN_THREADS
+                int const iUmask = kmk_builtin_thread_umask(NULL); /* save umask */
+#else
+                int const iUmask = umask(0);        /* save umask */
+                umask(iUmask);
+#endif
+
+                Ctx.pszProgName = pEntry->uName.s.sz;
+                Ctx.pOut = pChild ? &pChild->output : NULL;
+#if defined(KBUILD_OS_WINDOWS) || defined(CONFIG_WITH_KMK_BUILTIN_THREADS)
+                Ctx.pvWorker = NULL;
+#endif
+
+                if (pEntry->uFnSignature == FN_SIG_MAIN)
+                    rc = pEntry->u.pfnMain(argc, argv, papszEnvVars, &Ctx);
+                else if (pEntry->uFnSignature == FN_SIG_MAIN_SPAWNS)
+                    rc = pEntry->u.pfnMainSpawns(argc, argv, papszEnvVars, &Ctx, pChild, pPidSpawned);
+                else if (pEntry->uFnSignature == FN_SIG_MAIN_TO_SPAWN)
                 {
                     /*
-                     * Call the worker function, making sure to preserve umask.
+                     * When we got something to execute, check if the child is a kmk_builtin thing.
+                     * We recurse here, both because I'm lazy and because it's easier to debug a
+                     * problem then (the call stack shows what's been going on).
                      */
-#ifdef CONFIG_WITH_KMK_BUILTIN_STATS
-                    big_int nsStart = print_stats_flag ? nano_timestamp() : 0;
-#endif
-                    KMKBUILTINCTX Ctx;
-                    int const iUmask = umask(0);        /* save umask */
-                    umask(iUmask);
-
-                    Ctx.pszProgName = pEntry->uName.s.sz;
-                    Ctx.pOut = pChild ? &pChild->output : NULL;
-
-                    if (pEntry->uFnSignature == FN_SIG_MAIN)
-                        rc = pEntry->u.pfnMain(argc, argv, papszEnvVars, &Ctx);
-                    else if (pEntry->uFnSignature == FN_SIG_MAIN_SPAWNS)
-                        rc = pEntry->u.pfnMainSpawns(argc, argv, papszEnvVars, &Ctx, pChild, pPidSpawned);
-                    else if (pEntry->uFnSignature == FN_SIG_MAIN_TO_SPAWN)
+                    rc = pEntry->u.pfnMainToSpawn(argc, argv, papszEnvVars, &Ctx, ppapszArgvToSpawn);
+                    if (   !rc
+                        && *ppapszArgvToSpawn
+                        && !strncmp(**ppapszArgvToSpawn, s_szPrefix, sizeof(s_szPrefix) - 1))
                     {
-                        /*
-                         * When we got something to execute, check if the child is a kmk_builtin thing.
-                         * We recurse here, both because I'm lazy and because it's easier to debug a
-                         * problem then (the call stack shows what's been going on).
-                         */
-                        rc = pEntry->u.pfnMainToSpawn(argc, argv, papszEnvVars, &Ctx, ppapszArgvToSpawn);
-                        if (   !rc
-                            && *ppapszArgvToSpawn
-                            && !strncmp(**ppapszArgvToSpawn, s_szPrefix, sizeof(s_szPrefix) - 1))
-                        {
-                            char **argv_new = *ppapszArgvToSpawn;
-                            int argc_new = 1;
-                            while (argv_new[argc_new])
-                              argc_new++;
+                        char **argv_new = *ppapszArgvToSpawn;
+                        int argc_new = 1;
+                        while (argv_new[argc_new])
+                          argc_new++;
 
-                            assert(argv_new[0] != argv[0]);
-                            assert(!*pPidSpawned);
+                        assert(argv_new[0] != argv[0]);
+                        assert(!*pPidSpawned);
 
-                            *ppapszArgvToSpawn = NULL;
-                            rc = kmk_builtin_command_parsed(argc_new, argv_new, pChild, ppapszArgvToSpawn, pPidSpawned);
+                        *ppapszArgvToSpawn = NULL;
+                        rc = kmk_builtin_command_parsed(argc_new, argv_new, pChild, ppapszArgvToSpawn, pPidSpawned);
 
-                            free(argv_new[0]);
-                            free(argv_new);
-                        }
+                        free(argv_new[0]);
+                        free(argv_new);
                     }
-                    else
-                        rc = 99;
+                }
+                else
+                    rc = 99;
 
-                    umask(iUmask);                      /* restore it */
+                umask(iUmask);                      /* restore it */
 
 #ifdef CONFIG_WITH_KMK_BUILTIN_STATS
-                    if (print_stats_flag)
-                    {
-                        uintptr_t iEntry = pEntry - &g_aBuiltIns[0];
-                        g_aBuiltInStats[iEntry].cTimes++;
-                        g_aBuiltInStats[iEntry].cNs += nano_timestamp() - nsStart;
-                    }
-#endif
+                if (print_stats_flag)
+                {
+                    uintptr_t iEntry = pEntry - &g_aBuiltIns[0];
+                    g_aBuiltInStats[iEntry].cTimes++;
+                    g_aBuiltInStats[iEntry].cNs += nano_timestamp() - nsStart;
                 }
-                return rc;
+#endif
             }
+            return rc;
+        }
 
         /*
          * No match! :-(
@@ -461,7 +505,183 @@ int kmk_builtin_command_parsed(int argc, char **argv, struct child *pChild, char
     return 1;
 }
 
-#ifndef KBUILD_OS_WINDOWS
+#ifdef CONFIG_WITH_KMK_BUILTIN_SHELL
+/**
+ * Runs a built-in command for $(shell ) on the main thread.
+ *
+ * Only the plain FN_SIG_MAIN commands qualify, the others may want to spawn
+ * processes and need a child structure for that.
+ *
+ * @returns 0 if the command was executed, -1 if it isn't a suitable built-in
+ *          and should be run by the shell instead.
+ * @param   argc        The argument count.
+ * @param   argv        The argument vector, argv[0] is kmk_builtin_xxxx.
+ * @param   pOut        The output buffer to write to.
+ * @param   prcExit     Where to return the exit code of the command.
+ */
+int kmk_builtin_command_for_shell(int argc, char **argv, struct output *pOut, int *prcExit)
+{
+    PCKMKBUILTINENTRY pEntry;
+    KMKBUILTINCTX     Ctx;
+    int               iUmask;
+#ifdef CONFIG_WITH_KMK_BUILTIN_STATS
+    big_int           nsStart;
+#endif
+
+    if (strncmp(argv[0], "kmk_builtin_", sizeof("kmk_builtin_") - 1) != 0)
+        return -1;
+    pEntry = kmk_builtin_lookup(argv[0] + sizeof("kmk_builtin_") - 1);
+    if (!pEntry || pEntry->uFnSignature != FN_SIG_MAIN)
+        return -1;
+
+#ifdef CONFIG_WITH_KMK_BUILTIN_STATS
+    nsStart = print_stats_flag ? nano_timestamp() : 0;
+#endif
+#ifdef CONFIG_WITH_KMK_BUILTIN_THREADS
+    iUmask = kmk_builtin_thread_umask(NULL); /* save umask */
+#else
+    iUmask = umask(0);                  /* save umask */
+    umask(iUmask);
+#endif
+
+    Ctx.pszProgName = pEntry->uName.s.sz;
+    Ctx.pOut = pOut;
+#if defined(KBUILD_OS_WINDOWS) || defined(CONFIG_WITH_KMK_BUILTIN_THREADS)
+    Ctx.pvWorker = NULL;
+#endif
+    *prcExit = pEntry->u.pfnMain(argc, argv, pEntry->fNeedEnv ? environ : NULL, &Ctx);
+
+    umask(iUmask);                      /* restore it */
+
+#ifdef CONFIG_WITH_KMK_BUILTIN_STATS
+    if (print_stats_flag)
+    {
+        uintptr_t iEntry = pEntry - &g_aBuiltIns[0];
+        g_aBuiltInStats[iEntry].cTimes++;
+        g_aBuiltInStats[iEntry].cNs += nano_timestamp() - nsStart;
+    }
+#endif
+    return 0;
+}
+#endif /* CONFIG_WITH_KMK_BUILTIN_SHELL */
+
+#if !defined(KBUILD_OS_WINDOWS) && !defined(KBUILD_OS_OS2)
+
+/**
+ * Gets the next job that completed without any process terminating, that is
+ * a job submitted to a kWorker instance or a built-in command that ran on a
+ * worker thread.
+ *
+ * Called by reap_children() before it waits for child processes.
+ *
+ * @returns The process ID the kmk child was given, 0 if nothing completed.
+ * @param   piStatus            Where to return the wait status.
+ */
+pid_t kmk_builtin_async_reap(int *piStatus)
+{
+    pid_t pid = kSubmitPosixReapJob(piStatus);
+#ifdef CONFIG_WITH_KMK_BUILTIN_THREADS
+    if (pid == 0)
+        pid = kmk_builtin_thread_reap(piStatus);
+#endif
+    return pid;
+}
+
+
+/**
+ * Gets the number of jobs that will complete without a process terminating.
+ *
+ * reap_children() must not block in wait() while there are any.
+ */
+unsigned kmk_builtin_async_busy(void)
+{
+#ifdef CONFIG_WITH_KMK_BUILTIN_THREADS
+    return kSubmitPosixBusyWorkers() + kmk_builtin_thread_busy();
+#else
+    return kSubmitPosixBusyWorkers();
+#endif
+}
+
+
+/**
+ * Adds the descriptors signalling the completion of asynchronous jobs to a
+ * select() read set.
+ *
+ * Built-in commands on worker threads wake up the main thread with a SIGCHLD,
+ * so this is only the connections of busy kWorker instances.
+ *
+ * @returns 0 on success, -1 if some descriptor could not be added and the
+ *          caller has to poll.
+ * @param   pReadFds            The read set.
+ * @param   pfdMax              The highest descriptor in the set (in/out).
+ */
+int kmk_builtin_async_add_fds(fd_set *pReadFds, int *pfdMax)
+{
+    return kSubmitPosixAddBusyFds(pReadFds, pfdMax);
+}
+
+
+/**
+ * Waits for an asynchronous job to complete or a signal (SIGCHLD) to arrive.
+ *
+ * Only called by reap_children() when kmk_builtin_async_busy() is non-zero.
+ * The caller rechecks everything afterwards.
+ */
+void kmk_builtin_async_wait(void)
+{
+    fd_set          ReadFds;
+    int             fdMax = -1;
+    int             fPoll;
+#ifdef HAVE_PSELECT
+    sigset_t        SigMask;
+    struct timespec TimeoutTs = { 0, 50 * 1000 * 1000 };
+#else
+    struct timeval  TimeoutTv = { 0, 50 * 1000 };
+#endif
+
+    FD_ZERO(&ReadFds);
+    fPoll = kmk_builtin_async_add_fds(&ReadFds, &fdMax) != 0;
+
+#ifdef HAVE_PSELECT
+    /* main.c blocks SIGCHLD when pselect is available, so it can be unblocked
+       atomically while waiting and no completion or child exit is missed. */
+    sigprocmask(SIG_BLOCK, NULL, &SigMask);
+    if (sigismember(&SigMask, SIGCHLD) == 1)
+        sigdelset(&SigMask, SIGCHLD);
+    else
+        fPoll = 1;
+    pselect(fdMax + 1, &ReadFds, NULL, NULL, fPoll ? &TimeoutTs : NULL, &SigMask);
+#else
+    /* Without pselect a SIGCHLD may slip in before select is entered. */
+    select(fdMax + 1, &ReadFds, NULL, NULL, &TimeoutTv);
+    (void)fPoll;
+#endif
+}
+
+
+/**
+ * Tells the asynchronous job providers about a process reap_children() reaped.
+ *
+ * @returns 1 if the process belonged to an embedded shell and reap_children()
+ *          should forget about it, 0 if it is a kmk child.
+ * @param   pid                 The process ID.
+ * @param   iStatus             The wait status.
+ */
+int kmk_builtin_child_reaped(pid_t pid, int iStatus)
+{
+#ifdef CONFIG_WITH_KASH_EMBEDDED
+    if (sh_embedded_child_reaped(pid, iStatus))
+        return 1;
+#else
+    (void)iStatus;
+#endif
+    kSubmitPosixChildReaped(pid);
+    return 0;
+}
+
+#endif /* !KBUILD_OS_WINDOWS && !KBUILD_OS_OS2 */
+
+#if !defined(KBUILD_OS_WINDOWS) && !defined(CONFIG_WITH_DIRCACHE)
 /** Dummy. */
 int kmk_builtin_dircache(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
 {
@@ -493,6 +713,13 @@ extern void kmk_builtin_print_stats(FILE *pOutput, const char *pszPrefix)
         else if (g_aBuiltInStats[i].cAsyncTimes > 0)
             fprintf(pOutput, "%s kmk_builtin_%-9s: %4u times in worker thread\n",
                     pszPrefix, g_aBuiltIns[i].uName.s.sz, g_aBuiltInStats[i].cAsyncTimes);
+
+    /* How cp and install got the file data across. */
+    if (  g_acKmkCopyMethods[KMKCOPYMETHOD_CLONE] + g_acKmkCopyMethods[KMKCOPYMETHOD_COPY_FILE_RANGE]
+        + g_acKmkCopyMethods[KMKCOPYMETHOD_SENDFILE] + g_acKmkCopyMethods[KMKCOPYMETHOD_READ_WRITE] > 0)
+        fprintf(pOutput, "%s files copied: %u cloned, %u copy_file_range, %u sendfile, %u read/write\n",
+                pszPrefix, g_acKmkCopyMethods[KMKCOPYMETHOD_CLONE], g_acKmkCopyMethods[KMKCOPYMETHOD_COPY_FILE_RANGE],
+                g_acKmkCopyMethods[KMKCOPYMETHOD_SENDFILE], g_acKmkCopyMethods[KMKCOPYMETHOD_READ_WRITE]);
 }
 #endif
 
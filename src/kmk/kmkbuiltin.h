@@ -32,6 +32,7 @@
 # endif
 #else
 # include <sys/types.h>
+# include <sys/select.h>
 #endif
 #include <fcntl.h>
 #ifdef HAVE_STDINT_H
@@ -80,6 +81,16 @@
 struct child;
 int kmk_builtin_command(const char *pszCmd, struct child *pChild, char ***ppapszArgvToSpawn, pid_t *pPidSpawned);
 int kmk_builtin_command_parsed(int argc, char **argv, struct child *pChild, char ***ppapszArgvToSpawn, pid_t *pPidSpawned);
+#ifdef CONFIG_WITH_KMK_BUILTIN_SHELL
+int kmk_builtin_command_for_shell(int argc, char **argv, struct output *pOut, int *prcExit);
+#endif
+#if !defined(KBUILD_OS_WINDOWS) && !defined(KBUILD_OS_OS2) && !defined(KMK_BUILTIN_STANDALONE) && !defined(KWORKER)
+pid_t kmk_builtin_async_reap(int *piStatus);
+unsigned kmk_builtin_async_busy(void);
+int kmk_builtin_async_add_fds(fd_set *pReadFds, int *pfdMax);
+void kmk_builtin_async_wait(void);
+int kmk_builtin_child_reaped(pid_t pid, int iStatus);
+#endif
 
 
 /**
@@ -91,7 +102,7 @@ typedef struct KMKBUILTINCTX
     const char *pszProgName;
     /** The KMK output synchronizer.   */
     struct output *pOut;
-#if defined(KBUILD_OS_WINDOWS) && !defined(KMK_BUILTIN_STANDALONE)
+#if (defined(KBUILD_OS_WINDOWS) || defined(CONFIG_WITH_KMK_BUILTIN_THREADS)) && !defined(KMK_BUILTIN_STANDALONE)
     /** Pointer to the worker thread, if we're on one. */
     void *pvWorker;
 #endif
@@ -150,12 +161,37 @@ extern int kmk_builtin_rmdir(int argc, char **argv, char **envp, PKMKBUILTINCTX
 extern int kmk_builtin_sleep(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx);
 extern int kmk_builtin_test(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx, char ***ppapszArgvSpawn);
 extern int kmk_builtin_touch(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx);
-#ifdef KBUILD_OS_WINDOWS
+#ifndef KBUILD_OS_OS2
 extern int kmk_builtin_kSubmit(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx, struct child *pChild, pid_t *pPidSpawned);
+#endif
+#ifdef KBUILD_OS_WINDOWS
 extern int kSubmitSubProcGetResult(intptr_t pvUser, int fBlock, int *prcExit, int *piSigNo);
 extern int kSubmitSubProcKill(intptr_t pvUser, int iSignal);
 extern void kSubmitSubProcCleanup(intptr_t pvUser);
+#elif !defined(KBUILD_OS_OS2)
+extern pid_t kSubmitPosixReapJob(int *piStatus);
+extern unsigned kSubmitPosixBusyWorkers(void);
+extern int kSubmitPosixAddBusyFds(fd_set *pReadFds, int *pfdMax);
+extern void kSubmitPosixChildReaped(pid_t pid);
+#endif
+#if defined(CONFIG_WITH_KMK_BUILTIN_THREADS) && !defined(KMK_BUILTIN_STANDALONE)
+/* kmkbuiltin-threads.c: */
+extern int kmk_builtin_thread_submit(PCKMKBUILTINENTRY pBuiltIn, int cArgs, char **papszArgs, char **papszEnv,
+                                     struct child *pMkChild, pid_t *pPid);
+extern pid_t kmk_builtin_thread_reap(int *piStatus);
+extern unsigned kmk_builtin_thread_busy(void);
+extern mode_t kmk_builtin_thread_umask(void *pvWorker);
+# ifdef CONFIG_WITH_KASH_EMBEDDED
+extern int kmk_builtin_thread_submit_shell(int cArgs, char **papszArgs, char **papszEnv, int const *paFds,
+                                           struct child *pMkChild, pid_t *pPid);
+# endif
+#endif
+#if defined(CONFIG_WITH_KASH_EMBEDDED) && !defined(KMK_BUILTIN_STANDALONE)
+/* src/kash (kashembedded library): */
+extern int sh_embedded_main(int argc, char **argv, char **envp, int const *paFds, pid_t pid);
+extern int sh_embedded_child_reaped(pid_t pid, int iStatus);
 #endif
+extern int kmk_builtin_kDepDb(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx);
 extern int kmk_builtin_kDepIDB(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx);
 extern int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx);
 
@@ -86,6 +86,7 @@ static struct option long_options[] =
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
 extern void * bsd_setmode(const char *p);
+extern void * bsd_setmode_umask(const char *p, mode_t mask);
 extern mode_t bsd_getmode(const void *bbox, mode_t omode);
 extern void bsd_strmode(mode_t mode, char *p);
 
@@ -197,7 +198,12 @@ done:	argv += gos.optind;
 		change_mode = chmod;
 
 	mode = *argv;
-	if ((set = bsd_setmode(mode)) == NULL)
+#if defined(CONFIG_WITH_KMK_BUILTIN_THREADS) && !defined(KMK_BUILTIN_STANDALONE)
+	set = bsd_setmode_umask(mode, kmk_builtin_thread_umask(pCtx->pvWorker));
+#else
+	set = bsd_setmode(mode);
+#endif
+	if (set == NULL)
 		return errx(pCtx, 1, "invalid file mode: %s", mode);
 
 	if ((ftsp = fts_open(++argv, fts_options, 0)) == NULL)
@@ -444,8 +444,15 @@ copy(CPINSTANCE *pThis, char * const *argv, enum op type, int fts_options)
 	 * Keep an inverted copy of the umask, for use in correcting
 	 * permissions on created directories when not using -p.
 	 */
-	mask = ~umask(0777);
-	umask(~mask);
+#if defined(CONFIG_WITH_KMK_BUILTIN_THREADS) && !defined(KMK_BUILTIN_STANDALONE)
+	if (pThis->Utils.pCtx->pvWorker) /* must not touch the umask on a worker thread */
+		mask = ~kmk_builtin_thread_umask(pThis->Utils.pCtx->pvWorker);
+	else
+#endif
+	{
+		mask = ~umask(0777);
+		umask(~mask);
+	}
 
 	if ((ftsp = fts_open(argv, fts_options, mastercmp)) == NULL)
 		return err(pThis->Utils.pCtx, 1, "fts_open");
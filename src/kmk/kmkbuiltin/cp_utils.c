@@ -73,6 +73,7 @@ __FBSDID("$FreeBSD: src/bin/cp/utils.c,v 1.43 2004/04/06 20:06:44 markm Exp $");
 #endif
 #include "cp_extern.h"
 #include "cmp_extern.h"
+#include "fastcopy.h"
 
 
 /*********************************************************************************************************************************
@@ -97,7 +98,7 @@ copy_file(CPUTILSINSTANCE *pThis, const FTSENT *entp, int dne, int changed_only,
 {
 	/*static*/ char buf[MAXBSIZE];
 	struct stat *fs;
-	int ch, checkch, from_fd, rcount, rval, to_fd;
+	int ch, checkch, from_fd, rcount, rval, to_fd, fastrc;
 	ssize_t wcount;
 	size_t wresid;
 	size_t wtotal;
@@ -181,6 +182,15 @@ copy_file(CPUTILSINSTANCE *pThis, const FTSENT *entp, int dne, int changed_only,
 	rval = 0;
 	*pcopied = 1;
 
+	/*
+	 * Let the kernel clone or copy the data if it can.
+	 */
+	if ((fastrc = kmk_fast_copy(from_fd, to_fd)) <= 0) {
+		if (fastrc < 0) {
+			warn(pThis->pCtx, "copy: %s -> %s", entp->fts_path, pThis->to.p_path);
+			rval = 1;
+		}
+	} else
 	/*
 	 * Mmap and write if less than 8M (the limit is so we don't totally
 	 * trash memory on big files.  This is really a minor hack, but it
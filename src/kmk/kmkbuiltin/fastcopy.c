@@ -0,0 +1,175 @@
+/* $Id$ */
+/** @file
+ * Copying file data without going thru a user buffer.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "config.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#ifdef __linux__
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/sendfile.h>
+# include <sys/syscall.h>
+# include <linux/fs.h>
+#endif
+#include "fastcopy.h"
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The max number of bytes to ask the kernel to copy per call. */
+#define KMK_FAST_COPY_CHUNK     0x40000000
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+unsigned volatile g_acKmkCopyMethods[KMKCOPYMETHOD_MAX];
+
+
+/**
+ * Counts a file copied using the given method.
+ *
+ * @param   enmMethod   The method.
+ */
+void kmk_copy_method_count(KMKCOPYMETHOD enmMethod)
+{
+#ifdef __GNUC__
+    __sync_fetch_and_add(&g_acKmkCopyMethods[enmMethod], 1);
+#else
+    g_acKmkCopyMethods[enmMethod]++;
+#endif
+}
+
+
+#ifdef __linux__
+/**
+ * Checks if a kernel copy call failing before having copied anything means
+ * that it cannot handle this pair of files (rather than an I/O error).
+ */
+static int kmk_fast_copy_is_unsupported(int iErr)
+{
+    return iErr == ENOSYS
+        || iErr == EXDEV
+        || iErr == EINVAL
+        || iErr == EOPNOTSUPP
+        || iErr == EBADF
+        || iErr == EPERM
+        || iErr == ETXTBSY;
+}
+#endif
+
+
+/**
+ * Copies all the data of @a from_fd into @a to_fd without going thru a user
+ * buffer, if the OS and file systems allow it.
+ *
+ * This tries cloning the file (FICLONE, which is practically free on btrfs,
+ * xfs and friends), then copy_file_range() and then sendfile().  Both file
+ * offsets must be zero and the destination file must be empty.
+ *
+ * @returns 0 if all the data was copied.
+ * @returns 1 if the caller should copy the data itself (nothing was copied).
+ *          This is counted as a read/write copy.
+ * @returns -1 and errno on I/O error.
+ * @param   from_fd     The source file, must be a regular file to get
+ *                      anywhere.
+ * @param   to_fd       The destination file.
+ */
+int kmk_fast_copy(int from_fd, int to_fd)
+{
+#ifdef __linux__
+    struct stat st;
+    long long cbDone;
+    ssize_t cb;
+
+    /* Leave empty and special files to the caller (procfs & sysfs files
+       claim to be empty and the kernel won't copy those). */
+    if (fstat(from_fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        goto l_read_write;
+
+# ifdef FICLONE
+    if (ioctl(to_fd, FICLONE, from_fd) == 0)
+    {
+        kmk_copy_method_count(KMKCOPYMETHOD_CLONE);
+        return 0;
+    }
+# endif
+
+# ifdef __NR_copy_file_range
+    cbDone = 0;
+    for (;;)
+    {
+        cb = syscall(__NR_copy_file_range, from_fd, NULL, to_fd, NULL, (size_t)KMK_FAST_COPY_CHUNK, 0);
+        if (cb > 0)
+            cbDone += cb;
+        else if (cb == 0)
+        {
+            if (!cbDone)
+                goto l_read_write;
+            kmk_copy_method_count(KMKCOPYMETHOD_COPY_FILE_RANGE);
+            return 0;
+        }
+        else if (errno != EINTR)
+        {
+            if (cbDone || !kmk_fast_copy_is_unsupported(errno))
+                return -1;
+            break;
+        }
+    }
+# endif
+
+    cbDone = 0;
+    for (;;)
+    {
+        cb = sendfile(to_fd, from_fd, NULL, KMK_FAST_COPY_CHUNK);
+        if (cb > 0)
+            cbDone += cb;
+        else if (cb == 0)
+        {
+            if (!cbDone)
+                break;
+            kmk_copy_method_count(KMKCOPYMETHOD_SENDFILE);
+            return 0;
+        }
+        else if (errno != EINTR)
+        {
+            if (cbDone || !kmk_fast_copy_is_unsupported(errno))
+                return -1;
+            break;
+        }
+    }
+
+l_read_write:
+#else
+    (void)from_fd; (void)to_fd;
+#endif
+    kmk_copy_method_count(KMKCOPYMETHOD_READ_WRITE);
+    return 1;
+}
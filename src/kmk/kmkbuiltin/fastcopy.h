@@ -0,0 +1,53 @@
+/* $Id$ */
+/** @file
+ * Copying file data without going thru a user buffer.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef ___fastcopy_h
+#define ___fastcopy_h
+
+
+/**
+ * The ways the data of a file can be copied.
+ */
+typedef enum
+{
+    KMKCOPYMETHOD_FIRST = 0,
+    /** Sharing the extents (FICLONE, a.k.a. reflink). */
+    KMKCOPYMETHOD_CLONE = KMKCOPYMETHOD_FIRST,
+    /** copy_file_range(). */
+    KMKCOPYMETHOD_COPY_FILE_RANGE,
+    /** sendfile(). */
+    KMKCOPYMETHOD_SENDFILE,
+    /** read() and write() thru a buffer (or mmap and write). */
+    KMKCOPYMETHOD_READ_WRITE,
+    KMKCOPYMETHOD_MAX
+} KMKCOPYMETHOD;
+
+/** Number of files copied using each method, for the statistics. */
+extern unsigned volatile g_acKmkCopyMethods[KMKCOPYMETHOD_MAX];
+
+int  kmk_fast_copy(int from_fd, int to_fd);
+void kmk_copy_method_count(KMKCOPYMETHOD enmMethod);
+
+#endif
@@ -92,9 +92,11 @@ __FBSDID("$FreeBSD: src/usr.bin/xinstall/xinstall.c,v 1.66 2005/01/25 14:34:57 s
 #include "kmkbuiltin.h"
 #include "k/kDefs.h"	/* for K_OS */
 #include "dos2unix.h"
+#include "fastcopy.h"
 
 
 extern void * bsd_setmode(const char *p);
+extern void * bsd_setmode_umask(const char *p, mode_t mask);
 extern mode_t bsd_getmode(const void *bbox, mode_t omode);
 
 #ifndef MAXBSIZE
@@ -242,7 +244,12 @@ kmk_builtin_install(int argc, char *argv[], char ** envp, PKMKBUILTINCTX pCtx)
 			This.nommap = 1;
 			break;
                 case 'm':
-			if (!(set = bsd_setmode(gos.optarg)))
+#if defined(CONFIG_WITH_KMK_BUILTIN_THREADS) && !defined(KMK_BUILTIN_STANDALONE)
+			set = bsd_setmode_umask(gos.optarg, kmk_builtin_thread_umask(pCtx->pvWorker));
+#else
+			set = bsd_setmode(gos.optarg);
+#endif
+			if (!set)
 				return errx(pCtx, EX_USAGE, "invalid file mode: %s", gos.optarg);
 			This.mode = bsd_getmode(set, 0);
 			free(set);
@@ -969,8 +976,13 @@ copy(PINSTALLINSTANCE pThis, int from_fd, const char *from_name, int *ptr_to_fd,
 
 	if (pThis->dos2unix == 0) {
 		/*
-		 * Copy bytes, no conversion.
+		 * Copy bytes, no conversion.  Let the kernel do it if it can.
 		 */
+		nr = kmk_fast_copy(from_fd, to_fd);
+		if (nr == 0)
+			return EX_OK;
+		if (nr < 0)
+			return write_error(pThis, ptr_to_fd, to_name, -1);
 		while ((nr = read(from_fd, buf, sizeof(buf))) > 0)
 			if ((nw = write(to_fd, buf, nr)) != nr)
 				return write_error(pThis, ptr_to_fd, to_name, nw);
@@ -978,6 +990,7 @@ copy(PINSTALLINSTANCE pThis, int from_fd, const char *from_name, int *ptr_to_fd,
 		/*
 		 * CRLF -> LF is a reduction, so we can work with full buffers.
 		 */
+		kmk_copy_method_count(KMKCOPYMETHOD_READ_WRITE);
 		while ((nr = read(from_fd, buf, sizeof(buf))) > 0) {
 			if (   fPendingCr
 				&& buf[0] != '\n'
@@ -1000,6 +1013,7 @@ copy(PINSTALLINSTANCE pThis, int from_fd, const char *from_name, int *ptr_to_fd,
 		 *       valid DOS text, but no round-trip conversion.
 		 */
 		char * const pchSrc = &buf[sizeof(buf) / 2];
+		kmk_copy_method_count(KMKCOPYMETHOD_READ_WRITE);
 		while ((nr = read(from_fd, pchSrc, sizeof(buf) / 2)) > 0) {
 			if (   fPendingCr
 				&& pchSrc[0] != '\n'
@@ -0,0 +1,449 @@
+/* $Id$ */
+/** @file
+ * kDepDb - Dependency database maintenance.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * This file is part of kBuild.
+ *
+ * kBuild is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * kBuild is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kBuild.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#if !defined(_MSC_VER)
+# include <unistd.h>
+#else
+# include <io.h>
+#endif
+#include "../kdepdb.h"
+#include "err.h"
+#include "kmkbuiltin.h"
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * State for kDepDbDumpCallback.
+ */
+typedef struct KDEPDBDUMP
+{
+    PKMKBUILTINCTX  pCtx;
+    /** Set if we've printed a target which hasn't been terminated yet. */
+    int             fPendingTarget;
+} KDEPDBDUMP;
+
+
+/**
+ * Reads a whole file into a zero terminated heap buffer.
+ *
+ * @returns Pointer to the buffer on success, NULL on failure (error shown).
+ * @param   pCtx        The command execution context.
+ * @param   pszFile     The file to read.
+ */
+static char *kDepDbReadFile(PKMKBUILTINCTX pCtx, const char *pszFile)
+{
+    char   *pszBuf = NULL;
+    long    cbFile;
+    FILE   *pFile = fopen(pszFile, "rb" KMK_FOPEN_NO_INHERIT_MODE);
+    if (!pFile)
+    {
+        err(pCtx, 1, "Failed to open '%s'", pszFile);
+        return NULL;
+    }
+    if (    fseek(pFile, 0, SEEK_END) == 0
+        &&  (cbFile = ftell(pFile)) >= 0
+        &&  fseek(pFile, 0, SEEK_SET) == 0)
+    {
+        pszBuf = (char *)malloc(cbFile + 1);
+        if (pszBuf)
+        {
+            if (cbFile == 0 || fread(pszBuf, cbFile, 1, pFile) == 1)
+                pszBuf[cbFile] = '\0';
+            else
+            {
+                err(pCtx, 1, "Error reading '%s'", pszFile);
+                free(pszBuf);
+                pszBuf = NULL;
+            }
+        }
+        else
+            errx(pCtx, 1, "Out of memory reading '%s'", pszFile);
+    }
+    else
+        err(pCtx, 1, "Failed to determin the size of '%s'", pszFile);
+    fclose(pFile);
+    return pszBuf;
+}
+
+
+/**
+ * Splits a string into words, terminating each of them.
+ *
+ * @returns Number of words, -1 if out of memory.
+ * @param   psz         The string, will be modified.
+ * @param   ppapsz      Where to return the heap array of word pointers.
+ */
+static int kDepDbSplitWords(char *psz, const char ***ppapsz)
+{
+    const char **papsz = NULL;
+    int          cAlloc = 0;
+    int          c = 0;
+    for (;;)
+    {
+        while (isspace((unsigned char)*psz))
+            psz++;
+        if (!*psz)
+            break;
+        if (c >= cAlloc)
+        {
+            void *pvNew = realloc((void *)papsz, (cAlloc = cAlloc ? cAlloc * 2 : 16) * sizeof(papsz[0]));
+            if (!pvNew)
+            {
+                free((void *)papsz);
+                return -1;
+            }
+            papsz = (const char **)pvNew;
+        }
+        papsz[c++] = psz;
+        while (*psz && !isspace((unsigned char)*psz))
+            psz++;
+        if (*psz)
+            *psz++ = '\0';
+    }
+    *ppapsz = papsz;
+    return c;
+}
+
+
+/**
+ * Imports a dependency file.
+ *
+ * Only the simple 'target [target2...]: deps' format that the compilers and
+ * the kDep tools produce is understood.  Files with anything fancier (variable
+ * references, assignments, double colon rules, commands) are skipped so
+ * includedep will continue to read them.
+ *
+ * @returns 0 on success, 1 on failure, -1 if the file was skipped.
+ * @param   pCtx        The command execution context.
+ * @param   pDb         The database.
+ * @param   pszFile     The dependency file, also used as entry name.
+ */
+static int kDepDbImportFile(PKMKBUILTINCTX pCtx, PKDEPDB pDb, const char *pszFile)
+{
+    KDEPDBRULE     *paRules = NULL;
+    unsigned        cRules = 0;
+    unsigned        cRulesAlloc = 0;
+    const char   ***papapszToFree = NULL;
+    unsigned        cToFree = 0;
+    int             rcRet = 0;
+    char           *pszLine;
+    char           *pszBuf = kDepDbReadFile(pCtx, pszFile);
+    char           *psz;
+    unsigned        i;
+    if (!pszBuf)
+        return 1;
+
+    /*
+     * Join continuation lines.
+     */
+    for (psz = pszBuf; (psz = strchr(psz, '\\')) != NULL; psz++)
+        if (psz[1] == '\n')
+            psz[0] = psz[1] = ' ';
+        else if (psz[1] == '\r' && psz[2] == '\n')
+            psz[0] = psz[1] = psz[2] = ' ';
+
+    /*
+     * Process the lines.
+     */
+    for (pszLine = pszBuf; pszLine && !rcRet; pszLine = psz)
+    {
+        const char **papszTargets;
+        const char **papszDeps;
+        char        *pszColon;
+        int          cTargets;
+        int          cDeps;
+
+        psz = strchr(pszLine, '\n');
+        if (psz)
+            *psz++ = '\0';
+        if (*pszLine == '\t') /* commands */
+        {
+            rcRet = -1;
+            break;
+        }
+        pszColon = strchr(pszLine, '#');
+        if (pszColon)
+            *pszColon = '\0';
+        while (isspace((unsigned char)*pszLine))
+            pszLine++;
+        if (!*pszLine)
+            continue;
+
+        /* Find the colon separating targets and dependencies, skipping DOS drive letters. */
+        pszColon = pszLine;
+        while ((pszColon = strchr(pszColon, ':')) != NULL)
+            if (!pszColon[1] || isspace((unsigned char)pszColon[1]) || pszColon[1] == ':' || pszColon[1] == '=')
+                break;
+            else
+                pszColon++;
+        if (   !pszColon
+            || pszColon[1] == ':'
+            || pszColon[1] == '='
+            || strchr(pszLine, '$')
+            || strchr(pszLine, '='))
+        {
+            rcRet = -1;
+            break;
+        }
+        *pszColon = '\0';
+
+        /* Split it up. */
+        cTargets = kDepDbSplitWords(pszLine, &papszTargets);
+        if (cTargets <= 0)
+        {
+            rcRet = cTargets < 0 ? errx(pCtx, 1, "Out of memory") : -1;
+            break;
+        }
+        cDeps = kDepDbSplitWords(pszColon + 1, &papszDeps);
+        if (cDeps < 0)
+        {
+            free((void *)papszTargets);
+            rcRet = errx(pCtx, 1, "Out of memory");
+            break;
+        }
+
+        /* Add the rules. */
+        if (cRules + cTargets > cRulesAlloc)
+        {
+            void *pvNew1 = realloc(paRules, (cRulesAlloc = cRules + cTargets + 64) * sizeof(paRules[0]));
+            void *pvNew2 = realloc((void *)papapszToFree, (cRulesAlloc * 2 + 2) * sizeof(papapszToFree[0]));
+            if (pvNew1)
+                paRules = (KDEPDBRULE *)pvNew1;
+            if (pvNew2)
+                papapszToFree = (const char ***)pvNew2;
+            if (!pvNew1 || !pvNew2)
+            {
+                free((void *)papszTargets);
+                free((void *)papszDeps);
+                rcRet = errx(pCtx, 1, "Out of memory");
+                break;
+            }
+        }
+        papapszToFree[cToFree++] = papszTargets;
+        papapszToFree[cToFree++] = papszDeps;
+        for (i = 0; i < (unsigned)cTargets; i++, cRules++)
+        {
+            paRules[cRules].pszTarget = papszTargets[i];
+            paRules[cRules].cDeps     = cDeps;
+            paRules[cRules].papszDeps = papszDeps;
+        }
+    }
+
+    /*
+     * Store it.
+     */
+    if (!rcRet)
+    {
+        int rc = kDepDbPut(pDb, pszFile, paRules, cRules);
+        if (rc)
+            rcRet = errx(pCtx, 1, "Failed to store '%s': %s", pszFile, strerror(rc));
+    }
+
+    for (i = 0; i < cToFree; i++)
+        free((void *)papapszToFree[i]);
+    free((void *)papapszToFree);
+    free(paRules);
+    free(pszBuf);
+    return rcRet;
+}
+
+
+/**
+ * kDepDbQuery callback that prints the rules in makefile format.
+ */
+static void kDepDbDumpCallback(void *pvUser, int fTarget, const char *pszName, unsigned cchName)
+{
+    KDEPDBDUMP *pState = (KDEPDBDUMP *)pvUser;
+    if (fTarget)
+    {
+        if (pState->fPendingTarget)
+            kmk_builtin_ctx_printf(pState->pCtx, 0, "\n\n");
+        kmk_builtin_ctx_printf(pState->pCtx, 0, "%.*s:", (int)cchName, pszName);
+        pState->fPendingTarget = 1;
+    }
+    else
+        kmk_builtin_ctx_printf(pState->pCtx, 0, " \\\n\t%.*s", (int)cchName, pszName);
+}
+
+
+/**
+ * Dumps one entry.
+ *
+ * @returns 0 on success, 1 on failure.
+ * @param   pCtx        The command execution context.
+ * @param   pDb         The database.
+ * @param   pszName     The entry name.
+ * @param   cchName     The length of the name.
+ */
+static int kDepDbDumpOne(PKMKBUILTINCTX pCtx, PKDEPDB pDb, const char *pszName, unsigned cchName)
+{
+    KDEPDBDUMP  State;
+    int         rc;
+
+    State.pCtx = pCtx;
+    State.fPendingTarget = 0;
+    kmk_builtin_ctx_printf(pCtx, 0, "# %.*s\n", (int)cchName, pszName);
+    rc = kDepDbQuery(pDb, pszName, cchName, 0 /*nsNotBefore*/, kDepDbDumpCallback, &State);
+    if (State.fPendingTarget)
+        kmk_builtin_ctx_printf(pCtx, 0, "\n\n");
+    if (rc)
+        return errx(pCtx, 1, "Failed to query '%.*s': %s", (int)cchName, pszName, strerror(rc));
+    return 0;
+}
+
+
+/**
+ * kDepDbEnum callback for dumping everything.
+ */
+static int kDepDbDumpEnumCallback(PKDEPDB pDb, void *pvUser, const char *pszName, unsigned cchName)
+{
+    return kDepDbDumpOne((PKMKBUILTINCTX)pvUser, pDb, pszName, cchName);
+}
+
+
+static int kDepDbUsage(PKMKBUILTINCTX pCtx, int fIsErr)
+{
+    kmk_builtin_ctx_printf(pCtx, fIsErr,
+                           "usage: %s <database> import [-r] <depfile> [..]\n"
+                           "   or: %s <database> delete <depfile> [..]\n"
+                           "   or: %s <database> dump [depfile [..]]\n"
+                           "   or: %s --help\n"
+                           "   or: %s --version\n"
+                           "\n"
+                           "The database entries are named after the dependency files they replace,\n"
+                           "so setting KMK_DEPDB=<database> makes includedep use them instead of\n"
+                           "reading the files.  The import -r option removes the imported files.\n",
+                           pCtx->pszProgName, pCtx->pszProgName, pCtx->pszProgName,
+                           pCtx->pszProgName, pCtx->pszProgName);
+    return fIsErr ? 2 : 0;
+}
+
+
+int kmk_builtin_kDepDb(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
+{
+    const char *pszDb;
+    const char *pszCmd;
+    PKDEPDB     pDb;
+    int         fRemove = 0;
+    int         rcExit = 0;
+    int         rc;
+    int         i;
+    (void)envp;
+
+    /*
+     * Parse the arguments.
+     */
+    if (argc <= 1)
+        return kDepDbUsage(pCtx, 1);
+    if (!strcmp(argv[1], "--help") || !strcmp(argv[1], "-h") || !strcmp(argv[1], "-?"))
+        return kDepDbUsage(pCtx, 0);
+    if (!strcmp(argv[1], "--version") || !strcmp(argv[1], "-V"))
+        return kbuild_version(argv[0]);
+    if (argc < 3)
+        return kDepDbUsage(pCtx, 1);
+    pszDb  = argv[1];
+    pszCmd = argv[2];
+    i = 3;
+    if (!strcmp(pszCmd, "import"))
+        for (; i < argc && argv[i][0] == '-'; i++)
+        {
+            if (!strcmp(argv[i], "--"))
+            {
+                i++;
+                break;
+            }
+            if (strcmp(argv[i], "-r") && strcmp(argv[i], "--remove"))
+            {
+                errx(pCtx, 2, "Invalid import option '%s'.", argv[i]);
+                return kDepDbUsage(pCtx, 1);
+            }
+            fRemove = 1;
+        }
+    else if (strcmp(pszCmd, "delete") && strcmp(pszCmd, "dump"))
+    {
+        errx(pCtx, 2, "Unknown command '%s'.", pszCmd);
+        return kDepDbUsage(pCtx, 1);
+    }
+
+    /*
+     * Open the database and execute the command.
+     */
+    rc = kDepDbOpen(&pDb, pszDb, strcmp(pszCmd, "dump") != 0 /* fWrite */);
+    if (rc)
+        return errx(pCtx, 1, "Failed to open the dependency database '%s': %s", pszDb, strerror(rc));
+
+    if (!strcmp(pszCmd, "import"))
+        for (; i < argc; i++)
+        {
+            rc = kDepDbImportFile(pCtx, pDb, argv[i]);
+            if (rc > 0)
+                rcExit = 1;
+            else if (rc < 0)
+                warnx(pCtx, "Skipping '%s' as it isn't a plain dependency file.", argv[i]);
+            else if (fRemove && unlink(argv[i]) != 0)
+                rcExit = err(pCtx, 1, "Failed to remove '%s'", argv[i]);
+        }
+    else if (!strcmp(pszCmd, "delete"))
+        for (; i < argc; i++)
+        {
+            rc = kDepDbDelete(pDb, argv[i]);
+            if (rc && rc != ENOENT)
+                rcExit = errx(pCtx, 1, "Failed to delete '%s': %s", argv[i], strerror(rc));
+        }
+    else if (i < argc)
+        for (; i < argc; i++)
+            rcExit |= kDepDbDumpOne(pCtx, pDb, argv[i], (unsigned)strlen(argv[i]));
+    else
+    {
+        rc = kDepDbEnum(pDb, kDepDbDumpEnumCallback, pCtx);
+        if (rc > 1)
+            rcExit = errx(pCtx, 1, "Failed to enumerate '%s': %s", pszDb, strerror(rc));
+        else if (rc)
+            rcExit = 1;
+    }
+
+    kDepDbClose(pDb);
+    return rcExit;
+}
+
+#ifdef KMK_BUILTIN_STANDALONE
+int main(int argc, char **argv, char **envp)
+{
+    KMKBUILTINCTX Ctx = { "kDepDb", NULL };
+    return kmk_builtin_kDepDb(argc, argv, envp, &Ctx);
+}
+#endif
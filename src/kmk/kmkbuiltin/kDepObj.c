@@ -75,6 +75,78 @@ typedef intptr_t ssize_t;
 #define KDEPOMF_LINNUM32        0x95
 /** @} */
 
+/** @name ELF defines
+ * @{ */
+#define KDEPELF_EI_CLASS        4
+#define KDEPELF_EI_DATA         5
+#define KDEPELF_EI_VERSION      6
+#define KDEPELF_ELFCLASS32      1
+#define KDEPELF_ELFCLASS64      2
+#define KDEPELF_ELFDATA2LSB     1
+#define KDEPELF_ELFDATA2MSB     2
+#define KDEPELF_SHN_XINDEX      0xffff
+#define KDEPELF_SHT_SYMTAB      2
+#define KDEPELF_SHT_RELA        4
+#define KDEPELF_SHT_NOBITS      8
+#define KDEPELF_SHT_REL         9
+#define KDEPELF_SHF_COMPRESSED  0x800
+/** @} */
+
+/** @name DWARF defines (line number program header and compilation unit DIE)
+ * @{ */
+#define KDEPDW_LNCT_PATH            0x1
+#define KDEPDW_LNCT_DIRECTORY_INDEX 0x2
+#define KDEPDW_AT_STMT_LIST     0x10
+#define KDEPDW_AT_COMP_DIR      0x1b
+#define KDEPDW_FORM_ADDR        0x01
+#define KDEPDW_FORM_BLOCK2      0x03
+#define KDEPDW_FORM_BLOCK4      0x04
+#define KDEPDW_FORM_DATA2       0x05
+#define KDEPDW_FORM_DATA4       0x06
+#define KDEPDW_FORM_DATA8       0x07
+#define KDEPDW_FORM_STRING      0x08
+#define KDEPDW_FORM_BLOCK       0x09
+#define KDEPDW_FORM_BLOCK1      0x0a
+#define KDEPDW_FORM_DATA1       0x0b
+#define KDEPDW_FORM_FLAG        0x0c
+#define KDEPDW_FORM_SDATA       0x0d
+#define KDEPDW_FORM_STRP        0x0e
+#define KDEPDW_FORM_UDATA       0x0f
+#define KDEPDW_FORM_REF_ADDR    0x10
+#define KDEPDW_FORM_REF1        0x11
+#define KDEPDW_FORM_REF2        0x12
+#define KDEPDW_FORM_REF4        0x13
+#define KDEPDW_FORM_REF8        0x14
+#define KDEPDW_FORM_REF_UDATA   0x15
+#define KDEPDW_FORM_INDIRECT    0x16
+#define KDEPDW_FORM_SEC_OFFSET  0x17
+#define KDEPDW_FORM_EXPRLOC     0x18
+#define KDEPDW_FORM_FLAG_PRESENT 0x19
+#define KDEPDW_FORM_STRX        0x1a
+#define KDEPDW_FORM_ADDRX       0x1b
+#define KDEPDW_FORM_REF_SUP4    0x1c
+#define KDEPDW_FORM_STRP_SUP    0x1d
+#define KDEPDW_FORM_DATA16      0x1e
+#define KDEPDW_FORM_LINE_STRP   0x1f
+#define KDEPDW_FORM_REF_SIG8    0x20
+#define KDEPDW_FORM_IMPLICIT_CONST 0x21
+#define KDEPDW_FORM_LOCLISTX    0x22
+#define KDEPDW_FORM_RNGLISTX    0x23
+#define KDEPDW_FORM_REF_SUP8    0x24
+#define KDEPDW_FORM_STRX1       0x25
+#define KDEPDW_FORM_STRX2       0x26
+#define KDEPDW_FORM_STRX3       0x27
+#define KDEPDW_FORM_STRX4       0x28
+#define KDEPDW_FORM_ADDRX1      0x29
+#define KDEPDW_FORM_ADDRX2      0x2a
+#define KDEPDW_FORM_ADDRX3      0x2b
+#define KDEPDW_FORM_ADDRX4      0x2c
+#define KDEPDW_FORM_GNU_ADDR_INDEX 0x1f01
+#define KDEPDW_FORM_GNU_STR_INDEX  0x1f02
+#define KDEPDW_FORM_GNU_REF_ALT    0x1f20
+#define KDEPDW_FORM_GNU_STRP_ALT   0x1f21
+/** @} */
+
 
 /*******************************************************************************
 *   Structures and Typedefs                                                    *
@@ -169,6 +241,189 @@ typedef const KDEPCV8SYMHDR *PCKDEPCV8SYMHDR;
 #pragma pack()
 /** @} */
 
+
+/** @name ELF Structures
+ * @{ */
+/** ELF header, 32-bit. */
+typedef struct KDEPELF32EHDR
+{
+    KU8         e_ident[16];
+    KU16        e_type;
+    KU16        e_machine;
+    KU32        e_version;
+    KU32        e_entry;
+    KU32        e_phoff;
+    KU32        e_shoff;
+    KU32        e_flags;
+    KU16        e_ehsize;
+    KU16        e_phentsize;
+    KU16        e_phnum;
+    KU16        e_shentsize;
+    KU16        e_shnum;
+    KU16        e_shstrndx;
+} KDEPELF32EHDR;
+
+/** ELF header, 64-bit. */
+typedef struct KDEPELF64EHDR
+{
+    KU8         e_ident[16];
+    KU16        e_type;
+    KU16        e_machine;
+    KU32        e_version;
+    KU64        e_entry;
+    KU64        e_phoff;
+    KU64        e_shoff;
+    KU32        e_flags;
+    KU16        e_ehsize;
+    KU16        e_phentsize;
+    KU16        e_phnum;
+    KU16        e_shentsize;
+    KU16        e_shnum;
+    KU16        e_shstrndx;
+} KDEPELF64EHDR;
+
+/** Section header, 32-bit. */
+typedef struct KDEPELF32SHDR
+{
+    KU32        sh_name;
+    KU32        sh_type;
+    KU32        sh_flags;
+    KU32        sh_addr;
+    KU32        sh_offset;
+    KU32        sh_size;
+    KU32        sh_link;
+    KU32        sh_info;
+    KU32        sh_addralign;
+    KU32        sh_entsize;
+} KDEPELF32SHDR;
+
+/** Section header, 64-bit. */
+typedef struct KDEPELF64SHDR
+{
+    KU32        sh_name;
+    KU32        sh_type;
+    KU64        sh_flags;
+    KU64        sh_addr;
+    KU64        sh_offset;
+    KU64        sh_size;
+    KU32        sh_link;
+    KU32        sh_info;
+    KU64        sh_addralign;
+    KU64        sh_entsize;
+} KDEPELF64SHDR;
+
+/** Symbol table entry, 32-bit. */
+typedef struct KDEPELF32SYM
+{
+    KU32        st_name;
+    KU32        st_value;
+    KU32        st_size;
+    KU8         st_info;
+    KU8         st_other;
+    KU16        st_shndx;
+} KDEPELF32SYM;
+
+/** Symbol table entry, 64-bit. */
+typedef struct KDEPELF64SYM
+{
+    KU32        st_name;
+    KU8         st_info;
+    KU8         st_other;
+    KU16        st_shndx;
+    KU64        st_value;
+    KU64        st_size;
+} KDEPELF64SYM;
+
+/** Section header, converted to host format and bitness. */
+typedef struct KDEPELFSECT
+{
+    /** The section name (points into the file, may be NULL). */
+    const char *pszName;
+    KU32        uType;
+    KU64        fFlags;
+    KU64        offFile;
+    KU64        cb;
+    KU32        uLink;
+    KU32        uInfo;
+    KU64        cbEntry;
+} KDEPELFSECT;
+typedef KDEPELFSECT *PKDEPELFSECT;
+typedef const KDEPELFSECT *PCKDEPELFSECT;
+
+/** Relocation of a .debug_line field, converted to host format. */
+typedef struct KDEPELFRELOC
+{
+    /** Offset into the section of the field being fixed up. */
+    KU64        off;
+    /** The symbol value plus the explicit addend (RELA only). */
+    KU64        uValue;
+    /** Set if the field content is an implicit addend (REL). */
+    KBOOL       fAddField;
+} KDEPELFRELOC;
+typedef KDEPELFRELOC *PKDEPELFRELOC;
+typedef const KDEPELFRELOC *PCKDEPELFRELOC;
+
+/** ELF parser state. */
+typedef struct KDEPELF
+{
+    const KU8          *pbFile;
+    KSIZE               cbFile;
+    /** Set if the file is big endian. */
+    KBOOL               fBigEndian;
+    /** Set if the file is 64-bit. */
+    KBOOL               f64Bit;
+    /** Converted section headers. */
+    PKDEPELFSECT        paSects;
+    KU32                cSects;
+    /** The .debug_str section (DW_FORM_strp), NULL if not present. */
+    PCKDEPELFSECT       pDebugStr;
+    /** The .debug_line_str section (DW_FORM_line_strp), NULL if not present. */
+    PCKDEPELFSECT       pDebugLineStr;
+    /** The .debug_abbrev section, NULL if not present. */
+    PCKDEPELFSECT       pDebugAbbrev;
+    /** Relocations for the .debug_info or .debug_line section being parsed,
+     * sorted by offset. */
+    PKDEPELFRELOC       paRelocs;
+    KSIZE               cRelocs;
+    /** The compilation directories of the compilation units, for resolving
+     * the relative paths in DWARF 2 thru 4 line number program headers. */
+    struct KDEPDWCOMPDIR *paCompDirs;
+    KSIZE               cCompDirs;
+} KDEPELF;
+typedef KDEPELF *PKDEPELF;
+
+/** DWARF reader cursor, bounded by the section size. */
+typedef struct KDEPDWCURSOR
+{
+    const KU8          *pb;
+    KSIZE               cb;
+    KSIZE               off;
+    KBOOL               fBigEndian;
+    /** Set when reading past the end. */
+    KBOOL               fOverflow;
+} KDEPDWCURSOR;
+typedef KDEPDWCURSOR *PKDEPDWCURSOR;
+
+/** DWARF line header path entry (directory or file). */
+typedef struct KDEPDWPATH
+{
+    const char         *pch;
+    KSIZE               cch;
+    KU64                iDir;
+} KDEPDWPATH;
+typedef KDEPDWPATH *PKDEPDWPATH;
+
+/** The compilation directory of a compilation unit (DW_AT_comp_dir). */
+typedef struct KDEPDWCOMPDIR
+{
+    /** The .debug_line offset of the unit's line number program (DW_AT_stmt_list). */
+    KU64                offLine;
+    const char         *pch;
+    KSIZE               cch;
+} KDEPDWCOMPDIR;
+typedef KDEPDWCOMPDIR *PKDEPDWCOMPDIR;
+/** @} */
+
 /**
  * Globals.
  */
@@ -939,6 +1194,1103 @@ KBOOL kDepObjCOFFTest(PKDEPOBJGLOBALS pThis, const KU8 *pbFile, KSIZE cbFile)
 }
 
 
+/**
+ * Reads an unsigned integer of the given size from the file, honoring the
+ * file byte order.
+ *
+ * @returns The value.
+ * @param   pb          Where to read it from.
+ * @param   cb          The size, 1 thru 8 bytes.
+ * @param   fBigEndian  Set if big endian.
+ */
+static KU64 kDepObjELFReadU(const KU8 *pb, unsigned cb, KBOOL fBigEndian)
+{
+    KU64     u = 0;
+    unsigned i;
+    if (fBigEndian)
+        for (i = 0; i < cb; i++)
+            u = (u << 8) | pb[i];
+    else
+        for (i = cb; i-- > 0; )
+            u = (u << 8) | pb[i];
+    return u;
+}
+
+/** Reads a field from an ELF structure in the file byte order. */
+#define KDEPELF_FIELD(pElf, pStruct, Member) \
+    kDepObjELFReadU((const KU8 *)&(pStruct)->Member, sizeof((pStruct)->Member), (pElf)->fBigEndian)
+
+
+/**
+ * Reads an unsigned integer from a DWARF cursor.
+ *
+ * @returns The value, 0 on overflow.
+ * @param   pCur        The cursor.
+ * @param   cb          The size, 1 thru 8 bytes.
+ */
+static KU64 kDepObjDwReadU(PKDEPDWCURSOR pCur, unsigned cb)
+{
+    KU64 u;
+    if (pCur->off > pCur->cb || pCur->cb - pCur->off < cb)
+    {
+        pCur->fOverflow = K_TRUE;
+        pCur->off = pCur->cb;
+        return 0;
+    }
+    u = kDepObjELFReadU(&pCur->pb[pCur->off], cb, pCur->fBigEndian);
+    pCur->off += cb;
+    return u;
+}
+
+
+/**
+ * Reads an unsigned LEB128 number from a DWARF cursor.
+ *
+ * @returns The value, 0 on overflow.
+ * @param   pCur        The cursor.
+ */
+static KU64 kDepObjDwReadULeb128(PKDEPDWCURSOR pCur)
+{
+    KU64     u = 0;
+    unsigned iShift = 0;
+    while (pCur->off < pCur->cb)
+    {
+        KU8 b = pCur->pb[pCur->off++];
+        if (iShift < 64)
+            u |= (KU64)(b & 0x7f) << iShift;
+        iShift += 7;
+        if (!(b & 0x80))
+            return u;
+    }
+    pCur->fOverflow = K_TRUE;
+    return 0;
+}
+
+
+/**
+ * Reads a zero terminated string from a DWARF cursor.
+ *
+ * @returns Pointer to the string, NULL on overflow.
+ * @param   pCur        The cursor.
+ * @param   pcch        Where to return the string length.
+ */
+static const char *kDepObjDwReadStr(PKDEPDWCURSOR pCur, KSIZE *pcch)
+{
+    const char *psz = (const char *)&pCur->pb[pCur->off];
+    const char *pszEnd = pCur->off < pCur->cb ? (const char *)memchr(psz, '\0', pCur->cb - pCur->off) : NULL;
+    if (!pszEnd)
+    {
+        pCur->fOverflow = K_TRUE;
+        pCur->off = pCur->cb;
+        *pcch = 0;
+        return NULL;
+    }
+    *pcch = pszEnd - psz;
+    pCur->off += *pcch + 1;
+    return psz;
+}
+
+
+/**
+ * Looks up a string in a string section (.debug_str or .debug_line_str).
+ *
+ * @returns Pointer to the string, NULL if out of bounds or not terminated.
+ * @param   pElf        The ELF parser state.
+ * @param   pSect       The string section, NULL if not present.
+ * @param   off         The string offset.
+ * @param   pcch        Where to return the string length.
+ */
+static const char *kDepObjELFGetStr(PKDEPELF pElf, PCKDEPELFSECT pSect, KU64 off, KSIZE *pcch)
+{
+    const char *psz;
+    const char *pszEnd;
+    if (!pSect || off >= pSect->cb)
+        return NULL;
+    psz    = (const char *)pElf->pbFile + pSect->offFile + off;
+    pszEnd = (const char *)memchr(psz, '\0', (KSIZE)(pSect->cb - off));
+    if (!pszEnd)
+        return NULL;
+    *pcch = pszEnd - psz;
+    return psz;
+}
+
+
+/**
+ * qsort callback for sorting relocations by offset.
+ */
+static int kDepObjELFCompareRelocs(const void *pv1, const void *pv2)
+{
+    PCKDEPELFRELOC p1 = (PCKDEPELFRELOC)pv1;
+    PCKDEPELFRELOC p2 = (PCKDEPELFRELOC)pv2;
+    return p1->off < p2->off ? -1 : p1->off > p2->off ? 1 : 0;
+}
+
+
+/**
+ * Collects the relocations applying to the given section.
+ *
+ * Only needed for relocatable objects, where the DW_FORM_strp and
+ * DW_FORM_line_strp offsets in the line number program header and the
+ * compilation unit DIE, as well as DW_AT_stmt_list and the abbreviation
+ * offset, are relocations against other sections (with RELA the field
+ * content is usually zero).
+ *
+ * @returns 0 on success, 1 on failure.
+ * @param   pThis       The kDepObj instance data.
+ * @param   pElf        The ELF parser state.  paRelocs and cRelocs are set.
+ * @param   iSect       The index of the section to collect relocations for.
+ */
+static int kDepObjELFCollectRelocs(PKDEPOBJGLOBALS pThis, PKDEPELF pElf, KU32 iSect)
+{
+    KU32 iRelSect;
+
+    free(pElf->paRelocs);
+    pElf->paRelocs = NULL;
+    pElf->cRelocs  = 0;
+
+    for (iRelSect = 0; iRelSect < pElf->cSects; iRelSect++)
+    {
+        PCKDEPELFSECT   pRelSect = &pElf->paSects[iRelSect];
+        PCKDEPELFSECT   pSymSect;
+        KBOOL           fRela;
+        KSIZE           cbRel;
+        KSIZE           cbSym;
+        KSIZE           cRels;
+        KSIZE           iRel;
+        PKDEPELFRELOC   paNew;
+
+        if (   (pRelSect->uType != KDEPELF_SHT_REL && pRelSect->uType != KDEPELF_SHT_RELA)
+            || pRelSect->uInfo != iSect)
+            continue;
+        fRela = pRelSect->uType == KDEPELF_SHT_RELA;
+        cbRel = (pElf->f64Bit ? 16 : 8) + (fRela ? (pElf->f64Bit ? 8 : 4) : 0);
+        cbSym = pElf->f64Bit ? sizeof(KDEPELF64SYM) : sizeof(KDEPELF32SYM);
+        if (pRelSect->uLink >= pElf->cSects)
+            return kDepErr(pThis, 1, "ELF relocation section #%u has a bad symbol table link", (unsigned)iRelSect);
+        pSymSect = &pElf->paSects[pRelSect->uLink];
+
+        cRels = (KSIZE)(pRelSect->cb / cbRel);
+        paNew = (PKDEPELFRELOC)realloc(pElf->paRelocs, (pElf->cRelocs + cRels + 1) * sizeof(paNew[0]));
+        if (!paNew)
+            return kDepErr(pThis, 1, "Out of memory!");
+        pElf->paRelocs = paNew;
+
+        for (iRel = 0; iRel < cRels; iRel++)
+        {
+            const KU8      *pbRel = pElf->pbFile + pRelSect->offFile + iRel * cbRel;
+            PKDEPELFRELOC   pReloc = &pElf->paRelocs[pElf->cRelocs];
+            KU64            uInfo;
+            KU64            iSym;
+            KU64            uSymValue = 0;
+            unsigned        cbField = pElf->f64Bit ? 8 : 4;
+
+            pReloc->off = kDepObjELFReadU(pbRel, cbField, pElf->fBigEndian);
+            uInfo       = kDepObjELFReadU(pbRel + cbField, cbField, pElf->fBigEndian);
+            iSym        = pElf->f64Bit ? uInfo >> 32 : uInfo >> 8;
+            if (iSym != 0)
+            {
+                const KU8 *pbSym;
+                if (pSymSect->uType == KDEPELF_SHT_NOBITS || iSym >= pSymSect->cb / cbSym)
+                    return kDepErr(pThis, 1, "ELF relocation #%u in section #%u has a bad symbol index",
+                                   (unsigned)iRel, (unsigned)iRelSect);
+                pbSym = pElf->pbFile + pSymSect->offFile + iSym * cbSym;
+                if (pElf->f64Bit)
+                    uSymValue = KDEPELF_FIELD(pElf, (const KDEPELF64SYM *)pbSym, st_value);
+                else
+                    uSymValue = KDEPELF_FIELD(pElf, (const KDEPELF32SYM *)pbSym, st_value);
+            }
+            if (fRela)
+                pReloc->uValue = uSymValue + kDepObjELFReadU(pbRel + cbField * 2, cbField, pElf->fBigEndian);
+            else
+                pReloc->uValue = uSymValue;
+            pReloc->fAddField = !fRela;
+            pElf->cRelocs++;
+        }
+    }
+
+    if (pElf->cRelocs > 1)
+        qsort(pElf->paRelocs, pElf->cRelocs, sizeof(pElf->paRelocs[0]), kDepObjELFCompareRelocs);
+    return 0;
+}
+
+
+/**
+ * Reads a section offset field from the line number program header or a
+ * debugging information entry, applying any relocation for it.
+ *
+ * @returns The offset.
+ * @param   pElf        The ELF parser state.
+ * @param   pCur        The cursor (covering the whole .debug_line or
+ *                      .debug_info section).
+ * @param   cb          The field size (4 or 8).
+ */
+static KU64 kDepObjDwReadSectOff(PKDEPELF pElf, PKDEPDWCURSOR pCur, unsigned cb)
+{
+    KU64    offField = pCur->off;
+    KU64    uValue   = kDepObjDwReadU(pCur, cb);
+    KSIZE   iStart   = 0;
+    KSIZE   iEnd     = pElf->cRelocs;
+    while (iStart < iEnd)
+    {
+        KSIZE i = iStart + (iEnd - iStart) / 2;
+        if (pElf->paRelocs[i].off < offField)
+            iStart = i + 1;
+        else if (pElf->paRelocs[i].off > offField)
+            iEnd = i;
+        else
+        {
+            if (pElf->paRelocs[i].fAddField)
+                uValue += pElf->paRelocs[i].uValue;
+            else
+                uValue  = pElf->paRelocs[i].uValue;
+            break;
+        }
+    }
+    if (cb == 4)
+        uValue &= KU32_MAX;
+    return uValue;
+}
+
+
+/**
+ * Reads an attribute value from a DWARF 5 directory or file name entry or
+ * from a debugging information entry.
+ *
+ * DW_FORM_addr and DW_FORM_ref_addr depend on the unit header and must be
+ * dealt with by the caller.
+ *
+ * @returns 0 on success, 1 on unsupported form.
+ * @param   pElf        The ELF parser state.
+ * @param   pCur        The cursor.
+ * @param   uForm       The DW_FORM_XXX value.
+ * @param   cbOffset    The offset size, 4 for 32-bit DWARF and 8 for 64-bit.
+ * @param   ppch        Where to return the string for string forms. NULL if
+ *                      not a string form or the string is bad.
+ * @param   pcch        Where to return the string length.
+ * @param   pu          Where to return the value of constant forms.
+ */
+static int kDepObjDwReadForm(PKDEPELF pElf, PKDEPDWCURSOR pCur, KU64 uForm, unsigned cbOffset,
+                             const char **ppch, KSIZE *pcch, KU64 *pu)
+{
+    KU64 cbSkip;
+    *ppch = NULL;
+    *pcch = 0;
+    *pu   = 0;
+    switch (uForm)
+    {
+        case KDEPDW_FORM_STRING:
+            *ppch = kDepObjDwReadStr(pCur, pcch);
+            return 0;
+        case KDEPDW_FORM_LINE_STRP:
+            *ppch = kDepObjELFGetStr(pElf, pElf->pDebugLineStr, kDepObjDwReadSectOff(pElf, pCur, cbOffset), pcch);
+            return 0;
+        case KDEPDW_FORM_STRP:
+            *ppch = kDepObjELFGetStr(pElf, pElf->pDebugStr, kDepObjDwReadSectOff(pElf, pCur, cbOffset), pcch);
+            return 0;
+        /* DWARF 2 and 3 use data4/data8 for section offsets (DW_AT_stmt_list). */
+        case KDEPDW_FORM_DATA1:     *pu = kDepObjDwReadU(pCur, 1); return 0;
+        case KDEPDW_FORM_DATA2:     *pu = kDepObjDwReadU(pCur, 2); return 0;
+        case KDEPDW_FORM_DATA4:     *pu = kDepObjDwReadSectOff(pElf, pCur, 4); return 0;
+        case KDEPDW_FORM_DATA8:     *pu = kDepObjDwReadSectOff(pElf, pCur, 8); return 0;
+        case KDEPDW_FORM_UDATA:     *pu = kDepObjDwReadULeb128(pCur); return 0;
+        case KDEPDW_FORM_SDATA:     *pu = kDepObjDwReadULeb128(pCur); return 0;
+        case KDEPDW_FORM_SEC_OFFSET:
+        case KDEPDW_FORM_STRP_SUP:
+        case KDEPDW_FORM_GNU_REF_ALT:
+        case KDEPDW_FORM_GNU_STRP_ALT:
+            *pu = kDepObjDwReadSectOff(pElf, pCur, cbOffset);
+            return 0;
+        case KDEPDW_FORM_REF_UDATA:
+        case KDEPDW_FORM_STRX:
+        case KDEPDW_FORM_ADDRX:
+        case KDEPDW_FORM_LOCLISTX:
+        case KDEPDW_FORM_RNGLISTX:
+        case KDEPDW_FORM_GNU_ADDR_INDEX:
+        case KDEPDW_FORM_GNU_STR_INDEX:
+            *pu = kDepObjDwReadULeb128(pCur);
+            return 0;
+        case KDEPDW_FORM_FLAG_PRESENT:
+        case KDEPDW_FORM_IMPLICIT_CONST: /* the value is in the abbreviation */
+            return 0;
+        case KDEPDW_FORM_FLAG:
+        case KDEPDW_FORM_REF1:
+        case KDEPDW_FORM_STRX1:
+        case KDEPDW_FORM_ADDRX1:    cbSkip = 1; break;
+        case KDEPDW_FORM_REF2:
+        case KDEPDW_FORM_STRX2:
+        case KDEPDW_FORM_ADDRX2:    cbSkip = 2; break;
+        case KDEPDW_FORM_STRX3:
+        case KDEPDW_FORM_ADDRX3:    cbSkip = 3; break;
+        case KDEPDW_FORM_REF4:
+        case KDEPDW_FORM_REF_SUP4:
+        case KDEPDW_FORM_STRX4:
+        case KDEPDW_FORM_ADDRX4:    cbSkip = 4; break;
+        case KDEPDW_FORM_REF8:
+        case KDEPDW_FORM_REF_SIG8:
+        case KDEPDW_FORM_REF_SUP8:  cbSkip = 8; break;
+        case KDEPDW_FORM_DATA16:    cbSkip = 16; break;
+        case KDEPDW_FORM_BLOCK1:    cbSkip = kDepObjDwReadU(pCur, 1); break;
+        case KDEPDW_FORM_BLOCK2:    cbSkip = kDepObjDwReadU(pCur, 2); break;
+        case KDEPDW_FORM_BLOCK4:    cbSkip = kDepObjDwReadU(pCur, 4); break;
+        case KDEPDW_FORM_EXPRLOC:
+        case KDEPDW_FORM_BLOCK:     cbSkip = kDepObjDwReadULeb128(pCur); break;
+        default:
+            return 1;
+    }
+    if (pCur->off > pCur->cb || cbSkip > pCur->cb - pCur->off)
+    {
+        pCur->fOverflow = K_TRUE;
+        pCur->off = pCur->cb;
+    }
+    else
+        pCur->off += (KSIZE)cbSkip;
+    return 0;
+}
+
+
+/**
+ * Reads a DWARF 5 directory or file name entry table.
+ *
+ * @returns 0 on success, 1 on failure.
+ * @param   pThis       The kDepObj instance data.
+ * @param   pElf        The ELF parser state.
+ * @param   pCur        The cursor.
+ * @param   cbOffset    The offset size, 4 for 32-bit DWARF and 8 for 64-bit.
+ * @param   ppaEntries  Where to return the entry array (free it).
+ * @param   pcEntries   Where to return the number of entries.
+ */
+static int kDepObjDw5ReadEntries(PKDEPOBJGLOBALS pThis, PKDEPELF pElf, PKDEPDWCURSOR pCur, unsigned cbOffset,
+                                 PKDEPDWPATH *ppaEntries, KSIZE *pcEntries)
+{
+    KU64        auFormat[2 * 16];
+    unsigned    cFormats = (unsigned)kDepObjDwReadU(pCur, 1);
+    unsigned    iFormat;
+    KU64        cEntries;
+    KU64        iEntry;
+    PKDEPDWPATH paEntries;
+
+    *ppaEntries = NULL;
+    *pcEntries  = 0;
+    if (cFormats > sizeof(auFormat) / sizeof(auFormat[0]) / 2)
+        return kDepErr(pThis, 1, "Too many DWARF 5 line header entry formats: %u", cFormats);
+    for (iFormat = 0; iFormat < cFormats; iFormat++)
+    {
+        auFormat[iFormat * 2]     = kDepObjDwReadULeb128(pCur);
+        auFormat[iFormat * 2 + 1] = kDepObjDwReadULeb128(pCur);
+    }
+
+    cEntries = kDepObjDwReadULeb128(pCur);
+    if (pCur->fOverflow || pCur->off > pCur->cb || cEntries > pCur->cb - pCur->off)
+        return kDepErr(pThis, 1, "Bad DWARF 5 line header entry count");
+    paEntries = (PKDEPDWPATH)calloc((KSIZE)cEntries + 1, sizeof(paEntries[0]));
+    if (!paEntries)
+        return kDepErr(pThis, 1, "Out of memory!");
+
+    for (iEntry = 0; iEntry < cEntries && !pCur->fOverflow; iEntry++)
+        for (iFormat = 0; iFormat < cFormats; iFormat++)
+        {
+            const char *pch;
+            KSIZE       cch;
+            KU64        u;
+            if (kDepObjDwReadForm(pElf, pCur, auFormat[iFormat * 2 + 1], cbOffset, &pch, &cch, &u))
+            {
+                free(paEntries);
+                return kDepErr(pThis, 1, "Unsupported DWARF form in line header: %#x", (unsigned)auFormat[iFormat * 2 + 1]);
+            }
+            if (auFormat[iFormat * 2] == KDEPDW_LNCT_PATH)
+            {
+                paEntries[iEntry].pch = pch;
+                paEntries[iEntry].cch = cch;
+            }
+            else if (auFormat[iFormat * 2] == KDEPDW_LNCT_DIRECTORY_INDEX)
+                paEntries[iEntry].iDir = u;
+        }
+
+    *ppaEntries = paEntries;
+    *pcEntries  = (KSIZE)cEntries;
+    return 0;
+}
+
+
+/**
+ * Checks if a path recorded by the compiler is absolute.
+ */
+static KBOOL kDepObjDwIsAbsPath(const char *pch, KSIZE cch)
+{
+    return cch > 0
+        && (   pch[0] == '/'
+            || pch[0] == '\\'
+            || (cch > 2 && isalpha((unsigned char)pch[0]) && pch[1] == ':' && (pch[2] == '/' || pch[2] == '\\')));
+}
+
+
+/**
+ * Looks up an abbreviation declaration.
+ *
+ * @returns 0 on success, 1 if not found.
+ * @param   pElf        The ELF parser state.
+ * @param   offAbbrevs  The offset of the unit's abbreviations.
+ * @param   uCode       The abbreviation code to look for.
+ * @param   pCur        Where to return a cursor positioned at the attribute
+ *                      specifications of the declaration.
+ */
+static int kDepObjDwFindAbbrev(PKDEPELF pElf, KU64 offAbbrevs, KU64 uCode, PKDEPDWCURSOR pCur)
+{
+    if (!pElf->pDebugAbbrev || pElf->pDebugAbbrev->uType == KDEPELF_SHT_NOBITS || offAbbrevs >= pElf->pDebugAbbrev->cb)
+        return 1;
+    pCur->pb         = pElf->pbFile + pElf->pDebugAbbrev->offFile;
+    pCur->cb         = (KSIZE)pElf->pDebugAbbrev->cb;
+    pCur->off        = (KSIZE)offAbbrevs;
+    pCur->fBigEndian = pElf->fBigEndian;
+    pCur->fOverflow  = K_FALSE;
+    while (!pCur->fOverflow)
+    {
+        KU64 uThisCode = kDepObjDwReadULeb128(pCur);
+        if (!uThisCode)
+            break;
+        kDepObjDwReadULeb128(pCur);             /* tag */
+        kDepObjDwReadU(pCur, 1);                /* children */
+        if (uThisCode == uCode)
+            return pCur->fOverflow;
+        for (;;)
+        {
+            KU64 uAttr = kDepObjDwReadULeb128(pCur);
+            KU64 uForm = kDepObjDwReadULeb128(pCur);
+            if (pCur->fOverflow || (!uAttr && !uForm))
+                break;
+            if (uForm == KDEPDW_FORM_IMPLICIT_CONST)
+                kDepObjDwReadULeb128(pCur);
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Collects the compilation directories of the compilation units in a
+ * .debug_info section.
+ *
+ * DWARF 2 thru 4 line number program headers leave out the compilation
+ * directory (directory index 0), so relative directory and file names can only
+ * be resolved using the DW_AT_comp_dir attribute of the compilation unit DIE
+ * that refers to the line number program thru DW_AT_stmt_list.
+ *
+ * @returns 0 on success, 1 on failure.
+ * @param   pThis       The kDepObj instance data.
+ * @param   pElf        The ELF parser state.  Relocations for the section
+ *                      must have been collected.  paCompDirs and cCompDirs
+ *                      are updated.
+ * @param   pSect       The .debug_info section.
+ */
+static int kDepObjELFParseDebugInfo(PKDEPOBJGLOBALS pThis, PKDEPELF pElf, PCKDEPELFSECT pSect)
+{
+    KDEPDWCURSOR    Cur;
+
+    Cur.pb         = pElf->pbFile + pSect->offFile;
+    Cur.cb         = (KSIZE)pSect->cb;
+    Cur.off        = 0;
+    Cur.fBigEndian = pElf->fBigEndian;
+    Cur.fOverflow  = K_FALSE;
+
+    while (Cur.off < Cur.cb)
+    {
+        KSIZE           offUnit  = Cur.off;
+        KU64            cbUnit   = kDepObjDwReadU(&Cur, 4);
+        unsigned        cbOffset = 4;
+        unsigned        cbAddr;
+        KSIZE           offEnd;
+        unsigned        uVersion;
+        KU64            offAbbrevs;
+        KDEPDWCURSOR    Abbrev;
+        KU64            offLine  = 0;
+        KBOOL           fLine    = K_FALSE;
+        const char     *pchDir   = NULL;
+        KSIZE           cchDir   = 0;
+
+        if (cbUnit == KU32_MAX)
+        {
+            cbUnit   = kDepObjDwReadU(&Cur, 8);
+            cbOffset = 8;
+        }
+        else if (cbUnit >= KU32_C(0xfffffff0))
+            return kDepErr(pThis, 1, "Bad .debug_info unit length at %#lx: %#lx",
+                           (unsigned long)offUnit, (unsigned long)cbUnit);
+        if (Cur.fOverflow || cbUnit > Cur.cb - Cur.off)
+            return kDepErr(pThis, 1, "Truncated .debug_info unit at %#lx", (unsigned long)offUnit);
+        offEnd = Cur.off + (KSIZE)cbUnit;
+
+        uVersion = (unsigned)kDepObjDwReadU(&Cur, 2);
+        if (uVersion < 2 || uVersion > 4)
+        {
+            /* DWARF 5 line number program headers have the compilation directory. */
+            Cur.off = offEnd;
+            continue;
+        }
+        Cur.cb     = offEnd;                    /* restrict reading to the unit */
+        offAbbrevs = kDepObjDwReadSectOff(pElf, &Cur, cbOffset);
+        cbAddr     = (unsigned)kDepObjDwReadU(&Cur, 1);
+
+        /*
+         * The first DIE is the unit DIE.  Look for DW_AT_stmt_list and
+         * DW_AT_comp_dir among its attributes.
+         */
+        if (kDepObjDwFindAbbrev(pElf, offAbbrevs, kDepObjDwReadULeb128(&Cur), &Abbrev))
+            return kDepErr(pThis, 1, "Bad abbreviation for the .debug_info unit at %#lx", (unsigned long)offUnit);
+        while (!Cur.fOverflow && !Abbrev.fOverflow)
+        {
+            KU64        uAttr = kDepObjDwReadULeb128(&Abbrev);
+            KU64        uForm = kDepObjDwReadULeb128(&Abbrev);
+            const char *pch;
+            KSIZE       cch;
+            KU64        u;
+            if (!uAttr && !uForm)
+                break;
+            while (uForm == KDEPDW_FORM_INDIRECT && !Cur.fOverflow)
+                uForm = kDepObjDwReadULeb128(&Cur);
+            if (uForm == KDEPDW_FORM_ADDR)
+                kDepObjDwReadU(&Cur, cbAddr);
+            else if (uForm == KDEPDW_FORM_REF_ADDR)
+                kDepObjDwReadU(&Cur, uVersion < 3 ? cbAddr : cbOffset);
+            else if (uForm == KDEPDW_FORM_IMPLICIT_CONST)
+                kDepObjDwReadULeb128(&Abbrev);
+            else if (kDepObjDwReadForm(pElf, &Cur, uForm, cbOffset, &pch, &cch, &u))
+                return kDepErr(pThis, 1, "Unsupported DWARF form in the .debug_info unit at %#lx: %#x",
+                               (unsigned long)offUnit, (unsigned)uForm);
+            else if (uAttr == KDEPDW_AT_STMT_LIST)
+            {
+                offLine = u;
+                fLine   = K_TRUE;
+            }
+            else if (uAttr == KDEPDW_AT_COMP_DIR)
+            {
+                pchDir = pch;
+                cchDir = cch;
+            }
+        }
+        if (Cur.fOverflow || Abbrev.fOverflow)
+            return kDepErr(pThis, 1, "Truncated .debug_info unit at %#lx", (unsigned long)offUnit);
+
+        if (fLine && pchDir && cchDir)
+        {
+            void *pvNew = realloc(pElf->paCompDirs, (pElf->cCompDirs + 1) * sizeof(pElf->paCompDirs[0]));
+            if (!pvNew)
+                return kDepErr(pThis, 1, "Out of memory!");
+            pElf->paCompDirs = (PKDEPDWCOMPDIR)pvNew;
+            pElf->paCompDirs[pElf->cCompDirs].offLine = offLine;
+            pElf->paCompDirs[pElf->cCompDirs].pch     = pchDir;
+            pElf->paCompDirs[pElf->cCompDirs].cch     = cchDir;
+            pElf->cCompDirs++;
+        }
+
+        Cur.cb  = (KSIZE)pSect->cb;
+        Cur.off = offEnd;
+    }
+    return 0;
+}
+
+
+/**
+ * Adds a file from the line number program header as a dependency.
+ *
+ * @returns 0 on success, 1 if the path is too long.
+ * @param   pThis       The kDepObj instance data.
+ * @param   pFile       The file name entry.
+ * @param   paDirs      The directory table.
+ * @param   cDirs       The number of directories.
+ * @param   pCompDir    The compilation directory for relative directory
+ *                      entries (directory 0), NULL if not known.
+ */
+static int kDepObjDwAddFile(PKDEPOBJGLOBALS pThis, PKDEPDWPATH pFile, PKDEPDWPATH paDirs, KSIZE cDirs,
+                            PKDEPDWPATH pCompDir)
+{
+    char            szPath[4096];
+    KSIZE           off = 0;
+    PKDEPDWPATH     pDir;
+
+    if (!pFile->pch || !pFile->cch)
+        return 0;
+    if (kDepObjDwIsAbsPath(pFile->pch, pFile->cch))
+    {
+        depAdd(&pThis->Core, pFile->pch, pFile->cch);
+        return 0;
+    }
+
+    pDir = pFile->iDir < cDirs ? &paDirs[pFile->iDir] : NULL;
+    if (pDir && pDir->pch && pDir->cch)
+    {
+        if (   pCompDir
+            && pCompDir != pDir
+            && pCompDir->pch
+            && pCompDir->cch
+            && !kDepObjDwIsAbsPath(pDir->pch, pDir->cch))
+        {
+            if (pCompDir->cch + 1 >= sizeof(szPath))
+                return kDepErr(pThis, 1, "Path too long: %.*s", (int)pCompDir->cch, pCompDir->pch);
+            memcpy(szPath, pCompDir->pch, pCompDir->cch);
+            off = pCompDir->cch;
+            szPath[off++] = '/';
+        }
+        if (off + pDir->cch + 1 >= sizeof(szPath))
+            return kDepErr(pThis, 1, "Path too long: %.*s", (int)pDir->cch, pDir->pch);
+        memcpy(&szPath[off], pDir->pch, pDir->cch);
+        off += pDir->cch;
+        if (szPath[off - 1] != '/' && szPath[off - 1] != '\\')
+            szPath[off++] = '/';
+    }
+    if (off + pFile->cch >= sizeof(szPath))
+        return kDepErr(pThis, 1, "Path too long: %.*s", (int)pFile->cch, pFile->pch);
+    memcpy(&szPath[off], pFile->pch, pFile->cch);
+    off += pFile->cch;
+    szPath[off] = '\0';
+    depAdd(&pThis->Core, szPath, off);
+    return 0;
+}
+
+
+/**
+ * Parses the line number program headers in a .debug_line section.
+ *
+ * Handles DWARF versions 2 thru 5, both 32-bit and 64-bit DWARF.  Only the
+ * directory and file name tables are used, the line number programs are
+ * skipped.  For DWARF 2 thru 4 the compilation directories must have been
+ * collected by kDepObjELFParseDebugInfo first.
+ *
+ * @returns 0 on success, 1 on failure, 2 if no dependencies was found.
+ * @param   pThis       The kDepObj instance data.
+ * @param   pElf        The ELF parser state.
+ * @param   pSect       The .debug_line section.
+ */
+static int kDepObjELFParseDebugLine(PKDEPOBJGLOBALS pThis, PKDEPELF pElf, PCKDEPELFSECT pSect)
+{
+    KDEPDWCURSOR    Cur;
+    int             rcRet = 2;
+
+    Cur.pb         = pElf->pbFile + pSect->offFile;
+    Cur.cb         = (KSIZE)pSect->cb;
+    Cur.off        = 0;
+    Cur.fBigEndian = pElf->fBigEndian;
+    Cur.fOverflow  = K_FALSE;
+
+    while (Cur.off < Cur.cb)
+    {
+        KSIZE       offUnit = Cur.off;
+        KU64        cbUnit  = kDepObjDwReadU(&Cur, 4);
+        unsigned    cbOffset = 4;
+        KSIZE       offEnd;
+        unsigned    uVersion;
+        KU64        cbHdr;
+        unsigned    bOpcodeBase;
+        PKDEPDWPATH paDirs  = NULL;
+        KSIZE       cDirs   = 0;
+        PKDEPDWPATH paFiles = NULL;
+        KSIZE       cFiles  = 0;
+        KSIZE       i;
+        int         rc = 0;
+
+        if (cbUnit == KU32_MAX)
+        {
+            cbUnit   = kDepObjDwReadU(&Cur, 8);
+            cbOffset = 8;
+        }
+        else if (cbUnit >= KU32_C(0xfffffff0))
+            return kDepErr(pThis, 1, "Bad .debug_line unit length at %#lx: %#lx",
+                           (unsigned long)offUnit, (unsigned long)cbUnit);
+        if (Cur.fOverflow || cbUnit > Cur.cb - Cur.off)
+            return kDepErr(pThis, 1, "Truncated .debug_line unit at %#lx", (unsigned long)offUnit);
+        offEnd = Cur.off + (KSIZE)cbUnit;
+
+        uVersion = (unsigned)kDepObjDwReadU(&Cur, 2);
+        if (uVersion < 2 || uVersion > 5)
+        {
+            dprintf(("Skipping .debug_line unit at %#lx with version %u\n", (unsigned long)offUnit, uVersion));
+            Cur.off = offEnd;
+            continue;
+        }
+        if (uVersion >= 5)
+            Cur.off += 2;                       /* address_size, segment_selector_size */
+        cbHdr = kDepObjDwReadU(&Cur, cbOffset);
+        if (Cur.fOverflow || cbHdr > offEnd - Cur.off)
+            return kDepErr(pThis, 1, "Bad .debug_line header length at %#lx", (unsigned long)offUnit);
+        Cur.cb = Cur.off + (KSIZE)cbHdr;        /* restrict reading to the header */
+
+        Cur.off += uVersion >= 4 ? 5 : 4;       /* minimum_instruction_length thru line_range */
+        bOpcodeBase = (unsigned)kDepObjDwReadU(&Cur, 1);
+        if (bOpcodeBase > 0)
+            Cur.off += bOpcodeBase - 1;         /* standard_opcode_lengths */
+        if (Cur.off > Cur.cb)
+            Cur.fOverflow = K_TRUE;
+
+        if (uVersion >= 5)
+        {
+            rc = kDepObjDw5ReadEntries(pThis, pElf, &Cur, cbOffset, &paDirs, &cDirs);
+            if (!rc)
+                rc = kDepObjDw5ReadEntries(pThis, pElf, &Cur, cbOffset, &paFiles, &cFiles);
+        }
+        else
+        {
+            /* include_directories: index 0 is the compilation directory, which
+               isn't recorded here but in the compilation unit DIE. */
+            KSIZE cAlloc = 0;
+            for (;;)
+            {
+                KDEPDWPATH Entry;
+                memset(&Entry, 0, sizeof(Entry));
+                if (cDirs > 0)
+                {
+                    Entry.pch = kDepObjDwReadStr(&Cur, &Entry.cch);
+                    if (!Entry.pch || !Entry.cch)
+                        break;
+                }
+                else
+                    for (i = 0; i < pElf->cCompDirs; i++)
+                        if (pElf->paCompDirs[i].offLine == offUnit)
+                        {
+                            Entry.pch = pElf->paCompDirs[i].pch;
+                            Entry.cch = pElf->paCompDirs[i].cch;
+                            break;
+                        }
+                if (cDirs + 1 > cAlloc)
+                {
+                    void *pvNew = realloc(paDirs, (cAlloc = cAlloc ? cAlloc * 2 : 16) * sizeof(paDirs[0]));
+                    if (!pvNew)
+                    {
+                        rc = kDepErr(pThis, 1, "Out of memory!");
+                        break;
+                    }
+                    paDirs = (PKDEPDWPATH)pvNew;
+                }
+                paDirs[cDirs++] = Entry;
+            }
+
+            /* file_names: name, directory index, modification time, length. */
+            cAlloc = 0;
+            while (!rc)
+            {
+                KDEPDWPATH Entry;
+                Entry.pch = kDepObjDwReadStr(&Cur, &Entry.cch);
+                if (!Entry.pch || !Entry.cch)
+                    break;
+                Entry.iDir = kDepObjDwReadULeb128(&Cur);
+                kDepObjDwReadULeb128(&Cur);
+                kDepObjDwReadULeb128(&Cur);
+                if (cFiles + 1 > cAlloc)
+                {
+                    void *pvNew = realloc(paFiles, (cAlloc = cAlloc ? cAlloc * 2 : 16) * sizeof(paFiles[0]));
+                    if (!pvNew)
+                    {
+                        rc = kDepErr(pThis, 1, "Out of memory!");
+                        break;
+                    }
+                    paFiles = (PKDEPDWPATH)pvNew;
+                }
+                paFiles[cFiles++] = Entry;
+            }
+        }
+
+        if (!rc && Cur.fOverflow)
+            rc = kDepErr(pThis, 1, "Truncated .debug_line header at %#lx", (unsigned long)offUnit);
+        for (i = 0; i < cFiles && !rc; i++)
+        {
+            rc = kDepObjDwAddFile(pThis, &paFiles[i], paDirs, cDirs, cDirs > 0 ? &paDirs[0] : NULL);
+            if (!rc)
+                rcRet = 0;
+        }
+
+        free(paDirs);
+        free(paFiles);
+        if (rc)
+            return rc;
+
+        Cur.cb  = (KSIZE)pSect->cb;
+        Cur.off = offEnd;
+    }
+    return rcRet;
+}
+
+
+/**
+ * Parses the ELF file.
+ *
+ * @returns 0 on success, 1 on failure, 2 if no dependencies was found.
+ * @param   pThis       The kDepObj instance data.
+ * @param   pbFile      The start of the file.
+ * @param   cbFile      The file size.
+ */
+int kDepObjELFParse(PKDEPOBJGLOBALS pThis, const KU8 *pbFile, KSIZE cbFile)
+{
+    KDEPELF         Elf;
+    KU64            offSHdrs;
+    KU32            cSHdrs;
+    KU32            iShStrTab;
+    KSIZE           cbSHdr;
+    KU32            iSect;
+    KBOOL           fMacros = K_FALSE;
+    int             rcRet = 2;
+    int             rc;
+
+    memset(&Elf, 0, sizeof(Elf));
+    Elf.pbFile     = pbFile;
+    Elf.cbFile     = cbFile;
+    Elf.fBigEndian = pbFile[KDEPELF_EI_DATA] == KDEPELF_ELFDATA2MSB;
+    Elf.f64Bit     = pbFile[KDEPELF_EI_CLASS] == KDEPELF_ELFCLASS64;
+    dprintf(("ELF file! (%s, %s endian)\n", Elf.f64Bit ? "64-bit" : "32-bit", Elf.fBigEndian ? "big" : "little"));
+
+    /*
+     * Convert the section headers.  (kDepObjELFTest checked the bounds.)
+     */
+    if (Elf.f64Bit)
+    {
+        const KDEPELF64EHDR *pEhdr = (const KDEPELF64EHDR *)pbFile;
+        offSHdrs  = KDEPELF_FIELD(&Elf, pEhdr, e_shoff);
+        cSHdrs    = (KU32)KDEPELF_FIELD(&Elf, pEhdr, e_shnum);
+        iShStrTab = (KU32)KDEPELF_FIELD(&Elf, pEhdr, e_shstrndx);
+        cbSHdr    = sizeof(KDEPELF64SHDR);
+    }
+    else
+    {
+        const KDEPELF32EHDR *pEhdr = (const KDEPELF32EHDR *)pbFile;
+        offSHdrs  = KDEPELF_FIELD(&Elf, pEhdr, e_shoff);
+        cSHdrs    = (KU32)KDEPELF_FIELD(&Elf, pEhdr, e_shnum);
+        iShStrTab = (KU32)KDEPELF_FIELD(&Elf, pEhdr, e_shstrndx);
+        cbSHdr    = sizeof(KDEPELF32SHDR);
+    }
+    if (offSHdrs == 0)
+        return 2;
+    if (cbFile - offSHdrs < cbSHdr)
+        return kDepErr(pThis, 1, "ELF section headers are out of bounds");
+
+    Elf.paSects = (PKDEPELFSECT)calloc(cSHdrs ? cSHdrs : 1, sizeof(Elf.paSects[0]));
+    if (!Elf.paSects)
+        return kDepErr(pThis, 1, "Out of memory!");
+    for (iSect = 0; iSect < (cSHdrs ? cSHdrs : 1); iSect++)
+    {
+        PKDEPELFSECT pSect = &Elf.paSects[iSect];
+        if (Elf.f64Bit)
+        {
+            const KDEPELF64SHDR *pSHdr = (const KDEPELF64SHDR *)(pbFile + offSHdrs) + iSect;
+            pSect->pszName = (const char *)(KUPTR)KDEPELF_FIELD(&Elf, pSHdr, sh_name); /* fixed below */
+            pSect->uType   = (KU32)KDEPELF_FIELD(&Elf, pSHdr, sh_type);
+            pSect->fFlags  = KDEPELF_FIELD(&Elf, pSHdr, sh_flags);
+            pSect->offFile = KDEPELF_FIELD(&Elf, pSHdr, sh_offset);
+            pSect->cb      = KDEPELF_FIELD(&Elf, pSHdr, sh_size);
+            pSect->uLink   = (KU32)KDEPELF_FIELD(&Elf, pSHdr, sh_link);
+            pSect->uInfo   = (KU32)KDEPELF_FIELD(&Elf, pSHdr, sh_info);
+            pSect->cbEntry = KDEPELF_FIELD(&Elf, pSHdr, sh_entsize);
+        }
+        else
+        {
+            const KDEPELF32SHDR *pSHdr = (const KDEPELF32SHDR *)(pbFile + offSHdrs) + iSect;
+            pSect->pszName = (const char *)(KUPTR)KDEPELF_FIELD(&Elf, pSHdr, sh_name); /* fixed below */
+            pSect->uType   = (KU32)KDEPELF_FIELD(&Elf, pSHdr, sh_type);
+            pSect->fFlags  = KDEPELF_FIELD(&Elf, pSHdr, sh_flags);
+            pSect->offFile = KDEPELF_FIELD(&Elf, pSHdr, sh_offset);
+            pSect->cb      = KDEPELF_FIELD(&Elf, pSHdr, sh_size);
+            pSect->uLink   = (KU32)KDEPELF_FIELD(&Elf, pSHdr, sh_link);
+            pSect->uInfo   = (KU32)KDEPELF_FIELD(&Elf, pSHdr, sh_info);
+            pSect->cbEntry = KDEPELF_FIELD(&Elf, pSHdr, sh_entsize);
+        }
+
+        /* Section zero holds the real counts when they don't fit the ELF header. */
+        if (iSect == 0)
+        {
+            if (cSHdrs == 0)
+            {
+                KDEPELFSECT Sect0 = *pSect;
+                cSHdrs = (KU32)Sect0.cb;
+                if (   cSHdrs == 0
+                    || cSHdrs > (cbFile - offSHdrs) / cbSHdr)
+                {
+                    free(Elf.paSects);
+                    return kDepErr(pThis, 1, "ELF section header count is out of bounds");
+                }
+                free(Elf.paSects);
+                Elf.paSects = (PKDEPELFSECT)calloc(cSHdrs, sizeof(Elf.paSects[0]));
+                if (!Elf.paSects)
+                    return kDepErr(pThis, 1, "Out of memory!");
+                Elf.paSects[0] = Sect0;
+                pSect = &Elf.paSects[0];
+            }
+            if (iShStrTab == KDEPELF_SHN_XINDEX)
+                iShStrTab = pSect->uLink;
+        }
+
+        if (   pSect->uType != KDEPELF_SHT_NOBITS
+            && (   pSect->offFile > cbFile
+                || pSect->cb > cbFile - pSect->offFile))
+        {
+            free(Elf.paSects);
+            return kDepErr(pThis, 1, "ELF section #%u is out of bounds", (unsigned)iSect);
+        }
+    }
+    Elf.cSects = cSHdrs;
+
+    /*
+     * Resolve the section names.
+     */
+    if (iShStrTab >= cSHdrs || Elf.paSects[iShStrTab].uType == KDEPELF_SHT_NOBITS)
+    {
+        free(Elf.paSects);
+        return kDepErr(pThis, 1, "Bad ELF section header string table index: %u", (unsigned)iShStrTab);
+    }
+    for (iSect = 0; iSect < cSHdrs; iSect++)
+    {
+        KSIZE cchIgn;
+        Elf.paSects[iSect].pszName = kDepObjELFGetStr(&Elf, &Elf.paSects[iShStrTab],
+                                                      (KUPTR)Elf.paSects[iSect].pszName, &cchIgn);
+        if (!Elf.paSects[iSect].pszName)
+            continue;
+        if (!strcmp(Elf.paSects[iSect].pszName, ".debug_str"))
+            Elf.pDebugStr = &Elf.paSects[iSect];
+        else if (!strcmp(Elf.paSects[iSect].pszName, ".debug_line_str"))
+            Elf.pDebugLineStr = &Elf.paSects[iSect];
+        else if (!strcmp(Elf.paSects[iSect].pszName, ".debug_abbrev"))
+        {
+            if (!Elf.pDebugAbbrev)
+                Elf.pDebugAbbrev = &Elf.paSects[iSect];
+        }
+        else if (   !strcmp(Elf.paSects[iSect].pszName, ".debug_macro")
+                 || !strcmp(Elf.paSects[iSect].pszName, ".debug_macinfo"))
+            fMacros = K_TRUE;
+    }
+    if (   (Elf.pDebugStr && (Elf.pDebugStr->fFlags & KDEPELF_SHF_COMPRESSED))
+        || (Elf.pDebugLineStr && (Elf.pDebugLineStr->fFlags & KDEPELF_SHF_COMPRESSED))
+        || (Elf.pDebugAbbrev && (Elf.pDebugAbbrev->fFlags & KDEPELF_SHF_COMPRESSED)))
+    {
+        free(Elf.paSects);
+        return kDepErr(pThis, 1, "Compressed DWARF sections are not supported (compile with -gz=none)");
+    }
+
+    /*
+     * Collect the compilation directories from the .debug_info sections.
+     */
+    rc = 0;
+    for (iSect = 0; iSect < cSHdrs && !rc; iSect++)
+    {
+        PCKDEPELFSECT pSect = &Elf.paSects[iSect];
+        if (   !pSect->pszName
+            || strcmp(pSect->pszName, ".debug_info")
+            || pSect->uType == KDEPELF_SHT_NOBITS)
+            continue;
+        if (pSect->fFlags & KDEPELF_SHF_COMPRESSED)
+            rc = kDepErr(pThis, 1, "Compressed DWARF sections are not supported (compile with -gz=none)");
+        else
+        {
+            rc = kDepObjELFCollectRelocs(pThis, &Elf, iSect);
+            if (!rc)
+                rc = kDepObjELFParseDebugInfo(pThis, &Elf, pSect);
+        }
+    }
+
+    /*
+     * Parse the .debug_line sections.
+     */
+    for (iSect = 0; iSect < cSHdrs && !rc; iSect++)
+    {
+        PCKDEPELFSECT pSect = &Elf.paSects[iSect];
+        if (!pSect->pszName)
+            continue;
+        if (!strcmp(pSect->pszName, ".zdebug_line"))
+            rc = kDepErr(pThis, 1, "Compressed DWARF sections are not supported (compile with -gz=none)");
+        else if (!strcmp(pSect->pszName, ".debug_line") && pSect->uType != KDEPELF_SHT_NOBITS)
+        {
+            if (pSect->fFlags & KDEPELF_SHF_COMPRESSED)
+                rc = kDepErr(pThis, 1, "Compressed DWARF sections are not supported (compile with -gz=none)");
+            else
+            {
+                rc = kDepObjELFCollectRelocs(pThis, &Elf, iSect);
+                if (!rc)
+                    rc = kDepObjELFParseDebugLine(pThis, &Elf, pSect);
+                if (rc == 2)
+                    rc = 0;
+                else if (!rc)
+                    rcRet = 0;
+            }
+        }
+    }
+
+    /*
+     * Headers that only provide macros don't make it into the line number
+     * program headers unless there is macro debug info referring to them, so
+     * without it the dependencies are incomplete.  Don't let that pass.
+     */
+    if (!rc && !rcRet && !fMacros)
+        rc = kDepErr(pThis, 1, "No macro debug info, headers only providing macros would be missing (compile with -g3)");
+
+    free(Elf.paCompDirs);
+    free(Elf.paRelocs);
+    free(Elf.paSects);
+    return rc ? rc : rcRet;
+}
+
+
+/**
+ * Checks if this file is an ELF file or not.
+ *
+ * @returns K_TRUE if it's ELF, K_FALSE otherwise.
+ *
+ * @param   pThis   The kDepObj instance data.
+ * @param   pb      The start of the file.
+ * @param   cb      The file size.
+ */
+KBOOL kDepObjELFTest(PKDEPOBJGLOBALS pThis, const KU8 *pbFile, KSIZE cbFile)
+{
+    KDEPELF     Elf;
+    KU64        offSHdrs;
+    KU64        cSHdrs;
+    KU64        cbSHdr;
+    KU64        cbSHdrExpected;
+
+    if (cbFile < sizeof(KDEPELF64EHDR))
+        return K_FALSE;
+    if (   pbFile[0] != 0x7f
+        || pbFile[1] != 'E'
+        || pbFile[2] != 'L'
+        || pbFile[3] != 'F')
+        return K_FALSE;
+    if (   pbFile[KDEPELF_EI_CLASS] != KDEPELF_ELFCLASS32
+        && pbFile[KDEPELF_EI_CLASS] != KDEPELF_ELFCLASS64)
+    {
+        kDepErr(pThis, 1, "Unsupported ELF class: %u", pbFile[KDEPELF_EI_CLASS]);
+        return K_FALSE;
+    }
+    if (   pbFile[KDEPELF_EI_DATA] != KDEPELF_ELFDATA2LSB
+        && pbFile[KDEPELF_EI_DATA] != KDEPELF_ELFDATA2MSB)
+    {
+        kDepErr(pThis, 1, "Unsupported ELF data encoding: %u", pbFile[KDEPELF_EI_DATA]);
+        return K_FALSE;
+    }
+    if (pbFile[KDEPELF_EI_VERSION] != 1)
+        return K_FALSE;
+
+    memset(&Elf, 0, sizeof(Elf));
+    Elf.fBigEndian = pbFile[KDEPELF_EI_DATA] == KDEPELF_ELFDATA2MSB;
+    if (pbFile[KDEPELF_EI_CLASS] == KDEPELF_ELFCLASS64)
+    {
+        const KDEPELF64EHDR *pEhdr = (const KDEPELF64EHDR *)pbFile;
+        offSHdrs = KDEPELF_FIELD(&Elf, pEhdr, e_shoff);
+        cSHdrs   = KDEPELF_FIELD(&Elf, pEhdr, e_shnum);
+        cbSHdr   = KDEPELF_FIELD(&Elf, pEhdr, e_shentsize);
+        cbSHdrExpected = sizeof(KDEPELF64SHDR);
+    }
+    else
+    {
+        const KDEPELF32EHDR *pEhdr = (const KDEPELF32EHDR *)pbFile;
+        offSHdrs = KDEPELF_FIELD(&Elf, pEhdr, e_shoff);
+        cSHdrs   = KDEPELF_FIELD(&Elf, pEhdr, e_shnum);
+        cbSHdr   = KDEPELF_FIELD(&Elf, pEhdr, e_shentsize);
+        cbSHdrExpected = sizeof(KDEPELF32SHDR);
+    }
+    if (offSHdrs == 0)
+        return K_TRUE;                          /* no sections, no dependencies. */
+    if (cbSHdr != cbSHdrExpected)
+        return K_FALSE;
+    if (   offSHdrs >= cbFile
+        || (cSHdrs ? cSHdrs : 1) > (cbFile - offSHdrs) / cbSHdr)
+        return K_FALSE;
+    return K_TRUE;
+}
+
+
 /**
  * Read the file into memory and parse it.
  */
@@ -963,8 +2315,10 @@ static int kDepObjProcessFile(PKDEPOBJGLOBALS pThis, FILE *pInput)
         rc = kDepObjOMFParse(pThis, pbFile, cbFile);
     else if (kDepObjCOFFTest(pThis, pbFile, cbFile))
         rc = kDepObjCOFFParse(pThis, pbFile, cbFile);
+    else if (kDepObjELFTest(pThis, pbFile, cbFile))
+        rc = kDepObjELFParse(pThis, pbFile, cbFile);
     else
-        rc = kDepErr(pThis, 1, "Doesn't recognize the header of the OMF/COFF file.");
+        rc = kDepErr(pThis, 1, "Doesn't recognize the header of the OMF/COFF/ELF file.");
 
     depFreeFileMemory(pbFile, pvOpaque);
     return rc;
@@ -974,9 +2328,16 @@ static int kDepObjProcessFile(PKDEPOBJGLOBALS pThis, FILE *pInput)
 static void kDebObjUsage(PKMKBUILTINCTX pCtx, int fIsErr)
 {
     kmk_builtin_ctx_printf(pCtx, fIsErr,
-                           "usage: %s -o <output> -t <target> [-fqs] [-e <ignore-ext>] <OMF or COFF file>\n"
+                           "usage: %s -o <output> -t <target> [-fqs] [-e <ignore-ext>] [-d <depdb>] <OMF, COFF or ELF file>\n"
                            "   or: %s --help\n"
-                           "   or: %s --version\n",
+                           "   or: %s --version\n"
+                           "\n"
+                           "With -d (--db) the dependencies are stored in the given dependency\n"
+                           "database under the <output> name instead of being written to <output>.\n"
+                           "\n"
+                           "ELF dependencies come from the DWARF line tables, which only list headers\n"
+                           "providing nothing but macros when there is macro debug info.  ELF objects\n"
+                           "must therefore be compiled with -g3, kDepObj fails on objects without it.\n",
                            pCtx->pszProgName, pCtx->pszProgName, pCtx->pszProgName);
 }
 
@@ -989,6 +2350,7 @@ int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
     /* Arguments. */
     FILE       *pOutput = NULL;
     const char *pszOutput = NULL;
+    const char *pszDb = NULL;
     FILE       *pInput = NULL;
     const char *pszTarget = NULL;
     int         fStubs = 0;
@@ -1027,6 +2389,8 @@ int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
                     chOpt = '?';
                 else if (!strcmp(psz, "version"))
                     chOpt = 'V';
+                else if (!strcmp(psz, "db"))
+                    chOpt = 'd';
                 else
                 {
                     errx(pCtx, 2, "Invalid argument '%s'.", argv[i]);
@@ -1044,6 +2408,7 @@ int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
                 case 'o':
                 case 't':
                 case 'e':
+                case 'd':
                     if (*psz)
                         pszValue = psz;
                     else if (++i < argc)
@@ -1065,15 +2430,20 @@ int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
                  */
                 case 'o':
                 {
-                    if (pOutput)
+                    if (pszOutput)
                         return errx(pCtx, 2, "only one output file!");
                     pszOutput = pszValue;
-                    if (pszOutput[0] == '-' && !pszOutput[1])
-                        pOutput = stdout;
-                    else
-                        pOutput = fopen(pszOutput, "w" KMK_FOPEN_NO_INHERIT_MODE);
-                    if (!pOutput)
-                        return err(pCtx, 1, "Failed to create output file '%s'", pszOutput);
+                    break;
+                }
+
+                /*
+                 * Dependency database.
+                 */
+                case 'd':
+                {
+                    if (pszDb)
+                        return errx(pCtx, 2, "only one dependency database!");
+                    pszDb = pszValue;
                     break;
                 }
 
@@ -1169,11 +2539,27 @@ int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
      */
     if (!pInput)
         return errx(pCtx, 2, "No input!");
-    if (!pOutput)
+    if (!pszOutput)
         return errx(pCtx, 2, "No output!");
     if (!pszTarget)
         return errx(pCtx, 2, "No target!");
 
+    /*
+     * Open the output file (unless we're writing to the database).
+     */
+    if (!pszDb)
+    {
+        if (pszOutput[0] == '-' && !pszOutput[1])
+            pOutput = stdout;
+        else
+            pOutput = fopen(pszOutput, "w" KMK_FOPEN_NO_INHERIT_MODE);
+        if (!pOutput)
+        {
+            fclose(pInput);
+            return err(pCtx, 1, "Failed to create output file '%s'", pszOutput);
+        }
+    }
+
     /*
      * Do the parsing.
      */
@@ -1182,8 +2568,21 @@ int kmk_builtin_kDepObj(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
     fclose(pInput);
 
     /*
-     * Write the dependecy file.
+     * Write the dependecy file or database entry.
      */
+    if (pszDb)
+    {
+        if (!i)
+        {
+            depOptimize(&This.Core, fFixCase, fQuiet, pszIgnoreExt);
+            i = depWriteToDb(&This.Core, pszDb, pszOutput, pszTarget, fStubs);
+            if (i)
+                i = errx(pCtx, 1, "Failed to store '%s' in the dependency database '%s': %s",
+                         pszOutput, pszDb, strerror(i));
+        }
+        depCleanup(&This.Core);
+        return i;
+    }
     if (!i)
     {
         depOptimize(&This.Core, fFixCase, fQuiet, pszIgnoreExt);
@@ -32,7 +32,10 @@
 #include "makeint.h"
 #include "job.h"
 #include "variable.h"
-#include "pathstuff.h"
+#include "os.h"
+#ifdef KBUILD_OS_WINDOWS
+# include "pathstuff.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +51,14 @@
 # include <process.h>
 #else
 # include <unistd.h>
+# include <fcntl.h>
+# include <signal.h>
+# include <spawn.h>
+# include <poll.h>
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/select.h>
+# include <sys/wait.h>
 #endif
 #ifdef KBUILD_OS_WINDOWS
 # ifndef CONFIG_NEW_WIN_CHILDREN
@@ -71,6 +82,16 @@
 
 #define TUPLE(a_sz)     a_sz, sizeof(a_sz) - 1
 
+#ifndef KBUILD_OS_WINDOWS
+/** @def KSUBMIT_SEND_FLAGS
+ * Flags for send() so a dead worker doesn't get us killed by SIGPIPE. */
+# ifdef MSG_NOSIGNAL
+#  define KSUBMIT_SEND_FLAGS    MSG_NOSIGNAL
+# else
+#  define KSUBMIT_SEND_FLAGS    0
+# endif
+#endif
+
 
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
@@ -117,7 +138,8 @@ typedef struct WORKERINSTANCE
     PWINCCWPIPE             pStdErr;
 # endif
 #else
-    /** The socket descriptor we use to talk to the kWorker process. */
+    /** The socket descriptor we use to talk to the kWorker process.
+     * This is -1 when the connection has been closed. */
     int                     fdSocket;
 #endif
 
@@ -175,6 +197,11 @@ static unsigned             g_cArchBits    = 32;
 static char const           g_szArch[]     = "x86";
 static unsigned             g_cAltArchBits = 64;
 static char const           g_szAltArch[]  = "amd64";
+#elif !defined(KBUILD_OS_WINDOWS)
+static unsigned             g_cArchBits    = K_ARCH_BITS;
+static char const           g_szArch[]     = KBUILD_HOST_ARCH;
+static unsigned             g_cAltArchBits = K_ARCH_BITS;
+static char const           g_szAltArch[]  = KBUILD_HOST_ARCH;
 #else
 # error "Port me!"
 #endif
@@ -273,16 +300,17 @@ static void kSubmitPidHashRemove(PWORKERINSTANCE pWorker)
 {
     size_t idxHash = KWORKER_PID_HASH(pWorker->pid);
     if (g_apPidHash[idxHash] == pWorker)
-        g_apPidHash[idxHash] = pWorker->pNext;
+        g_apPidHash[idxHash] = pWorker->pNextPidHash;
     else
     {
         PWORKERINSTANCE pPrev = g_apPidHash[idxHash];
-        while (pPrev && pPrev->pNext != pWorker)
-            pPrev = pPrev->pNext;
+        while (pPrev && pPrev->pNextPidHash != pWorker)
+            pPrev = pPrev->pNextPidHash;
         assert(pPrev != NULL);
         if (pPrev)
-            pPrev->pNext = pWorker->pNext;
+            pPrev->pNextPidHash = pWorker->pNextPidHash;
     }
+    pWorker->pNextPidHash = NULL;
     pWorker->pid = -1;
 }
 
@@ -602,14 +630,69 @@ static int kSubmitSpawnWorker(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker, int
 
 #else
         /*
-         * Create a socket pair.
+         * Create a socket pair.  Our end must not be inherited by anyone,
+         * as the worker uses end-of-file as the signal to quit.
          */
         int aiPair[2] = { -1, -1 };
         if (socketpair(AF_LOCAL, SOCK_STREAM, 0, aiPair) == 0)
         {
-            pWorker->fdSocket = aiPair[1];
+            posix_spawn_file_actions_t FileActions;
+
+            fcntl(aiPair[0], F_SETFD, FD_CLOEXEC);
+            fcntl(aiPair[1], F_SETFD, FD_CLOEXEC);
+# ifdef SO_NOSIGPIPE
+            {
+                int fOn = 1;
+                setsockopt(aiPair[0], SOL_SOCKET, SO_NOSIGPIPE, &fOn, sizeof(fOn));
+            }
+# endif
 
-            rc = -1;
+            /*
+             * The worker gets the other end of the socket as standard input.
+             */
+            rc = posix_spawn_file_actions_init(&FileActions);
+            if (rc == 0)
+            {
+                rc = posix_spawn_file_actions_adddup2(&FileActions, aiPair[1], 0);
+                if (rc == 0)
+                {
+                    extern char   **environ;
+                    char           *apszArgs[4];
+                    unsigned        cArgs = 0;
+                    pid_t           pid   = -1;
+
+                    apszArgs[cArgs++] = szExecutable;
+                    if (pVarVolatile && *pVarVolatile->value)
+                    {
+                        apszArgs[cArgs++] = "--volatile";
+                        apszArgs[cArgs++] = pVarVolatile->value;
+                    }
+                    apszArgs[cArgs] = NULL;
+
+                    /* Keep the jobserver pipe out of the worker, it outlives the jobs. */
+                    jobserver_pre_child(0 /*recursive*/);
+                    rc = posix_spawn(&pid, szExecutable, &FileActions, NULL /*pAttr*/, apszArgs, environ);
+                    jobserver_post_child(0 /*recursive*/);
+                    if (rc == 0)
+                    {
+                        close(aiPair[1]);
+                        posix_spawn_file_actions_destroy(&FileActions);
+                        pWorker->fdSocket = aiPair[0];
+                        pWorker->pid      = pid;
+                        if (cVerbosity > 0)
+                            warnx(pCtx, "created %d bit worker %d\n", pWorker->cBits, pWorker->pid);
+                        return 0;
+                    }
+                    rc = errx(pCtx, -2, "posix_spawn failed on '%s': %s", szExecutable, strerror(rc));
+                }
+                else
+                    rc = errx(pCtx, -1, "posix_spawn_file_actions_adddup2 failed: %s", strerror(rc));
+                posix_spawn_file_actions_destroy(&FileActions);
+            }
+            else
+                rc = errx(pCtx, -1, "posix_spawn_file_actions_init failed: %s", strerror(rc));
+            close(aiPair[0]);
+            close(aiPair[1]);
         }
         else
             rc = err(pCtx, -1, "socketpair");
@@ -677,9 +760,6 @@ static int kSubmitRespawnWorker(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker, in
     pWorker->hProcess = INVALID_HANDLE_VALUE;
 
 #else
-    pid_t   pidWait;
-    int     rc;
-
     if (pWorker->fdSocket != -1)
     {
         if (close(pWorker->fdSocket) != 0)
@@ -687,16 +767,25 @@ static int kSubmitRespawnWorker(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker, in
         pWorker->fdSocket = -1;
     }
 
-    kill(pWorker->pid, SIGTERM);
-    pidWait = waitpid(pWorker->pid, &rc, 0);
-    if (pidWait != pWorker->pid)
-        warn(pCtx, "waitpid(pWorker->pid,,0)");
+    /* The process may already have been reaped by reap_children(). */
+    if (pWorker->pid != -1)
+    {
+        pid_t   pidWait;
+        int     rc;
+        kill(pWorker->pid, SIGTERM);
+        EINTRLOOP(pidWait, waitpid(pWorker->pid, &rc, 0));
+        if (pidWait != pWorker->pid)
+            warn(pCtx, "waitpid(pWorker->pid,,0)");
+    }
 #endif
 
     /*
      * Unlink it from the hash table.
      */
-    kSubmitPidHashRemove(pWorker);
+#ifndef KBUILD_OS_WINDOWS
+    if (pWorker->pid != -1)
+#endif
+        kSubmitPidHashRemove(pWorker);
 
     /*
      * Respawn it.
@@ -917,10 +1006,13 @@ static void *kSubmitComposeJobMessage(const char *pszExecutable, char **papszArg
  * @param   pvMsg               The message to send.
  * @param   cbMsg               The size of the message.
  * @param   fNoRespawning       Set if
+ * @param   pafdOutput          Standard output and error descriptors for the
+ *                              job to pass along with the message (POSIX).
+ *                              NULL if the worker should use its own.
  * @param   cVerbosity          The verbosity level.
  */
 static int kSubmitSendJobMessage(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker, void const *pvMsg, uint32_t cbMsg,
-                                 int fNoRespawning, int cVerbosity)
+                                 int fNoRespawning, int const *pafdOutput, int cVerbosity)
 {
     int cRetries;
 
@@ -972,22 +1064,53 @@ static int kSubmitSendJobMessage(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker, v
             || cRetries <= 0)
             return errx(pCtx, 1, "Error writing to worker: %u", dwErr);
 #else
-        ssize_t cbWritten
-        while ((cbWritten = write(pWorker->fdSocket, pbLeft, cbLeft)) >= 0)
+        ssize_t         cbWritten;
+        for (;;)
         {
-            assert(cbWritten <= cbLeft);
-            cbLeft -= cbWritten;
-            if (!cbLeft)
-                return 0;
-
-            pbLeft += cbWritten;
+            if (pbLeft == (uint8_t const *)pvMsg && pafdOutput)
+            {
+                /* The job output descriptors ride along with the first chunk. */
+                union
+                {
+                    struct cmsghdr  Hdr;
+                    char            ab[CMSG_SPACE(sizeof(int) * 2)];
+                } uCtl;
+                struct cmsghdr *pCMsgHdr;
+                struct msghdr   MsgHdr;
+                struct iovec    IoVec;
+                IoVec.iov_base = (void *)pbLeft;
+                IoVec.iov_len  = cbLeft;
+                memset(&MsgHdr, 0, sizeof(MsgHdr));
+                memset(&uCtl, 0, sizeof(uCtl));
+                MsgHdr.msg_iov        = &IoVec;
+                MsgHdr.msg_iovlen     = 1;
+                MsgHdr.msg_control    = uCtl.ab;
+                MsgHdr.msg_controllen = sizeof(uCtl.ab);
+                pCMsgHdr = CMSG_FIRSTHDR(&MsgHdr);
+                pCMsgHdr->cmsg_level = SOL_SOCKET;
+                pCMsgHdr->cmsg_type  = SCM_RIGHTS;
+                pCMsgHdr->cmsg_len   = CMSG_LEN(sizeof(int) * 2);
+                memcpy(CMSG_DATA(pCMsgHdr), pafdOutput, sizeof(int) * 2);
+                cbWritten = sendmsg(pWorker->fdSocket, &MsgHdr, KSUBMIT_SEND_FLAGS);
+            }
+            else
+                cbWritten = send(pWorker->fdSocket, pbLeft, cbLeft, KSUBMIT_SEND_FLAGS);
+            if (cbWritten >= 0)
+            {
+                assert((uint32_t)cbWritten <= cbLeft);
+                cbLeft -= (uint32_t)cbWritten;
+                if (!cbLeft)
+                    return 0;
+                pbLeft += cbWritten;
+            }
+            else if (errno != EINTR)
+                break;
         }
-        if (  (   errno != EPIPE
-               && errno != ENOTCONN
-               && errno != ECONNRESET))
+        if (   (   errno != EPIPE
+                && errno != ENOTCONN
+                && errno != ECONNRESET)
             || cRetries <= 0)
             return err(pCtx, 1, "Error writing to worker");
-# error "later"
 #endif
 
         /*
@@ -1022,9 +1145,12 @@ static void kSubmitCloseConnectOnExitingWorker(PKMKBUILTINCTX pCtx, PWORKERINSTA
         warnx(pCtx, "CloseHandle(pWorker->hPipe): %u", GetLastError());
     pWorker->hPipe = INVALID_HANDLE_VALUE;
 #else
-    if (close(pWorker->fdSocket) != 0)
-        warn(pCtx, "close(pWorker->fdSocket)");
-    pWorker->fdSocket = -1;
+    if (pWorker->fdSocket != -1)
+    {
+        if (close(pWorker->fdSocket) != 0)
+            warn(pCtx, "close(pWorker->fdSocket)");
+        pWorker->fdSocket = -1;
+    }
 #endif
 }
 
@@ -1271,9 +1397,174 @@ void kSubmitSubProcCleanup(intptr_t pvUser)
     kSubmitListAppend(&g_IdleList, pWorker);
 }
 
-#endif /* KBUILD_OS_WINDOWS */
+#else  /* !KBUILD_OS_WINDOWS */
+
+/**
+ * Reads more of the job result from a busy worker, without blocking.
+ *
+ * @returns 0 if we've got the whole result, -1 if more is pending.  A broken
+ *          connection completes the result with a failure status.
+ * @param   pCtx                The command execution context.
+ * @param   pWorker             The busy worker instance.
+ */
+static int kSubmitReadMoreResultPosix(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker)
+{
+    while (pWorker->cbResultRead < sizeof(pWorker->Result))
+    {
+        ssize_t cbRead = -1;
+        if (pWorker->fdSocket != -1)
+        {
+            struct pollfd PollFd;
+            int           rc;
+            PollFd.fd      = pWorker->fdSocket;
+            PollFd.events  = POLLIN;
+            PollFd.revents = 0;
+            EINTRLOOP(rc, poll(&PollFd, 1, 0 /*ms*/));
+            if (rc == 0)
+                return -1;
+            if (rc > 0)
+            {
+                EINTRLOOP(cbRead, read(pWorker->fdSocket, &pWorker->Result.ab[pWorker->cbResultRead],
+                                       sizeof(pWorker->Result) - pWorker->cbResultRead));
+                if (cbRead > 0)
+                {
+                    pWorker->cbResultRead += cbRead;
+                    continue;
+                }
+                if (cbRead == 0)
+                    errx(pCtx, 1, "Worker %ld closed the connection (read %u bytes)",
+                         (long)pWorker->pid, (unsigned)pWorker->cbResultRead);
+            }
+            if (cbRead != 0)
+                err(pCtx, 1, "Reading result from worker %ld failed", (long)pWorker->pid);
+        }
+
+        /* Complete the result. */
+        pWorker->Result.s.rcExit         = 127;
+        pWorker->Result.s.bWorkerExiting = 1;
+        pWorker->cbResultRead            = sizeof(pWorker->Result);
+    }
+    return 0;
+}
 
 
+/**
+ * Completes the job a worker was busy with, making the worker idle again.
+ *
+ * @returns The process ID of the worker, which is what the kmk child was
+ *          given as its process ID by kSubmitMarkActive.
+ * @param   pCtx                The command execution context.
+ * @param   pWorker             The busy worker instance with a complete result.
+ * @param   piStatus            Where to return the wait status for the job.
+ */
+static pid_t kSubmitPosixJobCompleted(PKMKBUILTINCTX pCtx, PWORKERINSTANCE pWorker, int *piStatus)
+{
+    pid_t   pid    = pWorker->pid;
+    int32_t rcExit = pWorker->Result.s.rcExit;
+    assert(pWorker->cbResultRead == sizeof(pWorker->Result));
+
+    *piStatus = (rcExit >= 0 && rcExit <= 255 ? rcExit : 255) << 8;
+    if (pWorker->Result.s.bWorkerExiting)
+        kSubmitCloseConnectOnExitingWorker(pCtx, pWorker);
+
+    pWorker->pBusyWith = NULL;
+    kSubmitListUnlink(&g_BusyList, pWorker);
+    kSubmitListAppend(&g_IdleList, pWorker);
+    return pid;
+}
+
+
+/**
+ * Gets the next job completed by a kWorker instance, if any.
+ *
+ * Called by reap_children() via kmk_builtin_async_reap(), since a job
+ * submitted to a worker completes without any process terminating.
+ *
+ * @returns Process ID of the worker, which is what the kmk child was given as
+ *          its process ID by kSubmitMarkActive.  0 if no job has completed.
+ * @param   piStatus            Where to return the wait status for the job.
+ */
+pid_t kSubmitPosixReapJob(int *piStatus)
+{
+    KMKBUILTINCTX   FakeCtx = { "kSubmit/reap", NULL };
+    PWORKERINSTANCE pWorker;
+    for (pWorker = g_BusyList.pHead; pWorker != NULL; pWorker = pWorker->pNext)
+        if (kSubmitReadMoreResultPosix(&FakeCtx, pWorker) == 0)
+            return kSubmitPosixJobCompleted(&FakeCtx, pWorker, piStatus);
+    return 0;
+}
+
+
+/**
+ * Gets the number of workers busy with a job.
+ */
+unsigned kSubmitPosixBusyWorkers(void)
+{
+    return g_BusyList.cEntries;
+}
+
+
+/**
+ * Adds the connections of the busy workers to a select() read set.
+ *
+ * This is used when waiting for children and for job server tokens, as the
+ * result of a job arrives on the connection and doesn't come with a SIGCHLD.
+ *
+ * @returns 0 if all connections were added, -1 if some were beyond FD_SETSIZE
+ *          and the caller must poll for them.
+ * @param   pReadFds            The read set to add the connections to.
+ * @param   pfdMax              The highest descriptor in the set (in/out).
+ */
+int kSubmitPosixAddBusyFds(fd_set *pReadFds, int *pfdMax)
+{
+    PWORKERINSTANCE pWorker;
+    int             rc = 0;
+    for (pWorker = g_BusyList.pHead; pWorker != NULL; pWorker = pWorker->pNext)
+        if (pWorker->fdSocket != -1)
+        {
+            if (pWorker->fdSocket < FD_SETSIZE)
+            {
+                FD_SET(pWorker->fdSocket, pReadFds);
+                if (pWorker->fdSocket > *pfdMax)
+                    *pfdMax = pWorker->fdSocket;
+            }
+            else
+                rc = -1;
+        }
+    return rc;
+}
+
+
+/**
+ * Updates the worker bookkeeping after reap_children() reaped a child process.
+ *
+ * If the process is a busy worker, the job it was running is considered failed
+ * and the wait status of the worker is what kmk will see for it.  The worker
+ * instance will be respawned the next time it is engaged.
+ *
+ * @param   pid                 The process ID of the reaped child.
+ */
+void kSubmitPosixChildReaped(pid_t pid)
+{
+    PWORKERINSTANCE pWorker = kSubmitFindWorkerByPid(pid);
+    if (pWorker)
+    {
+        KMKBUILTINCTX FakeCtx = { "kSubmit/reaped", NULL };
+        kSubmitCloseConnectOnExitingWorker(&FakeCtx, pWorker);
+        kSubmitPidHashRemove(pWorker);
+        if (pWorker->pBusyWith)
+        {
+            pWorker->pBusyWith = NULL;
+            kSubmitListUnlink(&g_BusyList, pWorker);
+            kSubmitListAppend(&g_IdleList, pWorker);
+        }
+    }
+}
+
+#endif /* !KBUILD_OS_WINDOWS */
+
+
+#ifdef KBUILD_OS_WINDOWS
 /**
  * atexit callback that trigger worker termination.
  */
@@ -1403,6 +1694,81 @@ static void kSubmitAtExitCallback(void)
     } /* outer wait loop */
 }
 
+#else  /* !KBUILD_OS_WINDOWS */
+
+/**
+ * atexit callback that trigger worker termination.
+ */
+static void kSubmitAtExitCallback(void)
+{
+    PWORKERINSTANCE pWorker;
+    unsigned        cMsWaited  = 0;
+    unsigned        cKillRaids = 0;
+    KMKBUILTINCTX   FakeCtx = { "kSubmit/atexit", NULL };
+    PKMKBUILTINCTX  pCtx = &FakeCtx;
+
+    /*
+     * Tell all the workers to exit by breaking the connection.
+     */
+    for (pWorker = g_IdleList.pHead; pWorker != NULL; pWorker = pWorker->pNext)
+        kSubmitCloseConnectOnExitingWorker(pCtx, pWorker);
+    for (pWorker = g_BusyList.pHead; pWorker != NULL; pWorker = pWorker->pNext)
+        kSubmitCloseConnectOnExitingWorker(pCtx, pWorker);
+
+    /*
+     * Wait a little while for them to stop.
+     */
+    for (;;)
+    {
+        PWORKERLIST const   apLists[2] = { &g_IdleList, &g_BusyList };
+        unsigned            cLeft = 0;
+        unsigned            iList;
+        struct timespec     SleepTs;
+
+        for (iList = 0; iList < 2; iList++)
+            for (pWorker = apLists[iList]->pHead; pWorker != NULL; pWorker = pWorker->pNext)
+                if (pWorker->pid != -1)
+                {
+                    int   iStatus;
+                    pid_t pidWait;
+                    EINTRLOOP(pidWait, waitpid(pWorker->pid, &iStatus, WNOHANG));
+                    if (pidWait == pWorker->pid || (pidWait < 0 && errno == ECHILD))
+                        kSubmitPidHashRemove(pWorker);
+                    else
+                        cLeft++;
+                }
+        if (cLeft == 0)
+            return;
+
+        if (cMsWaited >= 5000)
+        {
+            /* Terminate the whole bunch. */
+            cKillRaids++;
+            if (cKillRaids == 1 && getenv("KMK_KSUBMIT_NO_KILL") == NULL)
+            {
+                warnx(pCtx, "Killing %u lingering worker processe(s)!\n", cLeft);
+                for (iList = 0; iList < 2; iList++)
+                    for (pWorker = apLists[iList]->pHead; pWorker != NULL; pWorker = pWorker->pNext)
+                        if (pWorker->pid != -1)
+                            kill(pWorker->pid, SIGKILL);
+                cMsWaited = 4000; /* one more second */
+            }
+            else
+            {
+                warnx(pCtx, "Giving up on the last %u worker processe(s). :-(\n", cLeft);
+                return;
+            }
+        }
+
+        SleepTs.tv_sec  = 0;
+        SleepTs.tv_nsec = 10 * 1000 * 1000;
+        nanosleep(&SleepTs, NULL);
+        cMsWaited += 10;
+    }
+}
+
+#endif /* !KBUILD_OS_WINDOWS */
+
 
 static int kmk_builtin_kSubmit_usage(PKMKBUILTINCTX pCtx, int fIsErr)
 {
@@ -1478,7 +1844,11 @@ int kmk_builtin_kSubmit(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx,
      * Note! We only clean up the environment on successful return, assuming
      *       make will stop after that.
      */
+#ifdef KBUILD_OS_WINDOWS
     if (getcwd_fs(szCwd, cbCwdBuf) != NULL)
+#else
+    if (getcwd(szCwd, cbCwdBuf) != NULL)
+#endif
     { /* likely */ }
     else
         return err(pCtx, 1, "getcwd_fs failed\n");
@@ -1691,6 +2061,23 @@ int kmk_builtin_kSubmit(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx,
         PWORKERINSTANCE pWorker = kSubmitSelectWorkSpawnNewIfNecessary(pCtx, cBitsWorker, cVerbosity);
         if (pWorker)
         {
+            int const  *pafdOutput = NULL;
+#ifdef OUTPUT_WITH_PIPES
+            int         afdOutput[2];
+#endif
+#ifdef OUTPUT_WITH_PIPES
+            /* The job writes to the pipes of the kmk child, just like a job
+               started by kmk itself would, so give them to the worker. */
+            if (   pCtx->pOut
+                && pCtx->pOut->syncout
+                && output_pipe_open(pCtx->pOut) == 0)
+            {
+                afdOutput[0] = pCtx->pOut->child_out;
+                afdOutput[1] = pCtx->pOut->child_err;
+                pafdOutput   = afdOutput;
+            }
+            else
+#endif
             /* Before we send off the job, we should dump pending output, since
                the kWorker process currently does not coordinate its output with
                the output.c mechanics. */
@@ -1700,7 +2087,11 @@ int kmk_builtin_kSubmit(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx,
             if (pCtx->pOut)
 #endif
                 output_dump(pCtx->pOut);
-            rcExit = kSubmitSendJobMessage(pCtx, pWorker, pvMsg, cbMsg, 0 /*fNoRespawning*/, cVerbosity);
+            rcExit = kSubmitSendJobMessage(pCtx, pWorker, pvMsg, cbMsg, 0 /*fNoRespawning*/, pafdOutput, cVerbosity);
+#ifdef OUTPUT_WITH_PIPES
+            if (pafdOutput)
+                output_pipe_close_child(pCtx->pOut);
+#endif
             if (rcExit == 0)
                 rcExit = kSubmitMarkActive(pCtx, pWorker, cVerbosity, pChild, pPidSpawned);
 
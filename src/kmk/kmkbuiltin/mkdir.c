@@ -71,6 +71,11 @@ __FBSDID("$FreeBSD: src/bin/mkdir/mkdir.c,v 1.28 2004/04/06 20:06:48 markm Exp $
 #endif
 #include "kmkbuiltin.h"
 
+#if defined(CONFIG_WITH_KMK_BUILTIN_THREADS) && !defined(KMK_BUILTIN_STANDALONE)
+/* Commands on kmk's worker threads may be creating files, so we must not
+   change the process umask while they do, see kmk_builtin_thread_umask. */
+# define MKDIR_KEEP_UMASK
+#endif
 
 static struct option long_options[] =
 {
@@ -81,6 +86,7 @@ static struct option long_options[] =
 
 
 extern void * bsd_setmode(const char *p);
+extern void * bsd_setmode_umask(const char *p, mode_t mask);
 extern mode_t bsd_getmode(const void *bbox, mode_t omode);
 
 static int	build(PKMKBUILTINCTX pCtx, char *, mode_t, int);
@@ -128,7 +134,12 @@ kmk_builtin_mkdir(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
 	if (mode == NULL) {
 		omode = S_IRWXU | S_IRWXG | S_IRWXO;
 	} else {
-		if ((set = bsd_setmode(mode)) == NULL)
+#ifdef MKDIR_KEEP_UMASK
+		set = bsd_setmode_umask(mode, kmk_builtin_thread_umask(pCtx->pvWorker));
+#else
+		set = bsd_setmode(mode);
+#endif
+		if (set == NULL)
                         return errx(pCtx, 1, "invalid file mode: %s", mode);
 		omode = bsd_getmode(set, S_IRWXU | S_IRWXG | S_IRWXO);
 		free(set);
@@ -237,15 +248,22 @@ build(PKMKBUILTINCTX pCtx, char *path, mode_t omode, int vflag)
 			 *    mkdir [-m mode] dir
 			 *
 			 * We change the user's umask and then restore it,
-			 * instead of doing chmod's.
+			 * instead of doing chmod's.  (Except inside kmk.)
 			 */
+#ifdef MKDIR_KEEP_UMASK
+			oumask = kmk_builtin_thread_umask(pCtx->pvWorker);
+			(void)numask;
+#else
 			oumask = umask(0);
 			numask = oumask & ~(S_IWUSR | S_IXUSR);
 			(void)umask(numask);
+#endif
 			first = 0;
 		}
+#ifndef MKDIR_KEEP_UMASK
 		if (last)
 			(void)umask(oumask);
+#endif
 		if (mkdir(path, last ? omode : S_IRWXU | S_IRWXG | S_IRWXO) < 0) {
 			if (errno == EEXIST || errno == EISDIR
 			    || errno == ENOSYS  /* (solaris crap) */
@@ -268,13 +286,21 @@ build(PKMKBUILTINCTX pCtx, char *path, mode_t omode, int vflag)
 				retval = 1;
 				break;
 			}
-		} else if (vflag)
-			kmk_builtin_ctx_printf(pCtx, 0, "%s\n", path);
+		} else {
+#ifdef MKDIR_KEEP_UMASK
+			if (!last && (oumask & (S_IWUSR | S_IXUSR)))
+				(void)chmod(path, ((S_IRWXU | S_IRWXG | S_IRWXO) & ~oumask) | S_IWUSR | S_IXUSR);
+#endif
+			if (vflag)
+				kmk_builtin_ctx_printf(pCtx, 0, "%s\n", path);
+		}
 		if (!last)
 		    *p = '/';
 	}
+#ifndef MKDIR_KEEP_UMASK
 	if (!first && !last)
 		(void)umask(oumask);
+#endif
 	return (retval);
 }
 
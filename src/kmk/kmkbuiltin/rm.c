@@ -439,7 +439,7 @@ rm_tree(PRMINSTANCE pThis, char **argv)
 				if (rval == 0 || (pThis->fflag && errno == ENOENT)) {
 					if (rval == 0 && pThis->vflag)
 						kmk_builtin_ctx_printf(pThis->pCtx, 0, "%s\n", p->fts_path);
-#if defined(KMK) && defined(KBUILD_OS_WINDOWS)
+#if defined(KMK) && (defined(KBUILD_OS_WINDOWS) || defined(CONFIG_WITH_DIRCACHE))
 					if (rval == 0) {
 					    extern int dir_cache_deleted_directory(const char *pszDir);
 					    dir_cache_deleted_directory(p->fts_accpath);
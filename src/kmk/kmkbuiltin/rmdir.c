@@ -99,7 +99,7 @@ static struct option long_options[] =
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
-#if !defined(KMK_BUILTIN_STANDALONE) && defined(KBUILD_OS_WINDOWS)
+#if !defined(KMK_BUILTIN_STANDALONE) && (defined(KBUILD_OS_WINDOWS) || defined(CONFIG_WITH_DIRCACHE))
 extern int dir_cache_deleted_directory(const char *pszDir);
 #endif
 static int rm_path(PRMDIRINSTANCE, char *);
@@ -164,7 +164,7 @@ kmk_builtin_rmdir(int argc, char **argv, char **envp, PKMKBUILTINCTX pCtx)
 				continue;
 			/* (only ignored doesn't exist errors fall thru) */
 		} else {
-#if !defined(KMK_BUILTIN_STANDALONE) && defined(KBUILD_OS_WINDOWS)
+#if !defined(KMK_BUILTIN_STANDALONE) && (defined(KBUILD_OS_WINDOWS) || defined(CONFIG_WITH_DIRCACHE))
 			dir_cache_deleted_directory(*argv);
 #endif
 			if (This.vflag)
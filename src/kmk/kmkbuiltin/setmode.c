@@ -81,6 +81,7 @@ typedef struct bitcmd {
 #define	CMD2_OBITS	0x08
 #define	CMD2_UBITS	0x10
 
+void		*bsd_setmode_umask(const char *, mode_t);
 static BITCMD	*addcmd(BITCMD *, int, int, int, u_int);
 static void	 compress_mode(BITCMD *);
 #ifdef SETMODE_DEBUG
@@ -199,34 +200,47 @@ void *
 bsd_setmode(p)
 	const char *p;
 {
-	int perm, who;
-	char op, *ep;
-	BITCMD *set, *saveset, *endset;
+	mode_t mask;
 #ifndef _MSC_VER
 	sigset_t signset, sigoset;
 #endif
-	mode_t mask;
-	int equalopdone = 0;	/* pacify gcc */
-	int permXbits, setlen;
-
-	if (!*p)
-		return (NULL);
 
 	/*
 	 * Get a copy of the mask for the permissions that are mask relative.
-	 * Flip the bits, we want what's not set.  Since it's possible that
-	 * the caller is opening files inside a signal handler, protect them
-	 * as best we can.
+	 * Since it's possible that the caller is opening files inside a signal
+	 * handler, protect them as best we can.
 	 */
 #ifndef _MSC_VER
 	sigfillset(&signset);
 	(void)sigprocmask(SIG_BLOCK, &signset, &sigoset);
 #endif
 	(void)umask(mask = umask(0));
-	mask = ~mask;
 #ifndef _MSC_VER
 	(void)sigprocmask(SIG_SETMASK, &sigoset, NULL);
 #endif
+	return (bsd_setmode_umask(p, mask));
+}
+
+/*
+ * Same as bsd_setmode, except that the caller supplies the umask.  Inside
+ * kmk, commands running on a worker thread must use this, as temporarily
+ * changing the process umask would affect the children the main thread
+ * creates meanwhile (kmk_builtin_thread_umask).
+ */
+void *
+bsd_setmode_umask(const char *p, mode_t mask)
+{
+	int perm, who;
+	char op, *ep;
+	BITCMD *set, *saveset, *endset;
+	int equalopdone = 0;	/* pacify gcc */
+	int permXbits, setlen;
+
+	if (!*p)
+		return (NULL);
+
+	/* Flip the bits, we want what's not set. */
+	mask = ~mask;
 
 	setlen = SET_LEN + 2;
 
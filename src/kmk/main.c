@@ -410,6 +410,12 @@ int process_priority = 0;
 int process_affinity = 0;
 #endif /* KMK */
 
+#ifdef CONFIG_WITH_INCLUDEDEP
+/* Max number of includedep worker threads; 0 means automatic. */
+
+int incdep_threads_option = 0;
+#endif
+
 #if defined (CONFIG_WITH_MAKE_STATS) || defined (CONFIG_WITH_MINIMAL_STATS)
 /* When set, we'll gather expensive statistics like for the heap. */
 
@@ -533,6 +539,10 @@ static const char *const usage[] =
     N_("\
   --nice                      Alias for --priority=1\n"),
 #endif /* KMK */
+#ifdef CONFIG_WITH_INCLUDEDEP
+    N_("\
+  --incdep-threads=N          Max number of threads reading includedep files.\n"),
+#endif
 #ifdef CONFIG_PRETTY_COMMAND_PRINTING
     N_("\
   --pretty-command-printing   Makes the command echo easier to read.\n"),
@@ -592,6 +602,10 @@ static const struct command_switch switches[] =
     { CHAR_MAX+15, positive_int, (char *) &process_affinity, 1, 1, 0,
       (char *) &process_affinity, (char *) &process_affinity, "affinity" },
     { CHAR_MAX+17, flag, (char *) &process_priority, 1, 1, 0, 0, 0, "nice" },
+#endif
+#ifdef CONFIG_WITH_INCLUDEDEP
+    { CHAR_MAX+18, positive_int, (char *) &incdep_threads_option, 1, 1, 0,
+      (char *) &incdep_threads_option, (char *) &incdep_threads_option, "incdep-threads" },
 #endif
     { 'q', flag, &question_flag, 1, 1, 1, 0, 0, "question" },
     { 'r', flag, &no_builtin_rules_flag, 1, 1, 0, 0, 0, "no-builtin-rules" },
@@ -1486,7 +1500,7 @@ static BOOL WINAPI ctrl_event(DWORD CtrlType)
 #ifdef KMK
 /* Determins the number of CPUs that are currently online.
    This is used to setup the default number of job slots. */
-static int
+int
 get_online_cpu_count(void)
 {
 # ifdef WINDOWS32
@@ -3287,6 +3301,9 @@ main (int argc, char **argv, char **envp)
 
   DB (DB_BASIC, (_("Updating goal targets....\n")));
 
+#ifdef CONFIG_WITH_DIRCACHE
+  prefetch_goal_mtimes (goals);
+#endif
   {
     switch (update_goal_chain (goals))
     {
@@ -4332,6 +4349,13 @@ die (int status)
       /* Remove the intermediate files.  */
       remove_intermediates (0);
 
+#ifdef CONFIG_WITH_JOB_HISTORY
+      job_history_save ();
+#endif
+#ifdef CONFIG_WITH_CMD_DB
+      cmd_db_save ();
+#endif
+
       if (print_data_base_flag)
         print_data_base ();
 
@@ -678,6 +678,24 @@ char *end_of_token (const char *);
 #ifdef KMK
 char *find_next_token_eos (const char **ptr, const char *eos, unsigned int *lengthptr);
 #endif
+#ifdef CONFIG_WITH_SPLIT_WORDS
+/* A word found by split_words.  */
+struct word_ref
+  {
+    const char *str;            /* Start of the word (not terminated). */
+    unsigned int len;           /* The word length. */
+  };
+/* The words of a string, as split by split_words.  */
+struct word_list
+  {
+    struct word_ref *words;     /* The words, the heap or inline_words. */
+    unsigned int count;         /* Number of words. */
+    unsigned int alloc;         /* Number of entries allocated. */
+    struct word_ref inline_words[64];
+  };
+void split_words (struct word_list *list, const char *text);
+void free_word_list (struct word_list *list);
+#endif
 #ifndef CONFIG_WITH_VALUE_LENGTH
 void collapse_continuations (char *);
 #else
@@ -1170,13 +1188,38 @@ extern char *expr_eval_to_string(char *o, const char *expr);
 #ifdef KMK
 extern char *abspath(const char *name, char *apath);
 extern char *func_breakpoint(char *o, char **argv, const char *funcname);
-# ifdef KBUILD_OS_WINDOWS
+extern int get_online_cpu_count(void);
+# if defined (KBUILD_OS_WINDOWS) || defined (CONFIG_WITH_DIRCACHE)
 extern void dir_cache_invalid_after_job (void);
 extern void dir_cache_invalid_all (void);
 extern void dir_cache_invalid_missing (void);
 extern int dir_cache_volatile_dir (const char *dir);
 extern int dir_cache_deleted_directory(const char *pszDir);
 # endif
+# ifdef CONFIG_WITH_JOB_HISTORY
+/* jobhist.c */
+struct file;
+struct dep;
+extern void job_history_record (struct file *file, big_int elapsed);
+extern void job_history_save (void);
+extern struct dep **job_history_sort_deps (struct dep *deps);
+# endif
+# ifdef CONFIG_WITH_CMD_DB
+/* cmddb.c */
+extern int cmd_db_check (struct file *file, const char *cmds, size_t len);
+extern void cmd_db_record (struct file *file);
+extern void cmd_db_save (void);
+# endif
+# ifdef CONFIG_WITH_DIRCACHE
+/* dircache-posix.c */
+struct stat;
+extern void dir_cache_init (void);
+extern int dir_cache_stat (const char *path, struct stat *st);
+extern int dir_cache_is_known_missing (const char *path, unsigned int len);
+extern void dir_cache_prefetch (const char * const *paths, unsigned int count,
+                                unsigned int threads);
+extern void dir_cache_print_stats (void);
+# endif
 #endif
 
 #if defined (CONFIG_WITH_NANOTS) || defined (CONFIG_WITH_PRINT_TIME_SWITCH) || defined(CONFIG_WITH_KMK_BUILTIN_STATS)
@@ -45,6 +45,17 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifdef KBUILD_OS_WINDOWS
 # include "console.h"
 #endif
+#ifdef OUTPUT_WITH_PIPES
+# include <poll.h>
+# include <pthread.h>
+# include <sys/ioctl.h>
+# ifdef KBUILD_OS_SOLARIS
+#  include <sys/filio.h>
+# endif
+# include <signal.h>
+# include <stddef.h>
+# include <time.h>
+#endif
 
 struct output *output_context = NULL;
 unsigned int stdio_traced = 0;
@@ -77,15 +88,59 @@ static int   log_working_directory (int);
    Also, did we already sync_init (== -1)?  */
 static int combined_output = -1;
 
+# ifdef OUTPUT_WITH_PIPES
+/* Record header in the overflow file. */
+struct output_spill_hdr
+{
+    unsigned int is_err;
+    unsigned int len;
+};
+
+static void membuf_unspill (struct output *out);
+# endif
+
+/* Frees all the segments and resets the buffers of OUT. */
+static void membuf_free_segments (struct output *out)
+{
+  struct output_segment *seg;
+
+  while ((seg = out->out.head_seg))
+    {
+     out->out.head_seg = seg->next;
+     free (seg);
+    }
+  out->out.tail_seg = NULL;
+  out->out.tail_run = NULL;
+  out->out.head_run = NULL;
+  out->out.left     = 0;
+  out->out.total    = 0;
+
+  while ((seg = out->err.head_seg))
+    {
+     out->err.head_seg = seg->next;
+     free (seg);
+    }
+  out->err.tail_seg = NULL;
+  out->err.tail_run = NULL;
+  out->err.head_run = NULL;
+  out->err.left     = 0;
+  out->err.total    = 0;
+
+  out->seqno = 0;
+}
+
 /* Internal worker for output_dump and membuf_dump_most. */
 static void membuf_dump (struct output *out)
 {
-  if (out->out.total || out->err.total)
+  if (out->out.total || out->err.total
+# ifdef OUTPUT_WITH_PIPES
+      || out->spill_fd >= 0
+# endif
+      )
     {
       int traced = 0;
       struct output_run *err_run;
       struct output_run *out_run;
-      struct output_segment *seg;
       FILE *prevdst;
 
       /* Try to acquire the semaphore.  If it fails, dump the output
@@ -103,6 +158,12 @@ static void membuf_dump (struct output *out)
         traced = log_working_directory (1);
 # endif
 
+# ifdef OUTPUT_WITH_PIPES
+      /* Whatever overflowed to disk goes first. */
+      if (out->spill_fd >= 0)
+        membuf_unspill (out);
+# endif
+
       /* Work the out and err sequences in parallel. */
       out_run = out->out.head_run;
       err_run = out->err.head_run;
@@ -172,32 +233,136 @@ static void membuf_dump (struct output *out)
         release_semaphore (sem);
 
       /* Free the segments and reset the state. */
-      while ((seg = out->out.head_seg))
+      membuf_free_segments (out);
+    }
+  else
+    assert (out->out.head_seg == NULL && out->err.head_seg == NULL);
+}
+
+# ifdef OUTPUT_WITH_PIPES
+/* Writes LEN bytes to FD, returns 0 on success and -1 on failure. */
+static int
+spill_write (int fd, const void *src, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t r;
+      EINTRLOOP (r, write (fd, src, len));
+      if (r <= 0)
+        return -1;
+      src = (const char *)src + r;
+      len -= r;
+    }
+  return 0;
+}
+
+/* Moves the buffered output of OUT to the overflow file, keeping the
+   order of the runs.  This way big outputs neither eat all the memory nor
+   get written out before the job completes.  Returns 0 on success and -1
+   if we couldn't create the overflow file.  */
+static int
+membuf_spill (struct output *out)
+{
+  struct output_run *out_run = out->out.head_run;
+  struct output_run *err_run = out->err.head_run;
+  int fd = out->spill_fd;
+
+  if (fd < 0)
+    {
+      FILE *tfile = tmpfile ();
+      if (!tfile)
+        return -1;
+      fd = dup (fileno (tfile));
+      fclose (tfile);
+      if (fd < 0)
+        return -1;
+      CLOSE_ON_EXEC (fd);
+      out->spill_fd = fd;
+    }
+
+  while (out_run || err_run)
+    {
+      struct output_spill_hdr hdr;
+      const char *src;
+      if (out_run && (!err_run || out_run->seqno <= err_run->seqno))
         {
-         out->out.head_seg = seg->next;
-         free (seg);
+          hdr.is_err = 0;
+          hdr.len    = out_run->len;
+          src        = (const char *)(out_run + 1);
+          out_run    = out_run->next;
         }
-      out->out.tail_seg = NULL;
-      out->out.tail_run = NULL;
-      out->out.head_run = NULL;
-      out->out.left     = 0;
-      out->out.total    = 0;
-
-      while ((seg = out->err.head_seg))
+      else
         {
-         out->err.head_seg = seg->next;
-         free (seg);
+          hdr.is_err = 1;
+          hdr.len    = err_run->len;
+          src        = (const char *)(err_run + 1);
+          err_run    = err_run->next;
         }
-      out->err.tail_seg = NULL;
-      out->err.tail_run = NULL;
-      out->err.head_run = NULL;
-      out->err.left     = 0;
-      out->err.total    = 0;
+      if (hdr.len > 0
+          && (   spill_write (fd, &hdr, sizeof (hdr)) != 0
+              || spill_write (fd, src, hdr.len) != 0))
+        {
+          perror ("write()");
+          break;
+        }
+    }
+
+  membuf_free_segments (out);
+  return 0;
+}
+
+/* Writes the content of the overflow file to stdout and stderr and closes
+   it.  Called by membuf_dump while owning the semaphore. */
+static void
+membuf_unspill (struct output *out)
+{
+  int fd = out->spill_fd;
+  FILE *prevdst = NULL;
+  struct output_spill_hdr hdr;
+  char buf[8192];
 
-      out->seqno = 0;
+  if (lseek (fd, 0, SEEK_SET) == -1)
+    perror ("lseek()");
+  for (;;)
+    {
+      FILE *dst;
+      ssize_t r;
+      EINTRLOOP (r, read (fd, &hdr, sizeof (hdr)));
+      if (r != sizeof (hdr))
+        break;
+      dst = hdr.is_err ? stderr : stdout;
+      if (dst != prevdst && prevdst)
+        fflush (prevdst);
+      prevdst = dst;
+      while (hdr.len > 0)
+        {
+          size_t chunk = hdr.len < sizeof (buf) ? hdr.len : sizeof (buf);
+          EINTRLOOP (r, read (fd, buf, chunk));
+          if (r <= 0)
+            break;
+          fwrite (buf, r, 1, dst);
+          hdr.len -= r;
+        }
+      if (hdr.len > 0)
+        break;
     }
-  else
-    assert (out->out.head_seg == NULL && out->err.head_seg == NULL);
+  if (prevdst)
+    fflush (prevdst);
+
+  close (fd);
+  out->spill_fd = -1;
+}
+# endif /* OUTPUT_WITH_PIPES */
+
+/* Gets rid of the buffered output of OUT when we've hit MEMBUF_MAX_TOTAL. */
+static void
+membuf_overflow (struct output *out)
+{
+# ifdef OUTPUT_WITH_PIPES
+  if (membuf_spill (out) == 0)
+    return;
+# endif
+  membuf_dump (out);
 }
 
 /* Writes up to LEN bytes to the given segment.
@@ -348,9 +513,9 @@ membuf_write_new_segment (struct output_membuf *membuf, const char *src,
   return written;
 }
 
-/* Worker for output_write that will dump most of the output when we hit
-   MEMBUF_MAX_TOTAL on either of the two membuf structures, then free all the
-   output segments.  Incomplete lines will be held over to the next buffers
+/* Worker for output_write that will dump (or on POSIX spill to disk) most of
+   the output when we hit MEMBUF_MAX_TOTAL on either of the two membuf
+   structures, then free all the output segments.  Incomplete lines will be held over to the next buffers
    and copied into new segments. */
 static void
 membuf_dump_most (struct output *out)
@@ -358,7 +523,7 @@ membuf_dump_most (struct output *out)
   size_t out_to_move = membuf_calc_move_len (out->out.tail_run);
   size_t err_to_move = membuf_calc_move_len (out->err.tail_run);
   if (!out_to_move && !err_to_move)
-    membuf_dump (out);
+    membuf_overflow (out);
   else
     {
       /* Allocate a stack buffer for holding incomplete lines.  This should be
@@ -383,7 +548,7 @@ membuf_dump_most (struct output *out)
                   err_to_move);
         }
 
-      membuf_dump (out);
+      membuf_overflow (out);
 
       if (out_to_move)
         {
@@ -449,6 +614,89 @@ output_write_bin (struct output *out, int is_err, const char *src, size_t len)
   return ret;
 }
 
+#ifdef CONFIG_WITH_KMK_BUILTIN_SHELL
+/* Appends LEN bytes at SRC to the heap buffer *BUFP of size *SIZEP holding
+   *LENP bytes, keeping room for a terminator.  */
+static void
+take_out_append (char **bufp, size_t *sizep, size_t *lenp,
+                 const char *src, size_t len)
+{
+  if (*lenp + len >= *sizep)
+    {
+      while (*lenp + len >= *sizep)
+        *sizep *= 2;
+      *bufp = xrealloc (*bufp, *sizep);
+    }
+  memcpy (*bufp + *lenp, src, len);
+  *lenp += len;
+}
+
+/* Takes the standard output buffered by OUT, for $(shell ) running kmk
+   built-in commands in-process.  The standard error output is written out
+   as usual.  Returns a heap buffer with room for a terminator and sets
+   *LENP to the length of the output.  OUT is reset.  */
+char *
+output_take_out (struct output *out, size_t *lenp)
+{
+  size_t size = 256;
+  size_t len = 0;
+  char *buf = xmalloc (size);
+  struct output_run *run;
+
+# ifdef OUTPUT_WITH_PIPES
+  /* Anything that overflowed to disk comes first.  */
+  if (out->spill_fd >= 0)
+    {
+      struct output_spill_hdr hdr;
+      char tmp[8192];
+      ssize_t r;
+
+      if (lseek (out->spill_fd, 0, SEEK_SET) == -1)
+        perror ("lseek()");
+      for (;;)
+        {
+          EINTRLOOP (r, read (out->spill_fd, &hdr, sizeof (hdr)));
+          if (r != sizeof (hdr))
+            break;
+          while (hdr.len > 0)
+            {
+              size_t chunk = hdr.len < sizeof (tmp) ? hdr.len : sizeof (tmp);
+              EINTRLOOP (r, read (out->spill_fd, tmp, chunk));
+              if (r <= 0)
+                break;
+              if (hdr.is_err)
+                fwrite (tmp, r, 1, stderr);
+              else
+                take_out_append (&buf, &size, &len, tmp, r);
+              hdr.len -= r;
+            }
+          if (hdr.len > 0)
+            break;
+        }
+      fflush (stderr);
+      close (out->spill_fd);
+      out->spill_fd = -1;
+    }
+# endif
+
+  for (run = out->out.head_run; run; run = run->next)
+    take_out_append (&buf, &size, &len, (const char *)(run + 1), run->len);
+
+  /* The standard error output goes straight out, like when the shell
+     writes it.  */
+  if (out->err.head_run)
+    {
+      for (run = out->err.head_run; run; run = run->next)
+        fwrite (run + 1, run->len, 1, stderr);
+      fflush (stderr);
+    }
+  membuf_free_segments (out);
+
+  *lenp = len;
+  return buf;
+}
+#endif /* CONFIG_WITH_KMK_BUILTIN_SHELL */
+
 #endif /* CONFIG_WITH_OUTPUT_IN_MEMORY */
 
 /* write/fwrite like function, text mode. */
@@ -939,6 +1187,375 @@ output_dump (struct output *out)
 #endif
 }
 #endif /* NO_OUTPUT_SYNC */
+
+#ifdef OUTPUT_WITH_PIPES
+
+/* Child output collection for POSIX.
+
+   Children whose output is synchronized get pipes for stdout and stderr
+   (one pipe if both go to the same place).  A single thread polls all the
+   read ends and appends whatever arrives to the membufs of the job, so no
+   temporary files need creating, copying and deleting.  When a child has
+   been reaped, output_pipe_wait waits for the pipes to reach EOF before the
+   output is dumped.
+
+   The mutex only protects the pipe table and the counters; the thread does
+   the reading and the (possibly spilling) appending without holding it.  */
+
+/* How often to check the pipes of a reaped child that haven't reached EOF
+   yet.  If they are all empty by then, some background process is holding
+   on to them and we stop waiting.  */
+# define OUTPUT_PIPE_LINGER_MS 20
+/* The max time to wait for such pipes while output keeps coming. */
+# define OUTPUT_PIPE_TIMEOUT_MS 2000
+
+/* pipe2 gets the pipe created close-on-exec atomically, which matters as the
+   pipes are created while other threads (kash, kSubmit) may be spawning. */
+# if defined (O_CLOEXEC) \
+  && (   defined (KBUILD_OS_LINUX) || defined (KBUILD_OS_FREEBSD) \
+      || defined (KBUILD_OS_NETBSD) || defined (KBUILD_OS_OPENBSD))
+#  define OUTPUT_PIPE_HAVE_PIPE2
+# endif
+
+/* A pipe the output thread is reading. */
+struct output_pipe
+{
+  int fd;                   /* The read end, -1 when closed.  */
+  int is_err;               /* Set if this is stderr output.  */
+  struct output *out;       /* Where to put it, NULL when passing thru.  */
+};
+
+static pthread_mutex_t output_pipe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  output_pipe_cond  = PTHREAD_COND_INITIALIZER;
+static struct output_pipe *output_pipes = NULL;
+static unsigned int output_pipe_count = 0;
+static unsigned int output_pipe_alloc = 0;
+/* Pipe for waking up the thread when new pipes are added. */
+static int output_pipe_wakeup[2] = { -1, -1 };
+static int output_pipe_thread_started = 0;
+/* The output the thread is appending to without holding the mutex. */
+static struct output *output_pipe_busy = NULL;
+
+/* Creates a pipe with both ends close-on-exec.  Returns 0 on success. */
+static int
+output_pipe_create (int fds[2])
+{
+# ifdef OUTPUT_PIPE_HAVE_PIPE2
+  if (pipe2 (fds, O_CLOEXEC) == 0)
+    return 0;
+  if (errno != ENOSYS)
+    return -1;
+# endif
+  if (pipe (fds) != 0)
+    return -1;
+  CLOSE_ON_EXEC (fds[0]);
+  CLOSE_ON_EXEC (fds[1]);
+  return 0;
+}
+
+/* Writes output that no job wants any more straight to stdout/stderr. */
+static void
+output_pipe_passthru (int is_err, const char *src, size_t len)
+{
+  int fd = is_err ? FD_STDERR : FD_STDOUT;
+  while (len > 0)
+    {
+      ssize_t r;
+      EINTRLOOP (r, write (fd, src, len));
+      if (r <= 0)
+        break;
+      src += r;
+      len -= r;
+    }
+}
+
+/* The output thread. */
+static void *
+output_pipe_thread (void *ignored)
+{
+  static char buf[32768];
+  struct pollfd *fds = NULL;
+  unsigned int fds_alloc = 0;
+  (void)ignored;
+
+  for (;;)
+    {
+      unsigned int i, j, n;
+      int closed = 0;
+      int rc;
+
+      /* Snapshot the pipes.  Only this thread removes entries, so the first
+         N entries stay put while we're polling.  */
+      pthread_mutex_lock (&output_pipe_mutex);
+      n = output_pipe_count;
+      if (n + 1 > fds_alloc)
+        {
+          fds_alloc = n + 32;
+          fds = xrealloc (fds, fds_alloc * sizeof (fds[0]));
+        }
+      fds[0].fd = output_pipe_wakeup[0];
+      fds[0].events = POLLIN;
+      for (i = 0; i < n; i++)
+        {
+          fds[i + 1].fd = output_pipes[i].fd;
+          fds[i + 1].events = POLLIN;
+        }
+      pthread_mutex_unlock (&output_pipe_mutex);
+
+      rc = poll (fds, n + 1, -1);
+      if (rc <= 0)
+        continue;
+
+      if (fds[0].revents)
+        {
+          char tmp[64];
+          while (read (output_pipe_wakeup[0], tmp, sizeof (tmp)) > 0)
+            ;
+        }
+
+      for (i = 0; i < n; i++)
+        if (fds[i + 1].revents)
+          {
+            /* Only this thread closes the descriptors, but output_pipe_add
+               may reallocate the table, so only index it under the mutex.
+               OUT is marked busy so it isn't detached while we're reading
+               and appending.  */
+            struct output *out;
+            int is_err;
+            ssize_t cb;
+            int err;
+
+            pthread_mutex_lock (&output_pipe_mutex);
+            out = output_pipes[i].out;
+            is_err = output_pipes[i].is_err;
+            output_pipe_busy = out;
+            pthread_mutex_unlock (&output_pipe_mutex);
+
+            cb = read (fds[i + 1].fd, buf, sizeof (buf));
+            err = cb < 0 ? errno : 0;
+            if (cb > 0)
+              {
+                if (out)
+                  output_write_bin (out, is_err, buf, cb);
+                else
+                  output_pipe_passthru (is_err, buf, cb);
+              }
+
+            pthread_mutex_lock (&output_pipe_mutex);
+            output_pipe_busy = NULL;
+            if (cb == 0 || (cb < 0 && err != EINTR && err != EAGAIN))
+              {
+                close (output_pipes[i].fd);
+                output_pipes[i].fd = -1;
+                if (output_pipes[i].out)
+                  output_pipes[i].out->pipes_pending--;
+                closed = 1;
+              }
+            pthread_cond_broadcast (&output_pipe_cond);
+            pthread_mutex_unlock (&output_pipe_mutex);
+          }
+
+      if (closed)
+        {
+          pthread_mutex_lock (&output_pipe_mutex);
+          for (i = j = 0; i < output_pipe_count; i++)
+            if (output_pipes[i].fd >= 0)
+              output_pipes[j++] = output_pipes[i];
+          output_pipe_count = j;
+          pthread_cond_broadcast (&output_pipe_cond);
+          pthread_mutex_unlock (&output_pipe_mutex);
+        }
+    }
+  return NULL;
+}
+
+/* Starts the output thread.  Returns 0 on success, -1 on failure. */
+static int
+output_pipe_start_thread (void)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  sigset_t all, saved;
+  int rc;
+
+  if (output_pipe_create (output_pipe_wakeup) != 0)
+    return -1;
+  fcntl (output_pipe_wakeup[0], F_SETFL, O_NONBLOCK);
+  fcntl (output_pipe_wakeup[1], F_SETFL, O_NONBLOCK);
+
+  /* Signals are the main thread's business. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &saved);
+  rc = pthread_attr_init (&attr);
+  if (rc == 0)
+    {
+      pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+      pthread_attr_setstacksize (&attr, 256*1024);
+      rc = pthread_create (&thread, &attr, output_pipe_thread, NULL);
+      pthread_attr_destroy (&attr);
+    }
+  pthread_sigmask (SIG_SETMASK, &saved, NULL);
+
+  if (rc != 0)
+    {
+      close (output_pipe_wakeup[0]);
+      close (output_pipe_wakeup[1]);
+      output_pipe_wakeup[0] = output_pipe_wakeup[1] = -1;
+      return -1;
+    }
+  output_pipe_thread_started = 1;
+  return 0;
+}
+
+/* Adds a read end to the output thread.  Called with the mutex held. */
+static void
+output_pipe_add (int fd, int is_err, struct output *out)
+{
+  if (output_pipe_count >= output_pipe_alloc)
+    {
+      output_pipe_alloc = output_pipe_alloc ? output_pipe_alloc * 2 : 64;
+      output_pipes = xrealloc (output_pipes,
+                               output_pipe_alloc * sizeof (output_pipes[0]));
+    }
+  fcntl (fd, F_SETFL, O_NONBLOCK);
+  output_pipes[output_pipe_count].fd = fd;
+  output_pipes[output_pipe_count].is_err = is_err;
+  output_pipes[output_pipe_count].out = out;
+  output_pipe_count++;
+  out->pipes_pending++;
+}
+
+/* Creates the pipes for a child whose output goes to OUT, setting
+   OUT->child_out and OUT->child_err to the write ends.  Returns 0 on
+   success, -1 on failure (the child should then use our stdout/stderr).  */
+int
+output_pipe_open (struct output *out)
+{
+  int out_fds[2];
+  int err_fds[2] = { -1, -1 };
+
+  if (combined_output < 0)
+    combined_output = sync_init ();
+  if (!output_sync)
+    return -1;
+  if (!output_pipe_thread_started && output_pipe_start_thread () != 0)
+    return -1;
+
+  if (output_pipe_create (out_fds) != 0)
+    return -1;
+  if (!combined_output && output_pipe_create (err_fds) != 0)
+    {
+      close (out_fds[0]);
+      close (out_fds[1]);
+      return -1;
+    }
+
+  pthread_mutex_lock (&output_pipe_mutex);
+  output_pipe_add (out_fds[0], 0, out);
+  if (err_fds[0] >= 0)
+    output_pipe_add (err_fds[0], 1, out);
+  pthread_mutex_unlock (&output_pipe_mutex);
+  if (write (output_pipe_wakeup[1], "", 1) < 0)
+    { /* Already full, so the thread will wake up anyway. */ }
+
+  out->child_out = out_fds[1];
+  out->child_err = err_fds[1] >= 0 ? err_fds[1] : out_fds[1];
+  return 0;
+}
+
+/* Closes our copy of the pipe write ends after the child has been created,
+   so that the pipes reach EOF when the child is done with them.  */
+void
+output_pipe_close_child (struct output *out)
+{
+  if (out->child_err >= 0 && out->child_err != out->child_out)
+    close (out->child_err);
+  if (out->child_out >= 0)
+    close (out->child_out);
+  out->child_out = out->child_err = -1;
+}
+
+/* Checks that the pipes of OUT which haven't reached EOF are all empty and
+   that the thread isn't appending anything to OUT.  Called with the mutex
+   held.  */
+static int
+output_pipe_is_idle (struct output *out)
+{
+  unsigned int i;
+
+  if (output_pipe_busy == out)
+    return 0;
+  for (i = 0; i < output_pipe_count; i++)
+    if (output_pipes[i].out == out && output_pipes[i].fd >= 0)
+      {
+# ifdef FIONREAD
+        int cb = 0;
+        if (ioctl (output_pipes[i].fd, FIONREAD, &cb) != 0 || cb != 0)
+          return 0;
+# else
+        return 0; /* Can't tell, so wait for the timeout. */
+# endif
+      }
+  return 1;
+}
+
+/* Adds MS milliseconds to *TS. */
+static void
+output_pipe_add_ms (struct timespec *ts, unsigned int ms)
+{
+  ts->tv_nsec += ms % 1000 * 1000000L;
+  ts->tv_sec  += ms / 1000 + ts->tv_nsec / 1000000000L;
+  ts->tv_nsec %= 1000000000L;
+}
+
+/* Waits for the output thread to finish reading the pipes of OUT after the
+   child has been reaped.  The pipes are checked every OUTPUT_PIPE_LINGER_MS
+   and if the ones still open are empty, something left running in the
+   background is holding on to them and we let whatever it writes later pass
+   straight thru.  The same happens if they haven't reached EOF after
+   OUTPUT_PIPE_TIMEOUT_MS.  */
+void
+output_pipe_wait (struct output *out)
+{
+  struct timespec deadline;
+
+  clock_gettime (CLOCK_REALTIME, &deadline);
+  output_pipe_add_ms (&deadline, OUTPUT_PIPE_TIMEOUT_MS);
+
+  pthread_mutex_lock (&output_pipe_mutex);
+  while (out->pipes_pending > 0)
+    {
+      struct timespec ts;
+      int rc;
+
+      clock_gettime (CLOCK_REALTIME, &ts);
+      output_pipe_add_ms (&ts, OUTPUT_PIPE_LINGER_MS);
+      rc = pthread_cond_timedwait (&output_pipe_cond, &output_pipe_mutex, &ts);
+      if (rc == ETIMEDOUT && out->pipes_pending > 0)
+        {
+          int expired = ts.tv_sec > deadline.tv_sec
+                     || (   ts.tv_sec == deadline.tv_sec
+                         && ts.tv_nsec >= deadline.tv_nsec);
+          if (expired || output_pipe_is_idle (out))
+            {
+              unsigned int i;
+
+              /* Let the thread finish appending before detaching. */
+              while (output_pipe_busy == out)
+                pthread_cond_wait (&output_pipe_cond, &output_pipe_mutex);
+
+              for (i = 0; i < output_pipe_count; i++)
+                if (output_pipes[i].out == out)
+                  output_pipes[i].out = NULL;
+              out->pipes_pending = 0;
+              break;
+            }
+        }
+    }
+  pthread_mutex_unlock (&output_pipe_mutex);
+}
+
+#endif /* OUTPUT_WITH_PIPES */
 
 
 /* Provide support for temporary files.  */
@@ -1057,6 +1674,12 @@ output_init (struct output *out)
       out->err.total     = 0;
       out->out.total     = 0;
       out->seqno         = 0;
+# ifdef OUTPUT_WITH_PIPES
+      out->child_out     = -1;
+      out->child_err     = -1;
+      out->spill_fd      = -1;
+      out->pipes_pending = 0;
+# endif
 #else
       out->out = out->err = OUTPUT_NONE;
 #endif
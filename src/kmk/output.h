@@ -46,6 +46,11 @@ struct output_membuf
                                    the tail_run.  */
     size_t total;               /* Total segment allocation size.  */
 };
+
+/* On POSIX hosts child output is collected thru pipes by a thread. */
+# ifndef KBUILD_OS_WINDOWS
+#  define OUTPUT_WITH_PIPES
+# endif
 #endif /* CONFIG_WITH_OUTPUT_IN_MEMORY */
 
 struct output
@@ -54,6 +59,12 @@ struct output
     struct output_membuf out;
     struct output_membuf err;
     unsigned int seqno;         /* The current run sequence number. */
+# ifdef OUTPUT_WITH_PIPES
+    int child_out;              /* Pipe write end for the child's stdout. */
+    int child_err;              /* Ditto for stderr, may equal child_out. */
+    int spill_fd;               /* Overflow file for big outputs, or -1. */
+    unsigned int pipes_pending; /* Pipes the output thread is reading. */
+# endif
 #else
     int out;
     int err;
@@ -85,9 +96,18 @@ void output_start (void);
 void outputs (int is_err, const char *msg);
 #ifdef CONFIG_WITH_OUTPUT_IN_MEMORY
 ssize_t output_write_bin (struct output *out, int is_err, const char *src, size_t len);
+# ifdef CONFIG_WITH_KMK_BUILTIN_SHELL
+char *output_take_out (struct output *out, size_t *lenp);
+# endif
 #endif
 ssize_t output_write_text (struct output *out, int is_err, const char *src, size_t len);
 
+#ifdef OUTPUT_WITH_PIPES
+int output_pipe_open (struct output *out);
+void output_pipe_close_child (struct output *out);
+void output_pipe_wait (struct output *out);
+#endif
+
 #ifndef NO_OUTPUT_SYNC
 int output_tmpfd (void);
 /* Dump any child output content to stdout, and reset it.  */
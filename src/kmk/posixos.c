@@ -28,6 +28,9 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "debug.h"
 #include "job.h"
 #include "os.h"
+#if defined (CONFIG_WITH_KMK_BUILTIN) && !defined (KBUILD_OS_OS2)
+# include "kmkbuiltin.h"
+#endif
 
 #ifdef MAKE_JOBSERVER
 
@@ -243,6 +246,7 @@ jobserver_acquire (int timeout)
   fd_set readfds;
   struct timespec spec;
   struct timespec *specp = NULL;
+  int fd_max;
   int r;
   char intake;
 
@@ -250,6 +254,7 @@ jobserver_acquire (int timeout)
 
   FD_ZERO (&readfds);
   FD_SET (job_fds[0], &readfds);
+  fd_max = job_fds[0];
 
   if (timeout)
     {
@@ -259,7 +264,18 @@ jobserver_acquire (int timeout)
       specp = &spec;
     }
 
-  r = pselect (job_fds[0]+1, &readfds, NULL, NULL, specp, &empty);
+#if defined (CONFIG_WITH_KMK_BUILTIN) && !defined (KBUILD_OS_OS2)
+  /* Results from kWorker instances don't come with a SIGCHLD, so watch
+     their connections too and return without a token when one is ready.  */
+  if (kmk_builtin_async_add_fds (&readfds, &fd_max) != 0 && !specp)
+    {
+      spec.tv_sec = 0;
+      spec.tv_nsec = 50 * 1000 * 1000;
+      specp = &spec;
+    }
+#endif
+
+  r = pselect (fd_max+1, &readfds, NULL, NULL, specp, &empty);
 
   if (r == -1)
     {
@@ -273,6 +289,12 @@ jobserver_acquire (int timeout)
     /* Timeout.  */
     return 0;
 
+#if defined (CONFIG_WITH_KMK_BUILTIN) && !defined (KBUILD_OS_OS2)
+  if (!FD_ISSET (job_fds[0], &readfds))
+    /* A job completed on a kWorker instance.  */
+    return 0;
+#endif
+
   /* The read FD is ready: read it!  */
   EINTRLOOP (r, read (job_fds[0], &intake, 1));
   if (r < 0)
@@ -30,6 +30,17 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 # include "kbuild.h"
 #endif
 
+/* Use SSE2 for scanning makefile text where we know it's available. */
+#if defined (CONFIG_WITH_OPTIMIZATION_HACKS) \
+ && (defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)) \
+ && !defined (GCC_ADDRESS_SANITIZER)
+# define KMK_READ_WITH_SSE2
+# include <emmintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+# endif
+#endif
+
 #ifdef WINDOWS32
 #include <windows.h>
 # ifndef _MSC_VER
@@ -64,6 +75,13 @@ struct ebuffer
     unsigned int size;  /* Malloc'd size of buffer. */
     FILE *fp;           /* File, or NULL if this is an internal buffer.  */
     floc floc;          /* Info on the file in fp (if any).  */
+#ifdef CONFIG_WITH_COMPILER
+    int count_lines;    /* Whether readstring should count lines (kmk_cc). */
+#endif
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+    int in_memory;      /* The whole file is in the buffer (readbuffer). */
+    int has_cr;         /* The buffer contains CR characters. */
+#endif
   };
 
 /* Track the modifiers we can have on variable assignments */
@@ -168,6 +186,13 @@ static struct goaldep *eval_makefile (const char *filename, int flags);
 static void eval (struct ebuffer *buffer, int flags);
 
 static long readline (struct ebuffer *ebuf);
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+static int readbuffer_load (struct ebuffer *ebuf, off_t size_hint);
+# ifdef CONFIG_WITH_INCLUDEDEP
+static int readbuffer_take_prefetched (struct ebuffer *ebuf, const char *filename,
+                                       struct stat const *st);
+# endif
+#endif
 static void do_undefine (char *name, enum variable_origin origin,
                          struct ebuffer *ebuf);
 static struct variable *do_define (char *name IF_WITH_VALUE_LENGTH_PARAM(char *eos),
@@ -399,6 +424,9 @@ eval_makefile (const char *filename, int flags)
   ebuf.floc.filenm = filename; /* Use the original file name.  */
   ebuf.floc.lineno = 1;
   ebuf.floc.offset = 0;
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+  ebuf.in_memory = 0;
+#endif
 
   if (ISDB (DB_VERBOSE))
     {
@@ -520,23 +548,32 @@ eval_makefile (const char *filename, int flags)
   /* Execute compiled version if repeatedly evaluating this file.
      ASSUMES file content is unmodified since compilation. */
   deps->file->eval_count++;
-  if (   deps->file->evalprog
+  if (   !(flags & RM_NO_DEFAULT_GOAL)
+      && (   deps->file->evalprog
 # ifdef CONFIG_WITH_COMPILE_EVERYTHING
-      || (   deps->file->eval_count == 1
+          || (   deps->file->eval_count == 1
 # else
-      || (   deps->file->eval_count == 3
+          || (   deps->file->eval_count == 3
 # endif
-          && (deps->file->evalprog = kmk_cc_compile_file_for_eval (ebuf.fp, filename)) != NULL) )
+              && (deps->file->evalprog = kmk_cc_compile_file_for_eval (ebuf.fp, filename)) != NULL) ) )
     {
+      int rc;
       curfile = reading_file;
       reading_file = &ebuf.floc;
 
-      kmk_exec_eval_file (deps->file->evalprog);
+      rc = kmk_exec_eval_file (deps->file->evalprog);
 
       reading_file = curfile;
-      fclose (ebuf.fp);
-      alloca (0);
-      return 1;
+      if (rc == 0)
+        {
+          fclose (ebuf.fp);
+          alloca (0);
+          errno = 0;
+          return deps;
+        }
+
+      /* The program refused to run (cmd_prefix changed), interpret it. */
+      fseek (ebuf.fp, 0, SEEK_SET);
     }
 #elif defined (CONFIG_WITH_MAKE_STATS)
   deps->file->eval_count++;
@@ -551,6 +588,12 @@ eval_makefile (const char *filename, int flags)
     if (!birdStatOnFdJustSize(fileno(ebuf.fp), &st.st_size))
 # else
     if (!fstat (fileno (ebuf.fp), &st))
+# endif
+# ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+#  ifdef CONFIG_WITH_INCLUDEDEP
+      if (!readbuffer_take_prefetched (&ebuf, filename, &st))
+#  endif
+      if (!readbuffer_load (&ebuf, st.st_size))
 # endif
       {
         int stream_buf_size = 256*1024;
@@ -568,8 +611,13 @@ eval_makefile (const char *filename, int flags)
 
   /* Evaluate the makefile */
 
-  ebuf.size = 200;
-  ebuf.buffer = ebuf.bufnext = ebuf.bufstart = xmalloc (ebuf.size);
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+  if (!ebuf.in_memory)
+#endif
+    {
+      ebuf.size = 200;
+      ebuf.buffer = ebuf.bufnext = ebuf.bufstart = xmalloc (ebuf.size);
+    }
 #ifdef CONFIG_WITH_VALUE_LENGTH
   ebuf.eol = NULL;
 #endif
@@ -581,7 +629,10 @@ eval_makefile (const char *filename, int flags)
 
   reading_file = curfile;
 
-  fclose (ebuf.fp);
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+  if (ebuf.fp)
+#endif
+    fclose (ebuf.fp);
 
 #ifdef KMK
    if (stream_buf)
@@ -614,6 +665,12 @@ eval_buffer (char *buffer, const floc *flocp IF_WITH_VALUE_LENGTH_PARAM(char *eo
 #endif
   ebuf.buffer = ebuf.bufnext = ebuf.bufstart = buffer;
   ebuf.fp = NULL;
+#ifdef CONFIG_WITH_COMPILER
+  ebuf.count_lines = 0;
+#endif
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+  ebuf.in_memory = 0;
+#endif
 
   if (flocp)
     ebuf.floc = *flocp;
@@ -639,6 +696,102 @@ eval_buffer (char *buffer, const floc *flocp IF_WITH_VALUE_LENGTH_PARAM(char *eo
 
   alloca (0);
 }
+
+#ifdef CONFIG_WITH_COMPILER
+/* Variant of eval_buffer used by kmk_cc_exec.c for the chunks of a compiled
+   makefile or variable it leaves to the interpreter.  If COUNT_LINES is set,
+   line numbers are advanced like when reading FLOCP->filenm from a file.  */
+
+void
+eval_buffer_for_compiler (char *buffer, char *eos, const floc *flocp,
+                          int count_lines)
+{
+  struct ebuffer ebuf;
+  struct conditionals *saved;
+  struct conditionals new;
+  const floc *curfile;
+
+  ebuf.size = eos - buffer;
+  ebuf.eol = eos;
+  assert (strchr (buffer, '\0') == eos);
+  ebuf.buffer = ebuf.bufnext = ebuf.bufstart = buffer;
+  ebuf.fp = NULL;
+  ebuf.count_lines = count_lines;
+# ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+  ebuf.in_memory = 0;
+# endif
+  ebuf.floc = *flocp;
+
+  curfile = reading_file;
+  reading_file = &ebuf.floc;
+
+  saved = install_conditionals (&new);
+
+  eval (&ebuf, 1);
+
+  restore_conditionals (saved);
+
+  reading_file = curfile;
+
+  alloca (0);
+}
+
+/* Prepares a copy of a makefile line for kmk_cc_exec.c the same way eval()
+   does before looking at it: continuations are collapsed and comments
+   removed.  Returns the new end of the line.  */
+
+char *
+eval_prep_line_for_compiler (char *line, unsigned int linelen)
+{
+  char *eol = collapse_continuations (line, linelen);
+  return remove_comments (line, eol);
+}
+
+/* Implements the 'include', '-include' and 'sinclude' directives on behalf
+   of kmk_cc_exec.c.  NAMES is the expanded list of makefiles (modified).  */
+
+void
+eval_include_for_compiler (char *names, int noerror, const floc *flocp)
+{
+  struct nameseq *files;
+  struct conditionals *save;
+  struct conditionals new_conditionals;
+
+  /* If no filenames, it's a no-op.  */
+  if (*names == '\0')
+    return;
+
+  /* Parse the list of file names.  Don't expand archive references!  */
+  files = PARSE_FILE_SEQ (&names, struct nameseq, MAP_NUL, NULL,
+                          PARSEFS_NOAR);
+
+  /* Save the state of conditionals and start
+     the included makefile with a clean slate.  */
+  save = install_conditionals (&new_conditionals);
+
+  /* Read each included makefile.  */
+  while (files != 0)
+    {
+      struct nameseq *next = files->next;
+      int flags = (RM_INCLUDED | RM_NO_TILDE
+                   | (noerror ? RM_DONTCARE : 0));
+
+      struct goaldep *d = eval_makefile (files->name, flags);
+
+      if (errno)
+        {
+          d->error = (unsigned short)errno;
+          d->floc = *flocp;
+        }
+
+      free_ns (files);
+      files = next;
+    }
+
+  /* Restore conditional state.  */
+  restore_conditionals (save);
+}
+#endif /* CONFIG_WITH_COMPILER */
 
 /* Check LINE to see if it's a variable assignment or undefine.
 
@@ -1098,16 +1251,23 @@ eval (struct ebuffer *ebuf, int set_default)
 
 #ifdef CONFIG_WITH_INCLUDEDEP
       assert (strchr (p2, '\0') == eol);
-      if (word1eq ("includedep") || word1eq ("includedep-queue") || word1eq ("includedep-flush"))
+      if (word1eq ("includedep") || word1eq ("includedep-queue") || word1eq ("includedep-flush")
+          || word1eq ("include-prefetch"))
         {
           /* We have found an `includedep' line specifying one or more dep files
              to be read at this point. This include variation does no
              globbing and do not support multiple names. It's trying to save
-             time by being dead simple as well as ignoring errors. */
+             time by being dead simple as well as ignoring errors.
+
+             `include-prefetch' uses the same machinery to read makefiles
+             that will be included later on into memory on the worker
+             threads.  They are still evaluated by `include' as usual. */
           enum incdep_op op = p[wlen - 1] == 'p'
                             ? incdep_read_it
                             : p[wlen - 1] == 'e'
-                            ? incdep_queue : incdep_flush;
+                            ? incdep_queue
+                            : p[7] == '-'
+                            ? incdep_prefetch : incdep_flush;
           char *free_me = NULL;
           unsigned int buf_len;
           char *name = p2;
@@ -2875,6 +3035,96 @@ l_next:
 
    STOPCHAR _cannot_ be '$' if IGNOREVARS is true.  */
 
+#ifdef KMK_READ_WITH_SSE2
+
+/* The stop character sets find_stop_char has seen, as SSE2 vectors. */
+#define STOP_SET_CACHE_SIZE     8
+#define STOP_SET_MAX_CHARS      6
+static struct stop_set_vectors
+{
+  int map;                      /* The MAP_XXX mask, 0 if unused entry. */
+  int count;                    /* Number of chars, -1 if too many. */
+  __m128i chars[STOP_SET_MAX_CHARS];
+} stop_set_cache[STOP_SET_CACHE_SIZE];
+static unsigned int stop_set_cache_next;
+
+/* Looks up or creates the vectors for MAP (which must include MAP_NUL). */
+static struct stop_set_vectors *
+get_stop_set_vectors (int map)
+{
+  struct stop_set_vectors *set;
+  unsigned int i;
+
+  for (i = 0; i < STOP_SET_CACHE_SIZE; i++)
+    if (stop_set_cache[i].map == map)
+      return &stop_set_cache[i];
+
+  set = &stop_set_cache[stop_set_cache_next++ % STOP_SET_CACHE_SIZE];
+  set->map = map;
+  set->count = 0;
+  for (i = 0; i <= UCHAR_MAX; i++)
+    if (STOP_SET (i, map))
+      {
+        if (set->count >= STOP_SET_MAX_CHARS)
+          {
+            set->count = -1;
+            break;
+          }
+        set->chars[set->count++] = _mm_set1_epi8 ((char)i);
+      }
+  return set;
+}
+
+/* Returns the first character in STR that is in the MAP stop set.  MAP must
+   include MAP_NUL.
+
+   This checks 16 bytes at the time using aligned loads, so it may read
+   past the terminator but never into the next page. */
+static char *
+find_stop_char (char *str, int map)
+{
+  struct stop_set_vectors const *set = get_stop_set_vectors (map);
+  const __m128i *cur;
+  unsigned int mask;
+  unsigned int off;
+
+  if (set->count < 0)
+    {
+      while (!STOP_SET (*str, map))
+        ++str;
+      return str;
+    }
+
+  off = (unsigned int)((size_t)str & 15);
+  cur = (const __m128i *)(str - off);
+  mask = 0xffffU << off;
+  for (;;)
+    {
+      __m128i const chunk = _mm_load_si128 (cur);
+      __m128i hits = _mm_cmpeq_epi8 (chunk, set->chars[0]);
+      int i;
+      for (i = 1; i < set->count; i++)
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (chunk, set->chars[i]));
+      mask &= (unsigned int)_mm_movemask_epi8 (hits);
+      if (mask)
+        break;
+      mask = 0xffffU;
+      cur++;
+    }
+
+# ifdef _MSC_VER
+  {
+    unsigned long bit;
+    _BitScanForward (&bit, mask);
+    return (char *)cur + bit;
+  }
+# else
+  return (char *)cur + __builtin_ctz (mask);
+# endif
+}
+
+#endif /* KMK_READ_WITH_SSE2 */
+
 static char *
 find_char_unquote (char *string, int map IF_WITH_VALUE_LENGTH_PARAM(unsigned int string_len))
 {
@@ -2891,8 +3141,12 @@ find_char_unquote (char *string, int map IF_WITH_VALUE_LENGTH_PARAM(unsigned int
 
   while (1)
     {
+#ifdef KMK_READ_WITH_SSE2
+      p = find_stop_char (p, map);
+#else
       while (! STOP_SET (*p, map))
         ++p;
+#endif
 
       if (*p == '\0')
         break;
@@ -3146,6 +3400,9 @@ readstring (struct ebuffer *ebuf)
 #ifdef CONFIG_WITH_VALUE_LENGTH
   char *end;
 #endif
+#ifdef CONFIG_WITH_COMPILER
+  long nlines = 1;
+#endif
 
   /* If there is nothing left in this buffer, return 0.  */
   if (ebuf->bufnext >= ebuf->bufstart + ebuf->size)
@@ -3178,6 +3435,10 @@ readstring (struct ebuffer *ebuf)
           ebuf->bufnext = ebuf->bufstart + ebuf->size + 1;
 #ifdef CONFIG_WITH_VALUE_LENGTH
           ebuf->eol = end;
+#endif
+#ifdef CONFIG_WITH_COMPILER
+          if (ebuf->count_lines)
+            return nlines;
 #endif
           return 0;
         }
@@ -3188,6 +3449,9 @@ readstring (struct ebuffer *ebuf)
       if (!backslash)
         break;
       ++eol;
+#ifdef CONFIG_WITH_COMPILER
+      ++nlines;
+#endif
     }
 
   /* Overwrite the newline char.  */
@@ -3197,9 +3461,181 @@ readstring (struct ebuffer *ebuf)
   ebuf->eol = eol;
 #endif
 
+#ifdef CONFIG_WITH_COMPILER
+  if (ebuf->count_lines)
+    return nlines;
+#endif
+  return 0;
+}
+
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+
+/* Checks the SIZE bytes at BUF for NUL and CR characters.  Returns 1 if
+   there are any NULs, otherwise 0 with *HAS_CRP set.  */
+static int
+readbuffer_scan (const char *buf, size_t size, int *has_crp)
+{
+  size_t off = 0;
+  int has_cr = 0;
+# ifdef KMK_READ_WITH_SSE2
+  __m128i const zero = _mm_setzero_si128 ();
+  __m128i const cr   = _mm_set1_epi8 ('\r');
+  __m128i crs        = zero;
+  for (; off + 16 <= size; off += 16)
+    {
+      __m128i const chunk = _mm_loadu_si128 ((const __m128i *)(buf + off));
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (chunk, zero)))
+        return 1;
+      crs = _mm_or_si128 (crs, _mm_cmpeq_epi8 (chunk, cr));
+    }
+  has_cr = _mm_movemask_epi8 (crs) != 0;
+# endif
+  for (; off < size; off++)
+    if (buf[off] == '\0')
+      return 1;
+    else if (buf[off] == '\r')
+      has_cr = 1;
+  *has_crp = has_cr;
   return 0;
 }
 
+/* Tries to read the whole of EBUF->fp into memory so readline can use
+   readbuffer.  SIZE_HINT is the file size according to stat.
+
+   Returns 1 and closes the file on success.  Returns 0 if the file must be
+   read with fgets (it contains NUL characters, which readline deals with in
+   its own peculiar way), leaving the stream at the start of the file.  */
+static int
+readbuffer_load (struct ebuffer *ebuf, off_t size_hint)
+{
+  size_t alloc = (size_t)size_hint + 1 > 0x1000 ? (size_t)size_hint + 1 : 0x1000;
+  size_t size = 0;
+  char *buf = xmalloc (alloc);
+  size_t cb;
+
+  /* The size is usually right, but be prepared for the file growing or
+     shrinking (text mode) while we read it. */
+  while ((cb = fread (buf + size, 1, alloc - size - 1, ebuf->fp)) > 0)
+    {
+      size += cb;
+      if (alloc - size - 1 == 0)
+        {
+          alloc *= 2;
+          buf = xrealloc (buf, alloc);
+        }
+    }
+  if (ferror (ebuf->fp))
+    pfatal_with_name (ebuf->floc.filenm);
+
+  if (readbuffer_scan (buf, size, &ebuf->has_cr))
+    {
+      free (buf);
+      fseek (ebuf->fp, 0, SEEK_SET);
+      return 0;
+    }
+
+  buf[size] = '\0';
+  fclose (ebuf->fp);
+  ebuf->fp = NULL;
+  ebuf->in_memory = 1;
+  ebuf->buffer = ebuf->bufnext = ebuf->bufstart = buf;
+  ebuf->size = size;
+  return 1;
+}
+
+# ifdef CONFIG_WITH_INCLUDEDEP
+/* Uses the content of FILENAME if it was read ahead by include-prefetch
+   and the file hasn't changed since (according to ST).  Returns 1 and
+   closes the file on success, 0 if the caller should read the file.  */
+static int
+readbuffer_take_prefetched (struct ebuffer *ebuf, const char *filename,
+                            struct stat const *st)
+{
+  size_t size;
+  FILE_TIMESTAMP mtime;
+  char *buf = incdep_take_prefetched_makefile (filename, &size, &mtime);
+  if (!buf)
+    return 0;
+  if (   (off_t)size != st->st_size
+#  ifndef KBUILD_OS_WINDOWS
+      || mtime != FILE_TIMESTAMP_STAT_MODTIME (filename, *st)
+#  endif
+      || readbuffer_scan (buf, size, &ebuf->has_cr))
+    {
+      free (buf);
+      return 0;
+    }
+
+  fclose (ebuf->fp);
+  ebuf->fp = NULL;
+  ebuf->in_memory = 1;
+  ebuf->buffer = ebuf->bufnext = ebuf->bufstart = buf;
+  ebuf->size = size;
+  return 1;
+}
+# endif /* CONFIG_WITH_INCLUDEDEP */
+
+/* Reads a line from a file that's been loaded into memory by readbuffer_load.
+   This produces the same result as the fgets loop in readline, including
+   line counting and CRLF handling, but works directly on the buffer.  */
+
+static long
+readbuffer (struct ebuffer *ebuf)
+{
+  char * const end = ebuf->bufstart + ebuf->size;
+  char *bol = ebuf->bufnext;
+  char *p = bol;
+  long nlines = 0;
+
+  if (bol >= end)
+    return -1;
+
+  while (1)
+    {
+      int backslash = 0;
+      char *nl = (char *)memchr (p, '\n', end - p);
+      char *p2;
+      if (!nl)
+        {
+          /* Last line without a newline; there is a terminator at END. */
+          ebuf->buffer = bol;
+          ebuf->bufnext = end;
+#ifdef CONFIG_WITH_VALUE_LENGTH
+          ebuf->eol = end;
+#endif
+          return nlines ? nlines : 1;
+        }
+      ++nlines;
+
+      /* Drop a CR in front of the newline.  Rather than moving the rest
+         of the buffer, we move the part of the line before it one
+         character forward.  */
+      if (ebuf->has_cr && nl > bol && nl[-1] == '\r')
+        {
+          memmove (bol + 1, bol, nl - 1 - bol);
+          bol++;
+        }
+
+      for (p2 = nl - 1; p2 >= bol && *p2 == '\\'; --p2)
+        backslash = !backslash;
+      if (!backslash)
+        {
+          *nl = '\0';
+          ebuf->buffer = bol;
+          ebuf->bufnext = nl + 1;
+#ifdef CONFIG_WITH_VALUE_LENGTH
+          ebuf->eol = nl;
+#endif
+          return nlines;
+        }
+
+      /* Backslash/newline combo, continue with the next line. */
+      p = nl + 1;
+    }
+}
+
+#endif /* CONFIG_WITH_MAKEFILE_IN_MEMORY */
+
 static long
 readline (struct ebuffer *ebuf)
 {
@@ -3212,7 +3648,11 @@ readline (struct ebuffer *ebuf)
      warrant different functions.  Do the Right Thing.  */
 
   if (!ebuf->fp)
+#ifdef CONFIG_WITH_MAKEFILE_IN_MEMORY
+    return ebuf->in_memory ? readbuffer (ebuf) : readstring (ebuf);
+#else
     return readstring (ebuf);
+#endif
 
   /* When reading from a file, we always start over at the beginning of the
      buffer for each new line.  */
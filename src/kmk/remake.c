@@ -73,6 +73,9 @@ static const char *library_search (const char *lib, FILE_TIMESTAMP *mtime_ptr);
 #ifdef CONFIG_WITH_DOT_MUST_MAKE
 static int call_must_make_target_var (struct file *file, unsigned int depth);
 #endif
+#if defined (CONFIG_WITH_DOT_MUST_MAKE) && defined (CONFIG_WITH_CMD_DB)
+static void call_must_make_for_cmd_db (struct file *file);
+#endif
 #ifdef CONFIG_WITH_DOT_IS_CHANGED
 static int call_is_changed_target_var (struct file *file);
 #endif
@@ -299,6 +302,132 @@ show_goal_error (void)
       }
 }
 
+#ifdef CONFIG_WITH_DIRCACHE
+
+/* Hash functions for the set of files visited by prefetch_goal_mtimes,
+   keyed by address.  */
+
+static unsigned long
+prefetch_file_hash_1 (const void *key)
+{
+  return (unsigned long) ((size_t) key >> 4);
+}
+
+static unsigned long
+prefetch_file_hash_2 (const void *key)
+{
+  return (unsigned long) ((size_t) key >> 9) | 1;
+}
+
+static int
+prefetch_file_hash_cmp (const void *x, const void *y)
+{
+  return x == y ? 0 : (size_t) x < (size_t) y ? -1 : 1;
+}
+
+/* On network file systems a no-op build is mostly spent waiting on stat,
+   since update_file asks name_mtime about one file after the other.  If
+   KMK_STAT_PREFETCH is set to a thread count, collect the files reachable
+   from GOALS whose mtime is still unknown and have the directory cache stat
+   them in parallel, so the name_mtime calls become cache hits.  Going thru
+   the cache leaves the vpath, archive and rename handling of f_mtime alone,
+   and the results are invalidated by jobs like any other cache entry.  */
+
+void
+prefetch_goal_mtimes (struct goaldep *goals)
+{
+  struct hash_table visited;
+  struct goaldep *g;
+  struct variable *v;
+  struct file **stack;
+  const char **names;
+  unsigned int stack_size = 1024;
+  unsigned int depth = 0;
+  unsigned int names_size = 1024;
+  unsigned int count = 0;
+  unsigned long threads = 0;
+
+  v = lookup_variable (STRING_SIZE_TUPLE ("KMK_STAT_PREFETCH"));
+  if (v && v->value_length)
+    {
+      char *str = v->recursive && memchr (v->value, '$', v->value_length)
+                ? allocated_variable_expand (v->value) : xstrdup (v->value);
+      threads = strtoul (str, NULL, 0);
+      free (str);
+    }
+  if (threads <= 1)
+    return;
+  if (threads > 64)
+    threads = 64;
+
+  /* Walk the graph depth first, following everything update_file may go to,
+     and pick the files which will need their mtime.  */
+  hash_init (&visited, 4096, prefetch_file_hash_1, prefetch_file_hash_2,
+             prefetch_file_hash_cmp);
+  stack = xmalloc (stack_size * sizeof (*stack));
+  names = xmalloc (names_size * sizeof (*names));
+
+#define PREFETCH_PUSH(f) \
+    do { \
+        struct file *pushed_ = (f); \
+        struct file **slot_ = (struct file **) hash_find_slot (&visited, pushed_); \
+        if (HASH_VACANT (*slot_)) \
+          { \
+            hash_insert_at (&visited, pushed_, slot_); \
+            if (depth >= stack_size) \
+              { \
+                stack_size *= 2; \
+                stack = xrealloc (stack, stack_size * sizeof (*stack)); \
+              } \
+            stack[depth++] = pushed_; \
+          } \
+    } while (0)
+
+  for (g = goals; g; g = g->next)
+    PREFETCH_PUSH (g->file);
+
+  while (depth > 0)
+    {
+      struct file *f = stack[--depth];
+      struct dep *d;
+
+      if (f->last_mtime == UNKNOWN_MTIME && !f->phony
+#ifndef NO_ARCHIVES
+          && !ar_name (f->name)
+#endif
+         )
+        {
+          if (count >= names_size)
+            {
+              names_size *= 2;
+              names = xrealloc (names, names_size * sizeof (*names));
+            }
+          names[count++] = f->name;
+        }
+
+      if (f->double_colon && f->prev)
+        PREFETCH_PUSH (f->prev);
+#ifdef CONFIG_WITH_EXPLICIT_MULTITARGET
+      if (f->multi_next)
+        PREFETCH_PUSH (f->multi_next);
+#endif
+      for (d = f->also_make; d; d = d->next)
+        PREFETCH_PUSH (d->file);
+      for (d = f->deps; d; d = d->next)
+        PREFETCH_PUSH (d->file);
+    }
+#undef PREFETCH_PUSH
+  free (stack);
+  hash_free (&visited, 0);
+
+  dir_cache_prefetch (names, count, (unsigned int) threads);
+  DB (DB_BASIC, (_("Prefetched the mtime of %u files using %u threads.\n"),
+                 count, (unsigned int) threads));
+  free (names);
+}
+
+#endif /* CONFIG_WITH_DIRCACHE */
+
 /* If FILE is not up to date, execute the commands for it.
    Return 0 if successful, non-0 if unsuccessful;
    but with some flag settings, just call 'exit' if unsuccessful.
@@ -668,10 +797,25 @@ update_file_1 (struct file *file, unsigned int depth)
   while (ad)
     {
       struct dep *lastd = 0;
+#ifdef CONFIG_WITH_JOB_HISTORY
+      /* In parallel builds, visit the deps with the longest critical path
+         first so their jobs get started early (only for FILE's own deps,
+         the also_make ones are left alone).  */
+      struct dep **sorted = ad->file == file
+                          ? job_history_sort_deps (ad->file->deps) : NULL;
+      unsigned int isorted = 0;
+# define NEXT_DEP(d) (sorted ? sorted[++isorted] : (d)->next)
+#else
+# define NEXT_DEP(d) ((d)->next)
+#endif
 
       /* Find the deps we're scanning */
       d = ad->file->deps;
       ad = ad->next;
+#ifdef CONFIG_WITH_JOB_HISTORY
+      if (sorted)
+        d = sorted[0];
+#endif
 
       while (d)
         {
@@ -692,13 +836,23 @@ update_file_1 (struct file *file, unsigned int depth)
               if (file->multi_maybe && d->file == org_file)
                 {
                   lastd = d;
-                  d = d->next;
+                  d = NEXT_DEP (d);
                   continue;
                 }
 #endif
 
               OSS (error, NILF, _("Circular %s <- %s dependency dropped."),
                    file->name, d->file->name);
+#ifdef CONFIG_WITH_JOB_HISTORY
+              /* LASTD isn't the list predecessor when walking SORTED.  */
+              if (sorted)
+                {
+                  lastd = 0;
+                  if (file->deps != d)
+                    for (lastd = file->deps; lastd->next != d; lastd = lastd->next)
+                      /* nothing */;
+                }
+#endif
               /* We cannot free D here because our the caller will still have
                  a reference to it when we were called recursively via
                  check_dep below.  */
@@ -706,7 +860,7 @@ update_file_1 (struct file *file, unsigned int depth)
                 file->deps = d->next;
               else
                 lastd->next = d->next;
-              d = d->next;
+              d = NEXT_DEP (d);
               continue;
             }
 
@@ -756,8 +910,12 @@ update_file_1 (struct file *file, unsigned int depth)
                           || (mtime == NONEXISTENT_MTIME));
 
           lastd = d;
-          d = d->next;
+          d = NEXT_DEP (d);
         }
+#ifdef CONFIG_WITH_JOB_HISTORY
+      free (sorted);
+#endif
+#undef NEXT_DEP
     }
 
 #ifdef CONFIG_WITH_EXPLICIT_MULTITARGET
@@ -779,6 +937,15 @@ update_file_1 (struct file *file, unsigned int depth)
   if (!must_make)
     must_make = call_must_make_target_var (file, depth);
 # endif
+# ifdef CONFIG_WITH_CMD_DB
+  if (must_make || always_make_flag)
+#  ifdef CONFIG_WITH_EXPLICIT_MULTITARGET
+    for (f2 = org_file; f2; f2 = f2->multi_next)
+      call_must_make_for_cmd_db (f2);
+#  else
+    call_must_make_for_cmd_db (file);
+#  endif
+# endif
 #endif /* CONFIG_WITH_DOT_MUST_MAKE */
 
   /* Now we know whether this target needs updating.
@@ -1101,6 +1268,32 @@ call_must_make_target_var (struct file *file, unsigned int depth)
     }
   return 0;
 }
+
+# ifdef CONFIG_WITH_CMD_DB
+/* When a target using $(comp-cmds-db ) in its .MUST_MAKE variable is remade
+   for other reasons, the variable must still be expanded so the fingerprint
+   of the commands gets calculated and can be recorded when they succeed.
+   Otherwise the next run would remake it again.  Such targets are marked
+   by listing them as prerequisites of .CMD_DB (see KB_FN_AUTO_CMD_DEPS_EX)
+   or by having their .MUST_MAKE expanded earlier.  */
+static void
+call_must_make_for_cmd_db (struct file *file)
+{
+  struct variable *var;
+
+  if (file->cmd_db || !file->cmd_db_target || !file->variables)
+    return;
+  var = lookup_variable_in_set (".MUST_MAKE", sizeof (".MUST_MAKE") - 1,
+                                file->variables->set);
+  if (var)
+    {
+      initialize_file_variables (file, 0);
+      set_file_variables (file, 1 /* called early, no dep lists please */);
+      variable_expand_for_file_2 (NULL, var->value, var->value_length,
+                                  file, NULL);
+    }
+}
+# endif
 #endif /* CONFIG_WITH_DOT_MUST_MAKE */
 
 #ifdef CONFIG_WITH_DOT_IS_CHANGED
@@ -1864,6 +2057,8 @@ name_mtime (const char *name)
 #if defined(KMK) && defined(KBUILD_OS_WINDOWS)
   extern int stat_only_mtime(const char *pszPath, struct stat *pStat);
   e = stat_only_mtime (name, &st);
+#elif defined(CONFIG_WITH_DIRCACHE)
+  e = dir_cache_stat (name, &st);
 #else
   EINTRLOOP (e, stat (name, &st));
 #endif
@@ -59,6 +59,135 @@ struct file *suffix_file;
 /* Maximum length of a suffix.  */
 
 unsigned int maxsuffix;
+
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+/* Index of the pattern rule targets by the last character, so that
+   pattern_search only needs to look at the target patterns that can
+   possibly match a file name.  Each bucket lists its patterns in rule
+   order, merged with the patterns ending with '%' (which can match any
+   file name).  Buckets without patterns of their own share the list of
+   patterns ending with '%'.  */
+
+struct rule_index_bucket
+  {
+    struct rule_index_entry *entries;
+    unsigned int count;
+  };
+
+static struct rule_index_bucket pattern_rule_index[256];
+
+/* The patterns ending with '%'.  */
+
+static struct rule_index_bucket pattern_rule_index_any;
+
+/* Nonzero if pattern_rule_index reflects the pattern_rules chain.  */
+
+static int pattern_rule_index_valid;
+
+/* Invalidates the pattern rule index.  */
+
+static void
+invalidate_pattern_rule_index (void)
+{
+  unsigned int i;
+
+  if (!pattern_rule_index_valid)
+    return;
+  pattern_rule_index_valid = 0;
+  for (i = 0; i < 256; i++)
+    {
+      if (pattern_rule_index[i].entries != pattern_rule_index_any.entries)
+        free (pattern_rule_index[i].entries);
+      pattern_rule_index[i].entries = 0;
+      pattern_rule_index[i].count = 0;
+    }
+  free (pattern_rule_index_any.entries);
+  pattern_rule_index_any.entries = 0;
+  pattern_rule_index_any.count = 0;
+}
+
+/* (Re)builds the pattern rule index.  */
+
+static void
+build_pattern_rule_index (void)
+{
+  unsigned int counts[256];
+  unsigned int any = 0;
+  unsigned int i;
+  struct rule *rule;
+
+  invalidate_pattern_rule_index ();
+
+  /* Count the patterns in each bucket.  */
+  memset (counts, 0, sizeof (counts));
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (i = 0; i < rule->num; ++i)
+      if (*rule->suffixes[i] == '\0')
+        ++any;
+      else
+        ++counts[(unsigned char) rule->targets[i][rule->lens[i] - 1]];
+
+  if (any)
+    pattern_rule_index_any.entries =
+      xmalloc (any * sizeof (struct rule_index_entry));
+  for (i = 0; i < 256; i++)
+    if (counts[i])
+      pattern_rule_index[i].entries =
+        xmalloc ((counts[i] + any) * sizeof (struct rule_index_entry));
+    else
+      pattern_rule_index[i].entries = pattern_rule_index_any.entries;
+
+  /* Fill them in rule order.  The '%' patterns go into every bucket.  */
+  for (rule = pattern_rules; rule != 0; rule = rule->next)
+    for (i = 0; i < rule->num; ++i)
+      {
+        struct rule_index_entry *ent;
+        if (*rule->suffixes[i] == '\0')
+          {
+            unsigned int c;
+            ent = &pattern_rule_index_any.entries[pattern_rule_index_any.count++];
+            for (c = 0; c < 256; c++)
+              if (counts[c])
+                {
+                  struct rule_index_entry *ent2;
+                  ent2 = &pattern_rule_index[c].entries[pattern_rule_index[c].count++];
+                  ent2->rule = rule;
+                  ent2->ti = i;
+                }
+          }
+        else
+          {
+            unsigned char c = rule->targets[i][rule->lens[i] - 1];
+            ent = &pattern_rule_index[c].entries[pattern_rule_index[c].count++];
+          }
+        ent->rule = rule;
+        ent->ti = i;
+      }
+  for (i = 0; i < 256; i++)
+    if (!counts[i])
+      pattern_rule_index[i].count = any;
+
+  pattern_rule_index_valid = 1;
+}
+
+/* Returns the target patterns which may match the file name NAME of length
+   LEN, in rule order, and their number in *COUNTP.  */
+
+const struct rule_index_entry *
+pattern_rule_index_lookup (const char *name, unsigned int len,
+                           unsigned int *countp)
+{
+  struct rule_index_bucket *bucket;
+
+  if (!pattern_rule_index_valid)
+    build_pattern_rule_index ();
+
+  bucket = len > 0 ? &pattern_rule_index[(unsigned char) name[len - 1]]
+                   : &pattern_rule_index_any;
+  *countp = bucket->count;
+  return bucket->entries;
+}
+#endif /* CONFIG_WITH_PATTERN_RULE_INDEX */
 
 /* Compute the maximum dependency length and maximum number of
    dependencies of all implicit rules.  Also sets the subdir
@@ -141,6 +270,10 @@ count_implicit_rule_limits (void)
     }
 
   free (name);
+
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  build_pattern_rule_index ();
+#endif
 }
 
 /* Create a pattern rule from a suffix rule.
@@ -288,6 +421,10 @@ new_pattern_rule (struct rule *rule, int override)
 
   rule->next = 0;
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  invalidate_pattern_rule_index ();
+#endif
+
   /* Search for an identical rule.  */
   lastrule = 0;
   for (r = pattern_rules; r != 0; lastrule = r, r = r->next)
@@ -407,6 +544,9 @@ freerule (struct rule *rule, struct rule *lastrule)
 {
   struct rule *next = rule->next;
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+  invalidate_pattern_rule_index ();
+#endif
   free_dep_chain (rule->deps);
 
   /* MSVC erroneously warns without a cast here.  */
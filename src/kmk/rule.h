@@ -30,6 +30,15 @@ struct rule
     char in_use;                /* If in use by a parent pattern_search.  */
   };
 
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+/* A target pattern in the pattern rule index.  */
+struct rule_index_entry
+  {
+    struct rule *rule;          /* The rule.  */
+    unsigned int ti;            /* The index of the target pattern.  */
+  };
+#endif
+
 /* For calling install_pattern_rule.  */
 struct pspec
   {
@@ -50,6 +59,11 @@ extern unsigned int maxsuffix;
 
 
 void count_implicit_rule_limits (void);
+#ifdef CONFIG_WITH_PATTERN_RULE_INDEX
+const struct rule_index_entry *pattern_rule_index_lookup (const char *name,
+                                                          unsigned int len,
+                                                          unsigned int *countp);
+#endif
 void convert_to_pattern (void);
 void install_pattern_rule (struct pspec *p, int terminal);
 void create_pattern_rule (const char **targets, const char **target_percents,
@@ -350,7 +350,7 @@ void strcache_init (void)
 #else
                  0,             /* case insensitive */
 #endif
-                 0);            /* thread safe */
+                 1);            /* thread safe (incdep workers) */
 
   /* .SUFFIXES is referenced in several loops, keep the added pointer in a
      global var so these can be optimized. */
@@ -55,6 +55,9 @@ typedef signed int     int32_t;
 # include <sys/fmutex.h>
 #endif
 
+#if !defined(WINDOWS32) && !defined(__OS2__)
+# define HAVE_PTHREAD
+#endif
 #ifdef HAVE_PTHREAD
 # include <pthread.h>
 #endif
@@ -74,6 +77,36 @@ typedef signed int     int32_t;
 # define STRCACHE2_MOD_IT(cache, hash)  ((hash) % (cache)->hash_div)
 #endif
 
+/** Atomic load-acquire / store-release of a pointer or integer member.
+ * These are used for the parts of the cache that are read without holding the
+ * lock of a thread safe cache: the hash table pointer and mask, the hash table
+ * slots and the collision chain pointers.  The other compilers we care about
+ * (MSC) give volatile accesses these semantics on x86 and AMD64. */
+#if defined (__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+# define STRCACHE2_LOAD_ACQ(type, lvalue)           __atomic_load_n (&(lvalue), __ATOMIC_ACQUIRE)
+# define STRCACHE2_STORE_REL(type, lvalue, value)   __atomic_store_n (&(lvalue), (value), __ATOMIC_RELEASE)
+#else
+# define STRCACHE2_LOAD_ACQ(type, lvalue)           (*(type volatile *)&(lvalue))
+# define STRCACHE2_STORE_REL(type, lvalue, value)   (*(type volatile *)&(lvalue) = (value))
+#endif
+/** Memory fences for the rehash generation (seqlock) protocol. */
+#if defined (__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+# define STRCACHE2_FENCE_ACQ()                      __atomic_thread_fence (__ATOMIC_ACQUIRE)
+# define STRCACHE2_FENCE_REL()                      __atomic_thread_fence (__ATOMIC_RELEASE)
+#elif defined (__GNUC__)
+# define STRCACHE2_FENCE_ACQ()                      __sync_synchronize ()
+# define STRCACHE2_FENCE_REL()                      __sync_synchronize ()
+#elif defined (_MSC_VER)
+# include <intrin.h>
+# define STRCACHE2_FENCE_ACQ()                      _ReadWriteBarrier ()
+# define STRCACHE2_FENCE_REL()                      _ReadWriteBarrier ()
+#else
+# define STRCACHE2_FENCE_ACQ()                      do { } while (0)
+# define STRCACHE2_FENCE_REL()                      do { } while (0)
+#endif
+/** Advances ENTRY to the next one in the collision chain. */
+#define STRCACHE2_NEXT(entry)   STRCACHE2_LOAD_ACQ (struct strcache2_entry *, (entry)->next)
+
 # if (   defined(__amd64__) || defined(__x86_64__) || defined(__AMD64__) || defined(_M_X64) || defined(__amd64) \
       || defined(__i386__) || defined(__x86__) || defined(__X86__) || defined(_M_IX86) || defined(__i386)) \
   && !defined(GCC_ADDRESS_SANITIZER)
@@ -638,6 +671,69 @@ strcache2_is_iequal (struct strcache2 *cache, struct strcache2_entry const *entr
 }
 #endif /* HAVE_CASE_INSENSITIVE_FS */
 
+/* Takes the lock of a thread safe cache. */
+MY_INLINE void
+strcache2_lock (struct strcache2 *cache)
+{
+#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
+  pthread_mutex_lock ((pthread_mutex_t *)cache->lock);
+#elif defined (WINDOWS32)
+  EnterCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+  _fmutex_request ((_fmutex *)cache->lock, 0);
+#else
+  (void)cache;
+#endif
+}
+
+/* Releases the lock of a thread safe cache. */
+MY_INLINE void
+strcache2_unlock (struct strcache2 *cache)
+{
+#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
+  pthread_mutex_unlock ((pthread_mutex_t *)cache->lock);
+#elif defined (WINDOWS32)
+  LeaveCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+  _fmutex_release ((_fmutex *)cache->lock);
+#else
+  (void)cache;
+#endif
+}
+
+/* Gets the head of the collision chain for HASH, returning the hash table
+   index at IDXP.
+
+   This is safe to call without holding the lock of a thread safe cache:
+   the hash table pointer is always updated before the mask, so we may
+   end up using an older (smaller) mask with a newer table, but never the
+   other way around.  The former merely causes a lookup miss, which the
+   add functions deal with by retrying under the lock and the lookup
+   functions by checking the rehash generation (strcache2_lookup_miss). */
+MY_INLINE struct strcache2_entry const *
+strcache2_get_chain (struct strcache2 *cache, unsigned int hash, unsigned int *idxp)
+{
+  struct strcache2_entry **hash_tab;
+  unsigned int idx;
+#ifdef STRCACHE2_USE_MASK
+  idx = hash & STRCACHE2_LOAD_ACQ (unsigned int, cache->hash_mask);
+#else
+  idx = hash % STRCACHE2_LOAD_ACQ (unsigned int, cache->hash_div);
+#endif
+  hash_tab = STRCACHE2_LOAD_ACQ (struct strcache2_entry **, cache->hash_tab);
+  *idxp = idx;
+  return STRCACHE2_LOAD_ACQ (struct strcache2_entry *, hash_tab[idx]);
+}
+
+/* Rehashes the cache, doubling the hash table size.
+
+   For thread safe caches this is done while other threads may be walking
+   the old table and chains.  The entries never move and the relinked
+   chains are always NULL terminated, so these readers will at worst miss
+   an entry and take the locked path.  The old table is kept around (linked
+   from the extra slot at the end of the new one) until strcache2_term.
+   The rehash generation is odd while chains are being relinked, so that
+   lookups can tell whether a miss is real. */
 static void
 strcache2_rehash (struct strcache2 *cache)
 {
@@ -648,20 +744,23 @@ strcache2_rehash (struct strcache2 *cache)
   unsigned int hash_shift;
 #endif
 
-  /* Allocate a new hash table twice the size of the current. */
-  cache->hash_size <<= 1;
+  unsigned int dst_size = src * 2;
 #ifdef STRCACHE2_USE_MASK
-  cache->hash_mask <<= 1;
-  cache->hash_mask |= 1;
+  unsigned int dst_mask = (cache->hash_mask << 1) | 1;
 #else
-  for (hash_shift = 1; (1U << hash_shift) < cache->hash_size; hash_shift++)
+  unsigned int dst_div;
+  for (hash_shift = 1; (1U << hash_shift) < dst_size; hash_shift++)
     /* nothing */;
-  cache->hash_div = strcache2_find_prime (hash_shift);
+  dst_div = strcache2_find_prime (hash_shift);
 #endif
-  cache->rehash_count <<= 1;
-  cache->hash_tab = dst_tab = (struct strcache2_entry **)
-    xmalloc (cache->hash_size * sizeof (struct strcache2_entry *));
-  memset (dst_tab, '\0', cache->hash_size * sizeof (struct strcache2_entry *));
+
+  /* Allocate a new hash table twice the size of the current. */
+  dst_tab = (struct strcache2_entry **)
+    xmalloc ((dst_size + (cache->lock != NULL)) * sizeof (struct strcache2_entry *));
+  memset (dst_tab, '\0', (dst_size + (cache->lock != NULL)) * sizeof (struct strcache2_entry *));
+
+  STRCACHE2_STORE_REL (unsigned int, cache->rehash_gen, cache->rehash_gen + 1);
+  STRCACHE2_FENCE_REL ();
 
   /* Copy the entries from the old to the new hash table. */
   cache->collision_count = 0;
@@ -671,17 +770,36 @@ strcache2_rehash (struct strcache2 *cache)
       while (entry)
         {
           struct strcache2_entry *next = entry->next;
-          unsigned int dst = STRCACHE2_MOD_IT (cache, entry->hash);
-          if ((entry->next = dst_tab[dst]) != 0)
+#ifdef STRCACHE2_USE_MASK
+          unsigned int dst = entry->hash & dst_mask;
+#else
+          unsigned int dst = entry->hash % dst_div;
+#endif
+          if (dst_tab[dst] != 0)
             cache->collision_count++;
+          STRCACHE2_STORE_REL (struct strcache2_entry *, entry->next, dst_tab[dst]);
           dst_tab[dst] = entry;
 
           entry = next;
         }
     }
 
-  /* That's it, just free the old table and we're done. */
-  free (src_tab);
+  /* Switch to the new table, then the new mask (see strcache2_get_chain). */
+  cache->hash_size = dst_size;
+  cache->rehash_count <<= 1;
+  STRCACHE2_STORE_REL (struct strcache2_entry **, cache->hash_tab, dst_tab);
+#ifdef STRCACHE2_USE_MASK
+  STRCACHE2_STORE_REL (unsigned int, cache->hash_mask, dst_mask);
+#else
+  STRCACHE2_STORE_REL (unsigned int, cache->hash_div, dst_div);
+#endif
+  STRCACHE2_STORE_REL (unsigned int, cache->rehash_gen, cache->rehash_gen + 1);
+
+  /* That's it, just free (or retire) the old table and we're done. */
+  if (cache->lock)
+    dst_tab[dst_size] = (struct strcache2_entry *)src_tab;
+  else
+    free (src_tab);
 }
 
 static struct strcache2_seg *
@@ -718,11 +836,12 @@ strcache2_new_seg (struct strcache2 *cache, unsigned int minlen)
   return seg;
 }
 
-/* Internal worker that enters a new string into the cache. */
+/* Internal worker that inserts a new string into the cache at IDX.
+   The caller owns the lock if it's a thread safe cache. */
 static const char *
-strcache2_enter_string (struct strcache2 *cache, unsigned int idx,
-                        const char *str, unsigned int length,
-                        unsigned int hash)
+strcache2_insert (struct strcache2 *cache, unsigned int idx,
+                  const char *str, unsigned int length,
+                  unsigned int hash)
 {
   struct strcache2_entry *entry;
   struct strcache2_seg *seg;
@@ -759,7 +878,7 @@ strcache2_enter_string (struct strcache2 *cache, unsigned int idx,
 
   if ((entry->next = cache->hash_tab[idx]) != 0)
     cache->collision_count++;
-  cache->hash_tab[idx] = entry;
+  STRCACHE2_STORE_REL (struct strcache2_entry *, cache->hash_tab[idx], entry);
   cache->count++;
   if (cache->count >= cache->rehash_count)
     strcache2_rehash (cache);
@@ -767,6 +886,85 @@ strcache2_enter_string (struct strcache2 *cache, unsigned int idx,
   return str_copy;
 }
 
+/* Looks up a string in a thread safe cache, returning its entry or NULL.
+   The caller owns the lock, so there is no rehash going on.  */
+static struct strcache2_entry const *
+strcache2_find_locked (struct strcache2 *cache, const char *str,
+                       unsigned int length, unsigned int hash)
+{
+  struct strcache2_entry const *entry;
+  unsigned int idx = STRCACHE2_MOD_IT (cache, hash);
+  for (entry = cache->hash_tab[idx]; entry; entry = entry->next)
+#if defined(HAVE_CASE_INSENSITIVE_FS)
+    if (cache->case_insensitive
+        ? strcache2_is_iequal (cache, entry, str, length, hash)
+        : strcache2_is_equal (cache, entry, str, length, hash))
+#else
+    if (strcache2_is_equal (cache, entry, str, length, hash))
+#endif
+      break;
+  return entry;
+}
+
+/* Deals with a miss in the lockless lookup functions.  A rehash on another
+   thread may have hidden the entry from us (see strcache2_get_chain), so if
+   the rehash generation GEN taken before the lookup is odd or has changed
+   since, a thread safe cache has to be searched again while owning the lock
+   before we can say that the string isn't there. */
+MY_INLINE const char *
+strcache2_lookup_miss (struct strcache2 *cache, const char *str,
+                       unsigned int length, unsigned int hash,
+                       unsigned int gen)
+{
+  struct strcache2_entry const *entry;
+  if (!cache->lock)
+    return NULL;
+  STRCACHE2_FENCE_ACQ ();
+  if (   !(gen & 1)
+      && gen == STRCACHE2_LOAD_ACQ (unsigned int, cache->rehash_gen))
+    return NULL;
+
+  strcache2_lock (cache);
+  entry = strcache2_find_locked (cache, str, length, hash);
+  strcache2_unlock (cache);
+  return entry ? (const char *)(entry + 1) : NULL;
+}
+
+/* Enters a string into a thread safe cache after the lockless lookup
+   failed to find it.  Since another thread may have added the string
+   in the meantime (or a rehash may have hidden it), we have to look it
+   up again while owning the lock. */
+static const char *
+strcache2_enter_string_locked (struct strcache2 *cache, const char *str,
+                               unsigned int length, unsigned int hash)
+{
+  struct strcache2_entry const *entry;
+  const char *ret;
+
+  strcache2_lock (cache);
+
+  entry = strcache2_find_locked (cache, str, length, hash);
+  if (entry)
+    ret = (const char *)(entry + 1);
+  else
+    ret = strcache2_insert (cache, STRCACHE2_MOD_IT (cache, hash), str, length, hash);
+
+  strcache2_unlock (cache);
+  return ret;
+}
+
+/* Internal worker that enters a new string into the cache after a lookup
+   failed to find it in the IDX collision chain. */
+MY_INLINE const char *
+strcache2_enter_string (struct strcache2 *cache, unsigned int idx,
+                        const char *str, unsigned int length,
+                        unsigned int hash)
+{
+  if (cache->lock)
+    return strcache2_enter_string_locked (cache, str, length, hash);
+  return strcache2_insert (cache, idx, str, length, hash);
+}
+
 /* The public add string interface. */
 const char *
 strcache2_add (struct strcache2 *cache, const char *str, unsigned int length)
@@ -782,15 +980,14 @@ strcache2_add (struct strcache2 *cache, const char *str, unsigned int length)
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_get_chain (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
-  entry = entry->next;
+  entry = STRCACHE2_NEXT (entry);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -800,7 +997,7 @@ strcache2_add (struct strcache2 *cache, const char *str, unsigned int length)
   /* Loop the rest.  */
   for (;;)
     {
-      entry = entry->next;
+      entry = STRCACHE2_NEXT (entry);
       if (!entry)
         return strcache2_enter_string (cache, idx, str, length, hash);
       if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -831,15 +1028,14 @@ strcache2_add_hashed (struct strcache2 *cache, const char *str,
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_get_chain (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
-  entry = entry->next;
+  entry = STRCACHE2_NEXT (entry);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -849,7 +1045,7 @@ strcache2_add_hashed (struct strcache2 *cache, const char *str,
   /* Loop the rest.  */
   for (;;)
     {
-      entry = entry->next;
+      entry = STRCACHE2_NEXT (entry);
       if (!entry)
         return strcache2_enter_string (cache, idx, str, length, hash);
       if (strcache2_is_equal (cache, entry, str, length, hash))
@@ -866,6 +1062,7 @@ strcache2_lookup (struct strcache2 *cache, const char *str, unsigned int length)
   struct strcache2_entry const *entry;
   unsigned int hash = strcache2_case_sensitive_hash (str, length);
   unsigned int idx;
+  unsigned int gen;
 
   assert (!cache->case_insensitive);
   assert (!memchr (str, '\0', length));
@@ -874,17 +1071,17 @@ strcache2_lookup (struct strcache2 *cache, const char *str, unsigned int length)
 
   /* Lookup the entry in the hash table, hoping for an
      early match. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  gen = STRCACHE2_LOAD_ACQ (unsigned int, cache->rehash_gen);
+  entry = strcache2_get_chain (cache, hash, &idx);
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, gen);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
-  entry = entry->next;
+  entry = STRCACHE2_NEXT (entry);
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, gen);
   if (strcache2_is_equal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_2nd_count++);
@@ -892,9 +1089,9 @@ strcache2_lookup (struct strcache2 *cache, const char *str, unsigned int length)
   /* Loop the rest. */
   for (;;)
     {
-      entry = entry->next;
+      entry = STRCACHE2_NEXT (entry);
       if (!entry)
-        return NULL;
+        return strcache2_lookup_miss (cache, str, length, hash, gen);
       if (strcache2_is_equal (cache, entry, str, length, hash))
         return (const char *)(entry + 1);
       MAKE_STATS (cache->collision_3rd_count++);
@@ -919,15 +1116,14 @@ strcache2_iadd (struct strcache2 *cache, const char *str, unsigned int length)
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_get_chain (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_iequal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
-  entry = entry->next;
+  entry = STRCACHE2_NEXT (entry);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_iequal (cache, entry, str, length, hash))
@@ -937,7 +1133,7 @@ strcache2_iadd (struct strcache2 *cache, const char *str, unsigned int length)
   /* Loop the rest. */
   for (;;)
     {
-      entry = entry->next;
+      entry = STRCACHE2_NEXT (entry);
       if (!entry)
         return strcache2_enter_string (cache, idx, str, length, hash);
       if (strcache2_is_iequal (cache, entry, str, length, hash))
@@ -968,15 +1164,14 @@ strcache2_iadd_hashed (struct strcache2 *cache, const char *str,
 
   /* Lookup the entry in the hash table, hoping for an
      early match.  If not found, enter the string at IDX. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  entry = strcache2_get_chain (cache, hash, &idx);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_iequal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
-  entry = entry->next;
+  entry = STRCACHE2_NEXT (entry);
   if (!entry)
     return strcache2_enter_string (cache, idx, str, length, hash);
   if (strcache2_is_iequal (cache, entry, str, length, hash))
@@ -986,7 +1181,7 @@ strcache2_iadd_hashed (struct strcache2 *cache, const char *str,
   /* Loop the rest. */
   for (;;)
     {
-      entry = entry->next;
+      entry = STRCACHE2_NEXT (entry);
       if (!entry)
         return strcache2_enter_string (cache, idx, str, length, hash);
       if (strcache2_is_iequal (cache, entry, str, length, hash))
@@ -1003,6 +1198,7 @@ strcache2_ilookup (struct strcache2 *cache, const char *str, unsigned int length
   struct strcache2_entry const *entry;
   unsigned int hash = strcache2_case_insensitive_hash (str, length);
   unsigned int idx;
+  unsigned int gen;
 
   assert (cache->case_insensitive);
   assert (!memchr (str, '\0', length));
@@ -1011,17 +1207,17 @@ strcache2_ilookup (struct strcache2 *cache, const char *str, unsigned int length
 
   /* Lookup the entry in the hash table, hoping for an
      early match. */
-  idx = STRCACHE2_MOD_IT (cache, hash);
-  entry = cache->hash_tab[idx];
+  gen = STRCACHE2_LOAD_ACQ (unsigned int, cache->rehash_gen);
+  entry = strcache2_get_chain (cache, hash, &idx);
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, gen);
   if (strcache2_is_iequal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_1st_count++);
 
-  entry = entry->next;
+  entry = STRCACHE2_NEXT (entry);
   if (!entry)
-    return NULL;
+    return strcache2_lookup_miss (cache, str, length, hash, gen);
   if (strcache2_is_iequal (cache, entry, str, length, hash))
     return (const char *)(entry + 1);
   MAKE_STATS (cache->collision_2nd_count++);
@@ -1029,9 +1225,9 @@ strcache2_ilookup (struct strcache2 *cache, const char *str, unsigned int length
   /* Loop the rest. */
   for (;;)
     {
-      entry = entry->next;
+      entry = STRCACHE2_NEXT (entry);
       if (!entry)
-        return NULL;
+        return strcache2_lookup_miss (cache, str, length, hash, gen);
       if (strcache2_is_iequal (cache, entry, str, length, hash))
         return (const char *)(entry + 1);
       MAKE_STATS (cache->collision_3rd_count++);
@@ -1127,7 +1323,6 @@ strcache2_init (struct strcache2 *cache, const char *name, unsigned int size,
                 unsigned int def_seg_size, int case_insensitive, int thread_safe)
 {
   unsigned hash_shift;
-  assert (!thread_safe);
 
   /* calc the size as a power of two */
   if (!size)
@@ -1166,12 +1361,32 @@ strcache2_init (struct strcache2 *cache, const char *name, unsigned int size,
   cache->hash_size = 1U << hash_shift;
   cache->def_seg_size = def_seg_size;
   cache->lock = NULL;
+  cache->rehash_gen = 0;
   cache->name = name;
 
-  /* allocate the hash table and first segment. */
+  /* create the lock if the cache is to be shared between threads. */
+  if (thread_safe)
+    {
+#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
+      int rc;
+      cache->lock = xmalloc (sizeof (pthread_mutex_t));
+      rc = pthread_mutex_init ((pthread_mutex_t *)cache->lock, NULL);
+      if (rc)
+        ON (fatal, NILF, _("pthread_mutex_init failed: err=%d"), rc);
+#elif defined (WINDOWS32)
+      cache->lock = xmalloc (sizeof (CRITICAL_SECTION));
+      InitializeCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+      cache->lock = xmalloc (sizeof (_fmutex));
+      _fmutex_create ((_fmutex *)cache->lock, 0);
+#endif
+    }
+
+  /* allocate the hash table and first segment.  Thread safe caches has an
+     extra slot at the end for linking up retired tables, see rehash. */
   cache->hash_tab = (struct strcache2_entry **)
-    xmalloc (cache->init_size * sizeof (struct strcache2_entry *));
-  memset (cache->hash_tab, '\0', cache->init_size * sizeof (struct strcache2_entry *));
+    xmalloc ((cache->init_size + (cache->lock != NULL)) * sizeof (struct strcache2_entry *));
+  memset (cache->hash_tab, '\0', (cache->init_size + (cache->lock != NULL)) * sizeof (struct strcache2_entry *));
   strcache2_new_seg (cache, 0);
 
   /* link it */
@@ -1206,8 +1421,31 @@ strcache2_term (struct strcache2 *cache)
     }
   while (cache->seg_head);
 
-  /* free the hash and clear the structure. */
-  free (cache->hash_tab);
+  /* free the hash (and any retired ones) and the lock, then clear the
+     structure. */
+  if (cache->lock)
+    {
+      struct strcache2_entry **hash_tab = cache->hash_tab;
+      unsigned int hash_size = cache->hash_size;
+      while (hash_tab)
+        {
+          struct strcache2_entry **prev = (struct strcache2_entry **)hash_tab[hash_size];
+          free (hash_tab);
+          hash_tab = prev;
+          hash_size >>= 1;
+        }
+
+#if defined (HAVE_PTHREAD) && !defined (CONFIG_WITHOUT_THREADS)
+      pthread_mutex_destroy ((pthread_mutex_t *)cache->lock);
+#elif defined (WINDOWS32)
+      DeleteCriticalSection ((CRITICAL_SECTION *)cache->lock);
+#elif defined (__OS2__)
+      _fmutex_close ((_fmutex *)cache->lock);
+#endif
+      free (cache->lock);
+    }
+  else
+    free (cache->hash_tab);
   memset (cache, '\0', sizeof (struct strcache2));
 }
 
@@ -67,6 +67,14 @@ struct strcache2_entry
 #define STRCACHE2_ENTRY_ALIGNMENT       (1 << STRCACHE2_ENTRY_ALIGN_SHIFT)
 
 
+/* A string cache.
+
+   If initialized as thread safe, lookups (including the hit path of the add
+   functions) are done without any locking, while inserting new strings and
+   rehashing is serialized by the lock.  Entries never move or go away, so a
+   string pointer obtained in one thread is valid in all of them.  A lookup
+   racing a rehash may miss an entry; rehash_gen tells the lookup functions
+   when that may have happened so they can search again under the lock.  */
 struct strcache2
 {
     struct strcache2_entry **hash_tab;  /* The hash table. */
@@ -86,7 +94,8 @@ struct strcache2
     unsigned int init_size;             /* The initial hash table size. */
     unsigned int hash_size;             /* The hash table size. */
     unsigned int def_seg_size;          /* The default segment size. */
-    void *lock;                         /* The lock handle. */
+    void *lock;                         /* The lock handle, NULL if not thread safe. */
+    unsigned int rehash_gen;            /* Rehash generation, odd while rehashing. */
     struct strcache2_seg *seg_head;     /* The memory segment list. */
     struct strcache2 *next;             /* The next string cache. */
     const char *name;                   /* Cache name. */
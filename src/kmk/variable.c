@@ -624,7 +624,11 @@ undefine_variable_in_set (const char *name, unsigned int length,
             strcache2_set_user_val (&variable_strcache, v->name, NULL);
 #endif
           free_variable_name_and_value (v);
+#ifndef CONFIG_WITH_ALLOC_CACHES
           free (v);
+#else
+          alloccache_free (&variable_cache, v);
+#endif
           if (set == &global_variable_set)
             ++variable_changenum;
         }
@@ -1723,6 +1727,11 @@ define_automatic_variables (void)
   define_variable_cname ("PATH_KBUILD_BIN", get_kbuild_bin_path (), o_default, 0);
 
   /* Define KMK_FEATURES to indicate various working KMK features. */
+# if defined (CONFIG_WITH_CMD_DB) && defined (CONFIG_WITH_COMMANDS_FUNC)
+#  define KMK_FEATURES_CMD_DB " comp-cmds-db"
+# else
+#  define KMK_FEATURES_CMD_DB ""
+# endif
 # if defined (CONFIG_WITH_RSORT) \
   && defined (CONFIG_WITH_ABSPATHEX) \
   && defined (CONFIG_WITH_TOUPPER_TOLOWER) \
@@ -1778,6 +1787,7 @@ define_automatic_variables (void)
                          " length insert pos lastpos substr translate"
                          " kb-src-tool kb-obj-base kb-obj-suff kb-src-prop kb-src-one kb-exp-tmpl"
                          " firstdefined lastdefined"
+                         KMK_FEATURES_CMD_DB
                          , o_default, 0);
 # else /* MSC can't deal with strings mixed with #if/#endif, thus the slow way. */
 #  error "All features should be enabled by default!"
@@ -1858,6 +1868,7 @@ define_automatic_variables (void)
 #  if defined (CONFIG_WITH_DEFINED_FUNCTIONS)
   strcat (buf, " firstdefined lastdefined");
 #  endif
+  strcat (buf, KMK_FEATURES_CMD_DB);
 #  if defined (KMK_HELPERS)
   strcat (buf, " kb-src-tool kb-obj-base kb-obj-suff kb-src-prop kb-src-one kb-exp-tmpl");
 #  endif
@@ -150,12 +150,51 @@ crc(int fd, u_int32_t *cval, off_t *clen)
 
 /* These two are rather more useful to the outside world */
 
+/*
+ * Slice-by-8: crctab8[k][b] is the crc of byte b followed by k zero bytes,
+ * so eight input bytes can be folded in with eight independent lookups
+ * instead of a chain of eight dependent ones.  The tables are derived from
+ * crctab the first time they are needed.
+ */
+static u_int32_t crctab8[8][256];
+static int crctab8_done;
+
+static void
+crc32_init_slices(void)
+{
+	unsigned i, k;
+
+	for (i = 0; i < 256; i++)
+		crctab8[0][i] = crctab[i];
+	for (k = 1; k < 8; k++)
+		for (i = 0; i < 256; i++)
+			crctab8[k][i] = crctab8[k - 1][i] << 8
+			    ^ crctab[crctab8[k - 1][i] >> 24];
+	crctab8_done = 1;
+}
+
 uint32_t
 crc32(uint32_t thecrc, const void *buf, size_t len)
 {
 	const uint8_t *p = buf;
 
-	for (p = buf; len; p++, len--)
+	if (len >= 64) {
+		if (!crctab8_done)
+			crc32_init_slices();
+		for (; len >= 8; p += 8, len -= 8) {
+			thecrc ^= (u_int32_t)p[0] << 24 | (u_int32_t)p[1] << 16
+			    | (u_int32_t)p[2] << 8 | p[3];
+			thecrc = crctab8[7][thecrc >> 24]
+			    ^ crctab8[6][(thecrc >> 16) & 0xff]
+			    ^ crctab8[5][(thecrc >> 8) & 0xff]
+			    ^ crctab8[4][thecrc & 0xff]
+			    ^ crctab8[3][p[4]]
+			    ^ crctab8[2][p[5]]
+			    ^ crctab8[1][p[6]]
+			    ^ crctab8[0][p[7]];
+		}
+	}
+	for (; len; p++, len--)
 		COMPUTE(thecrc, *p);
 	return thecrc;
 }
@@ -54,9 +54,14 @@
 # include <dirent.h>
 # include <unistd.h>
 # include <stdint.h>
+# if K_OS != K_OS_OS2
+#  define USE_POSIX_MMAP
+#  include <sys/mman.h>
+# endif
 #endif
 
 #include "kDep.h"
+#include "../kmk/kdepdb.h"
 
 #ifdef KWORKER
 extern int kwFsPathExists(const char *pszPath);
@@ -353,6 +358,74 @@ void depPrintStubs(PDEPGLOBALS pThis, FILE *pOutput)
 }
 
 
+/**
+ * Writes the dependencies to a dependency database (see kmk/kdepdb.c)
+ * instead of a dependency file.
+ *
+ * The entry is keyed by the dependency file name, so the makefile can keep
+ * using 'includedep' on it when KMK_DEPDB points to the database.
+ *
+ * @returns 0 on success, errno style status code on failure.
+ * @param   pThis       The 'dep' instance.
+ * @param   pszDb       The database filename base.
+ * @param   pszName     The name of the dependency file this replaces.
+ * @param   pszTarget   The target the dependencies are for.
+ * @param   fStubs      Whether to add empty stub rules for the dependencies.
+ */
+int depWriteToDb(PDEPGLOBALS pThis, const char *pszDb, const char *pszName, const char *pszTarget, int fStubs)
+{
+    PKDEPDB         pDb;
+    KDEPDBRULE     *paRules;
+    const char    **papszDeps;
+    unsigned        cDeps = 0;
+    unsigned        cRules;
+    unsigned        i;
+    PDEP            pDep;
+    int             rc;
+
+    /*
+     * Build the rule array: the target with all the dependencies, optionally
+     * followed by one empty rule per dependency.
+     */
+    for (pDep = pThis->pDeps; pDep; pDep = pDep->pNext)
+        cDeps++;
+    cRules = 1 + (fStubs ? cDeps : 0);
+    paRules   = (KDEPDBRULE *)malloc(sizeof(paRules[0]) * cRules);
+    papszDeps = (const char **)malloc(sizeof(papszDeps[0]) * (cDeps + 1));
+    if (!paRules || !papszDeps)
+    {
+        free(paRules);
+        free(papszDeps);
+        return ENOMEM;
+    }
+    for (pDep = pThis->pDeps, i = 0; pDep; pDep = pDep->pNext, i++)
+        papszDeps[i] = pDep->szFilename;
+    paRules[0].pszTarget = pszTarget;
+    paRules[0].cDeps     = cDeps;
+    paRules[0].papszDeps = papszDeps;
+    for (i = 1; i < cRules; i++)
+    {
+        paRules[i].pszTarget = papszDeps[i - 1];
+        paRules[i].cDeps     = 0;
+        paRules[i].papszDeps = NULL;
+    }
+
+    /*
+     * Store it.
+     */
+    rc = kDepDbOpen(&pDb, pszDb, 1 /* fWrite */);
+    if (!rc)
+    {
+        rc = kDepDbPut(pDb, pszName, paRules, cRules);
+        kDepDbClose(pDb);
+    }
+
+    free(papszDeps);
+    free(paRules);
+    return rc;
+}
+
+
 /* sdbm:
    This algorithm was created for sdbm (a public-domain reimplementation of
    ndbm) database library. it was found to do well in scrambling bits,
@@ -516,6 +589,21 @@ void *depReadFileIntoMemory(FILE *pInput, size_t *pcbFile, void **ppvOpaque)
             fprintf(stderr, "kDep: warning: CreateFileMapping failed, %d.\n", GetLastError());
     }
 
+#elif defined(USE_POSIX_MMAP)
+    /* Note! Unlike the read path, the mapping isn't zero terminated. The
+             opaque value is the mapping size so depFreeFileMemory can
+             unmap it; empty files are read since they cannot be mapped. */
+    if (cbFile > 0)
+    {
+        pvFile = mmap(NULL, cbFile, PROT_READ, MAP_PRIVATE, fileno(pInput), 0);
+        if (pvFile != MAP_FAILED)
+        {
+            *ppvOpaque = (void *)(uintptr_t)cbFile;
+            return pvFile;
+        }
+        fprintf(stderr, "kDep: warning: mmap failed, %s.\n", strerror(errno));
+    }
+
 #endif
 
     /*
@@ -554,6 +642,12 @@ void depFreeFileMemory(void *pvFile, void *pvOpaque)
         CloseHandle(pvOpaque);
         return;
     }
+#elif defined(USE_POSIX_MMAP)
+    if (pvOpaque)
+    {
+        munmap(pvFile, (uintptr_t)pvOpaque);
+        return;
+    }
 #endif
     free(pvFile);
 }
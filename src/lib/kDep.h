@@ -59,6 +59,7 @@ extern PDEP depAdd(PDEPGLOBALS pThis, const char *pszFilename, size_t cchFilenam
 extern void depOptimize(PDEPGLOBALS pThis, int fFixCase, int fQuiet, const char *pszIgnoredExt);
 extern void depPrint(PDEPGLOBALS pThis, FILE *pOutput);
 extern void depPrintStubs(PDEPGLOBALS pThis, FILE *pOutput);
+extern int  depWriteToDb(PDEPGLOBALS pThis, const char *pszDb, const char *pszName, const char *pszTarget, int fStubs);
 
 extern void *depReadFileIntoMemory(FILE *pInput, size_t *pcbFile, void **ppvOpaque);
 extern void depFreeFileMemory(void *pvFile, void *pvOpaque);
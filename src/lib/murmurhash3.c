@@ -0,0 +1,209 @@
+/* $Id$ */
+/** @file
+ * murmurhash3 - Incremental MurmurHash3 x64 128-bit.
+ *
+ * The algorithm is Austin Appleby's MurmurHash3_x64_128 (public domain) with
+ * a zero seed, restructured so the data can be fed in arbitrary pieces.  The
+ * digest is the two 64-bit halves in little endian byte order, i.e. the same
+ * bytes as the reference implementation produces on x86.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Alternatively, the content of this file may be used under the terms of the
+ * GPL version 2 or later, or LGPL version 2.1 or later.
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <string.h>
+#include "murmurhash3.h"
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+#ifndef UINT64_C
+# define UINT64_C(a_Value) a_Value ## ui64
+#endif
+
+#define MM3_C1  UINT64_C(0x87c37b91114253d5)
+#define MM3_C2  UINT64_C(0x4cf5ad432745937f)
+#define MM3_ROTL64(a_u, a_cShift)   ( ((a_u) << (a_cShift)) | ((a_u) >> (64 - (a_cShift))) )
+
+
+/**
+ * Loads a little endian 64-bit value (any alignment).
+ */
+static uint64_t mm3Load64(const unsigned char *pb)
+{
+    return (uint64_t)pb[0]
+         | ((uint64_t)pb[1] <<  8)
+         | ((uint64_t)pb[2] << 16)
+         | ((uint64_t)pb[3] << 24)
+         | ((uint64_t)pb[4] << 32)
+         | ((uint64_t)pb[5] << 40)
+         | ((uint64_t)pb[6] << 48)
+         | ((uint64_t)pb[7] << 56);
+}
+
+
+/**
+ * Final avalanche of one half.
+ */
+static uint64_t mm3FMix64(uint64_t u)
+{
+    u ^= u >> 33;
+    u *= UINT64_C(0xff51afd7ed558ccd);
+    u ^= u >> 33;
+    u *= UINT64_C(0xc4ceb9fe1a85ec53);
+    u ^= u >> 33;
+    return u;
+}
+
+
+/**
+ * Mixes whole 16 byte blocks into the hash.
+ *
+ * @param   pCtx    The context.
+ * @param   pb      The blocks.
+ * @param   cBlocks The number of blocks.
+ */
+static void mm3Blocks(struct MurmurHash3Context *pCtx, const unsigned char *pb, size_t cBlocks)
+{
+    uint64_t h1 = pCtx->h1;
+    uint64_t h2 = pCtx->h2;
+    while (cBlocks-- > 0)
+    {
+        uint64_t k1 = mm3Load64(pb);
+        uint64_t k2 = mm3Load64(pb + 8);
+        pb += 16;
+
+        k1 *= MM3_C1; k1 = MM3_ROTL64(k1, 31); k1 *= MM3_C2; h1 ^= k1;
+        h1 = MM3_ROTL64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= MM3_C2; k2 = MM3_ROTL64(k2, 33); k2 *= MM3_C1; h2 ^= k2;
+        h2 = MM3_ROTL64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+    pCtx->h1 = h1;
+    pCtx->h2 = h2;
+}
+
+
+/**
+ * Initializes a hash context.
+ *
+ * @param   pCtx    The context.
+ */
+void MurmurHash3Init(struct MurmurHash3Context *pCtx)
+{
+    pCtx->h1 = 0;
+    pCtx->h2 = 0;
+    pCtx->cbTotal = 0;
+    pCtx->cbPartial = 0;
+}
+
+
+/**
+ * Feeds more data to the hash.
+ *
+ * @param   pCtx    The context.
+ * @param   pvBuf   The data.
+ * @param   cbBuf   The number of bytes.
+ */
+void MurmurHash3Update(struct MurmurHash3Context *pCtx, const void *pvBuf, size_t cbBuf)
+{
+    const unsigned char *pb = (const unsigned char *)pvBuf;
+    pCtx->cbTotal += cbBuf;
+
+    /* Complete the partial block from the previous call. */
+    if (pCtx->cbPartial)
+    {
+        size_t cb = 16 - pCtx->cbPartial;
+        if (cb > cbBuf)
+            cb = cbBuf;
+        memcpy(&pCtx->abPartial[pCtx->cbPartial], pb, cb);
+        pCtx->cbPartial += (unsigned)cb;
+        pb += cb;
+        cbBuf -= cb;
+        if (pCtx->cbPartial < 16)
+            return;
+        mm3Blocks(pCtx, pCtx->abPartial, 1);
+        pCtx->cbPartial = 0;
+    }
+
+    /* Whole blocks straight from the input, carry over the rest. */
+    mm3Blocks(pCtx, pb, cbBuf / 16);
+    pb += cbBuf & ~(size_t)15;
+    cbBuf &= 15;
+    if (cbBuf)
+    {
+        memcpy(pCtx->abPartial, pb, cbBuf);
+        pCtx->cbPartial = (unsigned)cbBuf;
+    }
+}
+
+
+/**
+ * Completes the hash calculation.
+ *
+ * @param   abDigest    Where to return the 128-bit digest.
+ * @param   pCtx        The context.  Must be reinitialized before reuse.
+ */
+void MurmurHash3Final(unsigned char abDigest[16], struct MurmurHash3Context *pCtx)
+{
+    uint64_t h1 = pCtx->h1;
+    uint64_t h2 = pCtx->h2;
+    unsigned i;
+
+    /* The tail. */
+    if (pCtx->cbPartial)
+    {
+        unsigned char abTail[16];
+        uint64_t k1, k2;
+        memset(abTail, 0, sizeof(abTail));
+        memcpy(abTail, pCtx->abPartial, pCtx->cbPartial);
+        k1 = mm3Load64(abTail);
+        k2 = mm3Load64(abTail + 8);
+
+        k2 *= MM3_C2; k2 = MM3_ROTL64(k2, 33); k2 *= MM3_C1; h2 ^= k2;
+        k1 *= MM3_C1; k1 = MM3_ROTL64(k1, 31); k1 *= MM3_C2; h1 ^= k1;
+    }
+
+    /* Finalization. */
+    h1 ^= pCtx->cbTotal;
+    h2 ^= pCtx->cbTotal;
+    h1 += h2;
+    h2 += h1;
+    h1 = mm3FMix64(h1);
+    h2 = mm3FMix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    for (i = 0; i < 8; i++)
+    {
+        abDigest[i]     = (unsigned char)(h1 >> (i * 8));
+        abDigest[i + 8] = (unsigned char)(h2 >> (i * 8));
+    }
+    memset(pCtx, 0, sizeof(*pCtx));
+}
@@ -0,0 +1,55 @@
+/* $Id$ */
+/** @file
+ * murmurhash3 - Incremental MurmurHash3 x64 128-bit.
+ */
+
+/*
+ * Copyright (c) 2026 knut st. osmundsen <bird-kBuild-spamx@anduin.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Alternatively, the content of this file may be used under the terms of the
+ * GPL version 2 or later, or LGPL version 2.1 or later.
+ */
+
+#ifndef ___murmurhash3_h___
+#define ___murmurhash3_h___
+
+#include "mytypes.h"
+
+/**
+ * MurmurHash3 context for hashing data that arrives in pieces.
+ */
+struct MurmurHash3Context
+{
+    /** The two hash halves. */
+    uint64_t h1, h2;
+    /** The total number of bytes hashed. */
+    uint64_t cbTotal;
+    /** Number of bytes in abPartial. */
+    unsigned cbPartial;
+    /** Partial block carried over to the next update. */
+    unsigned char abPartial[16];
+};
+
+void MurmurHash3Init(struct MurmurHash3Context *pCtx);
+void MurmurHash3Update(struct MurmurHash3Context *pCtx, const void *pvBuf, size_t cbBuf);
+void MurmurHash3Final(unsigned char abDigest[16], struct MurmurHash3Context *pCtx);
+
+#endif
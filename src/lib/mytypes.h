@@ -40,6 +40,8 @@ typedef unsigned int uint32_t;
 typedef signed int int32_t;
 typedef unsigned char uint8_t;
 typedef signed char int8_t;
+typedef unsigned __int64 uint64_t;
+typedef signed __int64 int64_t;
 #else
 # include <stdint.h>
 #endif